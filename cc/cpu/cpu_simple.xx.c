@@ -43,6 +43,36 @@ int8_t cpu_check_rdrand(void){
     return -1;
 }
 
+int8_t cpu_check_pcid(void){
+    cpu_cpuid_regs_t query = {0x00000001, 0, 0, 0};
+    cpu_cpuid_regs_t answer = {0, 0, 0, 0};
+
+    if(cpu_cpuid(query, &answer) != 0) {
+        return -1;
+    }
+
+    if(((answer.ecx >> 17) & 1) == 1) {
+        return 0;
+    }
+
+    return -1;
+}
+
+int8_t cpu_check_1g_pages(void){
+    cpu_cpuid_regs_t query = {0x80000001, 0, 0, 0};
+    cpu_cpuid_regs_t answer = {0, 0, 0, 0};
+
+    if(cpu_cpuid(query, &answer) != 0) {
+        return -1;
+    }
+
+    if(((answer.edx >> 26) & 1) == 1) {
+        return 0;
+    }
+
+    return -1;
+}
+
 
 uint8_t cpu_cpuid(cpu_cpuid_regs_t query, cpu_cpuid_regs_t* answer){
     __asm__ __volatile__ ("cpuid\n"
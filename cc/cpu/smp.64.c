@@ -28,6 +28,11 @@ void video_text_print(const char_t* str);
 
 int8_t  smp_init_cpu(uint8_t cpu_id);
 int32_t smp_ap_boot(uint8_t cpu_id);
+int8_t  smp_tlb_shootdown_isr(interrupt_frame_ext_t* frame);
+
+smp_tlb_shootdown_request_t smp_tlb_shootdown_requests[MEMORY_PAGING_CPU_MASK_SIZE * 64] = {0};
+volatile uint64_t smp_tlb_shootdown_active_mask[MEMORY_PAGING_CPU_MASK_SIZE] = {0};
+uint8_t smp_tlb_shootdown_intnum = 0;
 
 const uint8_t trampoline_code[] = {
     0xea, 0x05, 0x80, 0x00, 0x00, // 8000: jmp $0x0:$0x8005
@@ -104,6 +109,113 @@ const uint8_t trampoline_code[] = {
 };
 
 
+static void smp_tlb_shootdown_serve(uint8_t apic_id) {
+    for(uint64_t i = 0; i < MEMORY_PAGING_CPU_MASK_SIZE; i++) {
+        uint64_t active = __atomic_load_n(&smp_tlb_shootdown_active_mask[i], __ATOMIC_ACQUIRE);
+
+        while(active) {
+            uint64_t bit = __builtin_ctzll(active);
+            active &= active - 1;
+
+            smp_tlb_shootdown_request_t* req = &smp_tlb_shootdown_requests[i * 64 + bit];
+
+            // request fields are written before pending bits, so they are valid while our bit is set
+            if(!(__atomic_load_n(&req->pending_mask[apic_id / 64], __ATOMIC_ACQUIRE) & (1ULL << (apic_id % 64)))) {
+                continue;
+            }
+
+            memory_paging_tlb_invalidate_local(req->table_context, req->virtual_address, req->page_count, apic_id);
+
+            bit_clear_atomic(&req->pending_mask[apic_id / 64], apic_id % 64);
+        }
+    }
+}
+
+int8_t smp_tlb_shootdown_isr(interrupt_frame_ext_t* frame) {
+    UNUSED(frame);
+
+    smp_tlb_shootdown_serve(apic_get_local_apic_id());
+
+    apic_eoi();
+
+    return 0;
+}
+
+int8_t smp_tlb_shootdown(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t page_count) {
+    if(table_context == NULL) {
+        return -1;
+    }
+
+    boolean_t int_was_disabled = cpu_cli();
+    uint8_t apic_id = apic_get_local_apic_id();
+
+    smp_tlb_shootdown_request_t* req = &smp_tlb_shootdown_requests[apic_id];
+
+    req->table_context = table_context;
+    req->virtual_address = virtual_address;
+    req->page_count = page_count;
+
+    uint64_t targets[MEMORY_PAGING_CPU_MASK_SIZE] = {0};
+
+    // cpus which left the table can keep entries tagged with its pcid, they flush it at next load
+    for(uint64_t i = 0; i < MEMORY_PAGING_CPU_MASK_SIZE; i++) {
+        targets[i] = table_context->cpu_mask[i];
+        __atomic_fetch_or(&table_context->flush_mask[i], ~targets[i], __ATOMIC_SEQ_CST);
+    }
+
+    boolean_t has_target = false;
+
+    // a cpu loading the table may consume its flush bit before we set it, read mask again and interrupt it
+    for(uint64_t i = 0; i < MEMORY_PAGING_CPU_MASK_SIZE; i++) {
+        uint64_t mask = targets[i] | __atomic_load_n(&table_context->cpu_mask[i], __ATOMIC_SEQ_CST);
+
+        if(i == apic_id / 64U) {
+            mask &= ~(1ULL << (apic_id % 64));
+        }
+
+        __atomic_store_n(&req->pending_mask[i], mask, __ATOMIC_RELEASE);
+
+        if(mask) {
+            has_target = true;
+        }
+    }
+
+    if(has_target) {
+        bit_set_atomic(&smp_tlb_shootdown_active_mask[apic_id / 64], apic_id % 64);
+
+        for(uint64_t i = 0; i < MEMORY_PAGING_CPU_MASK_SIZE; i++) {
+            uint64_t mask = req->pending_mask[i];
+
+            while(mask) {
+                uint64_t bit = __builtin_ctzll(mask);
+                mask &= mask - 1;
+
+                apic_send_ipi(i * 64 + bit, smp_tlb_shootdown_intnum);
+            }
+        }
+    }
+
+    memory_paging_tlb_invalidate_local(table_context, virtual_address, page_count, apic_id);
+
+    if(has_target) {
+        // targets may wait for our ack with interrupts disabled, so serve their requests while waiting
+        for(uint64_t i = 0; i < MEMORY_PAGING_CPU_MASK_SIZE; i++) {
+            while(req->pending_mask[i]) {
+                smp_tlb_shootdown_serve(apic_id);
+                asm volatile ("pause" ::: "memory");
+            }
+        }
+
+        bit_clear_atomic(&smp_tlb_shootdown_active_mask[apic_id / 64], apic_id % 64);
+    }
+
+    if(!int_was_disabled) {
+        cpu_sti();
+    }
+
+    return 0;
+}
+
 int8_t smp_init_cpu(uint8_t cpu_id) {
     PRINTLOG(APIC, LOG_INFO, "SMP: Initialising CPU %d", cpu_id);
 
@@ -139,6 +251,18 @@ int8_t smp_init(void) {
         return -1;
     }
 
+    smp_tlb_shootdown_intnum = interrupt_get_next_empty_interrupt();
+    interrupt_irq_set_handler(smp_tlb_shootdown_intnum - INTERRUPT_IRQ_BASE, &smp_tlb_shootdown_isr);
+
+    // bsp loads table again for marking itself as user of the table
+    memory_page_table_context_t* table_context = memory_paging_get_table();
+    uint64_t bsp_cr3 = memory_paging_get_cr3_for_cpu(table_context, local_apic_id);
+    __asm__ __volatile__ ("mov %0, %%cr3\n" : : "r" (bsp_cr3));
+
+    memory_paging_set_tlb_shootdown_handler(smp_tlb_shootdown);
+
+    PRINTLOG(APIC, LOG_INFO, "SMP: tlb shootdown interrupt 0x%02x", smp_tlb_shootdown_intnum);
+
     memory_paging_add_page(0x8000, 0x8000, MEMORY_PAGING_PAGE_TYPE_4K);
 
     uint8_t * trampoline = (uint8_t*)0x8000;
@@ -239,6 +363,10 @@ int32_t smp_ap_boot(uint8_t cpu_id) {
     uint64_t stack_base = smp_data->stack_base;
     stack_base += (cpu_id - 1) * smp_data->stack_size;
 
+    // reload table with pcid of table and mark cpu as user of the table for tlb shootdowns
+    uint64_t cr3 = memory_paging_get_cr3_for_cpu(memory_paging_get_table(), cpu_id);
+    __asm__ __volatile__ ("mov %0, %%cr3\n" : : "r" (cr3));
+
     apic_enable_lapic();
 
     uint32_t local_apic_id = apic_get_local_apic_id();
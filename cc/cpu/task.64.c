@@ -10,6 +10,7 @@
 #include <cpu/cpu_state.h>
 #include <cpu/interrupt.h>
 #include <cpu/task.h>
+#include <cpu/task_sleep_queue.h>
 #include <cpu/crx.h>
 #include <cpu/sync.h>
 #include <memory/paging.h>
@@ -57,8 +58,30 @@ lock_t* task_next_task_id_lock = NULL;
 
 volatile boolean_t task_tasking_initialized = false;
 
+/*! initial capacity of sleep queue of each cpu */
+#define TASK_SCHEDULER_SLEEP_QUEUE_INITIAL_CAPACITY 64
+
+/**
+ * @struct task_scheduler_t
+ * @brief per cpu scheduler queues except ready and cleanup queues which are at cpu state
+ *
+ * sleeping tasks are kept at a sleep queue ordered by wake tick, waiting tasks are kept at an intrusive list.
+ * other cpus and interrupts never touch these queues, they push tasks into lock free wake inbox and owner cpu
+ * places them at next task switch.
+ */
+typedef struct task_scheduler_t {
+    memory_heap_t*      heap; ///< heap of scheduler and sleep queue
+    task_t* volatile    wake_inbox; ///< lock free stack of woken or new tasks
+    task_sleep_queue_t* sleep_queue; ///< sleeping tasks ordered by wake tick
+    task_t*             wait_head; ///< first task of wait list
+    uint64_t            wait_count; ///< waiting task count
+    uint64_t            last_poll_tick; ///< last tick when wait list polled for message queues
+    uint64_t            task_count; ///< task count assigned to cpu, used for balancing new tasks
+} task_scheduler_t; ///< short hand for struct
+
 list_t** task_queues = NULL;
 list_t** task_cleanup_queues = NULL;
+task_scheduler_t** task_schedulers = NULL;
 map_t task_map = NULL;
 uint32_t task_mxcsr_mask = 0;
 
@@ -81,6 +104,72 @@ extern volatile cpu_state_t __seg_gs * cpu_state;
 
 lock_t * task_find_next_task_lock = NULL;
 
+static task_scheduler_t* task_scheduler_create(memory_heap_t* heap) {
+    if(heap == NULL) {
+        heap = memory_get_default_heap(); // sleep queue grows at task switch, so never use task heaps
+    }
+
+    task_scheduler_t* scheduler = memory_malloc_ext(heap, sizeof(task_scheduler_t), 0x40);
+
+    if(scheduler == NULL) {
+        return NULL;
+    }
+
+    scheduler->sleep_queue = task_sleep_queue_create(heap, TASK_SCHEDULER_SLEEP_QUEUE_INITIAL_CAPACITY);
+
+    if(scheduler->sleep_queue == NULL) {
+        memory_free_ext(heap, scheduler);
+
+        return NULL;
+    }
+
+    scheduler->heap = heap;
+
+    return scheduler;
+}
+
+static inline boolean_t task_scheduler_cas(task_t* volatile* target, task_t* expected, task_t* desired) {
+    boolean_t res = false;
+    __asm__ __volatile__ ("lock cmpxchgq %[desired], %[target]\n"
+                          : "=@ccz" (res), [target] "+m" (*target), "+a" (expected)
+                          : [desired] "r" (desired)
+                          : "memory");
+    return res;
+}
+
+static inline task_t* task_scheduler_xchg(task_t* volatile* target, task_t* value) {
+    __asm__ __volatile__ ("xchgq %[value], %[target]\n" : [value] "+r" (value), [target] "+m" (*target) : : "memory");
+    return value;
+}
+
+static inline boolean_t task_scheduler_test_and_set(volatile uint64_t* flag) {
+    uint8_t was_set = 0;
+    __asm__ __volatile__ ("lock btsq $0, %[flag]\n" : "=@ccc" (was_set), [flag] "+m" (*flag) : : "memory");
+    return was_set;
+}
+
+/**
+ * @brief pushes task into wake inbox of its cpu, safe for other cpus and interrupts
+ * @param[in] task task whose flags are already updated
+ */
+static void task_scheduler_wake(task_t* task) {
+    if(task_schedulers == NULL || task_schedulers[task->cpu_id] == NULL) {
+        return;
+    }
+
+    if(task_scheduler_test_and_set(&task->wake_pending)) {
+        return; // already at inbox, owner cpu will check task flags
+    }
+
+    task_scheduler_t* scheduler = task_schedulers[task->cpu_id];
+    task_t* head = NULL;
+
+    do {
+        head = scheduler->wake_inbox;
+        task->wake_next = head;
+    } while(!task_scheduler_cas(&scheduler->wake_inbox, head, task));
+}
+
 task_t* task_get_current_task(void){
     if(!task_tasking_initialized) {
         return NULL;
@@ -177,12 +266,27 @@ int8_t task_init_tasking_ext(memory_heap_t* heap) {
 
     task_queues = memory_malloc_ext(heap, sizeof(list_t*) * cpu_count, 0x0);
     task_cleanup_queues = memory_malloc_ext(heap, sizeof(list_t*) * cpu_count, 0x0);
+    task_schedulers = memory_malloc_ext(heap, sizeof(task_scheduler_t*) * cpu_count, 0x0);
+
+    if(task_queues == NULL || task_cleanup_queues == NULL || task_schedulers == NULL) {
+        PRINTLOG(TASKING, LOG_FATAL, "cannot allocate task queue lists");
+
+        return -1;
+    }
 
     task_queues[0] = list_create_queue_with_heap(heap);
     task_cleanup_queues[0] = list_create_queue_with_heap(heap);
+    task_schedulers[0] = task_scheduler_create(heap);
+
+    if(task_queues[0] == NULL || task_cleanup_queues[0] == NULL || task_schedulers[0] == NULL) {
+        PRINTLOG(TASKING, LOG_FATAL, "cannot create task queues");
+
+        return -1;
+    }
 
     current_cpu_state->task_queue = task_queues[0];
     current_cpu_state->task_cleanup_queue = task_cleanup_queues[0];
+    current_cpu_state->task_scheduler = task_schedulers[0];
 
     interrupt_irq_set_handler(0xde, &task_task_switch_isr);
 
@@ -297,10 +401,17 @@ int8_t task_set_current_and_idle_task(void* entry_point, uint64_t stack_base, ui
 
     task_queues[apic_id] = list_create_queue_with_heap(heap);
     task_cleanup_queues[apic_id] = list_create_queue_with_heap(heap);
+    task_scheduler_t* scheduler = task_scheduler_create(heap);
 
-    if(task_queues[apic_id] == NULL || task_cleanup_queues[apic_id] == NULL) {
+    if(task_queues[apic_id] == NULL || task_cleanup_queues[apic_id] == NULL || scheduler == NULL) {
         list_destroy(task_queues[apic_id]);
         list_destroy(task_cleanup_queues[apic_id]);
+
+        if(scheduler) {
+            task_sleep_queue_destroy(scheduler->sleep_queue);
+            memory_free_ext(scheduler->heap, scheduler);
+        }
+
         PRINTLOG(TASKING, LOG_FATAL, "cannot create task queue for apic id %d", apic_id);
 
         return -1;
@@ -308,6 +419,8 @@ int8_t task_set_current_and_idle_task(void* entry_point, uint64_t stack_base, ui
 
     cpu_state->task_queue = task_queues[apic_id];
     cpu_state->task_cleanup_queue = task_cleanup_queues[apic_id];
+    cpu_state->task_scheduler = scheduler;
+    task_schedulers[apic_id] = scheduler;
 
     task_t* current_task = memory_malloc_ext(heap, sizeof(task_t), 0x0);
 
@@ -487,7 +600,21 @@ static void task_cleanup_task(task_t* task) {
 
     map_delete(task_map, (void*)task->task_id);
 
-    if(task->heap != memory_get_default_heap()) {
+    if(task_schedulers[task->cpu_id] && task_schedulers[task->cpu_id]->task_count) {
+        task_schedulers[task->cpu_id]->task_count--;
+    }
+
+    boolean_t has_heap = task->heap != memory_get_default_heap();
+
+    // tasks sharing default heap have no heap frames, their buffers are freed one by one
+    if(task->shares_default_heap) {
+        buffer_destroy(task->input_buffer);
+        buffer_destroy(task->output_buffer);
+        buffer_destroy(task->error_buffer);
+    }
+
+    // kernel and idle tasks also use default heap but they are not created here, their stacks are not ours
+    if(has_heap || task->shares_default_heap) {
         uint64_t stack_va = (uint64_t)task->stack;
         uint64_t stack_fa = MEMORY_PAGING_GET_FA_FOR_RESERVED_VA(stack_va);
 
@@ -509,7 +636,9 @@ static void task_cleanup_task(task_t* task) {
 
             cpu_hlt();
         }
+    }
 
+    if(has_heap) {
         uint64_t heap_va = (uint64_t)task->heap;
         uint64_t heap_fa = MEMORY_PAGING_GET_FA_FOR_RESERVED_VA(heap_va);
 
@@ -531,7 +660,7 @@ static void task_cleanup_task(task_t* task) {
         }
 
         if(frame_get_allocator()->release_frame(frame_get_allocator(), &heap_frames) != 0) {
-            PRINTLOG(TASKING, LOG_ERROR, "cannot release heap with frames at 0x%llx with count 0x%llx", stack_fa, heap_frames_cnt);
+            PRINTLOG(TASKING, LOG_ERROR, "cannot release heap with frames at 0x%llx with count 0x%llx", heap_fa, heap_frames_cnt);
 
             cpu_hlt();
         }
@@ -598,58 +727,189 @@ boolean_t task_idle_check_need_yield(void) {
 }
 #endif
 
-task_t* task_find_next_task(void) {
-    task_t* tmp_task = NULL;
+static void task_scheduler_wait_list_insert(task_scheduler_t* scheduler, task_t* task) {
+    task->wait_previous = NULL;
+    task->wait_next = scheduler->wait_head;
 
-    // lock_acquire(task_find_next_task_lock);
+    if(scheduler->wait_head) {
+        scheduler->wait_head->wait_previous = task;
+    }
 
-    uint64_t found_index = -1;
+    scheduler->wait_head = task;
+    scheduler->wait_count++;
+    task->scheduler_queue = TASK_SCHEDULER_QUEUE_WAIT;
+}
 
-    for(uint64_t i = 0; i < list_size(cpu_state->task_queue); i++) {
-        task_t* t = (task_t*)list_get_data_at_position(cpu_state->task_queue, i);
+static void task_scheduler_wait_list_remove(task_scheduler_t* scheduler, task_t* task) {
+    if(task->wait_previous) {
+        task->wait_previous->wait_next = task->wait_next;
+    } else {
+        scheduler->wait_head = task->wait_next;
+    }
 
-        if(t->state == TASK_STATE_ENDED) {
-            found_index = i;
-            break; // trick to remove ended task from queue
-        }
+    if(task->wait_next) {
+        task->wait_next->wait_previous = task->wait_previous;
+    }
 
-        if(t->wait_for_future) {
-            continue;
-        } else if(t->sleeping) {
-            if(t->wake_tick < time_timer_get_tick_count()) {
-                t->sleeping = false;
-                found_index = i;
-                break;
-            }
-        } else if(t->message_waiting) {
-            if(t->interruptible) {
-                if(t->interrupt_received) {
-                    t->interrupt_received = false;
-                    t->message_waiting = false;
-                    found_index = i;
-                    break;
-                }
+    task->wait_next = NULL;
+    task->wait_previous = NULL;
+    scheduler->wait_count--;
+    task->scheduler_queue = TASK_SCHEDULER_QUEUE_NONE;
+}
+
+/**
+ * @brief checks message waiting task can continue, clears waiting flags when it can
+ * @param[in] task message waiting task
+ * @return true if task does not wait anymore
+ */
+static boolean_t task_scheduler_check_message_waiting(task_t* task) {
+    if(!task->message_waiting) {
+        return true;
+    }
+
+    if(task->interruptible && task->interrupt_received) {
+        task->interrupt_received = false;
+        task->message_waiting = false;
+
+        return true;
+    }
+
+    if(task->message_queues) {
+        for(uint64_t q_idx = 0; q_idx < list_size(task->message_queues); q_idx++) {
+            list_t* q = (list_t*)list_get_data_at_position(task->message_queues, q_idx);
+
+            if(list_size(q)) {
+                task->message_waiting = false;
+
+                return true;
             }
+        }
+    }
 
-            if(t->message_queues) {
-                for(uint64_t q_idx = 0; q_idx < list_size(t->message_queues); q_idx++) {
-                    list_t* q = (list_t*)list_get_data_at_position(t->message_queues, q_idx);
+    return false;
+}
 
-                    if(list_size(q)) {
-                        t->message_waiting = false;
-                        found_index = i;
-                        break;
-                    }
+/**
+ * @brief places a task which is not at any queue into ready queue, sleep queue or wait list of current cpu
+ * @param[in] scheduler scheduler of current cpu
+ * @param[in] task task to place
+ */
+static void task_scheduler_enqueue(task_scheduler_t* scheduler, task_t* task) {
+    if(task->state != TASK_STATE_ENDED) {
+        if(task->wait_for_future) {
+            task_scheduler_wait_list_insert(scheduler, task);
+
+            return;
+        }
+
+        if(task->sleeping) {
+            if(task->wake_tick >= time_timer_get_tick_count()) {
+                if(task_sleep_queue_push(scheduler->sleep_queue, task, task->wake_tick)) {
+                    task->scheduler_queue = TASK_SCHEDULER_QUEUE_SLEEP;
+
+                    return;
                 }
+
+                // wait list poll also checks wake tick
+                task_scheduler_wait_list_insert(scheduler, task);
+
+                return;
             }
-        } else {
-            found_index = i;
-            break;
+
+            task->sleeping = false;
         }
+
+        if(!task_scheduler_check_message_waiting(task)) {
+            task_scheduler_wait_list_insert(scheduler, task);
+
+            return;
+        }
+    }
+
+    // ended tasks also go to ready queue, task_find_next_task moves them to cleanup queue
+    task->scheduler_queue = TASK_SCHEDULER_QUEUE_READY;
+    list_queue_push(cpu_state->task_queue, task);
+}
+
+/**
+ * @brief places tasks of wake inbox, new tasks and woken waiting tasks are rechecked
+ * @param[in] scheduler scheduler of current cpu
+ */
+static void task_scheduler_drain_wake_inbox(task_scheduler_t* scheduler) {
+    if(scheduler->wake_inbox == NULL) {
+        return;
+    }
+
+    task_t* task = task_scheduler_xchg(&scheduler->wake_inbox, NULL);
+
+    while(task) {
+        task_t* next = task->wake_next;
+
+        task->wake_next = NULL;
+        task->wake_pending = 0;
+
+        if(task->scheduler_queue == TASK_SCHEDULER_QUEUE_WAIT) {
+            task_scheduler_wait_list_remove(scheduler, task);
+            task_scheduler_enqueue(scheduler, task);
+        } else if(task->scheduler_queue == TASK_SCHEDULER_QUEUE_NEW) {
+            task->scheduler_queue = TASK_SCHEDULER_QUEUE_NONE;
+            task_scheduler_enqueue(scheduler, task);
+        } else if(task->scheduler_queue == TASK_SCHEDULER_QUEUE_SLEEP && task->state == TASK_STATE_ENDED) {
+            // killed sleeping task is cleaned now instead of at its wake tick
+            task_sleep_queue_remove(scheduler->sleep_queue, task);
+            task->scheduler_queue = TASK_SCHEDULER_QUEUE_NONE;
+            task_scheduler_enqueue(scheduler, task);
+        }
+
+        task = next;
     }
+}
 
-    if(found_index != -1ULL) {
-        tmp_task = (task_t*)list_delete_at_position(cpu_state->task_queue, found_index);
+/**
+ * @brief polls waiting tasks for message queues which are filled without explicit wake up
+ * @param[in] scheduler scheduler of current cpu
+ */
+static void task_scheduler_poll_wait_list(task_scheduler_t* scheduler) {
+    uint64_t tick = time_timer_get_tick_count();
+    task_t* task = scheduler->wait_head;
+
+    while(task) {
+        task_t* next = task->wait_next;
+
+        if(task->state == TASK_STATE_ENDED ||
+           (!task->wait_for_future && task->sleeping && task->wake_tick < tick) ||
+           (!task->wait_for_future && !task->sleeping && task_scheduler_check_message_waiting(task))) {
+            task_scheduler_wait_list_remove(scheduler, task);
+            task_scheduler_enqueue(scheduler, task);
+        }
+
+        task = next;
+    }
+}
+
+task_t* task_find_next_task(void) {
+    task_t* tmp_task = NULL;
+    task_scheduler_t* scheduler = cpu_state->task_scheduler;
+    uint64_t tick = time_timer_get_tick_count();
+
+    task_scheduler_drain_wake_inbox(scheduler);
+
+    while(task_sleep_queue_peek_wake_tick(scheduler->sleep_queue) < tick) {
+        task_t* t = task_sleep_queue_pop(scheduler->sleep_queue);
+        t->scheduler_queue = TASK_SCHEDULER_QUEUE_NONE;
+        t->sleeping = false;
+        task_scheduler_enqueue(scheduler, t);
+    }
+
+    // message queues do not wake their tasks, so poll them once per tick or when there is nothing to run
+    if(scheduler->wait_head && (scheduler->last_poll_tick != tick || list_size(cpu_state->task_queue) == 0)) {
+        scheduler->last_poll_tick = tick;
+        task_scheduler_poll_wait_list(scheduler);
+    }
+
+    if(list_size(cpu_state->task_queue)) {
+        tmp_task = (task_t*)list_queue_pop(cpu_state->task_queue);
+        tmp_task->scheduler_queue = TASK_SCHEDULER_QUEUE_NONE;
 
         // need check it is ended?
         if(tmp_task->state == TASK_STATE_ENDED) {
@@ -666,9 +926,6 @@ task_t* task_find_next_task(void) {
         tmp_task = (task_t*)cpu_state->idle_task;
     }
 
-    // lock_release(task_find_next_task_lock);
-
-
     // PRINTLOG(TASKING, LOG_WARNING, "task 0x%llx selected for execution. queue size %lli", tmp_task->task_id, list_size(task_queue));
 
     return tmp_task;
@@ -719,6 +976,8 @@ __attribute__((no_stack_protector)) void task_switch_task(void) {
 
     task_save_registers(current_task->registers);
 
+    memory_page_table_context_t* prev_page_table = current_task->page_table;
+
     switch(current_task->state) {
     case TASK_STATE_CREATED:
     case TASK_STATE_ENDED:
@@ -729,7 +988,7 @@ __attribute__((no_stack_protector)) void task_switch_task(void) {
     }
 
     if(current_task != cpu_state->idle_task) {
-        list_queue_push(cpu_state->task_queue, current_task);
+        task_scheduler_enqueue(cpu_state->task_scheduler, current_task);
     }
 
     if(current_task == cpu_state->idle_task && list_size(cpu_state->task_cleanup_queue) > 0) {
@@ -763,6 +1022,20 @@ __attribute__((no_stack_protector)) void task_switch_task(void) {
         vmx_write(VMX_HOST_GS_BASE, cpu_read_gs_base());
     }
 
+    // shootdowns of left table mark this cpu for flushing at next load instead of interrupting it
+    if(prev_page_table && prev_page_table != current_task->page_table) {
+        memory_paging_leave_table_for_cpu(prev_page_table, cpu_state->local_apic_id);
+    }
+
+    if(current_task->page_table) {
+        uint64_t table_fa = MEMORY_PAGING_GET_FA_FOR_RESERVED_VA((uint64_t)current_task->page_table->page_table);
+
+        // tag cr3 with pcid of table, so loading it does not flush whole tlb
+        if((current_task->registers->cr3 & ~(0xFFFULL | MEMORY_PAGING_CR3_NO_FLUSH)) == table_fa) {
+            current_task->registers->cr3 = memory_paging_get_cr3_for_cpu(current_task->page_table, cpu_state->local_apic_id);
+        }
+    }
+
     task_load_registers(current_task->registers);
 
     task_switch_task_exit_prep();
@@ -834,9 +1107,12 @@ void task_kill_task(uint64_t task_id, boolean_t force) {
     task->message_waiting = false;
     task->interruptible = false;
     task->wait_for_future = false;
+    task->sleeping = false;
 
     task->state = TASK_STATE_ENDED;
 
+    // owner cpu takes task out of its wait list or sleep queue
+    task_scheduler_wake(task);
 
     PRINTLOG(TASKING, LOG_INFO, "task 0x%llx will be ended", task->task_id);
 }
@@ -878,7 +1154,7 @@ void task_set_message_waiting(void){
     }
 }
 
-uint64_t task_create_task(memory_heap_t* heap, uint64_t heap_size, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name) {
+static uint64_t task_create_task_internal(memory_heap_t* heap, uint64_t heap_size, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name, boolean_t share_default_heap) {
 
     task_t* new_task = memory_malloc_ext(heap, sizeof(task_t), 0x0);
 
@@ -909,11 +1185,11 @@ uint64_t task_create_task(memory_heap_t* heap, uint64_t heap_size, uint64_t stac
         return -1;
     }
 
-    frame_t* heap_frames;
-    uint64_t heap_frames_cnt = (heap_size + FRAME_SIZE - 1) / FRAME_SIZE;
+    frame_t* heap_frames = NULL;
+    uint64_t heap_frames_cnt = share_default_heap ? 0 : (heap_size + FRAME_SIZE - 1) / FRAME_SIZE;
     heap_size = heap_frames_cnt * FRAME_SIZE;
 
-    if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), heap_frames_cnt, FRAME_ALLOCATION_TYPE_USED | FRAME_ALLOCATION_TYPE_BLOCK, &heap_frames, NULL) != 0) {
+    if(!share_default_heap && frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), heap_frames_cnt, FRAME_ALLOCATION_TYPE_USED | FRAME_ALLOCATION_TYPE_BLOCK, &heap_frames, NULL) != 0) {
         PRINTLOG(TASKING, LOG_ERROR, "cannot allocate heap with frame count 0x%llx", heap_frames_cnt);
 
         if(frame_get_allocator()->release_frame(frame_get_allocator(), stack_frames) != 0) {
@@ -938,20 +1214,23 @@ uint64_t task_create_task(memory_heap_t* heap, uint64_t heap_size, uint64_t stac
 
     memory_memclean((void*)stack_va, stack_size);
 
-    uint64_t heap_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(heap_frames->frame_address);
+    // task sharing default heap has no heap frames, so its allocations can outlive it
+    memory_heap_t* task_heap = memory_get_default_heap();
 
-    if(memory_paging_add_va_for_frame(heap_va, heap_frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC) != 0) {
-        PRINTLOG(TASKING, LOG_ERROR, "cannot add heap va 0x%llx for frame at 0x%llx with count 0x%llx", heap_va, heap_frames->frame_address, heap_frames->frame_count);
+    if(!share_default_heap) {
+        uint64_t heap_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(heap_frames->frame_address);
 
-        cpu_hlt();
-    }
+        if(memory_paging_add_va_for_frame(heap_va, heap_frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC) != 0) {
+            PRINTLOG(TASKING, LOG_ERROR, "cannot add heap va 0x%llx for frame at 0x%llx with count 0x%llx", heap_va, heap_frames->frame_address, heap_frames->frame_count);
 
-    memory_heap_t* task_heap = NULL;
+            cpu_hlt();
+        }
 
-    if(heap_size > (16 << 20)) {
-        task_heap = memory_create_heap_hash(heap_va, heap_va + heap_size);
-    } else {
-        task_heap = memory_create_heap_simple(heap_va, heap_va + heap_size);
+        if(heap_size > (16 << 20)) {
+            task_heap = memory_create_heap_hash(heap_va, heap_va + heap_size);
+        } else {
+            task_heap = memory_create_heap_simple(heap_va, heap_va + heap_size);
+        }
     }
 
 
@@ -959,10 +1238,13 @@ uint64_t task_create_task(memory_heap_t* heap, uint64_t heap_size, uint64_t stac
     uint64_t new_task_id = task_next_task_id++;
     lock_release(task_next_task_id_lock);
 
-    task_heap->task_id = new_task_id;
+    if(!share_default_heap) {
+        task_heap->task_id = new_task_id;
+    }
 
     new_task->heap = task_heap;
     new_task->heap_size = heap_size;
+    new_task->shares_default_heap = share_default_heap;
     new_task->task_id = new_task_id;
     new_task->state = TASK_STATE_CREATED;
     new_task->entry_point = entry_point;
@@ -1007,30 +1289,41 @@ uint64_t task_create_task(memory_heap_t* heap, uint64_t heap_size, uint64_t stac
              new_task->task_name, new_task->task_id, new_task, registers->rsp, registers->rbp, new_task->heap, new_task->heap_size);
 
     uint64_t cpu_count = apic_get_ap_count() + 1;
-    size_t min_queue_size = -1;
-    list_t* min_queue = NULL;
+    uint64_t min_task_count = -1;
+
+    lock_acquire(task_find_next_task_lock);
 
     for(uint64_t i = 0; i < cpu_count; i++) {
-        list_t* queue = task_queues[i];
+        task_scheduler_t* scheduler = task_schedulers[i];
 
-        if(list_size(queue) < min_queue_size) {
-            min_queue_size = list_size(queue);
-            min_queue = queue;
+        if(scheduler && scheduler->task_count < min_task_count) {
+            min_task_count = scheduler->task_count;
             new_task->cpu_id = i;
         }
     }
 
-    lock_acquire(task_find_next_task_lock);
-    list_stack_push(min_queue, new_task);
+    task_schedulers[new_task->cpu_id]->task_count++;
+    new_task->scheduler_queue = TASK_SCHEDULER_QUEUE_NEW;
     map_insert(task_map, (void*)new_task->task_id, new_task);
     lock_release(task_find_next_task_lock);
 
+    // owner cpu places the task into its ready queue at next task switch
+    task_scheduler_wake(new_task);
+
 
     PRINTLOG(TASKING, LOG_INFO, "task %s 0x%llx added to task queue on cpu 0x%llx", new_task->task_name, new_task->task_id, new_task->cpu_id);
 
     return new_task->task_id;
 }
 
+uint64_t task_create_task(memory_heap_t* heap, uint64_t heap_size, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name) {
+    return task_create_task_internal(heap, heap_size, stack_size, entry_point, args_cnt, args, task_name, false);
+}
+
+uint64_t task_create_task_with_default_heap(memory_heap_t* heap, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name) {
+    return task_create_task_internal(heap, 0, stack_size, entry_point, args_cnt, args, task_name, true);
+}
+
 void task_idle_task(void) {
     while(true) {
         asm volatile ("sti\nhlt\n");
@@ -1174,6 +1467,7 @@ void task_clear_message_waiting(uint64_t tid) {
 
     if(task) {
         task->message_waiting = false;
+        task_scheduler_wake(task);
     } else {
         PRINTLOG(TASKING, LOG_ERROR, "task not found 0x%llx", tid);
     }
@@ -1184,6 +1478,7 @@ void task_set_interrupt_received(uint64_t tid) {
 
     if(task) {
         task->interrupt_received = true;
+        task_scheduler_wake(task);
     } else {
         PRINTLOG(TASKING, LOG_ERROR, "task not found 0x%llx", tid);
     }
@@ -1407,6 +1702,10 @@ void task_toggle_wait_for_future(uint64_t tid) {
         video_text_print("\n");
 
         task->wait_for_future = !task->wait_for_future;
+
+        if(!task->wait_for_future) {
+            task_scheduler_wake(task);
+        }
     }
 }
 
@@ -0,0 +1,204 @@
+/**
+ * @file task_sleep_queue.64.c
+ * @brief sleep queue of scheduler
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <cpu/task_sleep_queue.h>
+
+MODULE("turnstone.kernel.cpu.task");
+
+/**
+ * @struct task_sleep_queue_entry_t
+ * @brief sleeping task with its wake tick, tick is kept at entry so sifting does not touch tasks
+ */
+typedef struct task_sleep_queue_entry_t {
+    uint64_t wake_tick; ///< tick when task wakes up
+    void*    task; ///< sleeping task
+} task_sleep_queue_entry_t; ///< short hand for struct
+
+/**
+ * @struct task_sleep_queue_t
+ * @brief min heap of sleeping tasks
+ */
+struct task_sleep_queue_t {
+    memory_heap_t*            heap; ///< heap of queue
+    task_sleep_queue_entry_t* entries; ///< heap ordered entries
+    uint64_t                  size; ///< entry count
+    uint64_t                  capacity; ///< entry capacity
+}; ///< sleep queue
+
+static void task_sleep_queue_sift_up(task_sleep_queue_t* queue, uint64_t idx) {
+    task_sleep_queue_entry_t* entries = queue->entries;
+    task_sleep_queue_entry_t entry = entries[idx];
+
+    while(idx) {
+        uint64_t parent = (idx - 1) / 2;
+
+        if(entries[parent].wake_tick <= entry.wake_tick) {
+            break;
+        }
+
+        entries[idx] = entries[parent];
+        idx = parent;
+    }
+
+    entries[idx] = entry;
+}
+
+static void task_sleep_queue_sift_down(task_sleep_queue_t* queue, uint64_t idx) {
+    task_sleep_queue_entry_t* entries = queue->entries;
+    task_sleep_queue_entry_t entry = entries[idx];
+    uint64_t size = queue->size;
+
+    while(true) {
+        uint64_t child = idx * 2 + 1;
+
+        if(child >= size) {
+            break;
+        }
+
+        if(child + 1 < size && entries[child + 1].wake_tick < entries[child].wake_tick) {
+            child++;
+        }
+
+        if(entry.wake_tick <= entries[child].wake_tick) {
+            break;
+        }
+
+        entries[idx] = entries[child];
+        idx = child;
+    }
+
+    entries[idx] = entry;
+}
+
+/**
+ * @brief removes entry at index, last entry fills its place and moves to its position
+ * @param[in] queue sleep queue
+ * @param[in] idx index of entry
+ * @return task of removed entry
+ */
+static void* task_sleep_queue_remove_at(task_sleep_queue_t* queue, uint64_t idx) {
+    void* task = queue->entries[idx].task;
+
+    queue->size--;
+
+    if(idx == queue->size) {
+        return task;
+    }
+
+    queue->entries[idx] = queue->entries[queue->size];
+
+    // last entry can be earlier than parent of removed one when it comes from another subtree
+    task_sleep_queue_sift_down(queue, idx);
+    task_sleep_queue_sift_up(queue, idx);
+
+    return task;
+}
+
+task_sleep_queue_t* task_sleep_queue_create(memory_heap_t* heap, uint64_t capacity) {
+    if(!capacity) {
+        capacity = 1;
+    }
+
+    task_sleep_queue_t* queue = memory_malloc_ext(heap, sizeof(task_sleep_queue_t), 0x0);
+
+    if(queue == NULL) {
+        return NULL;
+    }
+
+    queue->entries = memory_malloc_ext(heap, sizeof(task_sleep_queue_entry_t) * capacity, 0x0);
+
+    if(queue->entries == NULL) {
+        memory_free_ext(heap, queue);
+
+        return NULL;
+    }
+
+    queue->heap = heap;
+    queue->capacity = capacity;
+
+    return queue;
+}
+
+void task_sleep_queue_destroy(task_sleep_queue_t* queue) {
+    if(queue == NULL) {
+        return;
+    }
+
+    memory_free_ext(queue->heap, queue->entries);
+    memory_free_ext(queue->heap, queue);
+}
+
+uint64_t task_sleep_queue_size(const task_sleep_queue_t* queue) {
+    if(queue == NULL) {
+        return 0;
+    }
+
+    return queue->size;
+}
+
+boolean_t task_sleep_queue_push(task_sleep_queue_t* queue, void* task, uint64_t wake_tick) {
+    if(queue == NULL || task == NULL) {
+        return false;
+    }
+
+    if(queue->size == queue->capacity) {
+        uint64_t new_capacity = queue->capacity * 2;
+        task_sleep_queue_entry_t* new_entries = memory_malloc_ext(queue->heap, sizeof(task_sleep_queue_entry_t) * new_capacity, 0x0);
+
+        if(new_entries == NULL) {
+            return false;
+        }
+
+        memory_memcopy(queue->entries, new_entries, sizeof(task_sleep_queue_entry_t) * queue->size);
+        memory_free_ext(queue->heap, queue->entries);
+
+        queue->entries = new_entries;
+        queue->capacity = new_capacity;
+    }
+
+    uint64_t idx = queue->size++;
+
+    queue->entries[idx].wake_tick = wake_tick;
+    queue->entries[idx].task = task;
+
+    task_sleep_queue_sift_up(queue, idx);
+
+    return true;
+}
+
+uint64_t task_sleep_queue_peek_wake_tick(const task_sleep_queue_t* queue) {
+    if(queue == NULL || !queue->size) {
+        return -1ULL;
+    }
+
+    return queue->entries[0].wake_tick;
+}
+
+void* task_sleep_queue_pop(task_sleep_queue_t* queue) {
+    if(queue == NULL || !queue->size) {
+        return NULL;
+    }
+
+    return task_sleep_queue_remove_at(queue, 0);
+}
+
+boolean_t task_sleep_queue_remove(task_sleep_queue_t* queue, const void* task) {
+    if(queue == NULL || task == NULL) {
+        return false;
+    }
+
+    for(uint64_t i = 0; i < queue->size; i++) {
+        if(queue->entries[i].task == task) {
+            task_sleep_queue_remove_at(queue, i);
+
+            return true;
+        }
+    }
+
+    return false;
+}
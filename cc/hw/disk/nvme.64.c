@@ -16,6 +16,7 @@
 #include <apic.h>
 #include <hashmap.h>
 #include <cpu/task.h>
+#include <cpu.h>
 #include <utils.h>
 
 
@@ -24,7 +25,7 @@ MODULE("turnstone.kernel.hw.drivers");
 void video_text_print(const char* str);
 
 hashmap_t* nvme_disks = NULL;
-hashmap_t* nvme_disk_isr_map = NULL;
+hashmap_t* nvme_disk_isr_map = NULL; ///< isr number to \ref nvme_io_queue_t map
 
 int8_t    nvme_isr(interrupt_frame_ext_t* frame);
 int8_t    nvme_format(nvme_disk_t* nvme_disk);
@@ -59,64 +60,284 @@ const nvme_disk_t* nvme_get_disk_by_id(uint64_t disk_id) {
     return hashmap_get(nvme_disks, (void*)disk_id);
 }
 
+/**
+ * @brief locks io queue, caller disables interrupts because isr of queue takes same lock
+ * @param[in] io_queue io queue
+ */
+static inline void nvme_io_queue_lock(nvme_io_queue_t* io_queue) {
+    while(true) {
+        int8_t locked = 0;
+
+        asm volatile ("lock btsq $0, %[value]\n" : "=@ccc" (locked), [value] "+m" (io_queue->lock_value) : : "memory");
+
+        if(!locked) {
+            return;
+        }
+
+        asm volatile ("pause" ::: "memory");
+    }
+}
+
+/**
+ * @brief unlocks io queue
+ * @param[in] io_queue io queue
+ */
+static inline void nvme_io_queue_unlock(nvme_io_queue_t* io_queue) {
+    asm volatile ("" ::: "memory");
+    io_queue->lock_value = 0;
+}
+
+/**
+ * @brief returns io queue of current cpu
+ * @param[in] nvme_disk nvme disk
+ * @return io queue
+ */
+static inline nvme_io_queue_t* nvme_io_queue_of_cpu(nvme_disk_t* nvme_disk) {
+    return &nvme_disk->io_queues[apic_get_local_apic_id() % nvme_disk->io_queue_count];
+}
+
+/**
+ * @brief takes a free command id of io queue
+ * @param[in] io_queue io queue
+ * @param[out] cid command id, also index of command slot and prp list frame
+ * @return false if all command ids are in use
+ */
+static boolean_t nvme_io_queue_reserve_cid(nvme_io_queue_t* io_queue, uint16_t* cid) {
+    boolean_t int_disabled = cpu_cli();
+    nvme_io_queue_lock(io_queue);
+
+    boolean_t res = io_queue->free_cid_count != 0;
+
+    if(res) {
+        *cid = io_queue->free_cids[--io_queue->free_cid_count];
+    }
+
+    nvme_io_queue_unlock(io_queue);
+
+    if(!int_disabled) {
+        cpu_sti();
+    }
+
+    return res;
+}
+
+/**
+ * @brief gives back command id which is reserved but not submitted
+ * @param[in] io_queue io queue
+ * @param[in] cid command id
+ */
+static void nvme_io_queue_release_cid(nvme_io_queue_t* io_queue, uint16_t cid) {
+    boolean_t int_disabled = cpu_cli();
+    nvme_io_queue_lock(io_queue);
+
+    io_queue->free_cids[io_queue->free_cid_count++] = cid;
+
+    nvme_io_queue_unlock(io_queue);
+
+    if(!int_disabled) {
+        cpu_sti();
+    }
+}
+
+/**
+ * @brief copies command to submission queue tail and rings doorbell
+ * @param[in] io_queue io queue
+ * @param[in] cmd command with reserved cid
+ * @param[in] lock future lock released when command completes
+ */
+static void nvme_io_queue_submit(nvme_io_queue_t* io_queue, const nvme_submission_queue_entry_t* cmd, lock_t* lock) {
+    boolean_t int_disabled = cpu_cli();
+    nvme_io_queue_lock(io_queue);
+
+    io_queue->command_locks[cmd->cid] = lock;
+    io_queue->submission_queue[io_queue->s_queue_tail] = *cmd;
+
+    io_queue->s_queue_tail = (io_queue->s_queue_tail + 1) % io_queue->nvme_disk->io_queue_size;
+    *io_queue->submission_queue_tail_doorbell = io_queue->s_queue_tail;
+
+    nvme_io_queue_unlock(io_queue);
+
+    if(!int_disabled) {
+        cpu_sti();
+    }
+}
+
 int8_t nvme_isr(interrupt_frame_ext_t* frame) {
     uint8_t intnum = frame->interrupt_number;
     intnum -= 0x20;
 
-    nvme_disk_t* nvme_disk = (nvme_disk_t*)hashmap_get(nvme_disk_isr_map, (void*)(uint64_t)intnum);
+    nvme_io_queue_t* io_queue = (nvme_io_queue_t*)hashmap_get(nvme_disk_isr_map, (void*)(uint64_t)intnum);
 
-    if(nvme_disk == NULL) {
+    if(io_queue == NULL) {
         video_text_print("nvme disk not found\n");
         apic_eoi();
 
         return 0;
     }
 
-    // uint32_t status_code = nvme_disk->io_completion_queue[nvme_disk->io_c_queue_head].status_code;
-    // uint32_t status_type = nvme_disk->io_completion_queue[nvme_disk->io_c_queue_head].status_type;
-    // uint32_t sqhd = nvme_disk->io_completion_queue[nvme_disk->io_c_queue_head].sqhd;
-    // uint32_t sqid = nvme_disk->io_completion_queue[nvme_disk->io_c_queue_head].sqid;
+    uint64_t queue_size = io_queue->nvme_disk->io_queue_size;
+
+    nvme_io_queue_lock(io_queue);
 
-    while(nvme_disk->io_s_queue_tail != nvme_disk->io_c_queue_head) {
-        uint32_t cid = nvme_disk->io_completion_queue[nvme_disk->io_c_queue_head].cid;
-        uint32_t status_code = nvme_disk->io_completion_queue[nvme_disk->io_c_queue_head].status_code;
-        boolean_t phase = nvme_disk->io_completion_queue[nvme_disk->io_c_queue_head].p;
+    // completion entries with current phase are new, doorbell is written once for whole batch
+    while(io_queue->completion_queue[io_queue->c_queue_head].p == io_queue->current_phase) {
+        uint16_t cid = io_queue->completion_queue[io_queue->c_queue_head].cid;
+        uint32_t status_code = io_queue->completion_queue[io_queue->c_queue_head].status_code;
 
         if(status_code != 0) {
             video_text_print("!");
         }
 
-        if(nvme_disk->current_phase != phase) {
-            video_text_print("-");
-        } else {
-            lock_t* lock = (lock_t*)hashmap_get(nvme_disk->command_lock_map, (void*)(uint64_t)cid);
-            hashmap_delete(nvme_disk->command_lock_map, (void*)(uint64_t)cid);
+        lock_t* lock = cid < queue_size ? io_queue->command_locks[cid] : NULL;
 
-            if(lock == NULL) {
-                video_text_print("nvme lock not found cid: ");
-                video_int_print(cid);
-                video_text_print("\n");
-            }
+        if(lock == NULL) {
+            video_text_print("nvme lock not found cid: ");
+            video_int_print(cid);
+            video_text_print("\n");
+        } else {
+            io_queue->command_locks[cid] = NULL;
+            io_queue->free_cids[io_queue->free_cid_count++] = cid;
 
             lock_release(lock);
+        }
 
-            nvme_disk->active_command_count--;
-
-            nvme_disk->io_c_queue_head = (nvme_disk->io_c_queue_head + 1) % nvme_disk->io_queue_size;
-
-            *nvme_disk->io_completion_queue_head_doorbell = nvme_disk->io_c_queue_head;
+        io_queue->c_queue_head = (io_queue->c_queue_head + 1) % queue_size;
 
-            if(nvme_disk->io_c_queue_head == 0) {
-                nvme_disk->current_phase = !nvme_disk->current_phase;
-            }
+        if(io_queue->c_queue_head == 0) {
+            io_queue->current_phase = !io_queue->current_phase;
         }
     }
 
-    pci_msix_clear_pending_bit(nvme_disk->pci_device, nvme_disk->msix_capability, 1);
+    *io_queue->completion_queue_head_doorbell = io_queue->c_queue_head;
+
+    nvme_io_queue_unlock(io_queue);
+
+    pci_msix_clear_pending_bit(io_queue->nvme_disk->pci_device, io_queue->nvme_disk->msix_capability, io_queue->msix_vector);
     apic_eoi();
     return 0;
 }
 
+/**
+ * @brief creates io completion and submission queue pair with given id, completions interrupt given cpu
+ * @param[in] nvme_disk nvme disk
+ * @param[in] queue_id queue id, also msix vector of completion queue
+ * @param[in] apic_id local apic id of cpu which handles completions
+ * @return 0 on success, -1 on failure
+ */
+static int8_t nvme_create_io_queue(nvme_disk_t* nvme_disk, uint16_t queue_id, uint32_t apic_id) {
+    nvme_io_queue_t* io_queue = &nvme_disk->io_queues[queue_id - 1];
+    uint64_t queue_size = nvme_disk->io_queue_size;
+
+    io_queue->command_locks = memory_malloc_ext(nvme_disk->heap, sizeof(lock_t*) * queue_size, 0);
+
+    if(io_queue->command_locks == NULL) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot allocate command slots of io queue %i", queue_id);
+
+        return -1;
+    }
+
+    io_queue->free_cids = memory_malloc_ext(nvme_disk->heap, sizeof(uint16_t) * queue_size, 0);
+
+    if(io_queue->free_cids == NULL) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot allocate free cids of io queue %i", queue_id);
+        memory_free_ext(nvme_disk->heap, io_queue->command_locks);
+
+        return -1;
+    }
+
+    for(uint64_t i = 0; i < queue_size; i++) {
+        io_queue->free_cids[i] = queue_size - 1 - i;
+    }
+
+    io_queue->free_cid_count = queue_size;
+
+    uint64_t sq_frame_count = (queue_size * sizeof(nvme_submission_queue_entry_t) + FRAME_SIZE - 1) / FRAME_SIZE;
+    uint64_t cq_frame_count = (queue_size * sizeof(nvme_completion_queue_entry_t) + FRAME_SIZE - 1) / FRAME_SIZE;
+    // each cid has its own prp list frame
+    uint64_t frame_count = sq_frame_count + cq_frame_count + queue_size;
+
+    frame_t* queue_frames = NULL;
+
+    if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), frame_count, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &queue_frames, NULL) != 0) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot allocate frame for io queue %i", queue_id);
+        memory_free_ext(nvme_disk->heap, io_queue->command_locks);
+        memory_free_ext(nvme_disk->heap, io_queue->free_cids);
+
+        return -1;
+    }
+
+    uint64_t queue_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(queue_frames->frame_address);
+    memory_paging_add_va_for_frame(queue_va, queue_frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC);
+    memory_memclean((void*)queue_va, frame_count * FRAME_SIZE);
+
+    io_queue->nvme_disk = nvme_disk;
+    io_queue->queue_id = queue_id;
+    io_queue->msix_vector = queue_id;
+    io_queue->apic_id = apic_id;
+    io_queue->current_phase = true;
+    io_queue->submission_queue_fa = queue_frames->frame_address;
+    io_queue->completion_queue_fa = io_queue->submission_queue_fa + sq_frame_count * FRAME_SIZE;
+    io_queue->prp_frame_fa = io_queue->completion_queue_fa + cq_frame_count * FRAME_SIZE;
+    io_queue->submission_queue = (nvme_submission_queue_entry_t*)queue_va;
+    io_queue->completion_queue = (nvme_completion_queue_entry_t*)(queue_va + sq_frame_count * FRAME_SIZE);
+
+    uint64_t bar_va = (uint64_t)nvme_disk->nvme_registers;
+    uint64_t dstrd = nvme_disk->nvme_registers->capabilities.fields.dstrd;
+    io_queue->submission_queue_tail_doorbell = (uint32_t*)(bar_va + 0x1000 + (2 * queue_id) * (4 << dstrd));
+    io_queue->completion_queue_head_doorbell = (uint32_t*)(bar_va + 0x1000 + (2 * queue_id + 1) * (4 << dstrd));
+
+    PRINTLOG(NVME, LOG_TRACE, "creating io cq %i for apic id %i", queue_id, apic_id);
+
+    io_queue->isr = pci_msix_set_isr_with_apic_id(nvme_disk->pci_device, nvme_disk->msix_capability, io_queue->msix_vector, apic_id, nvme_isr);
+    hashmap_put(nvme_disk_isr_map, (void*)io_queue->isr, io_queue);
+
+    if(nvme_send_admin_command(nvme_disk,
+                               NVME_ADMIN_CMD_CREATE_CQ, // opcode
+                               0x0, // fuse
+                               0x0, // nsid
+                               0x0, // mptr
+                               io_queue->completion_queue_fa, // prp1
+                               0x0, // prp2
+                               ((queue_size - 1) << 16) | queue_id, // cdw10
+                               (io_queue->msix_vector << 16) | (1 << 1) | 1, // cdw11
+                               0x0, // cdw12
+                               0x0, // cdw13
+                               0x0, // cdw14
+                               0x0, // cdw15
+                               0x0 // sdw0
+                               ) != 0) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot create io cq %i", queue_id);
+
+        return -1;
+    }
+
+    pci_msix_clear_pending_bit(nvme_disk->pci_device, nvme_disk->msix_capability, io_queue->msix_vector);
+
+    PRINTLOG(NVME, LOG_TRACE, "creating io sq %i", queue_id);
+
+    if(nvme_send_admin_command(nvme_disk,
+                               NVME_ADMIN_CMD_CREATE_SQ, // opcode
+                               0x0, // fuse
+                               0x0, // nsid
+                               0x0, // mptr
+                               io_queue->submission_queue_fa, // prp1
+                               0x0, // prp2
+                               ((queue_size - 1) << 16) | queue_id, // cdw10
+                               (queue_id << 16) | 1, // cdw11
+                               0x0, // cdw12
+                               0x0, // cdw13
+                               0x0, // cdw14
+                               0x0, // cdw15
+                               0x0 // sdw0
+                               ) != 0) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot create io sq %i", queue_id);
+
+        return -1;
+    }
+
+    return 0;
+}
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
 int8_t nvme_init(memory_heap_t* heap, list_t* nvme_pci_devices) {
@@ -127,7 +348,7 @@ int8_t nvme_init(memory_heap_t* heap, list_t* nvme_pci_devices) {
         return 0;
     }
 
-    nvme_disks = hashmap_integer(16);
+    nvme_disks = hashmap_integer_concurrent(16);
 
     if(nvme_disks == NULL) {
         PRINTLOG(NVME, LOG_ERROR, "cannot allocate memory for nvme disks");
@@ -135,7 +356,7 @@ int8_t nvme_init(memory_heap_t* heap, list_t* nvme_pci_devices) {
         return -1;
     }
 
-    nvme_disk_isr_map = hashmap_integer(16);
+    nvme_disk_isr_map = hashmap_integer_concurrent(16);
 
     if(nvme_disk_isr_map == NULL) {
         PRINTLOG(NVME, LOG_ERROR, "cannot allocate memory for nvme disk isr map");
@@ -163,20 +384,9 @@ int8_t nvme_init(memory_heap_t* heap, list_t* nvme_pci_devices) {
             return -1;
         }
 
-        nvme_disk->command_lock_map = hashmap_integer(64);
-
-        if(nvme_disk->command_lock_map == NULL) {
-            PRINTLOG(NVME, LOG_ERROR, "cannot allocate memory for nvme command lock map");
-            memory_free_ext(heap, nvme_disk);
-            iter->destroy(iter);
-
-            return -1;
-        }
-
         nvme_disk->heap = heap;
         nvme_disk->disk_id = disk_id;
         nvme_disk->pci_device = pci_nvme;
-        nvme_disk->current_phase = true; // when nvme controller is reset, phase is 1
 
 
         pci_capability_msi_t* msi_cap = NULL;
@@ -252,7 +462,7 @@ int8_t nvme_init(memory_heap_t* heap, list_t* nvme_pci_devices) {
 
         frame_t* queue_frames = NULL;
 
-        if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), 4, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &queue_frames, NULL) != 0) {
+        if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), 2, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &queue_frames, NULL) != 0) {
             PRINTLOG(NVME, LOG_ERROR, "cannot allocate frame for queues");
             memory_free_ext(heap, nvme_disk);
 
@@ -261,12 +471,10 @@ int8_t nvme_init(memory_heap_t* heap, list_t* nvme_pci_devices) {
 
         uint64_t queue_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(queue_frames->frame_address);
         memory_paging_add_va_for_frame(queue_va, queue_frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC);
-        memory_memclean((void*)queue_va, FRAME_SIZE * 4);
+        memory_memclean((void*)queue_va, FRAME_SIZE * 2);
 
         nvme_disk->admin_submission_queue = (nvme_submission_queue_entry_t*)queue_va;
         nvme_disk->admin_completion_queue = (nvme_completion_queue_entry_t*)(queue_va + FRAME_SIZE);
-        nvme_disk->io_submission_queue = (nvme_submission_queue_entry_t*)(queue_va + FRAME_SIZE * 2);
-        nvme_disk->io_completion_queue = (nvme_completion_queue_entry_t*)(queue_va + FRAME_SIZE * 3);
 
         nvme_disk->timeout = nvme_regs->capabilities.fields.timeout + 1;
         nvme_disk->nvme_registers = nvme_regs;
@@ -286,7 +494,7 @@ int8_t nvme_init(memory_heap_t* heap, list_t* nvme_pci_devices) {
 
 
         nvme_disk->admin_queue_size = 64;
-        nvme_disk->io_queue_size = 64;
+        nvme_disk->io_queue_size = MIN(NVME_IO_QUEUE_SIZE, nvme_regs->capabilities.fields.mqes + 1ULL);
 
         PRINTLOG(NVME, LOG_TRACE, "nvme asq %llx acq %llx", queue_frames->frame_address, queue_frames->frame_address + FRAME_SIZE);
         nvme_regs->config.css = 0;
@@ -318,16 +526,11 @@ int8_t nvme_init(memory_heap_t* heap, list_t* nvme_pci_devices) {
         uint64_t dstrd = nvme_regs->capabilities.fields.dstrd;
         uint64_t admin_sqtdb = bar_va + 0x1000 + (2 * 0) * (4 << dstrd);
         uint64_t admin_cqhdb = bar_va + 0x1000 + (2 * 0 + 1) * (4 << dstrd);
-        uint64_t io_sqtdb = bar_va + 0x1000 + (2 * 1) * (4 << dstrd);
-        uint64_t io_cqhdb = bar_va + 0x1000 + (2 * 1 + 1) * (4 << dstrd);
 
         PRINTLOG(NVME, LOG_TRACE, "nvme admin sqtdb %llx cqhdb %llx", admin_sqtdb, admin_cqhdb);
-        PRINTLOG(NVME, LOG_TRACE, "nvme io sqtdb %llx cqhdb %llx", io_sqtdb, io_cqhdb);
 
         nvme_disk->admin_completion_queue_head_doorbell = (uint32_t*)admin_cqhdb;
         nvme_disk->admin_submission_queue_tail_doorbell = (uint32_t*)admin_sqtdb;
-        nvme_disk->io_completion_queue_head_doorbell = (uint32_t*)io_cqhdb;
-        nvme_disk->io_submission_queue_tail_doorbell = (uint32_t*)io_sqtdb;
 
         nvme_disk->next_cid = 1;
 
@@ -421,82 +624,47 @@ int8_t nvme_init(memory_heap_t* heap, list_t* nvme_pci_devices) {
            }
          */
 
-        if(nvme_set_queue_count(nvme_disk, 1, 1) != 0) {
+        // one queue pair per cpu, msix vector 0 stays for admin queue which is polled
+        uint64_t queue_count = MIN(apic_get_ap_count() + 1, (uint64_t)NVME_IO_QUEUE_MAX_COUNT);
+        queue_count = MIN(queue_count, (uint64_t)msix_cap->table_size);
+
+        if(queue_count == 0 || nvme_set_queue_count(nvme_disk, queue_count, queue_count) != 0) {
             PRINTLOG(NVME, LOG_ERROR, "cannot set queue count");
             memory_free_ext(heap, nvme_disk);
 
             return -1;
         }
 
-        PRINTLOG(NVME, LOG_TRACE, "creating io cq");
-
-        nvme_disk->io_queue_isr = pci_msix_set_isr(pci_nvme,  msix_cap, 1, nvme_isr);
-        hashmap_put(nvme_disk_isr_map, (void*)nvme_disk->io_queue_isr, nvme_disk);
-
-        if(nvme_send_admin_command(nvme_disk,
-                                   NVME_ADMIN_CMD_CREATE_CQ, // opcode
-                                   0x0, // fuse
-                                   0x0, // nsid
-                                   0x0, // mptr
-                                   queue_frames->frame_address + 3 * FRAME_SIZE, // prp1
-                                   0x0, // prp2
-                                   ((nvme_disk->io_queue_size - 1) << 16) | 1, // cdw10
-                                   (1 << 16) | (1 << 1) | 1, // cdw11
-                                   0x0, // cdw12
-                                   0x0, // cdw13
-                                   0x0, // cdw14
-                                   0x0, // cdw15
-                                   0x0 // sdw0
-                                   ) != 0) {
-            PRINTLOG(NVME, LOG_ERROR, "cannot create io cq");
-            memory_free_ext(heap, nvme_disk);
+        queue_count = MIN(queue_count, MIN(nvme_disk->io_sq_count, nvme_disk->io_cq_count) + 1ULL);
 
-            return -1;
-        }
+        nvme_disk->io_queues = memory_malloc_ext(heap, sizeof(nvme_io_queue_t) * queue_count, 0);
 
-        pci_msix_clear_pending_bit(pci_nvme, msix_cap, 1);
-
-        PRINTLOG(NVME, LOG_TRACE, "io cq created");
-
-        PRINTLOG(NVME, LOG_TRACE, "creating io sq");
-
-        if(nvme_send_admin_command(nvme_disk,
-                                   NVME_ADMIN_CMD_CREATE_SQ, // opcode
-                                   0x0, // fuse
-                                   0x0, // nsid
-                                   0x0, // mptr
-                                   queue_frames->frame_address + 2 * FRAME_SIZE, // prp1
-                                   0x0, // prp2
-                                   ((nvme_disk->io_queue_size - 1) << 16) | 1, // cdw10
-                                   (1 << 16) | 1, // cdw11
-                                   0x0, // cdw12
-                                   0x0, // cdw13
-                                   0x0, // cdw14
-                                   0x0, // cdw15
-                                   0x0 // sdw0
-                                   ) != 0) {
-            PRINTLOG(NVME, LOG_ERROR, "cannot create io sq");
+        if(nvme_disk->io_queues == NULL) {
+            PRINTLOG(NVME, LOG_ERROR, "cannot allocate memory for io queues");
             memory_free_ext(heap, nvme_disk);
 
             return -1;
         }
 
-        PRINTLOG(NVME, LOG_TRACE, "io sq created");
+        for(uint64_t i = 0; i < queue_count; i++) {
+            // cpus are indexed by local apic id like task queues
+            if(nvme_create_io_queue(nvme_disk, i + 1, i) != 0) {
+                // queues created so far are still usable
+                break;
+            }
 
-        frame_t* prp_frames = NULL;
+            nvme_disk->io_queue_count++;
+        }
 
-        if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), 64, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &prp_frames, NULL) != 0) {
-            PRINTLOG(NVME, LOG_ERROR, "cannot allocate frame for prp");
+        if(nvme_disk->io_queue_count == 0) {
+            PRINTLOG(NVME, LOG_ERROR, "cannot create io queues");
+            memory_free_ext(heap, nvme_disk->io_queues);
             memory_free_ext(heap, nvme_disk);
 
             return -1;
         }
 
-        nvme_disk->prp_frame_fa = prp_frames->frame_address;
-        nvme_disk->prp_frame_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(nvme_disk->prp_frame_fa);
-
-        memory_paging_add_va_for_frame(nvme_disk->prp_frame_va, prp_frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC);
-        memory_memclean((void*)nvme_disk->prp_frame_va, 64 * FRAME_SIZE);
+        PRINTLOG(NVME, LOG_DEBUG, "nvme %lli has %i io queues with depth %lli", disk_id, nvme_disk->io_queue_count, nvme_disk->io_queue_size);
 
         hashmap_put(nvme_disks, (void*)nvme_disk->disk_id, nvme_disk);
 
@@ -581,8 +749,8 @@ int8_t nvme_set_queue_count(nvme_disk_t* nvme_disk, uint16_t io_sq_count, uint16
                                          );
 
     if(res == 0) {
-        nvme_disk->io_sq_count = (result >> 16) & 0xFFFF;
-        nvme_disk->io_cq_count = result & 0xFFFF;
+        nvme_disk->io_sq_count = result & 0xFFFF;
+        nvme_disk->io_cq_count = (result >> 16) & 0xFFFF;
     }
 
     return res;
@@ -618,17 +786,45 @@ future_t* nvme_write(uint64_t disk_id, uint64_t lba, uint32_t size, uint8_t* buf
     return nvme_read_write(disk_id, lba, size, buffer, true);
 }
 
-future_t* nvme_read_write(uint64_t disk_id, uint64_t lba, uint32_t size, uint8_t* buffer, boolean_t write) {
-    nvme_disk_t* nvme_disk = (nvme_disk_t*)hashmap_get(nvme_disks, (void*)disk_id);
+/**
+ * @brief submits io command with reserved cid and returns future which is released at completion
+ * @param[in] io_queue io queue
+ * @param[in] cmd command
+ * @return future, NULL on failure
+ */
+static future_t* nvme_io_queue_submit_with_future(nvme_io_queue_t* io_queue, const nvme_submission_queue_entry_t* cmd) {
+    uint64_t tid = task_get_id();
+    lock_t* lock = lock_create_with_heap_for_future(io_queue->nvme_disk->heap, true, tid);
 
-    if(nvme_disk == NULL) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot %s: disk not found", write?"write":"read");
+    if(lock == NULL) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot create lock for command 0x%x", cmd->opc);
+        nvme_io_queue_release_cid(io_queue, cmd->cid);
 
         return NULL;
     }
 
-    if(nvme_disk->active_command_count > nvme_disk->io_queue_size - 1) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot %s: too many active commands", write?"write":"read");
+    future_t* fut = future_create_with_heap_and_data(io_queue->nvme_disk->heap, lock, NULL);
+
+    if(fut == NULL) {
+        lock_destroy(lock);
+        PRINTLOG(NVME, LOG_ERROR, "cannot create future for command 0x%x", cmd->opc);
+        nvme_io_queue_release_cid(io_queue, cmd->cid);
+
+        return NULL;
+    }
+
+    nvme_io_queue_submit(io_queue, cmd, lock);
+
+    PRINTLOG(NVME, LOG_TRACE, "command 0x%x sent with cid %x to queue %i", cmd->opc, cmd->cid, io_queue->queue_id);
+
+    return fut;
+}
+
+future_t* nvme_read_write(uint64_t disk_id, uint64_t lba, uint32_t size, uint8_t* buffer, boolean_t write) {
+    nvme_disk_t* nvme_disk = (nvme_disk_t*)hashmap_get(nvme_disks, (void*)disk_id);
+
+    if(nvme_disk == NULL) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot %s: disk not found", write?"write":"read");
 
         return NULL;
     }
@@ -640,100 +836,90 @@ future_t* nvme_read_write(uint64_t disk_id, uint64_t lba, uint32_t size, uint8_t
     }
 
     uint64_t fcnt = size / nvme_disk->lba_size;
-    uint64_t fa_cnt = fcnt / (0x1000 / nvme_disk->lba_size);
 
-    if(fcnt > 512) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot %s: size too big", write?"write":"read");
+    if(fcnt == 0 || fcnt > 512) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot %s: invalid size 0x%x", write?"write":"read", size);
 
         return NULL;
     }
 
     uint64_t buffer_va = (uint64_t)buffer;
 
-    if(buffer_va % 0x1000) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot %s: buffer not aligned to 4k", write?"write":"read");
+    // only first prp entry may have an offset and it should be dword aligned
+    if(buffer_va % 4) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot %s: buffer not aligned to dword", write?"write":"read");
 
         return NULL;
     }
 
-    uint64_t buffer_fa = 0;
+    uint64_t page_offset = buffer_va % FRAME_SIZE;
+    uint64_t page_count = (page_offset + size + FRAME_SIZE - 1) / FRAME_SIZE;
 
-    if(memory_paging_get_physical_address(buffer_va, &buffer_fa) != 0) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot %s: buffer physical address not found", write?"write":"read");
+    if(page_count - 1 > FRAME_SIZE / sizeof(uint64_t)) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot %s: buffer spans too many pages", write?"write":"read");
 
         return NULL;
     }
 
-    uint16_t cid = nvme_disk->next_cid++;
-
-    if(cid == 0) {
-        cid = nvme_disk->next_cid++;
-    }
+    uint64_t prp1 = 0;
 
-    uint64_t iosqt = nvme_disk->io_s_queue_tail;
+    if(memory_paging_get_physical_address(buffer_va, &prp1) != 0) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot %s: buffer physical address not found", write?"write":"read");
 
-    uint64_t prp1 = buffer_fa;
+        return NULL;
+    }
 
     PRINTLOG(NVME, LOG_TRACE, "prp1: %llx va %llx", prp1, buffer_va);
 
-    uint64_t prp2 = 0;
+    nvme_io_queue_t* io_queue = nvme_io_queue_of_cpu(nvme_disk);
+    uint16_t cid = 0;
 
-    if(fa_cnt == 2) {
-        prp2 = prp1 + 0x1000;
-    } else if(fa_cnt > 2) {
-        prp2 = nvme_disk->prp_frame_fa + iosqt * 0x1000;
-        uint64_t* prp2_list = (uint64_t*)MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(prp2);
-        memory_memclean(prp2_list, 0x1000);
+    if(!nvme_io_queue_reserve_cid(io_queue, &cid)) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot %s: too many active commands", write?"write":"read");
 
-        for(uint64_t i = 0; i < fa_cnt - 1; i++) {
-            prp2_list[i] = prp1 + (i + 1) * 0x1000;
-            PRINTLOG(NVME, LOG_TRACE, "prp2: %llx va %llx", prp2_list[i], buffer_va + (i + 1) * 0x1000);
-        }
+        return NULL;
     }
 
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].opc = write?NVME_CMD_WRITE:NVME_CMD_READ;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].fuse = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cid = cid;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].nsid = nvme_disk->ns_id;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].psdt = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].mptr = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].dptr.prplist.prp1 = prp1;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].dptr.prplist.prp2 = prp2;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw10 = lba & 0xFFFFFFFF;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw11 = (lba >> 32) & 0xFFFFFFFF;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw12 = (fcnt - 1);
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw13 = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw14 = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw15 = 0;
-
-    uint64_t tid = task_get_id();
-    lock_t* lock = lock_create_with_heap_for_future(nvme_disk->heap, true, tid);
+    // remaining pages start at page boundaries, each one is looked up because buffer is only virtually contiguous
+    uint64_t page_va = buffer_va - page_offset + FRAME_SIZE;
+    uint64_t prp2 = 0;
 
-    if(lock == NULL) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot create lock for %s", write?"write":"read");
+    if(page_count == 2) {
+        if(memory_paging_get_physical_address(page_va, &prp2) != 0) {
+            PRINTLOG(NVME, LOG_ERROR, "cannot %s: buffer physical address not found", write?"write":"read");
+            nvme_io_queue_release_cid(io_queue, cid);
 
-        return NULL;
-    }
+            return NULL;
+        }
+    } else if(page_count > 2) {
+        // prp list frame belongs to cid until its completion
+        prp2 = io_queue->prp_frame_fa + cid * FRAME_SIZE;
+        uint64_t* prp2_list = (uint64_t*)MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(prp2);
 
-    hashmap_put(nvme_disk->command_lock_map, (void*)(uint64_t)cid, lock);
-    future_t* fut = future_create(lock);
+        for(uint64_t i = 0; i < page_count - 1; i++, page_va += FRAME_SIZE) {
+            if(memory_paging_get_physical_address(page_va, &prp2_list[i]) != 0) {
+                PRINTLOG(NVME, LOG_ERROR, "cannot %s: buffer physical address not found", write?"write":"read");
+                nvme_io_queue_release_cid(io_queue, cid);
 
-    if(fut == NULL) {
-        hashmap_delete(nvme_disk->command_lock_map, (void*)(uint64_t)cid);
-        lock_destroy(lock);
-        PRINTLOG(NVME, LOG_ERROR, "cannot create future for %s", write?"write":"read");
+                return NULL;
+            }
 
-        return NULL;
+            PRINTLOG(NVME, LOG_TRACE, "prp2: %llx va %llx", prp2_list[i], page_va);
+        }
     }
 
-    nvme_disk->io_s_queue_tail = (nvme_disk->io_s_queue_tail + 1) % 64;
-    *nvme_disk->io_submission_queue_tail_doorbell = nvme_disk->io_s_queue_tail;
-
-    nvme_disk->active_command_count++;
+    nvme_submission_queue_entry_t cmd = {0};
 
-    PRINTLOG(NVME, LOG_TRACE, "%s command sent with cid %x and s tail %llx", write?"write":"read", cid, nvme_disk->io_s_queue_tail - 1);
+    cmd.opc = write?NVME_CMD_WRITE:NVME_CMD_READ;
+    cmd.cid = cid;
+    cmd.nsid = nvme_disk->ns_id;
+    cmd.dptr.prplist.prp1 = prp1;
+    cmd.dptr.prplist.prp2 = prp2;
+    cmd.cdw10 = lba & 0xFFFFFFFF;
+    cmd.cdw11 = (lba >> 32) & 0xFFFFFFFF;
+    cmd.cdw12 = (fcnt - 1);
 
-    return fut;
+    return nvme_io_queue_submit_with_future(io_queue, &cmd);
 }
 
 future_t* nvme_flush(uint64_t disk_id) {
@@ -747,67 +933,28 @@ future_t* nvme_flush(uint64_t disk_id) {
         return NULL;
     }
 
-    if(nvme_disk->active_command_count > nvme_disk->io_queue_size - 1) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot flush: too many active commands");
-
-        return NULL;
-    }
-
     if(!nvme_disk->flush_supported) {
         PRINTLOG(NVME, LOG_TRACE, "cannot flush: flush not supported");
 
         return NULL;
     }
 
-    uint16_t cid = nvme_disk->next_cid++;
-
-    if(cid == 0) {
-        cid = nvme_disk->next_cid++;
-    }
-
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].opc = NVME_CMD_FLUSH;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].fuse = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cid = cid;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].nsid = 0xFFFFFFFF;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].psdt = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].mptr = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].dptr.prplist.prp1 = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].dptr.prplist.prp2 = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw10 = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw11 = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw12 = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw13 = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw14 = 0;
-    nvme_disk->io_submission_queue[nvme_disk->io_s_queue_tail].cdw15 = 0;
-
-    uint64_t tid = task_get_id();
-    lock_t* lock = lock_create_with_heap_for_future(nvme_disk->heap, true, tid);
-
-    if(lock == NULL) {
-        PRINTLOG(NVME, LOG_ERROR, "cannot create lock for flush");
-
-        return NULL;
-    }
-
-
-    hashmap_put(nvme_disk->command_lock_map, (void*)(uint64_t)cid, lock);
-    future_t* fut = future_create_with_heap_and_data(nvme_disk->heap, lock, NULL);
+    nvme_io_queue_t* io_queue = nvme_io_queue_of_cpu(nvme_disk);
+    uint16_t cid = 0;
 
-    if(fut == NULL) {
-        lock_destroy(lock);
-        PRINTLOG(NVME, LOG_ERROR, "cannot create future for flush");
+    if(!nvme_io_queue_reserve_cid(io_queue, &cid)) {
+        PRINTLOG(NVME, LOG_ERROR, "cannot flush: too many active commands");
 
         return NULL;
     }
 
-    nvme_disk->io_s_queue_tail = (nvme_disk->io_s_queue_tail + 1) % nvme_disk->io_queue_size;
-    *nvme_disk->io_submission_queue_tail_doorbell = nvme_disk->io_s_queue_tail;
+    nvme_submission_queue_entry_t cmd = {0};
 
-    nvme_disk->active_command_count++;
+    cmd.opc = NVME_CMD_FLUSH;
+    cmd.cid = cid;
+    cmd.nsid = 0xFFFFFFFF;
 
-    PRINTLOG(NVME, LOG_TRACE, "flush command sent with cid %x and s tail %llx", cid, nvme_disk->io_s_queue_tail - 1);
-
-    return fut;
+    return nvme_io_queue_submit_with_future(io_queue, &cmd);
 }
 
 int8_t nvme_send_admin_command(nvme_disk_t* nvme_disk,
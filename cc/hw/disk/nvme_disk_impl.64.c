@@ -50,13 +50,17 @@ int8_t nvme_disk_impl_write(const disk_or_partition_t* d, uint64_t lba, uint64_t
     }
 
     uint64_t buffer_len = count * ctx->block_size;
-    uint64_t real_buffer_len = buffer_len;
     uint8_t* write_buf = data;
     boolean_t need_to_free = false;
 
-    if(real_buffer_len % 0x1000 || (uint64_t)write_buf % 0x1000) {
-        real_buffer_len += 0x1000 - (real_buffer_len % 0x1000);
-        write_buf = memory_malloc_ext(ctx->nvme_disk->heap, real_buffer_len, 0x1000);
+    // prp lists are built from page tables, only buffers which are not dword aligned need a copy
+    if((uint64_t)write_buf % 4) {
+        write_buf = memory_malloc_ext(ctx->nvme_disk->heap, buffer_len, 0x1000);
+
+        if(write_buf == NULL) {
+            return -1;
+        }
+
         memory_memcopy(data, write_buf, buffer_len);
         need_to_free = true;
     }
@@ -83,10 +87,6 @@ int8_t nvme_disk_impl_write(const disk_or_partition_t* d, uint64_t lba, uint64_t
         rem_lba -= iter_read_size;
     }
 
-    if(need_to_free) {
-        memory_free_ext(ctx->nvme_disk->heap, write_buf);
-    }
-
     iterator_t* iter = list_iterator_create(futs);
 
     while(iter->end_of_iterator(iter) != 0) {
@@ -97,8 +97,15 @@ int8_t nvme_disk_impl_write(const disk_or_partition_t* d, uint64_t lba, uint64_t
         iter = iter->next(iter);
     }
 
+    iter->destroy(iter);
+
     list_destroy(futs);
 
+    // copy is freed after controller reads it
+    if(need_to_free) {
+        memory_free_ext(ctx->nvme_disk->heap, write_buf);
+    }
+
     return 0;
 }
 
@@ -149,6 +156,8 @@ int8_t nvme_disk_impl_read(const disk_or_partition_t* d, uint64_t lba, uint64_t
         iter = iter->next(iter);
     }
 
+    iter->destroy(iter);
+
     list_destroy(futs);
 
     return 0;
@@ -35,9 +35,52 @@ int8_t   network_e1000_tx_init(network_e1000_dev_t* dev);
 void     network_e1000_rx_poll(const network_e1000_dev_t* netdev);
 int8_t   network_e1000_rx_isr(interrupt_frame_ext_t* frame);
 int8_t   network_e1000_process_tx(void);
+int8_t   network_e1000_send_packet(network_e1000_dev_t* dev, network_buffer_t* nb);
 void     network_e1000_phy_write(network_e1000_dev_t* dev, int regaddr, uint16_t data);
 
 
+int8_t network_e1000_send_packet(network_e1000_dev_t* dev, network_buffer_t* nb) {
+    PRINTLOG(NETWORK, LOG_TRACE, "network packet will be sended with length 0x%x", nb->length);
+
+    volatile network_e1000_tx_desc_t* desc = &dev->tx_desc[dev->tx_tail];
+
+    if(dev->tx_buffers[dev->tx_tail] != NULL) {
+        // descriptor done bit tells buffer is read by device
+        if(!(desc->sta & NETWORK_E1000_TX_STA_DD)) {
+            PRINTLOG(NETWORK, LOG_TRACE, "tx queue is full");
+
+            return -1;
+        }
+
+        network_buffer_release(dev->tx_buffers[dev->tx_tail]);
+        dev->tx_buffers[dev->tx_tail] = NULL;
+    }
+
+    nb = network_buffer_get_dma_buffer(nb);
+
+    if(nb == NULL) {
+        PRINTLOG(NETWORK, LOG_ERROR, "cannot get dma buffer, packet dropped");
+        dev->packets_dropped++;
+
+        return 0;
+    }
+
+    dev->tx_buffers[dev->tx_tail] = nb;
+
+    desc->address = network_buffer_get_data_fa(nb);
+    desc->length = nb->length;
+    desc->sta = 0;
+    desc->cmd = NETWORK_E1000_TX_CMD_EOP | NETWORK_E1000_TX_CMD_IFCS | NETWORK_E1000_TX_CMD_RS;
+
+    // update the tail so the hardware knows it's ready
+    dev->tx_tail = (dev->tx_tail + 1) % NETWORK_E1000_NUM_TX_DESCRIPTORS;
+    dev->mmio->tdt = dev->tx_tail;
+
+    dev->tx_count++;
+
+    return 0;
+}
+
 int8_t network_e1000_process_tx(void) {
 
     for(uint64_t dev_idx = 0; dev_idx < list_size(e1000_net_devs); dev_idx++) {
@@ -52,30 +95,21 @@ int8_t network_e1000_process_tx(void) {
             network_e1000_dev_t* dev = (network_e1000_dev_t*)list_get_data_at_position(e1000_net_devs, dev_idx);
 
             while(list_size(dev->transmit_queue)) {
-                const network_transmit_packet_t* packet = list_queue_pop(dev->transmit_queue);
+                network_buffer_t* nb = (network_buffer_t*)list_queue_peek(dev->transmit_queue);
 
-                if(packet) {
-                    PRINTLOG(NETWORK, LOG_TRACE, "network packet will be sended with length 0x%llx", packet->packet_len);
+                if(nb) {
                     packet_exists = 1;
 
-                    uint8_t* buffer = (uint8_t*)MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(dev->tx_desc[dev->tx_tail].address);
-
-                    memory_memcopy(packet->packet_data, buffer, packet->packet_len);
-
-                    dev->tx_desc[dev->tx_tail].length = packet->packet_len;
-                    dev->tx_desc[dev->tx_tail].cmd = 3;
-
-                    memory_free(packet->packet_data);
-                    memory_free((void*)packet);
-
-                    // update the tail so the hardware knows it's ready
-                    dev->tx_tail = (dev->tx_tail + 1) % NETWORK_E1000_NUM_TX_DESCRIPTORS;
-                    dev->mmio->tdt = dev->tx_tail;
-
-                    dev->tx_count++;
+                    if(network_e1000_send_packet(dev, nb) != 0) {
+                        // packet stays at queue until device completes the descriptor
+                        task_yield();
 
+                        break;
+                    }
                 }
 
+                list_queue_pop(dev->transmit_queue);
+
                 PRINTLOG(NETWORK, LOG_TRACE, "tx queue size 0x%llx", list_size(dev->transmit_queue));
             }
 
@@ -148,26 +182,22 @@ void network_e1000_rx_enable(network_e1000_dev_t* dev) {
 int8_t network_e1000_rx_init(network_e1000_dev_t* dev) {
     PRINTLOG(E1000, LOG_TRACE, "try to initialize rx queue");
 
-    uint64_t queue_size = (8192 + 16) * NETWORK_E1000_NUM_RX_DESCRIPTORS;
-
-    uint64_t queue_frm_cnt = (queue_size + FRAME_SIZE - 1)  / FRAME_SIZE;
     uint64_t queue_meta_frm_cnt = ((sizeof(network_e1000_rx_desc_t) * NETWORK_E1000_NUM_RX_DESCRIPTORS)  + FRAME_SIZE - 1 ) / FRAME_SIZE;
 
-
-    frame_t* queue_frames;
     frame_t* queue_meta_frames;
 
-    PRINTLOG(E1000, LOG_TRACE, "rx queue size 0x%llx queue frm count 0x%llx meta frm count 0x%llx", queue_size, queue_frm_cnt, queue_meta_frm_cnt);
+    PRINTLOG(E1000, LOG_TRACE, "rx queue meta frm count 0x%llx", queue_meta_frm_cnt);
 
+    dev->rx_buffers = memory_malloc(sizeof(network_buffer_t*) * NETWORK_E1000_NUM_RX_DESCRIPTORS);
 
-    if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), queue_frm_cnt, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &queue_frames, NULL) == 0 &&
-       frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), queue_meta_frm_cnt, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &queue_meta_frames, NULL) == 0) {
-        queue_frames->frame_attributes |= FRAME_ATTRIBUTE_RESERVED_PAGE_MAPPED;
-        queue_meta_frames->frame_attributes |= FRAME_ATTRIBUTE_RESERVED_PAGE_MAPPED;
+    if(dev->rx_buffers == NULL) {
+        PRINTLOG(E1000, LOG_ERROR, "cannot allocate rx buffer list");
+
+        return -1;
+    }
 
-        uint64_t queue_fa = queue_frames->frame_address;
-        uint64_t queue_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(queue_frames->frame_address);
-        memory_paging_add_va_for_frame(queue_va, queue_frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC);
+    if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), queue_meta_frm_cnt, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &queue_meta_frames, NULL) == 0) {
+        queue_meta_frames->frame_attributes |= FRAME_ATTRIBUTE_RESERVED_PAGE_MAPPED;
 
         uint64_t queue_meta_fa = queue_meta_frames->frame_address;
         uint64_t queue_meta_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(queue_meta_frames->frame_address);
@@ -180,7 +210,16 @@ int8_t network_e1000_rx_init(network_e1000_dev_t* dev) {
         PRINTLOG(E1000, LOG_TRACE, "filling rx queue at 0x%llx", queue_meta_va);
 
         for(int32_t i = 0; i < NETWORK_E1000_NUM_RX_DESCRIPTORS; i++ ) {
-            dev->rx_desc[i].address = queue_fa + i * (8192 + 16);
+            network_buffer_t* nb = network_buffer_alloc(NETWORK_BUFFER_SIZE - NETWORK_BUFFER_HEADROOM);
+
+            if(nb == NULL) {
+                PRINTLOG(E1000, LOG_ERROR, "cannot allocate rx buffer");
+
+                return -1;
+            }
+
+            dev->rx_buffers[i] = nb;
+            dev->rx_desc[i].address = network_buffer_get_data_fa(nb);
             dev->rx_desc[i].status = 0;
         }
 
@@ -192,8 +231,8 @@ int8_t network_e1000_rx_init(network_e1000_dev_t* dev) {
         dev->mmio->rdt = NETWORK_E1000_NUM_RX_DESCRIPTORS;
         dev->rx_tail = 0;
 
-        // set the receieve control register (promisc ON, 8K pkt size)
-        dev->mmio->rctl = (NETWORK_E1000_RCTL_SBP | NETWORK_E1000_RCTL_UPE | NETWORK_E1000_RCTL_MPE | NETWORK_E1000_RDMTS_HALF | NETWORK_E1000_RCTL_SECRC | NETWORK_E1000_RCTL_LPE | NETWORK_E1000_RCTL_BAM | NETWORK_E1000_RCTL_BSIZE_8192);
+        // set the receieve control register (promisc ON, 2K pkt size without long packets, a full frame fits into buffer tailroom)
+        dev->mmio->rctl = (NETWORK_E1000_RCTL_SBP | NETWORK_E1000_RCTL_UPE | NETWORK_E1000_RCTL_MPE | NETWORK_E1000_RDMTS_HALF | NETWORK_E1000_RCTL_SECRC | NETWORK_E1000_RCTL_BAM | NETWORK_E1000_RCTL_BSIZE_2048);
 
         PRINTLOG(E1000, LOG_TRACE, "rx queue initialized");
 
@@ -204,26 +243,23 @@ int8_t network_e1000_rx_init(network_e1000_dev_t* dev) {
 }
 
 int8_t network_e1000_tx_init(network_e1000_dev_t* dev) {
-    uint64_t queue_size = (8192 + 16) * NETWORK_E1000_NUM_TX_DESCRIPTORS;
+    uint64_t queue_meta_frm_cnt = ((sizeof(network_e1000_tx_desc_t) * NETWORK_E1000_NUM_TX_DESCRIPTORS)  + FRAME_SIZE - 1 ) / FRAME_SIZE;
+
+    frame_t* queue_meta_frames;
 
-    uint64_t queue_frm_cnt = (queue_size + FRAME_SIZE - 1)  / FRAME_SIZE;
-    uint64_t queue_meta_frm_cnt = ((sizeof(network_e1000_rx_desc_t) * NETWORK_E1000_NUM_TX_DESCRIPTORS)  + FRAME_SIZE - 1 ) / FRAME_SIZE;
+    PRINTLOG(E1000, LOG_TRACE, "tx queue meta frm count 0x%llx", queue_meta_frm_cnt);
 
+    dev->tx_buffers = memory_malloc(sizeof(network_buffer_t*) * NETWORK_E1000_NUM_TX_DESCRIPTORS);
 
-    frame_t* queue_frames;
-    frame_t* queue_meta_frames;
+    if(dev->tx_buffers == NULL) {
+        PRINTLOG(E1000, LOG_ERROR, "cannot allocate tx buffer list");
 
-    PRINTLOG(E1000, LOG_TRACE, "tx queue size 0x%llx queue frm count 0x%llx meta frm count 0x%llx", queue_size, queue_frm_cnt, queue_meta_frm_cnt);
+        return -1;
+    }
 
-    if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), queue_frm_cnt, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &queue_frames, NULL) == 0 &&
-       frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), queue_meta_frm_cnt, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &queue_meta_frames, NULL) == 0) {
-        queue_frames->frame_attributes |= FRAME_ATTRIBUTE_RESERVED_PAGE_MAPPED;
+    if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), queue_meta_frm_cnt, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &queue_meta_frames, NULL) == 0) {
         queue_meta_frames->frame_attributes |= FRAME_ATTRIBUTE_RESERVED_PAGE_MAPPED;
 
-        uint64_t queue_fa = queue_frames->frame_address;
-        uint64_t queue_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(queue_frames->frame_address);
-        memory_paging_add_va_for_frame(queue_va, queue_frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC);
-
         uint64_t queue_meta_fa = queue_meta_frames->frame_address;
         uint64_t queue_meta_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(queue_meta_frames->frame_address);
         memory_paging_add_va_for_frame(queue_meta_va, queue_meta_frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC);
@@ -234,8 +270,9 @@ int8_t network_e1000_tx_init(network_e1000_dev_t* dev) {
 
         PRINTLOG(E1000, LOG_TRACE, "filling tx queue at 0x%llx", queue_meta_va);
 
+        // buffers are attached at send time
         for(int32_t i = 0; i < NETWORK_E1000_NUM_TX_DESCRIPTORS; i++ ) {
-            dev->tx_desc[i].address = queue_fa + i * (8192 + 16);
+            dev->tx_desc[i].address = 0;
             dev->tx_desc[i].cmd = 0;
         }
 
@@ -263,8 +300,7 @@ int8_t network_e1000_tx_init(network_e1000_dev_t* dev) {
 // This can be used stand-alone or from an interrupt handler
 void network_e1000_rx_poll(const network_e1000_dev_t* dev) {
     while( (dev->rx_desc[dev->rx_tail].status & (1 << 0)) ) {
-        // raw packet and packet length (excluding CRC)
-        uint8_t* pkt = (void*)dev->rx_desc[dev->rx_tail].address;
+        // packet length (excluding CRC)
         uint16_t pktlen = dev->rx_desc[dev->rx_tail].length;
         boolean_t dropflag = 0;
 
@@ -287,30 +323,33 @@ void network_e1000_rx_poll(const network_e1000_dev_t* dev) {
             // send the packet to higher layers for parsing
             PRINTLOG(E1000, LOG_TRACE, "packet received with len 0x%x", pktlen);
 
-            pkt = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(pkt);
-
-            network_received_packet_t* packet = memory_malloc(sizeof(network_received_packet_t));
+            network_buffer_t* nb = dev->rx_buffers[dev->rx_tail];
+            network_buffer_t* new_nb = network_buffer_alloc(NETWORK_BUFFER_SIZE - NETWORK_BUFFER_HEADROOM);
+            network_received_packet_t* packet = NULL;
 
-            if(packet == NULL) {
-                continue;
+            if(new_nb) {
+                packet = memory_malloc(sizeof(network_received_packet_t));
             }
 
-            packet->packet_len = pktlen;
-            packet->return_queue = dev->transmit_queue;
-            packet->network_info = (void*)dev->mac;
-            packet->network_type = NETWORK_TYPE_ETHERNET;
-
-            packet->packet_data = memory_malloc(pktlen);
-
-            if(packet->packet_data == NULL) {
+            if(packet == NULL || network_buffer_put(nb, pktlen) == NULL) {
+                // current buffer stays at descriptor, packet is dropped
                 memory_free(packet);
-
-                continue;
+                network_buffer_release(new_nb);
+                ((network_e1000_dev_t*)dev)->packets_dropped++;
+            } else {
+                dev->rx_buffers[dev->rx_tail] = new_nb;
+                dev->rx_desc[dev->rx_tail].address = network_buffer_get_data_fa(new_nb);
+
+                packet->buffer = nb;
+                packet->return_queue = dev->transmit_queue;
+                packet->network_info = (void*)dev->mac;
+                packet->network_type = NETWORK_TYPE_ETHERNET;
+
+                if(list_queue_push(network_received_packets, packet) == -1ULL) {
+                    network_buffer_release(nb);
+                    memory_free(packet);
+                }
             }
-
-            memory_memcopy(pkt, packet->packet_data, pktlen);
-
-            list_queue_push(network_received_packets, packet);
         }
 
         // update RX counts and the tail pointer
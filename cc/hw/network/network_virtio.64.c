@@ -33,40 +33,151 @@ int8_t   network_virtio_tx_isr(interrupt_frame_ext_t* frame);
 int8_t   network_virtio_ctrl_isr(interrupt_frame_ext_t* frame);
 int8_t   network_virtio_config_isr(interrupt_frame_ext_t* frame);
 int8_t   network_virtio_combined_isr(interrupt_frame_ext_t* frame);
-int8_t   network_virtio_send_packet(network_transmit_packet_t* packet, virtio_dev_t* vdev, virtio_queue_ext_t* vq_tx, virtio_queue_avail_t* avail, virtio_queue_descriptor_t* descs);
+uint64_t network_virtio_send_packets(virtio_dev_t* vdev, list_t* packets);
 int8_t   network_virtio_process_tx(void);
 int32_t  network_virtio_process_rx(uint64_t args_cnt, void** args);
 int8_t   network_virtio_ctrl_set_mac(virtio_dev_t* vdev);
 uint64_t network_virtio_select_features(virtio_dev_t* vdev, uint64_t avail_features);
-int8_t   network_rx_tx_queue_item_builder(virtio_dev_t* vdev, void* queue_item);
 int8_t   network_virtio_create_queues(virtio_dev_t* vdev);
 
 
-int8_t network_virtio_send_packet(network_transmit_packet_t* packet, virtio_dev_t* vdev, virtio_queue_ext_t* vq_tx, virtio_queue_avail_t* avail, virtio_queue_descriptor_t* descs) {
-    PRINTLOG(VIRTIONET, LOG_TRACE, "network packet will be sended with length 0x%llx", packet->packet_len);
+static uint16_t network_virtio_get_header_length(const virtio_dev_t* vdev) {
+    if(!vdev->is_legacy || (vdev->selected_features & VIRTIO_NETWORK_F_MRG_RXBUF)) {
+        return sizeof(virtio_network_header_t);
+    }
 
-    uint16_t avail_tx_id = avail->index;
+    return sizeof(virtio_network_header_t) - 2;
+}
 
-    uint8_t* offset = (uint8_t*)MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(descs[avail_tx_id % vdev->queue_size].address);
-    virtio_network_header_t* hdr = (virtio_network_header_t*)offset;
+static void network_virtio_set_rx_buffer(const virtio_dev_t* vdev, virtio_queue_ext_t* vq_rx, virtio_queue_descriptor_t* descs, uint16_t desc_id, network_buffer_t* nb) {
+    uint16_t header_length = network_virtio_get_header_length(vdev);
 
-    memory_memclean(hdr, sizeof(virtio_network_header_t));
+    // device writes virtio header into headroom, so frame starts at buffer data
+    descs[desc_id].address = network_buffer_get_data_fa(nb) - header_length;
+    descs[desc_id].length = header_length + network_buffer_get_tailroom(nb);
+    descs[desc_id].flags = VIRTIO_QUEUE_DESC_F_WRITE;
 
-    offset += sizeof(virtio_network_header_t);
+    vq_rx->item_buffers[desc_id] = nb;
+}
 
-    memory_memcopy(packet->packet_data, offset, packet->packet_len);
+static int8_t network_virtio_post_rx_buffers(virtio_dev_t* vdev) {
+    virtio_queue_ext_t* vq_rx = &vdev->queues[0];
+    virtio_queue_descriptor_t* descs = virtio_queue_get_desc(vdev, vq_rx->vq);
 
-    descs[avail_tx_id % vdev->queue_size].length = sizeof(virtio_network_header_t) + packet->packet_len;
+    vq_rx->item_buffers = memory_malloc(sizeof(void*) * vdev->queue_size);
 
-    memory_free(packet->packet_data);
-    memory_free(packet);
+    if(vq_rx->item_buffers == NULL) {
+        PRINTLOG(VIRTIONET, LOG_ERROR, "cannot allocate rx buffer list");
 
-    avail->index++;
-    vq_tx->nd->vqn = 1;
+        return -1;
+    }
+
+    for(uint16_t i = 0; i < vdev->queue_size; i++) {
+        network_buffer_t* nb = network_buffer_alloc(NETWORK_BUFFER_SIZE - NETWORK_BUFFER_HEADROOM);
+
+        if(nb == NULL) {
+            PRINTLOG(VIRTIONET, LOG_ERROR, "cannot allocate rx buffer");
+
+            return -1;
+        }
+
+        network_virtio_set_rx_buffer(vdev, vq_rx, descs, i, nb);
+    }
 
     return 0;
 }
 
+static void network_virtio_reclaim_tx_buffers(virtio_dev_t* vdev, virtio_queue_ext_t* vq_tx) {
+    virtio_queue_used_t* used = virtio_queue_get_used(vdev, vq_tx->vq);
+
+    while(vq_tx->last_used_index != used->index) {
+        uint16_t desc_id = used->ring[vq_tx->last_used_index % vdev->queue_size].id;
+
+        network_buffer_release(vq_tx->item_buffers[desc_id]);
+        vq_tx->item_buffers[desc_id] = NULL;
+
+        vq_tx->last_used_index++;
+    }
+}
+
+static int8_t network_virtio_enqueue_packet(virtio_dev_t* vdev, network_buffer_t* nb, uint16_t* avail_index) {
+    PRINTLOG(VIRTIONET, LOG_TRACE, "network packet will be sended with length 0x%x", nb->length);
+
+    virtio_queue_ext_t* vq_tx = &vdev->queues[1];
+    virtio_queue_avail_t* avail = virtio_queue_get_avail(vdev, vq_tx->vq);
+    virtio_queue_descriptor_t* descs = virtio_queue_get_desc(vdev, vq_tx->vq);
+
+    uint16_t desc_id = *avail_index % vdev->queue_size;
+
+    if(vq_tx->item_buffers[desc_id] != NULL) {
+        network_virtio_reclaim_tx_buffers(vdev, vq_tx);
+
+        if(vq_tx->item_buffers[desc_id] != NULL) {
+            PRINTLOG(VIRTIONET, LOG_TRACE, "tx queue is full");
+
+            return -1;
+        }
+    }
+
+    nb = network_buffer_get_dma_buffer(nb);
+
+    if(nb == NULL) {
+        PRINTLOG(VIRTIONET, LOG_ERROR, "cannot get dma buffer, packet dropped");
+
+        return 0;
+    }
+
+    uint16_t header_length = network_virtio_get_header_length(vdev);
+    virtio_network_header_t* hdr = (virtio_network_header_t*)network_buffer_push(nb, header_length);
+
+    if(hdr == NULL) {
+        PRINTLOG(VIRTIONET, LOG_ERROR, "not enough headroom, packet dropped");
+        network_buffer_release(nb);
+
+        return 0;
+    }
+
+    memory_memclean(hdr, header_length);
+
+    descs[desc_id].address = network_buffer_get_data_fa(nb);
+    descs[desc_id].length = nb->length;
+    descs[desc_id].flags = 0;
+
+    vq_tx->item_buffers[desc_id] = nb;
+
+    avail->ring[desc_id] = desc_id;
+    (*avail_index)++;
+
+    return 0;
+}
+
+uint64_t network_virtio_send_packets(virtio_dev_t* vdev, list_t* packets) {
+    virtio_queue_ext_t* vq_tx = &vdev->queues[1];
+    uint16_t avail_index = virtio_queue_get_avail(vdev, vq_tx->vq)->index;
+    uint64_t sent_count = 0;
+
+    network_virtio_reclaim_tx_buffers(vdev, vq_tx);
+
+    while(list_size(packets)) {
+        network_buffer_t* nb = (network_buffer_t*)list_queue_peek(packets);
+
+        // packet stays at queue until device returns tx descriptors
+        if(nb && network_virtio_enqueue_packet(vdev, nb, &avail_index) != 0) {
+            break;
+        }
+
+        list_queue_pop(packets);
+        sent_count++;
+    }
+
+    // whole burst is published with one index update and at most one notification
+    virtio_queue_kick(vdev, 1, avail_index);
+
+    PRINTLOG(VIRTIONET, LOG_TRACE, "0x%llx packets sended, tx queue size 0x%llx", sent_count, list_size(packets));
+
+    return sent_count;
+}
+
 int8_t network_virtio_process_tx(void){
 
     for(uint64_t dev_idx = 0; dev_idx < list_size(virtio_net_devs); dev_idx++) {
@@ -101,21 +212,13 @@ int8_t network_virtio_process_tx(void){
                 }
             }
 
-            virtio_queue_ext_t* vq_tx = &vdev->queues[1];
-            virtio_queue_avail_t* avail = virtio_queue_get_avail(vdev, vq_tx->vq);
-            virtio_queue_descriptor_t* descs = virtio_queue_get_desc(vdev, vq_tx->vq);
-
-            while(list_size(vdev->return_queue)) {
-                network_transmit_packet_t* packet = (network_transmit_packet_t*)list_queue_peek(vdev->return_queue);
-
-                if(packet) {
-                    packet_exists = 1;
-                    network_virtio_send_packet(packet, vdev, vq_tx, avail, descs);
+            if(list_size(vdev->return_queue)) {
+                packet_exists = 1;
 
-                    list_queue_pop(vdev->return_queue);
+                if(network_virtio_send_packets(vdev, vdev->return_queue) == 0) {
+                    // tx ring is full, let device consume it
+                    task_yield();
                 }
-
-                PRINTLOG(VIRTIONET, LOG_TRACE, "tx queue size 0x%llx", list_size(vdev->return_queue));
             }
 
         }
@@ -133,93 +236,114 @@ int8_t network_virtio_process_tx(void){
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-int32_t network_virtio_process_rx(uint64_t args_cnt, void** args){
-    UNUSED(args_cnt);
-
-    virtio_dev_t* vdev = (virtio_dev_t*)args[0];
-
+static uint64_t network_virtio_rx_poll(virtio_dev_t* vdev, uint64_t budget) {
     virtio_queue_ext_t* vq_rx = &vdev->queues[0];
     virtio_queue_used_t* used = virtio_queue_get_used(vdev, vq_rx->vq);
     virtio_queue_avail_t* avail = virtio_queue_get_avail(vdev, vq_rx->vq);
     virtio_queue_descriptor_t* descs = virtio_queue_get_desc(vdev, vq_rx->vq);
 
-    PRINTLOG(VIRTIONET, LOG_TRACE, "virtio network rx clear pending bit send set interruptible");
-    cpu_cli();
-    pci_msix_update_lapic((pci_generic_device_t*)vdev->pci_dev->pci_header, vdev->msix_cap, 0);
-    pci_msix_clear_pending_bit((pci_generic_device_t*)vdev->pci_dev->pci_header, vdev->msix_cap, 0);
-    task_set_interruptible();
-    cpu_sti();
+    uint16_t avail_index = avail->index;
+    uint64_t processed_count = 0;
 
-    while(true) {
+    while(processed_count < budget && vq_rx->last_used_index != used->index) {
+        PRINTLOG(VIRTIONET, LOG_TRACE, "packet received. last used index %i", vq_rx->last_used_index);
 
-        if(network_received_packets != NULL && vdev->return_queue != NULL) {
+        uint32_t packet_len = used->ring[vq_rx->last_used_index % vdev->queue_size].length;
+        uint16_t packet_desc_id = used->ring[vq_rx->last_used_index % vdev->queue_size].id;
+        uint16_t header_length = network_virtio_get_header_length(vdev);
 
-            while(vq_rx->last_used_index < used->index) {
-                PRINTLOG(VIRTIONET, LOG_TRACE, "packet received. last used index %i", vq_rx->last_used_index);
+        network_buffer_t* nb = vq_rx->item_buffers[packet_desc_id];
+        network_buffer_t* new_nb = network_buffer_alloc(NETWORK_BUFFER_SIZE - NETWORK_BUFFER_HEADROOM);
+        network_received_packet_t* packet = NULL;
 
-                network_received_packet_t* packet = memory_malloc_ext(list_get_heap(network_received_packets), sizeof(network_received_packet_t), 0);
+        if(new_nb) {
+            packet = memory_malloc_ext(list_get_heap(network_received_packets), sizeof(network_received_packet_t), 0);
+        }
 
-                if(packet == NULL) {
-                    PRINTLOG(VIRTIONET, LOG_ERROR, "failed to allocate packet");
+        if(packet == NULL) {
+            PRINTLOG(VIRTIONET, LOG_ERROR, "failed to allocate packet");
+            network_buffer_release(new_nb);
 
-                    task_yield();
+            // descriptor is retried at next poll
+            break;
+        }
 
-                    continue;
-                }
+        const virtio_network_header_t* hdr = (virtio_network_header_t*)(network_buffer_get_data(nb) - header_length);
+
+        if(packet_len < header_length || network_buffer_put(nb, packet_len - header_length) == NULL ||
+           ((vdev->selected_features & VIRTIO_NETWORK_F_MRG_RXBUF) && hdr->buffer_count > 1)) {
+            PRINTLOG(VIRTIONET, LOG_ERROR, "invalid packet with length 0x%x dropped", packet_len);
+            // buffer is posted again as it is, new buffer isnot needed
+            memory_free_ext(list_get_heap(network_received_packets), packet);
+            network_buffer_release(new_nb);
+            nb->length = 0;
+            new_nb = nb;
+            nb = NULL;
+        }
 
-                uint64_t packet_len = used->ring[vq_rx->last_used_index % vdev->queue_size].length;
-                uint16_t packet_desc_id = used->ring[vq_rx->last_used_index % vdev->queue_size].id;
+        network_virtio_set_rx_buffer(vdev, vq_rx, descs, packet_desc_id, new_nb);
 
-                uint8_t* offset = (uint8_t*)MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(descs[packet_desc_id].address);
-                virtio_network_header_t* hdr = (virtio_network_header_t*)offset;
+        avail->ring[avail_index % vdev->queue_size] = packet_desc_id;
+        avail_index++;
 
-                if(vdev->features & VIRTIO_NETWORK_F_MRG_RXBUF) {
-                    hdr->header_length = sizeof(virtio_network_header_t);
-                } else {
-                    hdr->header_length = sizeof(virtio_network_header_t) - 2;
-                }
+        vq_rx->last_used_index++;
+        processed_count++;
 
-                offset += hdr->header_length;
-                packet_len -= hdr->header_length;
+        if(nb == NULL) {
+            continue;
+        }
 
-                packet->packet_len = packet_len;
-                packet->return_queue = vdev->return_queue;
-                packet->network_info = vdev->extra_data;
-                packet->network_type = NETWORK_TYPE_ETHERNET;
+        packet->buffer = nb;
+        packet->return_queue = vdev->return_queue;
+        packet->network_info = vdev->extra_data;
+        packet->network_type = NETWORK_TYPE_ETHERNET;
 
-                packet->packet_data = memory_malloc_ext(list_get_heap(network_received_packets), packet_len, 0);
+        uint8_t* mac = vdev->extra_data;
 
-                if(packet->packet_data == NULL) {
-                    PRINTLOG(VIRTIONET, LOG_ERROR, "failed to allocate packet data. packet len 0x%llx", packet_len);
-                    memory_free_ext(list_get_heap(network_received_packets), packet);
+        PRINTLOG(VIRTIONET, LOG_TRACE, "packet received with length 0x%x", nb->length);
+        PRINTLOG(VIRTIONET, LOG_TRACE, "dst mac %02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
-                    task_yield();
+        if(list_queue_push(network_received_packets, packet) == -1ULL) {
+            PRINTLOG(VIRTIONET, LOG_ERROR, "failed to queue packet");
+            network_buffer_release(nb);
+            memory_free_ext(list_get_heap(network_received_packets), packet);
+        } else {
+            PRINTLOG(VIRTIONET, LOG_TRACE, "packet queued");
+        }
+    }
 
-                    continue;
-                }
+    // reposted descriptors are published with one index update and at most one notification
+    virtio_queue_kick(vdev, 0, avail_index);
+
+    return processed_count;
+}
+#pragma GCC diagnostic pop
+
+int32_t network_virtio_process_rx(uint64_t args_cnt, void** args){
+    UNUSED(args_cnt);
 
-                memory_memcopy(offset, packet->packet_data, packet_len);
+    virtio_dev_t* vdev = (virtio_dev_t*)args[0];
 
-                descs[packet_desc_id].flags = VIRTIO_QUEUE_DESC_F_WRITE;
+    PRINTLOG(VIRTIONET, LOG_TRACE, "virtio network rx clear pending bit send set interruptible");
+    cpu_cli();
+    pci_msix_update_lapic((pci_generic_device_t*)vdev->pci_dev->pci_header, vdev->msix_cap, 0);
+    pci_msix_clear_pending_bit((pci_generic_device_t*)vdev->pci_dev->pci_header, vdev->msix_cap, 0);
+    task_set_interruptible();
+    cpu_sti();
 
-                avail->ring[avail->index % vdev->queue_size] = packet_desc_id;
-                avail->index++;
-                vq_rx->nd->vqn = 0;
+    while(true) {
 
-                uint8_t* mac = vdev->extra_data;
+        if(network_received_packets != NULL && vdev->return_queue != NULL) {
+            // polling mode, device fills used ring without interrupts while ring is busy
+            virtio_queue_disable_interrupts(vdev, 0);
 
-                PRINTLOG(VIRTIONET, LOG_TRACE, "packet received with length 0x%llx", packet_len);
-                PRINTLOG(VIRTIONET, LOG_TRACE, "dst mac %02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+            uint64_t processed_count = network_virtio_rx_poll(vdev, NETWORK_VIRTIO_RX_POLL_BUDGET);
 
-                if(list_queue_push(network_received_packets, packet) == -1ULL) {
-                    PRINTLOG(VIRTIONET, LOG_ERROR, "failed to queue packet");
-                    memory_free_ext(list_get_heap(network_received_packets), packet->packet_data);
-                    memory_free_ext(list_get_heap(network_received_packets), packet);
-                } else {
-                    PRINTLOG(VIRTIONET, LOG_TRACE, "packet queued");
-                }
+            if(processed_count == NETWORK_VIRTIO_RX_POLL_BUDGET || virtio_queue_enable_interrupts(vdev, 0)) {
+                // ring is busy or packets arrived while enabling interrupts, poll again after other tasks
+                task_yield();
 
-                vq_rx->last_used_index++;
+                continue;
             }
 
             pci_msix_clear_pending_bit((pci_generic_device_t*)vdev->pci_dev->pci_header, vdev->msix_cap, 0);
@@ -235,7 +359,6 @@ int32_t network_virtio_process_rx(uint64_t args_cnt, void** args){
 
     return 0;
 }
-#pragma GCC diagnostic pop
 
 int8_t network_virtio_rx_isr(interrupt_frame_ext_t* frame) {
     uint8_t intnum = frame->interrupt_number;
@@ -443,6 +566,12 @@ uint64_t network_virtio_select_features(virtio_dev_t* vdev, uint64_t avail_featu
         req_features |= VIRTIO_F_NOTIFICATION_DATA;
     }
 
+    if(avail_features & VIRTIO_F_EVENT_IDX) {
+        PRINTLOG(VIRTIONET, LOG_TRACE, "device has event index feature");
+
+        req_features |= VIRTIO_F_EVENT_IDX;
+    }
+
     if(avail_features & VIRTIO_NETWORK_F_GUEST_HDRLEN) {
         PRINTLOG(VIRTIONET, LOG_TRACE, "device has guest hdr len feature");
 
@@ -458,18 +587,6 @@ uint64_t network_virtio_select_features(virtio_dev_t* vdev, uint64_t avail_featu
     return req_features;
 }
 
-int8_t network_rx_tx_queue_item_builder(virtio_dev_t* vdev, void* queue_item) {
-    virtio_network_header_t* hdr = (virtio_network_header_t*)MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(queue_item);
-
-    if(vdev->selected_features & VIRTIO_NETWORK_F_MRG_RXBUF) {
-        hdr->header_length = sizeof(virtio_network_header_t);
-    } else {
-        hdr->header_length = sizeof(virtio_network_header_t) - 2;
-    }
-
-    return 0;
-}
-
 int8_t network_virtio_create_queues(virtio_dev_t* vdev){
     PRINTLOG(VIRTIONET, LOG_TRACE, "vq count %i", vdev->max_vq_count);
 
@@ -477,18 +594,35 @@ int8_t network_virtio_create_queues(virtio_dev_t* vdev){
 
     // TODO create only one rx,tx queue
 
-    if(virtio_create_queue(vdev, 0, VIRTIO_NETWORK_QUEUE_ITEM_LENGTH, 1, 0, &network_rx_tx_queue_item_builder, &network_virtio_rx_isr, &network_virtio_combined_isr) != 0) {
+    if(virtio_create_queue(vdev, 0, VIRTIO_NETWORK_QUEUE_ITEM_LENGTH, 1, 0, NULL, &network_virtio_rx_isr, &network_virtio_combined_isr) != 0) {
         PRINTLOG(VIRTIONET, LOG_ERROR, "cannot create rx queue");
 
         return -1;
     }
 
-    if(virtio_create_queue(vdev, 1, VIRTIO_NETWORK_QUEUE_ITEM_LENGTH, 0, 0, &network_rx_tx_queue_item_builder, &network_virtio_tx_isr, &network_virtio_combined_isr) != 0) {
+    if(network_virtio_post_rx_buffers(vdev) != 0) {
+        PRINTLOG(VIRTIONET, LOG_ERROR, "cannot post rx buffers");
+
+        return -1;
+    }
+
+    if(virtio_create_queue(vdev, 1, VIRTIO_NETWORK_QUEUE_ITEM_LENGTH, 0, 0, NULL, &network_virtio_tx_isr, &network_virtio_combined_isr) != 0) {
         PRINTLOG(VIRTIONET, LOG_ERROR, "cannot create tx queue");
 
         return -1;
     }
 
+    vdev->queues[1].item_buffers = memory_malloc(sizeof(void*) * vdev->queue_size);
+
+    if(vdev->queues[1].item_buffers == NULL) {
+        PRINTLOG(VIRTIONET, LOG_ERROR, "cannot allocate tx buffer list");
+
+        return -1;
+    }
+
+    // tx buffers are reclaimed while sending, completions are not needed
+    virtio_queue_disable_interrupts(vdev, 1);
+
     if(((vdev->selected_features & VIRTIO_NETWORK_F_CTRL_VQ) == VIRTIO_NETWORK_F_CTRL_VQ) && virtio_create_queue(vdev, 2, VIRTIO_NETWORK_CTRL_QUEUE_ITEM_LENGTH, 0, 1, NULL, &network_virtio_ctrl_isr, &network_virtio_combined_isr) != 0) {
         PRINTLOG(VIRTIONET, LOG_ERROR, "cannot create ctrl queue");
 
@@ -79,6 +79,10 @@ int8_t pci_msix_configure(pci_generic_device_t* pci_gen_dev, pci_capability_msix
 }
 
 uint8_t pci_msix_set_isr(pci_generic_device_t* pci_dev, pci_capability_msix_t* msix_cap, uint16_t msix_vector, interrupt_irq isr) {
+    return pci_msix_set_isr_with_apic_id(pci_dev, msix_cap, msix_vector, apic_get_local_apic_id(), isr);
+}
+
+uint8_t pci_msix_set_isr_with_apic_id(pci_generic_device_t* pci_dev, pci_capability_msix_t* msix_cap, uint16_t msix_vector, uint32_t apic_id, interrupt_irq isr) {
     uint64_t msix_table_address = pci_get_bar_address(pci_dev, msix_cap->bir);
 
     msix_table_address += (msix_cap->table_offset << 3);
@@ -86,9 +90,7 @@ uint8_t pci_msix_set_isr(pci_generic_device_t* pci_dev, pci_capability_msix_t* m
     pci_capability_msix_table_t* msix_table = (pci_capability_msix_table_t*)MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(msix_table_address);
 
     uint32_t msg_addr = 0xFEE00000;
-    uint32_t apic_id = apic_get_local_apic_id();
-    apic_id <<= 12;
-    msg_addr |= apic_id;
+    msg_addr |= apic_id << 12;
 
     uint8_t intnum = interrupt_get_next_empty_interrupt();
     msix_table->entries[msix_vector].message_address = msg_addr;
@@ -229,6 +229,72 @@ int8_t virtio_create_queue(virtio_dev_t* vdev, uint16_t queue_no, uint64_t queue
 }
 
 
+boolean_t virtio_queue_kick(virtio_dev_t* vdev, uint16_t queue_no, uint16_t new_avail_index) {
+    virtio_queue_ext_t* vqe = &vdev->queues[queue_no];
+    virtio_queue_avail_t* avail = virtio_queue_get_avail(vdev, vqe->vq);
+    const virtio_queue_used_t* used = virtio_queue_get_used(vdev, vqe->vq);
+
+    uint16_t old_avail_index = avail->index;
+
+    if(old_avail_index == new_avail_index) {
+        return false;
+    }
+
+    // ring entries should be visible before index, and index before reading device's event fields
+    asm volatile ("" ::: "memory");
+    avail->index = new_avail_index;
+    asm volatile ("mfence" ::: "memory");
+
+    boolean_t need_notify;
+
+    if(vdev->selected_features & VIRTIO_F_EVENT_IDX) {
+        need_notify = virtio_queue_need_event(*virtio_queue_get_avail_event(vdev, vqe->vq), new_avail_index, old_avail_index);
+    } else {
+        need_notify = !(used->flags & VIRTIO_QUEUE_USED_F_NO_NOTIFY);
+    }
+
+    if(!need_notify) {
+        return false;
+    }
+
+    if(vdev->is_legacy) {
+        outw(vdev->iobase + VIRTIO_IOPORT_VQ_NOTIFY, queue_no);
+    } else if(vdev->selected_features & VIRTIO_F_NOTIFICATION_DATA) {
+        // split ring next offset is whole avail index
+        *((volatile uint32_t*)vqe->nd) = queue_no | ((uint32_t)new_avail_index << 16);
+    } else {
+        vqe->nd->vqn = queue_no;
+    }
+
+    return true;
+}
+
+void virtio_queue_disable_interrupts(virtio_dev_t* vdev, uint16_t queue_no) {
+    virtio_queue_ext_t* vqe = &vdev->queues[queue_no];
+
+    if(vdev->selected_features & VIRTIO_F_EVENT_IDX) {
+        // device interrupts only when used index passes used event, which is a full ring cycle away
+        *virtio_queue_get_used_event(vdev, vqe->vq) = vqe->last_used_index - 1;
+    } else {
+        virtio_queue_get_avail(vdev, vqe->vq)->flags |= VIRTIO_QUEUE_AVAIL_F_NO_INTERRUPT;
+    }
+}
+
+boolean_t virtio_queue_enable_interrupts(virtio_dev_t* vdev, uint16_t queue_no) {
+    virtio_queue_ext_t* vqe = &vdev->queues[queue_no];
+
+    if(vdev->selected_features & VIRTIO_F_EVENT_IDX) {
+        *virtio_queue_get_used_event(vdev, vqe->vq) = vqe->last_used_index;
+    } else {
+        virtio_queue_get_avail(vdev, vqe->vq)->flags &= ~VIRTIO_QUEUE_AVAIL_F_NO_INTERRUPT;
+    }
+
+    // used entries written before device saw the update will not interrupt
+    asm volatile ("mfence" ::: "memory");
+
+    return virtio_queue_get_used(vdev, vqe->vq)->index != vqe->last_used_index;
+}
+
 int8_t virtio_init_legacy(virtio_dev_t* vdev, virtio_select_features_f select_features, virtio_create_queues_f create_queues) {
     PRINTLOG(VIRTIO, LOG_TRACE, "legacy device addr 0x%x", vdev->iobase);
 
@@ -14,6 +14,21 @@
 
 MODULE("turnstone.lib");
 
+/*! blocked filter block size in bits, one cache line */
+#define BLOOMFILTER_BLOCK_BITS 512
+/*! blocked filter block size in uint64_t words */
+#define BLOOMFILTER_BLOCK_WORDS (BLOOMFILTER_BLOCK_BITS / 64)
+/*! multiplier for deriving probe positions inside block from block hash */
+#define BLOOMFILTER_PROBE_MIX 0x9E3779B97F4A7C15ULL
+
+#if defined(__AVX2__)
+/*! four lanes of a block, unaligned loads are allowed */
+typedef uint64_t bloomfilter_lanes_t __attribute__((vector_size(32), aligned(8)));
+#elif defined(__SSE2__)
+/*! two lanes of a block, unaligned loads are allowed */
+typedef uint64_t bloomfilter_lanes_t __attribute__((vector_size(16), aligned(8)));
+#endif
+
 /**
  * @struct bloomfilter_t
  * @brief bloom filter struct
@@ -26,6 +41,8 @@ typedef struct bloomfilter_t {
     uint64_t  hash_seed; ///< xxhash seed
     uint64_t  bit_count; ///< bit count at array
     uint64_t* bits; ///bit array
+    boolean_t blocked; ///< all probes of an entry are inside one 512 bit block
+    uint64_t  block_count; ///< block count of blocked filter
 }bloomfilter_t;
 
 /**
@@ -38,7 +55,7 @@ typedef struct bloomfilter_t {
  */
 boolean_t bloomfilter_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t add);
 
-bloomfilter_t* bloomfilter_new(uint64_t entry_count, float64_t error) {
+static bloomfilter_t* bloomfilter_new_internal(uint64_t entry_count, float64_t error, boolean_t blocked) {
     if(!entry_count || (error < 0 || error >= 1)) {
         return NULL;
     }
@@ -60,9 +77,16 @@ bloomfilter_t* bloomfilter_new(uint64_t entry_count, float64_t error) {
     float64_t dec = entry_count;
     res->bit_count = (uint64_t)(dec * res->bpe);
 
-    uint64_t bc = (res->bit_count + 63) / 64;
+    if(blocked) {
+        res->blocked = true;
+        res->block_count = (res->bit_count + BLOOMFILTER_BLOCK_BITS - 1) / BLOOMFILTER_BLOCK_BITS;
+        res->bit_count = res->block_count * BLOOMFILTER_BLOCK_BITS;
+        res->bits = memory_malloc_aligned(res->bit_count / 8, 64);
+    } else {
+        uint64_t bc = (res->bit_count + 63) / 64;
 
-    res->bits = memory_malloc(bc * sizeof(uint64_t));
+        res->bits = memory_malloc(bc * sizeof(uint64_t));
+    }
 
     if(!res->bits) {
         memory_free(res);
@@ -73,6 +97,97 @@ bloomfilter_t* bloomfilter_new(uint64_t entry_count, float64_t error) {
     return res;
 }
 
+bloomfilter_t* bloomfilter_new(uint64_t entry_count, float64_t error) {
+    return bloomfilter_new_internal(entry_count, error, false);
+}
+
+bloomfilter_t* bloomfilter_new_blocked(uint64_t entry_count, float64_t error) {
+    return bloomfilter_new_internal(entry_count, error, true);
+}
+
+/**
+ * @brief builds probe mask of an entry inside its block
+ * @param[in] bf blocked bloom filter
+ * @param[in] hash entry hash
+ * @param[out] mask block sized probe mask
+ * @return block index
+ */
+static uint64_t bloomfilter_blocked_mask(bloomfilter_t* bf, uint64_t hash, uint64_t* mask) {
+    uint64_t block = (uint64_t)(((uint128_t)hash * bf->block_count) >> 64);
+
+    uint64_t mix = hash * BLOOMFILTER_PROBE_MIX;
+    uint32_t a = mix >> 32;
+    uint32_t b = (uint32_t)mix | 1;
+
+    for(uint64_t i = 0; i < bf->hash_count; i++) {
+        uint32_t x = (a + b * i) % BLOOMFILTER_BLOCK_BITS;
+        mask[x / 64] |= 1ULL << (x % 64);
+    }
+
+    return block;
+}
+
+/**
+ * @brief checks if all bits of mask are set at block
+ * @param[in] block block words
+ * @param[in] mask probe mask
+ * @return true if all probes hit
+ */
+static boolean_t bloomfilter_blocked_test(const uint64_t* block, const uint64_t* mask) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    const bloomfilter_lanes_t* b_lanes = (const bloomfilter_lanes_t*)block;
+    const bloomfilter_lanes_t* m_lanes = (const bloomfilter_lanes_t*)mask;
+    const uint64_t lane_count = sizeof(bloomfilter_lanes_t) / sizeof(uint64_t);
+
+    bloomfilter_lanes_t missing = m_lanes[0] & ~b_lanes[0];
+
+    for(uint64_t i = 1; i < BLOOMFILTER_BLOCK_WORDS / lane_count; i++) {
+        missing |= m_lanes[i] & ~b_lanes[i];
+    }
+
+    uint64_t res = 0;
+
+    for(uint64_t i = 0; i < lane_count; i++) {
+        res |= missing[i];
+    }
+
+    return res == 0;
+#else
+    uint64_t missing = 0;
+
+    for(uint64_t i = 0; i < BLOOMFILTER_BLOCK_WORDS; i++) {
+        missing |= mask[i] & ~block[i];
+    }
+
+    return missing == 0;
+#endif
+}
+
+static boolean_t bloomfilter_blocked_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t add) {
+    uint64_t mask[BLOOMFILTER_BLOCK_WORDS] __attribute__((aligned(64))) = {0};
+
+    uint64_t hash = xxhash64_hash_with_seed((uint8_t*)data->value, data->length, bf->hash_seed);
+    uint64_t block = bloomfilter_blocked_mask(bf, hash, mask);
+
+    uint64_t* block_bits = bf->bits + block * BLOOMFILTER_BLOCK_WORDS;
+
+    if(!add) {
+        return bloomfilter_blocked_test(block_bits, mask);
+    }
+
+    for(uint64_t i = 0; i < BLOOMFILTER_BLOCK_WORDS; i++) {
+        uint64_t m = mask[i];
+
+        while(m) {
+            uint8_t bit = __builtin_ctzll(m);
+            bit_set_atomic(block_bits + i, bit);
+            m &= m - 1;
+        }
+    }
+
+    return true;
+}
+
 boolean_t bloomfilter_destroy(bloomfilter_t* bf) {
     if(!bf) {
         return true;
@@ -92,6 +207,10 @@ boolean_t bloomfilter_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t ad
         return false;
     }
 
+    if(bf->blocked) {
+        return bloomfilter_blocked_check_or_add(bf, data, add);
+    }
+
     uint64_t hits = 0;
 
     uint64_t a = xxhash64_hash_with_seed((uint8_t*)data->value, data->length, bf->hash_seed);
@@ -103,7 +222,7 @@ boolean_t bloomfilter_check_or_add(bloomfilter_t* bf, data_t* data, boolean_t ad
         x = (a + b * i) % bf->bit_count;
         boolean_t check = bit_test(bf->bits + (x / 64), x % 64);
         if(add) {
-            bit_set(bf->bits + (x / 64), x % 64);
+            bit_set_atomic(bf->bits + (x / 64), x % 64);
             hits++;
         } else if(check) {
             hits++;
@@ -133,9 +252,10 @@ data_t* bloomfilter_serialize(bloomfilter_t* bf) {
         return NULL;
     }
 
+    // classic filters keep seven fields, so filters written before blocked ones deserialize as before
     data_t d = {0};
     d.type = DATA_TYPE_DATA;
-    d.length = 7;
+    d.length = bf->blocked ? 8 : 7;
 
     data_t* fields = memory_malloc(sizeof(data_t) * d.length);
 
@@ -171,6 +291,11 @@ data_t* bloomfilter_serialize(bloomfilter_t* bf) {
     fields[6].value = bf->bits;
     fields[6].length = (bf->bit_count + 63) / 64;
 
+    if(bf->blocked) {
+        fields[7].type = DATA_TYPE_INT64;
+        fields[7].value = (void*)bf->block_count;
+    }
+
     d.value = fields;
 
     data_t* res = data_bson_serialize(&d);
@@ -195,7 +320,7 @@ bloomfilter_t* bloomfilter_deserialize(data_t* data) {
         return NULL;
     }
 
-    if(bf_data->length != 7 || bf_data->value == NULL) {
+    if((bf_data->length != 7 && bf_data->length != 8) || bf_data->value == NULL) {
         data_free(bf_data);
 
         return NULL;
@@ -214,6 +339,31 @@ bloomfilter_t* bloomfilter_deserialize(data_t* data) {
     uint64_t hash_seed = (uint64_t)fields[4].value;
     uint64_t bit_count = (uint64_t)fields[5].value;
     uint64_t* bits = (uint64_t*)fields[6].value;
+    uint64_t block_count = 0;
+
+    if(bf_data->length == 8) {
+        block_count = (uint64_t)fields[7].value;
+
+        if(!block_count || block_count * BLOOMFILTER_BLOCK_BITS != bit_count || fields[6].length != bit_count / 64) {
+            data_free(bf_data);
+
+            return NULL;
+        }
+
+        // blocks are aligned to cache lines, so each probe touches one line
+        uint64_t* aligned_bits = memory_malloc_aligned(bit_count / 8, 64);
+
+        if(!aligned_bits) {
+            data_free(bf_data);
+
+            return NULL;
+        }
+
+        memory_memcopy(bits, aligned_bits, bit_count / 8);
+        memory_free(bits);
+        fields[6].value = aligned_bits;
+        bits = aligned_bits;
+    }
 
     bloomfilter_t* res = memory_malloc(sizeof(bloomfilter_t));
 
@@ -230,6 +380,8 @@ bloomfilter_t* bloomfilter_deserialize(data_t* data) {
     res->hash_seed = hash_seed;
     res->bit_count = bit_count;
     res->bits = bits;
+    res->blocked = block_count != 0;
+    res->block_count = block_count;
 
     memory_free(fields);
     memory_free(bf_data);
@@ -1275,6 +1275,10 @@ iterator_t* bplustree_search(index_t* idx, const void* key1, const void* key2, c
                             if(c_res == 0) {
                                 iter->end_of_iter = 1;
                                 break;
+                            } else if(c_res < 0 && criteria != INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL) {
+                                // range starts at first key greater than missing key1
+                                iter->end_of_iter = 1;
+                                break;
                             } else if(c_res < 0)  {
                                 iter->current_node = NULL;
                                 iter->current_index = 0;
@@ -1306,6 +1310,13 @@ iterator_t* bplustree_search(index_t* idx, const void* key1, const void* key2, c
 
                     k_iter->destroy(k_iter);
 
+                    if(criteria == INDEXER_KEY_COMPARATOR_CRITERIA_BETWEEN && iter->current_node != NULL &&
+                       iter->comparator(list_get_data_at_position(iter->current_node->keys, iter->current_index), key2) > 0) {
+                        iter->current_node = NULL;
+                        iter->current_index = 0;
+                        iter->end_of_iter = 0;
+                    }
+
                 } else {
                     iter->end_of_iter = 1;
                 }
@@ -13,109 +13,83 @@
 
 MODULE("turnstone.lib");
 
+/*! minimum limit of one shard, smaller caches use less shards */
+#define CACHE_SHARD_MIN_LIMIT_COUNT 64
+/*! minimum size limit of one shard, smaller caches use less shards */
+#define CACHE_SHARD_MIN_LIMIT_SIZE  (64 << 10)
+
 typedef struct cache_item_t cache_item_t;
 
 struct cache_item_t {
     const void*   key;
     const void*   item;
     uint64_t      size;
+    boolean_t     referenced;
     cache_item_t* previous;
     cache_item_t* next;
 };
 
+/**
+ * @brief one shard of cache, items are at a clock ring, hits only mark referenced flag
+ */
+typedef struct cache_shard_t {
+    lock_t*       lock;
+    hashmap_t*    map;
+    cache_item_t* hand;
+    uint64_t      size;
+    uint64_t      limit;
+} cache_shard_t;
+
 struct cache_t {
     cache_config_t config;
-    cache_item_t*  mru_list_head;
-    cache_item_t*  mru_list_tail;
-    hashmap_t*     mru_map;
-    uint64_t       mru_size;
-    cache_item_t*  lru_list_head;
-    cache_item_t*  lru_list_tail;
-    hashmap_t*     lru_map;
-    uint64_t       lru_size;
-    lock_t*        lock;
+    uint64_t       shard_count;
+    uint64_t       shard_bits;
+    cache_shard_t* shards;
 };
 
-static inline int8_t cache_insert_head(cache_t* cache, boolean_t mru, cache_item_t* ci) {
-    if(!cache || !ci) {
-        return -1;
-    }
-
-    if(mru) {
-        if(cache->mru_list_head) {
-            cache->mru_list_head->previous = ci;
-        }
-
-        ci->next = cache->mru_list_head;
-        ci->previous = NULL;
-        cache->mru_list_head = ci;
-
-        if(!cache->mru_list_tail) {
-            cache->mru_list_tail = ci;
-        }
-    } else {
-        if(cache->lru_list_head) {
-            cache->lru_list_head->previous = ci;
-        }
-
-        ci->next = cache->lru_list_head;
-        ci->previous = NULL;
-        cache->lru_list_head = ci;
+static inline void cache_ring_insert(cache_shard_t* shard, cache_item_t* ci) {
+    if(!shard->hand) {
+        ci->next = ci;
+        ci->previous = ci;
+        shard->hand = ci;
 
-        if(!cache->lru_list_tail) {
-            cache->lru_list_tail = ci;
-        }
+        return;
     }
 
-    return 0;
+    // new item is placed behind hand, so it is examined last
+    ci->next = shard->hand;
+    ci->previous = shard->hand->previous;
+    shard->hand->previous->next = ci;
+    shard->hand->previous = ci;
 }
 
-static inline int8_t cache_delete_item(cache_t* cache, boolean_t mru, cache_item_t* ci) {
-    if(!cache || !ci) {
-        return -1;
-    }
-
-    if(mru) {
-        if(ci->previous) {
-            ci->previous->next = ci->next;
-        } else {
-            cache->mru_list_head = ci->next;
-        }
-
-        if(ci->next) {
-            ci->next->previous = ci->previous;
-        } else {
-            cache->mru_list_tail = ci->previous;
-        }
+static inline void cache_ring_delete(cache_shard_t* shard, cache_item_t* ci) {
+    if(ci->next == ci) {
+        shard->hand = NULL;
     } else {
-        if(ci->previous) {
-            ci->previous->next = ci->next;
-        } else {
-            cache->lru_list_head = ci->next;
-        }
+        ci->previous->next = ci->next;
+        ci->next->previous = ci->previous;
 
-        if(ci->next) {
-            ci->next->previous = ci->previous;
-        } else {
-            cache->lru_list_tail = ci->previous;
+        if(shard->hand == ci) {
+            shard->hand = ci->next;
         }
     }
 
     ci->previous = NULL;
     ci->next = NULL;
-
-    return 0;
 }
 
-static inline int8_t cache_move_to_head(cache_t* cache, boolean_t mru, cache_item_t* ci) {
-    if(!cache || !ci) {
-        return -1;
+static inline cache_shard_t* cache_get_shard(cache_t* cache, const void* key) {
+    if(cache->shard_count == 1) {
+        return cache->shards;
     }
 
-    cache_delete_item(cache, mru, ci);
-    cache_insert_head(cache, mru, ci);
+    uint64_t hash = cache->config.key_generator ? cache->config.key_generator(key) : (uint64_t)key;
 
-    return 0;
+    // fibonacci hashing spreads pointer and small integer keys over shards
+    hash *= 0x9E3779B97F4A7C15ULL;
+
+    return &cache->shards[hash >> (64 - cache->shard_bits)];
 }
 
 cache_t* cache_new (cache_config_t * config) {
@@ -131,101 +105,106 @@ cache_t* cache_new (cache_config_t * config) {
 
     memory_memcopy(config, cache, sizeof(cache_config_t));
 
-    cache->mru_map = hashmap_new_with_hkg_with_hkc(128, cache->config.key_generator, cache->config.key_comparator);
-    cache->lru_map = hashmap_new_with_hkg_with_hkc(128, cache->config.key_generator, cache->config.key_comparator);
-
-    if(!cache->mru_map || !cache->lru_map) {
-        hashmap_destroy(cache->mru_map);
-        hashmap_destroy(cache->lru_map);
-        memory_free(cache);
+    uint64_t shard_count = config->shard_count ? config->shard_count : CACHE_DEFAULT_SHARD_COUNT;
+    uint64_t min_limit = config->policy == CACHE_POLICY_COUNT ? CACHE_SHARD_MIN_LIMIT_COUNT : CACHE_SHARD_MIN_LIMIT_SIZE;
 
-        return NULL;
+    if(shard_count & (shard_count - 1)) {
+        PRINTLOG(KERNEL, LOG_WARNING, "cache shard count 0x%llx is not power of two, using default", shard_count);
+        shard_count = CACHE_DEFAULT_SHARD_COUNT;
     }
 
-    cache->lock = lock_create();
-
-    return cache;
-}
-
-boolean_t cache_destroy (cache_t * cache) {
-    if(!cache) {
-        return true;
+    while(shard_count > 1 && config->hard_limit / shard_count < min_limit) {
+        shard_count >>= 1;
     }
 
-    cache_item_t* ci;
+    cache->shard_count = shard_count;
 
-    ci = cache->mru_list_head;
-
-    while(ci) {
-        cache_item_t* next = ci->next;
+    while((1ULL << cache->shard_bits) < shard_count) {
+        cache->shard_bits++;
+    }
 
-        cache->config.item_key_destroyer(ci->key, ci->item);
+    cache->shards = memory_malloc(sizeof(cache_shard_t) * shard_count);
 
-        memory_free(ci);
+    if(!cache->shards) {
+        memory_free(cache);
 
-        ci = next;
+        return NULL;
     }
 
-    hashmap_destroy(cache->mru_map);
+    for(uint64_t i = 0; i < shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
 
-    ci = cache->lru_list_head;
+        shard->limit = config->hard_limit / shard_count;
+        shard->map = hashmap_new_with_hkg_with_hkc(128, cache->config.key_generator, cache->config.key_comparator);
+        shard->lock = lock_create();
 
-    while(ci) {
-        cache_item_t* next = ci->next;
+        if(!shard->map || !shard->lock) {
+            hashmap_destroy(shard->map);
+            lock_destroy(shard->lock);
+            shard->map = NULL;
+            shard->lock = NULL;
 
-        cache->config.item_key_destroyer(ci->key, ci->item);
+            cache_destroy(cache);
 
-        memory_free(ci);
-
-        ci = next;
+            return NULL;
+        }
     }
 
-    hashmap_destroy(cache->lru_map);
-
-    lock_destroy(cache->lock);
-
-    memory_free(cache);
-
-    return true;
+    return cache;
 }
 
-static boolean_t cache_put_ci(cache_t * cache, cache_item_t* ci) {
+boolean_t cache_destroy (cache_t * cache) {
     if(!cache) {
-        return false;
+        return true;
     }
 
-    cache_insert_head(cache, true, ci);
+    for(uint64_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t* shard = &cache->shards[i];
 
-    hashmap_put(cache->mru_map, ci->key, ci);
+        if(!shard->map) {
+            continue;
+        }
 
-    cache->mru_size += ci->size;
+        while(shard->hand) {
+            cache_item_t* ci = shard->hand;
 
-    if(cache->mru_size > cache->config.soft_limit) {
-        cache_item_t* old_ci = cache->mru_list_tail;
+            cache_ring_delete(shard, ci);
 
-        cache_delete_item(cache, true, old_ci);
-        hashmap_delete(cache->mru_map, old_ci->key);
-        cache->mru_size -= old_ci->size;
+            cache->config.item_key_destroyer(ci->key, ci->item);
 
-        cache_insert_head(cache, false, old_ci);
+            memory_free(ci);
+        }
 
-        hashmap_put(cache->lru_map, old_ci->key, old_ci);
+        hashmap_destroy(shard->map);
+        lock_destroy(shard->lock);
+    }
 
-        cache->lru_size += old_ci->size;
+    memory_free(cache->shards);
+    memory_free(cache);
 
-        if(cache->mru_size + cache->lru_size > cache->config.hard_limit) {
-            old_ci = cache->lru_list_tail;
-            cache_delete_item(cache, false, old_ci);
-            hashmap_delete(cache->lru_map, old_ci->key);
-            cache->lru_size -= old_ci->size;
+    return true;
+}
 
-            cache->config.item_key_destroyer(old_ci->key, old_ci->item);
+static void cache_shard_evict(cache_t* cache, cache_shard_t* shard, const cache_item_t* keep) {
+    while(shard->size > shard->limit && shard->hand && shard->hand->next != shard->hand) {
+        cache_item_t* ci = shard->hand;
 
-            memory_free(old_ci);
+        if(ci == keep || ci->referenced) {
+            // second chance
+            ci->referenced = false;
+            shard->hand = ci->next;
+
+            continue;
         }
-    }
 
-    return true;
+        cache_ring_delete(shard, ci);
+        hashmap_delete(shard->map, ci->key);
+        shard->size -= ci->size;
+
+        cache->config.item_key_destroyer(ci->key, ci->item);
+
+        memory_free(ci);
+    }
 }
 
 #pragma GCC diagnostic push
@@ -243,9 +222,36 @@ boolean_t cache_put(cache_t * cache, const void* key, const void* item, uint64_t
 
     ci->item = item;
     ci->key = key;
-    ci->size = size;
+    ci->size = cache->config.policy == CACHE_POLICY_COUNT ? 1 : size;
+
+    cache_shard_t* shard = cache_get_shard(cache, key);
+
+    lock_acquire(shard->lock);
+
+    cache_item_t* old_ci = (cache_item_t*)hashmap_put(shard->map, ci->key, ci);
 
-    return cache_put_ci(cache, ci);
+    if(old_ci) {
+        cache_ring_delete(shard, old_ci);
+        shard->size -= old_ci->size;
+
+        if(old_ci->item != item) {
+            cache->config.item_key_destroyer(old_ci->key, old_ci->item);
+        } else if(old_ci->key != key) {
+            // item stays at cache with the new key, old key is not reachable anymore
+            cache->config.item_key_destroyer(old_ci->key, NULL);
+        }
+
+        memory_free(old_ci);
+    }
+
+    cache_ring_insert(shard, ci);
+    shard->size += ci->size;
+
+    cache_shard_evict(cache, shard, ci);
+
+    lock_release(shard->lock);
+
+    return true;
 }
 #pragma GCC diagnostic pop
 
@@ -254,25 +260,20 @@ const void* cache_get(cache_t* cache, const void* key) {
         return NULL;
     }
 
-    cache_item_t* ci = (cache_item_t*)hashmap_get(cache->mru_map, key);
+    cache_shard_t* shard = cache_get_shard(cache, key);
 
-    if(ci) {
-        cache_move_to_head(cache, true, ci);
+    const void* item = NULL;
 
-        return ci->item;
-    }
+    lock_acquire(shard->lock);
 
-    ci = (cache_item_t*)hashmap_get(cache->lru_map, key);
+    cache_item_t* ci = (cache_item_t*)hashmap_get(shard->map, key);
 
     if(ci) {
-        cache_delete_item(cache, false, ci);
-        hashmap_delete(cache->lru_map, ci->key);
-        cache->lru_size -= ci->size;
-
-        cache_put_ci(cache, ci);
-
-        return ci->item;
+        ci->referenced = true;
+        item = ci->item;
     }
 
-    return NULL;
+    lock_release(shard->lock);
+
+    return item;
 }
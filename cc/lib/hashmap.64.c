@@ -11,29 +11,71 @@
 #include <cpu/sync.h>
 #include <xxhash.h>
 #include <strings.h>
+#include <utils.h>
 
 /*! module name */
 MODULE("turnstone.lib.hashmap");
 
+/*! slot count of a group, groups are probed at once */
+#define HASHMAP_GROUP_SIZE 16
+/*! control byte of a never used slot */
+#define HASHMAP_CTRL_EMPTY ((int8_t)-128)
+/*! control byte of a deleted slot, probing continues over it */
+#define HASHMAP_CTRL_DELETED ((int8_t)-2)
+/*! groups of old table moved to new table at each insert while resizing */
+#define HASHMAP_MIGRATE_GROUPS 2
+/*! reader counter stripes of map, readers of different stacks mostly use different cache lines */
+#define HASHMAP_READER_STRIPES 16
+
+#if defined(__SSE2__)
+/*! control bytes of a group */
+typedef char hashmap_ctrl_group_t __attribute__((vector_size(HASHMAP_GROUP_SIZE)));
+#endif
+
 /**
  * @struct hashmap_item_t
  * @brief hashmap item
  */
 typedef struct hashmap_item_t {
-    boolean_t   exists; ///< item exists
     const void* key; ///< item key
     const void* value; ///< item value
 } hashmap_item_t; ///< hashmap item
 
 /**
- * @struct hashmap_segment_t
- * @brief hashmap segment
+ * @struct hashmap_table_t
+ * @brief open addressing table, each slot has a control byte which is empty, deleted or 7 bits of key hash
+ */
+typedef struct hashmap_table_t {
+    uint64_t                group_count; ///< group count, power of two
+    uint64_t                capacity; ///< slot count
+    uint64_t                size; ///< full slot count
+    uint64_t                deleted_count; ///< deleted slot count
+    int8_t*                 ctrl; ///< control bytes
+    hashmap_item_t*         items; ///< items at slots
+    volatile uint32_t*      versions; ///< group versions of concurrent map, odd while group is written
+    uint64_t                retire_epoch; ///< epoch when table is retired
+    struct hashmap_table_t* next; ///< next retired table
+} hashmap_table_t; ///< hashmap table
+
+/**
+ * @struct hashmap_reader_stripe_t
+ * @brief active reader counts of a stripe for two epoch parities
+ */
+typedef struct hashmap_reader_stripe_t {
+    volatile uint64_t counts[2]; ///< reader counts of even and odd epochs
+    uint8_t           padding[48]; ///< stripes do not share cache lines
+} __attribute__((aligned(64))) hashmap_reader_stripe_t; ///< hashmap reader stripe
+
+/**
+ * @struct hashmap_retired_t
+ * @brief data retired from a concurrent map, reclaimed when readers which may see it are gone
  */
-typedef struct hashmap_segment_t {
-    uint64_t                  size; ///< segment size
-    struct hashmap_segment_t* next; ///< next segment
-    hashmap_item_t*           items; ///< items at segment
-} hashmap_segment_t; ///< hashmap segment
+typedef struct hashmap_retired_t {
+    void*                     data; ///< retired data
+    hashmap_reclaimer_f       reclaimer; ///< reclaimer of data
+    uint64_t                  epoch; ///< epoch when data is retired
+    struct hashmap_retired_t* next; ///< next retired data
+} hashmap_retired_t; ///< hashmap retired data
 
 /**
  * @struct hashmap_t
@@ -41,19 +83,24 @@ typedef struct hashmap_segment_t {
  */
 struct hashmap_t {
     memory_heap_t*           heap; ///< heap
-    uint64_t                 segment_capacity; ///< segment capacity
-    uint64_t                 total_capacity; ///< total capacity
     uint64_t                 total_size; ///< total size
     hashmap_key_generator_f  hkg; ///< key generator
     hashmap_key_comparator_f hkc; ///< key comparator
-    hashmap_segment_t*       segments; ///< segments
+    hashmap_table_t*         table; ///< current table, new items are inserted here
+    hashmap_table_t*         old_table; ///< table which is moved to current table while resizing
+    uint64_t                 migrate_group; ///< next group of old table to move
+    hashmap_table_t*         retired_tables; ///< moved tables, readers do not lock so they are reclaimed with epochs or at destroy
     lock_t*                  lock; ///< lock
+    boolean_t                concurrent; ///< readers validate groups with versions and retired data waits for them
+    volatile uint64_t        epoch; ///< reclamation epoch
+    hashmap_reader_stripe_t* readers; ///< active reader counts
+    hashmap_retired_t*       retired_items; ///< data retired by users of concurrent map
 }; ///< hashmap
 
 /**
  * @brief default key generator
  * @param[in] key key
- * @return key hash xxhash64
+ * @return key itself, hashmap mixes it
  */
 uint64_t hashmap_default_kg(const void* key);
 
@@ -112,278 +159,776 @@ int8_t hashmap_string_kc(const void* item1, const void* item2) {
     return strcmp(ti1, ti2);
 }
 
-hashmap_t*  hashmap_new_with_hkg_with_hkc(uint64_t capacity, hashmap_key_generator_f hkg, hashmap_key_comparator_f hkc) {
-    if(!capacity) {
-        return NULL;
+/**
+ * @brief mixes generated key, integer and pointer keys have their entropy at few bits
+ * @param[in] hm hashmap
+ * @param[in] key key
+ * @return key hash
+ */
+static inline uint64_t hashmap_hash(hashmap_t* hm, const void* key) {
+    uint64_t h = hm->hkg(key);
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+/**
+ * @brief returns slot mask of group whose control bytes equal to value
+ * @param[in] group control bytes of group
+ * @param[in] value control byte
+ * @return bit i is set if slot i matches
+ */
+static inline uint32_t hashmap_group_match(const int8_t* group, int8_t value) {
+#if defined(__SSE2__)
+    hashmap_ctrl_group_t g = *(const hashmap_ctrl_group_t*)group;
+    hashmap_ctrl_group_t v = {0};
+
+    v += (char)value;
+
+    return (uint32_t)__builtin_ia32_pmovmskb128((hashmap_ctrl_group_t)(g == v));
+#else
+    uint32_t res = 0;
+
+    for(uint32_t i = 0; i < HASHMAP_GROUP_SIZE; i++) {
+        if(group[i] == value) {
+            res |= 1U << i;
+        }
     }
 
-    memory_heap_t* heap = memory_get_heap(NULL);
+    return res;
+#endif
+}
 
-    hashmap_t* hm = memory_malloc_ext(heap, sizeof(hashmap_t), 0);
+/**
+ * @brief returns slot mask of group whose slots are empty or deleted
+ * @param[in] group control bytes of group
+ * @return bit i is set if slot i is free
+ */
+static inline uint32_t hashmap_group_match_free(const int8_t* group) {
+#if defined(__SSE2__)
+    return (uint32_t)__builtin_ia32_pmovmskb128(*(const hashmap_ctrl_group_t*)group);
+#else
+    uint32_t res = 0;
+
+    for(uint32_t i = 0; i < HASHMAP_GROUP_SIZE; i++) {
+        if(group[i] < 0) {
+            res |= 1U << i;
+        }
+    }
 
-    if(!hm) {
+    return res;
+#endif
+}
+
+static hashmap_table_t* hashmap_table_new(memory_heap_t* heap, uint64_t group_count, boolean_t concurrent) {
+    hashmap_table_t* t = memory_malloc_ext(heap, sizeof(hashmap_table_t), 0);
+
+    if(!t) {
         return NULL;
     }
 
-    hm->heap = heap;
+    t->group_count = group_count;
+    t->capacity = group_count * HASHMAP_GROUP_SIZE;
 
-    hm->lock = lock_create_with_heap(heap);
+    t->ctrl = memory_malloc_ext(heap, t->capacity, HASHMAP_GROUP_SIZE);
 
-    hm->total_capacity = capacity;
-    hm->segment_capacity = capacity;
+    if(!t->ctrl) {
+        memory_free_ext(heap, t);
 
-    hm->hkg = hkg?hkg:hashmap_default_kg;
-    hm->hkc = hkc?hkc:hashmap_default_kc;
+        return NULL;
+    }
 
-    hm->segments = memory_malloc_ext(heap, sizeof(hashmap_segment_t), 0);
+    memory_memset(t->ctrl, (uint8_t)HASHMAP_CTRL_EMPTY, t->capacity);
 
-    if(!hm->segments) {
-        memory_free_ext(heap, hm);
+    t->items = memory_malloc_ext(heap, sizeof(hashmap_item_t) * t->capacity, 0);
+
+    if(!t->items) {
+        memory_free_ext(heap, t->ctrl);
+        memory_free_ext(heap, t);
 
         return NULL;
     }
 
-    hm->segments->items = memory_malloc_ext(heap, sizeof(hashmap_item_t) * hm->segment_capacity, 0);
+    if(concurrent) {
+        t->versions = memory_malloc_ext(heap, sizeof(uint32_t) * group_count, 0);
 
-    if(!hm->segments->items) {
-        memory_free_ext(heap, hm->segments);
-        memory_free_ext(heap, hm);
+        if(!t->versions) {
+            memory_free_ext(heap, t->items);
+            memory_free_ext(heap, t->ctrl);
+            memory_free_ext(heap, t);
 
-        return NULL;
+            return NULL;
+        }
     }
 
-    return hm;
+    return t;
 }
 
-hashmap_t* hashmap_string(uint64_t capacity) {
-    return hashmap_new_with_hkg_with_hkc(capacity, hashmap_string_kg, hashmap_string_kc);
+static void hashmap_table_destroy(memory_heap_t* heap, hashmap_table_t* t) {
+    memory_free_ext(heap, (void*)t->versions);
+    memory_free_ext(heap, t->items);
+    memory_free_ext(heap, t->ctrl);
+    memory_free_ext(heap, t);
 }
 
-boolean_t   hashmap_destroy(hashmap_t* hm) {
-    if(!hm) {
-        return false;
+/**
+ * @brief starts writing a group of concurrent map, readers of group retry until write ends
+ * @param[in] t table
+ * @param[in] group group index
+ */
+static inline void hashmap_group_write_begin(hashmap_table_t* t, uint64_t group) {
+    if(t->versions) {
+        t->versions[group]++;
+
+        asm volatile ("" ::: "memory");
     }
+}
 
-    memory_heap_t* heap = hm->heap;
+/**
+ * @brief ends writing a group of concurrent map
+ * @param[in] t table
+ * @param[in] group group index
+ */
+static inline void hashmap_group_write_end(hashmap_table_t* t, uint64_t group) {
+    if(t->versions) {
+        asm volatile ("" ::: "memory");
 
-    hashmap_segment_t* seg = hm->segments;
+        t->versions[group]++;
+    }
+}
 
-    while(seg) {
-        hashmap_segment_t* t_seg = seg->next;
+/**
+ * @brief finds slot of key at table with group probing
+ * @param[in] hm hashmap
+ * @param[in] t table
+ * @param[in] key key
+ * @param[in] hash key hash
+ * @return slot index or -1ULL if key does not exist
+ */
+static uint64_t hashmap_table_find(hashmap_t* hm, hashmap_table_t* t, const void* key, uint64_t hash) {
+    const int8_t h2 = hash & 0x7F;
+    const uint64_t group_mask = t->group_count - 1;
+    uint64_t group = (hash >> 7) & group_mask;
+
+    for(uint64_t step = 1; step <= t->group_count; step++) {
+        const int8_t* ctrl = t->ctrl + group * HASHMAP_GROUP_SIZE;
+
+        uint32_t match = hashmap_group_match(ctrl, h2);
+
+        while(match) {
+            uint64_t slot = group * HASHMAP_GROUP_SIZE + __builtin_ctz(match);
 
-        memory_free_ext(heap, seg->items);
-        memory_free_ext(heap, seg);
+            if(hm->hkc(key, t->items[slot].key) == 0) {
+                return slot;
+            }
+
+            match &= match - 1;
+        }
+
+        // a probe never passes a group with an empty slot
+        if(hashmap_group_match(ctrl, HASHMAP_CTRL_EMPTY)) {
+            break;
+        }
 
-        seg = t_seg;
+        // triangular steps visit each group once when group count is power of two
+        group = (group + step) & group_mask;
     }
 
-    lock_destroy(hm->lock);
-    memory_free_ext(heap, hm);
+    return -1ULL;
+}
 
-    return NULL;
+/**
+ * @brief puts a key which does not exist at table, table should have a free slot
+ * @param[in] t table
+ * @param[in] key key
+ * @param[in] value value
+ * @param[in] hash key hash
+ */
+static void hashmap_table_insert(hashmap_table_t* t, const void* key, const void* value, uint64_t hash) {
+    const uint64_t group_mask = t->group_count - 1;
+    uint64_t group = (hash >> 7) & group_mask;
+
+    for(uint64_t step = 1; step <= t->group_count; step++) {
+        uint32_t free_slots = hashmap_group_match_free(t->ctrl + group * HASHMAP_GROUP_SIZE);
+
+        if(free_slots) {
+            uint64_t slot = group * HASHMAP_GROUP_SIZE + __builtin_ctz(free_slots);
+
+            if(t->ctrl[slot] == HASHMAP_CTRL_DELETED) {
+                t->deleted_count--;
+            }
+
+            hashmap_group_write_begin(t, group);
+
+            t->items[slot].key = key;
+            t->items[slot].value = value;
+
+            // readers do not lock, item should be visible before its control byte
+            asm volatile ("" ::: "memory");
+
+            t->ctrl[slot] = hash & 0x7F;
+
+            hashmap_group_write_end(t, group);
+
+            t->size++;
+
+            return;
+        }
+
+        group = (group + step) & group_mask;
+    }
+}
+
+/**
+ * @brief marks slot free, slot becomes empty if its group already stops probes
+ * @param[in] t table
+ * @param[in] slot slot index
+ */
+static void hashmap_table_erase(hashmap_table_t* t, uint64_t slot) {
+    const int8_t* group = t->ctrl + (slot / HASHMAP_GROUP_SIZE) * HASHMAP_GROUP_SIZE;
+
+    hashmap_group_write_begin(t, slot / HASHMAP_GROUP_SIZE);
+
+    if(hashmap_group_match(group, HASHMAP_CTRL_EMPTY)) {
+        t->ctrl[slot] = HASHMAP_CTRL_EMPTY;
+    } else {
+        t->ctrl[slot] = HASHMAP_CTRL_DELETED;
+        t->deleted_count++;
+    }
+
+    hashmap_group_write_end(t, slot / HASHMAP_GROUP_SIZE);
+
+    t->size--;
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
 /**
- * @brief get next new segment
+ * @brief moves some groups of old table to current table, empty old table is retired for readers
  * @param[in] hm hashmap
- * @param[in] seg segment
- * @return next new segment
+ * @param[in] group_count group count to move, 0 moves all remaining groups
  */
-static hashmap_segment_t* hashmap_segment_next_new(hashmap_t* hm, hashmap_segment_t* seg) {
-    while(seg->next) {
-        seg = seg->next;
+static void hashmap_migrate(hashmap_t* hm, uint64_t group_count) {
+    hashmap_table_t* old = hm->old_table;
+
+    if(!old) {
+        return;
     }
 
-    seg->next = memory_malloc_ext(hm->heap, sizeof(hashmap_segment_t), 0);
+    uint64_t end = group_count ? MIN(hm->migrate_group + group_count, old->group_count) : old->group_count;
 
-    if(!seg->next) {
-        return NULL;
+    for(; hm->migrate_group < end; hm->migrate_group++) {
+        for(uint64_t i = 0; i < HASHMAP_GROUP_SIZE; i++) {
+            uint64_t slot = hm->migrate_group * HASHMAP_GROUP_SIZE + i;
+
+            if(old->ctrl[slot] < 0) {
+                continue;
+            }
+
+            const void* key = old->items[slot].key;
+
+            // item is visible at new table before it leaves old one
+            hashmap_table_insert(hm->table, key, old->items[slot].value, hashmap_hash(hm, key));
+
+            asm volatile ("" ::: "memory");
+
+            hashmap_table_erase(old, slot);
+        }
     }
 
-    seg->next->items = memory_malloc_ext(hm->heap, sizeof(hashmap_item_t) * hm->segment_capacity, 0);
+    if(hm->migrate_group == old->group_count) {
+        hm->old_table = NULL;
 
-    if(!seg->next->items) {
-        memory_free_ext(hm->heap, seg->next);
+        asm volatile ("mfence" ::: "memory");
 
-        return NULL;
+        old->retire_epoch = hm->epoch;
+        old->next = hm->retired_tables;
+        hm->retired_tables = old;
+    }
+}
+
+/**
+ * @brief starts resize if current table cannot take one more item under 7/8 load
+ * @details live items double table, tables full of deleted slots are rebuilt with same size
+ * @param[in] hm hashmap
+ * @return false if new table cannot be created
+ */
+static boolean_t hashmap_reserve(hashmap_t* hm) {
+    hashmap_table_t* t = hm->table;
+
+    if((t->size + t->deleted_count + 1) * 8 <= t->capacity * 7) {
+        return true;
+    }
+
+    // one resize at a time, remaining groups of previous one are moved now. previous resize doubled table and moved
+    // two groups per insert, so it is already done before table fills again
+    hashmap_migrate(hm, 0);
+
+    uint64_t group_count = t->group_count;
+
+    if(t->size * 2 >= t->capacity) {
+        group_count *= 2;
+    }
+
+    hashmap_table_t* n_t = hashmap_table_new(hm->heap, group_count, hm->concurrent);
+
+    if(!n_t) {
+        return false;
     }
 
-    hm->total_capacity += hm->segment_capacity;
+    hm->migrate_group = 0;
+    hm->old_table = t;
 
-    seg = seg->next;
+    asm volatile ("" ::: "memory");
 
-    return seg;
+    hm->table = n_t;
+
+    // same sized rebuild needs free slots before first insert
+    if(group_count == t->group_count) {
+        hashmap_migrate(hm, 0);
+    }
+
+    return true;
 }
-#pragma GCC diagnostic pop
 
-const void* hashmap_put(hashmap_t* hm, const void* key, const void* item) {
-    if(!hm) {
-        return NULL;
+/**
+ * @brief finds the table and slot of key, old table is checked first while resizing
+ * @param[in] hm hashmap
+ * @param[in] key key
+ * @param[out] table table of key
+ * @return slot index or -1ULL if key does not exist
+ */
+static uint64_t hashmap_find(hashmap_t* hm, const void* key, hashmap_table_t** table) {
+    uint64_t hash = hashmap_hash(hm, key);
+
+    hashmap_table_t* old = hm->old_table;
+
+    if(old) {
+        uint64_t slot = hashmap_table_find(hm, old, key, hash);
+
+        if(slot != -1ULL) {
+            *table = old;
+
+            return slot;
+        }
     }
 
-    lock_acquire(hm->lock);
+    hashmap_table_t* t = hm->table;
 
-    uint64_t h_key = hm->hkg(key) % hm->segment_capacity;
+    *table = t;
 
-    hashmap_segment_t* seg = hm->segments;
+    return hashmap_table_find(hm, t, key, hash);
+}
+
+/**
+ * @brief enters a reader section of map, retired data is not reclaimed until reader exits
+ * @param[in] hm hashmap
+ * @param[out] stripe reader stripe
+ * @return epoch of reader
+ */
+static uint64_t hashmap_read_enter(hashmap_t* hm, uint64_t* stripe) {
+    // stacks of tasks are at different pages, so concurrent readers mostly pick different stripes
+    uint64_t s = ((uint64_t)__builtin_frame_address(0) >> 12) % HASHMAP_READER_STRIPES;
 
     while(true) {
-        if(seg->items[h_key].exists) {
-            if(hm->hkc(key, seg->items[h_key].key) == 0) {
-                const void* old_item = seg->items[h_key].value;
+        uint64_t epoch = hm->epoch;
 
-                seg->items[h_key].key = key;
-                seg->items[h_key].value = item;
-                seg->items[h_key].exists = true;
+        asm volatile ("lock incq %0" : "+m" (hm->readers[s].counts[epoch & 1]) : : "memory");
 
-                lock_release(hm->lock);
+        // epoch is flipped while entering, reader should count at new parity
+        if(hm->epoch == epoch) {
+            *stripe = s;
 
-                return old_item;
-            }
+            return epoch;
+        }
 
-            uint64_t t_h_key = (h_key + 1) % hm->segment_capacity;
+        asm volatile ("lock decq %0" : "+m" (hm->readers[s].counts[epoch & 1]) : : "memory");
+    }
+}
 
-            if(seg->items[t_h_key].exists) {
-                if(hm->hkc(key, seg->items[t_h_key].key) == 0) {
-                    const void* old_item = seg->items[t_h_key].value;
+/**
+ * @brief exits a reader section of map
+ * @param[in] hm hashmap
+ * @param[in] stripe reader stripe
+ * @param[in] epoch epoch of reader
+ */
+static void hashmap_read_exit(hashmap_t* hm, uint64_t stripe, uint64_t epoch) {
+    asm volatile ("lock decq %0" : "+m" (hm->readers[stripe].counts[epoch & 1]) : : "memory");
+}
 
-                    seg->items[t_h_key].key = key;
-                    seg->items[t_h_key].value = item;
-                    seg->items[t_h_key].exists = true;
+/**
+ * @brief reclaims retired tables and data which no reader can see, should be called with map lock
+ * @details readers are only at current and previous epochs. when previous epoch has no reader, data retired before
+ * current epoch is reclaimed and epoch is advanced for data retired at current epoch.
+ * @param[in] hm hashmap
+ */
+static void hashmap_reclaim(hashmap_t* hm) {
+    if(!hm->retired_tables && !hm->retired_items) {
+        return;
+    }
 
-                    lock_release(hm->lock);
+    uint64_t epoch = hm->epoch;
 
-                    return old_item;
-                }
-            } else {
-                h_key = t_h_key;
+    asm volatile ("mfence" ::: "memory");
 
-                break;
-            }
+    for(uint64_t i = 0; i < HASHMAP_READER_STRIPES; i++) {
+        if(hm->readers[i].counts[(epoch - 1) & 1]) {
+            return;
+        }
+    }
 
-            if(seg->next) {
-                seg = seg->next;
-            } else {
-                seg = hashmap_segment_next_new(hm, seg);
+    hashmap_table_t** t_ref = &hm->retired_tables;
 
-                if(!seg) {
-                    lock_release(hm->lock);
+    while(*t_ref) {
+        hashmap_table_t* t = *t_ref;
 
-                    return NULL;
-                }
+        if(t->retire_epoch < epoch) {
+            *t_ref = t->next;
+            hashmap_table_destroy(hm->heap, t);
+        } else {
+            t_ref = &t->next;
+        }
+    }
+
+    hashmap_retired_t** r_ref = &hm->retired_items;
+
+    while(*r_ref) {
+        hashmap_retired_t* r = *r_ref;
+
+        if(r->epoch < epoch) {
+            *r_ref = r->next;
+            r->reclaimer(r->data);
+            memory_free_ext(hm->heap, r);
+        } else {
+            r_ref = &r->next;
+        }
+    }
+
+    if(hm->retired_tables || hm->retired_items) {
+        hm->epoch = epoch + 1;
+    }
+}
+
+/*! result of versioned lookup at a table */
+typedef enum hashmap_lookup_result_t {
+    HASHMAP_LOOKUP_NOT_FOUND, ///< key is not at table
+    HASHMAP_LOOKUP_FOUND, ///< key is found
+    HASHMAP_LOOKUP_RETRY, ///< a probed group is written while reading
+} hashmap_lookup_result_t; ///< hashmap lookup result
+
+/**
+ * @brief finds key at table of concurrent map without lock, each probed group is validated with its version
+ * @param[in] hm hashmap
+ * @param[in] t table
+ * @param[in] key key
+ * @param[in] hash key hash
+ * @param[out] res copy of found item
+ * @return lookup result
+ */
+static hashmap_lookup_result_t hashmap_table_lookup_versioned(hashmap_t* hm, hashmap_table_t* t, const void* key, uint64_t hash, hashmap_item_t* res) {
+    const int8_t h2 = hash & 0x7F;
+    const uint64_t group_mask = t->group_count - 1;
+    uint64_t group = (hash >> 7) & group_mask;
+
+    for(uint64_t step = 1; step <= t->group_count; step++) {
+        uint32_t version = t->versions[group];
+
+        if(version & 1) {
+            return HASHMAP_LOOKUP_RETRY;
+        }
+
+        asm volatile ("" ::: "memory");
+
+        const int8_t* ctrl = t->ctrl + group * HASHMAP_GROUP_SIZE;
+
+        boolean_t found = false;
+        uint32_t match = hashmap_group_match(ctrl, h2);
+
+        while(match) {
+            uint64_t slot = group * HASHMAP_GROUP_SIZE + __builtin_ctz(match);
+            const void* s_key = t->items[slot].key;
+
+            if(hm->hkc(key, s_key) == 0) {
+                res->key = s_key;
+                res->value = t->items[slot].value;
+                found = true;
 
                 break;
             }
 
-        } else {
+            match &= match - 1;
+        }
+
+        boolean_t has_empty = hashmap_group_match(ctrl, HASHMAP_CTRL_EMPTY) != 0;
+
+        asm volatile ("" ::: "memory");
+
+        if(t->versions[group] != version) {
+            return HASHMAP_LOOKUP_RETRY;
+        }
+
+        if(found) {
+            return HASHMAP_LOOKUP_FOUND;
+        }
+
+        if(has_empty) {
             break;
         }
+
+        group = (group + step) & group_mask;
     }
 
-    seg->items[h_key].key = key;
-    seg->items[h_key].value = item;
-    seg->items[h_key].exists = true;
-    seg->size++;
-    hm->total_size++;
+    return HASHMAP_LOOKUP_NOT_FOUND;
+}
 
-    lock_release(hm->lock);
+/**
+ * @brief finds key for readers, maps are read without lock
+ * @details plain maps are probed directly inside a reader section, so a table moved while probing is not freed
+ * @param[in] hm hashmap
+ * @param[in] key key
+ * @param[out] res copy of found item
+ * @return true if key exists
+ */
+static boolean_t hashmap_lookup(hashmap_t* hm, const void* key, hashmap_item_t* res) {
+    uint64_t stripe = 0;
+    uint64_t epoch = hashmap_read_enter(hm, &stripe);
 
-    return NULL;
+    if(!hm->concurrent) {
+        hashmap_table_t* t = NULL;
+        uint64_t slot = hashmap_find(hm, key, &t);
+
+        if(slot != -1ULL) {
+            *res = t->items[slot];
+        }
+
+        hashmap_read_exit(hm, stripe, epoch);
+
+        return slot != -1ULL;
+    }
+
+    uint64_t hash = hashmap_hash(hm, key);
+
+    hashmap_lookup_result_t lr = HASHMAP_LOOKUP_NOT_FOUND;
+
+    while(true) {
+        hashmap_table_t* old = hm->old_table;
+
+        asm volatile ("" ::: "memory");
+
+        hashmap_table_t* t = hm->table;
+
+        lr = HASHMAP_LOOKUP_NOT_FOUND;
+
+        if(old) {
+            lr = hashmap_table_lookup_versioned(hm, old, key, hash, res);
+        }
+
+        if(lr == HASHMAP_LOOKUP_NOT_FOUND) {
+            lr = hashmap_table_lookup_versioned(hm, t, key, hash, res);
+        }
+
+        // a resize started or ended while reading may move key to a table which is not read
+        if(lr == HASHMAP_LOOKUP_NOT_FOUND) {
+            asm volatile ("" ::: "memory");
+
+            if(hm->old_table != old || hm->table != t) {
+                lr = HASHMAP_LOOKUP_RETRY;
+            }
+        }
+
+        if(lr != HASHMAP_LOOKUP_RETRY) {
+            break;
+        }
+
+        asm volatile ("pause" ::: "memory");
+    }
+
+    hashmap_read_exit(hm, stripe, epoch);
+
+    return lr == HASHMAP_LOOKUP_FOUND;
 }
 
-const void* hashmap_get_key(hashmap_t* hm, const void* key) {
+static hashmap_t* hashmap_new_internal(uint64_t capacity, hashmap_key_generator_f hkg, hashmap_key_comparator_f hkc, boolean_t concurrent) {
+    if(!capacity) {
+        return NULL;
+    }
+
+    memory_heap_t* heap = memory_get_heap(NULL);
+
+    hashmap_t* hm = memory_malloc_ext(heap, sizeof(hashmap_t), 0);
+
     if(!hm) {
         return NULL;
     }
 
-    const uint64_t h_key = hm->hkg(key) % hm->segment_capacity;
+    hm->heap = heap;
 
-    hashmap_segment_t* seg = hm->segments;
+    hm->hkg = hkg?hkg:hashmap_default_kg;
+    hm->hkc = hkc?hkc:hashmap_default_kc;
+    hm->concurrent = concurrent;
 
-    while(seg) {
-        if(seg->items[h_key].exists) {
-            if(hm->hkc(key, seg->items[h_key].key) == 0) {
-                return seg->items[h_key].key;
-            }
+    hm->readers = memory_malloc_ext(heap, sizeof(hashmap_reader_stripe_t) * HASHMAP_READER_STRIPES, 64);
 
-            uint64_t t_h_key = (h_key + 1) % hm->segment_capacity;
+    if(!hm->readers) {
+        memory_free_ext(heap, hm);
 
-            if(seg->items[t_h_key].exists) {
-                if(hm->hkc(key, seg->items[t_h_key].key) == 0) {
-                    return seg->items[t_h_key].key;
-                }
-            }
-        }
+        return NULL;
+    }
 
-        seg = seg->next;
+    // capacity items fit under 7/8 load
+    uint64_t group_count = 1;
+
+    while(group_count * HASHMAP_GROUP_SIZE * 7 < capacity * 8) {
+        group_count *= 2;
     }
 
-    return NULL;
+    hm->table = hashmap_table_new(heap, group_count, concurrent);
+
+    if(!hm->table) {
+        memory_free_ext(heap, hm->readers);
+        memory_free_ext(heap, hm);
+
+        return NULL;
+    }
+
+    hm->lock = lock_create_with_heap(heap);
+
+    return hm;
 }
 
-boolean_t hashmap_exists(hashmap_t* hm, const void* key) {
+hashmap_t*  hashmap_new_with_hkg_with_hkc(uint64_t capacity, hashmap_key_generator_f hkg, hashmap_key_comparator_f hkc) {
+    return hashmap_new_internal(capacity, hkg, hkc, false);
+}
+
+hashmap_t* hashmap_new_concurrent_with_hkg_with_hkc(uint64_t capacity, hashmap_key_generator_f hkg, hashmap_key_comparator_f hkc) {
+    return hashmap_new_internal(capacity, hkg, hkc, true);
+}
+
+hashmap_t* hashmap_string(uint64_t capacity) {
+    return hashmap_new_with_hkg_with_hkc(capacity, hashmap_string_kg, hashmap_string_kc);
+}
+
+hashmap_t* hashmap_string_concurrent(uint64_t capacity) {
+    return hashmap_new_concurrent_with_hkg_with_hkc(capacity, hashmap_string_kg, hashmap_string_kc);
+}
+
+boolean_t   hashmap_destroy(hashmap_t* hm) {
     if(!hm) {
         return false;
     }
 
-    const uint64_t h_key = hm->hkg(key) % hm->segment_capacity;
+    memory_heap_t* heap = hm->heap;
 
-    hashmap_segment_t* seg = hm->segments;
+    hashmap_table_t* t = hm->retired_tables;
 
-    while(seg) {
-        if(seg->items[h_key].exists) {
-            if(hm->hkc(key, seg->items[h_key].key) == 0) {
-                return true;
-            }
+    while(t) {
+        hashmap_table_t* t_next = t->next;
 
-            uint64_t t_h_key = (h_key + 1) % hm->segment_capacity;
+        hashmap_table_destroy(heap, t);
 
-            if(seg->items[t_h_key].exists) {
-                if(hm->hkc(key, seg->items[t_h_key].key) == 0) {
-                    return true;
-                }
-            }
-        }
+        t = t_next;
+    }
 
-        seg = seg->next;
+    hashmap_retired_t* r = hm->retired_items;
+
+    while(r) {
+        hashmap_retired_t* r_next = r->next;
+
+        r->reclaimer(r->data);
+        memory_free_ext(heap, r);
+
+        r = r_next;
     }
 
-    return false;
-}
+    if(hm->old_table) {
+        hashmap_table_destroy(heap, hm->old_table);
+    }
 
+    hashmap_table_destroy(heap, hm->table);
 
-const void* hashmap_get(hashmap_t* hm, const void* key) {
+    lock_destroy(hm->lock);
+    memory_free_ext(heap, hm->readers);
+    memory_free_ext(heap, hm);
+
+    return NULL;
+}
+
+const void* hashmap_put(hashmap_t* hm, const void* key, const void* item) {
     if(!hm) {
         return NULL;
     }
 
-    const uint64_t h_key = hm->hkg(key) % hm->segment_capacity;
+    lock_acquire(hm->lock);
 
-    hashmap_segment_t* seg = hm->segments;
+    hashmap_table_t* t = NULL;
+    uint64_t slot = hashmap_find(hm, key, &t);
 
-    while(seg) {
-        if(seg->items[h_key].exists) {
-            if(hm->hkc(key, seg->items[h_key].key) == 0) {
-                return seg->items[h_key].value;
-            }
+    if(slot != -1ULL) {
+        const void* old_item = t->items[slot].value;
 
-            uint64_t t_h_key = (h_key + 1) % hm->segment_capacity;
+        hashmap_group_write_begin(t, slot / HASHMAP_GROUP_SIZE);
 
-            if(seg->items[t_h_key].exists) {
-                if(hm->hkc(key, seg->items[t_h_key].key) == 0) {
-                    return seg->items[t_h_key].value;
-                }
-            }
-        }
+        t->items[slot].key = key;
+        t->items[slot].value = item;
+
+        hashmap_group_write_end(t, slot / HASHMAP_GROUP_SIZE);
 
-        seg = seg->next;
+        lock_release(hm->lock);
+
+        return old_item;
+    }
+
+    if(!hashmap_reserve(hm)) {
+        lock_release(hm->lock);
+
+        return NULL;
     }
 
+    hashmap_table_insert(hm->table, key, item, hashmap_hash(hm, key));
+    hm->total_size++;
+
+    hashmap_migrate(hm, HASHMAP_MIGRATE_GROUPS);
+    hashmap_reclaim(hm);
+
+    lock_release(hm->lock);
+
     return NULL;
 }
 
+const void* hashmap_get_key(hashmap_t* hm, const void* key) {
+    if(!hm) {
+        return NULL;
+    }
+
+    hashmap_item_t res = {0};
+
+    return hashmap_lookup(hm, key, &res)?res.key:NULL;
+}
+
+boolean_t hashmap_exists(hashmap_t* hm, const void* key) {
+    if(!hm) {
+        return false;
+    }
+
+    hashmap_item_t res = {0};
+
+    return hashmap_lookup(hm, key, &res);
+}
+
+
+const void* hashmap_get(hashmap_t* hm, const void* key) {
+    if(!hm) {
+        return NULL;
+    }
+
+    hashmap_item_t res = {0};
+
+    return hashmap_lookup(hm, key, &res)?res.value:NULL;
+}
+
 boolean_t hashmap_delete(hashmap_t* hm, const void* key) {
     if(!hm) {
         return false;
@@ -391,50 +936,57 @@ boolean_t hashmap_delete(hashmap_t* hm, const void* key) {
 
     lock_acquire(hm->lock);
 
-    const uint64_t h_key = hm->hkg(key) % hm->segment_capacity;
+    hashmap_table_t* t = NULL;
+    uint64_t slot = hashmap_find(hm, key, &t);
 
-    hashmap_segment_t* seg = hm->segments;
+    if(slot != -1ULL) {
+        hashmap_table_erase(t, slot);
+        hm->total_size--;
+    }
 
-    while(seg) {
-        if(seg->items[h_key].exists) {
-            if(hm->hkc(key, seg->items[h_key].key) == 0) {
-                seg->items[h_key].key = NULL;
-                seg->items[h_key].value = NULL;
-                seg->items[h_key].exists = false;
-                seg->size--;
-                hm->total_size--;
+    hashmap_reclaim(hm);
 
-                lock_release(hm->lock);
+    lock_release(hm->lock);
 
-                return true;
-            }
+    return true;
+}
 
-            uint64_t t_h_key = (h_key + 1) % hm->segment_capacity;
+boolean_t hashmap_retire(hashmap_t* hm, void* data, hashmap_reclaimer_f reclaimer) {
+    if(!hm || !reclaimer) {
+        return false;
+    }
 
-            if(seg->items[t_h_key].exists) {
-                if(hm->hkc(key, seg->items[t_h_key].key) == 0) {
-                    seg->items[t_h_key].key = NULL;
-                    seg->items[t_h_key].value = NULL;
-                    seg->items[t_h_key].exists = false;
-                    seg->size--;
-                    hm->total_size--;
+    if(!hm->concurrent) {
+        reclaimer(data);
 
-                    lock_release(hm->lock);
+        return true;
+    }
 
-                    return true;
-                }
-            }
-        }
+    hashmap_retired_t* r = memory_malloc_ext(hm->heap, sizeof(hashmap_retired_t), 0);
 
-        seg = seg->next;
+    if(!r) {
+        return false;
     }
 
+    r->data = data;
+    r->reclaimer = reclaimer;
+
+    lock_acquire(hm->lock);
+
+    // data is already unreachable from map, readers entering from now on cannot see it
+    asm volatile ("mfence" ::: "memory");
+
+    r->epoch = hm->epoch;
+    r->next = hm->retired_items;
+    hm->retired_items = r;
+
+    hashmap_reclaim(hm);
+
     lock_release(hm->lock);
 
     return true;
 }
 
-
 uint64_t hashmap_size(hashmap_t* hm) {
     if(!hm) {
         return 0;
@@ -448,10 +1000,13 @@ uint64_t hashmap_size(hashmap_t* hm) {
  * @brief  Metadata for the hashmap iterator
  */
 typedef struct hashmap_iterator_metadata_t {
-    memory_heap_t*     heap; ///< Heap
-    hashmap_segment_t* current_segment; ///< Current segment
-    uint64_t           segment_capacity; ///< Segment capacity
-    uint64_t           current_index; ///< Current index
+    memory_heap_t*   heap; ///< Heap
+    hashmap_t*       hm; ///< map whose reader section is held by iterator
+    uint64_t         reader_stripe; ///< reader stripe
+    uint64_t         reader_epoch; ///< reader epoch
+    hashmap_table_t* tables[2]; ///< old table while resizing and current table
+    uint64_t         current_table; ///< index of table at tables, 2 at end
+    uint64_t         current_index; ///< Current index
 } hashmap_iterator_metadata_t; ///< Typedef for hashmap iterator metadata
 
 /**
@@ -489,6 +1044,27 @@ int8_t hashmap_iterator_destroy(iterator_t* iter);
  */
 int8_t hashmap_iterator_end_of_iterator(iterator_t* iter);
 
+/**
+ * @brief moves iterator to first full slot at or after current position
+ * @param[in] iter_md iterator metadata
+ */
+static void hashmap_iterator_seek(hashmap_iterator_metadata_t* iter_md) {
+    while(iter_md->current_table < 2) {
+        hashmap_table_t* t = iter_md->tables[iter_md->current_table];
+
+        if(t) {
+            for(; iter_md->current_index < t->capacity; iter_md->current_index++) {
+                if(t->ctrl[iter_md->current_index] >= 0) {
+                    return;
+                }
+            }
+        }
+
+        iter_md->current_table++;
+        iter_md->current_index = 0;
+    }
+}
+
 const void* hashmap_iterator_get_item(iterator_t* iter) {
     if(!iter) {
         return NULL;
@@ -496,7 +1072,7 @@ const void* hashmap_iterator_get_item(iterator_t* iter) {
 
     hashmap_iterator_metadata_t* iter_md = iter->metadata;
 
-    return iter_md->current_segment->items[iter_md->current_index].value;
+    return iter_md->tables[iter_md->current_table]->items[iter_md->current_index].value;
 }
 
 const void* hashmap_iterator_get_extra_data(iterator_t* iter) {
@@ -506,7 +1082,7 @@ const void* hashmap_iterator_get_extra_data(iterator_t* iter) {
 
     hashmap_iterator_metadata_t* iter_md = iter->metadata;
 
-    return iter_md->current_segment->items[iter_md->current_index].key;
+    return iter_md->tables[iter_md->current_table]->items[iter_md->current_index].key;
 }
 
 iterator_t* hashmap_iterator_next(iterator_t* iter) {
@@ -516,27 +1092,13 @@ iterator_t* hashmap_iterator_next(iterator_t* iter) {
 
     hashmap_iterator_metadata_t* iter_md = iter->metadata;
 
-    if(!iter_md->current_segment) {
+    if(iter_md->current_table == 2) {
         return iter;
     }
 
-    while(true) {
-        iter_md->current_index++;
-
-        if(iter_md->current_index == iter_md->segment_capacity) {
-            iter_md->current_index = 0;
-            iter_md->current_segment = iter_md->current_segment->next;
-        }
-
-        if(!iter_md->current_segment) {
-            break;
-        }
-
-        if(iter_md->current_segment->items[iter_md->current_index].exists) {
-            break;
-        }
+    iter_md->current_index++;
 
-    }
+    hashmap_iterator_seek(iter_md);
 
     return iter;
 }
@@ -546,7 +1108,10 @@ int8_t hashmap_iterator_destroy(iterator_t* iter) {
         return -1;
     }
 
-    memory_heap_t* heap = ((hashmap_iterator_metadata_t*)iter->metadata)->heap;
+    hashmap_iterator_metadata_t* iter_md = iter->metadata;
+    memory_heap_t* heap = iter_md->heap;
+
+    hashmap_read_exit(iter_md->hm, iter_md->reader_stripe, iter_md->reader_epoch);
 
     memory_free_ext(heap, iter->metadata);
     memory_free_ext(heap, iter);
@@ -561,7 +1126,7 @@ int8_t hashmap_iterator_end_of_iterator(iterator_t* iter) {
 
     hashmap_iterator_metadata_t* iter_md = iter->metadata;
 
-    return iter_md->current_segment == NULL?0:1;
+    return iter_md->current_table == 2?0:1;
 }
 
 iterator_t* hashmap_iterator_create(hashmap_t* hm) {
@@ -576,8 +1141,6 @@ iterator_t* hashmap_iterator_create(hashmap_t* hm) {
     }
 
     iter_md->heap = hm->heap;
-    iter_md->current_segment = hm->segments;
-    iter_md->segment_capacity = hm->segment_capacity;
 
     iterator_t* iter = memory_malloc_ext(hm->heap, sizeof(iterator_t), 0);
 
@@ -587,6 +1150,16 @@ iterator_t* hashmap_iterator_create(hashmap_t* hm) {
         return NULL;
     }
 
+    // tables are not reclaimed until iterator is destroyed
+    iter_md->hm = hm;
+    iter_md->reader_epoch = hashmap_read_enter(hm, &iter_md->reader_stripe);
+
+    iter_md->tables[0] = hm->old_table;
+
+    asm volatile ("" ::: "memory");
+
+    iter_md->tables[1] = hm->table;
+
     iter->metadata = iter_md;
     iter->get_item = hashmap_iterator_get_item;
     iter->end_of_iterator = hashmap_iterator_end_of_iterator;
@@ -595,20 +1168,9 @@ iterator_t* hashmap_iterator_create(hashmap_t* hm) {
     iter->next = hashmap_iterator_next;
 
     if(hm->total_size == 0) {
-        iter_md->current_segment = NULL;
+        iter_md->current_table = 2;
     } else {
-        while(iter_md->current_segment) {
-            if(iter_md->current_segment->items[iter_md->current_index].exists) {
-                break;
-            }
-
-            iter_md->current_index++;
-
-            if(iter_md->current_index == iter_md->segment_capacity) {
-                iter_md->current_segment = iter_md->current_segment->next;
-                iter_md->current_segment = iter_md->current_segment->next;
-            }
-        }
+        hashmap_iterator_seek(iter_md);
     }
 
     return iter;
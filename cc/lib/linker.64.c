@@ -352,6 +352,111 @@ const uint8_t linker_plt_entry_data[] = {
 
 _Static_assert(sizeof(linker_plt_entry_data) == 0x40, "plt entry size mismatch");
 
+/**
+ * @brief fetches module ids of sections referenced by relocations with one multi get
+ * @param[in] tbl_sections sections table
+ * @param[in] relocations relocation records
+ * @return map of section id to module id, null on error
+ */
+static hashmap_t* linker_get_relocation_section_modules(tosdb_table_t* tbl_sections, list_t* relocations) {
+    hashmap_t* section_modules = hashmap_integer(128);
+
+    if(!section_modules) {
+        PRINTLOG(LINKER, LOG_ERROR, "cannot create section modules hashmap");
+
+        return NULL;
+    }
+
+    uint64_t reloc_count = list_size(relocations);
+
+    if(!reloc_count) {
+        return section_modules;
+    }
+
+    tosdb_record_t** sec_recs = memory_malloc(sizeof(tosdb_record_t*) * reloc_count);
+    boolean_t* founds = memory_malloc(sizeof(boolean_t) * reloc_count);
+
+    if(!sec_recs || !founds) {
+        PRINTLOG(LINKER, LOG_ERROR, "cannot create section records array");
+        memory_free(sec_recs);
+        memory_free(founds);
+        hashmap_destroy(section_modules);
+
+        return NULL;
+    }
+
+    uint64_t sec_count = 0;
+    boolean_t error = false;
+
+    iterator_t* it = list_iterator_create(relocations);
+
+    if(!it) {
+        PRINTLOG(LINKER, LOG_ERROR, "cannot create iterator for relocations");
+        error = true;
+    }
+
+    while(!error && it->end_of_iterator(it) != 0) {
+        tosdb_record_t* reloc_rec = (tosdb_record_t*)it->get_item(it);
+        int64_t symbol_section_id = 0;
+
+        // missing section ids are reported by caller
+        if(reloc_rec->get_int64(reloc_rec, "symbol_section_id", &symbol_section_id) && symbol_section_id &&
+           !hashmap_exists(section_modules, (void*)symbol_section_id)) {
+            hashmap_put(section_modules, (void*)symbol_section_id, NULL);
+
+            sec_recs[sec_count] = tosdb_table_create_record(tbl_sections);
+
+            if(!sec_recs[sec_count]) {
+                PRINTLOG(LINKER, LOG_ERROR, "cannot create record for searching section");
+                error = true;
+
+                break;
+            }
+
+            sec_recs[sec_count]->set_uint64(sec_recs[sec_count], "id", symbol_section_id);
+            sec_count++;
+        }
+
+        it = it->next(it);
+    }
+
+    if(it) {
+        it->destroy(it);
+    }
+
+    if(!error && !tosdb_table_multi_get(tbl_sections, sec_recs, sec_count, founds)) {
+        PRINTLOG(LINKER, LOG_ERROR, "cannot get section records");
+        error = true;
+    }
+
+    for(uint64_t i = 0; i < sec_count; i++) {
+        uint64_t section_id = 0;
+        int64_t module_id = 0;
+
+        sec_recs[i]->get_uint64(sec_recs[i], "id", &section_id);
+
+        // sections which are not found are removed, caller fails at them
+        if(!error && founds[i] && sec_recs[i]->get_int64(sec_recs[i], "module_id", &module_id)) {
+            hashmap_put(section_modules, (void*)section_id, (void*)module_id);
+        } else {
+            hashmap_delete(section_modules, (void*)section_id);
+        }
+
+        sec_recs[i]->destroy(sec_recs[i]);
+    }
+
+    memory_free(sec_recs);
+    memory_free(founds);
+
+    if(error) {
+        hashmap_destroy(section_modules);
+
+        return NULL;
+    }
+
+    return section_modules;
+}
+
 int8_t linker_build_relocations(linker_context_t* ctx, uint64_t section_id, uint8_t section_type, uint64_t section_offset, linker_module_t* module, boolean_t recursive) {
     int8_t res = 0;
 
@@ -398,6 +503,15 @@ int8_t linker_build_relocations(linker_context_t* ctx, uint64_t section_id, uint
         return -1;
     }
 
+    // section lookups of all relocations are done at once instead of one get per relocation
+    hashmap_t* section_modules = linker_get_relocation_section_modules(tbl_sections, relocations);
+
+    if(!section_modules) {
+        PRINTLOG(LINKER, LOG_ERROR, "cannot get modules of relocation sections for section id 0x%llx", section_id);
+
+        goto clean_relocs_iter;
+    }
+
     linker_relocation_entry_t relocation = {0};
     int64_t reloc_id = 0;
     int64_t symbol_section_id = 0;
@@ -506,40 +620,14 @@ int8_t linker_build_relocations(linker_context_t* ctx, uint64_t section_id, uint
         }
 
         if(!is_got_symbol) {
-            tosdb_record_t* s_sec_rec = tosdb_table_create_record(tbl_sections);
-
-            if(!s_sec_rec) {
-                PRINTLOG(LINKER, LOG_ERROR, "cannot create record for searching section");
-                reloc_rec->destroy(reloc_rec);
-
-                goto clean_relocs_iter;
-            }
-
-            if(!s_sec_rec->set_uint64(s_sec_rec, "id", symbol_section_id)) {
-                PRINTLOG(LINKER, LOG_ERROR, "cannot set search key for records id column for section id 0x%llx", symbol_section_id);
-                reloc_rec->destroy(reloc_rec);
-                s_sec_rec->destroy(s_sec_rec);
-
-                goto clean_relocs_iter;
-            }
-
-            if(!s_sec_rec->get_record(s_sec_rec)) {
+            if(!hashmap_exists(section_modules, (void*)symbol_section_id)) {
                 PRINTLOG(LINKER, LOG_ERROR, "cannot get section record for section id 0x%llx for relocation 0x%llx", symbol_section_id, reloc_id);
                 reloc_rec->destroy(reloc_rec);
-                s_sec_rec->destroy(s_sec_rec);
-
-                goto clean_relocs_iter;
-            }
-
-            if(!s_sec_rec->get_int64(s_sec_rec, "module_id", &module_id)) {
-                PRINTLOG(LINKER, LOG_ERROR, "cannot get section module id, is deleted? %d", s_sec_rec->is_deleted(s_sec_rec));
-                reloc_rec->destroy(reloc_rec);
-                s_sec_rec->destroy(s_sec_rec);
 
                 goto clean_relocs_iter;
             }
 
-            s_sec_rec->destroy(s_sec_rec);
+            module_id = (int64_t)hashmap_get(section_modules, (void*)symbol_section_id);
 
             PRINTLOG(LINKER, LOG_DEBUG, "relocation 0x%llx source symbol section id 0x%llx", reloc_id, symbol_section_id);
         }
@@ -722,6 +810,7 @@ int8_t linker_build_relocations(linker_context_t* ctx, uint64_t section_id, uint
     it->destroy(it);
 
     list_destroy(relocations);
+    hashmap_destroy(section_modules);
 
     return res;
 
@@ -739,6 +828,7 @@ clean_relocs_iter:
     it->destroy(it);
 
     list_destroy(relocations);
+    hashmap_destroy(section_modules);
 
     return -1;
 }
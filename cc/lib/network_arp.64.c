@@ -17,25 +17,25 @@
 
 MODULE("turnstone.lib.network");
 
-uint8_t*       network_arp_create_reply_from_packet(network_arp_t* src_arp_packet, network_mac_address_t mac, uint16_t* return_packet_len);
-network_arp_t* network_arp_create_request(network_mac_address_t src_mac, network_ipv4_address_t src_ip, network_ipv4_address_t tgt_ip);
+network_buffer_t* network_arp_create_reply_from_packet(network_buffer_t* recv_buffer, network_mac_address_t mac);
+network_buffer_t* network_arp_create_request(network_mac_address_t src_mac, network_ipv4_address_t src_ip, network_ipv4_address_t tgt_ip);
 
-uint8_t* network_arp_process_packet(network_arp_t* recv_arp_packet, void* network_info, uint16_t* return_packet_len) {
-    UNUSED(network_info);
+network_buffer_t* network_arp_process_packet(network_buffer_t* recv_buffer, void* network_info) {
+    if(recv_buffer->length < sizeof(network_arp_t)) {
+        return NULL;
+    }
+
+    network_arp_t* recv_arp_packet = (network_arp_t*)network_buffer_get_data(recv_buffer);
 
     if(BYTE_SWAP16(recv_arp_packet->operation_code) == NETWORK_ARP_OPERATION_CODE_REQUEST) {
-        return network_arp_create_reply_from_packet(recv_arp_packet, network_info, return_packet_len);
+        return network_arp_create_reply_from_packet(recv_buffer, network_info);
     }
 
     return NULL;
 }
 
 
-uint8_t* network_arp_create_reply_from_packet(network_arp_t* src_arp_packet, network_mac_address_t mac, uint16_t* return_packet_len) {
-    if(return_packet_len == NULL) {
-        return NULL;
-    }
-
+network_buffer_t* network_arp_create_reply_from_packet(network_buffer_t* recv_buffer, network_mac_address_t mac) {
     const network_info_t* ni = map_get(network_info_map, mac);
 
     if(!ni) {
@@ -46,44 +46,44 @@ uint8_t* network_arp_create_reply_from_packet(network_arp_t* src_arp_packet, net
         return NULL;
     }
 
+    network_arp_t* arp_packet = (network_arp_t*)network_buffer_get_data(recv_buffer);
 
-    if(!network_ipv4_is_address_eq(ni->ipv4_address, src_arp_packet->target_ip)) {
-        return NULL;
-    }
-
-    network_arp_t* arp_packet = memory_malloc(sizeof(network_arp_t));
-
-    if(arp_packet == NULL) {
+    if(!network_ipv4_is_address_eq(ni->ipv4_address, arp_packet->target_ip)) {
         return NULL;
     }
 
+    // request is turned into reply inside received buffer
     arp_packet->hardware_type = BYTE_SWAP16(NETWORK_ARP_HARDWARE_TYPE_ETHERNET);
     arp_packet->protocol_type = BYTE_SWAP16(NETWORK_ARP_PROTOCOL_TYPE_IP);
     arp_packet->hardware_address_length = NETWORK_ARP_HARDWARE_ADDRESS_LENGTH;
     arp_packet->protocol_address_length = NETWORK_ARP_PROTOCOL_ADDRESS_LENGTH;
     arp_packet->operation_code = BYTE_SWAP16(NETWORK_ARP_OPERATION_CODE_ANSWER);
 
-    arp_packet->target_ip = src_arp_packet->source_ip;
-    memory_memcopy(src_arp_packet->source_mac, arp_packet->target_mac, sizeof(network_mac_address_t));
+    arp_packet->target_ip = arp_packet->source_ip;
+    memory_memcopy(arp_packet->source_mac, arp_packet->target_mac, sizeof(network_mac_address_t));
 
     PRINTLOG(NETWORK, LOG_TRACE, "arp ip address %i.%i.%i.%i", arp_packet->target_ip.as_bytes[0], arp_packet->target_ip.as_bytes[1], arp_packet->target_ip.as_bytes[2], arp_packet->target_ip.as_bytes[3]);
     PRINTLOG(NETWORK, LOG_TRACE, "arp mac address %02x:%02x:%02x:%02x:%02x:%02x", arp_packet->target_mac[0], arp_packet->target_mac[1], arp_packet->target_mac[2], arp_packet->target_mac[3], arp_packet->target_mac[4], arp_packet->target_mac[5]);
 
     memory_memcopy(mac, arp_packet->source_mac, sizeof(network_mac_address_t));
-    arp_packet->source_ip = src_arp_packet->target_ip;
+    arp_packet->source_ip = ni->ipv4_address;
 
-    *return_packet_len = sizeof(network_arp_t);
+    network_buffer_trim(recv_buffer, sizeof(network_arp_t));
 
-    return (uint8_t*)arp_packet;
+    return network_buffer_retain(recv_buffer);
 }
 
-network_arp_t* network_arp_create_request(network_mac_address_t src_mac, network_ipv4_address_t src_ip, network_ipv4_address_t tgt_ip){
-    network_arp_t* arp_packet = memory_malloc(sizeof(network_arp_t));
+network_buffer_t* network_arp_create_request(network_mac_address_t src_mac, network_ipv4_address_t src_ip, network_ipv4_address_t tgt_ip){
+    network_buffer_t* nb = network_buffer_alloc(sizeof(network_arp_t));
 
-    if(arp_packet == NULL) {
+    if(nb == NULL) {
         return NULL;
     }
 
+    network_arp_t* arp_packet = (network_arp_t*)network_buffer_put(nb, sizeof(network_arp_t));
+
+    memory_memclean(arp_packet, sizeof(network_arp_t));
+
     arp_packet->hardware_type = BYTE_SWAP16(NETWORK_ARP_HARDWARE_TYPE_ETHERNET);
     arp_packet->protocol_type = BYTE_SWAP16(NETWORK_ARP_PROTOCOL_TYPE_IP);
     arp_packet->hardware_address_length = NETWORK_ARP_HARDWARE_ADDRESS_LENGTH;
@@ -94,5 +94,5 @@ network_arp_t* network_arp_create_request(network_mac_address_t src_mac, network
     arp_packet->source_ip = src_ip;
     arp_packet->target_ip = tgt_ip;
 
-    return arp_packet;
+    return nb;
 }
@@ -0,0 +1,257 @@
+/**
+ * @file network_buffer.64.c
+ * @brief Network packet buffer pool implementation.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <network/network_buffer.h>
+#include <memory.h>
+#include <memory/frame.h>
+#include <memory/paging.h>
+#include <cpu/sync.h>
+#include <logging.h>
+
+MODULE("turnstone.lib.network");
+
+typedef struct network_buffer_pool_t {
+    lock_t*           lock;
+    network_buffer_t* free_list;
+    uint64_t          total_count;
+    uint64_t          free_count;
+} network_buffer_pool_t;
+
+network_buffer_pool_t network_buffer_pool = {0};
+
+static int8_t network_buffer_pool_grow(void) {
+    if(network_buffer_pool.total_count + NETWORK_BUFFER_POOL_GROW_COUNT > NETWORK_BUFFER_POOL_MAX_COUNT) {
+        PRINTLOG(NETWORK, LOG_ERROR, "network buffer pool reached its limit");
+
+        return -1;
+    }
+
+    // descriptors are kept after slabs inside same frames
+    uint64_t slabs_size = NETWORK_BUFFER_POOL_GROW_COUNT * NETWORK_BUFFER_SIZE;
+    uint64_t frame_count = (slabs_size + NETWORK_BUFFER_POOL_GROW_COUNT * sizeof(network_buffer_t) + FRAME_SIZE - 1) / FRAME_SIZE;
+
+    frame_t* frames = NULL;
+
+    if(frame_get_allocator()->allocate_frame_by_count(frame_get_allocator(), frame_count, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &frames, NULL) != 0) {
+        PRINTLOG(NETWORK, LOG_ERROR, "cannot allocate frames for network buffer pool");
+
+        return -1;
+    }
+
+    frames->frame_attributes |= FRAME_ATTRIBUTE_RESERVED_PAGE_MAPPED;
+
+    uint64_t frame_address = frames->frame_address;
+    uint64_t frame_va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(frame_address);
+
+    if(memory_paging_add_va_for_frame(frame_va, frames, MEMORY_PAGING_PAGE_TYPE_NOEXEC) != 0) {
+        PRINTLOG(NETWORK, LOG_ERROR, "cannot map network buffer pool frames");
+        frame_get_allocator()->release_frame(frame_get_allocator(), frames);
+
+        return -1;
+    }
+
+    network_buffer_t* nbs = (network_buffer_t*)(frame_va + slabs_size);
+
+    for(uint64_t i = 0; i < NETWORK_BUFFER_POOL_GROW_COUNT; i++) {
+        nbs[i].head = (uint8_t*)(frame_va + i * NETWORK_BUFFER_SIZE);
+        nbs[i].head_fa = frame_address + i * NETWORK_BUFFER_SIZE;
+        nbs[i].size = NETWORK_BUFFER_SIZE;
+        nbs[i].next = network_buffer_pool.free_list;
+        network_buffer_pool.free_list = &nbs[i];
+    }
+
+    network_buffer_pool.total_count += NETWORK_BUFFER_POOL_GROW_COUNT;
+    network_buffer_pool.free_count += NETWORK_BUFFER_POOL_GROW_COUNT;
+
+    PRINTLOG(NETWORK, LOG_TRACE, "network buffer pool grown to 0x%llx buffers at fa 0x%llx", network_buffer_pool.total_count, frame_address);
+
+    return 0;
+}
+
+int8_t network_buffer_pool_init(void) {
+    if(network_buffer_pool.lock != NULL) {
+        return 0;
+    }
+
+    network_buffer_pool.lock = lock_create_with_heap(memory_get_default_heap());
+
+    if(network_buffer_pool.lock == NULL) {
+        PRINTLOG(NETWORK, LOG_ERROR, "cannot create network buffer pool lock");
+
+        return -1;
+    }
+
+    lock_acquire(network_buffer_pool.lock);
+    int8_t res = network_buffer_pool_grow();
+    lock_release(network_buffer_pool.lock);
+
+    return res;
+}
+
+uint64_t network_buffer_pool_get_free_count(void) {
+    return network_buffer_pool.free_count;
+}
+
+network_buffer_t* network_buffer_alloc(uint32_t length) {
+    network_buffer_t* nb = NULL;
+
+    if(length > NETWORK_BUFFER_SIZE - NETWORK_BUFFER_HEADROOM) {
+        nb = memory_malloc_ext(memory_get_default_heap(), sizeof(network_buffer_t), 0);
+
+        if(nb == NULL) {
+            return NULL;
+        }
+
+        nb->size = NETWORK_BUFFER_HEADROOM + length;
+        nb->head = memory_malloc_ext(memory_get_default_heap(), nb->size, 0);
+
+        if(nb->head == NULL) {
+            memory_free_ext(memory_get_default_heap(), nb);
+
+            return NULL;
+        }
+
+        nb->head_fa = 0;
+    } else {
+        if(network_buffer_pool.lock == NULL && network_buffer_pool_init() != 0) {
+            return NULL;
+        }
+
+        lock_acquire(network_buffer_pool.lock);
+
+        if(network_buffer_pool.free_list == NULL && network_buffer_pool_grow() != 0) {
+            lock_release(network_buffer_pool.lock);
+
+            return NULL;
+        }
+
+        nb = network_buffer_pool.free_list;
+        network_buffer_pool.free_list = nb->next;
+        network_buffer_pool.free_count--;
+
+        lock_release(network_buffer_pool.lock);
+    }
+
+    nb->next = NULL;
+    nb->offset = NETWORK_BUFFER_HEADROOM;
+    nb->length = 0;
+    nb->ref_count = 1;
+
+    return nb;
+}
+
+network_buffer_t* network_buffer_create_from_data(const uint8_t* data, uint32_t length) {
+    network_buffer_t* nb = network_buffer_alloc(length);
+
+    if(nb == NULL) {
+        return NULL;
+    }
+
+    memory_memcopy(data, network_buffer_put(nb, length), length);
+
+    return nb;
+}
+
+network_buffer_t* network_buffer_get_dma_buffer(network_buffer_t* nb) {
+    if(nb == NULL || nb->head_fa) {
+        return nb;
+    }
+
+    network_buffer_t* dma_nb = NULL;
+
+    if(nb->length <= NETWORK_BUFFER_SIZE - NETWORK_BUFFER_HEADROOM) {
+        dma_nb = network_buffer_create_from_data(network_buffer_get_data(nb), nb->length);
+    }
+
+    network_buffer_release(nb);
+
+    return dma_nb;
+}
+
+network_buffer_t* network_buffer_retain(network_buffer_t* nb) {
+    __atomic_add_fetch(&nb->ref_count, 1, __ATOMIC_RELAXED);
+
+    return nb;
+}
+
+void network_buffer_release(network_buffer_t* nb) {
+    if(nb == NULL) {
+        return;
+    }
+
+    if(__atomic_sub_fetch(&nb->ref_count, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+
+    if(nb->head_fa == 0) {
+        memory_free_ext(memory_get_default_heap(), nb->head);
+        memory_free_ext(memory_get_default_heap(), nb);
+
+        return;
+    }
+
+    lock_acquire(network_buffer_pool.lock);
+
+    nb->next = network_buffer_pool.free_list;
+    network_buffer_pool.free_list = nb;
+    network_buffer_pool.free_count++;
+
+    lock_release(network_buffer_pool.lock);
+}
+
+int8_t network_buffer_destroyer(memory_heap_t* heap, void* data) {
+    UNUSED(heap);
+
+    network_buffer_release(data);
+
+    return 0;
+}
+
+uint8_t* network_buffer_push(network_buffer_t* nb, uint32_t length) {
+    if(length > nb->offset) {
+        return NULL;
+    }
+
+    nb->offset -= length;
+    nb->length += length;
+
+    return network_buffer_get_data(nb);
+}
+
+uint8_t* network_buffer_pull(network_buffer_t* nb, uint32_t length) {
+    if(length > nb->length) {
+        return NULL;
+    }
+
+    nb->offset += length;
+    nb->length -= length;
+
+    return network_buffer_get_data(nb);
+}
+
+uint8_t* network_buffer_put(network_buffer_t* nb, uint32_t length) {
+    if(length > network_buffer_get_tailroom(nb)) {
+        return NULL;
+    }
+
+    uint8_t* res = network_buffer_get_data(nb) + nb->length;
+
+    nb->length += length;
+
+    return res;
+}
+
+int8_t network_buffer_trim(network_buffer_t* nb, uint32_t length) {
+    if(length > nb->length) {
+        return -1;
+    }
+
+    nb->length = length;
+
+    return 0;
+}
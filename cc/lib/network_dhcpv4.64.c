@@ -158,7 +158,7 @@ uint8_t* network_dhcpv4_process_packet(network_dhcpv4_t* recv_dhcpv4_packet, voi
             return NULL;
         }
 
-        network_udpv4_header_t* udp = network_udpv4_create_packet_from_data(NETWORK_DHCPV4_SOURCE_PORT, NETWORK_DHCPV4_DESTINATION_PORT, dhcp_packet_len, (uint8_t*)dhcp_packet);
+        network_buffer_t* udp = network_udpv4_create_packet_from_data(NETWORK_DHCPV4_SOURCE_PORT, NETWORK_DHCPV4_DESTINATION_PORT, dhcp_packet_len, (uint8_t*)dhcp_packet);
 
         memory_free(dhcp_packet);
 
@@ -176,55 +176,29 @@ uint8_t* network_dhcpv4_process_packet(network_dhcpv4_t* recv_dhcpv4_packet, voi
             return NULL;
         }
 
-        network_transmit_packet_t* t_ip = (network_transmit_packet_t*)list_queue_pop(l_ip);
+        network_buffer_t* ip = (network_buffer_t*)list_queue_pop(l_ip);
 
-        list_destroy(l_ip);
+        list_destroy_with_type(l_ip, LIST_DESTROY_WITH_DATA, network_buffer_destroyer);
 
-        if(t_ip == NULL) {
+        if(ip == NULL) {
             PRINTLOG(NETWORK, LOG_ERROR, "ip packet is null");
 
             return NULL;
         }
 
-        network_ipv4_header_t* ip = (network_ipv4_header_t*)t_ip->packet_data;
-
-        memory_free(t_ip);
-
-        uint16_t tl = BYTE_SWAP16(ip->total_length);
-
-        uint8_t* eth = network_ethernet_create_packet(BROADCAST_MAC, network_info, NETWORK_PROTOCOL_IPV4, tl, (uint8_t*)ip);
-
-        network_transmit_packet_t* res = memory_malloc_ext(list_get_heap(ni->return_queue), sizeof(network_transmit_packet_t), 0);
-
-        if(res == NULL) {
-            PRINTLOG(NETWORK, LOG_ERROR, "network transmit packet is null, re trying...");
-
-            memory_free(eth);
+        if(network_ethernet_push_header(ip, BROADCAST_MAC, network_info, NETWORK_ETHERNET_TYPE_IPV4) != 0) {
+            network_buffer_release(ip);
 
             return NULL;
         }
 
-        res->packet_len = sizeof(network_ethernet_t) + tl;
-
-        uint8_t* packet_data = memory_malloc_ext(list_get_heap(ni->return_queue), res->packet_len, 0);
-
-        if(packet_data == NULL) {
-            PRINTLOG(NETWORK, LOG_ERROR, "packet data allocation failed, re trying...");
-
-            memory_free(eth);
-            memory_free_ext(list_get_heap(ni->return_queue), res);
+        if(list_queue_push(ni->return_queue, ip) == -1ULL) {
+            PRINTLOG(NETWORK, LOG_ERROR, "cannot queue dhcp request");
+            network_buffer_release(ip);
 
             return NULL;
         }
 
-        memory_memcopy(eth, packet_data, res->packet_len);
-
-        memory_free(eth);
-
-        res->packet_data = packet_data;
-
-        list_queue_push(ni->return_queue, res);
-
         PRINTLOG(NETWORK, LOG_TRACE, "dhcp request is send");
     } else if(type == NETWORK_DHCPV4_OPCODE_ACK) {
         PRINTLOG(NETWORK, LOG_TRACE, "dhcp type is ack");
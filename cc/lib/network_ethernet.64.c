@@ -29,13 +29,13 @@ boolean_t network_ethernet_is_mac_address_eq(network_mac_address_t mac1, network
     return true;
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-list_t* network_ethernet_process_packet(network_ethernet_t* recv_eth_packet, void* network_info) {
-    if(recv_eth_packet == NULL) {
+list_t* network_ethernet_process_packet(network_buffer_t* recv_buffer, void* network_info) {
+    if(recv_buffer == NULL || recv_buffer->length < sizeof(network_ethernet_t)) {
         return NULL;
     }
 
+    network_ethernet_t* recv_eth_packet = (network_ethernet_t*)network_buffer_get_data(recv_buffer);
+
     network_mac_address_t our_mac = {};
     memory_memcopy(network_info, our_mac, sizeof(network_mac_address_t));
 
@@ -48,119 +48,93 @@ list_t* network_ethernet_process_packet(network_ethernet_t* recv_eth_packet, voi
         return NULL;
     }
 
-    uint8_t* data = (uint8_t*)recv_eth_packet;
-    uint8_t* data_inner_packet = (data + sizeof(network_ethernet_t));
-
+    // replies may be built over this header, so keep peer address
+    network_mac_address_t peer_mac = {};
+    memory_memcopy(recv_eth_packet->source, peer_mac, sizeof(network_mac_address_t));
 
+    network_buffer_pull(recv_buffer, sizeof(network_ethernet_t));
 
     if(packet_type == NETWORK_PROTOCOL_ARP) {
         PRINTLOG(NETWORK, LOG_TRACE, "arp packet received");
-        uint8_t* return_data = NULL;
-        uint16_t return_data_len = 0;
 
-        return_data = network_arp_process_packet((network_arp_t*)data_inner_packet, network_info, &return_data_len);
+        network_buffer_t* arp_reply = network_arp_process_packet(recv_buffer, network_info);
 
-        if(return_data == NULL || return_data_len == 0) {
+        if(arp_reply == NULL) {
             return NULL;
         }
 
-        uint8_t* eth_packet = network_ethernet_create_packet(recv_eth_packet->source, our_mac, NETWORK_PROTOCOL_ARP, return_data_len, return_data);
+        if(network_ethernet_push_header(arp_reply, peer_mac, our_mac, NETWORK_ETHERNET_TYPE_ARP) != 0) {
+            network_buffer_release(arp_reply);
 
-        if(eth_packet == NULL) {
             return NULL;
         }
 
         list_t* res = list_create_list();
 
         if(res == NULL) {
-            memory_free(eth_packet);
-            return NULL;
-        }
-
-        network_transmit_packet_t* transmit_packet = memory_malloc(sizeof(network_transmit_packet_t));
+            network_buffer_release(arp_reply);
 
-        if(transmit_packet == NULL) {
-            memory_free(eth_packet);
-            list_destroy(res);
             return NULL;
         }
 
-        transmit_packet->packet_data = eth_packet;
-        transmit_packet->packet_len = sizeof(network_ethernet_t) + return_data_len;
-
-        list_queue_push(res, transmit_packet);
+        list_queue_push(res, arp_reply);
 
         return res;
     } else if(packet_type == NETWORK_PROTOCOL_IPV4) {
         PRINTLOG(NETWORK, LOG_TRACE, "ipv4 packet received");
-        list_t* ip_pckts = network_ipv4_process_packet((network_ipv4_header_t*)data_inner_packet, network_info);
+        list_t* ip_pckts = network_ipv4_process_packet(recv_buffer, network_info);
 
         if(ip_pckts == NULL) {
             return NULL;
         }
 
-        list_t* res = list_create_list();
+        iterator_t* iter = list_iterator_create(ip_pckts);
+
+        if(iter == NULL) {
+            list_destroy_with_type(ip_pckts, LIST_DESTROY_WITH_DATA, network_buffer_destroyer);
 
-        if(res == NULL) {
-            list_destroy_with_type(ip_pckts, LIST_DESTROY_WITH_DATA, network_transmit_packet_destroyer);
             return NULL;
         }
 
-        while(list_size(ip_pckts)) {
-            network_transmit_packet_t* ip_pckt = (network_transmit_packet_t*)list_queue_pop(ip_pckts);
+        int8_t res = 0;
 
-            if(ip_pckt) {
-                uint8_t* eth_packet = network_ethernet_create_packet(recv_eth_packet->source, our_mac, NETWORK_PROTOCOL_IPV4, ip_pckt->packet_len, ip_pckt->packet_data);
+        while(iter->end_of_iterator(iter) != 0) {
+            network_buffer_t* ip_pckt = (network_buffer_t*)iter->get_item(iter);
 
-                if(eth_packet == NULL) {
-                    memory_free(ip_pckt); // data deleted by network_ethernet_create_packet
-                    break;
-                }
+            res |= network_ethernet_push_header(ip_pckt, peer_mac, our_mac, NETWORK_ETHERNET_TYPE_IPV4);
 
-                network_transmit_packet_t* transmit_packet = memory_malloc(sizeof(network_transmit_packet_t));
-
-                if(transmit_packet == NULL) {
-                    memory_free(ip_pckt); // data deleted by network_ethernet_create_packet
-                    memory_free(eth_packet);
-                    break;
-                }
+            iter = iter->next(iter);
+        }
 
-                transmit_packet->packet_data = eth_packet;
-                transmit_packet->packet_len = sizeof(network_ethernet_t) + ip_pckt->packet_len;
+        iter->destroy(iter);
 
-                list_queue_push(res, transmit_packet);
+        if(res != 0) {
+            list_destroy_with_type(ip_pckts, LIST_DESTROY_WITH_DATA, network_buffer_destroyer);
 
-                memory_free(ip_pckt); // data deleted by network_ethernet_create_packet
-            }
+            return NULL;
         }
 
-        list_destroy_with_type(ip_pckts, LIST_DESTROY_WITH_DATA, network_transmit_packet_destroyer);
-
-        return res;
+        return ip_pckts;
     } else {
         PRINTLOG(NETWORK, LOG_TRACE, "unimplemented packet type 0x%04x", packet_type);
     }
 
     return NULL;
 }
-#pragma GCC diagnostic pop
 
-uint8_t* network_ethernet_create_packet(network_mac_address_t dst, network_mac_address_t src, network_ethernet_type_t type, uint16_t data_len, uint8_t* data) {
-    uint8_t* res = memory_malloc(sizeof(network_ethernet_t) + data_len);
+int8_t network_ethernet_push_header(network_buffer_t* nb, network_mac_address_t dst, network_mac_address_t src, network_ethernet_type_t type) {
+    network_ethernet_t* eth_packet = (network_ethernet_t*)network_buffer_push(nb, sizeof(network_ethernet_t));
 
-    if(res == NULL) {
-        return NULL;
-    }
+    if(eth_packet == NULL) {
+        PRINTLOG(NETWORK, LOG_ERROR, "no headroom for ethernet header");
 
-    network_ethernet_t* eth_packet = (network_ethernet_t*)res;
+        return -1;
+    }
 
     eth_packet->type = BYTE_SWAP16(type);
 
     memory_memcopy(dst, eth_packet->destination, sizeof(network_mac_address_t));
     memory_memcopy(src, eth_packet->source, sizeof(network_mac_address_t));
-    memory_memcopy(data, res + sizeof(network_ethernet_t), data_len);
-
-    memory_free(data);
 
-    return res;
+    return 0;
 }
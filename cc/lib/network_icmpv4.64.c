@@ -15,24 +15,50 @@
 
 MODULE("turnstone.lib.network");
 
-network_icmpv4_ping_header_t* network_create_ping_packet(boolean_t is_reply, uint16_t identifier, uint16_t sequence, uint16_t data_len, uint8_t* data, uint16_t* packet_len);
+network_buffer_t* network_create_ping_packet(boolean_t is_reply, uint16_t identifier, uint16_t sequence, uint16_t data_len, uint8_t* data);
 
+static uint16_t network_icmpv4_checksum(const uint8_t* packet, uint32_t packet_len) {
+    const uint16_t* packet_16 = (const uint16_t*)packet;
 
-uint8_t* network_icmpv4_process_packet(network_icmpv4_header_t* recv_icmpv4_packet, void* network_info, uint16_t* return_packet_len) {
-    if(return_packet_len == NULL) {
-        return NULL;
+    uint32_t csum = 0;
+
+    for(uint32_t i = 0; i < packet_len / 2; i++) {
+        csum += packet_16[i];
+
+        uint32_t carry = csum >> 16;
+        csum &= 0xFFFF;
+        csum += carry;
     }
 
+    if(packet_len & 1) {
+        csum += packet[packet_len - 1];
 
-    if(recv_icmpv4_packet->type == NETWORK_ICMP_ECHO_REQUEST && recv_icmpv4_packet->code == NETWORK_ICMP_ECHO_CODE) {
-        uint8_t* data = (uint8_t*)recv_icmpv4_packet;
-        data += sizeof(network_icmpv4_header_t);
-        uint16_t ping_data_len = *((uint16_t*)network_info);
+        uint32_t carry = csum >> 16;
+        csum &= 0xFFFF;
+        csum += carry;
+    }
+
+    int16_t res = csum;
+
+    return ~res;
+}
+
+network_buffer_t* network_icmpv4_process_packet(network_buffer_t* recv_buffer, void* network_info) {
+    UNUSED(network_info);
+
+    if(recv_buffer->length < sizeof(network_icmpv4_header_t)) {
+        return NULL;
+    }
 
-        network_icmpv4_ping_header_t* ping = network_create_ping_packet(1, recv_icmpv4_packet->identifier, recv_icmpv4_packet->sequence, ping_data_len, data, return_packet_len);
+    network_icmpv4_header_t* recv_icmpv4_packet = (network_icmpv4_header_t*)network_buffer_get_data(recv_buffer);
 
+    if(recv_icmpv4_packet->type == NETWORK_ICMP_ECHO_REQUEST && recv_icmpv4_packet->code == NETWORK_ICMP_ECHO_CODE) {
+        // echo data stays where it is, only header is turned into reply
+        recv_icmpv4_packet->type = NETWORK_ICMP_ECHO_REPLY;
+        recv_icmpv4_packet->checksum = 0;
+        recv_icmpv4_packet->checksum = network_icmpv4_checksum((uint8_t*)recv_icmpv4_packet, recv_buffer->length);
 
-        return (uint8_t*)ping;
+        return network_buffer_retain(recv_buffer);
     } else {
         PRINTLOG(NETWORK, LOG_TRACE, "unimplemented icmp type 0x%02x code 0x%02x", recv_icmpv4_packet->type, recv_icmpv4_packet->code);
     }
@@ -42,7 +68,7 @@ uint8_t* network_icmpv4_process_packet(network_icmpv4_header_t* recv_icmpv4_pack
 }
 
 
-network_icmpv4_ping_header_t* network_create_ping_packet(boolean_t is_reply, uint16_t identifier, uint16_t sequence, uint16_t data_len, uint8_t* data, uint16_t* packet_len) {
+network_buffer_t* network_create_ping_packet(boolean_t is_reply, uint16_t identifier, uint16_t sequence, uint16_t data_len, uint8_t* data) {
     uint16_t plen = 0;
     uint16_t data_offset = 0;
 
@@ -54,12 +80,16 @@ network_icmpv4_ping_header_t* network_create_ping_packet(boolean_t is_reply, uin
         data_offset = sizeof(network_icmpv4_ping_header_t);
     }
 
-    network_icmpv4_ping_header_t* pp = memory_malloc(plen);
+    network_buffer_t* nb = network_buffer_alloc(plen);
 
-    if(pp == NULL) {
+    if(nb == NULL) {
         return NULL;
     }
 
+    network_icmpv4_ping_header_t* pp = (network_icmpv4_ping_header_t*)network_buffer_put(nb, plen);
+
+    memory_memclean(pp, data_offset);
+
     pp->header.type = is_reply?NETWORK_ICMP_ECHO_REPLY:NETWORK_ICMP_ECHO_REQUEST;
     pp->header.code = NETWORK_ICMP_ECHO_CODE;
     pp->header.identifier = identifier;
@@ -77,25 +107,7 @@ network_icmpv4_ping_header_t* network_create_ping_packet(boolean_t is_reply, uin
 
     memory_memcopy(data, pp_data + data_offset, data_len);
 
-    uint16_t* pp_data_16 = (uint16_t*)pp_data;
-
-    uint32_t csum = 0;
-
-    for(uint16_t i = 0; i < plen / 2; i++) {
-        csum += pp_data_16[i];
-
-        uint32_t carry = csum >> 16;
-        csum &= 0xFFFF;
-        csum += carry;
-    }
-
-    int16_t res = csum;
-
-    pp->header.checksum = ~res;
-
-    if(packet_len) {
-        *packet_len = plen;
-    }
+    pp->header.checksum = network_icmpv4_checksum(pp_data, plen);
 
-    return (network_icmpv4_ping_header_t*)pp;
+    return nb;
 }
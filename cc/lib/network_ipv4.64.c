@@ -27,9 +27,8 @@ MODULE("turnstone.lib.network");
 map_t network_ipv4_packet_fragments = NULL;
 
 typedef struct network_ipv4_fragment_t {
-    uint32_t offset;
-    uint16_t data_len;
-    uint8_t* data;
+    uint32_t          offset;
+    network_buffer_t* buffer; ///< received buffer reference, data is fragment payload
 } network_ipv4_fragment_t;
 
 typedef struct network_ipv4_fragment_item_t {
@@ -53,8 +52,8 @@ network_ipv4_address_t NETWORK_IPV4_ZERO_IP = { .as_bytes = {0, 0, 0, 0} };
 int8_t   network_ipv4_fragment_comparator(const void* f1, const void* f2);
 uint16_t network_ipv4_header_checksum(network_ipv4_header_t* ipv4_hdr);
 int8_t   network_ipv4_header_checksum_verify(network_ipv4_header_t* ipv4_hdr);
-list_t*  network_ipv4_collect_fragments(network_ipv4_header_t* recv_ipv4_packet);
-uint8_t* network_ipv4_get_packet_data(network_ipv4_header_t* recv_ipv4_packet);
+list_t*           network_ipv4_collect_fragments(network_ipv4_header_t* recv_ipv4_packet, network_buffer_t* payload);
+network_buffer_t* network_ipv4_get_packet_buffer(network_ipv4_header_t* recv_ipv4_packet, network_buffer_t* payload);
 
 int8_t network_ipv4_fragment_comparator(const void* f1, const void* f2){
     const network_ipv4_fragment_t* tf1 = f1;
@@ -127,7 +126,7 @@ int8_t network_ipv4_header_checksum_verify(network_ipv4_header_t* ipv4_hdr){
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-list_t* network_ipv4_collect_fragments(network_ipv4_header_t* recv_ipv4_packet) {
+static network_ipv4_fragment_item_t* network_ipv4_add_fragment(network_ipv4_header_t* recv_ipv4_packet, network_buffer_t* payload) {
     uint64_t key = network_ipv4_fragment_key_generator(recv_ipv4_packet->destination_ip, recv_ipv4_packet->identification, recv_ipv4_packet->protocol);
 
     network_ipv4_fragment_item_t* frag_item = (network_ipv4_fragment_item_t*)map_get(network_ipv4_packet_fragments, (void*)key);
@@ -144,102 +143,99 @@ list_t* network_ipv4_collect_fragments(network_ipv4_header_t* recv_ipv4_packet)
         map_insert(network_ipv4_packet_fragments, (void*)key, frag_item);
     }
 
-    uint16_t data_len = BYTE_SWAP16(recv_ipv4_packet->total_length) - (recv_ipv4_packet->header_length * 4);
-    uint8_t* data = (uint8_t*)recv_ipv4_packet;
-    data += recv_ipv4_packet->header_length * 4;
-
-    frag_item->total_length += data_len;
-
     network_ipv4_fragment_t* frag = memory_malloc(sizeof(network_ipv4_fragment_t));
 
     if(frag == NULL) {
         return NULL;
     }
 
+    // fragment payload is not copied, received buffer is kept until reassembly
     frag->offset = (uint32_t)recv_ipv4_packet->flags_fragment_offset.fields.fragment_offset << 3;
-    frag->data_len = data_len;
-    frag->data = memory_malloc(data_len);
-    memory_memcopy(data, frag->data, data_len);
+    frag->buffer = network_buffer_retain(payload);
+
+    frag_item->total_length += payload->length;
 
     list_sortedlist_insert(frag_item->fragments, frag);
 
-    return NULL;
+    return frag_item;
 }
 
-uint8_t* network_ipv4_get_packet_data(network_ipv4_header_t* recv_ipv4_packet) {
-    uint8_t* packet_data = NULL;
-
-    if (recv_ipv4_packet->flags_fragment_offset.fields.fragment_offset) {
-        uint64_t key = network_ipv4_fragment_key_generator(recv_ipv4_packet->destination_ip, recv_ipv4_packet->identification, recv_ipv4_packet->protocol);
+list_t* network_ipv4_collect_fragments(network_ipv4_header_t* recv_ipv4_packet, network_buffer_t* payload) {
+    network_ipv4_add_fragment(recv_ipv4_packet, payload);
 
-        network_ipv4_fragment_item_t* frag_item = (network_ipv4_fragment_item_t*)map_get(network_ipv4_packet_fragments, (void*)key);
+    return NULL;
+}
 
-        if(frag_item == NULL) {
-            return NULL;
-        }
+network_buffer_t* network_ipv4_get_packet_buffer(network_ipv4_header_t* recv_ipv4_packet, network_buffer_t* payload) {
+    if (!recv_ipv4_packet->flags_fragment_offset.fields.fragment_offset) {
+        return network_buffer_retain(payload);
+    }
 
-        uint16_t data_len = BYTE_SWAP16(recv_ipv4_packet->total_length) - (recv_ipv4_packet->header_length * 4);
-        uint8_t* data = (uint8_t*)recv_ipv4_packet;
-        data += recv_ipv4_packet->header_length * 4;
+    uint64_t key = network_ipv4_fragment_key_generator(recv_ipv4_packet->destination_ip, recv_ipv4_packet->identification, recv_ipv4_packet->protocol);
 
-        frag_item->total_length += data_len;
+    if(map_get(network_ipv4_packet_fragments, (void*)key) == NULL) {
+        return NULL;
+    }
 
-        network_ipv4_fragment_t* frag = memory_malloc(sizeof(network_ipv4_fragment_t));
+    network_ipv4_fragment_item_t* frag_item = network_ipv4_add_fragment(recv_ipv4_packet, payload);
 
-        if(frag == NULL) {
-            return NULL;
-        }
+    if(frag_item == NULL) {
+        return NULL;
+    }
 
-        frag->offset = (uint32_t)recv_ipv4_packet->flags_fragment_offset.fields.fragment_offset << 3;
-        frag->data_len = data_len;
-        frag->data = memory_malloc(data_len);
-        memory_memcopy(data, frag->data, data_len);
+    // reassembly is the only copy at receive path
+    network_buffer_t* packet_buffer = network_buffer_alloc(frag_item->total_length);
+    uint8_t* packet_data = NULL;
 
-        list_sortedlist_insert(frag_item->fragments, frag);
+    if(packet_buffer != NULL) {
+        packet_data = network_buffer_put(packet_buffer, frag_item->total_length);
+    }
 
-        packet_data = memory_malloc(frag_item->total_length);
+    iterator_t* iter = list_iterator_create(frag_item->fragments);
 
-        iterator_t* iter = list_iterator_create(frag_item->fragments);
+    while(iter->end_of_iterator(iter) != 0) {
+        network_ipv4_fragment_t* frag =  (network_ipv4_fragment_t*)iter->delete_item(iter);
 
-        while(iter->end_of_iterator(iter) != 0) {
-            frag =  (network_ipv4_fragment_t*)iter->delete_item(iter);
+        PRINTLOG(NETWORK, LOG_TRACE, "reassembly offset %i len %i", frag->offset, frag->buffer->length);
 
-            PRINTLOG(NETWORK, LOG_TRACE, "reassembly offset %i len %i", frag->offset, frag->data_len);
+        if(packet_data != NULL && frag->offset + frag->buffer->length <= frag_item->total_length) {
+            memory_memcopy(network_buffer_get_data(frag->buffer), packet_data + frag->offset, frag->buffer->length);
+        }
 
-            memory_memcopy(frag->data, packet_data + frag->offset, frag->data_len);
+        network_buffer_release(frag->buffer);
+        memory_free(frag);
 
-            memory_free(frag->data);
-            memory_free(frag);
+        iter = iter->next(iter);
+    }
 
-            iter = iter->next(iter);
-        }
+    iter->destroy(iter);
 
-        iter->destroy(iter);
+    map_delete(network_ipv4_packet_fragments, (void*)key);
+    list_destroy(frag_item->fragments);
+    memory_free(frag_item);
 
-        map_delete(network_ipv4_packet_fragments, (void*)key);
-        list_destroy_with_data(frag_item->fragments);
-        memory_free(frag_item);
+    return packet_buffer;
+}
 
-    } else {
-        uint16_t data_len = BYTE_SWAP16(recv_ipv4_packet->total_length) - (recv_ipv4_packet->header_length * 4);
-        uint8_t* data = (uint8_t*)recv_ipv4_packet;
-        data += recv_ipv4_packet->header_length * 4;
+list_t* network_ipv4_process_packet(network_buffer_t* recv_buffer, void* network_info) {
+    if(network_ipv4_packet_fragments == NULL) {
+        network_ipv4_packet_fragments = map_integer();
+    }
 
-        packet_data = memory_malloc(data_len);
+    if(recv_buffer->length < sizeof(network_ipv4_header_t)) {
+        return NULL;
+    }
 
-        if(packet_data == NULL) {
-            return NULL;
-        }
+    network_ipv4_header_t* recv_ipv4_packet = (network_ipv4_header_t*)network_buffer_get_data(recv_buffer);
 
-        memory_memcopy(data, packet_data, data_len);
-    }
+    uint16_t header_length = recv_ipv4_packet->header_length * 4;
+    uint16_t total_length = BYTE_SWAP16(recv_ipv4_packet->total_length);
 
-    return packet_data;
-}
+    // ethernet padding is stripped with trim
+    if(header_length < sizeof(network_ipv4_header_t) || total_length < header_length || network_buffer_trim(recv_buffer, total_length) != 0) {
+        PRINTLOG(NETWORK, LOG_TRACE, "ipv4 packet length is invalid");
 
-list_t* network_ipv4_process_packet(network_ipv4_header_t* recv_ipv4_packet, void* network_info) {
-    if(network_ipv4_packet_fragments == NULL) {
-        network_ipv4_packet_fragments = map_integer();
+        return NULL;
     }
 
     if(network_ipv4_header_checksum_verify(recv_ipv4_packet) != 0) {
@@ -257,46 +253,41 @@ list_t* network_ipv4_process_packet(network_ipv4_header_t* recv_ipv4_packet, voi
 
     recv_ipv4_packet->flags_fragment_offset.bits = BYTE_SWAP16(recv_ipv4_packet->flags_fragment_offset.bits);
 
-    uint8_t* packet_data = NULL;
+    // replies are built over received header, so addresses are kept at stack
+    network_ipv4_address_t sip = recv_ipv4_packet->source_ip;
+    network_ipv4_address_t dip = recv_ipv4_packet->destination_ip;
+    network_ipv4_protocol_t protocol = recv_ipv4_packet->protocol;
+
+    network_buffer_pull(recv_buffer, header_length);
 
     if(recv_ipv4_packet->flags_fragment_offset.fields.flags & NETWORK_IPV4_FLAG_MORE_FRAGMENTS) {
-        return network_ipv4_collect_fragments(recv_ipv4_packet);
-    } else {
-        packet_data = network_ipv4_get_packet_data(recv_ipv4_packet);
+        return network_ipv4_collect_fragments(recv_ipv4_packet, recv_buffer);
     }
 
-    if(recv_ipv4_packet->protocol == NETWORK_IPV4_PROTOCOL_ICMPV4) {
-        if(!ni) {
-            memory_free(packet_data);
-            return NULL;
-        }
+    network_buffer_t* packet_buffer = network_ipv4_get_packet_buffer(recv_ipv4_packet, recv_buffer);
+
+    if(packet_buffer == NULL) {
+        return NULL;
+    }
 
-        if(ni && !ni->is_ipv4_address_set) {
-            memory_free(packet_data);
+    if(protocol == NETWORK_IPV4_PROTOCOL_ICMPV4) {
+        if(!ni || !ni->is_ipv4_address_set) {
+            network_buffer_release(packet_buffer);
             return NULL;
         }
 
-        uint8_t* icmp_data = (uint8_t*)recv_ipv4_packet;
-        icmp_data += recv_ipv4_packet->header_length * 4;
-        network_icmpv4_header_t* recv_icmp_hdr = (network_icmpv4_header_t*)icmp_data;
-
-        uint16_t pp_len = 0;
-        uint16_t ping_data_len = BYTE_SWAP16(recv_ipv4_packet->total_length) - ((recv_ipv4_packet->header_length * 4) + sizeof(network_icmpv4_header_t));
+        network_buffer_t* resp_icmp = network_icmpv4_process_packet(packet_buffer, network_info);
 
-        network_icmpv4_header_t* resp_icmp_hdr = (network_icmpv4_header_t*)network_icmpv4_process_packet(recv_icmp_hdr, &ping_data_len, &pp_len);
+        network_buffer_release(packet_buffer);
 
-        memory_free(packet_data);
+        return network_ipv4_create_packet_from_icmp_packet(ni->ipv4_address, sip, resp_icmp);
 
-        return network_ipv4_create_packet_from_icmp_packet(ni->ipv4_address, recv_ipv4_packet->source_ip, resp_icmp_hdr, pp_len);
+    } else if(protocol == NETWORK_IPV4_PROTOCOL_UDPV4) {
+        network_buffer_t* resp_udpv4 = network_udpv4_process_packet(dip, sip, packet_buffer, network_info);
 
-    } else if(recv_ipv4_packet->protocol == NETWORK_IPV4_PROTOCOL_UDPV4) {
-        network_udpv4_header_t* recv_udpv4_hdr = (network_udpv4_header_t*)packet_data;
+        network_buffer_release(packet_buffer);
 
-        network_udpv4_header_t* resp_udpv4_hdr = (network_udpv4_header_t*)network_udpv4_process_packet(recv_ipv4_packet->destination_ip, recv_ipv4_packet->source_ip, recv_udpv4_hdr, network_info, NULL);
-
-        memory_free(packet_data);
-
-        list_t* ip_pckts = network_ipv4_create_packet_from_udp_packet(recv_ipv4_packet->destination_ip, recv_ipv4_packet->source_ip, resp_udpv4_hdr);
+        list_t* ip_pckts = network_ipv4_create_packet_from_udp_packet(dip, sip, resp_udpv4);
 
         if(ip_pckts == NULL) {
             PRINTLOG(NETWORK, LOG_TRACE, "ipv4 packet response discarded");
@@ -304,18 +295,12 @@ list_t* network_ipv4_process_packet(network_ipv4_header_t* recv_ipv4_packet, voi
         }
 
         return ip_pckts;
-    } else if(recv_ipv4_packet->protocol == NETWORK_IPV4_PROTOCOL_TCPV4) {
-        network_tcpv4_header_t* recv_tcpv4_hdr = (network_tcpv4_header_t*)packet_data;
-
-        uint16_t data_len = BYTE_SWAP16(recv_ipv4_packet->total_length) - (recv_ipv4_packet->header_length * 4);
+    } else if(protocol == NETWORK_IPV4_PROTOCOL_TCPV4) {
+        network_buffer_t* resp_tcpv4 = network_tcpv4_process_packet(dip, sip, packet_buffer, network_info);
 
-        uint16_t pp_len = 0;
+        network_buffer_release(packet_buffer);
 
-        network_tcpv4_header_t* resp_tcpv4_hdr = (network_tcpv4_header_t*)network_tcpv4_process_packet(recv_ipv4_packet->destination_ip, recv_ipv4_packet->source_ip, recv_tcpv4_hdr, network_info, data_len, &pp_len);
-
-        memory_free(packet_data);
-
-        list_t* ip_pckts = network_ipv4_create_packet_from_tcp_packet(recv_ipv4_packet->destination_ip, recv_ipv4_packet->source_ip, resp_tcpv4_hdr, pp_len);
+        list_t* ip_pckts = network_ipv4_create_packet_from_tcp_packet(dip, sip, resp_tcpv4);
 
         if(ip_pckts == NULL) {
             PRINTLOG(NETWORK, LOG_TRACE, "ipv4 packet response discarded");
@@ -324,166 +309,39 @@ list_t* network_ipv4_process_packet(network_ipv4_header_t* recv_ipv4_packet, voi
 
         return ip_pckts;
     } else {
-        memory_free(packet_data);
-        PRINTLOG(NETWORK, LOG_TRACE, "unimplemented ipv4 protocol 0x%02x", recv_ipv4_packet->protocol);
+        network_buffer_release(packet_buffer);
+        PRINTLOG(NETWORK, LOG_TRACE, "unimplemented ipv4 protocol 0x%02x", protocol);
     }
 
     return NULL;
 }
 
-list_t* network_ipv4_create_packet_from_icmp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_icmpv4_header_t* icmp_hdr, uint16_t icmp_packet_len) {
-    uint16_t packet_len = sizeof(network_ipv4_header_t) + icmp_packet_len;
+static int8_t network_ipv4_push_header(network_buffer_t* nb, const network_ipv4_address_t sip, network_ipv4_address_t dip, network_ipv4_protocol_t protocol,
+                                       uint16_t identification, uint16_t offset, boolean_t more_fragments) {
+    uint16_t packet_len = sizeof(network_ipv4_header_t) + nb->length;
 
-    network_ipv4_header_t* ipv4_packet = memory_malloc(packet_len);
+    network_ipv4_header_t* ipv4_packet = (network_ipv4_header_t*)network_buffer_push(nb, sizeof(network_ipv4_header_t));
 
     if(ipv4_packet == NULL) {
-        return NULL;
+        PRINTLOG(NETWORK, LOG_ERROR, "no headroom for ipv4 header");
+
+        return -1;
     }
 
+    memory_memclean(ipv4_packet, sizeof(network_ipv4_header_t));
+
     ipv4_packet->version = NETWORK_IPV4_VERSION;
     ipv4_packet->header_length = 5;
     ipv4_packet->total_length = BYTE_SWAP16(packet_len);
     ipv4_packet->ttl = NETWORK_IPV4_TTL;
-    ipv4_packet->protocol = NETWORK_IPV4_PROTOCOL_ICMPV4;
-
-    ipv4_packet->source_ip = sip;
-    ipv4_packet->destination_ip = dip;
-
-    network_ipv4_header_checksum(ipv4_packet);
-
-    uint8_t* buf = (uint8_t*)ipv4_packet;
-    buf += ipv4_packet->header_length * 4;
-
-    memory_memcopy((void*)icmp_hdr, buf, icmp_packet_len);
-
-    memory_free(icmp_hdr);
-
-    network_transmit_packet_t* ipv4_pckt = memory_malloc(sizeof(network_transmit_packet_t));
-
-    if(ipv4_pckt == NULL) {
-        memory_free(ipv4_packet);
-        return NULL;
-    }
-
-    ipv4_pckt->packet_data = (uint8_t*)ipv4_packet;
-    ipv4_pckt->packet_len = packet_len;
-
-    list_t* ipv4_packets = list_create_list();
-
-    if(ipv4_packets == NULL) {
-        memory_free(ipv4_packet);
-        memory_free(ipv4_pckt);
-        return NULL;
-    }
-
-    list_queue_push(ipv4_packets, ipv4_pckt);
-
-    return ipv4_packets;
-}
-
-list_t* network_ipv4_create_packet_from_udp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_udpv4_header_t* udp_hdr) {
-    if(udp_hdr == NULL) {
-        return NULL;
-    }
-
-    list_t* fragments = list_create_list();
-
-    if(fragments == NULL) {
-        memory_free(udp_hdr);
-
-        return NULL;
-    }
-
-    uint8_t* raw_udp_hdr = (uint8_t*)udp_hdr;
-
-    uint16_t packet_len = BYTE_SWAP16(udp_hdr->length);
-
-    uint16_t max_packet_len = 1500 - sizeof(network_ipv4_header_t);
-
-    if(max_packet_len % 8) {
-        max_packet_len -= max_packet_len % 8;
-    }
-
-    uint16_t identification = 0;
-
-    if(packet_len > max_packet_len) {
-        identification = rand();
-    }
-
-    uint16_t offset = 0;
-
-    while(packet_len > max_packet_len) {
-        packet_len -= max_packet_len;
-
-        network_ipv4_header_t* ipv4_packet = memory_malloc(max_packet_len + sizeof(network_ipv4_header_t));
-
-        if(ipv4_packet == NULL) {
-            return NULL;
-        }
+    ipv4_packet->protocol = protocol;
+    ipv4_packet->identification = BYTE_SWAP16(identification);
+    ipv4_packet->flags_fragment_offset.fields.fragment_offset = offset >> 3;
 
-        ipv4_packet->version = NETWORK_IPV4_VERSION;
-        ipv4_packet->header_length = 5;
-        ipv4_packet->total_length = BYTE_SWAP16(max_packet_len + sizeof(network_ipv4_header_t));
-        ipv4_packet->ttl = NETWORK_IPV4_TTL;
-        ipv4_packet->protocol = NETWORK_IPV4_PROTOCOL_UDPV4;
-        ipv4_packet->identification = BYTE_SWAP16(identification);
-        ipv4_packet->flags_fragment_offset.fields.fragment_offset = offset >> 3;
+    if(more_fragments) {
         ipv4_packet->flags_fragment_offset.fields.flags = NETWORK_IPV4_FLAG_MORE_FRAGMENTS;
-        ipv4_packet->flags_fragment_offset.bits = BYTE_SWAP16(ipv4_packet->flags_fragment_offset.bits);
-
-        ipv4_packet->source_ip = sip;
-        ipv4_packet->destination_ip = dip;
-
-        network_ipv4_header_checksum(ipv4_packet);
-
-        uint32_t hcsum = udp_hdr->checksum + sip.as_words[0] + sip.as_words[1] + dip.as_words[0] + dip.as_words[1];
-
-        while(hcsum >> 16) {
-            uint32_t carry = hcsum >> 16;
-            hcsum &= 0xFFFF;
-            hcsum += carry;
-        }
-
-        int16_t csum = hcsum;
-
-        udp_hdr->checksum = ~csum;
-
-        uint8_t* buf = (uint8_t*)ipv4_packet;
-        buf += ipv4_packet->header_length * 4;
-
-        memory_memcopy(raw_udp_hdr, buf, max_packet_len);
-
-        raw_udp_hdr += max_packet_len;
-        offset += max_packet_len;
-
-        network_transmit_packet_t* ipv4_pckt = memory_malloc(sizeof(network_transmit_packet_t));
-
-        if(ipv4_pckt == NULL) {
-            memory_free(ipv4_packet);
-            list_destroy_with_type(fragments, LIST_DESTROY_WITH_DATA, network_transmit_packet_destroyer);
-            return NULL;
-        }
-
-        ipv4_pckt->packet_data = (uint8_t*)ipv4_packet;
-        ipv4_pckt->packet_len = max_packet_len + sizeof(network_ipv4_header_t);
-
-        list_queue_push(fragments, ipv4_pckt);
-    }
-
-
-    network_ipv4_header_t* ipv4_packet = memory_malloc(packet_len + sizeof(network_ipv4_header_t));
-
-    if(ipv4_packet == NULL) {
-        return NULL;
     }
 
-    ipv4_packet->version = NETWORK_IPV4_VERSION;
-    ipv4_packet->header_length = 5;
-    ipv4_packet->total_length = BYTE_SWAP16(packet_len + sizeof(network_ipv4_header_t));
-    ipv4_packet->ttl = NETWORK_IPV4_TTL;
-    ipv4_packet->protocol = NETWORK_IPV4_PROTOCOL_UDPV4;
-    ipv4_packet->identification = BYTE_SWAP16(identification);
-    ipv4_packet->flags_fragment_offset.fields.fragment_offset = offset >> 3;
     ipv4_packet->flags_fragment_offset.bits = BYTE_SWAP16(ipv4_packet->flags_fragment_offset.bits);
 
     ipv4_packet->source_ip = sip;
@@ -491,8 +349,11 @@ list_t* network_ipv4_create_packet_from_udp_packet(const network_ipv4_address_t
 
     network_ipv4_header_checksum(ipv4_packet);
 
+    return 0;
+}
 
-    uint32_t hcsum = udp_hdr->checksum + sip.as_words[0] + sip.as_words[1] + dip.as_words[0] + dip.as_words[1];
+static uint16_t network_ipv4_add_pseudo_header_checksum(uint16_t checksum, const network_ipv4_address_t sip, network_ipv4_address_t dip) {
+    uint32_t hcsum = checksum + sip.as_words[0] + sip.as_words[1] + dip.as_words[0] + dip.as_words[1];
 
     while(hcsum >> 16) {
         uint32_t carry = hcsum >> 16;
@@ -502,171 +363,92 @@ list_t* network_ipv4_create_packet_from_udp_packet(const network_ipv4_address_t
 
     int16_t csum = hcsum;
 
-    udp_hdr->checksum = ~csum;
-
-    uint8_t* buf = (uint8_t*)ipv4_packet;
-    buf += ipv4_packet->header_length * 4;
-
-    memory_memcopy(raw_udp_hdr, buf, packet_len);
-
-    memory_free(udp_hdr);
-
-    network_transmit_packet_t* ipv4_pckt = memory_malloc(sizeof(network_transmit_packet_t));
-
-    if(ipv4_pckt == NULL) {
-        memory_free(ipv4_packet);
-        list_destroy_with_type(fragments, LIST_DESTROY_WITH_DATA, network_transmit_packet_destroyer);
-        return NULL;
-    }
-
-    ipv4_pckt->packet_data = (uint8_t*)ipv4_packet;
-    ipv4_pckt->packet_len = packet_len + sizeof(network_ipv4_header_t);
-
-    list_queue_push(fragments, ipv4_pckt);
-
-    return fragments;
+    return ~csum;
 }
 
-list_t* network_ipv4_create_packet_from_tcp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_tcpv4_header_t* tcp_hdr, uint16_t packet_len) {
-    if(tcp_hdr == NULL) {
-        return NULL;
-    }
-
+static list_t* network_ipv4_create_packets(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_ipv4_protocol_t protocol, network_buffer_t* nb) {
     list_t* fragments = list_create_list();
 
     if(fragments == NULL) {
-        memory_free(tcp_hdr);
+        network_buffer_release(nb);
 
         return NULL;
     }
 
-    uint8_t* raw_tcp_hdr = (uint8_t*)tcp_hdr;
-
     uint16_t max_packet_len = 1500 - sizeof(network_ipv4_header_t);
 
     if(max_packet_len % 8) {
         max_packet_len -= max_packet_len % 8;
     }
 
-    uint16_t identification = 0;
-
-    if(packet_len > max_packet_len) {
-        identification = rand();
-    }
-
-    uint16_t offset = 0;
-
-    while(packet_len > max_packet_len) {
-        packet_len -= max_packet_len;
-
-        network_ipv4_header_t* ipv4_packet = memory_malloc(max_packet_len + sizeof(network_ipv4_header_t));
+    if(nb->length <= max_packet_len) {
+        // header is prepended in place, payload is not touched
+        if(network_ipv4_push_header(nb, sip, dip, protocol, 0, 0, false) != 0) {
+            network_buffer_release(nb);
+            list_destroy(fragments);
 
-        if(ipv4_packet == NULL) {
             return NULL;
         }
 
-        ipv4_packet->version = NETWORK_IPV4_VERSION;
-        ipv4_packet->header_length = 5;
-        ipv4_packet->total_length = BYTE_SWAP16(max_packet_len + sizeof(network_ipv4_header_t));
-        ipv4_packet->ttl = NETWORK_IPV4_TTL;
-        ipv4_packet->protocol = NETWORK_IPV4_PROTOCOL_TCPV4;
-        ipv4_packet->identification = BYTE_SWAP16(identification);
-        ipv4_packet->flags_fragment_offset.fields.fragment_offset = offset >> 3;
-        ipv4_packet->flags_fragment_offset.fields.flags = NETWORK_IPV4_FLAG_MORE_FRAGMENTS;
-        ipv4_packet->flags_fragment_offset.bits = BYTE_SWAP16(ipv4_packet->flags_fragment_offset.bits);
-
-        ipv4_packet->source_ip = sip;
-        ipv4_packet->destination_ip = dip;
-
-        network_ipv4_header_checksum(ipv4_packet);
-
-        uint32_t hcsum = tcp_hdr->checksum + sip.as_words[0] + sip.as_words[1] + dip.as_words[0] + dip.as_words[1];
-
-        while(hcsum >> 16) {
-            uint32_t carry = hcsum >> 16;
-            hcsum &= 0xFFFF;
-            hcsum += carry;
-        }
+        list_queue_push(fragments, nb);
 
-        int16_t csum = hcsum;
+        return fragments;
+    }
 
-        tcp_hdr->checksum = ~csum;
+    uint16_t identification = rand();
 
-        uint8_t* buf = (uint8_t*)ipv4_packet;
-        buf += ipv4_packet->header_length * 4;
+    uint8_t* data = network_buffer_get_data(nb);
 
-        memory_memcopy(raw_tcp_hdr, buf, max_packet_len);
+    for(uint32_t offset = 0; offset < nb->length; offset += max_packet_len) {
+        uint32_t frag_len = MIN(max_packet_len, nb->length - offset);
 
-        raw_tcp_hdr += max_packet_len;
-        offset += max_packet_len;
+        network_buffer_t* frag = network_buffer_create_from_data(data + offset, frag_len);
 
-        network_transmit_packet_t* ipv4_pckt = memory_malloc(sizeof(network_transmit_packet_t));
+        if(frag == NULL || network_ipv4_push_header(frag, sip, dip, protocol, identification, offset, offset + frag_len < nb->length) != 0) {
+            network_buffer_release(frag);
+            network_buffer_release(nb);
+            list_destroy_with_type(fragments, LIST_DESTROY_WITH_DATA, network_buffer_destroyer);
 
-        if(ipv4_pckt == NULL) {
-            memory_free(ipv4_packet);
-            list_destroy_with_type(fragments, LIST_DESTROY_WITH_DATA, network_transmit_packet_destroyer);
             return NULL;
         }
 
-        ipv4_pckt->packet_data = (uint8_t*)ipv4_packet;
-        ipv4_pckt->packet_len = max_packet_len + sizeof(network_ipv4_header_t);
-
-        list_queue_push(fragments, ipv4_pckt);
+        list_queue_push(fragments, frag);
     }
 
+    network_buffer_release(nb);
 
-    network_ipv4_header_t* ipv4_packet = memory_malloc(packet_len + sizeof(network_ipv4_header_t));
+    return fragments;
+}
 
-    if(ipv4_packet == NULL) {
+list_t* network_ipv4_create_packet_from_icmp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_buffer_t* icmp_buffer) {
+    if(icmp_buffer == NULL) {
         return NULL;
     }
 
-    ipv4_packet->version = NETWORK_IPV4_VERSION;
-    ipv4_packet->header_length = 5;
-    ipv4_packet->total_length = BYTE_SWAP16(packet_len + sizeof(network_ipv4_header_t));
-    ipv4_packet->ttl = NETWORK_IPV4_TTL;
-    ipv4_packet->protocol = NETWORK_IPV4_PROTOCOL_TCPV4;
-    ipv4_packet->identification = BYTE_SWAP16(identification);
-    ipv4_packet->flags_fragment_offset.fields.fragment_offset = offset >> 3;
-    ipv4_packet->flags_fragment_offset.bits = BYTE_SWAP16(ipv4_packet->flags_fragment_offset.bits);
-
-    ipv4_packet->source_ip = sip;
-    ipv4_packet->destination_ip = dip;
-
-    network_ipv4_header_checksum(ipv4_packet);
-
-    uint32_t hcsum = tcp_hdr->checksum + sip.as_words[0] + sip.as_words[1] + dip.as_words[0] + dip.as_words[1];
+    return network_ipv4_create_packets(sip, dip, NETWORK_IPV4_PROTOCOL_ICMPV4, icmp_buffer);
+}
 
-    while(hcsum >> 16) {
-        uint32_t carry = hcsum >> 16;
-        hcsum &= 0xFFFF;
-        hcsum += carry;
+list_t* network_ipv4_create_packet_from_udp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_buffer_t* udp_buffer) {
+    if(udp_buffer == NULL) {
+        return NULL;
     }
 
-    int16_t csum = hcsum;
+    network_udpv4_header_t* udp_hdr = (network_udpv4_header_t*)network_buffer_get_data(udp_buffer);
 
-    tcp_hdr->checksum = ~csum;
+    udp_hdr->checksum = network_ipv4_add_pseudo_header_checksum(udp_hdr->checksum, sip, dip);
 
-    uint8_t* buf = (uint8_t*)ipv4_packet;
-    buf += ipv4_packet->header_length * 4;
-
-    memory_memcopy(raw_tcp_hdr, buf, packet_len);
-
-    memory_free(tcp_hdr);
-
-    network_transmit_packet_t* ipv4_pckt = memory_malloc(sizeof(network_transmit_packet_t));
+    return network_ipv4_create_packets(sip, dip, NETWORK_IPV4_PROTOCOL_UDPV4, udp_buffer);
+}
 
-    if(ipv4_pckt == NULL) {
-        memory_free(ipv4_packet);
-        list_destroy_with_type(fragments, LIST_DESTROY_WITH_DATA, network_transmit_packet_destroyer);
+list_t* network_ipv4_create_packet_from_tcp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_buffer_t* tcp_buffer) {
+    if(tcp_buffer == NULL) {
         return NULL;
     }
 
-    ipv4_pckt->packet_data = (uint8_t*)ipv4_packet;
-    ipv4_pckt->packet_len = packet_len + sizeof(network_ipv4_header_t);
+    network_tcpv4_header_t* tcp_hdr = (network_tcpv4_header_t*)network_buffer_get_data(tcp_buffer);
 
-    list_queue_push(fragments, ipv4_pckt);
+    tcp_hdr->checksum = network_ipv4_add_pseudo_header_checksum(tcp_hdr->checksum, sip, dip);
 
-    return fragments;
+    return network_ipv4_create_packets(sip, dip, NETWORK_IPV4_PROTOCOL_TCPV4, tcp_buffer);
 }
 #pragma GCC diagnostic pop
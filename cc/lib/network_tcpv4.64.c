@@ -31,7 +31,7 @@ void                        network_tcpv4_connection_del(network_tcpv4_connectio
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
 network_tcpv4_listener_t* network_tcpv4_listener_get(network_ipv4_address_t ip, uint16_t port) {
     if(network_tcpv4_listener_ip_map == NULL) {
-        network_tcpv4_listener_ip_map = hashmap_integer(128);
+        network_tcpv4_listener_ip_map = hashmap_integer_concurrent(128);
     }
 
     uint64_t key = ((uint64_t)ip.as_dword << 16) | port;
@@ -59,7 +59,7 @@ network_tcpv4_listener_t* network_tcpv4_listener_get(network_ipv4_address_t ip,
 
 void network_tcpv4_listener_add(network_ipv4_address_t ip, uint16_t port) {
     if(network_tcpv4_listener_ip_map == NULL) {
-        network_tcpv4_listener_ip_map = hashmap_integer(128);
+        network_tcpv4_listener_ip_map = hashmap_integer_concurrent(128);
     }
 
     uint64_t key = ((uint64_t)ip.as_dword << 16) | port;
@@ -144,13 +144,29 @@ static uint16_t network_tcpv4_generate_checksum(network_tcpv4_header_t* tcpv4_pa
 }
 
 
-static network_tcpv4_header_t* network_tcpv4_create_reset_packet(uint16_t dest_port, uint16_t source_port, uint32_t sequence_number, uint32_t acknowledgement_number) {
-    network_tcpv4_header_t* res = memory_malloc(sizeof(network_tcpv4_header_t));
+static network_buffer_t* network_tcpv4_alloc_packet(uint16_t data_len) {
+    network_buffer_t* nb = network_buffer_alloc(sizeof(network_tcpv4_header_t) + data_len);
 
-    if(res == NULL) {
+    if(nb == NULL) {
+        return NULL;
+    }
+
+    uint8_t* header = network_buffer_put(nb, sizeof(network_tcpv4_header_t) + data_len);
+
+    memory_memclean(header, sizeof(network_tcpv4_header_t));
+
+    return nb;
+}
+
+static network_buffer_t* network_tcpv4_create_reset_packet(uint16_t dest_port, uint16_t source_port, uint32_t sequence_number, uint32_t acknowledgement_number) {
+    network_buffer_t* nb = network_tcpv4_alloc_packet(0);
+
+    if(nb == NULL) {
         return NULL;
     }
 
+    network_tcpv4_header_t* res = (network_tcpv4_header_t*)network_buffer_get_data(nb);
+
     res->source_port = BYTE_SWAP16(source_port);
     res->destination_port = BYTE_SWAP16(dest_port);
     res->sequence_number = BYTE_SWAP32(sequence_number);
@@ -161,16 +177,18 @@ static network_tcpv4_header_t* network_tcpv4_create_reset_packet(uint16_t dest_p
 
     res->checksum = network_tcpv4_generate_checksum(res, sizeof(network_tcpv4_header_t));
 
-    return res;
+    return nb;
 }
 
-static network_tcpv4_header_t* network_tcpv4_create_syn_ack_packet_from_connection(network_tcpv4_connection_t* connection) {
-    network_tcpv4_header_t* res = memory_malloc(sizeof(network_tcpv4_header_t));
+static network_buffer_t* network_tcpv4_create_syn_ack_packet_from_connection(network_tcpv4_connection_t* connection) {
+    network_buffer_t* nb = network_tcpv4_alloc_packet(0);
 
-    if(res == NULL) {
+    if(nb == NULL) {
         return NULL;
     }
 
+    network_tcpv4_header_t* res = (network_tcpv4_header_t*)network_buffer_get_data(nb);
+
     res->source_port = BYTE_SWAP16(connection->local_port);
     res->destination_port = BYTE_SWAP16(connection->remote_port);
     res->sequence_number = BYTE_SWAP32(connection->local_sequence_number);
@@ -182,16 +200,18 @@ static network_tcpv4_header_t* network_tcpv4_create_syn_ack_packet_from_connecti
 
     res->checksum = network_tcpv4_generate_checksum(res, sizeof(network_tcpv4_header_t));
 
-    return res;
+    return nb;
 }
 
-static network_tcpv4_header_t* network_tcpv4_create_ack_packet_from_connection(network_tcpv4_connection_t* connection) {
-    network_tcpv4_header_t* res = memory_malloc(sizeof(network_tcpv4_header_t));
+static network_buffer_t* network_tcpv4_create_ack_packet_from_connection(network_tcpv4_connection_t* connection) {
+    network_buffer_t* nb = network_tcpv4_alloc_packet(0);
 
-    if(res == NULL) {
+    if(nb == NULL) {
         return NULL;
     }
 
+    network_tcpv4_header_t* res = (network_tcpv4_header_t*)network_buffer_get_data(nb);
+
     res->source_port = BYTE_SWAP16(connection->local_port);
     res->destination_port = BYTE_SWAP16(connection->remote_port);
     res->sequence_number = BYTE_SWAP32(connection->local_sequence_number);
@@ -202,16 +222,20 @@ static network_tcpv4_header_t* network_tcpv4_create_ack_packet_from_connection(n
 
     res->checksum = network_tcpv4_generate_checksum(res, sizeof(network_tcpv4_header_t));
 
-    return res;
+    return nb;
 }
 
-static network_tcpv4_header_t* network_tcpv4_create_psh_ack_packet_from_connection(network_tcpv4_connection_t* connection, uint8_t* data, uint16_t data_len) {
-    network_tcpv4_header_t* res = memory_malloc(sizeof(network_tcpv4_header_t) + data_len);
+static network_buffer_t* network_tcpv4_create_psh_ack_packet_from_connection(network_tcpv4_connection_t* connection, network_buffer_t* nb) {
+    network_tcpv4_header_t* res = (network_tcpv4_header_t*)network_buffer_push(nb, sizeof(network_tcpv4_header_t));
 
     if(res == NULL) {
+        network_buffer_release(nb);
+
         return NULL;
     }
 
+    memory_memclean(res, sizeof(network_tcpv4_header_t));
+
     res->source_port = BYTE_SWAP16(connection->local_port);
     res->destination_port = BYTE_SWAP16(connection->remote_port);
     res->sequence_number = BYTE_SWAP32(connection->local_sequence_number);
@@ -221,28 +245,29 @@ static network_tcpv4_header_t* network_tcpv4_create_psh_ack_packet_from_connecti
     res->ack = 1;
     res->psh = 1;
 
-    uint8_t* t_res = (uint8_t*)res;
-    t_res += sizeof(network_tcpv4_header_t);
-
-    memory_memcopy(data, t_res, data_len);
-
-    res->checksum = network_tcpv4_generate_checksum(res, sizeof(network_tcpv4_header_t) + data_len);
+    res->checksum = network_tcpv4_generate_checksum(res, nb->length);
 
-    return res;
+    return nb;
 }
 
-uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_tcpv4_header_t* recv_tcpv4_packet, void* network_info, uint16_t packet_len, uint16_t* return_packet_len) {
+network_buffer_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_buffer_t* recv_buffer, void* network_info) {
     UNUSED(network_info);
-    UNUSED(return_packet_len);
 
-    if (recv_tcpv4_packet == NULL || return_packet_len == NULL) {
-        PRINTLOG(NETWORK, LOG_ERROR, "recv_tcpv4_packet/return_packet_len is NULL");
+    if (recv_buffer == NULL || recv_buffer->length < sizeof(network_tcpv4_header_t)) {
+        PRINTLOG(NETWORK, LOG_ERROR, "recv_buffer is NULL or short");
         return NULL;
     }
 
     PRINTLOG(NETWORK, LOG_TRACE, "Processing TCPv4 packet");
 
+    network_tcpv4_header_t* recv_tcpv4_packet = (network_tcpv4_header_t*)network_buffer_get_data(recv_buffer);
+    uint16_t packet_len = recv_buffer->length;
     uint16_t header_length = recv_tcpv4_packet->header_length * 4;
+
+    if(header_length < sizeof(network_tcpv4_header_t) || header_length > packet_len) {
+        PRINTLOG(NETWORK, LOG_TRACE, "Invalid header length");
+        return NULL;
+    }
     uint16_t data_length = packet_len - header_length;
 
     uint16_t source_port = recv_tcpv4_packet->source_port;
@@ -397,7 +422,7 @@ uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_a
         }
     }
 
-    network_tcpv4_header_t* res = NULL;
+    network_buffer_t* res = NULL;
 
     network_tcpv4_connection_t* connection = network_tcpv4_connection_get(dip, dest_port, sip, source_port);
 
@@ -409,10 +434,9 @@ uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_a
             res = network_tcpv4_create_reset_packet(source_port, dest_port, 0, seq_num + 1);
 
             if(res != NULL) {
-                *return_packet_len = sizeof(network_tcpv4_header_t);
-                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", res->length);
 
-                return (uint8_t*)res;
+                return res;
             }
 
             return NULL;
@@ -443,10 +467,9 @@ uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_a
             res = network_tcpv4_create_syn_ack_packet_from_connection(connection);
 
             if(res != NULL) {
-                *return_packet_len = sizeof(network_tcpv4_header_t);
-                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", res->length);
 
-                return (uint8_t*)res;
+                return res;
             }
         }
     }
@@ -477,24 +500,25 @@ uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_a
                     connection->local_sequence_number = connection->remote_acknowledgement_number;
                     connection->remote_sequence_number = connection->remote_sequence_number + data_length;
 
-                    uint16_t extra_data_length = 0;
-
                     if(dest_port == 7) {
-                        res = network_tcpv4_create_psh_ack_packet_from_connection(connection, data, data_length);
-                        extra_data_length = data_length;
+                        // echo payload is sent from received buffer, reply header overwrites received one
+                        network_buffer_pull(recv_buffer, header_length);
+                        res = network_tcpv4_create_psh_ack_packet_from_connection(connection, network_buffer_retain(recv_buffer));
                     } else if(dest_port == 80) {
                         const char* http_response = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 12\r\n\r\nHello World!";
-                        extra_data_length = strlen(http_response);
-                        res = network_tcpv4_create_psh_ack_packet_from_connection(connection, (uint8_t*)http_response, strlen(http_response));
+                        network_buffer_t* http_nb = network_buffer_create_from_data((const uint8_t*)http_response, strlen(http_response));
+
+                        if(http_nb != NULL) {
+                            res = network_tcpv4_create_psh_ack_packet_from_connection(connection, http_nb);
+                        }
                     } else {
                         res = network_tcpv4_create_ack_packet_from_connection(connection);
                     }
 
                     if(res != NULL) {
-                        *return_packet_len = sizeof(network_tcpv4_header_t) + extra_data_length;
-                        PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+                        PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", res->length);
 
-                        return (uint8_t*)res;
+                        return res;
                     }
 
                     return NULL;
@@ -510,10 +534,9 @@ uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_a
                     res = network_tcpv4_create_ack_packet_from_connection(connection);
 
                     if(res != NULL) {
-                        *return_packet_len = sizeof(network_tcpv4_header_t);
-                        PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+                        PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", res->length);
 
-                        return (uint8_t*)res;
+                        return res;
                     }
 
                     return NULL;
@@ -535,10 +558,9 @@ uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_a
             res = network_tcpv4_create_reset_packet(source_port, dest_port, 0, seq_num + 1);
 
             if(res != NULL) {
-                *return_packet_len = sizeof(network_tcpv4_header_t);
-                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", res->length);
 
-                return (uint8_t*)res;
+                return res;
             }
 
             return NULL;
@@ -558,10 +580,9 @@ uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_a
             res = network_tcpv4_create_reset_packet(source_port, dest_port, 0, seq_num + 1);
 
             if(res != NULL) {
-                *return_packet_len = sizeof(network_tcpv4_header_t);
-                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", res->length);
 
-                return (uint8_t*)res;
+                return res;
             }
 
             return NULL;
@@ -579,10 +600,9 @@ uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_a
             res = network_tcpv4_create_reset_packet(source_port, dest_port, 0, seq_num + 1);
 
             if(res != NULL) {
-                *return_packet_len = sizeof(network_tcpv4_header_t);
-                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+                PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", res->length);
 
-                return (uint8_t*)res;
+                return res;
             }
 
             return NULL;
@@ -593,10 +613,9 @@ uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_a
     res = network_tcpv4_create_reset_packet(source_port, dest_port, 0, seq_num + 1);
 
     if(res != NULL) {
-        *return_packet_len = sizeof(network_tcpv4_header_t);
-        PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", *return_packet_len);
+        PRINTLOG(NETWORK, LOG_TRACE, "return packet len: %i", res->length);
 
-        return (uint8_t*)res;
+        return res;
     }
 
 
@@ -17,49 +17,20 @@
 
 MODULE("turnstone.lib.network");
 
-uint8_t* network_udpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_udpv4_header_t* recv_udpv4_packet, void* network_info, uint16_t* return_packet_len) {
-    UNUSED(network_info);
-    UNUSED(return_packet_len);
-    UNUSED(sip);
-    UNUSED(dip);
-
-    if(recv_udpv4_packet == NULL) {
-        return NULL;
-    }
-
-    uint8_t* data = (uint8_t*)recv_udpv4_packet;
-    data += sizeof(network_udpv4_header_t);
-    uint16_t data_len = BYTE_SWAP16(recv_udpv4_packet->length) - sizeof(network_udpv4_header_t);
-
-    uint16_t dport = BYTE_SWAP16(recv_udpv4_packet->destination_port);
-    uint16_t sport = BYTE_SWAP16(recv_udpv4_packet->source_port);
-
-
-    PRINTLOG(NETWORK, LOG_TRACE, "udpv4 packet dest port %i data len %i", dport, data_len);
+static network_buffer_t* network_udpv4_push_header(network_buffer_t* nb, uint16_t sp, uint16_t dp) {
+    uint16_t len = nb->length;
+    uint8_t* data = network_buffer_get_data(nb);
 
+    network_udpv4_header_t* res = (network_udpv4_header_t*)network_buffer_push(nb, sizeof(network_udpv4_header_t));
 
-    if(dport == NETWORK_APPLICATION_PORT_ECHO_SERVER) {
-        return (uint8_t*)network_udpv4_create_packet_from_data(dport, sport, data_len, data);
-    } else if(dport == NETWORK_APPLICATION_PORT_DHCP_CLIENT) {
-        if(data_len < sizeof(network_dhcpv4_t)) {
-            return NULL;
-        }
+    if(res == NULL) {
+        network_buffer_release(nb);
 
-        network_dhcpv4_process_packet((network_dhcpv4_t*)data, network_info, NULL);
+        return NULL;
     }
 
-    return NULL;
-}
-
-network_udpv4_header_t* network_udpv4_create_packet_from_data(uint16_t sp, uint16_t dp, uint16_t len, uint8_t* data) {
     uint16_t packet_len = sizeof(network_udpv4_header_t) + len;
 
-    network_udpv4_header_t* res = memory_malloc(packet_len);
-
-    if(res == NULL) {
-        return NULL;
-    }
-
     res->source_port = BYTE_SWAP16(sp);
     res->destination_port = BYTE_SWAP16(dp);
     res->length = BYTE_SWAP16(packet_len);
@@ -85,10 +56,55 @@ network_udpv4_header_t* network_udpv4_create_packet_from_data(uint16_t sp, uint1
 
     res->checksum = hcsum;
 
-    uint8_t* udp_buffer = (uint8_t*)res;
-    udp_buffer += sizeof(network_udpv4_header_t);
+    return nb;
+}
+
+network_buffer_t* network_udpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_buffer_t* recv_buffer, void* network_info) {
+    UNUSED(sip);
+    UNUSED(dip);
 
-    memory_memcopy(data, udp_buffer, len);
+    if(recv_buffer == NULL || recv_buffer->length < sizeof(network_udpv4_header_t)) {
+        return NULL;
+    }
+
+    network_udpv4_header_t* recv_udpv4_packet = (network_udpv4_header_t*)network_buffer_get_data(recv_buffer);
+
+    uint16_t udp_len = BYTE_SWAP16(recv_udpv4_packet->length);
+
+    if(udp_len < sizeof(network_udpv4_header_t) || network_buffer_trim(recv_buffer, udp_len) != 0) {
+        return NULL;
+    }
+
+    uint16_t dport = BYTE_SWAP16(recv_udpv4_packet->destination_port);
+    uint16_t sport = BYTE_SWAP16(recv_udpv4_packet->source_port);
+
+    uint8_t* data = network_buffer_pull(recv_buffer, sizeof(network_udpv4_header_t));
+    uint16_t data_len = recv_buffer->length;
+
+
+    PRINTLOG(NETWORK, LOG_TRACE, "udpv4 packet dest port %i data len %i", dport, data_len);
+
+
+    if(dport == NETWORK_APPLICATION_PORT_ECHO_SERVER) {
+        // echo payload is not moved, new header overwrites received one
+        return network_udpv4_push_header(network_buffer_retain(recv_buffer), dport, sport);
+    } else if(dport == NETWORK_APPLICATION_PORT_DHCP_CLIENT) {
+        if(data_len < sizeof(network_dhcpv4_t)) {
+            return NULL;
+        }
+
+        network_dhcpv4_process_packet((network_dhcpv4_t*)data, network_info, NULL);
+    }
+
+    return NULL;
+}
+
+network_buffer_t* network_udpv4_create_packet_from_data(uint16_t sp, uint16_t dp, uint16_t len, uint8_t* data) {
+    network_buffer_t* nb = network_buffer_create_from_data(data, len);
+
+    if(nb == NULL) {
+        return NULL;
+    }
 
-    return res;
+    return network_udpv4_push_header(nb, sp, dp);
 }
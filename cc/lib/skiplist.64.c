@@ -0,0 +1,660 @@
+/**
+ * @file skiplist.64.c
+ * @brief concurrent skiplist implementation
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+#include <skiplist.h>
+#include <memory.h>
+#include <indexer.h>
+#include <utils.h>
+
+MODULE("turnstone.lib");
+
+/**
+ * @struct skiplist_node_value_t
+ * @brief data of node with its order, both are replaced at once
+ */
+typedef struct skiplist_node_value_t {
+    const void* data; ///< node data
+    uint64_t    order; ///< data order given by ordered inserts, zero for plain inserts
+} __attribute__((aligned(16))) skiplist_node_value_t; ///< short hand for struct
+
+/**
+ * @struct skiplist_node_t
+ * @brief skiplist node, tower of next pointers follows the node
+ */
+typedef struct skiplist_node_t {
+    const void*                      key; ///< node key, cloned if cloner is set
+    uint64_t                         sequence; ///< insert sequence, orders equal keys of non unique index
+    volatile skiplist_node_value_t   value; ///< node data and its order, replaced atomically
+    uint64_t                         level; ///< tower height
+    struct skiplist_node_t* volatile next[]; ///< next nodes for each level
+} skiplist_node_t; ///< short hand for struct
+
+/**
+ * @struct skiplist_internal_t
+ * @brief internal skiplist struct. used as metadata of index.
+ */
+typedef struct skiplist_internal_t {
+    skiplist_node_t*          head; ///< head node with full tower and without key
+    boolean_t                 unique; ///< if key present replace data
+    volatile uint64_t         size; ///< element count
+    volatile uint64_t         sequence; ///< next insert sequence, also seeds tower heights
+    index_key_comparator_f    comparator_for_identify_unique_subpart; ///< key comparator
+    skiplist_key_destroyer_f  key_destroyer; ///< key destroyer
+    skiplist_key_cloner_f     key_cloner; ///< key cloner
+} skiplist_internal_t; ///< short hand for struct
+
+/**
+ * @struct skiplist_iterator_internal_t
+ * @brief internal iterator struct
+ */
+typedef struct skiplist_iterator_internal_t {
+    memory_heap_t*              heap; ///< the heap used at iteration
+    index_key_comparator_f      comparator; ///< key comparator
+    const skiplist_node_t*      current; ///< current node, null at end
+    index_key_search_criteria_t criteria; ///< search criteria
+    const void*                 key1; ///< search key for all type
+    const void*                 key2; ///< search key for between
+} skiplist_iterator_internal_t; ///< short hand for struct
+
+/**
+ * @enum skiplist_locate_mode_t
+ * @brief how keys are compared while locating position at skiplist
+ */
+typedef enum skiplist_locate_mode_t {
+    SKIPLIST_LOCATE_FIRST_EQUAL_OR_GREATER_KEY, ///< stop at first node whose key is not less, only index comparator
+    SKIPLIST_LOCATE_FIRST_GREATER_KEY, ///< stop at first node whose key is greater, only index comparator
+    SKIPLIST_LOCATE_INSERT_POSITION, ///< stop at insert position of key with unique subpart and sequence
+} skiplist_locate_mode_t; ///< short hand for enum
+
+/*! skiplist insert implementation. see also index_t insert method*/
+int8_t skiplist_insert(index_t* idx, const void* key, const void* data, void** removed_data);
+/*! skiplist delete implementation. skiplist is insert only, always fails*/
+int8_t skiplist_delete(index_t* idx, const void* key, void** deleted_data);
+/*! skiplist contains implementation. see also index_t contains method*/
+boolean_t skiplist_contains(index_t* idx, const void* key);
+/*! skiplist find implementation. see also index_t find method*/
+const void* skiplist_find(index_t* idx, const void* key);
+/*! skiplist search implementation. see also index_t search method*/
+iterator_t* skiplist_search(index_t* idx, const void* key1, const void* key2, const index_key_search_criteria_t criteria);
+/*! skiplist iterator implementation. see also index_t create_iterator method*/
+iterator_t* skiplist_iterator_create(index_t* idx);
+/*! skiplist size implementation.*/
+uint64_t skiplist_size(index_t* idx);
+/*! skiplist iterator destroy implementation. see also iterator_t destroy method*/
+int8_t skiplist_iterator_destroy(iterator_t* iterator);
+/*! skiplist iterator end implementation. see also iterator_t end_of_iterator method*/
+int8_t skiplist_iterator_end_of_index(iterator_t* iterator);
+/*! skiplist iterator next implementation. see also iterator_t next method*/
+iterator_t* skiplist_iterator_next(iterator_t* iterator);
+/*! skiplist iterator key implementation. see also iterator_t get_extra_data method*/
+const void* skiplist_iterator_get_key(iterator_t* iterator);
+/*! skiplist iterator data implementation. see also iterator_t get_item method*/
+const void* skiplist_iterator_get_data(iterator_t* iterator);
+
+static inline boolean_t skiplist_cas(skiplist_node_t* volatile* target, skiplist_node_t* expected, skiplist_node_t* desired) {
+    boolean_t res = false;
+    __asm__ __volatile__ ("lock cmpxchgq %[desired], %[target]\n"
+                          : "=@ccz" (res), [target] "+m" (*target), "+a" (expected)
+                          : [desired] "r" (desired)
+                          : "memory");
+    return res;
+}
+
+static inline const void* skiplist_xchg(const void* volatile* target, const void* value) {
+    __asm__ __volatile__ ("xchgq %[value], %[target]\n" : [value] "+r" (value), [target] "+m" (*target) : : "memory");
+    return value;
+}
+
+static inline boolean_t skiplist_cas_value(volatile skiplist_node_value_t* target, skiplist_node_value_t expected, skiplist_node_value_t desired) {
+    boolean_t res = false;
+    __asm__ __volatile__ ("lock cmpxchg16b %[target]\n"
+                          : "=@ccz" (res), [target] "+m" (*target), "+a" (expected.data), "+d" (expected.order)
+                          : "b" (desired.data), "c" (desired.order)
+                          : "memory");
+    return res;
+}
+
+static inline uint64_t skiplist_fetch_add(volatile uint64_t* target, uint64_t value) {
+    __asm__ __volatile__ ("lock xaddq %[value], %[target]\n" : [value] "+r" (value), [target] "+m" (*target) : : "memory");
+    return value;
+}
+
+/**
+ * @brief compares node with the key at insert order: index comparator, unique subpart and insert sequence
+ * @param[in] idx skiplist index
+ * @param[in] node node to compare
+ * @param[in] key key to compare
+ * @param[in] sequence insert sequence of key
+ * @return -1 if node is before key, 1 if node is after key, 0 if equal
+ */
+static int8_t skiplist_compare_insert_order(const index_t* idx, const skiplist_node_t* node, const void* key, uint64_t sequence) {
+    const skiplist_internal_t* sl = (const skiplist_internal_t*)idx->metadata;
+
+    int8_t res = idx->comparator(node->key, key);
+
+    if(res != 0 || sl->unique) {
+        return res;
+    }
+
+    if(sl->comparator_for_identify_unique_subpart) {
+        return sl->comparator_for_identify_unique_subpart(node->key, key);
+    }
+
+    if(node->sequence < sequence) {
+        return -1;
+    }
+
+    if(node->sequence > sequence) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief finds first node which is not before the key at each level.
+ * @param[in] idx skiplist index
+ * @param[in] key key to locate
+ * @param[in] sequence insert sequence of key, used only for insert position
+ * @param[in] mode comparison mode
+ * @param[out] preds last nodes before key at each level, may be null
+ * @param[out] succs first nodes not before key at each level, may be null
+ * @return first node not before key at level 0
+ */
+static skiplist_node_t* skiplist_locate(const index_t* idx, const void* key, uint64_t sequence, skiplist_locate_mode_t mode,
+                                        skiplist_node_t** preds, skiplist_node_t** succs) {
+    const skiplist_internal_t* sl = (const skiplist_internal_t*)idx->metadata;
+
+    skiplist_node_t* pred = sl->head;
+    skiplist_node_t* cur = NULL;
+
+    for(int64_t level = SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+        cur = pred->next[level];
+
+        while(cur) {
+            int8_t c_res = 0;
+
+            if(mode == SKIPLIST_LOCATE_INSERT_POSITION) {
+                c_res = skiplist_compare_insert_order(idx, cur, key, sequence);
+            } else {
+                c_res = idx->comparator(cur->key, key);
+
+                if(mode == SKIPLIST_LOCATE_FIRST_GREATER_KEY && c_res == 0) {
+                    c_res = -1;
+                }
+            }
+
+            if(c_res >= 0) {
+                break;
+            }
+
+            pred = cur;
+            cur = cur->next[level];
+        }
+
+        if(preds) {
+            preds[level] = pred;
+        }
+
+        if(succs) {
+            succs[level] = cur;
+        }
+    }
+
+    return cur;
+}
+
+static uint64_t skiplist_random_level(uint64_t seed) {
+    uint64_t x = seed * 0x9E3779B97F4A7C15ULL;
+
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+
+    uint64_t level = 1;
+
+    // each level is promoted with 1/4 probability
+    while(level < SKIPLIST_MAX_LEVEL && (x & 3) == 0) {
+        level++;
+        x >>= 2;
+    }
+
+    return level;
+}
+
+static void skiplist_node_destroy(index_t* idx, skiplist_node_t* node) {
+    skiplist_internal_t* sl = (skiplist_internal_t*)idx->metadata;
+
+    if(sl->key_cloner && sl->key_destroyer) {
+        sl->key_destroyer(idx->heap, (void*)node->key);
+    }
+
+    memory_free_ext(idx->heap, node);
+}
+
+static skiplist_node_t* skiplist_node_create(index_t* idx, const void* key, const void* data, uint64_t order, uint64_t sequence) {
+    skiplist_internal_t* sl = (skiplist_internal_t*)idx->metadata;
+
+    uint64_t level = skiplist_random_level(sequence);
+
+    skiplist_node_t* node = memory_malloc_ext(idx->heap, sizeof(skiplist_node_t) + sizeof(skiplist_node_t*) * level, 0x10);
+
+    if(node == NULL) {
+        return NULL;
+    }
+
+    node->key = key;
+    node->value.data = data;
+    node->value.order = order;
+    node->sequence = sequence;
+    node->level = level;
+
+    if(sl->key_cloner) {
+        void* cloned_key = NULL;
+
+        if(sl->key_cloner(idx->heap, key, &cloned_key) != 0) {
+            memory_free_ext(idx->heap, node);
+
+            return NULL;
+        }
+
+        node->key = cloned_key;
+    }
+
+    return node;
+}
+
+int8_t skiplist_set_comparator_for_unique_subpart_for_non_unique_index(index_t* idx, index_key_comparator_f comparator) {
+    if(idx == NULL || idx->metadata == NULL || comparator == NULL) {
+        return -1;
+    }
+
+    skiplist_internal_t* sl = (skiplist_internal_t*)idx->metadata;
+
+    sl->comparator_for_identify_unique_subpart = comparator;
+
+    return 0;
+}
+
+int8_t skiplist_set_key_destroyer(index_t* idx, skiplist_key_destroyer_f destroyer) {
+    if(idx == NULL || idx->metadata == NULL || destroyer == NULL) {
+        return -1;
+    }
+
+    skiplist_internal_t* sl = (skiplist_internal_t*)idx->metadata;
+
+    sl->key_destroyer = destroyer;
+
+    return 0;
+}
+
+int8_t skiplist_set_key_cloner(index_t* idx, skiplist_key_cloner_f cloner) {
+    if(idx == NULL || idx->metadata == NULL || cloner == NULL) {
+        return -1;
+    }
+
+    skiplist_internal_t* sl = (skiplist_internal_t*)idx->metadata;
+
+    sl->key_cloner = cloner;
+
+    return 0;
+}
+
+index_t* skiplist_create_index_with_heap_and_unique(memory_heap_t* heap, index_key_comparator_f comparator, boolean_t unique) {
+    if(comparator == NULL) {
+        return NULL;
+    }
+
+    heap = memory_get_heap(heap);
+
+    skiplist_internal_t* sl = memory_malloc_ext(heap, sizeof(skiplist_internal_t), 0x0);
+
+    if(sl == NULL) {
+        return NULL;
+    }
+
+    sl->head = memory_malloc_ext(heap, sizeof(skiplist_node_t) + sizeof(skiplist_node_t*) * SKIPLIST_MAX_LEVEL, 0x10);
+
+    if(sl->head == NULL) {
+        memory_free_ext(heap, sl);
+
+        return NULL;
+    }
+
+    sl->head->level = SKIPLIST_MAX_LEVEL;
+    sl->unique = unique;
+    sl->sequence = 1;
+
+    index_t* idx = memory_malloc_ext(heap, sizeof(index_t), 0x0);
+
+    if(idx == NULL) {
+        memory_free_ext(heap, sl->head);
+        memory_free_ext(heap, sl);
+
+        return NULL;
+    }
+
+    idx->heap = heap;
+    idx->metadata = sl;
+    idx->comparator = comparator;
+    idx->insert = &skiplist_insert;
+    idx->delete = &skiplist_delete;
+    idx->contains = &skiplist_contains;
+    idx->find = &skiplist_find;
+    idx->search = &skiplist_search;
+    idx->create_iterator = &skiplist_iterator_create;
+    idx->size = &skiplist_size;
+
+    return idx;
+}
+
+int8_t skiplist_destroy_index(index_t* idx) {
+    if(idx == NULL || idx->metadata == NULL) {
+        return -1;
+    }
+
+    skiplist_internal_t* sl = (skiplist_internal_t*)idx->metadata;
+
+    skiplist_node_t* node = sl->head->next[0];
+
+    while(node) {
+        skiplist_node_t* next = node->next[0];
+
+        skiplist_node_destroy(idx, node);
+
+        node = next;
+    }
+
+    memory_free_ext(idx->heap, sl->head);
+    memory_free_ext(idx->heap, sl);
+    memory_free_ext(idx->heap, idx);
+
+    return 0;
+}
+
+/**
+ * @brief inserts key or replaces data of equal key
+ * @param[in] idx skiplist index
+ * @param[in] key key to insert
+ * @param[in] data data of key
+ * @param[in] order data order, used only if ordered flag is set
+ * @param[in] ordered data of equal key is replaced only if its order is not greater
+ * @param[out] removed_data replaced data, or data itself if it is not inserted
+ * @return 0 if succeed
+ */
+static int8_t skiplist_insert_internal(index_t* idx, const void* key, const void* data, uint64_t order, boolean_t ordered, void** removed_data) {
+    if(idx == NULL || idx->metadata == NULL || key == NULL) {
+        return -1;
+    }
+
+    if(removed_data) {
+        *removed_data = NULL;
+    }
+
+    skiplist_internal_t* sl = (skiplist_internal_t*)idx->metadata;
+
+    skiplist_node_t* preds[SKIPLIST_MAX_LEVEL];
+    skiplist_node_t* succs[SKIPLIST_MAX_LEVEL];
+
+    uint64_t sequence = skiplist_fetch_add(&sl->sequence, 1);
+    skiplist_node_t* node = NULL;
+
+    while(true) {
+        skiplist_node_t* found = skiplist_locate(idx, key, sequence, SKIPLIST_LOCATE_INSERT_POSITION, preds, succs);
+
+        if(found && skiplist_compare_insert_order(idx, found, key, sequence) == 0) {
+            // key is already present, swap data and leave node at its place for concurrent readers
+            const void* old_data = NULL;
+
+            if(ordered) {
+                // a torn read is corrected by the failing cas, order of a node only grows
+                while(true) {
+                    skiplist_node_value_t expected = {.data = found->value.data, .order = found->value.order};
+
+                    if(expected.order > order) {
+                        old_data = data;
+
+                        break;
+                    }
+
+                    skiplist_node_value_t desired = {.data = data, .order = order};
+
+                    if(skiplist_cas_value(&found->value, expected, desired)) {
+                        old_data = expected.data;
+
+                        break;
+                    }
+                }
+            } else {
+                old_data = skiplist_xchg(&found->value.data, data);
+            }
+
+            if(removed_data) {
+                *removed_data = (void*)old_data;
+            }
+
+            if(node) {
+                skiplist_node_destroy(idx, node);
+            }
+
+            return 0;
+        }
+
+        if(node == NULL) {
+            node = skiplist_node_create(idx, key, data, ordered ? order : 0, sequence);
+
+            if(node == NULL) {
+                return -1;
+            }
+        }
+
+        // node becomes visible when it is linked at level 0, other levels are only shortcuts
+        node->next[0] = succs[0];
+
+        if(skiplist_cas(&preds[0]->next[0], succs[0], node)) {
+            break;
+        }
+    }
+
+    for(uint64_t level = 1; level < node->level; level++) {
+        while(true) {
+            node->next[level] = succs[level];
+
+            if(skiplist_cas(&preds[level]->next[level], succs[level], node)) {
+                break;
+            }
+
+            skiplist_locate(idx, node->key, node->sequence, SKIPLIST_LOCATE_INSERT_POSITION, preds, succs);
+        }
+    }
+
+    skiplist_fetch_add(&sl->size, 1);
+
+    return 0;
+}
+
+int8_t skiplist_insert(index_t* idx, const void* key, const void* data, void** removed_data) {
+    return skiplist_insert_internal(idx, key, data, 0, false, removed_data);
+}
+
+int8_t skiplist_insert_with_order(index_t* idx, const void* key, const void* data, uint64_t order, void** removed_data) {
+    return skiplist_insert_internal(idx, key, data, order, true, removed_data);
+}
+
+int8_t skiplist_delete(index_t* idx, const void* key, void** deleted_data) {
+    UNUSED(idx);
+    UNUSED(key);
+
+    if(deleted_data) {
+        *deleted_data = NULL;
+    }
+
+    return -1;
+}
+
+const void* skiplist_find(index_t* idx, const void* key) {
+    if(idx == NULL || idx->metadata == NULL || key == NULL) {
+        return NULL;
+    }
+
+    const skiplist_node_t* node = skiplist_locate(idx, key, 0, SKIPLIST_LOCATE_FIRST_EQUAL_OR_GREATER_KEY, NULL, NULL);
+
+    if(node && idx->comparator(node->key, key) == 0) {
+        return node->value.data;
+    }
+
+    return NULL;
+}
+
+boolean_t skiplist_contains(index_t* idx, const void* key) {
+    if(idx == NULL || idx->metadata == NULL || key == NULL) {
+        return false;
+    }
+
+    const skiplist_node_t* node = skiplist_locate(idx, key, 0, SKIPLIST_LOCATE_FIRST_EQUAL_OR_GREATER_KEY, NULL, NULL);
+
+    return node && idx->comparator(node->key, key) == 0;
+}
+
+uint64_t skiplist_size(index_t* idx) {
+    if(!idx || !idx->metadata) {
+        return 0;
+    }
+
+    skiplist_internal_t* sl = idx->metadata;
+
+    return sl->size;
+}
+
+/**
+ * @brief ends iteration if current node is out of search range
+ * @param[in] iter iterator metadata
+ */
+static void skiplist_iterator_check_range(skiplist_iterator_internal_t* iter) {
+    if(iter->current == NULL) {
+        return;
+    }
+
+    switch(iter->criteria) {
+    case INDEXER_KEY_COMPARATOR_CRITERIA_LESS:
+        if(iter->comparator(iter->current->key, iter->key1) >= 0) {
+            iter->current = NULL;
+        }
+        break;
+    case INDEXER_KEY_COMPARATOR_CRITERIA_LESSOREQUAL:
+    case INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL:
+        if(iter->comparator(iter->current->key, iter->key1) > 0) {
+            iter->current = NULL;
+        }
+        break;
+    case INDEXER_KEY_COMPARATOR_CRITERIA_BETWEEN:
+        if(iter->comparator(iter->current->key, iter->key2) > 0) {
+            iter->current = NULL;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+iterator_t* skiplist_search(index_t* idx, const void* key1, const void* key2, const index_key_search_criteria_t criteria) {
+    if(idx == NULL || idx->metadata == NULL) {
+        return NULL;
+    }
+
+    skiplist_internal_t* sl = (skiplist_internal_t*)idx->metadata;
+
+    skiplist_iterator_internal_t* iter = memory_malloc_ext(idx->heap, sizeof(skiplist_iterator_internal_t), 0x0);
+
+    if(iter == NULL) {
+        return NULL;
+    }
+
+    iter->heap = idx->heap;
+    iter->comparator = idx->comparator;
+    iter->criteria = criteria;
+    iter->key1 = key1;
+    iter->key2 = key2;
+
+    if(criteria == INDEXER_KEY_COMPARATOR_CRITERIA_GREATER) {
+        iter->current = skiplist_locate(idx, key1, 0, SKIPLIST_LOCATE_FIRST_GREATER_KEY, NULL, NULL);
+    } else if(criteria >= INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL) {
+        iter->current = skiplist_locate(idx, key1, 0, SKIPLIST_LOCATE_FIRST_EQUAL_OR_GREATER_KEY, NULL, NULL);
+    } else {
+        iter->current = sl->head->next[0];
+    }
+
+    skiplist_iterator_check_range(iter);
+
+    iterator_t* iterator = memory_malloc_ext(idx->heap, sizeof(iterator_t), 0x0);
+
+    if(iterator == NULL) {
+        memory_free_ext(idx->heap, iter);
+
+        return NULL;
+    }
+
+    iterator->metadata = iter;
+    iterator->destroy = &skiplist_iterator_destroy;
+    iterator->next = &skiplist_iterator_next;
+    iterator->end_of_iterator = &skiplist_iterator_end_of_index;
+    iterator->get_item = &skiplist_iterator_get_data;
+    iterator->delete_item = NULL;
+    iterator->get_extra_data = &skiplist_iterator_get_key;
+
+    return iterator;
+}
+
+iterator_t* skiplist_iterator_create(index_t* idx) {
+    return skiplist_search(idx, NULL, NULL, INDEXER_KEY_COMPARATOR_CRITERIA_NULL);
+}
+
+int8_t skiplist_iterator_destroy(iterator_t* iterator) {
+    skiplist_iterator_internal_t* iter = (skiplist_iterator_internal_t*)iterator->metadata;
+    memory_heap_t* heap = iter->heap;
+    memory_free_ext(heap, iter);
+    memory_free_ext(heap, iterator);
+    return 0;
+}
+
+int8_t skiplist_iterator_end_of_index(iterator_t* iterator) {
+    skiplist_iterator_internal_t* iter = (skiplist_iterator_internal_t*)iterator->metadata;
+    return iter->current != NULL;
+}
+
+iterator_t* skiplist_iterator_next(iterator_t* iterator) {
+    skiplist_iterator_internal_t* iter = (skiplist_iterator_internal_t*)iterator->metadata;
+
+    if(iter->current) {
+        iter->current = iter->current->next[0];
+        skiplist_iterator_check_range(iter);
+    }
+
+    return iterator;
+}
+
+const void* skiplist_iterator_get_key(iterator_t* iterator) {
+    skiplist_iterator_internal_t* iter = (skiplist_iterator_internal_t*)iterator->metadata;
+
+    if(iter->current == NULL) {
+        return NULL;
+    }
+
+    return iter->current->key;
+}
+
+const void* skiplist_iterator_get_data(iterator_t* iterator) {
+    skiplist_iterator_internal_t* iter = (skiplist_iterator_internal_t*)iterator->metadata;
+
+    if(iter->current == NULL) {
+        return NULL;
+    }
+
+    return iter->current->value.data;
+}
@@ -17,27 +17,43 @@
 #include <memory/paging.h>
 #include <stdbufs.h>
 #include <logging.h>
+#include <utils.h>
 
 MODULE("turnstone.kernel.memory.frame");
 
 
 static frame_allocator_t* frame_allocator_default = NULL;
 
+/**
+ * @struct frame_allocator_cpu_cache_t
+ * @brief single frame cache of a cpu
+ */
+typedef struct frame_allocator_cpu_cache_t {
+    volatile uint64_t busy; ///< owner or drainer is inside cache
+    uint64_t          count; ///< cached frame count
+    uint64_t          frames[FRAME_ALLOCATOR_CPU_CACHE_SIZE]; ///< cached frame addresses
+} frame_allocator_cpu_cache_t;
+
 typedef struct frame_allocator_context_t {
-    memory_heap_t* heap;
-    list_t*        free_frames_sorted_by_size;
-    list_t*        acpi_frames;
-    index_t*       free_frames_by_address;
-    index_t*       allocated_frames_by_address;
-    index_t*       reserved_frames_by_address;
-    lock_t*        lock;
-    uint64_t       total_frame_count;
-    uint64_t       free_frame_count;
-    uint64_t       allocated_frame_count;
+    memory_heap_t*                  heap;
+    list_t*                         acpi_frames;
+    index_t*                        allocated_frames_by_address; ///< only old reserved allocations, other used frames are not tracked
+    index_t*                        reserved_frames_by_address;
+    lock_t*                         lock;
+    uint64_t                        total_frame_count;
+    volatile uint64_t               free_frame_count;
+    volatile uint64_t               allocated_frame_count;
+    uint64_t                        buddy_base; ///< physical address of first frame of buddy, aligned to max order
+    uint64_t                        buddy_frame_count; ///< frame count covered by buddy, multiple of max order block
+    uint64_t*                       buddy_bitmaps[FRAME_ALLOCATOR_BUDDY_ORDER_COUNT]; ///< set bits are free blocks of order
+    uint64_t                        buddy_word_counts[FRAME_ALLOCATOR_BUDDY_ORDER_COUNT]; ///< word count of bitmaps
+    uint64_t                        buddy_hints[FRAME_ALLOCATOR_BUDDY_ORDER_COUNT]; ///< first word of bitmaps which may have free block
+    uint64_t*                       tracked_bitmap; ///< set bits are frames tracked by reserved or allocated trees
+    frame_allocator_cpu_id_getter_f cpu_id_getter;
+    frame_allocator_cpu_cache_t*    cpu_caches;
 } frame_allocator_context_t;
 
 
-int8_t       frame_allocator_cmp_by_size(const void* data1, const void* data2);
 int8_t       frame_allocator_cmp_by_address(const void* data1, const void* data2);
 int8_t       fa_reserve_system_frames(frame_allocator_t* self, frame_t* f);
 int8_t       fa_allocate_frame_by_count(frame_allocator_t* self, uint64_t count, frame_allocation_type_t fa_type, frame_t** fs, uint64_t* alloc_list_size);
@@ -51,19 +67,6 @@ uint64_t     fa_get_total_frame_count(frame_allocator_t* self);
 uint64_t     fa_get_free_frame_count(frame_allocator_t* self);
 uint64_t     fa_get_allocated_frame_count(frame_allocator_t* self);
 
-int8_t frame_allocator_cmp_by_size(const void* data1, const void* data2){
-    frame_t* f1 = (frame_t*)data1;
-    frame_t* f2 = (frame_t*)data2;
-
-    if(f1->frame_count > f2->frame_count) {
-        return 1;
-    } else if(f1->frame_count < f2->frame_count) {
-        return -1;
-    }
-
-    return 0;
-}
-
 int8_t frame_allocator_cmp_by_address(const void* data1, const void* data2){
     frame_t* f1 = (frame_t*)data1;
     frame_t* f2 = (frame_t*)data2;
@@ -115,590 +118,838 @@ uint64_t fa_get_allocated_frame_count(frame_allocator_t* self) {
     return ctx->allocated_frame_count;
 }
 
-int8_t fa_reserve_system_frames(frame_allocator_t* self, frame_t* f){
-    frame_allocator_context_t* ctx = (frame_allocator_context_t*)self->context;
+static inline void frame_allocator_count_allocation(frame_allocator_context_t* ctx, uint64_t count) {
+    __atomic_fetch_add(&ctx->allocated_frame_count, count, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&ctx->free_frame_count, count, __ATOMIC_RELAXED);
+}
 
-    lock_acquire(ctx->lock);
+static inline void frame_allocator_count_release(frame_allocator_context_t* ctx, uint64_t count) {
+    __atomic_fetch_sub(&ctx->allocated_frame_count, count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ctx->free_frame_count, count, __ATOMIC_RELAXED);
+}
 
-    uint64_t rem_frm_cnt = f->frame_count;
-    uint64_t rem_frm_start = f->frame_address;
+static inline boolean_t frame_allocator_try_lock(volatile uint64_t* lock) {
+    uint8_t was_locked = 0;
+    __asm__ __volatile__ ("lock btsq $0, %[lock]\n" : "=@ccc" (was_locked), [lock] "+m" (*lock) : : "memory");
+    return !was_locked;
+}
 
+static inline void frame_allocator_unlock(volatile uint64_t* lock) {
+    asm volatile ("" ::: "memory");
+    *lock = 0;
+}
 
+static inline boolean_t frame_allocator_is_in_buddy(frame_allocator_context_t* ctx, uint64_t frame_address, uint64_t frame_count) {
+    if(frame_address < ctx->buddy_base) {
+        return false;
+    }
 
-    while(rem_frm_cnt) {
+    uint64_t frame_idx = (frame_address - ctx->buddy_base) / FRAME_SIZE;
 
-        frame_t search_frm = {rem_frm_start, 1, 0, 0};
+    return frame_idx < ctx->buddy_frame_count && frame_count <= ctx->buddy_frame_count - frame_idx;
+}
 
-        frame_t* frm = (frame_t*)ctx->reserved_frames_by_address->find(ctx->reserved_frames_by_address, &search_frm);
+static inline boolean_t frame_allocator_buddy_is_free(frame_allocator_context_t* ctx, uint8_t order, uint64_t block) {
+    return (ctx->buddy_bitmaps[order][block / 64] >> (block % 64)) & 1;
+}
 
-        if(frm == NULL) {
-            break;
+static inline void frame_allocator_buddy_mark_free(frame_allocator_context_t* ctx, uint8_t order, uint64_t block) {
+    ctx->buddy_bitmaps[order][block / 64] |= 1ULL << (block % 64);
+
+    if(block / 64 < ctx->buddy_hints[order]) {
+        ctx->buddy_hints[order] = block / 64;
+    }
+}
+
+static inline void frame_allocator_buddy_mark_used(frame_allocator_context_t* ctx, uint8_t order, uint64_t block) {
+    ctx->buddy_bitmaps[order][block / 64] &= ~(1ULL << (block % 64));
+}
+
+static void frame_allocator_tracked_set(frame_allocator_context_t* ctx, uint64_t frame_idx, uint64_t count, boolean_t tracked) {
+    for(uint64_t i = frame_idx; i < frame_idx + count; i++) {
+        if(tracked) {
+            ctx->tracked_bitmap[i / 64] |= 1ULL << (i % 64);
+        } else {
+            ctx->tracked_bitmap[i / 64] &= ~(1ULL << (i % 64));
         }
+    }
+}
 
-        if(frm->frame_address <= rem_frm_start && rem_frm_cnt <= frm->frame_count) {
-            lock_release(ctx->lock);
-            PRINTLOG(FRAMEALLOCATOR, LOG_TRACE, "frame inside reserved area");
+static inline boolean_t frame_allocator_is_tracked(frame_allocator_context_t* ctx, uint64_t frame_idx) {
+    return (ctx->tracked_bitmap[frame_idx / 64] >> (frame_idx % 64)) & 1;
+}
 
-            return 0;
+static void frame_allocator_buddy_free_block(frame_allocator_context_t* ctx, uint64_t frame_idx, uint8_t order) {
+    // buddy span is multiple of max order block, so buddy of a block is always inside span
+    while(order < FRAME_ALLOCATOR_BUDDY_MAX_ORDER) {
+        uint64_t buddy = (frame_idx >> order) ^ 1;
+
+        if(!frame_allocator_buddy_is_free(ctx, order, buddy)) {
+            break;
         }
 
-        uint64_t frm_alloc_cnt = (rem_frm_start - frm->frame_address) / FRAME_SIZE;
-        frm_alloc_cnt = frm->frame_count - frm_alloc_cnt;
+        frame_allocator_buddy_mark_used(ctx, order, buddy);
 
-        rem_frm_start += frm_alloc_cnt * FRAME_SIZE;
-        rem_frm_cnt -= frm_alloc_cnt;
+        frame_idx &= ~((2ULL << order) - 1);
+        order++;
     }
 
+    frame_allocator_buddy_mark_free(ctx, order, frame_idx >> order);
+}
 
-    while(rem_frm_cnt) {
-        PRINTLOG(FRAMEALLOCATOR, LOG_TRACE, "remaining frame start 0x%llx count 0x%llx", rem_frm_start, rem_frm_cnt);
+static void frame_allocator_buddy_free_range(frame_allocator_context_t* ctx, uint64_t frame_idx, uint64_t count) {
+    uint64_t end = frame_idx + count;
 
-        frame_t search_frm = {rem_frm_start, 1, 0, 0};
+    while(frame_idx < end) {
+        uint8_t order = FRAME_ALLOCATOR_BUDDY_MAX_ORDER;
 
-        frame_t* frm = (frame_t*)ctx->free_frames_by_address->find(ctx->free_frames_by_address, &search_frm);
+        while(order && ((frame_idx & ((1ULL << order) - 1)) || frame_idx + (1ULL << order) > end)) {
+            order--;
+        }
 
-        if(frm == NULL) {
-            frame_t* new_r_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+        frame_allocator_buddy_free_block(ctx, frame_idx, order);
 
-            if(new_r_frm == NULL) {
-                PRINTLOG(FRAMEALLOCATOR, LOG_FATAL, "no free memory. Halting...");
-                cpu_hlt();
-            }
+        frame_idx += 1ULL << order;
+    }
+}
 
-            new_r_frm->frame_address = rem_frm_start;
-            new_r_frm->frame_count = rem_frm_cnt;
-            new_r_frm->type = FRAME_TYPE_RESERVED;
-            ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, new_r_frm, new_r_frm, NULL);
+static boolean_t frame_allocator_buddy_find_free_block(frame_allocator_context_t* ctx, uint64_t frame_idx, uint8_t* order) {
+    for(uint8_t o = 0; o < FRAME_ALLOCATOR_BUDDY_ORDER_COUNT; o++) {
+        if(frame_allocator_buddy_is_free(ctx, o, frame_idx >> o)) {
+            *order = o;
 
-            PRINTLOG(FRAMEALLOCATOR, LOG_TRACE, "no used frame found, inserted into reserveds, frame start 0x%llx count 0x%llx", rem_frm_start, rem_frm_cnt);
+            return true;
+        }
+    }
 
+    return false;
+}
+
+static uint64_t frame_allocator_buddy_free_run(frame_allocator_context_t* ctx, uint64_t frame_idx, uint64_t max_count) {
+    uint64_t count = 0;
+    uint8_t order = 0;
+
+    while(count < max_count && frame_idx + count < ctx->buddy_frame_count) {
+        uint64_t idx = frame_idx + count;
+
+        if(!frame_allocator_buddy_find_free_block(ctx, idx, &order)) {
             break;
         }
 
-        PRINTLOG(FRAMEALLOCATOR, LOG_TRACE, "area inside free frames, frame start 0x%llx count 0x%llx", rem_frm_start, rem_frm_cnt);
+        count = (((idx >> order) + 1) << order) - frame_idx;
+    }
 
-        uint64_t frm_alloc_cnt = (rem_frm_start - frm->frame_address) / FRAME_SIZE;
-        frm_alloc_cnt = frm->frame_count - frm_alloc_cnt;
+    return MIN(count, max_count);
+}
 
-        frame_t new_frm = {rem_frm_start, 0, FRAME_TYPE_RESERVED, 0};
+static boolean_t frame_allocator_buddy_first_free(frame_allocator_context_t* ctx, uint8_t order, uint64_t* block) {
+    uint64_t* bitmap = ctx->buddy_bitmaps[order];
 
-        if(frm_alloc_cnt < rem_frm_cnt) {
-            new_frm.frame_count = frm_alloc_cnt;
-            rem_frm_cnt -= frm_alloc_cnt;
-            rem_frm_start += frm_alloc_cnt * FRAME_SIZE;
-        } else {
-            new_frm.frame_count = rem_frm_cnt;
-            rem_frm_cnt = 0;
-        }
+    for(uint64_t w = ctx->buddy_hints[order]; w < ctx->buddy_word_counts[order]; w++) {
+        if(bitmap[w]) {
+            ctx->buddy_hints[order] = w;
+            *block = w * 64 + __builtin_ctzll(bitmap[w]);
 
-        self->allocate_frame(self, &new_frm);
+            return true;
+        }
     }
 
-    lock_release(ctx->lock);
+    ctx->buddy_hints[order] = ctx->buddy_word_counts[order];
 
+    return false;
+}
 
-    return 0;
+static boolean_t frame_allocator_buddy_allocate_block(frame_allocator_context_t* ctx, uint8_t order, uint64_t frame_limit, uint64_t* frame_idx) {
+    for(uint8_t o = order; o < FRAME_ALLOCATOR_BUDDY_ORDER_COUNT; o++) {
+        uint64_t block = 0;
+
+        // first free block is the lowest one, if it is over limit all blocks of order are
+        if(!frame_allocator_buddy_first_free(ctx, o, &block) || (block << o) + (1ULL << order) > frame_limit) {
+            continue;
+        }
+
+        frame_allocator_buddy_mark_used(ctx, o, block);
+
+        while(o > order) {
+            o--;
+            block <<= 1;
+            frame_allocator_buddy_mark_free(ctx, o, block | 1);
+        }
+
+        *frame_idx = block << order;
+
+        return true;
+    }
+
+    return false;
 }
 
+static boolean_t frame_allocator_buddy_allocate_large(frame_allocator_context_t* ctx, uint64_t count, uint64_t frame_limit, uint64_t* frame_idx) {
+    uint64_t block_count = (count + (1ULL << FRAME_ALLOCATOR_BUDDY_MAX_ORDER) - 1) >> FRAME_ALLOCATOR_BUDDY_MAX_ORDER;
+    uint64_t total_block_count = ctx->buddy_frame_count >> FRAME_ALLOCATOR_BUDDY_MAX_ORDER;
+    uint64_t run = 0;
 
-int8_t fa_allocate_frame_by_count(frame_allocator_t* self, uint64_t count, frame_allocation_type_t fa_type, frame_t** fs, uint64_t* alloc_list_size) {
-    frame_allocator_context_t* ctx = (frame_allocator_context_t*)self->context;
+    for(uint64_t b = 0; b < total_block_count; b++) {
+        if(!frame_allocator_buddy_is_free(ctx, FRAME_ALLOCATOR_BUDDY_MAX_ORDER, b)) {
+            run = 0;
 
+            continue;
+        }
 
-    lock_acquire(ctx->lock);
+        run++;
 
-    if(fa_type & FRAME_ALLOCATION_TYPE_RELAX) {
+        if(run < block_count) {
+            continue;
+        }
 
-    } else if(fa_type & FRAME_ALLOCATION_TYPE_BLOCK) {
-        iterator_t* iter = list_iterator_create(ctx->free_frames_sorted_by_size);
+        uint64_t first = b + 1 - block_count;
 
-        if(iter == NULL) {
-            lock_release(ctx->lock);
-            PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "cannot list free frames");
+        if((first << FRAME_ALLOCATOR_BUDDY_MAX_ORDER) + count > frame_limit) {
+            return false;
+        }
 
-            return -1;
+        for(uint64_t i = first; i <= b; i++) {
+            frame_allocator_buddy_mark_used(ctx, FRAME_ALLOCATOR_BUDDY_MAX_ORDER, i);
         }
 
-        frame_t* tmp_frm = NULL;
+        *frame_idx = first << FRAME_ALLOCATOR_BUDDY_MAX_ORDER;
+
+        uint64_t allocated = block_count << FRAME_ALLOCATOR_BUDDY_MAX_ORDER;
+
+        if(allocated > count) {
+            frame_allocator_buddy_free_range(ctx, *frame_idx + count, allocated - count);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+static boolean_t frame_allocator_buddy_allocate(frame_allocator_context_t* ctx, uint64_t count, uint64_t frame_limit, uint64_t* frame_idx) {
+    if(count > (1ULL << FRAME_ALLOCATOR_BUDDY_MAX_ORDER)) {
+        return frame_allocator_buddy_allocate_large(ctx, count, frame_limit, frame_idx);
+    }
+
+    uint8_t order = 0;
 
-        while(iter->end_of_iterator(iter) != 0) {
-            frame_t* item = (frame_t*)iter->get_item(iter);
+    while((1ULL << order) < count) {
+        order++;
+    }
 
-            if(item->frame_count >= count) {
-                if(fa_type & FRAME_ALLOCATION_TYPE_UNDER_4G) {
-                    if(item->frame_address + count * FRAME_SIZE >= 0x100000000) {
-                        iter->next(iter);
+    if(!frame_allocator_buddy_allocate_block(ctx, order, frame_limit, frame_idx)) {
+        return false;
+    }
+
+    // tail of power of two block returns back, blocks of order 9 and above are 2m aligned
+    if((1ULL << order) > count) {
+        frame_allocator_buddy_free_range(ctx, *frame_idx + count, (1ULL << order) - count);
+    }
+
+    return true;
+}
 
-                        continue;
-                    }
-                }
+static int8_t frame_allocator_buddy_allocate_range(frame_allocator_context_t* ctx, uint64_t frame_idx, uint64_t count) {
+    if(frame_allocator_buddy_free_run(ctx, frame_idx, count) != count) {
+        return -1;
+    }
+
+    uint64_t end = frame_idx + count;
+    uint64_t idx = frame_idx;
+    uint8_t order = 0;
+
+    while(idx < end) {
+        frame_allocator_buddy_find_free_block(ctx, idx, &order);
+
+        uint64_t block_start = (idx >> order) << order;
+        uint64_t block_end = block_start + (1ULL << order);
+
+        frame_allocator_buddy_mark_used(ctx, order, idx >> order);
+
+        if(block_start < frame_idx) {
+            frame_allocator_buddy_free_range(ctx, block_start, frame_idx - block_start);
+        }
+
+        if(block_end > end) {
+            frame_allocator_buddy_free_range(ctx, end, block_end - end);
+        }
 
-                if(count % 0x200 == 0) {
-                    if(item->frame_address % MEMORY_PAGING_PAGE_LENGTH_2M == 0) { // fast hit
-                        iter->delete_item(iter);
-                        ctx->free_frames_by_address->delete(ctx->free_frames_by_address, item, NULL);
-                        tmp_frm = item;
+        idx = block_end;
+    }
 
-                        break;
-                    } else {
-                        // we need check fit with alignment
-                        uint64_t begin_rem = item->frame_address % MEMORY_PAGING_PAGE_LENGTH_2M;
-                        uint64_t begin_rem_f_cnt = begin_rem / FRAME_SIZE;
+    return 0;
+}
 
-                        if(item->frame_count >= count + begin_rem_f_cnt) {
-                            iter->delete_item(iter);
-                            ctx->free_frames_by_address->delete(ctx->free_frames_by_address, item, NULL);
+static boolean_t frame_allocator_buddy_has_free_frame(frame_allocator_context_t* ctx, uint64_t frame_idx, uint64_t count) {
+    uint8_t order = 0;
 
-                            // we found, but we need to re-insert begining to free frames
-                            frame_t* new_begin_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+    for(uint64_t i = frame_idx; i < frame_idx + count; i++) {
+        if(frame_allocator_buddy_find_free_block(ctx, i, &order)) {
+            return true;
+        }
+    }
 
-                            if(new_begin_frm == NULL) {
-                                PRINTLOG(FRAMEALLOCATOR, LOG_FATAL, "no free memory. Halting...");
-                                cpu_hlt();
-                            }
+    return false;
+}
 
-                            new_begin_frm->frame_address = item->frame_address;
-                            new_begin_frm->frame_count = begin_rem_f_cnt;
+static frame_allocator_cpu_cache_t* frame_allocator_get_cpu_cache(frame_allocator_context_t* ctx) {
+    if(ctx->cpu_caches == NULL || ctx->cpu_id_getter == NULL) {
+        return NULL;
+    }
 
-                            list_sortedlist_insert(ctx->free_frames_sorted_by_size, new_begin_frm);
-                            ctx->free_frames_by_address->insert(ctx->free_frames_by_address, new_begin_frm, new_begin_frm, NULL);
+    uint32_t cpu_id = ctx->cpu_id_getter();
 
-                            item->frame_address += begin_rem_f_cnt * FRAME_SIZE;
-                            item->frame_count -= begin_rem_f_cnt;
+    if(cpu_id >= FRAME_ALLOCATOR_MAX_CPU_COUNT) {
+        return NULL;
+    }
 
-                            tmp_frm = item;
+    return &ctx->cpu_caches[cpu_id];
+}
 
-                            break;
-                        }
+static boolean_t frame_allocator_cpu_cache_pop(frame_allocator_context_t* ctx, uint64_t* frame_address) {
+    frame_allocator_cpu_cache_t* cache = frame_allocator_get_cpu_cache(ctx);
 
+    // if another task of this cpu is interrupted inside cache or cache is draining, caller uses buddy
+    if(cache == NULL || !frame_allocator_try_lock(&cache->busy)) {
+        return false;
+    }
 
-                    }
+    if(!cache->count) {
+        lock_acquire(ctx->lock);
 
-                } else {
-                    iter->delete_item(iter);
-                    ctx->free_frames_by_address->delete(ctx->free_frames_by_address, item, NULL);
-                    tmp_frm = item;
+        while(cache->count < FRAME_ALLOCATOR_CPU_CACHE_BATCH_SIZE) {
+            uint64_t frame_idx = 0;
 
-                    break;
-                }
+            if(!frame_allocator_buddy_allocate_block(ctx, 0, ctx->buddy_frame_count, &frame_idx)) {
+                break;
             }
 
-            iter = iter->next(iter);
+            cache->frames[cache->count++] = ctx->buddy_base + frame_idx * FRAME_SIZE;
         }
 
-        iter->destroy(iter);
+        lock_release(ctx->lock);
+    }
 
-        if(tmp_frm == NULL) {
-            lock_release(ctx->lock);
-            PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "cannot find free frames with count 0x%llx", count);
+    boolean_t res = false;
 
-            return -1;
+    if(cache->count) {
+        *frame_address = cache->frames[--cache->count];
+        res = true;
+    }
+
+    frame_allocator_unlock(&cache->busy);
+
+    return res;
+}
+
+static boolean_t frame_allocator_cpu_cache_push(frame_allocator_context_t* ctx, uint64_t frame_address) {
+    frame_allocator_cpu_cache_t* cache = frame_allocator_get_cpu_cache(ctx);
+
+    if(cache == NULL || !frame_allocator_try_lock(&cache->busy)) {
+        return false;
+    }
+
+    if(cache->count == FRAME_ALLOCATOR_CPU_CACHE_SIZE) {
+        lock_acquire(ctx->lock);
+
+        while(cache->count > FRAME_ALLOCATOR_CPU_CACHE_SIZE - FRAME_ALLOCATOR_CPU_CACHE_BATCH_SIZE) {
+            uint64_t cached_frame_address = cache->frames[--cache->count];
+
+            frame_allocator_buddy_free_block(ctx, (cached_frame_address - ctx->buddy_base) / FRAME_SIZE, 0);
         }
 
-        if(alloc_list_size) {
-            *alloc_list_size = 1;
+        lock_release(ctx->lock);
+    }
+
+    cache->frames[cache->count++] = frame_address;
+
+    frame_allocator_unlock(&cache->busy);
+
+    return true;
+}
+
+static void frame_allocator_cpu_cache_drain_all(frame_allocator_context_t* ctx) {
+    if(ctx->cpu_caches == NULL) {
+        return;
+    }
+
+    for(uint64_t i = 0; i < FRAME_ALLOCATOR_MAX_CPU_COUNT; i++) {
+        frame_allocator_cpu_cache_t* cache = &ctx->cpu_caches[i];
+
+        // owner may wait the frame allocator lock, so busy caches are skipped
+        if(!cache->count || !frame_allocator_try_lock(&cache->busy)) {
+            continue;
         }
 
-        frame_t* new_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+        while(cache->count) {
+            uint64_t cached_frame_address = cache->frames[--cache->count];
 
-        if(new_frm == NULL) {
-            PRINTLOG(FRAMEALLOCATOR, LOG_FATAL, "no free memory. Halting...");
-            cpu_hlt();
+            frame_allocator_buddy_free_block(ctx, (cached_frame_address - ctx->buddy_base) / FRAME_SIZE, 0);
         }
 
-        uint64_t rem_frms = tmp_frm->frame_count - count;
+        frame_allocator_unlock(&cache->busy);
+    }
+}
+
+static void frame_allocator_clean_frames(uint64_t frame_address, uint64_t frame_count) {
+    uint64_t i = 0;
 
-        new_frm->frame_address = tmp_frm->frame_address;
-        new_frm->frame_count = count;
-        new_frm->frame_attributes = tmp_frm->frame_attributes;
+    while(i < frame_count) {
+        uint64_t fa = frame_address + i * FRAME_SIZE;
+        uint64_t va = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(fa);
+        uint64_t pa = 0;
 
-        ctx->allocated_frame_count += count;
-        ctx->free_frame_count -= count;
+        if(memory_paging_get_physical_address_ext(NULL, va, &pa) == 0 && pa == fa) {
+            memory_memclean((void*)va, FRAME_SIZE);
+            i++;
 
-        if(fa_type & FRAME_ALLOCATION_TYPE_OLD_RESERVED) {
-            new_frm->frame_attributes |= FRAME_ATTRIBUTE_OLD_RESERVED;
+            continue;
         }
 
-        *fs = new_frm;
+        // unmapped frames are mapped temporarily as one run, so unmapping needs only one tlb shootdown
+        uint64_t run = 1;
 
-        if(fa_type & FRAME_ALLOCATION_TYPE_RESERVED) {
-            new_frm->type = FRAME_TYPE_RESERVED;
-            ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, new_frm, new_frm, NULL);
+        while(i + run < frame_count &&
+              memory_paging_get_physical_address_ext(NULL, va + run * FRAME_SIZE, &pa) != 0) {
+            run++;
+        }
+
+        frame_t run_frm = {fa, run, FRAME_TYPE_USED, 0};
+
+        if(memory_paging_add_va_for_frame(va, &run_frm, MEMORY_PAGING_PAGE_TYPE_NOEXEC) == 0) {
+            memory_memclean((void*)va, run * FRAME_SIZE);
         } else {
-            new_frm->type = FRAME_TYPE_USED;
-            ctx->allocated_frames_by_address->insert(ctx->allocated_frames_by_address, new_frm, new_frm, NULL);
+            PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "cannot map frames 0x%llx 0x%llx for cleaning", fa, run);
         }
 
+        memory_paging_delete_va_for_frame(va, &run_frm);
 
-        if(rem_frms) {
-            frame_t* free_rem_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+        i += run;
+    }
+}
 
-            if(free_rem_frm == NULL) {
-                PRINTLOG(FRAMEALLOCATOR, LOG_FATAL, "no free memory. Halting...");
-                cpu_hlt();
-            }
+static void frame_allocator_release_to_buddy(frame_allocator_context_t* ctx, uint64_t frame_address, uint64_t frame_count) {
+    if(!frame_allocator_is_in_buddy(ctx, frame_address, frame_count)) {
+        return;
+    }
 
-            free_rem_frm->frame_address = tmp_frm->frame_address + count * FRAME_SIZE;
-            free_rem_frm->frame_count = rem_frms;
-            free_rem_frm->type = FRAME_TYPE_FREE;
-            free_rem_frm->frame_attributes = tmp_frm->frame_attributes;
+    frame_allocator_clean_frames(frame_address, frame_count);
 
-            ctx->free_frames_by_address->insert(ctx->free_frames_by_address, free_rem_frm, free_rem_frm, NULL);
-            list_sortedlist_insert(ctx->free_frames_sorted_by_size, free_rem_frm);
-        }
+    uint64_t frame_idx = (frame_address - ctx->buddy_base) / FRAME_SIZE;
 
-        memory_free_ext(ctx->heap, tmp_frm);
+    lock_acquire(ctx->lock);
 
-        lock_release(ctx->lock);
+    frame_allocator_tracked_set(ctx, frame_idx, frame_count, false);
+    frame_allocator_buddy_free_range(ctx, frame_idx, frame_count);
 
-        return 0;
-    } else {
-        lock_release(ctx->lock);
-        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "unknown alloctation type for frames 0x%x", fa_type);
+    lock_release(ctx->lock);
+
+    frame_allocator_count_release(ctx, frame_count);
+}
 
+static int8_t frame_allocator_allocate_reserved_range(frame_allocator_context_t* ctx, uint64_t frame_address, uint64_t frame_count, uint64_t frame_attributes) {
+    frame_t* new_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+
+    if(new_frm == NULL) {
         return -1;
     }
 
-    lock_release(ctx->lock);
+    uint64_t frame_idx = (frame_address - ctx->buddy_base) / FRAME_SIZE;
 
-    PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "Should never hit");
+    if(frame_allocator_buddy_allocate_range(ctx, frame_idx, frame_count) != 0) {
+        memory_free_ext(ctx->heap, new_frm);
 
-    return -1;
-}
-
-int8_t fa_allocate_frame(frame_allocator_t* self, frame_t* f) {
-    if(self == NULL) {
         return -1;
     }
 
-    frame_allocator_context_t* ctx = self->context;
+    new_frm->frame_address = frame_address;
+    new_frm->frame_count = frame_count;
+    new_frm->type = FRAME_TYPE_RESERVED;
+    new_frm->frame_attributes = frame_attributes;
+
+    frame_allocator_tracked_set(ctx, frame_idx, frame_count, true);
+    ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, new_frm, new_frm, NULL);
+
+    frame_allocator_count_allocation(ctx, frame_count);
+
+    return 0;
+}
+
+int8_t fa_reserve_system_frames(frame_allocator_t* self, frame_t* f){
+    frame_allocator_context_t* ctx = (frame_allocator_context_t*)self->context;
 
     lock_acquire(ctx->lock);
 
-    frame_t* frm = (frame_t*)ctx->free_frames_by_address->find(ctx->free_frames_by_address, f);
+    uint64_t rem_frm_cnt = f->frame_count;
+    uint64_t rem_frm_start = f->frame_address;
 
-    if(frm == NULL) {
-        lock_release(ctx->lock);
-        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "frame not found 0x%llx 0x%llx", f->frame_address, f->frame_count);
 
-        return -1;
-    }
 
-    uint64_t rem_frms = frm->frame_count;
+    while(rem_frm_cnt) {
 
-    list_sortedlist_delete(ctx->free_frames_sorted_by_size, frm);
-    ctx->free_frames_by_address->delete(ctx->free_frames_by_address, frm, NULL);
+        frame_t search_frm = {rem_frm_start, 1, 0, 0};
 
-    if(frm->frame_address < f->frame_address) {
-        frame_t* new_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+        frame_t* frm = (frame_t*)ctx->reserved_frames_by_address->find(ctx->reserved_frames_by_address, &search_frm);
 
-        if(new_frm == NULL) {
-            lock_release(ctx->lock);
-            return -1;
+        if(frm == NULL) {
+            break;
         }
 
-        new_frm->frame_address = frm->frame_address;
-        new_frm->frame_count = (f->frame_address - frm->frame_address) / FRAME_SIZE;
-        new_frm->type = FRAME_TYPE_FREE;
-        new_frm->frame_attributes = frm->frame_attributes;
+        if(frm->frame_address <= rem_frm_start && rem_frm_cnt <= frm->frame_count) {
+            lock_release(ctx->lock);
+            PRINTLOG(FRAMEALLOCATOR, LOG_TRACE, "frame inside reserved area");
+
+            return 0;
+        }
 
-        list_sortedlist_insert(ctx->free_frames_sorted_by_size, new_frm);
-        ctx->free_frames_by_address->insert(ctx->free_frames_by_address, new_frm, new_frm, NULL);
+        uint64_t frm_alloc_cnt = (rem_frm_start - frm->frame_address) / FRAME_SIZE;
+        frm_alloc_cnt = frm->frame_count - frm_alloc_cnt;
 
-        rem_frms -= new_frm->frame_count;
+        rem_frm_start += frm_alloc_cnt * FRAME_SIZE;
+        rem_frm_cnt -= frm_alloc_cnt;
     }
 
-    rem_frms -= f->frame_count;
 
-    if(rem_frms) {
-        frame_t* new_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+    while(rem_frm_cnt) {
+        PRINTLOG(FRAMEALLOCATOR, LOG_TRACE, "remaining frame start 0x%llx count 0x%llx", rem_frm_start, rem_frm_cnt);
 
-        if(new_frm == NULL) {
-            lock_release(ctx->lock);
-            return -1;
+        uint64_t free_cnt = 0;
+
+        if(frame_allocator_is_in_buddy(ctx, rem_frm_start, 1)) {
+            free_cnt = frame_allocator_buddy_free_run(ctx, (rem_frm_start - ctx->buddy_base) / FRAME_SIZE, rem_frm_cnt);
+        }
+
+        if(free_cnt == 0) {
+            frame_t search_frm = {rem_frm_start, 1, 0, 0};
+
+            frame_t* frm = (frame_t*)ctx->reserved_frames_by_address->find(ctx->reserved_frames_by_address, &search_frm);
+
+            if(frm) {
+                uint64_t frm_skip_cnt = (frm->frame_address + frm->frame_count * FRAME_SIZE - rem_frm_start) / FRAME_SIZE;
+                frm_skip_cnt = MIN(frm_skip_cnt, rem_frm_cnt);
+
+                rem_frm_start += frm_skip_cnt * FRAME_SIZE;
+                rem_frm_cnt -= frm_skip_cnt;
+
+                continue;
+            }
+
+            frame_t* new_r_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+
+            if(new_r_frm == NULL) {
+                PRINTLOG(FRAMEALLOCATOR, LOG_FATAL, "no free memory. Halting...");
+                cpu_hlt();
+            }
+
+            new_r_frm->frame_address = rem_frm_start;
+            new_r_frm->frame_count = rem_frm_cnt;
+            new_r_frm->type = FRAME_TYPE_RESERVED;
+            ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, new_r_frm, new_r_frm, NULL);
+
+            PRINTLOG(FRAMEALLOCATOR, LOG_TRACE, "no used frame found, inserted into reserveds, frame start 0x%llx count 0x%llx", rem_frm_start, rem_frm_cnt);
+
+            break;
+        }
+
+        PRINTLOG(FRAMEALLOCATOR, LOG_TRACE, "area inside free frames, frame start 0x%llx count 0x%llx", rem_frm_start, free_cnt);
+
+        if(frame_allocator_allocate_reserved_range(ctx, rem_frm_start, free_cnt, 0) != 0) {
+            PRINTLOG(FRAMEALLOCATOR, LOG_FATAL, "no free memory. Halting...");
+            cpu_hlt();
         }
 
-        new_frm->frame_address = f->frame_address + f->frame_count * FRAME_SIZE;
-        new_frm->frame_count = rem_frms;
-        new_frm->type = FRAME_TYPE_FREE;
-        new_frm->frame_attributes = frm->frame_attributes;
+        rem_frm_start += free_cnt * FRAME_SIZE;
+        rem_frm_cnt -= free_cnt;
+    }
+
+    lock_release(ctx->lock);
+
+
+    return 0;
+}
+
+
+int8_t fa_allocate_frame_by_count(frame_allocator_t* self, uint64_t count, frame_allocation_type_t fa_type, frame_t** fs, uint64_t* alloc_list_size) {
+    frame_allocator_context_t* ctx = (frame_allocator_context_t*)self->context;
+
+    if(!(fa_type & FRAME_ALLOCATION_TYPE_BLOCK) || (fa_type & FRAME_ALLOCATION_TYPE_RELAX)) {
+        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "unknown alloctation type for frames 0x%x", fa_type);
 
-        list_sortedlist_insert(ctx->free_frames_sorted_by_size, new_frm);
-        ctx->free_frames_by_address->insert(ctx->free_frames_by_address, new_frm, new_frm, NULL);
+        return -1;
     }
 
+    if(count == 0) {
+        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "cannot allocate zero frames");
+
+        return -1;
+    }
 
     frame_t* new_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
 
     if(new_frm == NULL) {
-        lock_release(ctx->lock);
+        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "cannot allocate frame descriptor");
+
         return -1;
     }
 
-    new_frm->frame_address = f->frame_address;
-    new_frm->frame_count = f->frame_count;
-    new_frm->type = f->type != FRAME_TYPE_FREE?f->type:FRAME_TYPE_USED;
-    new_frm->frame_attributes = f->frame_attributes?f->frame_attributes:frm->frame_attributes;
-
-    ctx->allocated_frame_count += new_frm->frame_count;
-    ctx->free_frame_count -= new_frm->frame_count;
+    new_frm->frame_count = count;
+    new_frm->type = (fa_type & FRAME_ALLOCATION_TYPE_RESERVED)?FRAME_TYPE_RESERVED:FRAME_TYPE_USED;
 
-    if(new_frm->type == FRAME_TYPE_USED) {
-        ctx->allocated_frames_by_address->insert(ctx->allocated_frames_by_address, new_frm, new_frm, NULL);
-    } else {
-        ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, new_frm, new_frm, NULL);
+    if(fa_type & FRAME_ALLOCATION_TYPE_OLD_RESERVED) {
+        new_frm->frame_attributes |= FRAME_ATTRIBUTE_OLD_RESERVED;
     }
 
-    memory_free_ext(ctx->heap, frm);
+    boolean_t tracked = (fa_type & (FRAME_ALLOCATION_TYPE_RESERVED | FRAME_ALLOCATION_TYPE_OLD_RESERVED)) != 0;
 
-    lock_release(ctx->lock);
+    // single untracked frames are served from cpu cache without frame allocator lock
+    if(count == 1 && !tracked && !(fa_type & FRAME_ALLOCATION_TYPE_UNDER_4G) &&
+       frame_allocator_cpu_cache_pop(ctx, &new_frm->frame_address)) {
+        frame_allocator_count_allocation(ctx, count);
 
-    return 0;
-}
+        if(alloc_list_size) {
+            *alloc_list_size = 1;
+        }
 
-int8_t fa_release_frame(frame_allocator_t* self, frame_t* f) {
-    if(self == NULL) {
-        return -1;
+        *fs = new_frm;
+
+        return 0;
     }
 
-    frame_allocator_context_t* ctx = self->context;
+    uint64_t frame_limit = ctx->buddy_frame_count;
+
+    if(fa_type & FRAME_ALLOCATION_TYPE_UNDER_4G) {
+        if(ctx->buddy_base >= 0x100000000ULL) {
+            frame_limit = 0;
+        } else {
+            frame_limit = MIN(frame_limit, (0x100000000ULL - ctx->buddy_base) / FRAME_SIZE);
+        }
+    }
 
     lock_acquire(ctx->lock);
 
-    const frame_t* tmp_frame = ctx->allocated_frames_by_address->find(ctx->allocated_frames_by_address, f);
+    uint64_t frame_idx = 0;
 
-    if(tmp_frame) {
+    boolean_t allocated = frame_allocator_buddy_allocate(ctx, count, frame_limit, &frame_idx);
 
-        ctx->allocated_frames_by_address->delete(ctx->allocated_frames_by_address, tmp_frame, NULL);
+    if(!allocated && ctx->cpu_caches) {
+        // cached single frames may block merging of buddies
+        frame_allocator_cpu_cache_drain_all(ctx);
+        allocated = frame_allocator_buddy_allocate(ctx, count, frame_limit, &frame_idx);
+    }
 
-        uint64_t rem_frms = tmp_frame->frame_count - f->frame_count;
+    if(!allocated) {
+        lock_release(ctx->lock);
+        memory_free_ext(ctx->heap, new_frm);
 
-        if(tmp_frame->frame_address < f->frame_address) {
-            uint64_t prev_frm_count = (f->frame_address - tmp_frame->frame_address) / FRAME_SIZE;
+        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "cannot find free frames with count 0x%llx", count);
 
-            frame_t* prev_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+        return -1;
+    }
 
-            if(prev_frm == NULL) {
-                lock_release(ctx->lock);
-                return -1;
-            }
-            prev_frm->frame_address = tmp_frame->frame_address;
-            prev_frm->frame_count = prev_frm_count;
-            prev_frm->type = FRAME_TYPE_USED;
-            prev_frm->frame_attributes = tmp_frame->frame_attributes;
+    new_frm->frame_address = ctx->buddy_base + frame_idx * FRAME_SIZE;
 
-            ctx->allocated_frames_by_address->insert(ctx->allocated_frames_by_address, prev_frm, prev_frm, NULL);
+    if(tracked) {
+        frame_allocator_tracked_set(ctx, frame_idx, count, true);
 
-            rem_frms -= prev_frm_count;
+        if(new_frm->type == FRAME_TYPE_RESERVED) {
+            ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, new_frm, new_frm, NULL);
+        } else {
+            ctx->allocated_frames_by_address->insert(ctx->allocated_frames_by_address, new_frm, new_frm, NULL);
         }
+    }
 
-        if(rem_frms) {
-            frame_t* next_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+    lock_release(ctx->lock);
 
-            if(next_frm == NULL) {
-                lock_release(ctx->lock);
-                return -1;
-            }
-            next_frm->frame_address = f->frame_address + f->frame_count * FRAME_SIZE;
-            next_frm->frame_count = rem_frms;
-            next_frm->type = FRAME_TYPE_USED;
-            next_frm->frame_attributes = tmp_frame->frame_attributes;
+    frame_allocator_count_allocation(ctx, count);
+
+    if(alloc_list_size) {
+        *alloc_list_size = 1;
+    }
+
+    *fs = new_frm;
+
+    return 0;
+}
+
+int8_t fa_allocate_frame(frame_allocator_t* self, frame_t* f) {
+    if(self == NULL || f == NULL) {
+        return -1;
+    }
+
+    frame_allocator_context_t* ctx = self->context;
+
+    if(!frame_allocator_is_in_buddy(ctx, f->frame_address, f->frame_count)) {
+        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "frame not found 0x%llx 0x%llx", f->frame_address, f->frame_count);
+
+        return -1;
+    }
 
-            ctx->allocated_frames_by_address->insert(ctx->allocated_frames_by_address, next_frm, next_frm, NULL);
-        }
+    frame_type_t type = f->type != FRAME_TYPE_FREE?f->type:FRAME_TYPE_USED;
+    frame_t* new_frm = NULL;
 
-        frame_t* new_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+    if(type != FRAME_TYPE_USED) {
+        new_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
 
         if(new_frm == NULL) {
-            lock_release(ctx->lock);
             return -1;
         }
 
         new_frm->frame_address = f->frame_address;
         new_frm->frame_count = f->frame_count;
-        new_frm->type = FRAME_TYPE_FREE;
-        new_frm->frame_attributes = tmp_frame->frame_attributes;
+        new_frm->type = type;
+        new_frm->frame_attributes = f->frame_attributes;
+    }
 
-        ctx->allocated_frame_count -= new_frm->frame_count;
-        ctx->free_frame_count += new_frm->frame_count;
+    uint64_t frame_idx = (f->frame_address - ctx->buddy_base) / FRAME_SIZE;
 
-        for(uint64_t i = 0; i < f->frame_count; i++) {
-            memory_paging_add_page(0x1000, f->frame_address + i * FRAME_SIZE, MEMORY_PAGING_PAGE_TYPE_4K);
-            memory_memclean((void*)(0x1000), FRAME_SIZE);
-            memory_paging_delete_page(0x1000, NULL);
-        }
+    lock_acquire(ctx->lock);
 
-        ctx->free_frames_by_address->insert(ctx->free_frames_by_address, new_frm, new_frm, NULL);
-        list_sortedlist_insert(ctx->free_frames_sorted_by_size, new_frm);
+    int8_t res = frame_allocator_buddy_allocate_range(ctx, frame_idx, f->frame_count);
 
-        memory_free_ext(ctx->heap, (void*)tmp_frame);
+    if(res != 0 && ctx->cpu_caches) {
+        // requested frames may wait at cpu caches
+        frame_allocator_cpu_cache_drain_all(ctx);
+        res = frame_allocator_buddy_allocate_range(ctx, frame_idx, f->frame_count);
+    }
 
+    if(res != 0) {
         lock_release(ctx->lock);
+        memory_free_ext(ctx->heap, new_frm);
 
-        return 0;
+        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "frame not found 0x%llx 0x%llx", f->frame_address, f->frame_count);
+
+        return -1;
     }
 
-    tmp_frame = ctx->reserved_frames_by_address->find(ctx->reserved_frames_by_address, f);
+    if(new_frm) {
+        frame_allocator_tracked_set(ctx, frame_idx, f->frame_count, true);
+        ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, new_frm, new_frm, NULL);
+    }
 
-    if(tmp_frame) {
-        ctx->reserved_frames_by_address->delete(ctx->reserved_frames_by_address, tmp_frame, NULL);
+    lock_release(ctx->lock);
 
-        uint64_t rem_frms = tmp_frame->frame_count - f->frame_count;
+    frame_allocator_count_allocation(ctx, f->frame_count);
 
-        if(tmp_frame->frame_address < f->frame_address) {
-            uint64_t prev_frm_count = (f->frame_address - tmp_frame->frame_address) / FRAME_SIZE;
+    return 0;
+}
 
-            frame_t* prev_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+static int8_t frame_allocator_untrack_frames(frame_allocator_context_t* ctx, index_t* frames_by_address, const frame_t* tmp_frame, frame_t* f) {
+    frames_by_address->delete(frames_by_address, tmp_frame, NULL);
 
-            if(prev_frm == NULL) {
-                lock_release(ctx->lock);
-                return -1;
-            }
+    uint64_t rem_frms = tmp_frame->frame_count - f->frame_count;
 
-            prev_frm->frame_address = tmp_frame->frame_address;
-            prev_frm->frame_count = prev_frm_count;
-            prev_frm->type = FRAME_TYPE_USED;
-            prev_frm->frame_attributes = tmp_frame->frame_attributes;
+    if(tmp_frame->frame_address < f->frame_address) {
+        uint64_t prev_frm_count = (f->frame_address - tmp_frame->frame_address) / FRAME_SIZE;
 
-            ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, prev_frm, prev_frm, NULL);
+        frame_t* prev_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
 
-            rem_frms -= prev_frm_count;
+        if(prev_frm == NULL) {
+            return -1;
         }
 
-        if(rem_frms) {
-            frame_t* next_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+        prev_frm->frame_address = tmp_frame->frame_address;
+        prev_frm->frame_count = prev_frm_count;
+        prev_frm->type = tmp_frame->type;
+        prev_frm->frame_attributes = tmp_frame->frame_attributes;
 
-            if(next_frm == NULL) {
-                lock_release(ctx->lock);
-                return -1;
-            }
-
-            next_frm->frame_address = f->frame_address + f->frame_count * FRAME_SIZE;
-            next_frm->frame_count = rem_frms;
-            next_frm->type = FRAME_TYPE_USED;
-            next_frm->frame_attributes = tmp_frame->frame_attributes;
+        frames_by_address->insert(frames_by_address, prev_frm, prev_frm, NULL);
 
-            ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, next_frm, next_frm, NULL);
-        }
+        rem_frms -= prev_frm_count;
+    }
 
-        frame_t* new_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
+    if(rem_frms) {
+        frame_t* next_frm = memory_malloc_ext(ctx->heap, sizeof(frame_t), 0);
 
-        if(new_frm == NULL) {
-            lock_release(ctx->lock);
+        if(next_frm == NULL) {
             return -1;
         }
 
-        new_frm->frame_address = f->frame_address;
-        new_frm->frame_count = f->frame_count;
-        new_frm->type = FRAME_TYPE_FREE;
-        new_frm->frame_attributes = tmp_frame->frame_attributes;
-
-        ctx->allocated_frame_count -= new_frm->frame_count;
-        ctx->free_frame_count += new_frm->frame_count;
-
-        for(uint64_t i = 0; i < f->frame_count; i++) {
-            memory_paging_add_page(0x1000, f->frame_address + i * FRAME_SIZE, MEMORY_PAGING_PAGE_TYPE_4K);
-            memory_memclean((void*)(0x1000), FRAME_SIZE);
-            memory_paging_delete_page(0x1000, NULL);
-        }
-
-        ctx->free_frames_by_address->insert(ctx->free_frames_by_address, new_frm, new_frm, NULL);
-        list_sortedlist_insert(ctx->free_frames_sorted_by_size, new_frm);
+        next_frm->frame_address = f->frame_address + f->frame_count * FRAME_SIZE;
+        next_frm->frame_count = rem_frms;
+        next_frm->type = tmp_frame->type;
+        next_frm->frame_attributes = tmp_frame->frame_attributes;
 
-        memory_free_ext(ctx->heap, (void*)tmp_frame);
+        frames_by_address->insert(frames_by_address, next_frm, next_frm, NULL);
     }
 
-    lock_release(ctx->lock);
-
+    memory_free_ext(ctx->heap, (void*)tmp_frame);
 
     return 0;
 }
 
-int8_t fa_release_acpi_reclaim_memory(frame_allocator_t* self) {
-    if(self == NULL) {
+int8_t fa_release_frame(frame_allocator_t* self, frame_t* f) {
+    if(self == NULL || f == NULL) {
         return -1;
     }
 
     frame_allocator_context_t* ctx = self->context;
 
-    lock_acquire(ctx->lock);
-
-    iterator_t* iter;
-    list_t* frms;
-
+    if(f->frame_count == 0) {
+        return 0;
+    }
 
-    frms = list_create_sortedlist_with_heap(ctx->heap, frame_allocator_cmp_by_size);
+    // f may be the reserved frame itself which is freed while untracking
+    uint64_t frame_address = f->frame_address;
+    uint64_t frame_count = f->frame_count;
+    boolean_t in_buddy = frame_allocator_is_in_buddy(ctx, frame_address, frame_count);
+    uint64_t frame_idx = in_buddy?(frame_address - ctx->buddy_base) / FRAME_SIZE:0;
 
-    iter = ctx->reserved_frames_by_address->create_iterator(ctx->reserved_frames_by_address);
+    if(in_buddy && frame_count == 1 && ctx->cpu_caches && !frame_allocator_is_tracked(ctx, frame_idx)) {
+        frame_allocator_clean_frames(frame_address, 1);
 
-    while(iter->end_of_iterator(iter) != 0) {
-        frame_t* f = (frame_t*)iter->get_item(iter);
+        if(frame_allocator_cpu_cache_push(ctx, frame_address)) {
+            frame_allocator_count_release(ctx, 1);
 
-        if((f->frame_attributes & FRAME_ATTRIBUTE_ACPI_RECLAIM_MEMORY) && !(f->frame_attributes & FRAME_ATTRIBUTE_RESERVED_PAGE_MAPPED)) {
-            list_sortedlist_insert(frms, f);
+            return 0;
         }
-
-        iter = iter->next(iter);
     }
 
-    iter->destroy(iter);
+    lock_acquire(ctx->lock);
 
-    iter = list_iterator_create(frms);
+    index_t* frames_by_address = ctx->reserved_frames_by_address;
+    const frame_t* tmp_frame = frames_by_address->find(frames_by_address, f);
 
-    while(iter->end_of_iterator(iter) != 0) {
-        frame_t* f = (frame_t*)iter->get_item(iter);
+    if(tmp_frame == NULL) {
+        frames_by_address = ctx->allocated_frames_by_address;
+        tmp_frame = frames_by_address->find(frames_by_address, f);
+    }
 
-        ctx->reserved_frames_by_address->delete(ctx->reserved_frames_by_address, f, NULL);
+    if(tmp_frame) {
+        if(frame_allocator_untrack_frames(ctx, frames_by_address, tmp_frame, f) != 0) {
+            lock_release(ctx->lock);
 
-        for(uint64_t i = 0; i < f->frame_count; i++) {
-            memory_paging_add_page(0x1000, f->frame_address + i * FRAME_SIZE, MEMORY_PAGING_PAGE_TYPE_4K);
-            memory_memclean((void*)(0x1000), FRAME_SIZE);
-            memory_paging_delete_page(0x1000, NULL);
+            return -1;
         }
+    } else if(!in_buddy || frame_allocator_buddy_has_free_frame(ctx, frame_idx, frame_count)) {
+        lock_release(ctx->lock);
 
-        f->frame_attributes &= ~FRAME_ATTRIBUTE_ACPI_RECLAIM_MEMORY;
-        f->type = FRAME_TYPE_FREE;
-
-        ctx->allocated_frame_count -= f->frame_count;
-        ctx->free_frame_count += f->frame_count;
-
-        list_sortedlist_insert(ctx->free_frames_sorted_by_size, f);
-        ctx->free_frames_by_address->insert(ctx->free_frames_by_address, f, f, NULL);
+        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "frames are not allocated 0x%llx 0x%llx", frame_address, frame_count);
 
-        iter = iter->next(iter);
+        return -1;
     }
 
-    iter->destroy(iter);
-
-    list_destroy(frms);
-
     lock_release(ctx->lock);
 
+    // reserved frames out of buddy like mmio areas are only dropped from reserveds
+    frame_allocator_release_to_buddy(ctx, frame_address, frame_count);
+
     return 0;
 }
 
-int8_t fa_cleanup(frame_allocator_t* self) {
-    if(self == NULL) {
-        return -1;
-    }
-
-    frame_allocator_context_t* ctx = self->context;
-
-    lock_acquire(ctx->lock);
-
-    iterator_t* iter;
-    list_t* frms;
-
+static list_t* frame_allocator_untrack_frames_with_attribute(frame_allocator_context_t* ctx, index_t* frames_by_address, uint64_t attribute, uint64_t exclude_attribute) {
+    list_t* frms = list_create_list_with_heap(ctx->heap);
 
-    frms = list_create_sortedlist_with_heap(ctx->heap, frame_allocator_cmp_by_size);
+    if(frms == NULL) {
+        return NULL;
+    }
 
-    iter = ctx->reserved_frames_by_address->create_iterator(ctx->reserved_frames_by_address);
+    iterator_t* iter = frames_by_address->create_iterator(frames_by_address);
 
     while(iter->end_of_iterator(iter) != 0) {
         frame_t* f = (frame_t*)iter->get_item(iter);
 
-        if(f->frame_attributes & FRAME_ATTRIBUTE_OLD_RESERVED) {
-            list_sortedlist_insert(frms, f);
+        if((f->frame_attributes & attribute) && !(f->frame_attributes & exclude_attribute)) {
+            list_list_insert(frms, f);
         }
 
         iter = iter->next(iter);
@@ -711,78 +962,85 @@ int8_t fa_cleanup(frame_allocator_t* self) {
     while(iter->end_of_iterator(iter) != 0) {
         frame_t* f = (frame_t*)iter->get_item(iter);
 
-        ctx->reserved_frames_by_address->delete(ctx->reserved_frames_by_address, f, NULL);
-
-        for(uint64_t i = 0; i < f->frame_count; i++) {
-            memory_paging_add_page(0x1000, f->frame_address + i * FRAME_SIZE, MEMORY_PAGING_PAGE_TYPE_4K);
-            memory_memclean((void*)(0x1000), FRAME_SIZE);
-            memory_paging_delete_page(0x1000, NULL);
-        }
-
-        f->frame_attributes &= ~FRAME_ATTRIBUTE_OLD_RESERVED;
-        f->type = FRAME_TYPE_FREE;
-
-        ctx->allocated_frame_count -= f->frame_count;
-        ctx->free_frame_count += f->frame_count;
-
-        list_sortedlist_insert(ctx->free_frames_sorted_by_size, f);
-        ctx->free_frames_by_address->insert(ctx->free_frames_by_address, f, f, NULL);
+        frames_by_address->delete(frames_by_address, f, NULL);
 
         iter = iter->next(iter);
     }
 
     iter->destroy(iter);
 
-    list_destroy(frms);
-
+    return frms;
+}
 
-    frms = list_create_sortedlist_with_heap(ctx->heap, frame_allocator_cmp_by_size);
+static void frame_allocator_release_untracked_frames(frame_allocator_context_t* ctx, list_t* frms) {
+    if(frms == NULL) {
+        return;
+    }
 
-    iter = ctx->allocated_frames_by_address->create_iterator(ctx->allocated_frames_by_address);
+    iterator_t* iter = list_iterator_create(frms);
 
     while(iter->end_of_iterator(iter) != 0) {
         frame_t* f = (frame_t*)iter->get_item(iter);
 
-        if(f->frame_attributes & FRAME_ATTRIBUTE_OLD_RESERVED) {
-            list_sortedlist_insert(frms, f);
-        }
+        frame_allocator_release_to_buddy(ctx, f->frame_address, f->frame_count);
+
+        memory_free_ext(ctx->heap, f);
 
         iter = iter->next(iter);
     }
 
     iter->destroy(iter);
 
-    iter = list_iterator_create(frms);
+    list_destroy(frms);
+}
 
-    while(iter->end_of_iterator(iter) != 0) {
-        frame_t* f = (frame_t*)iter->get_item(iter);
+int8_t fa_release_acpi_reclaim_memory(frame_allocator_t* self) {
+    if(self == NULL) {
+        return -1;
+    }
 
-        ctx->allocated_frames_by_address->delete(ctx->allocated_frames_by_address, f, NULL);
+    frame_allocator_context_t* ctx = self->context;
 
-        for(uint64_t i = 0; i < f->frame_count; i++) {
-            memory_paging_add_page(0x1000, f->frame_address + i * FRAME_SIZE, MEMORY_PAGING_PAGE_TYPE_4K);
-            memory_memclean((void*)(0x1000), FRAME_SIZE);
-            memory_paging_delete_page(0x1000, NULL);
-        }
+    lock_acquire(ctx->lock);
 
-        f->frame_attributes &= ~FRAME_ATTRIBUTE_OLD_RESERVED;
-        f->type = FRAME_TYPE_FREE;
+    list_t* frms = frame_allocator_untrack_frames_with_attribute(ctx, ctx->reserved_frames_by_address,
+                                                                 FRAME_ATTRIBUTE_ACPI_RECLAIM_MEMORY,
+                                                                 FRAME_ATTRIBUTE_RESERVED_PAGE_MAPPED);
 
-        ctx->allocated_frame_count -= f->frame_count;
-        ctx->free_frame_count += f->frame_count;
+    lock_release(ctx->lock);
 
-        list_sortedlist_insert(ctx->free_frames_sorted_by_size, f);
-        ctx->free_frames_by_address->insert(ctx->free_frames_by_address, f, f, NULL);
+    if(frms == NULL) {
+        return -1;
+    }
 
-        iter = iter->next(iter);
+    frame_allocator_release_untracked_frames(ctx, frms);
+
+    return 0;
+}
+
+int8_t fa_cleanup(frame_allocator_t* self) {
+    if(self == NULL) {
+        return -1;
     }
 
-    iter->destroy(iter);
+    frame_allocator_context_t* ctx = self->context;
 
-    list_destroy(frms);
+    lock_acquire(ctx->lock);
+
+    list_t* reserved_frms = frame_allocator_untrack_frames_with_attribute(ctx, ctx->reserved_frames_by_address,
+                                                                          FRAME_ATTRIBUTE_OLD_RESERVED, 0);
+    list_t* allocated_frms = frame_allocator_untrack_frames_with_attribute(ctx, ctx->allocated_frames_by_address,
+                                                                           FRAME_ATTRIBUTE_OLD_RESERVED, 0);
 
     lock_release(ctx->lock);
 
+    frame_allocator_release_untracked_frames(ctx, reserved_frms);
+    frame_allocator_release_untracked_frames(ctx, allocated_frms);
+
+    if(reserved_frms == NULL || allocated_frms == NULL) {
+        return -1;
+    }
+
     return 0;
 }
 
@@ -847,6 +1105,92 @@ static int8_t frame_allocator_destroy_key(memory_heap_t* heap, void* key) {
     return 0;
 }
 
+static list_t* frame_allocator_collect_mmap_regions(memory_heap_t* heap) {
+    list_t* regions = list_create_list_with_heap(heap);
+
+    if(regions == NULL) {
+        return NULL;
+    }
+
+    uint64_t mmap_ent_cnt = SYSTEM_INFO->mmap_size / SYSTEM_INFO->mmap_descriptor_size;
+    frame_t* f = NULL;
+
+    for(size_t i = 0; i < mmap_ent_cnt; i++) {
+        efi_memory_descriptor_t* mem_desc = (efi_memory_descriptor_t*)(SYSTEM_INFO->mmap_data + (i * SYSTEM_INFO->mmap_descriptor_size));
+        frame_type_t type = fa_get_fa_type(mem_desc->type);
+
+        if(f && f->type == type && (f->frame_address + f->frame_count * FRAME_SIZE) == mem_desc->physical_start &&
+           f->frame_attributes == mem_desc->attribute) {
+            f->frame_count += mem_desc->page_count;
+
+            continue;
+        }
+
+        f = memory_malloc_ext(heap, sizeof(frame_t), 0);
+
+        if(f == NULL) {
+            list_destroy_with_data(regions);
+
+            return NULL;
+        }
+
+        f->frame_address = mem_desc->physical_start;
+        f->frame_count = mem_desc->page_count;
+        f->type = type;
+        f->frame_attributes = mem_desc->attribute;
+
+        list_list_insert(regions, f);
+    }
+
+    return regions;
+}
+
+static int8_t frame_allocator_init_buddy(frame_allocator_context_t* ctx, list_t* regions) {
+    uint64_t span_start = -1ULL;
+    uint64_t span_end = 0;
+
+    iterator_t* iter = list_iterator_create(regions);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        frame_t* f = (frame_t*)iter->get_item(iter);
+
+        if(f->type == FRAME_TYPE_FREE || f->type == FRAME_TYPE_ACPI_RECLAIM_MEMORY) {
+            span_start = MIN(span_start, f->frame_address);
+            span_end = MAX(span_end, f->frame_address + f->frame_count * FRAME_SIZE);
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(span_end == 0) {
+        return -1;
+    }
+
+    uint64_t max_block_size = FRAME_SIZE << FRAME_ALLOCATOR_BUDDY_MAX_ORDER;
+
+    ctx->buddy_base = span_start & ~(max_block_size - 1);
+    ctx->buddy_frame_count = ((span_end - ctx->buddy_base + max_block_size - 1) & ~(max_block_size - 1)) / FRAME_SIZE;
+
+    for(uint8_t o = 0; o < FRAME_ALLOCATOR_BUDDY_ORDER_COUNT; o++) {
+        ctx->buddy_word_counts[o] = ((ctx->buddy_frame_count >> o) + 63) / 64;
+        ctx->buddy_bitmaps[o] = memory_malloc_ext(ctx->heap, ctx->buddy_word_counts[o] * sizeof(uint64_t), 0);
+
+        if(ctx->buddy_bitmaps[o] == NULL) {
+            return -1;
+        }
+    }
+
+    ctx->tracked_bitmap = memory_malloc_ext(ctx->heap, ctx->buddy_word_counts[0] * sizeof(uint64_t), 0);
+
+    if(ctx->tracked_bitmap == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
 frame_allocator_t* frame_allocator_new_ext(memory_heap_t* heap) {
@@ -859,20 +1203,14 @@ frame_allocator_t* frame_allocator_new_ext(memory_heap_t* heap) {
     frame_allocator_t* fa = memory_malloc_ext(heap, sizeof(frame_allocator_t), 0);
 
     if(fa == NULL) {
-        memory_free_ext(ctx->heap, ctx);
+        memory_free_ext(heap, ctx);
         return NULL;
     }
 
     ctx->heap = heap;
-    ctx->free_frames_sorted_by_size = list_create_sortedlist_with_heap(heap, frame_allocator_cmp_by_size);
-    list_set_equality_comparator(ctx->free_frames_sorted_by_size, frame_allocator_cmp_by_address);
 
     ctx->acpi_frames = list_create_sortedlist_with_heap(heap, frame_allocator_cmp_by_address);
 
-    ctx->free_frames_by_address = bplustree_create_index_with_heap_and_unique(heap, 64, frame_allocator_cmp_by_address, true);
-    bplustree_set_key_cloner(ctx->free_frames_by_address, frame_allocator_clone_key);
-    bplustree_set_key_destroyer(ctx->free_frames_by_address, frame_allocator_destroy_key);
-
     ctx->allocated_frames_by_address = bplustree_create_index_with_heap_and_unique(heap, 64, frame_allocator_cmp_by_address, true);
     bplustree_set_key_cloner(ctx->allocated_frames_by_address, frame_allocator_clone_key);
     bplustree_set_key_destroyer(ctx->allocated_frames_by_address, frame_allocator_destroy_key);
@@ -883,81 +1221,69 @@ frame_allocator_t* frame_allocator_new_ext(memory_heap_t* heap) {
 
     ctx->lock = lock_create_with_heap(heap);
 
-    efi_memory_descriptor_t* mem_desc;
-
-    mem_desc = (efi_memory_descriptor_t*)(SYSTEM_INFO->mmap_data);
-
-    uint64_t frame_start = mem_desc->physical_start;
-    uint64_t frame_count = mem_desc->page_count;
-    frame_type_t type = fa_get_fa_type(mem_desc->type);
-    uint64_t frame_attr = mem_desc->attribute;
+    fa->context = ctx;
 
-    uint64_t mmap_ent_cnt = SYSTEM_INFO->mmap_size / SYSTEM_INFO->mmap_descriptor_size;
-    for(size_t i = 1; i < mmap_ent_cnt; i++) {
-        mem_desc = (efi_memory_descriptor_t*)(SYSTEM_INFO->mmap_data + (i * SYSTEM_INFO->mmap_descriptor_size));
+    list_t* regions = frame_allocator_collect_mmap_regions(heap);
 
-        if(type == fa_get_fa_type(mem_desc->type) && (frame_start + frame_count * FRAME_SIZE) == mem_desc->physical_start && frame_attr == mem_desc->attribute) {
-            frame_count += mem_desc->page_count;
-        } else {
+    if(regions == NULL || frame_allocator_init_buddy(ctx, regions) != 0) {
+        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "cannot build buddy from memory map");
 
+        if(regions) {
+            list_destroy_with_data(regions);
+        }
 
-            frame_t* f = memory_malloc_ext(heap, sizeof(frame_t), 0);
+        frame_allocator_destroy(fa);
 
-            if(f == NULL) {
-                memory_free_ext(ctx->heap, fa);
-                memory_free_ext(ctx->heap, ctx);
+        return NULL;
+    }
 
-                return NULL;
-            }
+    iterator_t* iter = list_iterator_create(regions);
 
+    while(iter->end_of_iterator(iter) != 0) {
+        frame_t* f = (frame_t*)iter->get_item(iter);
 
-            f->frame_address = frame_start;
-            f->frame_count = frame_count;
-            f->type = type;
-            f->frame_attributes = mem_desc->attribute;
+        if((f->frame_address + f->frame_count * FRAME_SIZE) <= (1 << 20)) {
+            f->type = FRAME_TYPE_RESERVED;
+        }
 
-            if((frame_start + frame_count * FRAME_SIZE) <= (1 << 20)) {
-                type = FRAME_TYPE_RESERVED;
-                f->type = type;
-            }
+        ctx->total_frame_count += f->frame_count;
 
-            ctx->total_frame_count += frame_count;
+        boolean_t in_buddy = frame_allocator_is_in_buddy(ctx, f->frame_address, f->frame_count);
+        uint64_t frame_idx = in_buddy?(f->frame_address - ctx->buddy_base) / FRAME_SIZE:0;
 
-            switch (type) {
-            case FRAME_TYPE_FREE:
-                ctx->free_frames_by_address->insert(ctx->free_frames_by_address, f, f, NULL);
-                list_sortedlist_insert(ctx->free_frames_sorted_by_size, f);
-                ctx->free_frame_count += frame_count;
-                break;
-            case FRAME_TYPE_USED:
-                ctx->allocated_frames_by_address->insert(ctx->allocated_frames_by_address, f, f, NULL);
-                ctx->allocated_frame_count += frame_count;
-                break;
-            case FRAME_TYPE_RESERVED:
-                ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, f, f, NULL);
-                ctx->allocated_frame_count += frame_count;
-                break;
-            case FRAME_TYPE_ACPI_RECLAIM_MEMORY:
-                f->frame_attributes |= FRAME_ATTRIBUTE_ACPI_RECLAIM_MEMORY;
-                ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, f, f, NULL);
-                ctx->allocated_frame_count += frame_count;
-                break;
-            case FRAME_TYPE_ACPI_CODE:
-            case FRAME_TYPE_ACPI_DATA:
-                f->frame_attributes |= FRAME_ATTRIBUTE_ACPI;
-                list_sortedlist_insert(ctx->acpi_frames, f);
-                ctx->allocated_frame_count += frame_count;
+        switch (f->type) {
+        case FRAME_TYPE_FREE:
+            frame_allocator_buddy_free_range(ctx, frame_idx, f->frame_count);
+            ctx->free_frame_count += f->frame_count;
+            memory_free_ext(heap, f);
+            break;
+        case FRAME_TYPE_ACPI_RECLAIM_MEMORY:
+            f->frame_attributes |= FRAME_ATTRIBUTE_ACPI_RECLAIM_MEMORY;
+            f->type = FRAME_TYPE_RESERVED;
+        // fall through
+        case FRAME_TYPE_USED:
+        case FRAME_TYPE_RESERVED:
+            if(in_buddy) {
+                frame_allocator_tracked_set(ctx, frame_idx, f->frame_count, true);
             }
 
-
-            frame_start = mem_desc->physical_start;
-            frame_count = mem_desc->page_count;
-            type = fa_get_fa_type(mem_desc->type);
+            ctx->reserved_frames_by_address->insert(ctx->reserved_frames_by_address, f, f, NULL);
+            ctx->allocated_frame_count += f->frame_count;
+            break;
+        case FRAME_TYPE_ACPI_CODE:
+        case FRAME_TYPE_ACPI_DATA:
+            f->frame_attributes |= FRAME_ATTRIBUTE_ACPI;
+            list_sortedlist_insert(ctx->acpi_frames, f);
+            ctx->allocated_frame_count += f->frame_count;
         }
 
+        iter = iter->next(iter);
     }
 
-    fa->context = ctx;
+    iter->destroy(iter);
+
+    list_destroy(regions);
+
     fa->allocate_frame_by_count = fa_allocate_frame_by_count;
     fa->allocate_frame = fa_allocate_frame;
     fa->release_frame = fa_release_frame;
@@ -973,47 +1299,105 @@ frame_allocator_t* frame_allocator_new_ext(memory_heap_t* heap) {
 }
 #pragma GCC diagnostic pop
 
-// TODO: delete me
-void frame_allocator_print(frame_allocator_t* fa) {
-    if(fa == NULL) {
-        return;
+int8_t frame_allocator_enable_cpu_cache(frame_allocator_t* fa, frame_allocator_cpu_id_getter_f cpu_id_getter) {
+    if(fa == NULL || cpu_id_getter == NULL) {
+        return -1;
     }
 
     frame_allocator_context_t* ctx = fa->context;
 
-    iterator_t* iter;
+    if(ctx->cpu_caches) {
+        return 0;
+    }
 
-    iter = ctx->free_frames_by_address->create_iterator(ctx->free_frames_by_address);
+    frame_allocator_cpu_cache_t* cpu_caches = memory_malloc_ext(ctx->heap, sizeof(frame_allocator_cpu_cache_t) * FRAME_ALLOCATOR_MAX_CPU_COUNT, 0);
 
-    printf("free frames by address\n");
+    if(cpu_caches == NULL) {
+        PRINTLOG(FRAMEALLOCATOR, LOG_ERROR, "cannot allocate cpu caches");
 
-    while(iter->end_of_iterator(iter) != 0) {
-        frame_t* f = (frame_t*)iter->get_item(iter);
+        return -1;
+    }
 
-        printf("0x%016llx \t 0x%016llx \t 0x%016llx\n", f->frame_address, f->frame_count, f->frame_attributes);
+    ctx->cpu_id_getter = cpu_id_getter;
+    ctx->cpu_caches = cpu_caches;
+
+    return 0;
+}
+
+static void frame_allocator_destroy_frames_of_index(memory_heap_t* heap, index_t* idx) {
+    if(idx == NULL) {
+        return;
+    }
+
+    iterator_t* iter = idx->create_iterator(idx);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        memory_free_ext(heap, (void*)iter->get_item(iter));
 
         iter = iter->next(iter);
     }
 
     iter->destroy(iter);
 
-    iter = list_iterator_create(ctx->free_frames_sorted_by_size);
+    bplustree_destroy_index(idx);
+}
+
+int8_t frame_allocator_destroy(frame_allocator_t* fa) {
+    if(fa == NULL) {
+        return -1;
+    }
 
-    printf("free frames by size\n");
+    frame_allocator_context_t* ctx = fa->context;
+    memory_heap_t* heap = ctx->heap;
 
-    while(iter->end_of_iterator(iter) != 0) {
-        frame_t* f = (frame_t*)iter->get_item(iter);
+    frame_allocator_destroy_frames_of_index(heap, ctx->allocated_frames_by_address);
+    frame_allocator_destroy_frames_of_index(heap, ctx->reserved_frames_by_address);
 
-        printf("0x%016llx \t 0x%016llx \t 0x%016llx\n", f->frame_address, f->frame_count, f->frame_attributes);
+    if(ctx->acpi_frames) {
+        list_destroy_with_data(ctx->acpi_frames);
+    }
 
-        iter = iter->next(iter);
+    for(uint8_t o = 0; o < FRAME_ALLOCATOR_BUDDY_ORDER_COUNT; o++) {
+        memory_free_ext(heap, ctx->buddy_bitmaps[o]);
     }
 
-    iter->destroy(iter);
+    memory_free_ext(heap, ctx->tracked_bitmap);
+    memory_free_ext(heap, ctx->cpu_caches);
+
+    lock_destroy(ctx->lock);
+
+    memory_free_ext(heap, ctx);
+    memory_free_ext(heap, fa);
+
+    return 0;
+}
+
+void frame_allocator_print(frame_allocator_t* fa) {
+    if(fa == NULL) {
+        return;
+    }
+
+    frame_allocator_context_t* ctx = fa->context;
+
+    printf("buddy base 0x%016llx frame count 0x%llx\n", ctx->buddy_base, ctx->buddy_frame_count);
+
+    for(uint8_t o = 0; o < FRAME_ALLOCATOR_BUDDY_ORDER_COUNT; o++) {
+        uint64_t block_count = 0;
+
+        for(uint64_t w = 0; w < ctx->buddy_word_counts[o]; w++) {
+            block_count += __builtin_popcountll(ctx->buddy_bitmaps[o][w]);
+        }
+
+        if(block_count) {
+            printf("order %02i free blocks 0x%llx\n", o, block_count);
+        }
+    }
+
+    iterator_t* iter;
 
     iter = ctx->allocated_frames_by_address->create_iterator(ctx->allocated_frames_by_address);
 
-    printf("used frames by address\n");
+    printf("old reserved frames by address\n");
 
     while(iter->end_of_iterator(iter) != 0) {
         frame_t* f = (frame_t*)iter->get_item(iter);
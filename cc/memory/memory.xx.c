@@ -76,6 +76,10 @@ void* memory_malloc_ext(memory_heap_t* heap, size_t size, size_t align){
             lock_release(current_task->heap->lock);
         }
 
+        if(!res) {
+            res = memory_magazine_malloc(size, align);
+        }
+
         if(!res) {
             lock_acquire(memory_heap_default->lock);
             res = memory_heap_default->malloc(memory_heap_default, size, align);
@@ -83,9 +87,15 @@ void* memory_malloc_ext(memory_heap_t* heap, size_t size, size_t align){
         }
 
     }else {
-        lock_acquire(heap->lock);
-        res = heap->malloc(heap, size, align);
-        lock_release(heap->lock);
+        if(heap == memory_heap_default) {
+            res = memory_magazine_malloc(size, align);
+        }
+
+        if(!res) {
+            lock_acquire(heap->lock);
+            res = heap->malloc(heap, size, align);
+            lock_release(heap->lock);
+        }
     }
 
     if(res != NULL) {
@@ -101,6 +111,20 @@ void* memory_malloc_ext(memory_heap_t* heap, size_t size, size_t align){
 int8_t memory_free_ext(memory_heap_t* heap, void* address){
     int8_t res = -1;
 
+    // magazine objects are at an area reserved from default heap, address range tells owner
+    if(heap == NULL || heap == memory_heap_default) {
+        int8_t mag_res = memory_magazine_free(address);
+
+        if(mag_res == 0) {
+            return 0;
+        }
+
+        // rejected magazine address is inside of reserved area, heaps should not free it either
+        if(mag_res > 0) {
+            return -1;
+        }
+    }
+
     if(heap == NULL) {
         task_t* current_task = memory_get_current_task();
         if(current_task != NULL && current_task->heap != NULL) {
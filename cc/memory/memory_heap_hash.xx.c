@@ -55,6 +55,15 @@ typedef struct memory_heap_hash_pool_t {
     uint32_t                      segment_end;
 }__attribute__((packed)) memory_heap_hash_pool_t;
 
+/*! page size of page granular allocations */
+#define MEMORY_HEAP_HASH_PAGE_SIZE        0x1000
+/*! page count of a page chunk, one bit per page at chunk bitmaps */
+#define MEMORY_HEAP_HASH_PAGE_CHUNK_PAGES 64
+/*! page chunk size */
+#define MEMORY_HEAP_HASH_PAGE_CHUNK_SIZE  (MEMORY_HEAP_HASH_PAGE_SIZE * MEMORY_HEAP_HASH_PAGE_CHUNK_PAGES)
+/*! bucket count of page chunk index, chunks are hashed by chunk sized address ranges */
+#define MEMORY_HEAP_HASH_PAGE_CHUNK_BUCKETS 64
+
 typedef struct memory_heap_hash_metadata_t {
     uint64_t pools[MEMORY_HEAP_HASH_MAX_POOLS];
     uint16_t pool_count;
@@ -68,8 +77,93 @@ typedef struct memory_heap_hash_metadata_t {
     uint64_t free_size;
     uint64_t fast_hit;
     uint64_t header_count;
+    uint64_t page_chunks;
+    uint64_t page_chunk_buckets[MEMORY_HEAP_HASH_PAGE_CHUNK_BUCKETS];
 }__attribute__((packed)) memory_heap_hash_metadata_t;
 
+/**
+ * @brief page aligned chunk for page aligned allocations, pages are tracked with bitmaps.
+ *
+ * hash blocks carry a one byte flag before each block hence page aligned blocks cannot be packed,
+ * so page aligned allocations are served from chunks instead of wasting a page per allocation.
+ */
+typedef struct memory_heap_hash_page_chunk_t {
+    uint64_t                              base;
+    uint64_t                              used;
+    uint64_t                              ends;
+    struct memory_heap_hash_page_chunk_t* next;
+    struct memory_heap_hash_page_chunk_t* prev;
+    struct memory_heap_hash_page_chunk_t* bucket_next;
+} memory_heap_hash_page_chunk_t;
+
+static inline uint64_t memory_heap_hash_page_chunk_bucket(uint64_t address) {
+    return (address / MEMORY_HEAP_HASH_PAGE_CHUNK_SIZE) % MEMORY_HEAP_HASH_PAGE_CHUNK_BUCKETS;
+}
+
+static void memory_heap_hash_page_chunk_link(memory_heap_hash_metadata_t* metadata, memory_heap_hash_page_chunk_t* chunk) {
+    chunk->prev = NULL;
+    chunk->next = (memory_heap_hash_page_chunk_t*)metadata->page_chunks;
+
+    if(chunk->next) {
+        chunk->next->prev = chunk;
+    }
+
+    metadata->page_chunks = (uint64_t)chunk;
+
+    uint64_t bucket = memory_heap_hash_page_chunk_bucket(chunk->base);
+
+    chunk->bucket_next = (memory_heap_hash_page_chunk_t*)metadata->page_chunk_buckets[bucket];
+    metadata->page_chunk_buckets[bucket] = (uint64_t)chunk;
+}
+
+static void memory_heap_hash_page_chunk_unlink(memory_heap_hash_metadata_t* metadata, memory_heap_hash_page_chunk_t* chunk) {
+    if(chunk->prev) {
+        chunk->prev->next = chunk->next;
+    } else {
+        metadata->page_chunks = (uint64_t)chunk->next;
+    }
+
+    if(chunk->next) {
+        chunk->next->prev = chunk->prev;
+    }
+
+    uint64_t bucket = memory_heap_hash_page_chunk_bucket(chunk->base);
+    memory_heap_hash_page_chunk_t* bucket_prev = (memory_heap_hash_page_chunk_t*)metadata->page_chunk_buckets[bucket];
+
+    if(bucket_prev == chunk) {
+        metadata->page_chunk_buckets[bucket] = (uint64_t)chunk->bucket_next;
+
+        return;
+    }
+
+    while(bucket_prev->bucket_next != chunk) {
+        bucket_prev = bucket_prev->bucket_next;
+    }
+
+    bucket_prev->bucket_next = chunk->bucket_next;
+}
+
+/**
+ * @brief finds chunk of address with chunk index
+ * @details chunk bases are page aligned, so a chunk starts at bucket of address or at previous bucket
+ */
+static memory_heap_hash_page_chunk_t* memory_heap_hash_page_chunk_find(memory_heap_hash_metadata_t* metadata, uint64_t address) {
+    for(uint64_t i = 0; i < 2 && address >= i * MEMORY_HEAP_HASH_PAGE_CHUNK_SIZE; i++) {
+        uint64_t bucket = memory_heap_hash_page_chunk_bucket(address - i * MEMORY_HEAP_HASH_PAGE_CHUNK_SIZE);
+        memory_heap_hash_page_chunk_t* chunk = (memory_heap_hash_page_chunk_t*)metadata->page_chunk_buckets[bucket];
+
+        while(chunk) {
+            if(chunk->base <= address && address < chunk->base + MEMORY_HEAP_HASH_PAGE_CHUNK_SIZE) {
+                return chunk;
+            }
+
+            chunk = chunk->bucket_next;
+        }
+    }
+
+    return NULL;
+}
+
 static inline memory_heap_hash_pool_t* memory_heap_hash_pool_get(memory_heap_hash_metadata_t* metadata, uint16_t pool_id) {
     if(!metadata) {
         return NULL;
@@ -114,7 +208,7 @@ static inline memory_heap_hash_block_t* memory_heap_hash_pool_get_hash_block(mem
     return (memory_heap_hash_block_t*)(pool->pool_base + block_address);
 }
 
-static inline void* memory_heap_hash_try_alloc_from_fast_class(memory_heap_hash_metadata_t* metadata, uint32_t size) {
+static inline void* memory_heap_hash_try_alloc_from_fast_class(memory_heap_hash_metadata_t* metadata, uint64_t alignment, uint32_t size) {
     uint32_t fast_class = size / 16;
 
     if(fast_class >= MEMORY_HEAP_HASH_FAST_CLASSES_COUNT) {
@@ -131,6 +225,10 @@ static inline void* memory_heap_hash_try_alloc_from_fast_class(memory_heap_hash_
                 continue;
             }
 
+            if((pool->pool_base + hash_block->address) % alignment) {
+                continue;
+            }
+
             pool->fast_classes[fast_class].head = hash_block->next;
 
             if(pool->fast_classes[fast_class].head == 0) {
@@ -182,7 +280,7 @@ static inline void* memory_heap_hash_try_alloc_from_free_list(memory_heap_hash_m
 
             // PRINTLOG(HEAP_HASH, LOG_TRACE, "found free node 0x%x address 0x%x size 0x%x", free_list, free_node->address, free_node->size);
 
-            if(free_node->size == size && !(free_node->address % alignment)) {
+            if(free_node->size == size && !((pool->pool_base + free_node->address) % alignment)) {
                 // PRINTLOG(HEAP_HASH, LOG_TRACE, "found free node 0x%x address 0x%x size 0x%x", free_list, free_node->address, free_node->size);
 
                 uint32_t next_free_list = free_node->next;
@@ -339,7 +437,7 @@ static inline void memory_heap_hash_pool_insert_sorted_at_free_list(memory_heap_
     // PRINTLOG(HEAP_HASH, LOG_TRACE, "inserted hash block 0x%x at free list 0x%x", hash_block_address, pool->free_list);
 }
 
-void* memory_heap_hash_malloc_ext(memory_heap_t* heap, uint64_t size, uint64_t alignment) {
+static void* memory_heap_hash_malloc_blocks(memory_heap_t* heap, uint64_t size, uint64_t alignment) {
     if(!heap) {
         return NULL;
     }
@@ -360,13 +458,11 @@ void* memory_heap_hash_malloc_ext(memory_heap_t* heap, uint64_t size, uint64_t a
 
     // PRINTLOG(HEAP_HASH, LOG_TRACE, "fixed malloc size 0x%llx alignment 0x%llx", size, alignment);
 
-    // look at fast classes if alignment is 16
-    if(alignment == 16) {
-        void* fast_class_ptr = memory_heap_hash_try_alloc_from_fast_class(metadata, size);
+    // look at fast classes, only head of each class is checked for alignment
+    void* fast_class_ptr = memory_heap_hash_try_alloc_from_fast_class(metadata, alignment, size);
 
-        if(fast_class_ptr) {
-            return fast_class_ptr;
-        }
+    if(fast_class_ptr) {
+        return fast_class_ptr;
     }
 
     // look at free list
@@ -396,7 +492,8 @@ void* memory_heap_hash_malloc_ext(memory_heap_t* heap, uint64_t size, uint64_t a
         }
 
         if(alignment > 16) {
-            uint32_t back = last_address % alignment + pool->pool_base % alignment;
+            // align absolute address, gap above block becomes a free block
+            uint32_t back = (pool->pool_base + last_address) % alignment;
 
             if(back > last_address) {
                 // PRINTLOG(HEAP_HASH, LOG_TRACE, "pool %d last address 0x%x is less than alignment 0x%llx", pool_id, last_address, alignment);
@@ -404,7 +501,7 @@ void* memory_heap_hash_malloc_ext(memory_heap_t* heap, uint64_t size, uint64_t a
                 continue;
             }
 
-            last_address -= last_address % alignment + pool->pool_base % alignment;
+            last_address -= back;
         }
 
         if(last_address <= pool->segment_end) {
@@ -499,7 +596,7 @@ void* memory_heap_hash_malloc_ext(memory_heap_t* heap, uint64_t size, uint64_t a
 }
 
 
-int8_t memory_heap_hash_free(memory_heap_t* heap, void* ptr) {
+static int8_t memory_heap_hash_free_blocks(memory_heap_t* heap, void* ptr) {
     if(!heap || !ptr) {
 
         return -1;
@@ -604,6 +701,156 @@ int8_t memory_heap_hash_free(memory_heap_t* heap, void* ptr) {
     return 0;
 }
 
+static void* memory_heap_hash_malloc_pages(memory_heap_t* heap, uint64_t size, uint64_t alignment) {
+    memory_heap_hash_metadata_t* metadata = heap->metadata;
+
+    uint64_t page_count = (size + MEMORY_HEAP_HASH_PAGE_SIZE - 1) / MEMORY_HEAP_HASH_PAGE_SIZE;
+    uint64_t mask = page_count == 64 ? -1ULL : (1ULL << page_count) - 1;
+
+    memory_heap_hash_page_chunk_t* chunk = (memory_heap_hash_page_chunk_t*)metadata->page_chunks;
+    boolean_t chunk_created = false;
+
+    while(true) {
+        if(!chunk) {
+            if(chunk_created) {
+                // new chunk cannot satisfy alignment, it is still at head of list
+                chunk = (memory_heap_hash_page_chunk_t*)metadata->page_chunks;
+
+                if(!chunk->used) {
+                    memory_heap_hash_page_chunk_unlink(metadata, chunk);
+                    memory_heap_hash_free_blocks(heap, (void*)chunk->base);
+                    memory_heap_hash_free_blocks(heap, chunk);
+                }
+
+                return NULL;
+            }
+
+            chunk_created = true;
+            chunk = memory_heap_hash_malloc_blocks(heap, sizeof(memory_heap_hash_page_chunk_t), 16);
+
+            if(!chunk) {
+                return NULL;
+            }
+
+            void* base = memory_heap_hash_malloc_blocks(heap, MEMORY_HEAP_HASH_PAGE_CHUNK_SIZE, MEMORY_HEAP_HASH_PAGE_SIZE);
+
+            if(!base) {
+                memory_heap_hash_free_blocks(heap, chunk);
+
+                return NULL;
+            }
+
+            chunk->base = (uint64_t)base;
+            chunk->used = 0;
+            chunk->ends = 0;
+            memory_heap_hash_page_chunk_link(metadata, chunk);
+        }
+
+        for(uint64_t i = 0; i + page_count <= MEMORY_HEAP_HASH_PAGE_CHUNK_PAGES; i++) {
+            if((chunk->used & (mask << i)) || ((chunk->base + i * MEMORY_HEAP_HASH_PAGE_SIZE) % alignment)) {
+                continue;
+            }
+
+            chunk->used |= mask << i;
+            chunk->ends |= 1ULL << (i + page_count - 1);
+
+            metadata->malloc_count++;
+
+            void* res = (void*)(chunk->base + i * MEMORY_HEAP_HASH_PAGE_SIZE);
+
+            PRINTLOG(HEAP_HASH, LOG_DEBUG, "malloced 0x%llx pages at 0x%p", page_count, res);
+
+            return res;
+        }
+
+        chunk = chunk->next;
+    }
+
+    return NULL;
+}
+
+static int8_t memory_heap_hash_free_pages(memory_heap_t* heap, void* ptr) {
+    memory_heap_hash_metadata_t* metadata = heap->metadata;
+
+    uint64_t address = (uint64_t)ptr;
+
+    memory_heap_hash_page_chunk_t* chunk = memory_heap_hash_page_chunk_find(metadata, address);
+
+    if(!chunk) {
+        return 1;
+    }
+
+    uint64_t page_idx = (address - chunk->base) / MEMORY_HEAP_HASH_PAGE_SIZE;
+
+    if(!(chunk->used & (1ULL << page_idx)) || (page_idx && (chunk->used & (1ULL << (page_idx - 1))) && !(chunk->ends & (1ULL << (page_idx - 1))))) {
+        PRINTLOG(HEAP_HASH, LOG_WARNING, "address %p is not an allocated page start. heap task 0x%llx", ptr, heap->task_id);
+
+        return -1;
+    }
+
+    uint64_t end_idx = page_idx;
+
+    while(!(chunk->ends & (1ULL << end_idx))) {
+        end_idx++;
+    }
+
+    uint64_t page_count = end_idx - page_idx + 1;
+    uint64_t mask = page_count == 64 ? -1ULL : (1ULL << page_count) - 1;
+
+    memory_memclean(ptr, page_count * MEMORY_HEAP_HASH_PAGE_SIZE);
+
+    chunk->used &= ~(mask << page_idx);
+    chunk->ends &= ~(1ULL << end_idx);
+
+    metadata->free_count++;
+
+    PRINTLOG(HEAP_HASH, LOG_DEBUG, "freed 0x%llx pages at %p", page_count, ptr);
+
+    if(!chunk->used) {
+        memory_heap_hash_page_chunk_unlink(metadata, chunk);
+        memory_heap_hash_free_blocks(heap, (void*)chunk->base);
+        memory_heap_hash_free_blocks(heap, chunk);
+    }
+
+    return 0;
+}
+
+void* memory_heap_hash_malloc_ext(memory_heap_t* heap, uint64_t size, uint64_t alignment) {
+    if(!heap || !size) {
+        return NULL;
+    }
+
+    // page aligned buffers are packed at page chunks
+    if(alignment >= MEMORY_HEAP_HASH_PAGE_SIZE && !(alignment % MEMORY_HEAP_HASH_PAGE_SIZE) &&
+       alignment <= MEMORY_HEAP_HASH_PAGE_CHUNK_SIZE && size <= MEMORY_HEAP_HASH_PAGE_CHUNK_SIZE / 2) {
+        void* res = memory_heap_hash_malloc_pages(heap, size, alignment);
+
+        if(res) {
+            return res;
+        }
+    }
+
+    return memory_heap_hash_malloc_blocks(heap, size, alignment);
+}
+
+int8_t memory_heap_hash_free(memory_heap_t* heap, void* ptr) {
+    if(!heap || !ptr) {
+        return -1;
+    }
+
+    memory_heap_hash_metadata_t* metadata = heap->metadata;
+
+    if(metadata->page_chunks && !((uint64_t)ptr % MEMORY_HEAP_HASH_PAGE_SIZE)) {
+        int8_t res = memory_heap_hash_free_pages(heap, ptr);
+
+        if(res != 1) {
+            return res;
+        }
+    }
+
+    return memory_heap_hash_free_blocks(heap, ptr);
+}
+
 void memory_heap_hash_stat(memory_heap_t* heap, memory_heap_stat_t* stat) {
     if(!heap || !stat) {
         return;
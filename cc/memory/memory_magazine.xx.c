@@ -0,0 +1,595 @@
+/**
+ * @file memory_magazine.xx.c
+ * @brief per cpu magazine front end of default heap for small allocations
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <memory.h>
+#include <cpu/sync.h>
+#include <logging.h>
+
+MODULE("turnstone.lib.memory");
+
+/*! size class granularity */
+#define MEMORY_MAGAZINE_CLASS_SIZE    16
+/*! size class count, classes are 16, 32, ... MEMORY_MAGAZINE_OBJECT_MAX_SIZE */
+#define MEMORY_MAGAZINE_CLASS_COUNT   (MEMORY_MAGAZINE_OBJECT_MAX_SIZE / MEMORY_MAGAZINE_CLASS_SIZE)
+/*! object count of a full magazine */
+#define MEMORY_MAGAZINE_CAPACITY      32
+/*! object count moved at refill and left after flush */
+#define MEMORY_MAGAZINE_BATCH         (MEMORY_MAGAZINE_CAPACITY / 2)
+/*! slab size, a slab is owned by one cpu and one size class */
+#define MEMORY_MAGAZINE_SLAB_SIZE     (64 << 10)
+/*! maximum cpu id plus one */
+#define MEMORY_MAGAZINE_MAX_CPU_COUNT 256
+/*! allocated bitmap word count of a slab, smallest class has most objects */
+#define MEMORY_MAGAZINE_BITMAP_SIZE   (MEMORY_MAGAZINE_SLAB_SIZE / MEMORY_MAGAZINE_CLASS_SIZE / 64)
+
+typedef struct memory_magazine_slab_t memory_magazine_slab_t;
+
+/**
+ * @struct memory_magazine_slab_t
+ * @brief slab metadata, slab data is at reserved area and found by address arithmetic
+ */
+struct memory_magazine_slab_t {
+    memory_magazine_slab_t* next; ///< next slab at partial list or free slabs
+    memory_magazine_slab_t* previous; ///< previous slab at partial list
+    void*                   free_list; ///< freed objects linked with their first word
+    uint32_t                cpu_id; ///< owner cpu
+    uint32_t                class_id; ///< size class
+    uint32_t                object_size; ///< object size
+    uint32_t                object_count; ///< object count at slab
+    uint32_t                carved_count; ///< objects given out at least once
+    uint32_t                free_count; ///< objects at free list and not carved ones
+    uint64_t                allocated[MEMORY_MAGAZINE_BITMAP_SIZE]; ///< objects given to callers, double frees are rejected
+};
+
+/**
+ * @struct memory_magazine_t
+ * @brief stack of zeroed objects of one size class
+ */
+typedef struct memory_magazine_t {
+    uint64_t count; ///< object count
+    void*    objects[MEMORY_MAGAZINE_CAPACITY]; ///< objects
+} memory_magazine_t;
+
+/**
+ * @struct memory_magazine_cpu_t
+ * @brief per cpu state, only owner cpu touches it except remote free lists
+ */
+typedef struct memory_magazine_cpu_t {
+    volatile uint64_t       busy; ///< owner is inside magazine code, guards against task switch
+    uint32_t                cpu_id; ///< cpu id
+    uint64_t                hit_count; ///< allocations served from magazines
+    uint64_t                refill_count; ///< refill count
+    uint64_t                flush_count; ///< flush count
+    uint64_t                remote_free_count; ///< frees made by other cpus
+    void*                   remote_frees[MEMORY_MAGAZINE_CLASS_COUNT]; ///< objects freed by other cpus, pushed with cas
+    memory_magazine_slab_t* partial_slabs[MEMORY_MAGAZINE_CLASS_COUNT]; ///< owned slabs which have free objects
+    memory_magazine_t       magazines[MEMORY_MAGAZINE_CLASS_COUNT]; ///< magazines
+} memory_magazine_cpu_t;
+
+/**
+ * @struct memory_magazine_pool_t
+ * @brief global magazine state, slabs are carved from one area reserved from default heap
+ */
+typedef struct memory_magazine_pool_t {
+    volatile uint64_t               lock; ///< guards free slabs and cpu states creation
+    boolean_t                       enabled; ///< new allocations can use magazines
+    memory_magazine_cpu_id_getter_f cpu_id_getter; ///< current cpu id getter
+    void*                           reserved; ///< area reserved from default heap
+    uint64_t                        data_start; ///< start of first slab
+    uint64_t                        slab_count; ///< slab count
+    memory_magazine_slab_t*         slabs; ///< slab metadata array
+    memory_magazine_slab_t*         free_slabs; ///< slabs not owned by any cpu
+    uint64_t                        free_slab_count; ///< free slab count
+    memory_magazine_cpu_t*          cpus[MEMORY_MAGAZINE_MAX_CPU_COUNT]; ///< per cpu states
+} memory_magazine_pool_t;
+
+static memory_magazine_pool_t memory_magazine_pool = {0};
+
+static inline boolean_t memory_magazine_try_lock(volatile uint64_t* lock) {
+    uint8_t was_locked = 0;
+    __asm__ __volatile__ ("lock btsq $0, %[lock]\n" : "=@ccc" (was_locked), [lock] "+m" (*lock) : : "memory");
+    return !was_locked;
+}
+
+static inline void memory_magazine_lock(volatile uint64_t* lock) {
+    while(!memory_magazine_try_lock(lock)) {
+        asm volatile ("pause" ::: "memory");
+    }
+}
+
+static inline void memory_magazine_unlock(volatile uint64_t* lock) {
+    asm volatile ("" ::: "memory");
+    *lock = 0;
+}
+
+static inline memory_magazine_slab_t* memory_magazine_slab_of(uint64_t address) {
+    if(address < memory_magazine_pool.data_start) {
+        return NULL;
+    }
+
+    uint64_t slab_idx = (address - memory_magazine_pool.data_start) / MEMORY_MAGAZINE_SLAB_SIZE;
+
+    if(slab_idx >= memory_magazine_pool.slab_count) {
+        return NULL;
+    }
+
+    return &memory_magazine_pool.slabs[slab_idx];
+}
+
+static inline uint64_t memory_magazine_slab_base(memory_magazine_slab_t* slab) {
+    return memory_magazine_pool.data_start + (uint64_t)(slab - memory_magazine_pool.slabs) * MEMORY_MAGAZINE_SLAB_SIZE;
+}
+
+/**
+ * @brief marks object as given to caller or as returned
+ * @details remote frees change bits of slabs owned by other cpus, so bits are changed atomically.
+ * @param[in] slab slab of object
+ * @param[in] obj object address
+ * @param[in] allocated new state
+ * @return previous state
+ */
+static inline boolean_t memory_magazine_mark(memory_magazine_slab_t* slab, void* obj, boolean_t allocated) {
+    uint64_t obj_idx = ((uint64_t)obj - memory_magazine_slab_base(slab)) / slab->object_size;
+    uint64_t mask = 1ULL << (obj_idx % 64);
+    uint64_t old = 0;
+
+    if(allocated) {
+        old = __atomic_fetch_or(&slab->allocated[obj_idx / 64], mask, __ATOMIC_ACQ_REL);
+    } else {
+        old = __atomic_fetch_and(&slab->allocated[obj_idx / 64], ~mask, __ATOMIC_ACQ_REL);
+    }
+
+    return (old & mask) != 0;
+}
+
+static memory_magazine_cpu_t* memory_magazine_get_cpu(void) {
+    uint32_t cpu_id = memory_magazine_pool.cpu_id_getter ? memory_magazine_pool.cpu_id_getter() : 0;
+
+    if(cpu_id >= MEMORY_MAGAZINE_MAX_CPU_COUNT) {
+        return NULL;
+    }
+
+    memory_magazine_cpu_t* cpu = memory_magazine_pool.cpus[cpu_id];
+
+    if(cpu) {
+        return cpu;
+    }
+
+    memory_heap_t* heap = memory_get_default_heap();
+
+    lock_acquire(heap->lock);
+    cpu = heap->malloc(heap, sizeof(memory_magazine_cpu_t), 0x40);
+    lock_release(heap->lock);
+
+    if(!cpu) {
+        return NULL;
+    }
+
+    memory_memclean(cpu, sizeof(memory_magazine_cpu_t));
+    cpu->cpu_id = cpu_id;
+
+    memory_magazine_lock(&memory_magazine_pool.lock);
+
+    if(memory_magazine_pool.cpus[cpu_id]) {
+        // another task of same cpu created it while we are allocating
+        memory_magazine_unlock(&memory_magazine_pool.lock);
+
+        lock_acquire(heap->lock);
+        heap->free(heap, cpu);
+        lock_release(heap->lock);
+
+        return memory_magazine_pool.cpus[cpu_id];
+    }
+
+    memory_magazine_pool.cpus[cpu_id] = cpu;
+
+    memory_magazine_unlock(&memory_magazine_pool.lock);
+
+    return cpu;
+}
+
+static void memory_magazine_partial_insert(memory_magazine_cpu_t* cpu, memory_magazine_slab_t* slab) {
+    slab->previous = NULL;
+    slab->next = cpu->partial_slabs[slab->class_id];
+
+    if(slab->next) {
+        slab->next->previous = slab;
+    }
+
+    cpu->partial_slabs[slab->class_id] = slab;
+}
+
+static void memory_magazine_partial_remove(memory_magazine_cpu_t* cpu, memory_magazine_slab_t* slab) {
+    if(slab->previous) {
+        slab->previous->next = slab->next;
+    } else {
+        cpu->partial_slabs[slab->class_id] = slab->next;
+    }
+
+    if(slab->next) {
+        slab->next->previous = slab->previous;
+    }
+
+    slab->next = NULL;
+    slab->previous = NULL;
+}
+
+static memory_magazine_slab_t* memory_magazine_slab_acquire(memory_magazine_cpu_t* cpu, uint32_t class_id) {
+    memory_magazine_lock(&memory_magazine_pool.lock);
+
+    memory_magazine_slab_t* slab = memory_magazine_pool.free_slabs;
+
+    if(slab) {
+        memory_magazine_pool.free_slabs = slab->next;
+        memory_magazine_pool.free_slab_count--;
+    }
+
+    memory_magazine_unlock(&memory_magazine_pool.lock);
+
+    if(!slab) {
+        return NULL;
+    }
+
+    slab->free_list = NULL;
+    slab->cpu_id = cpu->cpu_id;
+    slab->class_id = class_id;
+    slab->object_size = (class_id + 1) * MEMORY_MAGAZINE_CLASS_SIZE;
+    slab->object_count = MEMORY_MAGAZINE_SLAB_SIZE / slab->object_size;
+    slab->carved_count = 0;
+    slab->free_count = slab->object_count;
+
+    memory_magazine_partial_insert(cpu, slab);
+
+    return slab;
+}
+
+static void memory_magazine_slab_release(memory_magazine_cpu_t* cpu, memory_magazine_slab_t* slab) {
+    memory_magazine_partial_remove(cpu, slab);
+
+    // objects are cleaned at free, only links remain. next owner expects zeroed slab.
+    void* obj = slab->free_list;
+
+    while(obj) {
+        void* next = *(void**)obj;
+        *(void**)obj = NULL;
+        obj = next;
+    }
+
+    slab->free_list = NULL;
+
+    memory_magazine_lock(&memory_magazine_pool.lock);
+
+    slab->next = memory_magazine_pool.free_slabs;
+    memory_magazine_pool.free_slabs = slab;
+    memory_magazine_pool.free_slab_count++;
+
+    memory_magazine_unlock(&memory_magazine_pool.lock);
+}
+
+static void* memory_magazine_slab_get(memory_magazine_cpu_t* cpu, memory_magazine_slab_t* slab) {
+    void* obj = NULL;
+
+    if(slab->free_list) {
+        obj = slab->free_list;
+        slab->free_list = *(void**)obj;
+        *(void**)obj = NULL;
+    } else {
+        obj = (void*)(memory_magazine_slab_base(slab) + (uint64_t)slab->carved_count * slab->object_size);
+        slab->carved_count++;
+    }
+
+    slab->free_count--;
+
+    if(!slab->free_count) {
+        memory_magazine_partial_remove(cpu, slab);
+    }
+
+    return obj;
+}
+
+static void memory_magazine_slab_put(memory_magazine_cpu_t* cpu, memory_magazine_slab_t* slab, void* obj) {
+    *(void**)obj = slab->free_list;
+    slab->free_list = obj;
+    slab->free_count++;
+
+    if(slab->free_count == 1) {
+        memory_magazine_partial_insert(cpu, slab);
+    }
+
+    // keep one empty slab per class for reuse, return others to pool
+    if(slab->free_count == slab->object_count && (cpu->partial_slabs[slab->class_id] != slab || slab->next)) {
+        memory_magazine_slab_release(cpu, slab);
+    }
+}
+
+static void memory_magazine_refill(memory_magazine_cpu_t* cpu, uint32_t class_id) {
+    memory_magazine_t* mag = &cpu->magazines[class_id];
+
+    cpu->refill_count++;
+
+    void* remote = NULL;
+
+    // whole list is taken at once, so remote pushes never see a popped head again
+    if(cpu->remote_frees[class_id]) {
+        remote = __atomic_exchange_n(&cpu->remote_frees[class_id], NULL, __ATOMIC_ACQUIRE);
+    }
+
+    while(remote) {
+        void* next = *(void**)remote;
+
+        if(mag->count < MEMORY_MAGAZINE_CAPACITY) {
+            *(void**)remote = NULL;
+            mag->objects[mag->count++] = remote;
+        } else {
+            memory_magazine_slab_put(cpu, memory_magazine_slab_of((uint64_t)remote), remote);
+        }
+
+        remote = next;
+    }
+
+    while(mag->count < MEMORY_MAGAZINE_BATCH) {
+        memory_magazine_slab_t* slab = cpu->partial_slabs[class_id];
+
+        if(!slab) {
+            slab = memory_magazine_slab_acquire(cpu, class_id);
+
+            if(!slab) {
+                break;
+            }
+        }
+
+        mag->objects[mag->count++] = memory_magazine_slab_get(cpu, slab);
+    }
+}
+
+static void memory_magazine_flush(memory_magazine_cpu_t* cpu, uint32_t class_id, uint64_t keep) {
+    memory_magazine_t* mag = &cpu->magazines[class_id];
+
+    cpu->flush_count++;
+
+    while(mag->count > keep) {
+        void* obj = mag->objects[--mag->count];
+
+        memory_magazine_slab_put(cpu, memory_magazine_slab_of((uint64_t)obj), obj);
+    }
+}
+
+void* memory_magazine_malloc(size_t size, size_t align) {
+    if(!memory_magazine_pool.enabled || !size || size > MEMORY_MAGAZINE_OBJECT_MAX_SIZE || align > MEMORY_MAGAZINE_CLASS_SIZE) {
+        return NULL;
+    }
+
+    memory_magazine_cpu_t* cpu = memory_magazine_get_cpu();
+
+    if(!cpu) {
+        return NULL;
+    }
+
+    // if another task of this cpu is interrupted inside magazine code, caller falls back to heap
+    if(!memory_magazine_try_lock(&cpu->busy)) {
+        return NULL;
+    }
+
+    uint32_t class_id = (size - 1) / MEMORY_MAGAZINE_CLASS_SIZE;
+    memory_magazine_t* mag = &cpu->magazines[class_id];
+
+    if(!mag->count) {
+        memory_magazine_refill(cpu, class_id);
+    }
+
+    void* res = NULL;
+
+    if(mag->count) {
+        res = mag->objects[--mag->count];
+        cpu->hit_count++;
+
+        memory_magazine_mark(memory_magazine_slab_of((uint64_t)res), res, true);
+    }
+
+    memory_magazine_unlock(&cpu->busy);
+
+    return res;
+}
+
+int8_t memory_magazine_free(void* address) {
+    memory_magazine_slab_t* slab = memory_magazine_slab_of((uint64_t)address);
+
+    if(!slab) {
+        return -1;
+    }
+
+    if(((uint64_t)address - memory_magazine_slab_base(slab)) % slab->object_size) {
+        PRINTLOG(HEAP_HASH, LOG_ERROR, "address %p is not an object start at magazine slab", address);
+
+        return 1;
+    }
+
+    // object at a magazine or a free list is cleaned and linked, freeing it again would corrupt them
+    if(!memory_magazine_mark(slab, address, false)) {
+        PRINTLOG(HEAP_HASH, LOG_ERROR, "address %p is not allocated, double free is rejected", address);
+
+        return 1;
+    }
+
+    memory_memclean(address, slab->object_size);
+
+    memory_magazine_cpu_t* cpu = memory_magazine_get_cpu();
+
+    if(cpu && cpu->cpu_id == slab->cpu_id && memory_magazine_try_lock(&cpu->busy)) {
+        memory_magazine_t* mag = &cpu->magazines[slab->class_id];
+
+        if(mag->count == MEMORY_MAGAZINE_CAPACITY) {
+            memory_magazine_flush(cpu, slab->class_id, MEMORY_MAGAZINE_BATCH);
+        }
+
+        mag->objects[mag->count++] = address;
+
+        memory_magazine_unlock(&cpu->busy);
+
+        return 0;
+    }
+
+    // owner drains remote frees at its next refill, lock free push is safe at interrupt handlers too
+    memory_magazine_cpu_t* owner = memory_magazine_pool.cpus[slab->cpu_id];
+
+    void* head = __atomic_load_n(&owner->remote_frees[slab->class_id], __ATOMIC_RELAXED);
+
+    do {
+        *(void**)address = head;
+    } while(!__atomic_compare_exchange_n(&owner->remote_frees[slab->class_id], &head, address, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_fetch_add(&owner->remote_free_count, 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int8_t memory_magazine_enable(uint64_t reserve_size, memory_magazine_cpu_id_getter_f cpu_id_getter) {
+    if(memory_magazine_pool.reserved) {
+        PRINTLOG(HEAP_HASH, LOG_ERROR, "magazines are already enabled");
+
+        return -1;
+    }
+
+    memory_heap_t* heap = memory_get_default_heap();
+    uint64_t slab_count = reserve_size / MEMORY_MAGAZINE_SLAB_SIZE;
+
+    if(!heap || !slab_count) {
+        return -1;
+    }
+
+    uint64_t metadata_size = sizeof(memory_magazine_slab_t) * slab_count;
+    uint64_t total_size = metadata_size + slab_count * MEMORY_MAGAZINE_SLAB_SIZE + 0x40;
+
+    lock_acquire(heap->lock);
+    void* reserved = heap->malloc(heap, total_size, 0);
+    lock_release(heap->lock);
+
+    if(!reserved) {
+        PRINTLOG(HEAP_HASH, LOG_ERROR, "cannot reserve 0x%llx bytes for magazines", total_size);
+
+        return -1;
+    }
+
+    memory_memclean(reserved, total_size);
+
+    memory_magazine_pool.cpu_id_getter = cpu_id_getter;
+    memory_magazine_pool.reserved = reserved;
+    memory_magazine_pool.slabs = reserved;
+    memory_magazine_pool.slab_count = slab_count;
+    memory_magazine_pool.data_start = (uint64_t)reserved + metadata_size;
+
+    if(memory_magazine_pool.data_start % 0x40) {
+        memory_magazine_pool.data_start += 0x40 - (memory_magazine_pool.data_start % 0x40);
+    }
+
+    for(uint64_t i = slab_count; i > 0; i--) {
+        memory_magazine_pool.slabs[i - 1].next = memory_magazine_pool.free_slabs;
+        memory_magazine_pool.free_slabs = &memory_magazine_pool.slabs[i - 1];
+    }
+
+    memory_magazine_pool.free_slab_count = slab_count;
+
+    asm volatile ("" ::: "memory");
+
+    memory_magazine_pool.enabled = true;
+
+    PRINTLOG(HEAP_HASH, LOG_DEBUG, "magazines are enabled with 0x%llx slabs", slab_count);
+
+    return 0;
+}
+
+int8_t memory_magazine_disable(void) {
+    if(!memory_magazine_pool.reserved) {
+        return 0;
+    }
+
+    memory_magazine_pool.enabled = false;
+
+    for(uint64_t i = 0; i < MEMORY_MAGAZINE_MAX_CPU_COUNT; i++) {
+        memory_magazine_cpu_t* cpu = memory_magazine_pool.cpus[i];
+
+        if(!cpu) {
+            continue;
+        }
+
+        for(uint32_t class_id = 0; class_id < MEMORY_MAGAZINE_CLASS_COUNT; class_id++) {
+            memory_magazine_flush(cpu, class_id, 0);
+
+            void* remote = cpu->remote_frees[class_id];
+            cpu->remote_frees[class_id] = NULL;
+
+            while(remote) {
+                void* next = *(void**)remote;
+                memory_magazine_slab_put(cpu, memory_magazine_slab_of((uint64_t)remote), remote);
+                remote = next;
+            }
+
+            // kept empty slab goes back to pool too
+            memory_magazine_slab_t* slab = cpu->partial_slabs[class_id];
+
+            while(slab) {
+                memory_magazine_slab_t* next = slab->next;
+
+                if(slab->free_count == slab->object_count) {
+                    memory_magazine_slab_release(cpu, slab);
+                }
+
+                slab = next;
+            }
+        }
+    }
+
+    if(memory_magazine_pool.free_slab_count != memory_magazine_pool.slab_count) {
+        PRINTLOG(HEAP_HASH, LOG_WARNING, "magazine slabs are in use 0x%llx/0x%llx, keeping reserved area",
+                 memory_magazine_pool.slab_count - memory_magazine_pool.free_slab_count, memory_magazine_pool.slab_count);
+
+        return -1;
+    }
+
+    memory_heap_t* heap = memory_get_default_heap();
+
+    lock_acquire(heap->lock);
+
+    for(uint64_t i = 0; i < MEMORY_MAGAZINE_MAX_CPU_COUNT; i++) {
+        if(memory_magazine_pool.cpus[i]) {
+            heap->free(heap, memory_magazine_pool.cpus[i]);
+        }
+    }
+
+    heap->free(heap, memory_magazine_pool.reserved);
+
+    lock_release(heap->lock);
+
+    memory_memclean(&memory_magazine_pool, sizeof(memory_magazine_pool_t));
+
+    return 0;
+}
+
+void memory_magazine_get_stat(memory_magazine_stat_t* stat) {
+    if(!stat) {
+        return;
+    }
+
+    memory_memclean(stat, sizeof(memory_magazine_stat_t));
+
+    for(uint64_t i = 0; i < MEMORY_MAGAZINE_MAX_CPU_COUNT; i++) {
+        memory_magazine_cpu_t* cpu = memory_magazine_pool.cpus[i];
+
+        if(!cpu) {
+            continue;
+        }
+
+        stat->hit_count += cpu->hit_count;
+        stat->refill_count += cpu->refill_count;
+        stat->flush_count += cpu->flush_count;
+        stat->remote_free_count += cpu->remote_free_count;
+    }
+
+    stat->slab_count = memory_magazine_pool.slab_count;
+    stat->free_slab_count = memory_magazine_pool.free_slab_count;
+}
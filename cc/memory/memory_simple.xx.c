@@ -267,6 +267,84 @@ static inline void memory_simple_insert_sorted(heapmetainfo_t* heap, int8_t tofu
     }
 }
 
+/**
+ * @brief allocates an aligned slot inside an empty slot by splitting it
+ * @param[in] simple_heap heap metadata
+ * @param[in] empty_hi empty slot which has enough area for alignment
+ * @param[in] hi_a header of aligned slot inside empty_hi
+ * @param[in] t_size requested size in heapinfo_t units
+ * @return aligned address
+ *
+ * empty_hi stays at empty list as left part, right part if any is inserted after it.
+ */
+static void* memory_simple_malloc_aligned(heapmetainfo_t* simple_heap, heapinfo_t* empty_hi, heapinfo_t* hi_a, size_t t_size) {
+    heapinfo_t* empty_end = empty_hi + empty_hi->size;
+    heapinfo_t* hi_r = hi_a + 1 + t_size;
+    size_t rem = empty_end - hi_r;
+
+    empty_hi->size = hi_a - empty_hi;
+
+#if ___TESTMODE == 1
+    VALGRIND_MAKE_MEM_DEFINED(hi_a, sizeof(heapinfo_t));
+#endif
+
+    if(rem > 1) { // right part should store at least one item
+#if ___TESTMODE == 1
+        VALGRIND_MAKE_MEM_DEFINED(hi_r, sizeof(heapinfo_t));
+#endif
+
+        hi_r->magic = HEAP_INFO_MAGIC;
+        hi_r->padding = HEAP_INFO_PADDING;
+        hi_r->flags = HEAP_INFO_FLAG_NOTUSED;
+        hi_r->size = rem;
+
+        hi_r->previous = empty_hi;
+        hi_r->next = empty_hi->next;
+
+        if(hi_r->next) {
+#if ___TESTMODE == 1
+            VALGRIND_MAKE_MEM_DEFINED(hi_r->next, sizeof(heapinfo_t));
+#endif
+            hi_r->next->previous = hi_r;
+#if ___TESTMODE == 1
+            VALGRIND_MAKE_MEM_NOACCESS(hi_r->next, sizeof(heapinfo_t));
+#endif
+        }
+
+        empty_hi->next = hi_r;
+
+#if ___TESTMODE == 1
+        VALGRIND_MAKE_MEM_NOACCESS(hi_r, sizeof(heapinfo_t));
+#endif
+
+        simple_heap->free_size -= sizeof(heapinfo_t); // meta of right part occupies free area
+        simple_heap->header_count++;
+    } else { // if we not we should absorb remaining into aligned slot
+        t_size += rem;
+    }
+
+    hi_a->magic = HEAP_INFO_MAGIC;
+    hi_a->padding = HEAP_INFO_PADDING;
+    hi_a->flags = HEAP_INFO_FLAG_USED;
+    hi_a->size = 1 + t_size;
+    hi_a->previous = NULL;
+    hi_a->next = NULL;
+
+    simple_heap->free_size -= hi_a->size * sizeof(heapinfo_t); // meta and data of aligned slot
+    simple_heap->header_count++;
+    simple_heap->malloc_count++;
+
+    PRINTLOG(SIMPLEHEAP, LOG_TRACE, "memory 0x%p allocated with size 0x%llx aligned", hi_a + 1, t_size * sizeof(heapinfo_t));
+
+#if ___TESTMODE == 1
+    VALGRIND_MAKE_MEM_NOACCESS(empty_hi, sizeof(heapinfo_t));
+    VALGRIND_MALLOCLIKE_BLOCK(hi_a + 1, t_size * sizeof(heapinfo_t), sizeof(heapinfo_t), 1);
+    VALGRIND_MAKE_MEM_NOACCESS(hi_a, sizeof(heapinfo_t));
+#endif
+
+    return hi_a + 1;
+}
+
 void* memory_simple_malloc_ext(memory_heap_t* heap, size_t size, size_t align){
     if(heap == NULL) {
         PRINTLOG(SIMPLEHEAP, LOG_ERROR, "heap is NULL");
@@ -283,7 +361,13 @@ void* memory_simple_malloc_ext(memory_heap_t* heap, size_t size, size_t align){
     size_t a_size = size;
     size_t t_size =  (a_size + sizeof(heapinfo_t) - 1) / sizeof(heapinfo_t);
 
-    if(align <= sizeof(heapinfo_t) && (t_size - 1) < 128 && simple_heap->fast_classes[t_size - 1].head != NULL) {
+    // all slots start at heapinfo_t boundary
+    if(align <= sizeof(heapinfo_t)) {
+        align = 0;
+    }
+
+    if( (t_size - 1) < 128 && simple_heap->fast_classes[t_size - 1].head != NULL &&
+        (align == 0 || ((size_t)(simple_heap->fast_classes[t_size - 1].head + 1)) % align == 0)) {
         heapinfo_t* res = simple_heap->fast_classes[t_size - 1].head;
 
 #if ___TESTMODE == 1
@@ -338,14 +422,29 @@ void* memory_simple_malloc_ext(memory_heap_t* heap, size_t size, size_t align){
         return NULL;
     }
 
-    // find first empty and enough slot
+    heapinfo_t* hi_a = NULL;
+
+    // find first empty and enough slot, with alignment slot is divided into left, aligned and right parts
     while(1) { // size enough?
 #if ___TESTMODE == 1
         VALGRIND_MAKE_MEM_DEFINED(empty_hi, sizeof(heapinfo_t));
 #endif
 
         if(align) {
-            if(empty_hi->size == (t_size + 1)) {
+            size_t aligned_addr = (size_t)(empty_hi + 1);
+
+            if(aligned_addr % align) {
+                aligned_addr += align - (aligned_addr % align);
+
+                // left part should be a valid empty slot with header and at least one item
+                while(((heapinfo_t*)aligned_addr - 1) - empty_hi < 2) {
+                    aligned_addr += align;
+                }
+            }
+
+            hi_a = (heapinfo_t*)aligned_addr - 1;
+
+            if(hi_a + 1 + t_size <= empty_hi + empty_hi->size) {
                 break;
             }
         } else {
@@ -363,84 +462,19 @@ void* memory_simple_malloc_ext(memory_heap_t* heap, size_t size, size_t align){
 #endif
 
         if(empty_hi == NULL) {
-            if(align == 0) {
-                memory_heap_stat_t stat;
-                memory_simple_stat(heap, &stat);
-
-                PRINTLOG(SIMPLEHEAP, LOG_ERROR, "heap 0x%p task 0x%llx", heap, heap->task_id);
-                PRINTLOG(SIMPLEHEAP, LOG_ERROR, "memory stat ts 0x%llx fs 0x%llx mc 0x%llx fc 0x%llx diff 0x%llx", stat.total_size, stat.free_size, stat.malloc_count, stat.free_count, stat.malloc_count - stat.free_count);
-                PRINTLOG(SIMPLEHEAP, LOG_ERROR, "no free slot 0x%p 0x%llx 0x%x", empty_hi_t, empty_hi_t->size * sizeof(heapinfo_t), empty_hi_t->flags);
-                return NULL;
-            }
-            break;
-        }
-    }
-
-    if(align) { // if align req, then check it
-        int8_t need_check = 0;
-
-        if(empty_hi == NULL) {
-            need_check = 1;
-        } else {
-            size_t start_addr = (size_t)(empty_hi + 1);
-            if(start_addr % align) {
-                need_check = 1;
-            }
-        }
-
-        if(need_check) { // not aligned let's search again
-
-            empty_hi = simple_heap->first_empty;
-
-            a_size = size + align; // this time at align to the dize
-            t_size =  (a_size + sizeof(heapinfo_t) - 1) / sizeof(heapinfo_t);
-
-            // find first empty and enough slot
-            while(1) { // size enough?
-                if(empty_hi->size >= (t_size + 1)) {
-                    break;
-                }
-
-                empty_hi = empty_hi->next;
-
-                if(empty_hi == NULL) {
-                    PRINTLOG(SIMPLEHEAP, LOG_ERROR, "no free slot for aligned");
-                    return NULL;
-                }
-            }
+            memory_heap_stat_t stat;
+            memory_simple_stat(heap, &stat);
 
-        } else { // we found what we wanted, so send it
-            if(empty_hi->previous) { // if we have previous
-                empty_hi->previous->next = empty_hi->next; // set that's next to the empty_hi' next
-            } else {
-                simple_heap->first_empty = empty_hi->next; // update first_empty because we are removing first_empty
-            }
-
-            if(empty_hi->next) {
-                empty_hi->next->previous = empty_hi->previous;
-            }
-
-            // cleanup pointers and set used
-            empty_hi->previous = NULL;
-            empty_hi->next = NULL;
-            empty_hi->flags |= HEAP_INFO_FLAG_USED;
-
-            // memory_simple_insert_sorted(simple_heap, 1, empty_hi); // add to full slot's list
-            PRINTLOG(SIMPLEHEAP, LOG_TRACE, "memory 0x%p allocated with size 0x%llx", empty_hi + 1, t_size * sizeof(heapinfo_t));
-
-            simple_heap->free_size -= (empty_hi->size - 1) * sizeof(heapinfo_t);
-            simple_heap->malloc_count++;
-
-#if ___TESTMODE == 1
-            VALGRIND_MALLOCLIKE_BLOCK(empty_hi + 1, t_size * sizeof(heapinfo_t), sizeof(heapinfo_t), 1);
-            VALGRIND_MAKE_MEM_NOACCESS(empty_hi, sizeof(heapinfo_t));
-#endif
-
-
-            return empty_hi + 1;
+            PRINTLOG(SIMPLEHEAP, LOG_ERROR, "heap 0x%p task 0x%llx align 0x%llx", heap, heap->task_id, align);
+            PRINTLOG(SIMPLEHEAP, LOG_ERROR, "memory stat ts 0x%llx fs 0x%llx mc 0x%llx fc 0x%llx diff 0x%llx", stat.total_size, stat.free_size, stat.malloc_count, stat.free_count, stat.malloc_count - stat.free_count);
+            PRINTLOG(SIMPLEHEAP, LOG_ERROR, "no free slot 0x%p 0x%llx 0x%x", empty_hi_t, empty_hi_t->size * sizeof(heapinfo_t), empty_hi_t->flags);
+            return NULL;
         }
     }
 
+    if(align && hi_a != empty_hi) {
+        return memory_simple_malloc_aligned(simple_heap, empty_hi, hi_a, t_size);
+    }
 
     size_t rem = empty_hi->size - (t_size + 1);
 
@@ -486,7 +520,7 @@ void* memory_simple_malloc_ext(memory_heap_t* heap, size_t size, size_t align){
         t_size++;
     }
 
-    if (align == 0) { // if we donot need a alignment shortcut malloc remove empty_hi from list and append allocated list
+    { // remove empty_hi from list and append allocated list
 
         if(empty_hi->previous) { // if we have previous
 #if ___TESTMODE == 1
@@ -529,125 +563,6 @@ void* memory_simple_malloc_ext(memory_heap_t* heap, size_t size, size_t align){
 
         return empty_hi + 1;
     }
-
-    // now we have alignment problem empty_hi has enough area for alignment
-    // we should find where to divide it into left real right
-    size_t free_addr = (size_t)(empty_hi + 1);
-    size_t aligned_addr = ((free_addr / align) + 1) * align;
-    size_t hi_aligned_addr = aligned_addr - sizeof(heapinfo_t);
-    int8_t right_exists = 0;
-    size_t hi_a_size = size / sizeof(heapinfo_t);
-    if(size % sizeof(heapinfo_t)) {
-        hi_a_size++;
-    }
-
-
-    heapinfo_t* hi_a = (heapinfo_t*)hi_aligned_addr; // our rel addr
-
-#if ___TESTMODE == 1
-    VALGRIND_MAKE_MEM_DEFINED(hi_a, sizeof(heapinfo_t));
-#endif
-
-    // probable right side: at the end of hi_a
-    heapinfo_t* hi_r = hi_a + hi_a_size + 1;
-
-#if ___TESTMODE == 1
-    VALGRIND_MAKE_MEM_DEFINED(hi_r, sizeof(heapinfo_t));
-#endif
-
-    if(empty_hi + empty_hi->size > hi_r + 1 ) {
-        // we have empty space between hi_r and end of empty_hi, let's divide it
-        hi_r->magic = HEAP_INFO_MAGIC;
-        hi_r->padding = HEAP_INFO_PADDING;
-        hi_r->flags = HEAP_INFO_FLAG_USED;
-        hi_r->size = (uint64_t)(empty_hi + empty_hi->size - hi_r);
-
-        simple_heap->header_count++;
-
-        hi_r->next = empty_hi->next;
-        if(hi_r->next) {
-            hi_r->next->previous = hi_r;
-        }
-
-        simple_heap->free_size -= sizeof(heapinfo_t);
-
-        right_exists = 1; // set flag for setting previous of hi_r after left
-    }
-
-
-    // now let's look left side of hi_a, it is still empty_hi. if can contain at least one item let it go
-    if(hi_a - empty_hi > 1) {
-        // yes we have at least one area
-        empty_hi->size = (uint64_t)(hi_a - empty_hi); // set its size
-
-        if(empty_hi->previous == NULL) {
-            simple_heap->first_empty = empty_hi;
-        }
-
-        if(right_exists) {
-            // set empty_hi's right to hi_r
-            empty_hi->next = hi_r;
-            hi_r->previous = empty_hi;
-        }
-
-        simple_heap->free_size -= sizeof(heapinfo_t);
-    } else {
-        // ok hi_a is a dead area
-        if(right_exists) {
-            // let's link hi_r to empty_hi' previous
-            if(empty_hi->previous) {
-                hi_r->previous = empty_hi->previous;
-                hi_r->previous->next = hi_r;
-            } else { // empty_hi has not any prev so hi_r is first empty!!
-                simple_heap->first_empty = hi_r;
-            }
-
-        } else {
-            // no right not left hence link empty_hi' prev and next
-            if(empty_hi->previous) {
-                empty_hi->previous->next = empty_hi->next;
-                empty_hi->next->previous = empty_hi->previous;
-            } else { // empty_hi has not any prev so next is first empty!!
-                simple_heap->first_empty = empty_hi->next;
-                simple_heap->first_empty->previous = NULL;
-            }
-
-            memory_memclean(empty_hi, sizeof(heapinfo_t)); // cleanup data
-        }
-
-        simple_heap->free_size -= sizeof(heapinfo_t);
-    }
-
-#if ___TESTMODE == 1
-    VALGRIND_MAKE_MEM_NOACCESS(empty_hi, sizeof(heapinfo_t));
-
-    if(right_exists) {
-        VALGRIND_MAKE_MEM_NOACCESS(hi_r, sizeof(heapinfo_t));
-    }
-#endif
-
-    // memory_simple_insert_sorted(simple_heap, 1, hi_a); // add area used
-
-    // fill ha
-    hi_a->magic = HEAP_INFO_MAGIC;
-    hi_a->padding = HEAP_INFO_PADDING;
-    hi_a->size = hi_a_size + 1; // inclusive size
-    hi_a->flags = HEAP_INFO_FLAG_USED;
-
-    simple_heap->header_count++;
-
-    PRINTLOG(SIMPLEHEAP, LOG_TRACE, "memory 0x%llx allocated with size 0x%llx", aligned_addr, hi_a_size * sizeof(heapinfo_t));
-
-    simple_heap->free_size -= ( hi_a->size - 1) * sizeof(heapinfo_t);
-    simple_heap->malloc_count++;
-
-  #if ___TESTMODE == 1
-    VALGRIND_MALLOCLIKE_BLOCK(aligned_addr, hi_a_size * sizeof(heapinfo_t), sizeof(heapinfo_t), 1);
-    VALGRIND_MAKE_MEM_NOACCESS(hi_a, sizeof(heapinfo_t));
-  #endif
-
-    return (uint8_t*)aligned_addr;
-
 }
 
 
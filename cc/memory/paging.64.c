@@ -21,9 +21,133 @@
 MODULE("turnstone.kernel.memory.paging");
 
 hashmap_t* memory_paging_page_tables = NULL;
+boolean_t memory_paging_pcid_enabled = false;
+volatile uint64_t memory_paging_pcid_next = 1;
+memory_paging_tlb_shootdown_f memory_paging_tlb_shootdown_handler = NULL;
+int8_t memory_paging_1g_pages_supported = -1;
 
 uint64_t memory_paging_get_internal_frame(memory_page_table_context_t* table_context);
 
+void memory_paging_set_tlb_shootdown_handler(memory_paging_tlb_shootdown_f handler) {
+    memory_paging_tlb_shootdown_handler = handler;
+}
+
+static uint64_t memory_paging_get_pcid(memory_page_table_context_t* table_context) {
+    if(!memory_paging_pcid_enabled) {
+        return 0;
+    }
+
+    if(table_context->pcid == 0) {
+        uint64_t pcid = __atomic_fetch_add(&memory_paging_pcid_next, 1, __ATOMIC_SEQ_CST);
+
+        if(pcid > MEMORY_PAGING_PCID_MAX) {
+            // out of pcids, table will be flushed at each load
+            return 0;
+        }
+
+        uint64_t expected = 0;
+
+        if(!__atomic_compare_exchange_n(&table_context->pcid, &expected, pcid, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            pcid = expected;
+        }
+
+        return pcid;
+    }
+
+    return table_context->pcid;
+}
+
+uint64_t memory_paging_get_cr3_for_cpu(memory_page_table_context_t* table_context, uint8_t apic_id) {
+    uint64_t cr3 = MEMORY_PAGING_GET_FA_FOR_RESERVED_VA((uint64_t)table_context->page_table);
+
+    bit_set_atomic(&table_context->cpu_mask[apic_id / 64], apic_id % 64);
+
+    uint64_t pcid = memory_paging_get_pcid(table_context);
+
+    if(pcid == 0) {
+        return cr3;
+    }
+
+    cr3 |= pcid;
+
+    if(!bit_clear_atomic(&table_context->flush_mask[apic_id / 64], apic_id % 64)) {
+        cr3 |= MEMORY_PAGING_CR3_NO_FLUSH;
+    }
+
+    return cr3;
+}
+
+void memory_paging_leave_table_for_cpu(memory_page_table_context_t* table_context, uint8_t apic_id) {
+    if(table_context == NULL) {
+        return;
+    }
+
+    bit_clear_atomic(&table_context->cpu_mask[apic_id / 64], apic_id % 64);
+}
+
+void memory_paging_tlb_invalidate_local(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t page_count, uint8_t apic_id) {
+    uint64_t table_fa = MEMORY_PAGING_GET_FA_FOR_RESERVED_VA((uint64_t)table_context->page_table);
+
+    uint64_t cr3;
+    __asm__ __volatile__ ("mov %%cr3, %0\n" : "=r" (cr3));
+
+    if((cr3 & ~0xFFFULL) != table_fa) {
+        // entries of another pcid cannot be invalidated with invlpg, flush them at next load
+        if(memory_paging_pcid_enabled) {
+            bit_set_atomic(&table_context->flush_mask[apic_id / 64], apic_id % 64);
+        }
+
+        return;
+    }
+
+    if(page_count == 0 || page_count > MEMORY_PAGING_TLB_INVALIDATE_MAX_PAGE_COUNT) {
+        cpu_tlb_flush();
+
+        return;
+    }
+
+    virtual_address &= ~(MEMORY_PAGING_PAGE_LENGTH_4K - 1);
+
+    for(uint64_t i = 0; i < page_count; i++) {
+        cpu_tlb_invalidate((void*)(virtual_address + i * MEMORY_PAGING_PAGE_LENGTH_4K));
+    }
+}
+
+static void memory_paging_tlb_shootdown(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t page_count) {
+    if(memory_paging_tlb_shootdown_handler != NULL &&
+       memory_paging_tlb_shootdown_handler(table_context, virtual_address, page_count) == 0) {
+        return;
+    }
+
+    // apic id is unknown without shootdown service, flush mask is overwritten below
+    memory_paging_tlb_invalidate_local(table_context, virtual_address, page_count, 0);
+
+    // without shootdown service every other cpu should flush the table at its next load, cpus which left it too
+    for(uint64_t i = 0; i < MEMORY_PAGING_CPU_MASK_SIZE; i++) {
+        table_context->flush_mask[i] = -1ULL;
+    }
+}
+
+#if ___KERNELBUILD == 1
+int8_t memory_paging_enable_pcid(void) {
+    if(cpu_check_pcid() != 0) {
+        PRINTLOG(PAGING, LOG_INFO, "pcid is not supported");
+
+        return -1;
+    }
+
+    cpu_reg_cr4_t cr4 = cpu_read_cr4();
+    cr4.fields.process_context_identifier_enable = 1;
+    cpu_write_cr4(cr4);
+
+    memory_paging_pcid_enabled = true;
+
+    PRINTLOG(PAGING, LOG_INFO, "pcid enabled");
+
+    return 0;
+}
+#endif
+
 static void memory_paging_internal_frame_build(memory_page_table_context_t* table_context) {
     frame_t* internal_frms;
 
@@ -118,6 +242,9 @@ memory_page_table_context_t* memory_paging_switch_table(const memory_page_table_
     __asm__ __volatile__ ("mov %%cr3, %0\n"
                           : "=r" (old_table));
 
+    // low bits are pcid when pcid is enabled
+    old_table &= ~0xFFFULL;
+
     if(new_table != NULL) {
         __asm__ __volatile__ ("mov %0, %%cr3\n" : : "r" (MEMORY_PAGING_GET_FA_FOR_RESERVED_VA(new_table->page_table)));
     }
@@ -163,6 +290,82 @@ memory_page_table_context_t* memory_paging_switch_table(const memory_page_table_
     return old_table_context;
 }
 
+/**
+ * @brief finds leaf entry of virtual address
+ * @param[in] table_context page table context
+ * @param[in] virtual_address virtual address
+ * @param[out] page_length length of leaf page, or length of unmapped area at level where walk stopped
+ * @return leaf entry, NULL if virtual address is not mapped
+ */
+static memory_page_entry_t* memory_paging_get_leaf_entry(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t* page_length) {
+    memory_page_table_t* t_p = table_context->page_table;
+    uint64_t length = 1ULL << 39;
+
+    for(uint8_t level = 4; level > 0; level--) {
+        size_t idx = (virtual_address >> (12 + 9 * (level - 1))) & 0x1FF;
+        memory_page_entry_t* entry = &t_p->pages[idx];
+
+        if(entry->present == 0) {
+            *page_length = length;
+
+            return NULL;
+        }
+
+        if(level == 1 || (level < 4 && entry->hugepage == 1)) {
+            *page_length = length;
+
+            return entry;
+        }
+
+        t_p = (memory_page_table_t*)((uint64_t)(entry->physical_address << 12));
+        t_p = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(t_p);
+
+        length >>= 9;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief splits huge page into 512 pages of lower level with same attributes
+ * @param[in] table_context page table context
+ * @param[in] entry huge page entry
+ * @param[in] page_length length of huge page, 1G or 2M
+ *
+ * translations are not changed, so tlb entries of huge page stay valid until caller invalidates them.
+ */
+static void memory_paging_split_page(memory_page_table_context_t* table_context, memory_page_entry_t* entry, uint64_t page_length) {
+    uint64_t table_fa = memory_paging_get_internal_frame(table_context);
+    memory_page_table_t* t_p = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA((memory_page_table_t*)table_fa);
+
+    memory_page_entry_t sub_entry = *entry;
+    uint64_t step = 1;
+
+    sub_entry.accessed = 0;
+    sub_entry.dirty = 0;
+
+    if(page_length == MEMORY_PAGING_PAGE_LENGTH_1G) {
+        step = MEMORY_PAGING_PAGE_LENGTH_2M / FRAME_SIZE;
+    } else {
+        // bit 7 is pat at 4k entries
+        sub_entry.hugepage = 0;
+    }
+
+    for(uint64_t i = 0; i < MEMORY_PAGING_INDEX_COUNT; i++) {
+        t_p->pages[i] = sub_entry;
+        t_p->pages[i].physical_address = entry->physical_address + i * step;
+    }
+
+    memory_page_entry_t table_entry = {0};
+
+    table_entry.present = 1;
+    table_entry.writable = 1;
+    table_entry.user_accessible = entry->user_accessible;
+    table_entry.physical_address = table_fa >> 12;
+
+    *entry = table_entry;
+}
+
 int8_t memory_paging_add_page_ext(memory_page_table_context_t* table_context,
                                   uint64_t virtual_address, uint64_t frame_address,
                                   memory_paging_page_type_t type) {
@@ -260,6 +463,10 @@ int8_t memory_paging_add_page_ext(memory_page_table_context_t* table_context,
             return 0;
         }
 
+        if(t_p3->pages[p3idx].hugepage == 1) {
+            memory_paging_split_page(table_context, &t_p3->pages[p3idx], MEMORY_PAGING_PAGE_LENGTH_1G);
+        }
+
         uint64_t tmp_pa = t_p3->pages[p3idx].physical_address;
         t_p2 = (memory_page_table_t*)(tmp_pa << 12);
         t_p2 = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(t_p2);
@@ -318,6 +525,10 @@ int8_t memory_paging_add_page_ext(memory_page_table_context_t* table_context,
             return 0;
         }
 
+        if(t_p2->pages[p2idx].hugepage == 1) {
+            memory_paging_split_page(table_context, &t_p2->pages[p2idx], MEMORY_PAGING_PAGE_LENGTH_2M);
+        }
+
         uint64_t tmp_pa = t_p2->pages[p2idx].physical_address;
         t_p1 = (memory_page_table_t*)(tmp_pa << 12);
         t_p1 = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(t_p1);
@@ -579,9 +790,6 @@ int8_t memory_paging_clear_page_ext(memory_page_table_context_t* table_context,
             if(type & MEMORY_PAGING_CLEAR_TYPE_ACCESSED) {
                 t_p3->pages[p3_idx].accessed = 0;
             }
-
-            cpu_tlb_invalidate(t_p3);
-
         } else {
             t_p2 = (memory_page_table_t*)((uint64_t)(t_p3->pages[p3_idx].physical_address << 12));
             t_p2 = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(t_p2);
@@ -605,10 +813,6 @@ int8_t memory_paging_clear_page_ext(memory_page_table_context_t* table_context,
                 if(type & MEMORY_PAGING_CLEAR_TYPE_ACCESSED) {
                     t_p2->pages[p2_idx].accessed = 0;
                 }
-
-                cpu_tlb_invalidate(t_p2);
-
-
             } else {
                 t_p1 = (memory_page_table_t*)((uint64_t)(t_p2->pages[p2_idx].physical_address << 12));
                 t_p1 = MEMORY_PAGING_GET_VA_FOR_RESERVED_FA(t_p1);
@@ -630,14 +834,12 @@ int8_t memory_paging_clear_page_ext(memory_page_table_context_t* table_context,
                 if(type & MEMORY_PAGING_CLEAR_TYPE_ACCESSED) {
                     t_p1->pages[p1_idx].accessed = 0;
                 }
-
-                cpu_tlb_invalidate(t_p1);
-
-
             }
         }
     }
 
+    memory_paging_tlb_shootdown(table_context, virtual_address, 1);
+
     return 0;
 }
 
@@ -690,10 +892,6 @@ int8_t memory_paging_toggle_attributes_ext(memory_page_table_context_t* table_co
             if(type & MEMORY_PAGING_PAGE_TYPE_USER_ACCESSIBLE) {
                 t_p3->pages[p3_idx].user_accessible = ~t_p3->pages[p3_idx].user_accessible;
             }
-
-            cpu_tlb_invalidate(t_p3);
-            cpu_tlb_invalidate((void*)virtual_address);
-
         } else {
             if(type & MEMORY_PAGING_PAGE_TYPE_USER_ACCESSIBLE) {
                 t_p3->pages[p3_idx].user_accessible = ~t_p3->pages[p3_idx].user_accessible;
@@ -725,11 +923,6 @@ int8_t memory_paging_toggle_attributes_ext(memory_page_table_context_t* table_co
                 if(type & MEMORY_PAGING_PAGE_TYPE_USER_ACCESSIBLE) {
                     t_p2->pages[p2_idx].user_accessible = ~t_p2->pages[p2_idx].user_accessible;
                 }
-
-                cpu_tlb_invalidate(t_p2);
-                cpu_tlb_invalidate((void*)virtual_address);
-
-
             } else {
                 if(type & MEMORY_PAGING_PAGE_TYPE_USER_ACCESSIBLE) {
                     t_p2->pages[p2_idx].user_accessible = ~t_p2->pages[p2_idx].user_accessible;
@@ -759,15 +952,12 @@ int8_t memory_paging_toggle_attributes_ext(memory_page_table_context_t* table_co
                 if(type & MEMORY_PAGING_PAGE_TYPE_USER_ACCESSIBLE) {
                     t_p1->pages[p1_idx].user_accessible = ~t_p1->pages[p1_idx].user_accessible;
                 }
-
-                cpu_tlb_invalidate(t_p1);
-                cpu_tlb_invalidate((void*)virtual_address);
-
-
             }
         }
     }
 
+    memory_paging_tlb_shootdown(table_context, virtual_address, 1);
+
     return 0;
 }
 
@@ -808,9 +998,6 @@ int8_t memory_paging_set_user_accessible_ext(memory_page_table_context_t* table_
     } else {
         if(t_p3->pages[p3_idx].hugepage == 1) {
             t_p3->pages[p3_idx].user_accessible = 1;
-
-            cpu_tlb_invalidate(t_p3);
-
         } else {
             t_p3->pages[p3_idx].user_accessible = 1;
 
@@ -829,9 +1016,6 @@ int8_t memory_paging_set_user_accessible_ext(memory_page_table_context_t* table_
 
             if(t_p2->pages[p2_idx].hugepage == 1) {
                 t_p2->pages[p2_idx].user_accessible = 1;
-
-                cpu_tlb_invalidate(t_p2);
-
             } else {
                 t_p2->pages[p2_idx].user_accessible = 1;
 
@@ -849,26 +1033,18 @@ int8_t memory_paging_set_user_accessible_ext(memory_page_table_context_t* table_
                 }
 
                 t_p1->pages[p1_idx].user_accessible = 1;
-
-
-                cpu_tlb_invalidate(t_p1);
-
-
             }
         }
     }
 
+    memory_paging_tlb_shootdown(table_context, virtual_address, 1);
+
     return 0;
 }
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-int8_t memory_paging_delete_page_ext_with_heap(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t* frame_address){
-
-    if(table_context == NULL) {
-        table_context = memory_paging_switch_table(NULL);
-    }
-
+static int8_t memory_paging_delete_page_internal(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t* frame_address, uint64_t* page_length){
     memory_page_table_t* p4 = table_context->page_table;
 
     memory_page_table_t* t_p3;
@@ -904,6 +1080,10 @@ int8_t memory_paging_delete_page_ext_with_heap(memory_page_table_context_t* tabl
                 *frame_address = t_p3->pages[p3_idx].physical_address << 12;
             }
 
+            if(page_length) {
+                *page_length = MEMORY_PAGING_PAGE_LENGTH_1G;
+            }
+
             memory_memclean(&t_p3->pages[p3_idx], sizeof(memory_page_entry_t));
         } else {
             t_p2 = (memory_page_table_t*)((uint64_t)(t_p3->pages[p3_idx].physical_address << 12));
@@ -924,6 +1104,10 @@ int8_t memory_paging_delete_page_ext_with_heap(memory_page_table_context_t* tabl
                     *frame_address = t_p2->pages[p2_idx].physical_address << 12;
                 }
 
+                if(page_length) {
+                    *page_length = MEMORY_PAGING_PAGE_LENGTH_2M;
+                }
+
                 memory_memclean(&t_p2->pages[p2_idx], sizeof(memory_page_entry_t));
             } else {
                 t_p1 = (memory_page_table_t*)((uint64_t)(t_p2->pages[p2_idx].physical_address << 12));
@@ -943,6 +1127,10 @@ int8_t memory_paging_delete_page_ext_with_heap(memory_page_table_context_t* tabl
                     *frame_address = t_p1->pages[p1_idx].physical_address << 12;
                 }
 
+                if(page_length) {
+                    *page_length = MEMORY_PAGING_PAGE_LENGTH_4K;
+                }
+
                 memory_memclean(&t_p1->pages[p1_idx], sizeof(memory_page_entry_t));
 
                 for(size_t i = 0; i < MEMORY_PAGING_INDEX_COUNT; i++) {
@@ -996,6 +1184,20 @@ int8_t memory_paging_delete_page_ext_with_heap(memory_page_table_context_t* tabl
 
     return 0;
 }
+
+int8_t memory_paging_delete_page_ext_with_heap(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t* frame_address){
+    if(table_context == NULL) {
+        table_context = memory_paging_switch_table(NULL);
+    }
+
+    if(memory_paging_delete_page_internal(table_context, virtual_address, frame_address, NULL) != 0) {
+        return -1;
+    }
+
+    memory_paging_tlb_shootdown(table_context, virtual_address, 1);
+
+    return 0;
+}
 #pragma GCC diagnostic pop
 
 int8_t memory_paging_get_physical_address_ext(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t* physical_address){
@@ -1032,10 +1234,7 @@ int8_t memory_paging_get_physical_address_ext(memory_page_table_context_t* table
         return -1;
     } else {
         if(t_p3->pages[p3_idx].hugepage == 1) {
-            size_t p1_idx = MEMORY_PT_GET_P1_INDEX(virtual_address);
-            size_t p2_idx = MEMORY_PT_GET_P2_INDEX(virtual_address);
-
-            *physical_address = (t_p3->pages[p3_idx].physical_address | (p2_idx << 12) | p1_idx) << 12 | (virtual_address & ((1ULL << 30) - 1));
+            *physical_address = (t_p3->pages[p3_idx].physical_address << 12) | (virtual_address & ((1ULL << 30) - 1));
 
         } else {
             t_p2 = (memory_page_table_t*)((uint64_t)(t_p3->pages[p3_idx].physical_address << 12));
@@ -1078,32 +1277,54 @@ int8_t memory_paging_get_physical_address_ext(memory_page_table_context_t* table
     return 0;
 }
 
+static boolean_t memory_paging_is_1g_pages_supported(void) {
+    if(memory_paging_1g_pages_supported == -1) {
+        memory_paging_1g_pages_supported = cpu_check_1g_pages() == 0;
+    }
+
+    return memory_paging_1g_pages_supported == 1;
+}
+
 int8_t memory_paging_add_va_for_frame_ext(memory_page_table_context_t* table_context, uint64_t va_start, frame_t* frm, memory_paging_page_type_t type){
     if(frm == NULL) {
         return -1;
     }
 
+    if(table_context == NULL) {
+        table_context = memory_paging_switch_table(NULL);
+    }
+
     uint64_t frm_addr = frm->frame_address;
     uint64_t frm_cnt = frm->frame_count;
+    boolean_t use_1g = memory_paging_is_1g_pages_supported();
 
+    // aligned runs are promoted to huge pages if their area is not mapped partially with smaller pages
     while(frm_cnt) {
-        if(frm_cnt >= 0x200 && (frm_addr % MEMORY_PAGING_PAGE_LENGTH_2M) == 0 && (va_start % MEMORY_PAGING_PAGE_LENGTH_2M) == 0) {
-            if(memory_paging_add_page_with_p4(table_context, va_start, frm_addr, type | MEMORY_PAGING_PAGE_TYPE_2M) != 0) {
-                return -1;
-            }
-
-            frm_cnt -= 0x200;
-            frm_addr += MEMORY_PAGING_PAGE_LENGTH_2M;
-            va_start += MEMORY_PAGING_PAGE_LENGTH_2M;
-        } else {
-            if(memory_paging_add_page_with_p4(table_context, va_start, frm_addr, type | MEMORY_PAGING_PAGE_TYPE_4K) != 0) {
-                return -1;
+        uint64_t page_length = MEMORY_PAGING_PAGE_LENGTH_4K;
+        memory_paging_page_type_t page_type = MEMORY_PAGING_PAGE_TYPE_4K;
+        uint64_t unmapped_length = 0;
+
+        if(frm_cnt >= MEMORY_PAGING_PAGE_LENGTH_2M / FRAME_SIZE &&
+           (frm_addr % MEMORY_PAGING_PAGE_LENGTH_2M) == 0 && (va_start % MEMORY_PAGING_PAGE_LENGTH_2M) == 0 &&
+           memory_paging_get_leaf_entry(table_context, va_start, &unmapped_length) == NULL) {
+            if(use_1g && unmapped_length >= MEMORY_PAGING_PAGE_LENGTH_1G &&
+               frm_cnt >= MEMORY_PAGING_PAGE_LENGTH_1G / FRAME_SIZE &&
+               (frm_addr % MEMORY_PAGING_PAGE_LENGTH_1G) == 0 && (va_start % MEMORY_PAGING_PAGE_LENGTH_1G) == 0) {
+                page_length = MEMORY_PAGING_PAGE_LENGTH_1G;
+                page_type = MEMORY_PAGING_PAGE_TYPE_1G;
+            } else if(unmapped_length >= MEMORY_PAGING_PAGE_LENGTH_2M) {
+                page_length = MEMORY_PAGING_PAGE_LENGTH_2M;
+                page_type = MEMORY_PAGING_PAGE_TYPE_2M;
             }
+        }
 
-            frm_cnt--;
-            frm_addr += MEMORY_PAGING_PAGE_LENGTH_4K;
-            va_start += MEMORY_PAGING_PAGE_LENGTH_4K;
+        if(memory_paging_add_page_with_p4(table_context, va_start, frm_addr, type | page_type) != 0) {
+            return -1;
         }
+
+        frm_cnt -= page_length / FRAME_SIZE;
+        frm_addr += page_length;
+        va_start += page_length;
     }
 
     return 0;
@@ -1114,28 +1335,41 @@ int8_t memory_paging_delete_va_for_frame_ext(memory_page_table_context_t* table_
         return -1;
     }
 
-    uint64_t frm_addr = frm->frame_address;
-    uint64_t frm_cnt = frm->frame_count;
+    if(table_context == NULL) {
+        table_context = memory_paging_switch_table(NULL);
+    }
 
-    while(frm_cnt) {
-        if(frm_cnt >= 0x200 && (frm_addr % MEMORY_PAGING_PAGE_LENGTH_2M) == 0 && (va_start % MEMORY_PAGING_PAGE_LENGTH_2M) == 0) {
-            if(memory_paging_delete_page_ext(table_context, va_start, NULL) != 0) {
-                return -1;
-            }
+    uint64_t va = va_start;
+    uint64_t va_end = va_start + frm->frame_count * FRAME_SIZE;
+    int8_t res = 0;
 
-            frm_cnt -= 0x200;
-            frm_addr += MEMORY_PAGING_PAGE_LENGTH_2M;
-            va_start += MEMORY_PAGING_PAGE_LENGTH_2M;
-        } else {
-            if(memory_paging_delete_page_ext(table_context, va_start, NULL) != 0) {
-                return -1;
-            }
+    // steps with length of deleted page, range may be mapped with 4k pages even if it is 2m aligned
+    while(va < va_end) {
+        uint64_t page_length = MEMORY_PAGING_PAGE_LENGTH_4K;
+        memory_page_entry_t* entry = memory_paging_get_leaf_entry(table_context, va, &page_length);
+
+        // huge pages partially inside range are demoted, rest of them stays mapped
+        if(entry && page_length > MEMORY_PAGING_PAGE_LENGTH_4K && ((va % page_length) || va + page_length > va_end)) {
+            memory_paging_split_page(table_context, entry, page_length);
+
+            continue;
+        }
+
+        page_length = MEMORY_PAGING_PAGE_LENGTH_4K;
+
+        if(memory_paging_delete_page_internal(table_context, va, NULL, &page_length) != 0) {
+            res = -1;
 
-            frm_cnt--;
-            frm_addr += MEMORY_PAGING_PAGE_LENGTH_4K;
-            va_start += MEMORY_PAGING_PAGE_LENGTH_4K;
+            break;
         }
+
+        va += page_length;
     }
 
-    return 0;
+    // one shootdown for whole deleted range
+    if(va != va_start) {
+        memory_paging_tlb_shootdown(table_context, va_start, (va - va_start) / MEMORY_PAGING_PAGE_LENGTH_4K);
+    }
+
+    return res;
 }
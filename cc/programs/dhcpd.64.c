@@ -92,7 +92,7 @@ int32_t network_dhcpv4_send_discover(uint64_t args_cnt, void** args) {
         }
 
 
-        network_udpv4_header_t* udp = network_udpv4_create_packet_from_data(NETWORK_DHCPV4_SOURCE_PORT, NETWORK_DHCPV4_DESTINATION_PORT, return_packet_len, (uint8_t*)dhcp_packet);
+        network_buffer_t* udp = network_udpv4_create_packet_from_data(NETWORK_DHCPV4_SOURCE_PORT, NETWORK_DHCPV4_DESTINATION_PORT, return_packet_len, (uint8_t*)dhcp_packet);
 
         memory_free(dhcp_packet);
 
@@ -110,62 +110,31 @@ int32_t network_dhcpv4_send_discover(uint64_t args_cnt, void** args) {
             continue;
         }
 
-        network_transmit_packet_t* t_ip = (network_transmit_packet_t*)list_queue_pop(l_ip);
+        network_buffer_t* ip = (network_buffer_t*)list_queue_pop(l_ip);
 
-        if(t_ip == NULL) {
+        list_destroy_with_type(l_ip, LIST_DESTROY_WITH_DATA, network_buffer_destroyer);
+
+        if(ip == NULL) {
             PRINTLOG(NETWORK, LOG_ERROR, "ip packet is null, re trying...");
 
             continue;
         }
 
-        network_ipv4_header_t* ip = (network_ipv4_header_t*)t_ip->packet_data;
-
-        memory_free(t_ip);
-
-        uint16_t tl = BYTE_SWAP16(ip->total_length);
-
-        uint8_t* eth = (uint8_t*)network_ethernet_create_packet(BROADCAST_MAC, mac, NETWORK_PROTOCOL_IPV4, tl, (uint8_t*)ip);
-
-        if(eth == NULL) {
+        if(network_ethernet_push_header(ip, BROADCAST_MAC, mac, NETWORK_ETHERNET_TYPE_IPV4) != 0) {
             PRINTLOG(NETWORK, LOG_ERROR, "eth packet is null, re trying...");
+            network_buffer_release(ip);
 
             continue;
         }
 
-        network_transmit_packet_t* res = memory_malloc_ext(list_get_heap(ni->return_queue), sizeof(network_transmit_packet_t), 0);
-
-        if(res == NULL) {
-            PRINTLOG(NETWORK, LOG_ERROR, "network transmit packet is null, re trying...");
-
-            memory_free(eth);
-
-            continue;
-        }
-
-        res->packet_len = sizeof(network_ethernet_t) + tl;
-
-        uint8_t* packet_data = memory_malloc_ext(list_get_heap(ni->return_queue), res->packet_len, 0);
-
-        if(packet_data == NULL) {
-            PRINTLOG(NETWORK, LOG_ERROR, "packet data allocation failed, re trying...");
-
-            memory_free(eth);
-            memory_free_ext(list_get_heap(ni->return_queue), res);
-
-            continue;
-        }
-
-        memory_memcopy(eth, packet_data, res->packet_len);
-
-        memory_free(eth);
-
-        res->packet_data = packet_data;
-
         ni->is_ipv4_address_requested = true;
 
         PRINTLOG(NETWORK, LOG_TRACE, "dhcp packet sending...");
 
-        list_queue_push(ni->return_queue, res);
+        if(list_queue_push(ni->return_queue, ip) == -1ULL) {
+            PRINTLOG(NETWORK, LOG_ERROR, "cannot queue dhcp packet, re trying...");
+            network_buffer_release(ip);
+        }
     }
 
     return 0;
@@ -318,6 +318,10 @@ int8_t kmain64(size_t entry_point) {
 
     PRINTLOG(KERNEL, LOG_DEBUG, "acpi is initialized");
 
+    if(memory_paging_enable_pcid() != 0) {
+        PRINTLOG(KERNEL, LOG_INFO, "task switches will flush tlb");
+    }
+
     PRINTLOG(KERNEL, LOG_DEBUG, "tasking is initializing");
 
     syscall_init();
@@ -348,6 +352,19 @@ int8_t kmain64(size_t entry_point) {
         cpu_hlt();
     }
 
+    memory_heap_stat_t heap_stat = {0};
+    memory_get_heap_stat_ext(heap, &heap_stat);
+
+    // small allocations of all cpus are served by per cpu magazines without default heap lock
+    if(memory_magazine_enable(heap_stat.total_size / 16, apic_get_local_apic_id) != 0) {
+        PRINTLOG(KERNEL, LOG_WARNING, "cannot enable memory magazines, default heap lock will be used");
+    }
+
+    // single frame allocations and releases are served by per cpu caches without frame allocator lock
+    if(frame_allocator_enable_cpu_cache(frame_get_allocator(), apic_get_local_apic_id) != 0) {
+        PRINTLOG(KERNEL, LOG_WARNING, "cannot enable frame allocator cpu caches");
+    }
+
     PRINTLOG(KERNEL, LOG_INFO, "Initializing usb");
     if(usb_init() != 0) {
         PRINTLOG(KERNEL, LOG_FATAL, "cannot init usb. Halting...");
@@ -35,17 +35,6 @@ uint64_t network_info_mke(const void* key) {
     return x;
 }
 
-int8_t network_transmit_packet_destroyer(memory_heap_t* heap, void* data) {
-    UNUSED(heap);
-
-    network_transmit_packet_t* t_pckt = data;
-
-    memory_free(t_pckt->packet_data);
-    memory_free(t_pckt);
-
-    return 0;
-}
-
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
 static int8_t network_set_return_queue(const network_mac_address_t* mac, list_t* return_queue) {
@@ -69,38 +58,10 @@ static int8_t network_set_return_queue(const network_mac_address_t* mac, list_t*
     return 0;
 }
 
-static int8_t network_send_packet_to_nic(network_transmit_packet_t* orginal_packet, list_t* return_queue) {
-    network_transmit_packet_t* tx_packet = memory_malloc_ext(list_get_heap(return_queue), sizeof(network_transmit_packet_t), 0);
-
-    if(tx_packet == NULL) {
-        network_transmit_packet_destroyer(NULL, orginal_packet);
-
-        task_yield();
-
-        return -1;
-    }
-
-    uint8_t* tx_packet_data = memory_malloc_ext(list_get_heap(return_queue), orginal_packet->packet_len, 0);
-
-    if(tx_packet_data == NULL) {
-        network_transmit_packet_destroyer(NULL, orginal_packet);
-        memory_free_ext(list_get_heap(return_queue), tx_packet);
-
-        task_yield();
-
-        return -1;
-    }
-
-    memory_memcopy(orginal_packet->packet_data, tx_packet_data, orginal_packet->packet_len);
-
-    tx_packet->packet_len = orginal_packet->packet_len;
-    tx_packet->packet_data = tx_packet_data;
-
-    network_transmit_packet_destroyer(NULL, orginal_packet);
-
-    if(list_queue_push(return_queue, tx_packet) == -1ULL) {
-        memory_free_ext(list_get_heap(return_queue), tx_packet_data);
-        memory_free_ext(list_get_heap(return_queue), tx_packet);
+static int8_t network_send_packet_to_nic(network_buffer_t* tx_buffer, list_t* return_queue) {
+    // buffer itself is handed to nic, only queue item is allocated at queue heap
+    if(list_queue_push(return_queue, tx_buffer) == -1ULL) {
+        network_buffer_release(tx_buffer);
 
         task_yield();
 
@@ -129,7 +90,7 @@ int8_t network_process_rx(void){
             const network_received_packet_t* packet = list_queue_pop(network_received_packets);
 
             if(packet) {
-                PRINTLOG(NETWORK, LOG_TRACE, "network packet received with length 0x%llx", packet->packet_len);
+                PRINTLOG(NETWORK, LOG_TRACE, "network packet received with length 0x%x", packet->buffer->length);
 
                 list_t* return_list = NULL;
 
@@ -137,32 +98,32 @@ int8_t network_process_rx(void){
 
                     network_set_return_queue(packet->network_info, packet->return_queue);
 
-                    return_list = network_ethernet_process_packet((network_ethernet_t*)packet->packet_data, packet->network_info);
+                    return_list = network_ethernet_process_packet(packet->buffer, packet->network_info);
                 }
 
                 list_t* return_queue = packet->return_queue;
 
-                memory_free(packet->packet_data);
+                network_buffer_release(packet->buffer);
                 memory_free((void*)packet);
 
                 if(return_list) {
                     if(return_queue) {
                         while(list_size(return_list)) {
-                            network_transmit_packet_t* tx_packet = (network_transmit_packet_t*)list_queue_pop(return_list);
+                            network_buffer_t* tx_buffer = (network_buffer_t*)list_queue_pop(return_list);
 
-                            if(tx_packet) {
-                                if(network_send_packet_to_nic(tx_packet, return_queue) == -1) {
+                            if(tx_buffer) {
+                                if(network_send_packet_to_nic(tx_buffer, return_queue) == -1) {
                                     break;
                                 }
                             }
                         }
 
-                        list_destroy_with_type(return_list, LIST_DESTROY_WITH_DATA, &network_transmit_packet_destroyer);
+                        list_destroy_with_type(return_list, LIST_DESTROY_WITH_DATA, &network_buffer_destroyer);
 
                     } else {
                         PRINTLOG(NETWORK, LOG_TRACE, "there is no return queue");
 
-                        list_destroy_with_type(return_list, LIST_DESTROY_WITH_DATA, &network_transmit_packet_destroyer);
+                        list_destroy_with_type(return_list, LIST_DESTROY_WITH_DATA, &network_buffer_destroyer);
                     }
 
                 } else {
@@ -186,6 +147,12 @@ int8_t network_init(void) {
 
     network_info_map = map_new(&network_info_mke);
 
+    if(network_buffer_pool_init() != 0) {
+        PRINTLOG(NETWORK, LOG_ERROR, "cannot initialize network buffer pool");
+
+        return -1;
+    }
+
     iterator_t* iter = list_iterator_create(pci_get_context()->network_controllers);
 
     while(iter->end_of_iterator(iter) != 0) {
@@ -543,6 +543,7 @@ int32_t tosdb_manager_main(int32_t argc, char_t** argv) {
     cc.index_data_size = 4 << 20;
     cc.secondary_index_data_size = 4 << 20;
     cc.valuelog_size = 16 << 20;
+    cc.block_size = 8 << 20;
 
     if(!tosdb_cache_config_set(tdb, &cc)) {
         PRINTLOG(TOSDB, LOG_ERROR, "Failed to set cache config");
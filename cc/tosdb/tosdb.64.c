@@ -10,6 +10,7 @@
 #include <tosdb/tosdb_internal.h>
 #include <tosdb/tosdb_backend.h>
 #include <tosdb/tosdb_cache.h>
+#include <tosdb/wal.h>
 #include <buffer.h>
 #include <cpu/sync.h>
 #include <logging.h>
@@ -134,6 +135,9 @@ tosdb_t* tosdb_new(tosdb_backend_t* backend, compression_type_t compression_type
 
     res->backend = backend;
     res->superblock = main_sb;
+    res->compaction_config.level1_trigger_count = TOSDB_COMPACTION_DEFAULT_LEVEL1_TRIGGER_COUNT;
+    res->compaction_config.level1_stall_count = TOSDB_COMPACTION_DEFAULT_LEVEL1_STALL_COUNT;
+    res->compaction_config.level_trigger_count = TOSDB_COMPACTION_DEFAULT_LEVEL_TRIGGER_COUNT;
 
     if(main_sb->compression_type == COMPRESSION_TYPE_NONE) {
         res->compression = compression_get(compression_type_if_not_exists);
@@ -166,6 +170,27 @@ tosdb_t* tosdb_new(tosdb_backend_t* backend, compression_type_t compression_type
     }
 
     res->lock = lock_create();
+    res->block_lock = lock_create();
+
+    res->wal = tosdb_wal_new(res);
+
+    if(!res->wal) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create wal");
+        tosdb_free(res);
+
+        return NULL;
+    }
+
+    if(!tosdb_wal_replay(res->wal)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot replay wal");
+        tosdb_free(res);
+
+        return NULL;
+    }
+
+    if(!tosdb_compaction_task_start(res)) {
+        PRINTLOG(TOSDB, LOG_WARNING, "background compaction is disabled");
+    }
 
     return res;
 }
@@ -180,7 +205,7 @@ boolean_t tosdb_load_databases(tosdb_t* tdb) {
     }
 
     if(!tdb->databases) {
-        tdb->databases = hashmap_string(128);
+        tdb->databases = hashmap_string_concurrent(128);
     }
 
     if(!tdb->databases) {
@@ -193,14 +218,16 @@ boolean_t tosdb_load_databases(tosdb_t* tdb) {
     uint64_t db_list_size = tdb->superblock->database_list_size;
 
     while(db_list_loc != 0) {
-        tosdb_block_database_list_t* db_list = (tosdb_block_database_list_t*)tosdb_block_read(tdb, db_list_loc, db_list_size);
+        tosdb_cached_block_t* db_list_blk = tosdb_block_acquire(tdb, db_list_loc, db_list_size);
 
-        if(!db_list) {
+        if(!db_list_blk) {
             PRINTLOG(TOSDB, LOG_ERROR, "cannot read database list");
 
             return false;
         }
 
+        tosdb_block_database_list_t* db_list = (tosdb_block_database_list_t*)db_list_blk->block;
+
         char_t name_buf[TOSDB_NAME_MAX_LEN + 1] = {0};
 
         for(uint64_t i = 0; i < db_list->database_count; i++) {
@@ -215,7 +242,7 @@ boolean_t tosdb_load_databases(tosdb_t* tdb) {
 
             if(!db) {
                 PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate db");
-                memory_free(db_list);
+                tosdb_block_release(db_list_blk);
 
                 return false;
             }
@@ -241,7 +268,7 @@ boolean_t tosdb_load_databases(tosdb_t* tdb) {
         db_list_loc = db_list->header.previous_block_location;
         db_list_size = db_list->header.previous_block_size;
 
-        memory_free(db_list);
+        tosdb_block_release(db_list_blk);
     }
 
     return true;
@@ -269,6 +296,8 @@ boolean_t tosdb_close(tosdb_t* tdb) {
 
     boolean_t error = false;
 
+    tosdb_compaction_task_stop(tdb);
+
     iterator_t* iter = hashmap_iterator_create(tdb->databases);
 
     while (iter->end_of_iterator(iter) != 0) {
@@ -284,6 +313,11 @@ boolean_t tosdb_close(tosdb_t* tdb) {
 
     iter->destroy(iter);
 
+    if(!error && !tosdb_wal_truncate(tdb->wal)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot truncate wal");
+        error = true;
+    }
+
     if (tdb->is_dirty) {
         if (!tosdb_persist(tdb)) {
             PRINTLOG(TOSDB, LOG_ERROR, "cannot persist tosdb metadata");
@@ -333,11 +367,15 @@ boolean_t tosdb_free(tosdb_t * tdb) {
 
     iter->destroy(iter);
 
+    tosdb_compaction_task_end(tdb);
+
     memory_free(tdb->superblock);
     lock_destroy(tdb->lock);
+    lock_destroy(tdb->block_lock);
     hashmap_destroy(tdb->databases);
     hashmap_destroy(tdb->database_new);
     tosdb_cache_close(tdb->cache);
+    tosdb_wal_free(tdb->wal);
     memory_free(tdb);
 
     PRINTLOG(TOSDB, LOG_DEBUG, "tosdb freed");
@@ -345,7 +383,7 @@ boolean_t tosdb_free(tosdb_t * tdb) {
     return !error;
 }
 
-tosdb_block_header_t* tosdb_block_read(tosdb_t* tdb, uint64_t location, uint64_t size) {
+static tosdb_block_header_t* tosdb_block_load(tosdb_t* tdb, uint64_t location, uint64_t size) {
     if(!tdb || !location || !size || (size % TOSDB_PAGE_SIZE) ) {
         PRINTLOG(TOSDB, LOG_ERROR, "tosdb is null or location/size (0x%llx,0x%llx) is zero or size isnot multiple of tosdb page size", location, size);
 
@@ -376,6 +414,14 @@ tosdb_block_header_t* tosdb_block_read(tosdb_t* tdb, uint64_t location, uint64_t
         return NULL;
     }
 
+    // block layouts change between major versions, such as valuelog chunks and blocked bloom filters
+    if(block->version_major != TOSDB_VERSION_MAJOR) {
+        PRINTLOG(TOSDB, LOG_ERROR, "block version mismatch 0x%x 0x%x", block->version_major, TOSDB_VERSION_MAJOR);
+
+        memory_free(block);
+
+        return NULL;
+    }
 
     uint64_t csum_bak = block->checksum;
     block->checksum = 0;
@@ -394,6 +440,82 @@ tosdb_block_header_t* tosdb_block_read(tosdb_t* tdb, uint64_t location, uint64_t
     return block;
 }
 
+tosdb_cached_block_t* tosdb_block_acquire(tosdb_t* tdb, uint64_t location, uint64_t size) {
+    if(!tdb) {
+        PRINTLOG(TOSDB, LOG_ERROR, "tosdb is null");
+
+        return NULL;
+    }
+
+    tosdb_cached_block_t* c_blk = tosdb_cache_block_get(tdb->cache, location, size);
+
+    if(c_blk) {
+        return c_blk;
+    }
+
+    // blocks are never rewritten at same location, a verified block stays valid while cached
+    tosdb_block_header_t* block = tosdb_block_load(tdb, location, size);
+
+    if(!block) {
+        return NULL;
+    }
+
+    c_blk = memory_malloc(sizeof(tosdb_cached_block_t));
+
+    if(!c_blk) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create cached block");
+        memory_free(block);
+
+        return NULL;
+    }
+
+    c_blk->location = location;
+    c_blk->size = size;
+    c_blk->ref_count = 1;
+    c_blk->block = block;
+
+    tosdb_cache_block_put(tdb->cache, c_blk);
+
+    return c_blk;
+}
+
+void tosdb_block_release(tosdb_cached_block_t* c_blk) {
+    tosdb_cache_block_release(c_blk);
+}
+
+tosdb_block_header_t* tosdb_block_read(tosdb_t* tdb, uint64_t location, uint64_t size) {
+    if(!tdb || !tdb->cache) {
+        return tosdb_block_load(tdb, location, size);
+    }
+
+    tosdb_cached_block_t* c_blk = tosdb_block_acquire(tdb, location, size);
+
+    if(!c_blk) {
+        return NULL;
+    }
+
+    if(!c_blk->cache) {
+        // block is not shared, caller can own it
+        tosdb_block_header_t* block = c_blk->block;
+
+        memory_free(c_blk);
+
+        return block;
+    }
+
+    tosdb_block_header_t* block = memory_malloc(size);
+
+    if(block) {
+        memory_memcopy(c_blk->block, block, size);
+    } else {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot copy cached block");
+    }
+
+    tosdb_block_release(c_blk);
+
+    return block;
+}
+
 uint64_t tosdb_block_write(tosdb_t* tdb, tosdb_block_header_t* block) {
     if(!tdb || !block) {
         PRINTLOG(TOSDB, LOG_ERROR, "tosdb or block is null");
@@ -409,17 +531,37 @@ uint64_t tosdb_block_write(tosdb_t* tdb, tosdb_block_header_t* block) {
 
     block->checksum = csum;
 
-    uint64_t w_cnt = tdb->backend->write(tdb->backend, tdb->superblock->free_next_location, block->block_size, (uint8_t*)block);
+    // wal flushes, memtable persists and compaction write blocks at the same time, space is reserved under lock
+    lock_acquire(tdb->block_lock);
+
+    uint64_t res = tdb->superblock->free_next_location;
+
+    tdb->superblock->free_next_location += block->block_size;
+
+    lock_release(tdb->block_lock);
+
+    uint64_t w_cnt = tdb->backend->write(tdb->backend, res, block->block_size, (uint8_t*)block);
 
     if(w_cnt != block->block_size) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot write block");
 
+        return 0;
+    }
+
+    return res;
+}
+
+boolean_t tosdb_superblock_flush(tosdb_t* tdb) {
+    if(!tdb) {
         return false;
     }
 
-    uint64_t res = tdb->superblock->free_next_location;
+    // block allocation should not move free location while superblock checksum is computed
+    lock_acquire(tdb->block_lock);
 
-    tdb->superblock->free_next_location += block->block_size;
+    boolean_t res = tosdb_write_and_flush_superblock(tdb->backend, tdb->superblock);
+
+    lock_release(tdb->block_lock);
 
     return res;
 }
@@ -522,7 +664,7 @@ boolean_t tosdb_persist(tosdb_t* tdb) {
     hashmap_destroy(tdb->database_new);
     tdb->database_new = NULL;
 
-    if(!tosdb_write_and_flush_superblock(tdb->backend, tdb->superblock)) {
+    if(!tosdb_superblock_flush(tdb)) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot write and flush super block");
 
         return false;
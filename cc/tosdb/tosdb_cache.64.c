@@ -9,6 +9,7 @@
 #include <tosdb/tosdb_cache.h>
 #include <tosdb/tosdb_internal.h>
 #include <cache.h>
+#include <cpu/sync.h>
 #include <logging.h>
 #include <logging.h>
 #include <xxhash.h>
@@ -26,6 +27,10 @@ struct tosdb_cache_t {
     cache_t*             index_data_cache; ///< index data cache
     cache_t*             secondary_index_data_cache; ///< secondary index data cache
     cache_t*             valuelog_cache; ///< valuelog cache
+    cache_t*             block_cache; ///< raw block cache, null if disabled
+    lock_t*              block_lock; ///< block cache and block reference count lock
+    uint64_t             block_hit_count; ///< block cache hit count
+    uint64_t             block_miss_count; ///< block cache miss count
 };
 
 /**
@@ -51,6 +56,29 @@ int8_t tosdb_cache_key_comparator(const void* item1, const void* item2);
  */
 boolean_t tosdb_cache_item_key_destroyer(const void* key, const void* item);
 
+/**
+ * @brief tosdb block cache key generator
+ * @param item cached block
+ * @return key which is generated from block location and size with xxhash64 algorithm
+ */
+uint64_t tosdb_cache_block_key_generator(const void* item);
+
+/**
+ * @brief tosdb block cache key comparator
+ * @param item1 cached block 1
+ * @param item2 cached block 2
+ * @return 0 if item1 == item2, -1 if item1 < item2, 1 if item1 > item2
+ */
+int8_t tosdb_cache_block_key_comparator(const void* item1, const void* item2);
+
+/**
+ * @brief tosdb block cache item destroyer, drops reference of cache
+ * @param key key of item
+ * @param item cached block
+ * @return true
+ */
+boolean_t tosdb_cache_block_item_key_destroyer(const void* key, const void* item);
+
 
 
 uint64_t tosdb_cache_key_generator(const void* item) {
@@ -63,6 +91,7 @@ uint64_t tosdb_cache_key_generator(const void* item) {
     xxhash64_update(hctx, &key->index_id, 8);
     xxhash64_update(hctx, &key->level, 8);
     xxhash64_update(hctx, &key->sstable_id, 8);
+    xxhash64_update(hctx, &key->chunk_id, 8);
 
     return xxhash64_final(hctx);
 }
@@ -111,12 +140,25 @@ int8_t tosdb_cache_key_comparator(const void* item1, const void* item2) {
         return 1;
     }
 
+    if(key1->chunk_id < key2->chunk_id) {
+        return -1;
+    }
+
+    if(key1->chunk_id > key2->chunk_id) {
+        return 1;
+    }
+
     return 0;
 }
 
 boolean_t tosdb_cache_item_key_destroyer(const void* key, const void* item) {
     UNUSED(key);
 
+    // keys are inside items, nothing to release without item
+    if(!item) {
+        return true;
+    }
+
     const tosdb_cache_key_t* ckey = item;
 
     if(ckey->type == TOSDB_CACHE_ITEM_TYPE_BLOOMFILTER) {
@@ -135,13 +177,71 @@ boolean_t tosdb_cache_item_key_destroyer(const void* key, const void* item) {
         memory_free(c_id);
     } else if(ckey->type == TOSDB_CACHE_ITEM_TYPE_VALUELOG) {
         tosdb_cached_valuelog_t* c_vl = (tosdb_cached_valuelog_t*)item;
-        buffer_destroy(c_vl->values);
+        memory_free(c_vl->chunk);
         memory_free(c_vl);
     }
 
     return true;
 }
 
+uint64_t tosdb_cache_block_key_generator(const void* item) {
+    const tosdb_cached_block_t* c_blk = item;
+
+    xxhash64_context_t* hctx = xxhash64_init(0);
+
+    xxhash64_update(hctx, &c_blk->location, 8);
+    xxhash64_update(hctx, &c_blk->size, 8);
+
+    return xxhash64_final(hctx);
+}
+
+int8_t tosdb_cache_block_key_comparator(const void* item1, const void* item2) {
+    const tosdb_cached_block_t* c_blk1 = item1;
+    const tosdb_cached_block_t* c_blk2 = item2;
+
+    if(c_blk1->location < c_blk2->location) {
+        return -1;
+    }
+
+    if(c_blk1->location > c_blk2->location) {
+        return 1;
+    }
+
+    if(c_blk1->size < c_blk2->size) {
+        return -1;
+    }
+
+    if(c_blk1->size > c_blk2->size) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static void tosdb_cache_block_unref(tosdb_cached_block_t* c_blk) {
+    c_blk->ref_count--;
+
+    if(!c_blk->ref_count) {
+        memory_free(c_blk->block);
+        memory_free(c_blk);
+    }
+}
+
+boolean_t tosdb_cache_block_item_key_destroyer(const void* key, const void* item) {
+    UNUSED(key);
+
+    if(!item) {
+        return true;
+    }
+
+    // called while block lock is held, readers may still hold the block and they keep using block lock
+    tosdb_cached_block_t* c_blk = (tosdb_cached_block_t*)item;
+
+    tosdb_cache_block_unref(c_blk);
+
+    return true;
+}
+
 tosdb_cache_t* tosdb_cache_new(tosdb_cache_config_t* config) {
     if(!config) {
         return NULL;
@@ -161,7 +261,6 @@ tosdb_cache_t* tosdb_cache_new(tosdb_cache_config_t* config) {
     cc.key_generator = tosdb_cache_key_generator;
 
     cc.hard_limit = config->bloomfilter_size;
-    cc.soft_limit = cc.hard_limit / 2;
     cache->bloomfilter_cache = cache_new(&cc);
 
     if(!cache->bloomfilter_cache) {
@@ -171,7 +270,6 @@ tosdb_cache_t* tosdb_cache_new(tosdb_cache_config_t* config) {
     }
 
     cc.hard_limit = config->index_data_size;
-    cc.soft_limit = cc.hard_limit / 2;
     cache->index_data_cache = cache_new(&cc);
 
     if(!cache->index_data_cache) {
@@ -182,7 +280,6 @@ tosdb_cache_t* tosdb_cache_new(tosdb_cache_config_t* config) {
     }
 
     cc.hard_limit = config->secondary_index_data_size;
-    cc.soft_limit = cc.hard_limit / 2;
     cache->secondary_index_data_cache = cache_new(&cc);
 
     if(!cache->secondary_index_data_cache) {
@@ -194,7 +291,6 @@ tosdb_cache_t* tosdb_cache_new(tosdb_cache_config_t* config) {
     }
 
     cc.hard_limit = config->valuelog_size;
-    cc.soft_limit = cc.hard_limit / 2;
     cache->valuelog_cache = cache_new(&cc);
 
     if(!cache->valuelog_cache) {
@@ -206,6 +302,27 @@ tosdb_cache_t* tosdb_cache_new(tosdb_cache_config_t* config) {
         return NULL;
     }
 
+    if(config->block_size) {
+        cc.item_key_destroyer = tosdb_cache_block_item_key_destroyer;
+        cc.key_comparator = tosdb_cache_block_key_comparator;
+        cc.key_generator = tosdb_cache_block_key_generator;
+        cc.hard_limit = config->block_size;
+        cache->block_cache = cache_new(&cc);
+        cache->block_lock = lock_create();
+
+        if(!cache->block_cache || !cache->block_lock) {
+            cache_destroy(cache->block_cache);
+            lock_destroy(cache->block_lock);
+            cache_destroy(cache->valuelog_cache);
+            cache_destroy(cache->secondary_index_data_cache);
+            cache_destroy(cache->index_data_cache);
+            cache_destroy(cache->bloomfilter_cache);
+            memory_free(cache);
+
+            return NULL;
+        }
+    }
+
     return cache;
 }
 
@@ -219,6 +336,13 @@ boolean_t tosdb_cache_close(tosdb_cache_t* cache) {
     cache_destroy(cache->secondary_index_data_cache);
     cache_destroy(cache->valuelog_cache);
 
+    if(cache->block_cache) {
+        lock_acquire(cache->block_lock);
+        cache_destroy(cache->block_cache);
+        lock_release(cache->block_lock);
+        lock_destroy(cache->block_lock);
+    }
+
     memory_free(cache);
 
     return true;
@@ -267,3 +391,86 @@ boolean_t tosdb_cache_put(tosdb_cache_t* cache, tosdb_cache_key_t* key) {
 
     return false;
 }
+
+tosdb_cached_block_t* tosdb_cache_block_get(tosdb_cache_t* cache, uint64_t location, uint64_t size) {
+    if(!cache || !cache->block_cache) {
+        return NULL;
+    }
+
+    tosdb_cached_block_t key = {0};
+    key.location = location;
+    key.size = size;
+
+    lock_acquire(cache->block_lock);
+
+    tosdb_cached_block_t* c_blk = (tosdb_cached_block_t*)cache_get(cache->block_cache, &key);
+
+    if(c_blk) {
+        c_blk->ref_count++;
+        cache->block_hit_count++;
+    } else {
+        cache->block_miss_count++;
+    }
+
+    lock_release(cache->block_lock);
+
+    return c_blk;
+}
+
+boolean_t tosdb_cache_block_put(tosdb_cache_t* cache, tosdb_cached_block_t* c_blk) {
+    if(!cache || !cache->block_cache || !c_blk) {
+        return false;
+    }
+
+    boolean_t res = false;
+
+    lock_acquire(cache->block_lock);
+
+    // concurrent readers can miss same block, only first one is cached
+    if(!cache_get(cache->block_cache, c_blk)) {
+        c_blk->ref_count++;
+        c_blk->cache = cache;
+
+        res = cache_put_item_as_key(cache->block_cache, c_blk, c_blk->size);
+
+        if(!res) {
+            c_blk->ref_count--;
+            c_blk->cache = NULL;
+        }
+    }
+
+    lock_release(cache->block_lock);
+
+    return res;
+}
+
+void tosdb_cache_block_release(tosdb_cached_block_t* c_blk) {
+    if(!c_blk) {
+        return;
+    }
+
+    tosdb_cache_t* cache = c_blk->cache;
+
+    if(!cache) {
+        tosdb_cache_block_unref(c_blk);
+
+        return;
+    }
+
+    lock_acquire(cache->block_lock);
+    tosdb_cache_block_unref(c_blk);
+    lock_release(cache->block_lock);
+}
+
+boolean_t tosdb_block_cache_get_stats(tosdb_t* tdb, tosdb_block_cache_stats_t* stats) {
+    if(!tdb || !stats || !tdb->cache || !tdb->cache->block_cache) {
+        return false;
+    }
+
+    lock_acquire(tdb->cache->block_lock);
+    stats->hit_count = tdb->cache->block_hit_count;
+    stats->miss_count = tdb->cache->block_miss_count;
+    lock_release(tdb->cache->block_lock);
+
+    return true;
+}
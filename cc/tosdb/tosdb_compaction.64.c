@@ -10,9 +10,64 @@
 #include <tosdb/tosdb_internal.h>
 #include <logging.h>
 #include <stdbufs.h>
+#include <compression.h>
+#include <cpu/task.h>
 
 MODULE("turnstone.kernel.db");
 
+/**
+ * @struct tosdb_compaction_index_data_t
+ * @brief unpacked index data of one index of a compaction source sstable
+ */
+typedef struct tosdb_compaction_index_data_t {
+    tosdb_index_t* ti; ///< index of data
+    uint64_t       record_count; ///< item count
+    void**         items; ///< sorted items, first item is also start of unpacked data
+} tosdb_compaction_index_data_t;
+
+/**
+ * @struct tosdb_compaction_source_t
+ * @brief one input sstable of a compaction
+ */
+typedef struct tosdb_compaction_source_t {
+    tosdb_block_sstable_list_item_t* stli; ///< sstable list item of source
+    uint8_t*                         valuelog; ///< unpacked valuelog
+    uint64_t                         valuelog_size; ///< unpacked valuelog size
+    hashmap_t*                       indexes; ///< index id to @ref tosdb_compaction_index_data_t map
+} tosdb_compaction_source_t;
+
+/**
+ * @struct tosdb_compaction_survivor_t
+ * @brief record which survived primary index merge, other indexes are filtered with survivors
+ */
+typedef struct tosdb_compaction_survivor_t {
+    uint128_t record_id; ///< record id, also hashmap key
+    uint64_t  source; ///< source index of newest version of record
+    boolean_t is_deleted; ///< newest version is a delete marker
+    uint64_t  source_offset; ///< offset at valuelog of source
+    uint64_t  offset; ///< offset at new valuelog
+    uint64_t  length; ///< length at new valuelog
+} tosdb_compaction_survivor_t;
+
+uint8_t*                   tosdb_compaction_unpack(tosdb_t* tdb, uint8_t* data, uint64_t size, uint64_t unpacked_size);
+tosdb_compaction_source_t* tosdb_compaction_source_load(tosdb_table_t* tbl, tosdb_block_sstable_list_item_t* stli);
+boolean_t                  tosdb_compaction_source_free(tosdb_compaction_source_t* src);
+uint64_t                   tosdb_compaction_survivor_key_generator(const void* key);
+int8_t                     tosdb_compaction_survivor_key_comparator(const void* key1, const void* key2);
+boolean_t                  tosdb_compaction_bloomfilter_add(tosdb_memtable_index_t* mt_idx, uint8_t* key, uint64_t key_length, uint64_t* key_hash);
+boolean_t                  tosdb_compaction_merge_primary(tosdb_memtable_t* mt, tosdb_compaction_source_t** srcs, uint64_t src_count,
+                                                          boolean_t drop_deleted, tosdb_compaction_survivor_t* survivors, hashmap_t* survivor_map);
+boolean_t                  tosdb_compaction_merge_index(tosdb_memtable_index_t* mt_idx, tosdb_compaction_source_t** srcs, uint64_t src_count, hashmap_t* survivor_map);
+boolean_t                  tosdb_compaction_inputs_append(list_t* inputs, list_t* st_list);
+boolean_t                  tosdb_compaction_inputs_contains(list_t* inputs, const tosdb_block_sstable_list_item_t* stli);
+boolean_t                  tosdb_compaction_sstable_list_persist(tosdb_table_t* tbl, list_t* inputs, tosdb_block_sstable_list_item_t* output);
+boolean_t                  tosdb_compaction_swap(tosdb_table_t* tbl, list_t* inputs, tosdb_block_sstable_list_item_t* output);
+boolean_t                  tosdb_sstable_compact(tosdb_table_t* tbl, list_t* inputs, uint64_t level, boolean_t drop_deleted);
+uint64_t                   tosdb_compaction_level_sstable_count(const tosdb_table_t* tbl, uint64_t level);
+boolean_t                  tosdb_compaction_table_schedule(tosdb_table_t* tbl);
+boolean_t                  tosdb_compaction_schedule(tosdb_t* tdb);
+int32_t                    tosdb_compaction_task(int32_t argc, void** argv);
+
 boolean_t tosdb_compact(tosdb_t* tdb, tosdb_compaction_type_t type) {
     if(!tdb) {
         return false;
@@ -22,12 +77,6 @@ boolean_t tosdb_compact(tosdb_t* tdb, tosdb_compaction_type_t type) {
         return true;
     }
 
-    if(type == TOSDB_COMPACTION_TYPE_MAJOR) {
-        // if(!tosdb_compact(tdb, TOSDB_COMPACTION_TYPE_MINOR)) {
-        // return false;
-        // }
-    }
-
     hashmap_t* dbs = tdb->databases;
 
     if(!dbs) {
@@ -45,9 +94,9 @@ boolean_t tosdb_compact(tosdb_t* tdb, tosdb_compaction_type_t type) {
     }
 
     while(db_iter->end_of_iterator(db_iter)) {
-        const tosdb_database_t* db = db_iter->get_item(db_iter);
+        tosdb_database_t* db = (tosdb_database_t*)db_iter->get_item(db_iter);
 
-        error = !tosdb_database_compact(db, type);
+        error |= !tosdb_database_compact(db, type);
 
         db_iter = db_iter->next(db_iter);
     }
@@ -57,7 +106,7 @@ boolean_t tosdb_compact(tosdb_t* tdb, tosdb_compaction_type_t type) {
     return !error;
 }
 
-boolean_t tosdb_database_compact(const tosdb_database_t* db, tosdb_compaction_type_t type) {
+boolean_t tosdb_database_compact(tosdb_database_t* db, tosdb_compaction_type_t type) {
     if(!db) {
         return false;
     }
@@ -83,7 +132,7 @@ boolean_t tosdb_database_compact(const tosdb_database_t* db, tosdb_compaction_ty
     }
 
     while(tbl_iter->end_of_iterator(tbl_iter)) {
-        const tosdb_table_t* tbl = tbl_iter->get_item(tbl_iter);
+        tosdb_table_t* tbl = (tosdb_table_t*)tbl_iter->get_item(tbl_iter);
 
         error |= !tosdb_table_compact(tbl, type);
 
@@ -95,7 +144,7 @@ boolean_t tosdb_database_compact(const tosdb_database_t* db, tosdb_compaction_ty
     return !error;
 }
 
-boolean_t tosdb_table_compact(const tosdb_table_t* tbl, tosdb_compaction_type_t type) {
+boolean_t tosdb_table_compact(tosdb_table_t* tbl, tosdb_compaction_type_t type) {
     if(!tbl) {
         return false;
     }
@@ -104,98 +153,1352 @@ boolean_t tosdb_table_compact(const tosdb_table_t* tbl, tosdb_compaction_type_t
         return true;
     }
 
-    boolean_t error = false;
+    if(!tbl->is_open || tbl->is_deleted) {
+        return true;
+    }
+
+    uint64_t max_level = tbl->sstable_max_level;
 
-    set_t* pks = set_create(tosdb_record_primary_key_comparator);
-    list_t* old_pks = list_create_list();
-    tosdb_table_get_primary_keys_internal(tbl, pks, old_pks);
+    if(!max_level && tbl->sstable_list_items && list_size(tbl->sstable_list_items)) {
+        max_level = 1;
+    }
+
+    if(!max_level) {
+        return true;
+    }
 
-    if(!tosdb_table_get_primary_keys_internal(tbl, pks, old_pks)) {
-        error = true;
-        set_destroy_with_callback(pks, tosdb_record_search_set_destroy_cb);
+    hashmap_t* level_holes = hashmap_integer(128);
+
+    if(!level_holes) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot count holes of table %s", tbl->name);
 
         return false;
     }
 
-    printf("!!! ss %s live pk count: %lli\n", tbl->name, set_size(pks));
-    set_destroy_with_callback(pks, tosdb_record_search_set_destroy_cb);
+    // merge over primary index counts shadowed versions per level while streaming keys
+    iterator_t* iter = tosdb_merge_iterator_create(tbl, tbl->primary_index_id, NULL, NULL, level_holes);
 
-    printf("!!! ls %s %lli\n", tbl->name, list_size(old_pks));
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot get primary keys of table %s", tbl->name);
+        hashmap_destroy(level_holes);
 
-    iterator_t* iter = list_iterator_create(old_pks);
+        return false;
+    }
 
-    hashmap_t* level_holes = hashmap_integer(128);
+    uint64_t live_count = 0;
 
     while(iter->end_of_iterator(iter) != 0) {
-        tosdb_record_t* rec = (tosdb_record_t*)iter->get_item(iter);
-        tosdb_record_context_t* ctx = rec->context;
-
-        if(hashmap_exists(level_holes, (void*)ctx->level)) {
-            hashmap_t* st_holes = (hashmap_t*)hashmap_get(level_holes, (void*)ctx->level);
-            uint64_t hole_count = (uint64_t)hashmap_get(st_holes, (void*)ctx->sstable_id);
-            hole_count++;
-            hashmap_put(st_holes, (void*)ctx->sstable_id, (void*)hole_count);
-        } else {
-            hashmap_t* st_holes = hashmap_integer(128);
-            hashmap_put(st_holes, (void*)ctx->sstable_id, (void*)1);
-            hashmap_put(level_holes, (void*)ctx->level, st_holes);
+        live_count++;
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    PRINTLOG(TOSDB, LOG_DEBUG, "table %s live pk count: %lli", tbl->name, live_count);
+
+    boolean_t error = false;
+
+    if(type == TOSDB_COMPACTION_TYPE_MINOR) {
+        for(uint64_t i = 1; i <= max_level; i++) {
+            list_t* st_lvl_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)i);
+            uint64_t st_count = st_lvl_l?list_size(st_lvl_l):0;
+
+            if(i == 1 && tbl->sstable_list_items) {
+                st_count += list_size(tbl->sstable_list_items);
+            }
+
+            uint64_t hole_count = (uint64_t)hashmap_get(level_holes, (void*)i);
+
+            if(st_count > 1 || (st_count == 1 && hole_count)) {
+                PRINTLOG(TOSDB, LOG_DEBUG, "table %s level %lli has %lli sstables and %lli holes, compacting", tbl->name, i, st_count, hole_count);
+
+                error |= !tosdb_sstable_level_minor_compact(tbl, i);
+            }
+        }
+    } else {
+        if(max_level > 1) {
+            max_level--;
         }
 
-        rec->destroy(rec);
+        for(uint64_t i = 1; i <= max_level; i++) {
+            error |= !tosdb_sstable_level_major_compact(tbl, i);
+        }
+    }
+
+    hashmap_destroy(level_holes);
+
+    return !error;
+}
+
+boolean_t tosdb_sstable_level_minor_compact(tosdb_table_t* tbl, uint64_t level) {
+    if(!tbl || !level) {
+        return false;
+    }
+
+    list_t* inputs = list_create_queue();
+
+    if(!inputs) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction input list");
+
+        return false;
+    }
+
+    lock_acquire(tbl->lock);
+
+    if(level == 1) {
+        tosdb_compaction_inputs_append(inputs, tbl->sstable_list_items);
+    }
+
+    tosdb_compaction_inputs_append(inputs, (list_t*)hashmap_get(tbl->sstable_levels, (void*)level));
+
+    boolean_t res = true;
+
+    // table can be closed while waiting lock
+    if(tbl->is_open && list_size(inputs)) {
+        res = tosdb_sstable_compact(tbl, inputs, level, level >= tbl->sstable_max_level);
+    }
+
+    lock_release(tbl->lock);
+
+    list_destroy(inputs);
+
+    return res;
+}
+
+boolean_t tosdb_sstable_level_major_compact(tosdb_table_t* tbl, uint64_t level) {
+    if(!tbl || !level) {
+        return false;
+    }
+
+    list_t* inputs = list_create_queue();
+
+    if(!inputs) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction input list");
+
+        return false;
+    }
+
+    lock_acquire(tbl->lock);
+
+    if(level == 1) {
+        tosdb_compaction_inputs_append(inputs, tbl->sstable_list_items);
+    }
+
+    tosdb_compaction_inputs_append(inputs, (list_t*)hashmap_get(tbl->sstable_levels, (void*)level));
+
+    boolean_t res = true;
+
+    // table can be closed while waiting lock
+    if(tbl->is_open && list_size(inputs)) {
+        tosdb_compaction_inputs_append(inputs, (list_t*)hashmap_get(tbl->sstable_levels, (void*)(level + 1)));
+
+        res = tosdb_sstable_compact(tbl, inputs, level + 1, level + 1 >= tbl->sstable_max_level);
+    }
+
+    lock_release(tbl->lock);
+
+    list_destroy(inputs);
+
+    return res;
+}
+
+boolean_t tosdb_compaction_inputs_append(list_t* inputs, list_t* st_list) {
+    if(!inputs) {
+        return false;
+    }
+
+    if(!st_list) {
+        return true;
+    }
+
+    iterator_t* iter = list_iterator_create(st_list);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list iterator");
+
+        return false;
+    }
+
+    while(iter->end_of_iterator(iter) != 0) {
+        list_queue_push(inputs, iter->get_item(iter));
 
         iter = iter->next(iter);
     }
 
     iter->destroy(iter);
-    list_destroy(old_pks);
 
-    iter = hashmap_iterator_create(level_holes);
+    return true;
+}
 
-    while(iter->end_of_iterator(iter) != 0) {
-        hashmap_t* st_holes = (hashmap_t*)iter->get_item(iter);
-        uint64_t level = (uint64_t)iter->get_extra_data(iter);
+boolean_t tosdb_compaction_inputs_contains(list_t* inputs, const tosdb_block_sstable_list_item_t* stli) {
+    boolean_t found = false;
 
-        iterator_t* st_iter = hashmap_iterator_create(st_holes);
+    iterator_t* iter = list_iterator_create(inputs);
 
-        while(st_iter->end_of_iterator(st_iter) != 0) {
-            uint64_t hole_count = (uint64_t)st_iter->get_item(st_iter);
-            uint64_t st_id = (uint64_t)st_iter->get_extra_data(st_iter);
+    if(!iter) {
+        return false;
+    }
 
-            printf("level: %lli sstable id: %lli hole count: %lli\n", level, st_id, hole_count);
+    while(iter->end_of_iterator(iter) != 0) {
+        if(iter->get_item(iter) == stli) {
+            found = true;
 
-            st_iter = st_iter->next(st_iter);
+            break;
         }
 
-        st_iter->destroy(st_iter);
-        hashmap_destroy(st_holes);
-
         iter = iter->next(iter);
     }
 
     iter->destroy(iter);
-    hashmap_destroy(level_holes);
 
-    for(uint64_t i = 1; i < tbl->sstable_max_level; i++) {
-        if(type == TOSDB_COMPACTION_TYPE_MINOR) {
-            error = !tosdb_sstable_level_minor_compact(tbl, i);
-        } else {
-            error = !tosdb_sstable_level_major_compact(tbl, i);
+    return found;
+}
+
+uint8_t* tosdb_compaction_unpack(tosdb_t* tdb, uint8_t* data, uint64_t size, uint64_t unpacked_size) {
+    buffer_t* buf_in = buffer_encapsulate(data, size);
+
+    if(!buf_in) {
+        return NULL;
+    }
+
+    buffer_t* buf_out = buffer_new_with_capacity(NULL, unpacked_size);
+
+    if(!buf_out) {
+        buffer_destroy(buf_in);
+
+        return NULL;
+    }
+
+    int8_t zc_res = tdb->compression->unpack(buf_in, buf_out);
+
+    buffer_destroy(buf_in);
+
+    if(zc_res != 0 || buffer_get_length(buf_out) != unpacked_size) {
+        buffer_destroy(buf_out);
+
+        return NULL;
+    }
+
+    return buffer_get_all_bytes_and_destroy(buf_out, NULL);
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+tosdb_compaction_source_t* tosdb_compaction_source_load(tosdb_table_t* tbl, tosdb_block_sstable_list_item_t* stli) {
+    tosdb_t* tdb = tbl->db->tdb;
+
+    tosdb_compaction_source_t* src = memory_malloc(sizeof(tosdb_compaction_source_t));
+
+    if(!src) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction source");
+
+        return NULL;
+    }
+
+    src->stli = stli;
+    src->indexes = hashmap_integer(16);
+
+    if(!src->indexes) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction source index map");
+        memory_free(src);
+
+        return NULL;
+    }
+
+    tosdb_block_valuelog_t* b_vl = (tosdb_block_valuelog_t*)tosdb_block_read(tdb, stli->valuelog_location, stli->valuelog_size);
+
+    if(!b_vl) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot read valuelog of sstable %lli", stli->sstable_id);
+        tosdb_compaction_source_free(src);
+
+        return NULL;
+    }
+
+    src->valuelog_size = b_vl->valuelog_unpacked_size;
+
+    if(src->valuelog_size) {
+        src->valuelog = memory_malloc(src->valuelog_size);
+
+        if(!src->valuelog) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate valuelog of sstable %lli", stli->sstable_id);
+            memory_free(b_vl);
+            tosdb_compaction_source_free(src);
+
+            return NULL;
         }
     }
 
-    return !error;
+    for(uint64_t chunk_id = 0; chunk_id < b_vl->chunk_count; chunk_id++) {
+        uint64_t chunk_size = 0;
+        uint8_t* chunk = tosdb_valuelog_chunk_unpack(tdb, b_vl, chunk_id, &chunk_size);
+
+        if(!chunk) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot unpack valuelog of sstable %lli", stli->sstable_id);
+            memory_free(b_vl);
+            tosdb_compaction_source_free(src);
+
+            return NULL;
+        }
+
+        memory_memcopy(chunk, src->valuelog + chunk_id * b_vl->chunk_size, chunk_size);
+        memory_free(chunk);
+    }
+
+    memory_free(b_vl);
+
+    for(uint64_t i = 0; i < stli->index_count; i++) {
+        tosdb_index_t* ti = (tosdb_index_t*)hashmap_get(tbl->indexes, (void*)stli->indexes[i].index_id);
+
+        if(!ti) {
+            PRINTLOG(TOSDB, LOG_WARNING, "index %lli of sstable %lli is not found, skipping", stli->indexes[i].index_id, stli->sstable_id);
+
+            continue;
+        }
+
+        tosdb_block_sstable_index_t* b_si = (tosdb_block_sstable_index_t*)tosdb_block_read(tdb, stli->indexes[i].index_location, stli->indexes[i].index_size);
+
+        if(!b_si) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot read index %lli of sstable %lli", ti->id, stli->sstable_id);
+            tosdb_compaction_source_free(src);
+
+            return NULL;
+        }
+
+        tosdb_block_sstable_index_data_t* b_sid = (tosdb_block_sstable_index_data_t*)tosdb_block_read(tdb, b_si->index_data_location, b_si->index_data_size);
+
+        memory_free(b_si);
+
+        if(!b_sid) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot read index data %lli of sstable %lli", ti->id, stli->sstable_id);
+            tosdb_compaction_source_free(src);
+
+            return NULL;
+        }
+
+        uint64_t record_count = b_sid->record_count;
+        uint8_t* idx_data = tosdb_compaction_unpack(tdb, b_sid->data, b_sid->index_data_size, b_sid->index_data_unpacked_size);
+
+        memory_free(b_sid);
+
+        if(!idx_data) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot unpack index data %lli of sstable %lli", ti->id, stli->sstable_id);
+            tosdb_compaction_source_free(src);
+
+            return NULL;
+        }
+
+        tosdb_compaction_index_data_t* cid = memory_malloc(sizeof(tosdb_compaction_index_data_t));
+
+        if(!cid) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction index data");
+            memory_free(idx_data);
+            tosdb_compaction_source_free(src);
+
+            return NULL;
+        }
+
+        cid->items = memory_malloc(sizeof(void*) * MAX(record_count, 1ULL));
+
+        if(!cid->items) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction index item array");
+            memory_free(cid);
+            memory_free(idx_data);
+            tosdb_compaction_source_free(src);
+
+            return NULL;
+        }
+
+        cid->ti = ti;
+        cid->record_count = record_count;
+        cid->items[0] = idx_data;
+
+        for(uint64_t j = 0; j < record_count; j++) {
+            cid->items[j] = idx_data;
+
+            if(ti->type == TOSDB_INDEX_SECONDARY) {
+                tosdb_memtable_secondary_index_item_t* s_item = (tosdb_memtable_secondary_index_item_t*)idx_data;
+                idx_data += tosdb_memtable_secondary_index_item_size(s_item);
+            } else {
+                tosdb_memtable_index_item_t* p_item = (tosdb_memtable_index_item_t*)idx_data;
+                idx_data += sizeof(tosdb_memtable_index_item_t) + p_item->key_length;
+            }
+        }
+
+        hashmap_put(src->indexes, (void*)ti->id, cid);
+    }
+
+    return src;
+}
+#pragma GCC diagnostic pop
+
+boolean_t tosdb_compaction_source_free(tosdb_compaction_source_t* src) {
+    if(!src) {
+        return true;
+    }
+
+    if(src->indexes) {
+        iterator_t* iter = hashmap_iterator_create(src->indexes);
+
+        if(!iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction source index iterator");
+
+            return false;
+        }
+
+        while(iter->end_of_iterator(iter) != 0) {
+            tosdb_compaction_index_data_t* cid = (tosdb_compaction_index_data_t*)iter->get_item(iter);
+
+            memory_free(cid->items[0]);
+            memory_free(cid->items);
+            memory_free(cid);
+
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+
+        hashmap_destroy(src->indexes);
+    }
+
+    if(src->valuelog) {
+        memory_free(src->valuelog);
+    }
+
+    memory_free(src);
+
+    return true;
+}
+
+uint64_t tosdb_compaction_survivor_key_generator(const void* key) {
+    uint128_t record_id = *(const uint128_t*)key;
+
+    return (uint64_t)(record_id ^ (record_id >> 64));
+}
+
+int8_t tosdb_compaction_survivor_key_comparator(const void* key1, const void* key2) {
+    uint128_t record_id1 = *(const uint128_t*)key1;
+    uint128_t record_id2 = *(const uint128_t*)key2;
+
+    if(record_id1 < record_id2) {
+        return -1;
+    }
+
+    if(record_id1 > record_id2) {
+        return 1;
+    }
+
+    return 0;
 }
 
-boolean_t tosdb_sstable_level_minor_compact(const tosdb_table_t* tbl, uint64_t level) {
-    UNUSED(tbl);
-    UNUSED(level);
-    NOTIMPLEMENTEDLOG(TOSDB);
-    return false;
+boolean_t tosdb_compaction_bloomfilter_add(tosdb_memtable_index_t* mt_idx, uint8_t* key, uint64_t key_length, uint64_t* key_hash) {
+    if(!key_length) {
+        key_length = sizeof(uint64_t);
+        key = (uint8_t*)key_hash;
+    }
+
+    data_t d_key = {0};
+    d_key.type = DATA_TYPE_INT8_ARRAY;
+    d_key.length = key_length;
+    d_key.value = key;
+
+    return bloomfilter_add(mt_idx->bloomfilter, &d_key);
 }
 
-boolean_t tosdb_sstable_level_major_compact(const tosdb_table_t* tbl, uint64_t level) {
-    UNUSED(tbl);
-    UNUSED(level);
-    NOTIMPLEMENTEDLOG(TOSDB);
-    return false;
+boolean_t tosdb_compaction_merge_primary(tosdb_memtable_t* mt, tosdb_compaction_source_t** srcs, uint64_t src_count,
+                                         boolean_t drop_deleted, tosdb_compaction_survivor_t* survivors, hashmap_t* survivor_map) {
+    uint64_t pk_idx_id = mt->tbl->primary_index_id;
+
+    tosdb_memtable_index_t* mt_idx = (tosdb_memtable_index_t*)hashmap_get(mt->indexes, (void*)pk_idx_id);
+
+    if(!mt_idx) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot find primary index of compaction memtable");
+
+        return false;
+    }
+
+    tosdb_compaction_index_data_t** cids = memory_malloc(sizeof(tosdb_compaction_index_data_t*) * src_count);
+
+    if(!cids) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create merge cursor array");
+
+        return false;
+    }
+
+    uint64_t* positions = memory_malloc(sizeof(uint64_t) * src_count);
+
+    if(!positions) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create merge cursor array");
+        memory_free(cids);
+
+        return false;
+    }
+
+    for(uint64_t i = 0; i < src_count; i++) {
+        cids[i] = (tosdb_compaction_index_data_t*)hashmap_get(srcs[i]->indexes, (void*)pk_idx_id);
+        positions[i] = 0;
+    }
+
+    boolean_t error = false;
+    uint64_t survivor_count = 0;
+
+    // sources are ordered from newest to oldest, at equal keys the lowest source index wins
+    while(true) {
+        int64_t min_src = -1;
+        tosdb_memtable_index_item_t* min_item = NULL;
+
+        for(uint64_t i = 0; i < src_count; i++) {
+            if(!cids[i] || positions[i] >= cids[i]->record_count) {
+                continue;
+            }
+
+            tosdb_memtable_index_item_t* item = (tosdb_memtable_index_item_t*)cids[i]->items[positions[i]];
+
+            if(!min_item || tosdb_memtable_index_comparator(item, min_item) < 0) {
+                min_src = i;
+                min_item = item;
+            }
+        }
+
+        if(min_src == -1) {
+            break;
+        }
+
+        for(uint64_t i = 0; i < src_count; i++) {
+            while(cids[i] && positions[i] < cids[i]->record_count &&
+                  tosdb_memtable_index_comparator(cids[i]->items[positions[i]], min_item) == 0) {
+                positions[i]++;
+            }
+        }
+
+        if(min_item->is_deleted && drop_deleted) {
+            continue;
+        }
+
+        uint64_t item_size = sizeof(tosdb_memtable_index_item_t) + min_item->key_length;
+        tosdb_memtable_index_item_t* new_item = memory_malloc(item_size);
+
+        if(!new_item) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction index item");
+            error = true;
+
+            break;
+        }
+
+        memory_memcopy(min_item, new_item, item_size);
+
+        if(!min_item->is_deleted) {
+            if(min_item->offset + min_item->length > srcs[min_src]->valuelog_size) {
+                PRINTLOG(TOSDB, LOG_ERROR, "value of record is out of valuelog of sstable %lli", srcs[min_src]->stli->sstable_id);
+                memory_free(new_item);
+                error = true;
+
+                break;
+            }
+
+            int64_t offset = tosdb_memtable_values_reserve(mt, min_item->length);
+
+            if(offset == -1) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot append value to compaction valuelog");
+                memory_free(new_item);
+                error = true;
+
+                break;
+            }
+
+            new_item->offset = offset;
+            memory_memcopy(srcs[min_src]->valuelog + min_item->offset, mt->values + offset, min_item->length);
+        }
+
+        if(!tosdb_compaction_bloomfilter_add(mt_idx, new_item->key, new_item->key_length, &new_item->key_hash)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot add primary key to bloomfilter");
+            memory_free(new_item);
+            error = true;
+
+            break;
+        }
+
+        tosdb_memtable_index_item_t* old_item = NULL;
+
+        mt_idx->index->insert(mt_idx->index, new_item, new_item, (void**)&old_item);
+
+        if(old_item) {
+            memory_free(old_item);
+        }
+
+        tosdb_compaction_survivor_t* survivor = &survivors[survivor_count++];
+        survivor->record_id = new_item->record_id;
+        survivor->source = min_src;
+        survivor->is_deleted = new_item->is_deleted;
+        survivor->source_offset = min_item->offset;
+        survivor->offset = new_item->offset;
+        survivor->length = new_item->length;
+
+        hashmap_put(survivor_map, &survivor->record_id, survivor);
+
+        mt->record_count++;
+    }
+
+    memory_free(positions);
+    memory_free(cids);
+
+    return !error;
+}
+
+boolean_t tosdb_compaction_merge_index(tosdb_memtable_index_t* mt_idx, tosdb_compaction_source_t** srcs, uint64_t src_count, hashmap_t* survivor_map) {
+    boolean_t is_secondary = mt_idx->ti->type == TOSDB_INDEX_SECONDARY;
+
+    // older sources are inserted first, so newer items replace them at the unique index
+    for(int64_t i = src_count - 1; i >= 0; i--) {
+        tosdb_compaction_index_data_t* cid = (tosdb_compaction_index_data_t*)hashmap_get(srcs[i]->indexes, (void*)mt_idx->ti->id);
+
+        if(!cid) {
+            continue;
+        }
+
+        for(uint64_t j = 0; j < cid->record_count; j++) {
+            uint128_t* record_id = (uint128_t*)cid->items[j];
+
+            const tosdb_compaction_survivor_t* survivor = hashmap_get(survivor_map, record_id);
+
+            if(!survivor || survivor->source != (uint64_t)i) {
+                continue;
+            }
+
+            void* new_item = NULL;
+
+            if(is_secondary) {
+                tosdb_memtable_secondary_index_item_t* s_item = (tosdb_memtable_secondary_index_item_t*)cid->items[j];
+
+                // older versions of record at same source are stale, only the version of survivor is kept
+                if(s_item->offset != survivor->source_offset) {
+                    continue;
+                }
+
+                uint64_t item_size = tosdb_memtable_secondary_index_item_size(s_item);
+
+                tosdb_memtable_secondary_index_item_t* n_item = memory_malloc(item_size);
+
+                if(!n_item) {
+                    PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction secondary index item");
+
+                    return false;
+                }
+
+                memory_memcopy(s_item, n_item, item_size);
+                n_item->is_primary_key_deleted = survivor->is_deleted;
+                n_item->offset = survivor->offset;
+
+                if(!tosdb_compaction_bloomfilter_add(mt_idx, n_item->data, n_item->secondary_key_length, &n_item->secondary_key_hash)) {
+                    PRINTLOG(TOSDB, LOG_ERROR, "cannot add secondary key to bloomfilter");
+                    memory_free(n_item);
+
+                    return false;
+                }
+
+                new_item = n_item;
+            } else {
+                tosdb_memtable_index_item_t* u_item = (tosdb_memtable_index_item_t*)cid->items[j];
+                uint64_t item_size = sizeof(tosdb_memtable_index_item_t) + u_item->key_length;
+
+                tosdb_memtable_index_item_t* n_item = memory_malloc(item_size);
+
+                if(!n_item) {
+                    PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction unique index item");
+
+                    return false;
+                }
+
+                memory_memcopy(u_item, n_item, item_size);
+                n_item->is_deleted = survivor->is_deleted;
+                n_item->offset = survivor->offset;
+                n_item->length = survivor->length;
+
+                if(!tosdb_compaction_bloomfilter_add(mt_idx, n_item->key, n_item->key_length, &n_item->key_hash)) {
+                    PRINTLOG(TOSDB, LOG_ERROR, "cannot add unique key to bloomfilter");
+                    memory_free(n_item);
+
+                    return false;
+                }
+
+                new_item = n_item;
+            }
+
+            void* old_item = NULL;
+
+            mt_idx->index->insert(mt_idx->index, new_item, new_item, &old_item);
+
+            if(old_item) {
+                memory_free(old_item);
+            }
+        }
+    }
+
+    return true;
+}
+
+boolean_t tosdb_compaction_sstable_list_persist(tosdb_table_t* tbl, list_t* inputs, tosdb_block_sstable_list_item_t* output) {
+    buffer_t* buf_stli = buffer_new_with_capacity(NULL, TOSDB_PAGE_SIZE);
+
+    if(!buf_stli) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list buffer");
+
+        return false;
+    }
+
+    uint64_t stli_cnt = 0;
+    uint64_t max_level = tbl->sstable_max_level;
+
+    if(output) {
+        max_level = MAX(max_level, output->level);
+    }
+
+    boolean_t error = false;
+
+    for(uint64_t i = 1; i <= max_level; i++) {
+        if(output && output->level == i) {
+            buffer_append_bytes(buf_stli, (uint8_t*)output, sizeof(tosdb_block_sstable_list_item_t) + sizeof(tosdb_block_sstable_list_item_index_pair_t) * output->index_count);
+            stli_cnt++;
+        }
+
+        list_t* st_lvl_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)i);
+
+        if(!st_lvl_l) {
+            continue;
+        }
+
+        iterator_t* iter = list_iterator_create(st_lvl_l);
+
+        if(!iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable level iterator");
+            error = true;
+
+            break;
+        }
+
+        while(iter->end_of_iterator(iter) != 0) {
+            tosdb_block_sstable_list_item_t* stli = (tosdb_block_sstable_list_item_t*)iter->get_item(iter);
+
+            if(!tosdb_compaction_inputs_contains(inputs, stli)) {
+                buffer_append_bytes(buf_stli, (uint8_t*)stli, sizeof(tosdb_block_sstable_list_item_t) + sizeof(tosdb_block_sstable_list_item_index_pair_t) * stli->index_count);
+                stli_cnt++;
+            }
+
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+    }
+
+    if(error) {
+        buffer_destroy(buf_stli);
+
+        return false;
+    }
+
+    if(!stli_cnt) {
+        buffer_destroy(buf_stli);
+
+        PRINTLOG(TOSDB, LOG_DEBUG, "all sstables of table %s are compacted away", tbl->name);
+
+        tbl->sstable_list_location = 0;
+        tbl->sstable_list_size = 0;
+        tbl->is_sstable_list_dirty = true;
+        tbl->is_dirty = true;
+
+        return true;
+    }
+
+    uint64_t block_size = sizeof(tosdb_block_sstable_list_t) + buffer_get_length(buf_stli);
+
+    if(block_size % TOSDB_PAGE_SIZE) {
+        block_size += TOSDB_PAGE_SIZE - (block_size % TOSDB_PAGE_SIZE);
+    }
+
+    tosdb_block_sstable_list_t* block = memory_malloc(block_size);
+
+    if(!block) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list block");
+        buffer_destroy(buf_stli);
+
+        return false;
+    }
+
+    // compacted list contains all levels, older list blocks are not needed for loading
+    block->header.block_size = block_size;
+    block->header.block_type = TOSDB_BLOCK_TYPE_SSTABLE_LIST;
+    block->header.previous_block_invalid = true;
+    block->header.previous_block_location = tbl->sstable_list_location;
+    block->header.previous_block_size = tbl->sstable_list_size;
+    block->database_id = tbl->db->id;
+    block->table_id = tbl->id;
+    block->sstable_count = stli_cnt;
+
+    buffer_write_all_into(buf_stli, (uint8_t*)&block->sstables[0]);
+
+    buffer_destroy(buf_stli);
+
+    uint64_t block_loc = tosdb_block_write(tbl->db->tdb, (tosdb_block_header_t*)block);
+
+    memory_free(block);
+
+    if(!block_loc) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot write compacted sstable list of table %s", tbl->name);
+
+        return false;
+    }
+
+    PRINTLOG(TOSDB, LOG_DEBUG, "compacted sstable list for table %s persisted at 0x%llx(0x%llx)", tbl->name, block_loc, block_size);
+
+    tbl->sstable_list_location = block_loc;
+    tbl->sstable_list_size = block_size;
+    tbl->is_sstable_list_dirty = true;
+    tbl->is_dirty = true;
+
+    return true;
+}
+
+boolean_t tosdb_compaction_swap(tosdb_table_t* tbl, list_t* inputs, tosdb_block_sstable_list_item_t* output) {
+    if(!tbl->sstable_levels) {
+        tbl->sstable_levels = hashmap_integer(128);
+
+        if(!tbl->sstable_levels) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable levels map");
+
+            return false;
+        }
+    }
+
+    list_t* out_l = NULL;
+
+    if(output) {
+        out_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)output->level);
+
+        if(!out_l) {
+            out_l = list_create_queue();
+
+            if(!out_l) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list for level");
+
+                return false;
+            }
+
+            hashmap_put(tbl->sstable_levels, (void*)output->level, out_l);
+        }
+    }
+
+    // new list block is written before in memory lists are changed, a failure leaves old sstables in use
+    if(!tosdb_compaction_sstable_list_persist(tbl, inputs, output)) {
+        return false;
+    }
+
+    for(uint64_t i = 0; i <= tbl->sstable_max_level; i++) {
+        list_t* st_l = NULL;
+
+        if(i == 0) {
+            st_l = tbl->sstable_list_items;
+        } else {
+            st_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)i);
+        }
+
+        if(!st_l) {
+            continue;
+        }
+
+        iterator_t* iter = list_iterator_create(st_l);
+
+        if(!iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list iterator");
+
+            return false;
+        }
+
+        while(iter->end_of_iterator(iter) != 0) {
+            if(tosdb_compaction_inputs_contains(inputs, iter->get_item(iter))) {
+                iter->delete_item(iter);
+            }
+
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+    }
+
+    iterator_t* iter = list_iterator_create(inputs);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction input iterator");
+
+        return false;
+    }
+
+    while(iter->end_of_iterator(iter) != 0) {
+        memory_free((void*)iter->get_item(iter));
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(output) {
+        list_stack_push(out_l, output);
+        tbl->sstable_max_level = MAX(tbl->sstable_max_level, output->level);
+    }
+
+    return true;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+boolean_t tosdb_sstable_compact(tosdb_table_t* tbl, list_t* inputs, uint64_t level, boolean_t drop_deleted) {
+    uint64_t src_count = list_size(inputs);
+
+    tosdb_compaction_source_t** srcs = memory_malloc(sizeof(tosdb_compaction_source_t*) * src_count);
+
+    if(!srcs) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction source array");
+
+        return false;
+    }
+
+    boolean_t error = false;
+    uint64_t total_record_count = 0;
+    uint64_t total_valuelog_size = 0;
+    uint64_t src_idx = 0;
+
+    iterator_t* iter = list_iterator_create(inputs);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction input iterator");
+        memory_free(srcs);
+
+        return false;
+    }
+
+    while(iter->end_of_iterator(iter) != 0) {
+        tosdb_block_sstable_list_item_t* stli = (tosdb_block_sstable_list_item_t*)iter->get_item(iter);
+
+        srcs[src_idx] = tosdb_compaction_source_load(tbl, stli);
+
+        if(!srcs[src_idx]) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot load sstable %lli of table %s for compaction", stli->sstable_id, tbl->name);
+            error = true;
+
+            break;
+        }
+
+        tosdb_compaction_index_data_t* cid = (tosdb_compaction_index_data_t*)hashmap_get(srcs[src_idx]->indexes, (void*)tbl->primary_index_id);
+
+        if(cid) {
+            total_record_count += cid->record_count;
+        }
+
+        total_valuelog_size += srcs[src_idx]->valuelog_size;
+
+        src_idx++;
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    tosdb_memtable_t* mt = NULL;
+    tosdb_compaction_survivor_t* survivors = NULL;
+    hashmap_t* survivor_map = NULL;
+
+    if(!error) {
+        // merged valuelog is bounded by inputs
+        mt = tosdb_memtable_new_internal(tbl, MAX(total_valuelog_size, 1ULL));
+        survivors = memory_malloc(sizeof(tosdb_compaction_survivor_t) * MAX(total_record_count, 1ULL));
+        survivor_map = hashmap_new_with_hkg_with_hkc(MAX(total_record_count, 128ULL),
+                                                     tosdb_compaction_survivor_key_generator,
+                                                     tosdb_compaction_survivor_key_comparator);
+
+        if(mt) {
+            mt->tbl = tbl;
+            mt->level = level;
+        }
+
+        if(!mt || !survivors || !survivor_map) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction memtable for table %s", tbl->name);
+            error = true;
+        }
+    }
+
+    if(!error) {
+        // merged sstable can be larger than a memtable, bloom filters are sized with input record count
+        iterator_t* idx_iter = hashmap_iterator_create(mt->indexes);
+
+        if(!idx_iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction memtable index iterator");
+            error = true;
+        }
+
+        while(!error && idx_iter->end_of_iterator(idx_iter) != 0) {
+            tosdb_memtable_index_t* mt_idx = (tosdb_memtable_index_t*)idx_iter->get_item(idx_iter);
+
+            bloomfilter_destroy(mt_idx->bloomfilter);
+            mt_idx->bloomfilter = bloomfilter_new_blocked(MAX(total_record_count, 1ULL), 0.1);
+
+            if(!mt_idx->bloomfilter) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction bloomfilter");
+                error = true;
+            }
+
+            idx_iter = idx_iter->next(idx_iter);
+        }
+
+        if(idx_iter) {
+            idx_iter->destroy(idx_iter);
+        }
+    }
+
+    if(!error) {
+        error = !tosdb_compaction_merge_primary(mt, srcs, src_count, drop_deleted, survivors, survivor_map);
+    }
+
+    if(!error) {
+        iterator_t* idx_iter = hashmap_iterator_create(mt->indexes);
+
+        if(!idx_iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction memtable index iterator");
+            error = true;
+        }
+
+        while(!error && idx_iter->end_of_iterator(idx_iter) != 0) {
+            tosdb_memtable_index_t* mt_idx = (tosdb_memtable_index_t*)idx_iter->get_item(idx_iter);
+
+            if(mt_idx->ti->id != tbl->primary_index_id) {
+                error = !tosdb_compaction_merge_index(mt_idx, srcs, src_count, survivor_map);
+            }
+
+            idx_iter = idx_iter->next(idx_iter);
+        }
+
+        if(idx_iter) {
+            idx_iter->destroy(idx_iter);
+        }
+    }
+
+    for(uint64_t i = 0; i < src_idx; i++) {
+        tosdb_compaction_source_free(srcs[i]);
+    }
+
+    memory_free(srcs);
+
+    if(survivor_map) {
+        hashmap_destroy(survivor_map);
+    }
+
+    if(survivors) {
+        memory_free(survivors);
+    }
+
+    tosdb_block_sstable_list_item_t* output = NULL;
+
+    if(!error && mt->record_count) {
+        mt->id = tbl->memtable_next_id;
+        tbl->memtable_next_id++;
+        tbl->is_dirty = true;
+
+        if(!tosdb_memtable_persist(mt)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot persist compacted sstable of table %s", tbl->name);
+            error = true;
+        }
+
+        output = mt->stli;
+        mt->stli = NULL;
+    }
+
+    if(mt) {
+        tosdb_memtable_free(mt);
+    }
+
+    if(!error) {
+        PRINTLOG(TOSDB, LOG_DEBUG, "table %s %lli sstables with %lli records are compacted into level %lli with %lli records",
+                 tbl->name, src_count, total_record_count, level, output?output->record_count:0);
+
+        error = !tosdb_compaction_swap(tbl, inputs, output);
+    }
+
+    if(error && output) {
+        memory_free(output);
+    }
+
+    return !error;
+}
+#pragma GCC diagnostic pop
+
+uint64_t tosdb_compaction_level_sstable_count(const tosdb_table_t* tbl, uint64_t level) {
+    uint64_t count = 0;
+
+    if(level == 1 && tbl->sstable_list_items) {
+        count += list_size(tbl->sstable_list_items);
+    }
+
+    if(tbl->sstable_levels) {
+        list_t* st_lvl_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)level);
+
+        if(st_lvl_l) {
+            count += list_size(st_lvl_l);
+        }
+    }
+
+    return count;
+}
+
+boolean_t tosdb_compaction_table_schedule(tosdb_table_t* tbl) {
+    if(!tbl->is_open || tbl->is_deleted) {
+        return true;
+    }
+
+    const tosdb_compaction_config_t* config = &tbl->db->tdb->compaction_config;
+
+    boolean_t error = false;
+
+    uint64_t level1_count = tosdb_compaction_level_sstable_count(tbl, 1);
+
+    // stalled writers wait for us even if trigger is disabled
+    if((config->level1_trigger_count && level1_count >= config->level1_trigger_count) ||
+       (config->level1_stall_count && level1_count >= config->level1_stall_count)) {
+        PRINTLOG(TOSDB, LOG_DEBUG, "table %s level 1 has %lli sstables, merging into level 2", tbl->name, level1_count);
+
+        error |= !tosdb_sstable_level_major_compact(tbl, 1);
+    }
+
+    if(config->level_trigger_count) {
+        for(uint64_t i = 2; i <= tbl->sstable_max_level; i++) {
+            uint64_t level_count = tosdb_compaction_level_sstable_count(tbl, i);
+
+            if(level_count >= config->level_trigger_count) {
+                PRINTLOG(TOSDB, LOG_DEBUG, "table %s level %lli has %lli sstables, compacting", tbl->name, i, level_count);
+
+                error |= !tosdb_sstable_level_minor_compact(tbl, i);
+            }
+        }
+    }
+
+    return !error;
+}
+
+boolean_t tosdb_compaction_schedule(tosdb_t* tdb) {
+    iterator_t* db_iter = hashmap_iterator_create(tdb->databases);
+
+    if(!db_iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create db iterator");
+
+        return false;
+    }
+
+    boolean_t error = false;
+
+    while(!tdb->compaction_task_stop && db_iter->end_of_iterator(db_iter) != 0) {
+        tosdb_database_t* db = (tosdb_database_t*)db_iter->get_item(db_iter);
+
+        if(db->is_open && !db->is_deleted && db->tables) {
+            iterator_t* tbl_iter = hashmap_iterator_create(db->tables);
+
+            if(!tbl_iter) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot create table iterator");
+                error = true;
+            }
+
+            while(tbl_iter && !tdb->compaction_task_stop && tbl_iter->end_of_iterator(tbl_iter) != 0) {
+                tosdb_table_t* tbl = (tosdb_table_t*)tbl_iter->get_item(tbl_iter);
+
+                error |= !tosdb_compaction_table_schedule(tbl);
+
+                tbl_iter = tbl_iter->next(tbl_iter);
+            }
+
+            if(tbl_iter) {
+                tbl_iter->destroy(tbl_iter);
+            }
+        }
+
+        db_iter = db_iter->next(db_iter);
+    }
+
+    db_iter->destroy(db_iter);
+
+    return !error;
+}
+
+int32_t tosdb_compaction_task(int32_t argc, void** argv) {
+    if(argc != 1 || !argv || !argv[0]) {
+        PRINTLOG(TOSDB, LOG_ERROR, "invalid argument count");
+
+        return -1;
+    }
+
+    tosdb_t* tdb = (tosdb_t*)argv[0];
+
+    while(!tdb->compaction_task_end) {
+        // busy flag is set under lock, so tosdb_compaction_task_stop cannot miss a starting compaction
+        lock_acquire(tdb->lock);
+        boolean_t stop = tdb->compaction_task_stop;
+        tdb->compaction_task_busy = !stop;
+        lock_release(tdb->lock);
+
+        // compaction writes blocks while foreground persists and wal flushes write too, it holds only table locks.
+        // block space is reserved under block lock and superblock is written under tosdb lock, so it needs no more
+        if(!stop) {
+            tdb->compaction_task_failed = !tosdb_compaction_schedule(tdb);
+
+            if(tdb->compaction_task_failed) {
+                PRINTLOG(TOSDB, LOG_WARNING, "background compaction failed");
+            }
+
+            tdb->compaction_task_busy = false;
+        }
+
+        if(tdb->compaction_task_end) {
+            break;
+        }
+
+        task_set_message_waiting();
+        task_yield();
+    }
+
+    tdb->compaction_task_id = 0;
+
+    return 0;
+}
+
+boolean_t tosdb_compaction_task_start(tosdb_t* tdb) {
+    if(!tdb) {
+        return false;
+    }
+
+    if(tdb->compaction_task_id) {
+        return true;
+    }
+
+    void** args = memory_malloc(sizeof(void*));
+
+    if(!args) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create compaction task arguments");
+
+        return false;
+    }
+
+    args[0] = tdb;
+
+    tdb->compaction_task_stop = false;
+    tdb->compaction_task_end = false;
+    tdb->compaction_task_failed = false;
+
+    // compaction outputs live at table sstable lists after task ends, so task allocates from default heap
+    uint64_t task_id = task_create_task_with_default_heap(NULL, 64 << 10, tosdb_compaction_task, 1, args, "tosdb compaction");
+
+    if(task_id == -1ULL) {
+        PRINTLOG(TOSDB, LOG_WARNING, "cannot create compaction task, writers will compact when stalled");
+        memory_free(args);
+        tdb->compaction_task_id = 0;
+
+        return false;
+    }
+
+    tdb->compaction_task_id = task_id;
+
+    return true;
+}
+
+boolean_t tosdb_compaction_task_stop(tosdb_t* tdb) {
+    if(!tdb) {
+        return false;
+    }
+
+    lock_acquire(tdb->lock);
+    tdb->compaction_task_stop = true;
+    lock_release(tdb->lock);
+
+    while(tdb->compaction_task_busy) {
+        task_yield();
+    }
+
+    return true;
+}
+
+boolean_t tosdb_compaction_task_end(tosdb_t* tdb) {
+    if(!tdb) {
+        return false;
+    }
+
+    uint64_t task_id = tdb->compaction_task_id;
+
+    if(!task_id) {
+        return true;
+    }
+
+    tdb->compaction_task_stop = true;
+    tdb->compaction_task_end = true;
+
+    while(tdb->compaction_task_id) {
+        task_clear_message_waiting(task_id);
+        task_yield();
+    }
+
+    return true;
+}
+
+boolean_t tosdb_compaction_throttle_writer(tosdb_table_t* tbl) {
+    if(!tbl) {
+        return false;
+    }
+
+    tosdb_t* tdb = tbl->db->tdb;
+    const tosdb_compaction_config_t* config = &tdb->compaction_config;
+
+    uint64_t task_id = tdb->compaction_task_id;
+    uint64_t level1_count = tosdb_compaction_level_sstable_count(tbl, 1);
+
+    if(task_id && config->level1_trigger_count && level1_count >= config->level1_trigger_count) {
+        task_clear_message_waiting(task_id);
+    }
+
+    if(!config->level1_stall_count || level1_count < config->level1_stall_count) {
+        return true;
+    }
+
+    if(!task_id || tdb->compaction_task_stop) {
+        PRINTLOG(TOSDB, LOG_DEBUG, "table %s level 1 has %lli sstables, writer compacts", tbl->name, level1_count);
+
+        return tosdb_sstable_level_major_compact(tbl, 1);
+    }
+
+    PRINTLOG(TOSDB, LOG_DEBUG, "table %s level 1 has %lli sstables, writer is stalled", tbl->name, level1_count);
+
+    while(tdb->compaction_task_id && !tdb->compaction_task_stop &&
+          tosdb_compaction_level_sstable_count(tbl, 1) >= config->level1_stall_count) {
+        // level cannot shrink if compaction fails, waiting forever would hang the writer
+        if(tdb->compaction_task_failed) {
+            PRINTLOG(TOSDB, LOG_ERROR, "table %s level 1 cannot be compacted, stalled writer fails", tbl->name);
+
+            return false;
+        }
+
+        task_clear_message_waiting(task_id);
+        task_yield();
+    }
+
+    return true;
+}
+
+boolean_t tosdb_compaction_config_set(tosdb_t* tdb, tosdb_compaction_config_t* config) {
+    if(!tdb || !config) {
+        PRINTLOG(TOSDB, LOG_ERROR, "required fields are null");
+
+        return false;
+    }
+
+    lock_acquire(tdb->lock);
+    memory_memcopy(config, &tdb->compaction_config, sizeof(tosdb_compaction_config_t));
+    lock_release(tdb->lock);
+
+    if(tdb->compaction_task_id) {
+        task_clear_message_waiting(tdb->compaction_task_id);
+    }
+
+    return true;
 }
@@ -23,7 +23,7 @@ boolean_t tosdb_database_load_tables(tosdb_database_t* db) {
     }
 
     if(!db->tables) {
-        db->tables = hashmap_string(128);
+        db->tables = hashmap_string_concurrent(128);
     }
 
     if(!db->tables) {
@@ -36,14 +36,16 @@ boolean_t tosdb_database_load_tables(tosdb_database_t* db) {
     uint64_t tbl_list_size = db->table_list_size;
 
     while(tbl_list_loc != 0) {
-        tosdb_block_table_list_t* tbl_list = (tosdb_block_table_list_t*)tosdb_block_read(db->tdb, tbl_list_loc, tbl_list_size);
+        tosdb_cached_block_t* tbl_list_blk = tosdb_block_acquire(db->tdb, tbl_list_loc, tbl_list_size);
 
-        if(!tbl_list) {
+        if(!tbl_list_blk) {
             PRINTLOG(TOSDB, LOG_ERROR, "cannot read table list");
 
             return false;
         }
 
+        tosdb_block_table_list_t* tbl_list = (tosdb_block_table_list_t*)tbl_list_blk->block;
+
         char_t name_buf[TOSDB_NAME_MAX_LEN + 1] = {0};
 
         for(uint64_t i = 0; i < tbl_list->table_count; i++) {
@@ -58,7 +60,7 @@ boolean_t tosdb_database_load_tables(tosdb_database_t* db) {
 
             if(!tbl) {
                 PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate tbl");
-                memory_free(tbl_list);
+                tosdb_block_release(tbl_list_blk);
 
                 return false;
             }
@@ -77,7 +79,7 @@ boolean_t tosdb_database_load_tables(tosdb_database_t* db) {
 
 
         if(tbl_list->header.previous_block_invalid) {
-            memory_free(tbl_list);
+            tosdb_block_release(tbl_list_blk);
 
             break;
         }
@@ -85,7 +87,7 @@ boolean_t tosdb_database_load_tables(tosdb_database_t* db) {
         tbl_list_loc = tbl_list->header.previous_block_location;
         tbl_list_size = tbl_list->header.previous_block_size;
 
-        memory_free(tbl_list);
+        tosdb_block_release(tbl_list_blk);
     }
 
     return true;
@@ -209,7 +211,7 @@ tosdb_database_t* tosdb_database_create_or_open(tosdb_t* tdb, const char_t* name
     db->is_dirty = true;
 
     db->table_next_id = 1;
-    db->tables = hashmap_string(128);
+    db->tables = hashmap_string_concurrent(128);
 
     db->sequences = hashmap_string(128);
 
@@ -271,6 +273,7 @@ boolean_t tosdb_database_close(tosdb_database_t* db) {
             }
 
             hashmap_destroy(db->sequences);
+            db->sequences = NULL;
         } else {
             PRINTLOG(TOSDB, LOG_TRACE, "database %s has no sequences", db->name);
         }
@@ -347,6 +350,30 @@ boolean_t tosdb_database_free(tosdb_database_t* db) {
         hashmap_destroy(db->tables);
     }
 
+    // sequences are left when database is not closed
+    if(db->sequences) {
+        iterator_t* iter = hashmap_iterator_create(db->sequences);
+
+        if(!iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create sequence iterator");
+            error = true;
+        } else {
+            while(iter->end_of_iterator(iter) != 0) {
+                tosdb_sequence_t* seq = (tosdb_sequence_t*)iter->get_item(iter);
+
+                seq->this_record->destroy(seq->this_record);
+                lock_destroy(seq->lock);
+                memory_free(seq);
+
+                iter = iter->next(iter);
+            }
+
+            iter->destroy(iter);
+        }
+
+        hashmap_destroy(db->sequences);
+    }
+
     hashmap_destroy(db->table_new);
 
     memory_free(db->name);
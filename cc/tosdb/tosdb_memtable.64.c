@@ -9,8 +9,10 @@
 
 #include <tosdb/tosdb.h>
 #include <tosdb/tosdb_internal.h>
+#include <tosdb/wal.h>
 #include <logging.h>
-#include <bplustree.h>
+#include <skiplist.h>
+#include <cpu/task.h>
 #include <compression.h>
 #include <strings.h>
 
@@ -141,6 +143,10 @@ int8_t tosdb_memtable_secondary_index_record_id_comparator(const void* i1, const
     return 0;
 }
 
+uint64_t tosdb_memtable_secondary_index_item_size(const tosdb_memtable_secondary_index_item_t* item) {
+    return sizeof(tosdb_memtable_secondary_index_item_t) + item->secondary_key_length + item->primary_key_length + item->covered_length;
+}
+
 static int8_t tosdb_memtable_secondary_index_key_destroyer(memory_heap_t* heap, void* key) {
     memory_free_ext(heap, key);
     return 0;
@@ -153,7 +159,7 @@ static int8_t tosdb_memtable_secondary_index_key_cloner(memory_heap_t* heap, con
 
     tosdb_memtable_secondary_index_item_t* src = (tosdb_memtable_secondary_index_item_t*)key;
 
-    uint64_t key_size = sizeof(tosdb_memtable_index_item_t) + src->secondary_key_length + src->primary_key_length;
+    uint64_t key_size = tosdb_memtable_secondary_index_item_size(src);
 
     *cloned_key = memory_malloc_ext(heap, key_size, 0);
 
@@ -168,7 +174,7 @@ static int8_t tosdb_memtable_secondary_index_key_cloner(memory_heap_t* heap, con
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl) {
+tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl, uint64_t valuelog_capacity) {
     tosdb_memtable_t* mt = memory_malloc(sizeof(tosdb_memtable_t));
 
     if(!mt) {
@@ -178,7 +184,8 @@ tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl) {
     }
 
     mt->is_dirty = true;
-    mt->values = buffer_new_with_capacity(NULL, tbl->max_valuelog_size);
+    mt->values_capacity = valuelog_capacity;
+    mt->values = memory_malloc(valuelog_capacity);
 
     if(!mt->values) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot create valuelog for table %s at memory", tbl->name);
@@ -187,11 +194,22 @@ tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl) {
         return NULL;
     }
 
+    mt->retired_items = list_create_list();
+
+    if(!mt->retired_items) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create retired item list for table %s at memory", tbl->name);
+        memory_free(mt->values);
+        memory_free(mt);
+
+        return NULL;
+    }
+
     mt->indexes = hashmap_integer(128);
 
     if(!mt->indexes) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable indexes for table %s at memory", tbl->name);
-        buffer_destroy(mt->values);
+        list_destroy(mt->retired_items);
+        memory_free(mt->values);
         memory_free(mt);
 
         return NULL;
@@ -211,8 +229,10 @@ tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl) {
             break;
         }
 
+        hashmap_put(mt->indexes, (void*)index->id, (void*)mt_idx);
+
         mt_idx->ti = index;
-        mt_idx->bloomfilter = bloomfilter_new(tbl->max_record_count, 0.1);
+        mt_idx->bloomfilter = bloomfilter_new_blocked(tbl->max_record_count, 0.1);
 
         if(!mt_idx->bloomfilter) {
             error = true;
@@ -221,8 +241,8 @@ tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl) {
 
         boolean_t idx_unique = true;
         index_key_comparator_f cmp = tosdb_memtable_index_comparator;
-        bplustree_key_destroyer_f key_destroyer = tosdb_memtable_index_key_destroyer;
-        bplustree_key_cloner_f key_cloner = tosdb_memtable_index_key_cloner;
+        skiplist_key_destroyer_f key_destroyer = tosdb_memtable_index_key_destroyer;
+        skiplist_key_cloner_f key_cloner = tosdb_memtable_index_key_cloner;
 
         if(index->type == TOSDB_INDEX_SECONDARY) {
             idx_unique = false;
@@ -231,20 +251,21 @@ tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl) {
             key_cloner = tosdb_memtable_secondary_index_key_cloner;
         }
 
-        mt_idx->index = bplustree_create_index_with_unique(32, cmp, idx_unique);
-        bplustree_set_key_destroyer(mt_idx->index, key_destroyer);
-        bplustree_set_key_cloner(mt_idx->index, key_cloner);
+        // skiplist accepts inserts from many writers at once, readers never block
+        mt_idx->index = skiplist_create_index_with_unique(cmp, idx_unique);
 
         if(!mt_idx->index) {
             error = true;
             break;
         }
 
+        skiplist_set_key_destroyer(mt_idx->index, key_destroyer);
+        skiplist_set_key_cloner(mt_idx->index, key_cloner);
+
         if(index->type == TOSDB_INDEX_SECONDARY) {
-            bplustree_set_comparator_for_unique_subpart_for_non_unique_index(mt_idx->index, tosdb_memtable_secondary_index_record_id_comparator);
+            skiplist_set_comparator_for_unique_subpart_for_non_unique_index(mt_idx->index, tosdb_memtable_secondary_index_record_id_comparator);
         }
 
-        hashmap_put(mt->indexes, (void*)index->id, (void*)mt_idx);
         iter = iter->next(iter);
     }
 
@@ -252,14 +273,14 @@ tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl) {
 
     if(error) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot build memory index map for table %s", tbl->name);
-        buffer_destroy(mt->values);
 
         iterator_t* mt_idx_iter = hashmap_iterator_create(mt->indexes);
 
         if(!mt_idx_iter) {
             PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable index iterator for cleanup for table %s", tbl->name);
             hashmap_destroy(mt->indexes);
-            buffer_destroy(mt->values);
+            list_destroy(mt->retired_items);
+            memory_free(mt->values);
             memory_free(mt);
 
             return NULL;
@@ -271,7 +292,7 @@ tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl) {
             bloomfilter_destroy(mt_idx->bloomfilter);
 
             if(mt_idx->index) {
-                bplustree_destroy_index(mt_idx->index);
+                skiplist_destroy_index(mt_idx->index);
             }
 
             memory_free(mt_idx);
@@ -282,6 +303,8 @@ tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl) {
         mt_idx_iter->destroy(mt_idx_iter);
 
         hashmap_destroy(mt->indexes);
+        list_destroy(mt->retired_items);
+        memory_free(mt->values);
         memory_free(mt);
 
         return NULL;
@@ -307,7 +330,7 @@ boolean_t tosdb_memtable_new(tosdb_table_t * tbl) {
         }
     }
 
-    tosdb_memtable_t* mt = tosdb_memtable_new_internal(tbl);
+    tosdb_memtable_t* mt = tosdb_memtable_new_internal(tbl, tbl->max_valuelog_size);
 
     if(!mt) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable for table %s", tbl->name);
@@ -315,30 +338,91 @@ boolean_t tosdb_memtable_new(tosdb_table_t * tbl) {
         return false;
     }
 
-    boolean_t error = false;
-
     mt->tbl = tbl;
     mt->id = tbl->memtable_next_id;
     tbl->memtable_next_id++;
     tbl->is_dirty = true;
 
-    if(tbl->current_memtable) {
-        mt->level = tbl->current_memtable->level; // current memtable level
-        tbl->current_memtable->is_full = true;
-        tbl->current_memtable->is_readonly = true;
-    } else {
-        mt->level = 1;
+    // records of memtable are logged after it is created, so they are at this wal block or newer ones
+    mt->wal_sequence = tosdb_wal_get_sequence(tbl->db->tdb->wal);
+
+    if(!tbl->wal_sequence) {
+        tbl->wal_sequence = mt->wal_sequence;
     }
 
-    if(tbl->current_memtable && !tosdb_memtable_persist(tbl->current_memtable)) {
-        return false;
+    tosdb_memtable_t* old_mt = tbl->current_memtable;
+
+    if(old_mt) {
+        mt->level = old_mt->level; // current memtable level
+        old_mt->is_full = true;
+        old_mt->is_readonly = true;
+
+        // writers which pinned memtable before rotation are not waited, last of them persists it
+        __atomic_fetch_or(&old_mt->writer_count, TOSDB_MEMTABLE_WRITERS_CLOSED, __ATOMIC_SEQ_CST);
+    } else {
+        mt->level = 1;
     }
 
     tbl->current_memtable = mt;
     list_stack_push(tbl->memtables, mt);
 
+    return tosdb_memtable_persist_rotated(tbl);
+}
+#pragma GCC diagnostic pop
+
+boolean_t tosdb_memtable_persist_rotated(tosdb_table_t* tbl) {
+    boolean_t error = false;
+
+    // stack top is the newest memtable, rotated ones are persisted from the oldest
+    uint64_t idx = list_size(tbl->memtables);
+
+    while(idx > 0) {
+        idx--;
+
+        tosdb_memtable_t* mt = (tosdb_memtable_t*)list_get_data_at_position(tbl->memtables, idx);
+
+        if(mt == tbl->current_memtable || !mt->is_dirty) {
+            continue;
+        }
+
+        // newer memtables wait it, otherwise their sstables would be older than its sstable at level 1
+        if(__atomic_load_n(&mt->writer_count, __ATOMIC_ACQUIRE) & ~TOSDB_MEMTABLE_WRITERS_CLOSED) {
+            break;
+        }
+
+        if(!tosdb_memtable_persist(mt)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot persist memtable %lli of table %s", mt->id, tbl->name);
+            error = true;
+
+            break;
+        }
+
+        // persisted memtable becomes reachable from superblock, so wal can drop its records
+        if(!tosdb_table_checkpoint(tbl, mt)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot checkpoint memtable %lli of table %s", mt->id, tbl->name);
+            error = true;
+
+            break;
+        }
+
+        if(!mt->stli) {
+            // sstable of memtable is at its level now, keeping memtable would make readers see records twice
+            list_delete_at_position(tbl->memtables, idx);
+
+            if(!tosdb_memtable_free(mt)) {
+                error = true;
+            }
+        }
+    }
+
     while(list_size(tbl->memtables) > tbl->max_memtable_count)  {
-        tosdb_memtable_t* r_mt = (tosdb_memtable_t*)list_delete_at_tail(tbl->memtables);
+        tosdb_memtable_t* r_mt = (tosdb_memtable_t*)list_get_data_at_position(tbl->memtables, list_size(tbl->memtables) - 1);
+
+        if(r_mt == tbl->current_memtable || r_mt->is_dirty) {
+            break;
+        }
+
+        list_delete_at_tail(tbl->memtables);
 
         if(!tosdb_memtable_free(r_mt)) {
             error = true;
@@ -347,7 +431,6 @@ boolean_t tosdb_memtable_new(tosdb_table_t * tbl) {
 
     return !error;
 }
-#pragma GCC diagnostic pop
 
 boolean_t tosdb_memtable_free(tosdb_memtable_t* mt) {
     if(!mt) {
@@ -374,7 +457,8 @@ boolean_t tosdb_memtable_free(tosdb_memtable_t* mt) {
     if(!mt_idx_iter) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable index iterator for cleanup for table %s", mt->tbl->name);
         hashmap_destroy(mt->indexes);
-        buffer_destroy(mt->values);
+        list_destroy_with_data(mt->retired_items);
+        memory_free(mt->values);
         memory_free(mt);
 
         return false;
@@ -404,7 +488,7 @@ boolean_t tosdb_memtable_free(tosdb_memtable_t* mt) {
 
             }
 
-            bplustree_destroy_index(mt_idx->index);
+            skiplist_destroy_index(mt_idx->index);
         }
 
         memory_free(mt_idx);
@@ -416,94 +500,51 @@ boolean_t tosdb_memtable_free(tosdb_memtable_t* mt) {
 
     hashmap_destroy(mt->indexes);
 
-    buffer_destroy(mt->values);
+    list_destroy_with_data(mt->retired_items);
+    memory_free(mt->values);
     memory_free(mt);
 
     return !error;
 }
 
-boolean_t tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t * record, boolean_t del, tosdb_memtable_t** mt_out) {
-    if(!record || !record->context) {
-        PRINTLOG(TOSDB, LOG_ERROR, "record is null");
+static inline uint64_t tosdb_memtable_fetch_add(volatile uint64_t* target, uint64_t value) {
+    __asm__ __volatile__ ("lock xaddq %[value], %[target]\n" : [value] "+r" (value), [target] "+m" (*target) : : "memory");
+    return value;
+}
 
-        return false;
+int64_t tosdb_memtable_values_reserve(tosdb_memtable_t* mt, uint64_t length) {
+    if(!mt) {
+        return -1;
     }
 
-    tosdb_record_context_t* r_ctx = record->context;
-    tosdb_table_t* tbl = r_ctx->table;
-
-    if(hashmap_size(tbl->indexes) != hashmap_size(r_ctx->keys)) {
-        if(del) {
-            if(!record->get_record(record)) {
-                PRINTLOG(TOSDB, LOG_ERROR, "required columns are missing from record for table %s", tbl->name);
+    uint64_t offset = tosdb_memtable_fetch_add(&mt->values_length, length);
 
-                return false;
-            }
-        } else {
-            PRINTLOG(TOSDB, LOG_ERROR, "required columns are missing from record for table %s", tbl->name);
-
-            return false;
-        }
+    if(offset + length > mt->values_capacity) {
+        return -1;
     }
 
+    return offset;
+}
 
-    uint64_t offset = 0;
-    uint64_t length = 0;
-
-    if(!del) {
-        data_t* sd = tosdb_record_serialize(record);
-
-        if(!sd) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot serialize record");
-
-            return false;
-        }
-
-        if(buffer_get_length(mt->values) > tbl->max_valuelog_size ||
-           mt->record_count == tbl->max_record_count) {
-            if(tbl->current_memtable == mt) {
-                if(!tosdb_memtable_new(tbl)) {
-                    memory_free(sd->value);
-                    memory_free(sd);
-                    PRINTLOG(TOSDB, LOG_ERROR, "cannot create a new memtable for table %s", tbl->name);
-
-                    return false;
-                }
-
-                mt = tbl->current_memtable;
-            } else if(mt_out) {
-                uint64_t old_level = mt->level;
-                mt = tosdb_memtable_new_internal(tbl);
-
-                if(!mt) {
-                    memory_free(sd->value);
-                    memory_free(sd);
-                    PRINTLOG(TOSDB, LOG_ERROR, "cannot create a new memtable for table %s", tbl->name);
-
-                    return false;
-                }
-
-                mt->level = old_level;
-
-                *mt_out = mt;
-            } else {
-                memory_free(sd->value);
-                memory_free(sd);
-                PRINTLOG(TOSDB, LOG_ERROR, "cannot create a new memtable for table %s", tbl->name);
+uint64_t tosdb_memtable_values_size(const tosdb_memtable_t* mt) {
+    if(!mt) {
+        return 0;
+    }
 
-                return false;
-            }
-        }
+    return MIN(mt->values_length, mt->values_capacity);
+}
 
-        offset = buffer_get_position(mt->values);
-        length = sd->length;
-        buffer_append_bytes(mt->values, sd->value, sd->length);
+boolean_t tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t * record, boolean_t del, uint64_t offset, uint64_t length, uint64_t sequence) {
+    if(!mt || !record || !record->context) {
+        PRINTLOG(TOSDB, LOG_ERROR, "memtable or record is null");
 
-        memory_free(sd->value);
-        memory_free(sd);
+        return false;
     }
 
-    boolean_t need_rc_inc = true;
+    tosdb_record_context_t* r_ctx = record->context;
+    tosdb_table_t* tbl = r_ctx->table;
+
+    boolean_t need_rc_dec = false;
 
     iterator_t* iter = hashmap_iterator_create(tbl->indexes);
 
@@ -571,10 +612,11 @@ boolean_t tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t *
 
             tosdb_memtable_index_item_t* old_item = NULL;
 
-            mt_idx->index->insert(mt_idx->index, idx_item, idx_item, (void**)&old_item);
+            // older record of key can arrive later, it is returned back as the removed one
+            skiplist_insert_with_order(mt_idx->index, idx_item, idx_item, sequence, (void**)&old_item);
 
             if(old_item) {
-                need_rc_inc = false;
+                need_rc_dec = true;
                 pri_uniq_idx_removed = true;
                 pri_uniq_idx_remove_count++;
 
@@ -586,18 +628,31 @@ boolean_t tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t *
                     PRINTLOG(TOSDB, LOG_ERROR, "pri/uniq %lli new offset: %llx old offset: %llx", index->id, idx_item->offset, old_item->offset);
                 }
 
-                memory_free(old_item);
+                list_list_insert(mt->retired_items, old_item);
             }
 
         } else {
             const tosdb_record_key_t* pri_r_key = hashmap_get(r_ctx->keys, (void*)tbl->primary_index_id);
-            uint64_t sec_idx_item_len = sizeof(tosdb_memtable_secondary_index_item_t) + r_key->key_length + pri_r_key->key_length;
+
+            data_t* covered = NULL;
+
+            if(index->covered_columns && !del) {
+                covered = tosdb_record_serialize_covered(record, index->covered_columns);
+            }
+
+            uint64_t covered_length = covered ? covered->length : 0;
+            uint64_t sec_idx_item_len = sizeof(tosdb_memtable_secondary_index_item_t) + r_key->key_length + pri_r_key->key_length + covered_length;
 
             tosdb_memtable_secondary_index_item_t* sec_idx_item = memory_malloc(sec_idx_item_len);
 
             if(!sec_idx_item) {
                 PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable secondary index item for table %s", tbl->name);
 
+                if(covered) {
+                    memory_free(covered->value);
+                    memory_free(covered);
+                }
+
                 return false;
             }
 
@@ -607,10 +662,18 @@ boolean_t tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t *
             sec_idx_item->primary_key_length = pri_r_key->key_length;
             sec_idx_item->is_primary_key_deleted = del;
             sec_idx_item->record_id = r_ctx->record_id;
+            sec_idx_item->offset = offset;
+            sec_idx_item->covered_length = covered_length;
 
             memory_memcopy(r_key->key, sec_idx_item->data, r_key->key_length);
             memory_memcopy(pri_r_key->key, sec_idx_item->data + r_key->key_length, pri_r_key->key_length);
 
+            if(covered) {
+                memory_memcopy(covered->value, sec_idx_item->data + r_key->key_length + pri_r_key->key_length, covered_length);
+                memory_free(covered->value);
+                memory_free(covered);
+            }
+
             uint8_t* u8_key = r_key->key;
             uint64_t u8_key_length = r_key->key_length;
 
@@ -633,7 +696,7 @@ boolean_t tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t *
 
             tosdb_memtable_secondary_index_item_t* old_item = NULL;
 
-            mt_idx->index->insert(mt_idx->index, sec_idx_item, sec_idx_item, (void**)&old_item);
+            skiplist_insert_with_order(mt_idx->index, sec_idx_item, sec_idx_item, sequence, (void**)&old_item);
 
             if(old_item) {
 
@@ -644,7 +707,7 @@ boolean_t tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t *
                     PRINTLOG(TOSDB, LOG_ERROR, "secidx %lli new deleted: %s old deleted: %s", index->id, sec_idx_item->is_primary_key_deleted ? "true" : "false", old_item->is_primary_key_deleted ? "true" : "false");
                 }
 
-                memory_free(old_item);
+                list_list_insert(mt->retired_items, old_item);
             }
         }
 
@@ -657,13 +720,98 @@ boolean_t tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t *
         PRINTLOG(TOSDB, LOG_ERROR, "primary/unique index count %lli is not equal to removed count %lli for table %s", pri_uniq_idx_count, pri_uniq_idx_remove_count, tbl->name);
     }
 
-    if(need_rc_inc) {
-        mt->record_count++;
+    // record slot is reserved by writer, replacing a key gives it back
+    if(need_rc_dec) {
+        tosdb_memtable_fetch_add(&mt->record_count, -1ULL);
     }
 
     return true;
 }
 
+/**
+ * @brief reserves a record slot and valuelog range at current memtable, full memtables are rotated
+ * @details table lock should be held. record count is reserved with an atomic add and it is undone when memtable is
+ * full, writers replacing keys decrease it without table lock.
+ * @param[in] tbl table
+ * @param[in] length valuelog length
+ * @param[out] offset valuelog offset
+ * @return memtable which slot is reserved at, NULL if rotation fails
+ */
+static tosdb_memtable_t* tosdb_memtable_reserve(tosdb_table_t* tbl, uint64_t length, int64_t* offset) {
+    while(true) {
+        tosdb_memtable_t* mt = tbl->current_memtable;
+
+        if(mt && !mt->is_readonly) {
+            uint64_t record_count = tosdb_memtable_fetch_add(&mt->record_count, 1);
+
+            if(record_count < tbl->max_record_count) {
+                *offset = tosdb_memtable_values_reserve(mt, length);
+
+                if(*offset != -1) {
+                    return mt;
+                }
+            }
+
+            tosdb_memtable_fetch_add(&mt->record_count, -1ULL);
+        }
+
+        if(!tosdb_memtable_new(tbl)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create a new memtable for table %s", tbl->name);
+
+            return NULL;
+        }
+    }
+}
+
+/**
+ * @brief unpins memtable, last writer of a rotated memtable persists rotated memtables
+ * @param[in] tbl table
+ * @param[in] mt memtable, it can be freed after unpin
+ * @return true if success
+ */
+static boolean_t tosdb_memtable_unpin(tosdb_table_t* tbl, tosdb_memtable_t* mt) {
+    uint64_t writer_count = tosdb_memtable_fetch_add(&mt->writer_count, -1ULL);
+
+    if(writer_count != (TOSDB_MEMTABLE_WRITERS_CLOSED | 1)) {
+        return true;
+    }
+
+    lock_acquire(tbl->lock);
+
+    boolean_t res = tosdb_memtable_persist_rotated(tbl);
+
+    lock_release(tbl->lock);
+
+    return res;
+}
+
+boolean_t tosdb_memtable_upsert_locked(tosdb_record_t * record, boolean_t del, const data_t* sd, uint64_t sequence) {
+    if(!record || !record->context) {
+        PRINTLOG(TOSDB, LOG_ERROR, "record is null");
+
+        return false;
+    }
+
+    tosdb_record_context_t* r_ctx = record->context;
+    tosdb_table_t* tbl = r_ctx->table;
+
+    int64_t offset = 0;
+    uint64_t length = sd ? sd->length : 0;
+
+    // table lock is held, so memtable can only be rotated by us and it is not persisted before items are inserted
+    tosdb_memtable_t* mt = tosdb_memtable_reserve(tbl, length, &offset);
+
+    if(!mt) {
+        return false;
+    }
+
+    if(sd) {
+        memory_memcopy(sd->value, mt->values + offset, length);
+    }
+
+    return tosdb_memtable_upsert_internal(mt, record, del, offset, length, sequence);
+}
+
 boolean_t tosdb_memtable_upsert(tosdb_record_t * record, boolean_t del) {
     if(!record || !record->context) {
         PRINTLOG(TOSDB, LOG_ERROR, "record is null");
@@ -680,21 +828,110 @@ boolean_t tosdb_memtable_upsert(tosdb_record_t * record, boolean_t del) {
         return false;
     }
 
-    lock_acquire(tbl->lock);
+    if(!tosdb_compaction_throttle_writer(tbl)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot compact stalled level 1 of table %s", tbl->name);
 
-    if(!tbl->current_memtable || tbl->current_memtable->is_readonly) {
-        if(!tosdb_memtable_new(tbl)) {
-            lock_release(tbl->lock);
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot create a new memtable for table %s", tbl->name);
+        return false;
+    }
+
+    if(hashmap_size(tbl->indexes) != hashmap_size(r_ctx->keys)) {
+        if(del) {
+            if(!record->get_record(record)) {
+                PRINTLOG(TOSDB, LOG_ERROR, "required columns are missing from record for table %s", tbl->name);
+
+                return false;
+            }
+        } else {
+            PRINTLOG(TOSDB, LOG_ERROR, "required columns are missing from record for table %s", tbl->name);
 
             return false;
         }
     }
 
-    boolean_t res = tosdb_memtable_upsert_internal(tbl->current_memtable, record, del, NULL);
+    data_t* sd = NULL;
+
+    if(!del) {
+        // serialization and wal item are built before table lock, writers only contend at reservation
+        sd = tosdb_record_serialize(record);
+
+        if(!sd) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot serialize record");
+
+            return false;
+        }
+
+        if(sd->length > tbl->max_valuelog_size) {
+            PRINTLOG(TOSDB, LOG_ERROR, "record size %lli is larger than valuelog size of table %s", sd->length, tbl->name);
+            memory_free(sd->value);
+            memory_free(sd);
+
+            return false;
+        }
+    }
+
+    tosdb_wal_t* wal = tbl->db->tdb->wal;
+    buffer_t* wal_items = NULL;
+
+    if(!tosdb_wal_prepare(wal, &record, &del, 1, &wal_items)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot prepare wal item for table %s", tbl->name);
+
+        if(sd) {
+            memory_free(sd->value);
+            memory_free(sd);
+        }
+
+        return false;
+    }
+
+    int64_t offset = 0;
+    uint64_t length = sd ? sd->length : 0;
+    uint64_t group_sequence = 0;
+    uint64_t sequence = 0;
+    boolean_t res = true;
+
+    lock_acquire(tbl->lock);
+
+    // memtable slot and wal sequence are taken at one point, records of newer memtables are always newer
+    tosdb_memtable_t* mt = tosdb_memtable_reserve(tbl, length, &offset);
+
+    if(!mt) {
+        buffer_destroy(wal_items);
+        res = false;
+    } else {
+        tosdb_memtable_fetch_add(&mt->writer_count, 1);
+
+        if(!tosdb_wal_enqueue(wal, wal_items, 1, &group_sequence, &sequence)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot append record to wal for table %s", tbl->name);
+            tosdb_memtable_fetch_add(&mt->record_count, -1ULL);
+            res = false;
+        }
+    }
 
     lock_release(tbl->lock);
 
+    if(sd) {
+        if(res) {
+            memory_memcopy(sd->value, mt->values + offset, length);
+        }
+
+        memory_free(sd->value);
+        memory_free(sd);
+    }
+
+    if(res) {
+        res = tosdb_memtable_upsert_internal(mt, record, del, offset, length, sequence);
+    }
+
+    if(res && !tosdb_wal_sync(wal, group_sequence)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot commit record to wal for table %s", tbl->name);
+        res = false;
+    }
+
+    // pinned memtable is not persisted until its writers are done, unpin is the last access to it
+    if(mt && !tosdb_memtable_unpin(tbl, mt)) {
+        res = false;
+    }
+
     return res;
 }
 
@@ -717,33 +954,62 @@ boolean_t tosdb_memtable_persist(tosdb_memtable_t* mt) {
 
     boolean_t error = false;
 
-    uint64_t valuelog_unpacked_size = buffer_get_length(mt->values);
-    buffer_t* valuelog_out = buffer_new_with_capacity(NULL, valuelog_unpacked_size);
-
-    buffer_seek(mt->values, 0, BUFFER_SEEK_DIRECTION_START);
+    uint64_t valuelog_unpacked_size = tosdb_memtable_values_size(mt);
+    uint64_t chunk_count = (valuelog_unpacked_size + TOSDB_VALUELOG_CHUNK_SIZE - 1) / TOSDB_VALUELOG_CHUNK_SIZE;
+    uint64_t chunk_table_size = sizeof(tosdb_block_valuelog_chunk_t) * chunk_count;
 
-    const compression_t* compression = mt->tbl->db->tdb->compression;
+    tosdb_block_valuelog_chunk_t* chunks = memory_malloc(MAX(chunk_table_size, sizeof(tosdb_block_valuelog_chunk_t)));
 
-    if(compression->pack(mt->values, valuelog_out) != 0) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot pack valuelog");
-        buffer_destroy(valuelog_out);
+    if(!chunks) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create valuelog chunk table");
 
         return false;
     }
 
-    uint64_t len = buffer_get_length(valuelog_out);
+    buffer_t* valuelog_out = buffer_new_with_capacity(NULL, valuelog_unpacked_size);
 
-    if(valuelog_unpacked_size && !len) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot pack valuelog");
-        buffer_destroy(valuelog_out);
+    if(!valuelog_out) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create valuelog buffer");
+        memory_free(chunks);
 
         return false;
     }
 
+    const compression_t* compression = mt->tbl->db->tdb->compression;
+
+    // each chunk is packed independently, so a record can be read without unpacking whole valuelog
+    for(uint64_t chunk_id = 0; chunk_id < chunk_count; chunk_id++) {
+        uint64_t chunk_start = chunk_id * TOSDB_VALUELOG_CHUNK_SIZE;
+        uint64_t chunk_len = MIN(TOSDB_VALUELOG_CHUNK_SIZE, valuelog_unpacked_size - chunk_start);
+
+        buffer_t* chunk_in = buffer_encapsulate(mt->values + chunk_start, chunk_len);
+        buffer_t* chunk_out = buffer_new_with_capacity(NULL, chunk_len);
+
+        if(!chunk_in || !chunk_out || compression->pack(chunk_in, chunk_out) != 0 || !buffer_get_length(chunk_out)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot pack valuelog chunk %lli", chunk_id);
+            buffer_destroy(chunk_in);
+            buffer_destroy(chunk_out);
+            buffer_destroy(valuelog_out);
+            memory_free(chunks);
+
+            return false;
+        }
+
+        uint64_t packed_size = buffer_get_length(chunk_out);
+
+        chunks[chunk_id].offset = buffer_get_length(valuelog_out);
+        chunks[chunk_id].packed_size = packed_size;
+
+        buffer_append_bytes(valuelog_out, buffer_get_view_at_position(chunk_out, 0, packed_size), packed_size);
+
+        buffer_destroy(chunk_in);
+        buffer_destroy(chunk_out);
+    }
+
     uint64_t ol = 0;
     uint8_t* b_vl_data = buffer_get_all_bytes_and_destroy(valuelog_out, &ol);
 
-    uint64_t b_vl_size = sizeof(tosdb_block_valuelog_t) + ol;
+    uint64_t b_vl_size = sizeof(tosdb_block_valuelog_t) + chunk_table_size + ol;
 
     if(b_vl_size % TOSDB_PAGE_SIZE) {
         b_vl_size += TOSDB_PAGE_SIZE - (b_vl_size % TOSDB_PAGE_SIZE);
@@ -754,6 +1020,7 @@ boolean_t tosdb_memtable_persist(tosdb_memtable_t* mt) {
     if(!b_vl) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot create valuelog block");
         memory_free(b_vl_data);
+        memory_free(chunks);
 
         return false;
     }
@@ -765,8 +1032,12 @@ boolean_t tosdb_memtable_persist(tosdb_memtable_t* mt) {
     b_vl->sstable_id = mt->id;
     b_vl->data_size = ol;
     b_vl->valuelog_unpacked_size = valuelog_unpacked_size;
-    memory_memcopy(b_vl_data, b_vl->data, ol);
+    b_vl->chunk_size = TOSDB_VALUELOG_CHUNK_SIZE;
+    b_vl->chunk_count = chunk_count;
+    memory_memcopy(chunks, b_vl->chunks, chunk_table_size);
+    memory_memcopy(b_vl_data, (uint8_t*)&b_vl->chunks[chunk_count], ol);
     memory_free(b_vl_data);
+    memory_free(chunks);
 
     uint64_t b_vl_loc = tosdb_block_write(mt->tbl->db->tdb, (tosdb_block_header_t*)b_vl);
 
@@ -945,11 +1216,11 @@ boolean_t tosdb_memtable_index_persist(tosdb_memtable_t* mt, tosdb_block_sstable
 
             if(!first_key) {
                 first_key = ii;
-                first_key_length = sizeof(tosdb_memtable_secondary_index_item_t) + ii->secondary_key_length + ii->primary_key_length;
+                first_key_length = tosdb_memtable_secondary_index_item_size(ii);
             }
 
             last_key = ii;
-            last_key_length = sizeof(tosdb_memtable_secondary_index_item_t) + ii->secondary_key_length + ii->primary_key_length;
+            last_key_length = tosdb_memtable_secondary_index_item_size(ii);
 
             buffer_append_bytes(buf_id_in, (uint8_t*)ii, last_key_length);
 
@@ -1192,17 +1463,20 @@ boolean_t tosdb_memtable_is_deleted(tosdb_record_t* record) {
     return false;
 }
 
-boolean_t tosdb_memtable_get(tosdb_record_t* record) {
-    if(!record || !record->context) {
-        return false;
-    }
-
+/**
+ * @brief finds newest memtable index item of record key
+ * @param[in] record record with one key
+ * @param[out] found_mt memtable of found item
+ * @param[out] col_id column id of record key
+ * @return found item or null
+ */
+static const tosdb_memtable_index_item_t* tosdb_memtable_find_item(tosdb_record_t* record, const tosdb_memtable_t** found_mt, uint64_t* col_id) {
     tosdb_record_context_t* ctx = record->context;
 
     if(hashmap_size(ctx->keys) != 1) {
         PRINTLOG(TOSDB, LOG_ERROR, "record get supports only one key");
 
-        return false;
+        return NULL;
     }
 
     iterator_t* iter = hashmap_iterator_create(ctx->keys);
@@ -1210,7 +1484,7 @@ boolean_t tosdb_memtable_get(tosdb_record_t* record) {
     if(!iter) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot get key");
 
-        return false;
+        return NULL;
     }
 
     const tosdb_record_key_t* r_key = iter->get_item(iter);
@@ -1222,7 +1496,7 @@ boolean_t tosdb_memtable_get(tosdb_record_t* record) {
     if(!item) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable intex item");
 
-        return false;
+        return NULL;
     }
 
     item->key_hash = r_key->key_hash;
@@ -1234,29 +1508,25 @@ boolean_t tosdb_memtable_get(tosdb_record_t* record) {
     if(list_size(mts) == 0) {
         memory_free(item);
 
-        return false;
+        return NULL;
     }
 
-    boolean_t found = false;
     const tosdb_memtable_index_item_t* found_item = NULL;
-    const tosdb_memtable_t* mt = NULL;
 
     iter = list_iterator_create(mts);
 
-    uint64_t col_id = 0;
-
     while(iter->end_of_iterator(iter) != 0) {
-        mt = iter->get_item(iter);
+        const tosdb_memtable_t* mt = iter->get_item(iter);
 
         const tosdb_memtable_index_t* mt_idx = hashmap_get(mt->indexes, (void*)r_key->index_id);
 
-        col_id = mt_idx->ti->column_id;
+        *col_id = mt_idx->ti->column_id;
 
         iterator_t* s_iter = mt_idx->index->search(mt_idx->index, item, NULL, INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL);
 
         if(s_iter->end_of_iterator(s_iter) != 0) {
             found_item = s_iter->get_item(s_iter);
-            found = true;
+            *found_mt = mt;
             s_iter->destroy(s_iter);
 
             break;
@@ -1271,10 +1541,47 @@ boolean_t tosdb_memtable_get(tosdb_record_t* record) {
 
     memory_free(item);
 
-    if(!found) {
+    return found_item;
+}
+
+boolean_t tosdb_memtable_locate(tosdb_record_t* record, uint64_t* offset) {
+    if(!record || !record->context || !offset) {
+        return false;
+    }
+
+    tosdb_record_context_t* ctx = record->context;
+
+    const tosdb_memtable_t* mt = NULL;
+    uint64_t col_id = 0;
+
+    const tosdb_memtable_index_item_t* found_item = tosdb_memtable_find_item(record, &mt, &col_id);
+
+    if(!found_item) {
+        return false;
+    }
+
+    ctx->record_id = found_item->record_id;
+    ctx->is_deleted = found_item->is_deleted;
+    ctx->level = mt->stli ? mt->stli->level : 0;
+    ctx->sstable_id = mt->id;
+
+    *offset = found_item->offset;
+
+    return true;
+}
+
+boolean_t tosdb_memtable_get(tosdb_record_t* record) {
+    if(!record || !record->context) {
         return false;
     }
 
+    tosdb_record_context_t* ctx = record->context;
+
+    const tosdb_memtable_t* mt = NULL;
+    uint64_t col_id = 0;
+
+    const tosdb_memtable_index_item_t* found_item = tosdb_memtable_find_item(record, &mt, &col_id);
+
     if(!found_item) {
         return false;
     }
@@ -1286,22 +1593,14 @@ boolean_t tosdb_memtable_get(tosdb_record_t* record) {
         return true;
     }
 
-    lock_acquire(mt->tbl->lock);
-    uint64_t old_pos = buffer_get_position(mt->values);
-    buffer_seek(mt->values, found_item->offset, BUFFER_SEEK_DIRECTION_START);
-    uint8_t* f_d = buffer_get_bytes(mt->values, found_item->length);
-    buffer_seek(mt->values, old_pos, BUFFER_SEEK_DIRECTION_START);
-    lock_release(mt->tbl->lock);
-
+    // reserved valuelog ranges are never moved or rewritten, so value is read without table lock
     data_t s_d = {0};
     s_d.length = found_item->length;
     s_d.type = DATA_TYPE_INT8_ARRAY;
-    s_d.value = f_d;
+    s_d.value = mt->values + found_item->offset;
 
     data_t* r_d = data_bson_deserialize(&s_d);
 
-    memory_free(f_d);
-
     if(!r_d) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot deserialize data");
 
@@ -1326,103 +1625,5 @@ boolean_t tosdb_memtable_get(tosdb_record_t* record) {
 
     data_free(r_d);
 
-    return found;
-}
-
-boolean_t tosdb_memtable_search(tosdb_record_t* record, set_t* results) {
-    if(!record || !record->context) {
-        return false;
-    }
-
-    tosdb_record_context_t* ctx = record->context;
-
-    if(hashmap_size(ctx->keys) != 1) {
-        PRINTLOG(TOSDB, LOG_ERROR, "record search supports only one key");
-
-        return false;
-    }
-
-    iterator_t* iter = hashmap_iterator_create(ctx->keys);
-
-    if(!iter) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot get key");
-
-        return false;
-    }
-
-    const tosdb_record_key_t* r_key = iter->get_item(iter);
-
-    iter->destroy(iter);
-
-    tosdb_memtable_secondary_index_item_t* item = memory_malloc(sizeof(tosdb_memtable_secondary_index_item_t) + r_key->key_length);
-
-    if(!item) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable secondary index item");
-
-        return false;
-    }
-
-    item->secondary_key_hash = r_key->key_hash;
-    item->secondary_key_length = r_key->key_length;
-    memory_memcopy(r_key->key, item->data, item->secondary_key_length);
-
-    list_t* mts = ctx->table->memtables;
-
-    if(list_size(mts) == 0) {
-        memory_free(item);
-
-        return true;
-    }
-
-    const tosdb_memtable_t* mt = NULL;
-    boolean_t error = false;
-
-    iter = list_iterator_create(mts);
-
-    while(iter->end_of_iterator(iter) != 0) {
-        mt = iter->get_item(iter);
-
-        const tosdb_memtable_index_t* mt_idx = hashmap_get(mt->indexes, (void*)r_key->index_id);
-
-        iterator_t* s_iter = mt_idx->index->search(mt_idx->index, item, NULL, INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL);
-
-        while(s_iter->end_of_iterator(s_iter) != 0) {
-            const tosdb_memtable_secondary_index_item_t* s_idx_item = s_iter->get_item(s_iter);
-
-            uint64_t idx_item_len = sizeof(tosdb_memtable_index_item_t) + s_idx_item->primary_key_length;
-
-            tosdb_memtable_index_item_t* res = memory_malloc(idx_item_len);
-
-            if(!res) {
-                PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable index item");
-                error = true;
-
-                break;
-            }
-
-            res->record_id = s_idx_item->record_id;
-            res->is_deleted = s_idx_item->is_primary_key_deleted;
-            res->key_hash = s_idx_item->primary_key_hash;
-            res->key_length = s_idx_item->primary_key_length;
-            memory_memcopy(s_idx_item->data + s_idx_item->secondary_key_length, res->key, res->key_length);
-
-            if(!set_append(results, res)) {
-                memory_free(res);
-            }
-
-            s_iter = s_iter->next(s_iter);
-        }
-
-        s_iter->destroy(s_iter);
-
-        iter = iter->next(iter);
-    }
-
-    iter->destroy(iter);
-
-    memory_free(item);
-
-
-    return !error;
+    return true;
 }
-
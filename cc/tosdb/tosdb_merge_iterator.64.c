@@ -0,0 +1,1219 @@
+/**
+ * @file tosdb_merge_iterator.64.c
+ * @brief tosdb streaming merge iterator over memtables and sstables implementation
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <tosdb/tosdb.h>
+#include <tosdb/tosdb_internal.h>
+#include <tosdb/tosdb_cache.h>
+#include <logging.h>
+#include <compression.h>
+#include <set.h>
+
+MODULE("turnstone.kernel.db");
+
+/**
+ * @struct tosdb_merge_iterator_source_t
+ * @brief one sorted input of merge, a memtable index iterator or sorted sstable index items
+ */
+typedef struct tosdb_merge_iterator_source_t {
+    iterator_t*                   iter; ///< memtable index iterator
+    tosdb_memtable_index_item_t** items; ///< sorted index items
+    uint8_t*                      items_data; ///< index data which items point into, when null items are allocated one by one
+    uint64_t                      position; ///< current index item
+    uint64_t                      item_count; ///< end of index items
+    uint64_t                      priority; ///< source order, lower one is newer
+    uint64_t                      level; ///< sstable level of source, zero for memtables
+} tosdb_merge_iterator_source_t;
+
+/**
+ * @struct tosdb_merge_iterator_t
+ * @brief heap ordered merge of sources, yields newest version of each key and skips tombstones
+ */
+typedef struct tosdb_merge_iterator_t {
+    tosdb_merge_iterator_source_t** sources; ///< all sources
+    uint64_t                        source_count; ///< source count
+    tosdb_merge_iterator_source_t** heap; ///< min heap of sources which are not exhausted
+    uint64_t                        heap_size; ///< heap size
+    const tosdb_memtable_index_item_t* current; ///< current item
+    hashmap_t*                      shadowed_counts; ///< optional level to shadowed item count map
+    tosdb_memtable_index_item_t*    lo; ///< copy of lower bound, memtable searches refer it
+    tosdb_memtable_index_item_t*    hi; ///< copy of upper bound, memtable searches refer it
+} tosdb_merge_iterator_t;
+
+/**
+ * @struct tosdb_record_iterator_t
+ * @brief record iterator over merge iterator
+ */
+typedef struct tosdb_record_iterator_t {
+    tosdb_record_iterator_type_t type; ///< iterator type
+    iterator_t*                  merge_iter; ///< merge iterator
+    tosdb_table_t*               tbl; ///< table
+    const tosdb_index_t*         index; ///< index of merged items
+    const tosdb_column_t*        column; ///< column of merged items
+    const tosdb_column_t*        search_column; ///< searched column
+    uint64_t                     search_length; ///< searched value length
+    uint8_t*                     search_value; ///< searched value
+    tosdb_record_t*              current; ///< current record
+} tosdb_record_iterator_t;
+
+static tosdb_memtable_index_item_t* tosdb_merge_iterator_source_get_item(const tosdb_merge_iterator_source_t* src) {
+    if(src->iter) {
+        if(src->iter->end_of_iterator(src->iter) == 0) {
+            return NULL;
+        }
+
+        return (tosdb_memtable_index_item_t*)src->iter->get_item(src->iter);
+    }
+
+    if(src->position >= src->item_count) {
+        return NULL;
+    }
+
+    return src->items[src->position];
+}
+
+static void tosdb_merge_iterator_source_next(tosdb_merge_iterator_source_t* src) {
+    if(src->iter) {
+        src->iter = src->iter->next(src->iter);
+    } else {
+        src->position++;
+    }
+}
+
+static void tosdb_merge_iterator_source_destroy(tosdb_merge_iterator_source_t* src) {
+    if(!src) {
+        return;
+    }
+
+    if(src->iter) {
+        src->iter->destroy(src->iter);
+    }
+
+    if(src->items && !src->items_data) {
+        for(uint64_t i = 0; i < src->item_count; i++) {
+            memory_free(src->items[i]);
+        }
+    }
+
+    memory_free(src->items);
+    memory_free(src->items_data);
+    memory_free(src);
+}
+
+static uint64_t tosdb_merge_iterator_lower_bound(tosdb_memtable_index_item_t** items, uint64_t count, const tosdb_memtable_index_item_t* key) {
+    uint64_t start = 0;
+    uint64_t end = count;
+
+    while(start < end) {
+        uint64_t mid = start + (end - start) / 2;
+
+        if(tosdb_memtable_index_comparator(items[mid], key) < 0) {
+            start = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+
+    return start;
+}
+
+static uint64_t tosdb_merge_iterator_upper_bound(tosdb_memtable_index_item_t** items, uint64_t count, const tosdb_memtable_index_item_t* key) {
+    uint64_t start = 0;
+    uint64_t end = count;
+
+    while(start < end) {
+        uint64_t mid = start + (end - start) / 2;
+
+        if(tosdb_memtable_index_comparator(items[mid], key) <= 0) {
+            start = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+
+    return start;
+}
+
+static int8_t tosdb_merge_iterator_source_compare(const tosdb_merge_iterator_source_t* src1, const tosdb_merge_iterator_source_t* src2) {
+    int8_t res = tosdb_memtable_index_comparator(tosdb_merge_iterator_source_get_item(src1), tosdb_merge_iterator_source_get_item(src2));
+
+    if(res) {
+        return res;
+    }
+
+    return src1->priority < src2->priority ? -1 : 1;
+}
+
+static void tosdb_merge_iterator_heap_sift_down(tosdb_merge_iterator_t* mi, uint64_t pos) {
+    while(true) {
+        uint64_t min = pos;
+        uint64_t left = 2 * pos + 1;
+        uint64_t right = left + 1;
+
+        if(left < mi->heap_size && tosdb_merge_iterator_source_compare(mi->heap[left], mi->heap[min]) < 0) {
+            min = left;
+        }
+
+        if(right < mi->heap_size && tosdb_merge_iterator_source_compare(mi->heap[right], mi->heap[min]) < 0) {
+            min = right;
+        }
+
+        if(min == pos) {
+            break;
+        }
+
+        tosdb_merge_iterator_source_t* tmp = mi->heap[pos];
+        mi->heap[pos] = mi->heap[min];
+        mi->heap[min] = tmp;
+
+        pos = min;
+    }
+}
+
+static void tosdb_merge_iterator_heap_pop_next(tosdb_merge_iterator_t* mi) {
+    tosdb_merge_iterator_source_next(mi->heap[0]);
+
+    if(!tosdb_merge_iterator_source_get_item(mi->heap[0])) {
+        mi->heap_size--;
+        mi->heap[0] = mi->heap[mi->heap_size];
+    }
+
+    tosdb_merge_iterator_heap_sift_down(mi, 0);
+}
+
+static void tosdb_merge_iterator_advance(tosdb_merge_iterator_t* mi) {
+    mi->current = NULL;
+
+    while(mi->heap_size) {
+        const tosdb_memtable_index_item_t* winner = tosdb_merge_iterator_source_get_item(mi->heap[0]);
+
+        // sources do not free items while moving, winner stays valid
+        tosdb_merge_iterator_heap_pop_next(mi);
+
+        while(mi->heap_size && tosdb_memtable_index_comparator(tosdb_merge_iterator_source_get_item(mi->heap[0]), winner) == 0) {
+            if(mi->shadowed_counts && mi->heap[0]->level) {
+                uint64_t count = (uint64_t)hashmap_get(mi->shadowed_counts, (void*)mi->heap[0]->level);
+                count++;
+                hashmap_put(mi->shadowed_counts, (void*)mi->heap[0]->level, (void*)count);
+            }
+
+            tosdb_merge_iterator_heap_pop_next(mi);
+        }
+
+        if(!winner->is_deleted) {
+            mi->current = winner;
+
+            break;
+        }
+    }
+}
+
+static int8_t tosdb_merge_iterator_destroy(iterator_t* iterator) {
+    tosdb_merge_iterator_t* mi = iterator->metadata;
+
+    for(uint64_t i = 0; i < mi->source_count; i++) {
+        tosdb_merge_iterator_source_destroy(mi->sources[i]);
+    }
+
+    memory_free(mi->sources);
+    memory_free(mi->heap);
+    memory_free(mi->lo);
+    memory_free(mi->hi);
+    memory_free(mi);
+    memory_free(iterator);
+
+    return 0;
+}
+
+static iterator_t* tosdb_merge_iterator_next(iterator_t* iterator) {
+    tosdb_merge_iterator_advance(iterator->metadata);
+
+    return iterator;
+}
+
+static int8_t tosdb_merge_iterator_end_of_iterator(iterator_t* iterator) {
+    tosdb_merge_iterator_t* mi = iterator->metadata;
+
+    return mi->current ? 1 : 0;
+}
+
+static const void* tosdb_merge_iterator_get_item(iterator_t* iterator) {
+    tosdb_merge_iterator_t* mi = iterator->metadata;
+
+    return mi->current;
+}
+
+static int8_t tosdb_merge_iterator_destroy_source_cb(memory_heap_t* heap, void* item) {
+    UNUSED(heap);
+
+    tosdb_merge_iterator_source_destroy(item);
+
+    return 0;
+}
+
+static tosdb_memtable_index_item_t* tosdb_merge_iterator_key_clone(const tosdb_memtable_index_item_t* key) {
+    if(!key) {
+        return NULL;
+    }
+
+    uint64_t item_size = sizeof(tosdb_memtable_index_item_t) + key->key_length;
+
+    tosdb_memtable_index_item_t* res = memory_malloc(item_size);
+
+    if(!res) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot clone range key");
+
+        return NULL;
+    }
+
+    memory_memcopy(key, res, item_size);
+
+    return res;
+}
+
+static boolean_t tosdb_merge_iterator_destroy_item_cb(void* item) {
+    memory_free(item);
+
+    return true;
+}
+
+static iterator_t* tosdb_merge_iterator_build(list_t* sources, hashmap_t* shadowed_counts, tosdb_memtable_index_item_t* lo, tosdb_memtable_index_item_t* hi) {
+    tosdb_merge_iterator_t* mi = memory_malloc(sizeof(tosdb_merge_iterator_t));
+    iterator_t* iterator = memory_malloc(sizeof(iterator_t));
+    uint64_t source_count = list_size(sources);
+
+    if(!mi || !iterator) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create merge iterator");
+        memory_free(mi);
+        memory_free(iterator);
+        list_destroy_with_type(sources, LIST_DESTROY_WITH_DATA, tosdb_merge_iterator_destroy_source_cb);
+        memory_free(lo);
+        memory_free(hi);
+
+        return NULL;
+    }
+
+    mi->lo = lo;
+    mi->hi = hi;
+
+    mi->sources = memory_malloc(sizeof(tosdb_merge_iterator_source_t*) * (source_count + 1));
+    mi->heap = memory_malloc(sizeof(tosdb_merge_iterator_source_t*) * (source_count + 1));
+
+    if(!mi->sources || !mi->heap) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create merge iterator heap");
+        memory_free(mi->sources);
+        memory_free(mi->heap);
+        memory_free(mi->lo);
+        memory_free(mi->hi);
+        memory_free(mi);
+        memory_free(iterator);
+        list_destroy_with_type(sources, LIST_DESTROY_WITH_DATA, tosdb_merge_iterator_destroy_source_cb);
+
+        return NULL;
+    }
+
+    iterator_t* iter = list_iterator_create(sources);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        tosdb_merge_iterator_source_t* src = (tosdb_merge_iterator_source_t*)iter->get_item(iter);
+
+        src->priority = mi->source_count;
+        mi->sources[mi->source_count++] = src;
+
+        if(tosdb_merge_iterator_source_get_item(src)) {
+            mi->heap[mi->heap_size++] = src;
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    list_destroy(sources);
+
+    for(uint64_t i = mi->heap_size / 2; i > 0; i--) {
+        tosdb_merge_iterator_heap_sift_down(mi, i - 1);
+    }
+
+    mi->shadowed_counts = shadowed_counts;
+
+    iterator->metadata = mi;
+    iterator->destroy = tosdb_merge_iterator_destroy;
+    iterator->next = tosdb_merge_iterator_next;
+    iterator->end_of_iterator = tosdb_merge_iterator_end_of_iterator;
+    iterator->get_item = tosdb_merge_iterator_get_item;
+
+    tosdb_merge_iterator_advance(mi);
+
+    return iterator;
+}
+
+static boolean_t tosdb_merge_iterator_add_memtables(tosdb_table_t* tbl, uint64_t index_id, const tosdb_memtable_index_item_t* lo, const tosdb_memtable_index_item_t* hi, list_t* sources) {
+    if(!tbl->memtables) {
+        return true;
+    }
+
+    iterator_t* iter = list_iterator_create(tbl->memtables);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable iterator");
+
+        return false;
+    }
+
+    boolean_t error = false;
+
+    while(iter->end_of_iterator(iter) != 0) {
+        const tosdb_memtable_t* mt = iter->get_item(iter);
+
+        const tosdb_memtable_index_t* mt_idx = hashmap_get(mt->indexes, (void*)index_id);
+
+        if(mt_idx) {
+            tosdb_merge_iterator_source_t* src = memory_malloc(sizeof(tosdb_merge_iterator_source_t));
+
+            if(!src) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot create merge source");
+                error = true;
+
+                break;
+            }
+
+            if(lo) {
+                src->iter = mt_idx->index->search(mt_idx->index, lo, hi, INDEXER_KEY_COMPARATOR_CRITERIA_BETWEEN);
+            } else {
+                src->iter = mt_idx->index->create_iterator(mt_idx->index);
+            }
+
+            src->level = mt->stli ? mt->stli->level : 0;
+
+            if(!src->iter || list_queue_push(sources, src) == -1ULL) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot search memtable %lli", mt->id);
+                tosdb_merge_iterator_source_destroy(src);
+                error = true;
+
+                break;
+            }
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return !error;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+static boolean_t tosdb_merge_iterator_add_sstable(tosdb_table_t* tbl, tosdb_block_sstable_list_item_t* sli, uint64_t index_id, const tosdb_memtable_index_item_t* lo, const tosdb_memtable_index_item_t* hi, list_t* sources) {
+    uint64_t idx_loc = 0;
+    uint64_t idx_size = 0;
+
+    for(uint64_t i = 0; i < sli->index_count; i++) {
+        if(index_id == sli->indexes[i].index_id) {
+            idx_loc = sli->indexes[i].index_location;
+            idx_size = sli->indexes[i].index_size;
+        }
+    }
+
+    if(!idx_loc || !idx_size) {
+        PRINTLOG(TOSDB, LOG_TRACE, "index not found at sstable 0x%llx", sli->sstable_id);
+
+        return true;
+    }
+
+    tosdb_cache_t* tdb_cache = tbl->db->tdb->cache;
+
+    tosdb_cache_key_t cache_key = {0};
+
+    cache_key.type = TOSDB_CACHE_ITEM_TYPE_INDEX_DATA;
+    cache_key.database_id = tbl->db->id;
+    cache_key.table_id = tbl->id;
+    cache_key.index_id = index_id;
+    cache_key.level = sli->level;
+    cache_key.sstable_id = sli->sstable_id;
+
+    tosdb_cached_index_data_t* c_id = NULL;
+
+    if(tdb_cache) {
+        c_id = (tosdb_cached_index_data_t*)tosdb_cache_get(tdb_cache, &cache_key);
+    }
+
+    tosdb_merge_iterator_source_t* src = memory_malloc(sizeof(tosdb_merge_iterator_source_t));
+
+    if(!src) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create merge source");
+
+        return false;
+    }
+
+    src->level = sli->level;
+
+    if(c_id) {
+        // cache can evict index data while merge is lazily consumed, so range is copied out
+        uint64_t start = 0;
+        uint64_t end = c_id->record_count;
+
+        if(lo) {
+            start = tosdb_merge_iterator_lower_bound(c_id->index_items, c_id->record_count, lo);
+            end = tosdb_merge_iterator_upper_bound(c_id->index_items, c_id->record_count, hi);
+        }
+
+        if(start >= end) {
+            memory_free(src);
+
+            return true;
+        }
+
+        uint64_t data_size = 0;
+
+        for(uint64_t i = start; i < end; i++) {
+            data_size += sizeof(tosdb_memtable_index_item_t) + c_id->index_items[i]->key_length;
+        }
+
+        src->items_data = memory_malloc(data_size);
+        src->items = memory_malloc(sizeof(tosdb_memtable_index_item_t*) * (end - start));
+
+        if(!src->items_data || !src->items) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot copy cached index data");
+            tosdb_merge_iterator_source_destroy(src);
+
+            return false;
+        }
+
+        uint8_t* items_data = src->items_data;
+
+        for(uint64_t i = start; i < end; i++) {
+            uint64_t item_size = sizeof(tosdb_memtable_index_item_t) + c_id->index_items[i]->key_length;
+
+            memory_memcopy(c_id->index_items[i], items_data, item_size);
+            src->items[i - start] = (tosdb_memtable_index_item_t*)items_data;
+
+            items_data += item_size;
+        }
+
+        src->item_count = end - start;
+    } else {
+        tosdb_block_sstable_index_t* st_idx = (tosdb_block_sstable_index_t*)tosdb_block_read(tbl->db->tdb, idx_loc, idx_size);
+
+        if(!st_idx) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot read sstable index from backend");
+            memory_free(src);
+
+            return false;
+        }
+
+        // first and last keys are fences of index data, sstables outside of range are never unpacked
+        tosdb_memtable_index_item_t* first = (tosdb_memtable_index_item_t*)&st_idx->data[0];
+        tosdb_memtable_index_item_t* last = (tosdb_memtable_index_item_t*)(&st_idx->data[0] + sizeof(tosdb_memtable_index_item_t) + first->key_length);
+
+        boolean_t outside = lo && (tosdb_memtable_index_comparator(first, hi) > 0 || tosdb_memtable_index_comparator(last, lo) < 0);
+        uint64_t index_data_location = st_idx->index_data_location;
+        uint64_t index_data_size = st_idx->index_data_size;
+
+        memory_free(st_idx);
+
+        if(outside) {
+            PRINTLOG(TOSDB, LOG_TRACE, "sstable 0x%llx level 0x%llx is outside of range", sli->sstable_id, sli->level);
+            memory_free(src);
+
+            return true;
+        }
+
+        tosdb_block_sstable_index_data_t* b_sid = (tosdb_block_sstable_index_data_t*)tosdb_block_read(tbl->db->tdb, index_data_location, index_data_size);
+
+        if(!b_sid) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot read index data");
+            memory_free(src);
+
+            return false;
+        }
+
+        uint64_t record_count = b_sid->record_count;
+        uint64_t index_data_unpacked_size = b_sid->index_data_unpacked_size;
+
+        buffer_t* buf_idx_in = buffer_encapsulate(b_sid->data, b_sid->index_data_size);
+        buffer_t* buf_idx_out = buffer_new_with_capacity(NULL, index_data_unpacked_size);
+
+        int8_t zc_res = tbl->db->tdb->compression->unpack(buf_idx_in, buf_idx_out);
+
+        uint64_t zc = buffer_get_length(buf_idx_out);
+
+        memory_free(b_sid);
+
+        buffer_destroy(buf_idx_in);
+
+        if(zc_res != 0 || zc != index_data_unpacked_size) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot unpack idx");
+            buffer_destroy(buf_idx_out);
+            memory_free(src);
+
+            return false;
+        }
+
+        src->items_data = buffer_get_all_bytes_and_destroy(buf_idx_out, NULL);
+        src->items = memory_malloc(sizeof(tosdb_memtable_index_item_t*) * record_count);
+
+        if(!src->items_data || !src->items) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create index item array");
+            tosdb_merge_iterator_source_destroy(src);
+
+            return false;
+        }
+
+        uint8_t* idx_data = src->items_data;
+
+        for(uint64_t i = 0; i < record_count; i++) {
+            src->items[i] = (tosdb_memtable_index_item_t*)idx_data;
+
+            idx_data += sizeof(tosdb_memtable_index_item_t) + src->items[i]->key_length;
+        }
+
+        src->item_count = record_count;
+
+        if(lo) {
+            src->position = tosdb_merge_iterator_lower_bound(src->items, record_count, lo);
+            src->item_count = tosdb_merge_iterator_upper_bound(src->items, record_count, hi);
+        }
+    }
+
+    if(list_queue_push(sources, src) == -1ULL) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot add merge source");
+        tosdb_merge_iterator_source_destroy(src);
+
+        return false;
+    }
+
+    return true;
+}
+#pragma GCC diagnostic pop
+
+static boolean_t tosdb_merge_iterator_add_sstable_list(tosdb_table_t* tbl, list_t* st_list, uint64_t index_id, const tosdb_memtable_index_item_t* lo, const tosdb_memtable_index_item_t* hi, list_t* sources) {
+    iterator_t* iter = list_iterator_create(st_list);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstables list items iterator");
+
+        return false;
+    }
+
+    boolean_t error = false;
+
+    while(iter->end_of_iterator(iter) != 0) {
+        tosdb_block_sstable_list_item_t* sli = (tosdb_block_sstable_list_item_t*)iter->get_item(iter);
+
+        if(!tosdb_merge_iterator_add_sstable(tbl, sli, index_id, lo, hi, sources)) {
+            error = true;
+
+            break;
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return !error;
+}
+
+iterator_t* tosdb_merge_iterator_create(tosdb_table_t* tbl, uint64_t index_id, const tosdb_memtable_index_item_t* lo, const tosdb_memtable_index_item_t* hi, hashmap_t* shadowed_counts) {
+    if(!tbl || (!lo && hi) || (lo && !hi)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "table is null or range is half open");
+
+        return NULL;
+    }
+
+    tosdb_memtable_index_item_t* lo_key = tosdb_merge_iterator_key_clone(lo);
+    tosdb_memtable_index_item_t* hi_key = tosdb_merge_iterator_key_clone(hi);
+    list_t* sources = list_create_list();
+
+    if(!sources || (lo && (!lo_key || !hi_key))) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create merge source list");
+        list_destroy(sources);
+        memory_free(lo_key);
+        memory_free(hi_key);
+
+        return NULL;
+    }
+
+    lo = lo_key;
+    hi = hi_key;
+
+    // empty range, merge without sources ends immediately
+    if(lo && tosdb_memtable_index_comparator(lo, hi) > 0) {
+        return tosdb_merge_iterator_build(sources, shadowed_counts, lo_key, hi_key);
+    }
+
+    // sources are pushed from newest to oldest, first source wins on equal keys
+    boolean_t error = !tosdb_merge_iterator_add_memtables(tbl, index_id, lo, hi, sources);
+
+    if(!error && tbl->sstable_list_items) {
+        error = !tosdb_merge_iterator_add_sstable_list(tbl, tbl->sstable_list_items, index_id, lo, hi, sources);
+    }
+
+    if(!error && tbl->sstable_levels) {
+        for(uint64_t i = 1; i <= tbl->sstable_max_level; i++) {
+            list_t* st_lvl_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)i);
+
+            if(st_lvl_l && !tosdb_merge_iterator_add_sstable_list(tbl, st_lvl_l, index_id, lo, hi, sources)) {
+                error = true;
+
+                break;
+            }
+        }
+    }
+
+    if(error) {
+        list_destroy_with_type(sources, LIST_DESTROY_WITH_DATA, tosdb_merge_iterator_destroy_source_cb);
+        memory_free(lo_key);
+        memory_free(hi_key);
+
+        return NULL;
+    }
+
+    return tosdb_merge_iterator_build(sources, shadowed_counts, lo_key, hi_key);
+}
+
+static boolean_t tosdb_merge_iterator_add_secondary_results(set_t* results, uint64_t level, list_t* sources) {
+    tosdb_merge_iterator_source_t* src = memory_malloc(sizeof(tosdb_merge_iterator_source_t));
+    uint64_t count = set_size(results);
+
+    if(src) {
+        src->items = memory_malloc(sizeof(tosdb_memtable_index_item_t*) * (count + 1));
+    }
+
+    if(!src || !src->items) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create merge source");
+        set_destroy_with_callback(results, tosdb_merge_iterator_destroy_item_cb);
+        memory_free(src);
+
+        return false;
+    }
+
+    src->level = level;
+
+    iterator_t* iter = set_create_iterator(results);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        tosdb_memtable_index_item_t* item = (tosdb_memtable_index_item_t*)iter->get_item(iter);
+
+        // one source can hold stale versions of a primary key, liveness is decided by primary key lookup
+        item->is_deleted = false;
+
+        // matches of a secondary key are ordered by record id, merge needs primary key order
+        uint64_t pos = tosdb_merge_iterator_upper_bound(src->items, src->item_count, item);
+
+        for(uint64_t i = src->item_count; i > pos; i--) {
+            src->items[i] = src->items[i - 1];
+        }
+
+        src->items[pos] = item;
+        src->item_count++;
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    set_destroy(results);
+
+    if(!src->item_count) {
+        tosdb_merge_iterator_source_destroy(src);
+
+        return true;
+    }
+
+    if(list_queue_push(sources, src) == -1ULL) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot add merge source");
+        tosdb_merge_iterator_source_destroy(src);
+
+        return false;
+    }
+
+    return true;
+}
+
+static boolean_t tosdb_merge_iterator_add_secondary_memtables(tosdb_table_t* tbl, uint64_t index_id, tosdb_memtable_secondary_index_item_t* key, list_t* sources) {
+    if(!tbl->memtables) {
+        return true;
+    }
+
+    iterator_t* iter = list_iterator_create(tbl->memtables);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable iterator");
+
+        return false;
+    }
+
+    boolean_t error = false;
+
+    while(!error && iter->end_of_iterator(iter) != 0) {
+        const tosdb_memtable_t* mt = iter->get_item(iter);
+
+        const tosdb_memtable_index_t* mt_idx = hashmap_get(mt->indexes, (void*)index_id);
+
+        set_t* results = set_create(tosdb_memtable_record_id_comparator);
+
+        if(!mt_idx || !results) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot search memtable %lli", mt->id);
+            set_destroy(results);
+            error = true;
+
+            break;
+        }
+
+        iterator_t* s_iter = mt_idx->index->search(mt_idx->index, key, NULL, INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL);
+
+        while(s_iter->end_of_iterator(s_iter) != 0) {
+            const tosdb_memtable_secondary_index_item_t* s_idx_item = s_iter->get_item(s_iter);
+
+            tosdb_memtable_index_item_t* res = memory_malloc(sizeof(tosdb_memtable_index_item_t) + s_idx_item->primary_key_length);
+
+            if(!res) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable index item");
+                error = true;
+
+                break;
+            }
+
+            res->record_id = s_idx_item->record_id;
+            res->is_deleted = s_idx_item->is_primary_key_deleted;
+            res->key_hash = s_idx_item->primary_key_hash;
+            res->key_length = s_idx_item->primary_key_length;
+            memory_memcopy(s_idx_item->data + s_idx_item->secondary_key_length, res->key, res->key_length);
+
+            if(!set_append(results, res)) {
+                memory_free(res);
+            }
+
+            s_iter = s_iter->next(s_iter);
+        }
+
+        s_iter->destroy(s_iter);
+
+        if(error) {
+            set_destroy_with_callback(results, tosdb_merge_iterator_destroy_item_cb);
+        } else {
+            error = !tosdb_merge_iterator_add_secondary_results(results, mt->stli ? mt->stli->level : 0, sources);
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return !error;
+}
+
+static boolean_t tosdb_merge_iterator_add_secondary_sstable_list(tosdb_record_t* record, list_t* st_list, uint64_t index_id, tosdb_memtable_secondary_index_item_t* key, list_t* sources) {
+    iterator_t* iter = list_iterator_create(st_list);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstables list items iterator");
+
+        return false;
+    }
+
+    boolean_t error = false;
+
+    while(!error && iter->end_of_iterator(iter) != 0) {
+        tosdb_block_sstable_list_item_t* sli = (tosdb_block_sstable_list_item_t*)iter->get_item(iter);
+
+        if(index_id <= sli->index_count) {
+            set_t* results = set_create(tosdb_memtable_record_id_comparator);
+
+            if(!results) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable search results");
+                error = true;
+
+                break;
+            }
+
+            if(!tosdb_sstable_search_on_index(record, results, sli, key, index_id)) {
+                set_destroy_with_callback(results, tosdb_merge_iterator_destroy_item_cb);
+                error = true;
+
+                break;
+            }
+
+            error = !tosdb_merge_iterator_add_secondary_results(results, sli->level, sources);
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return !error;
+}
+
+iterator_t* tosdb_merge_iterator_create_secondary(tosdb_record_t* record, uint64_t index_id, tosdb_memtable_secondary_index_item_t* key) {
+    if(!record || !record->context || !key) {
+        PRINTLOG(TOSDB, LOG_ERROR, "record or key is null");
+
+        return NULL;
+    }
+
+    tosdb_table_t* tbl = ((tosdb_record_context_t*)record->context)->table;
+
+    list_t* sources = list_create_list();
+
+    if(!sources) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create merge source list");
+
+        return NULL;
+    }
+
+    boolean_t error = !tosdb_merge_iterator_add_secondary_memtables(tbl, index_id, key, sources);
+
+    if(!error && tbl->sstable_list_items) {
+        error = !tosdb_merge_iterator_add_secondary_sstable_list(record, tbl->sstable_list_items, index_id, key, sources);
+    }
+
+    if(!error && tbl->sstable_levels) {
+        for(uint64_t i = 1; i <= tbl->sstable_max_level; i++) {
+            list_t* st_lvl_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)i);
+
+            if(st_lvl_l && !tosdb_merge_iterator_add_secondary_sstable_list(record, st_lvl_l, index_id, key, sources)) {
+                error = true;
+
+                break;
+            }
+        }
+    }
+
+    if(error) {
+        list_destroy_with_type(sources, LIST_DESTROY_WITH_DATA, tosdb_merge_iterator_destroy_source_cb);
+
+        return NULL;
+    }
+
+    return tosdb_merge_iterator_build(sources, NULL, NULL, NULL);
+}
+
+uint64_t tosdb_record_key_length(data_type_t type) {
+    switch(type) {
+    case DATA_TYPE_CHAR:
+    case DATA_TYPE_INT8:
+    case DATA_TYPE_BOOLEAN:
+        return 1;
+    case DATA_TYPE_INT16:
+        return 2;
+    case DATA_TYPE_INT32:
+    case DATA_TYPE_FLOAT32:
+        return 4;
+    case DATA_TYPE_INT64:
+    case DATA_TYPE_FLOAT64:
+        return 8;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+static boolean_t tosdb_record_iterator_matches(tosdb_record_iterator_t* ri, tosdb_record_t* rec) {
+    uint8_t* value = NULL;
+    uint64_t length = 0;
+
+    if(!tosdb_record_get_data_with_colid(rec, ri->search_column->id, ri->search_column->type, &length, (void**)&value)) {
+        return false;
+    }
+
+    boolean_t res = false;
+
+    if(ri->search_column->type < DATA_TYPE_STRING) {
+        res = value == ri->search_value;
+    } else {
+        res = length == ri->search_length && memory_memcompare(value, ri->search_value, length) == 0;
+
+        memory_free(value);
+    }
+
+    return res;
+}
+
+static void tosdb_record_iterator_advance(tosdb_record_iterator_t* ri) {
+    ri->current = NULL;
+
+    while(ri->merge_iter->end_of_iterator(ri->merge_iter) != 0) {
+        const tosdb_memtable_index_item_t* item = ri->merge_iter->get_item(ri->merge_iter);
+
+        tosdb_record_t* rec = tosdb_table_create_record(ri->tbl);
+
+        if(!rec) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create record");
+
+            break;
+        }
+
+        uint64_t len = item->key_length;
+        const void* value = item->key;
+
+        if(!len) {
+            len = tosdb_record_key_length(ri->column->type);
+            value = (void*)tosdb_record_key_hash_decode(ri->index, ri->column->type, item->key_hash);
+        }
+
+        boolean_t key_set = tosdb_record_set_data_with_colid(rec, ri->column->id, ri->column->type, len, value);
+
+        ri->merge_iter = ri->merge_iter->next(ri->merge_iter);
+
+        if(!key_set) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot set record key");
+            rec->destroy(rec);
+
+            break;
+        }
+
+        if(ri->type == TOSDB_RECORD_ITERATOR_TYPE_PRIMARY_KEY) {
+            ri->current = rec;
+
+            break;
+        }
+
+        if(rec->get_record(rec)) {
+            if(ri->type == TOSDB_RECORD_ITERATOR_TYPE_RECORD || tosdb_record_iterator_matches(ri, rec)) {
+                ri->current = rec;
+
+                break;
+            }
+        } else if(!rec->is_deleted(rec)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot get record");
+            rec->destroy(rec);
+
+            break;
+        }
+
+        rec->destroy(rec);
+    }
+}
+
+static int8_t tosdb_record_iterator_destroy(iterator_t* iterator) {
+    tosdb_record_iterator_t* ri = iterator->metadata;
+
+    if(ri->current) {
+        ri->current->destroy(ri->current);
+    }
+
+    if(ri->merge_iter) {
+        ri->merge_iter->destroy(ri->merge_iter);
+    }
+
+    if(ri->search_column && ri->search_column->type >= DATA_TYPE_STRING) {
+        memory_free(ri->search_value);
+    }
+
+    memory_free(ri);
+    memory_free(iterator);
+
+    return 0;
+}
+
+static iterator_t* tosdb_record_iterator_next(iterator_t* iterator) {
+    tosdb_record_iterator_t* ri = iterator->metadata;
+
+    if(ri->current) {
+        ri->current->destroy(ri->current);
+    }
+
+    tosdb_record_iterator_advance(ri);
+
+    return iterator;
+}
+
+static int8_t tosdb_record_iterator_end_of_iterator(iterator_t* iterator) {
+    tosdb_record_iterator_t* ri = iterator->metadata;
+
+    return ri->current ? 1 : 0;
+}
+
+static const void* tosdb_record_iterator_get_item(iterator_t* iterator) {
+    tosdb_record_iterator_t* ri = iterator->metadata;
+
+    return ri->current;
+}
+
+static const void* tosdb_record_iterator_delete_item(iterator_t* iterator) {
+    tosdb_record_iterator_t* ri = iterator->metadata;
+
+    tosdb_record_t* rec = ri->current;
+
+    tosdb_record_iterator_advance(ri);
+
+    return rec;
+}
+
+iterator_t* tosdb_record_iterator_create(tosdb_record_iterator_type_t type, tosdb_table_t* tbl, uint64_t index_id, iterator_t* merge_iter) {
+    if(!merge_iter) {
+        return NULL;
+    }
+
+    tosdb_record_iterator_t* ri = memory_malloc(sizeof(tosdb_record_iterator_t));
+    iterator_t* iterator = memory_malloc(sizeof(iterator_t));
+
+    if(!ri || !iterator) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create record iterator");
+        memory_free(ri);
+        memory_free(iterator);
+        merge_iter->destroy(merge_iter);
+
+        return NULL;
+    }
+
+    ri->type = type;
+    ri->tbl = tbl;
+    ri->merge_iter = merge_iter;
+    ri->index = hashmap_get(tbl->indexes, (void*)index_id);
+    ri->column = tosdb_table_get_column_by_index_id(tbl, index_id);
+
+    iterator->metadata = ri;
+    iterator->destroy = tosdb_record_iterator_destroy;
+    iterator->next = tosdb_record_iterator_next;
+    iterator->end_of_iterator = tosdb_record_iterator_end_of_iterator;
+    iterator->get_item = tosdb_record_iterator_get_item;
+    iterator->delete_item = tosdb_record_iterator_delete_item;
+
+    if(!ri->index || !ri->column) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot find index %lli of table %s", index_id, tbl->name);
+        iterator->destroy(iterator);
+
+        return NULL;
+    }
+
+    // search iterators advance after search value is set
+    if(type != TOSDB_RECORD_ITERATOR_TYPE_SEARCH) {
+        tosdb_record_iterator_advance(ri);
+    }
+
+    return iterator;
+}
+
+tosdb_memtable_index_item_t* tosdb_record_iterator_key_item(tosdb_record_t* record, uint64_t* index_id) {
+    tosdb_record_context_t* ctx = record->context;
+
+    if(hashmap_size(ctx->keys) != 1) {
+        PRINTLOG(TOSDB, LOG_ERROR, "record iterators support only one key");
+
+        return NULL;
+    }
+
+    iterator_t* iter = hashmap_iterator_create(ctx->keys);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot get key");
+
+        return NULL;
+    }
+
+    const tosdb_record_key_t* r_key = iter->get_item(iter);
+
+    iter->destroy(iter);
+
+    tosdb_memtable_index_item_t* item = memory_malloc(sizeof(tosdb_memtable_index_item_t) + r_key->key_length);
+
+    if(!item) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable index item");
+
+        return NULL;
+    }
+
+    item->key_hash = r_key->key_hash;
+    item->key_length = r_key->key_length;
+    memory_memcopy(r_key->key, item->key, item->key_length);
+
+    *index_id = r_key->index_id;
+
+    return item;
+}
+
+iterator_t* tosdb_record_search_iterator(tosdb_record_t* record) {
+    if(!record || !record->context) {
+        PRINTLOG(TOSDB, LOG_ERROR, "record is null");
+
+        return NULL;
+    }
+
+    tosdb_table_t* tbl = ((tosdb_record_context_t*)record->context)->table;
+
+    uint64_t index_id = 0;
+
+    tosdb_memtable_index_item_t* key = tosdb_record_iterator_key_item(record, &index_id);
+
+    if(!key) {
+        return NULL;
+    }
+
+    const tosdb_index_t* index = hashmap_get(tbl->indexes, (void*)index_id);
+    const tosdb_column_t* col = tosdb_table_get_column_by_index_id(tbl, index_id);
+
+    if(!index || !col) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot find index %lli of table %s", index_id, tbl->name);
+        memory_free(key);
+
+        return NULL;
+    }
+
+    if(index->type != TOSDB_INDEX_SECONDARY) {
+        iterator_t* merge_iter = tosdb_merge_iterator_create(tbl, index_id, key, key, NULL);
+
+        memory_free(key);
+
+        return tosdb_record_iterator_create(TOSDB_RECORD_ITERATOR_TYPE_RECORD, tbl, index_id, merge_iter);
+    }
+
+    tosdb_memtable_secondary_index_item_t* s_key = memory_malloc(sizeof(tosdb_memtable_secondary_index_item_t) + key->key_length);
+
+    if(!s_key) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable secondary index item");
+        memory_free(key);
+
+        return NULL;
+    }
+
+    s_key->secondary_key_hash = key->key_hash;
+    s_key->secondary_key_length = key->key_length;
+    memory_memcopy(key->key, s_key->data, s_key->secondary_key_length);
+
+    memory_free(key);
+
+    iterator_t* merge_iter = tosdb_merge_iterator_create_secondary(record, index_id, s_key);
+
+    memory_free(s_key);
+
+    iterator_t* iter = tosdb_record_iterator_create(TOSDB_RECORD_ITERATOR_TYPE_SEARCH, tbl, tbl->primary_index_id, merge_iter);
+
+    if(!iter) {
+        return NULL;
+    }
+
+    tosdb_record_iterator_t* ri = iter->metadata;
+
+    if(!tosdb_record_get_data_with_colid(record, col->id, col->type, &ri->search_length, (void**)&ri->search_value)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot get search value");
+        iter->destroy(iter);
+
+        return NULL;
+    }
+
+    ri->search_column = col;
+
+    tosdb_record_iterator_advance(ri);
+
+    return iter;
+}
+
+iterator_t* tosdb_table_primary_key_iterator(tosdb_table_t* tbl) {
+    if(!tbl) {
+        return NULL;
+    }
+
+    iterator_t* merge_iter = tosdb_merge_iterator_create(tbl, tbl->primary_index_id, NULL, NULL, NULL);
+
+    return tosdb_record_iterator_create(TOSDB_RECORD_ITERATOR_TYPE_PRIMARY_KEY, tbl, tbl->primary_index_id, merge_iter);
+}
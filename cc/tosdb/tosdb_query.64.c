@@ -0,0 +1,1184 @@
+/**
+ * @file tosdb_query.64.c
+ * @brief tosdb search planner implementation
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <tosdb/tosdb.h>
+#include <tosdb/tosdb_internal.h>
+#include <logging.h>
+#include <quicksort.h>
+#include <set.h>
+
+MODULE("turnstone.kernel.db");
+
+/**
+ * @brief when candidate count times this ratio reaches table record count, a full scan is cheaper than fetching candidates
+ */
+#define TOSDB_QUERY_FULL_SCAN_RATIO 2
+
+/**
+ * @enum tosdb_query_plan_t
+ * @brief how a search is executed
+ */
+typedef enum tosdb_query_plan_t {
+    TOSDB_QUERY_PLAN_PRIMARY_LOOKUP, ///< key of a primary or unique index, one point lookup
+    TOSDB_QUERY_PLAN_SECONDARY_FETCH, ///< secondary index candidates are fetched with their primary keys
+    TOSDB_QUERY_PLAN_INDEX_ONLY, ///< covering secondary index answers search, values are not read
+    TOSDB_QUERY_PLAN_FULL_SCAN, ///< all sources are read with valuelog order and filtered
+} tosdb_query_plan_t;
+
+/**
+ * @struct tosdb_query_candidate_t
+ * @brief newest secondary index item of a record
+ * @details item is a primary key item, its offset is the version offset at source and covered data of length follows key.
+ */
+typedef struct tosdb_query_candidate_t {
+    uint128_t                    record_id; ///< record id, also hashmap key
+    uint64_t                     source_id; ///< memtable or sstable id of item
+    tosdb_memtable_index_item_t* item; ///< primary key item
+} tosdb_query_candidate_t;
+
+/**
+ * @struct tosdb_query_t
+ * @brief search state
+ */
+typedef struct tosdb_query_t {
+    tosdb_table_t*        tbl; ///< searched table
+    const tosdb_column_t* column; ///< searched column
+    const tosdb_index_t*  index; ///< index of searched column, null if column is not indexed
+    uint64_t              search_length; ///< searched value length
+    uint8_t*              search_value; ///< searched value, value itself for fixed size types
+    hashmap_t*            seen; ///< record id map of newest versions, candidates or scanned record ids
+    list_t*               results; ///< found records
+    boolean_t             error; ///< scan callback error
+} tosdb_query_t;
+
+static uint64_t tosdb_query_record_id_key_generator(const void* key) {
+    uint128_t record_id = *(const uint128_t*)key;
+
+    return (uint64_t)(record_id ^ (record_id >> 64));
+}
+
+static int8_t tosdb_query_record_id_key_comparator(const void* key1, const void* key2) {
+    uint128_t record_id1 = *(const uint128_t*)key1;
+    uint128_t record_id2 = *(const uint128_t*)key2;
+
+    if(record_id1 < record_id2) {
+        return -1;
+    }
+
+    if(record_id1 > record_id2) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static uint64_t tosdb_query_primary_key_generator(const void* key) {
+    return ((const tosdb_memtable_index_item_t*)key)->key_hash;
+}
+
+static int8_t tosdb_query_result_comparator(const void* item1, const void* item2) {
+    return tosdb_record_primary_key_comparator(item1, item2);
+}
+
+static int8_t tosdb_query_destroy_record_cb(memory_heap_t* heap, void* item) {
+    UNUSED(heap);
+
+    tosdb_record_t* rec = item;
+
+    return rec->destroy(rec) ? 0 : -1;
+}
+
+static const tosdb_column_t* tosdb_query_get_column_by_id(tosdb_table_t* tbl, uint64_t col_id) {
+    iterator_t* iter = hashmap_iterator_create(tbl->columns);
+
+    if(!iter) {
+        return NULL;
+    }
+
+    const tosdb_column_t* res = NULL;
+
+    while(iter->end_of_iterator(iter) != 0) {
+        const tosdb_column_t* col = iter->get_item(iter);
+
+        if(col->id == col_id) {
+            res = col;
+
+            break;
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return res;
+}
+
+/**
+ * @brief sums record counts of memtables and sstables, versions of same record are counted at each source
+ * @param[in] tbl table
+ * @return record count estimation
+ */
+static uint64_t tosdb_query_record_count(tosdb_table_t* tbl) {
+    uint64_t count = 0;
+
+    if(tbl->memtables) {
+        iterator_t* iter = list_iterator_create(tbl->memtables);
+
+        while(iter && iter->end_of_iterator(iter) != 0) {
+            const tosdb_memtable_t* mt = iter->get_item(iter);
+
+            count += mt->record_count;
+
+            iter = iter->next(iter);
+        }
+
+        if(iter) {
+            iter->destroy(iter);
+        }
+    }
+
+    list_t* st_lists[2] = {tbl->sstable_list_items, NULL};
+
+    for(uint64_t i = 0; i <= tbl->sstable_max_level; i++) {
+        list_t* st_list = st_lists[0];
+
+        if(i) {
+            st_list = tbl->sstable_levels ? (list_t*)hashmap_get(tbl->sstable_levels, (void*)i) : NULL;
+        }
+
+        if(!st_list) {
+            continue;
+        }
+
+        iterator_t* iter = list_iterator_create(st_list);
+
+        while(iter && iter->end_of_iterator(iter) != 0) {
+            const tosdb_block_sstable_list_item_t* sli = iter->get_item(iter);
+
+            count += sli->record_count;
+
+            iter = iter->next(iter);
+        }
+
+        if(iter) {
+            iter->destroy(iter);
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief checks if index stores all columns which are not at keys
+ * @param[in] tbl table
+ * @param[in] index secondary index
+ * @return true if records can be built from index items
+ */
+static boolean_t tosdb_query_index_is_covering(tosdb_table_t* tbl, const tosdb_index_t* index) {
+    if(!index->covered_columns) {
+        return false;
+    }
+
+    iterator_t* iter = hashmap_iterator_create(tbl->columns);
+
+    if(!iter) {
+        return false;
+    }
+
+    boolean_t res = true;
+
+    while(iter->end_of_iterator(iter) != 0) {
+        const tosdb_column_t* col = iter->get_item(iter);
+
+        if(!col->is_deleted && col->id != tbl->primary_column_id && col->id != index->column_id &&
+           (col->id >= 64 || !(index->covered_columns & (1ULL << col->id)))) {
+            res = false;
+
+            break;
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return res;
+}
+
+static boolean_t tosdb_query_value_matches(const tosdb_query_t* q, const data_t* d) {
+    if(d->type != q->column->type) {
+        return false;
+    }
+
+    if(d->type < DATA_TYPE_STRING) {
+        uint64_t value = 0;
+
+        memory_memcopy(&d->value, &value, d->length);
+
+        return value == (uint64_t)q->search_value;
+    }
+
+    return d->length == q->search_length && memory_memcompare(d->value, q->search_value, d->length) == 0;
+}
+
+/**
+ * @brief sets columns of deserialized record data which are not already at record
+ * @param[in] rec record
+ * @param[in] r_d deserialized record data
+ * @return true if succeed
+ */
+static boolean_t tosdb_query_record_populate(tosdb_record_t* rec, const data_t* r_d) {
+    tosdb_record_context_t* ctx = rec->context;
+
+    data_t* tmp = r_d->value;
+
+    for(uint64_t i = 0; i < r_d->length; i++) {
+        uint64_t tmp_col_id = (uint64_t)tmp[i].name->value;
+
+        if(hashmap_get(ctx->columns, (void*)tmp_col_id)) {
+            continue;
+        }
+
+        if(!tosdb_record_set_data_with_colid(rec, tmp_col_id, tmp[i].type, tmp[i].length, tmp[i].value)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot populate record");
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static tosdb_record_t* tosdb_query_create_record_with_key(tosdb_query_t* q, const tosdb_memtable_index_item_t* item) {
+    tosdb_table_t* tbl = q->tbl;
+
+    tosdb_record_t* rec = tosdb_table_create_record(tbl);
+
+    if(!rec) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create record");
+
+        return NULL;
+    }
+
+    uint64_t len = item->key_length;
+    const void* value = item->key;
+
+    if(!len) {
+        const tosdb_index_t* pri_index = hashmap_get(tbl->indexes, (void*)tbl->primary_index_id);
+
+        len = tosdb_record_key_length(tbl->primary_column_type);
+        value = (void*)tosdb_record_key_hash_decode(pri_index, tbl->primary_column_type, item->key_hash);
+    }
+
+    if(!tosdb_record_set_data_with_colid(rec, tbl->primary_column_id, tbl->primary_column_type, len, value)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot set record key");
+        rec->destroy(rec);
+
+        return NULL;
+    }
+
+    return rec;
+}
+
+static boolean_t tosdb_query_add_result(tosdb_query_t* q, tosdb_record_t* rec) {
+    if(list_queue_push(q->results, rec) == -1ULL) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot insert record to list");
+        rec->destroy(rec);
+
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief adds a secondary index match if it is the newest item of record seen so far
+ * @details sources are visited from newest to oldest, so first item of a record wins.
+ * @param[in] q query
+ * @param[in] source_id memtable or sstable id of item
+ * @param[in] item primary key item, owned by query after call
+ * @return false on allocation errors
+ */
+static boolean_t tosdb_query_add_candidate(tosdb_query_t* q, uint64_t source_id, tosdb_memtable_index_item_t* item) {
+    if(hashmap_exists(q->seen, &item->record_id)) {
+        memory_free(item);
+
+        return true;
+    }
+
+    tosdb_query_candidate_t* cand = memory_malloc(sizeof(tosdb_query_candidate_t));
+
+    if(!cand) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create search candidate");
+        memory_free(item);
+
+        return false;
+    }
+
+    cand->record_id = item->record_id;
+    cand->source_id = source_id;
+    cand->item = item;
+
+    hashmap_put(q->seen, &cand->record_id, cand);
+
+    return true;
+}
+
+static boolean_t tosdb_query_collect_memtables(tosdb_query_t* q, tosdb_memtable_secondary_index_item_t* key) {
+    tosdb_table_t* tbl = q->tbl;
+
+    if(!tbl->memtables) {
+        return true;
+    }
+
+    iterator_t* iter = list_iterator_create(tbl->memtables);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable iterator");
+
+        return false;
+    }
+
+    boolean_t error = false;
+
+    while(!error && iter->end_of_iterator(iter) != 0) {
+        const tosdb_memtable_t* mt = iter->get_item(iter);
+
+        const tosdb_memtable_index_t* mt_idx = hashmap_get(mt->indexes, (void*)q->index->id);
+
+        if(!mt_idx) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot search memtable %lli", mt->id);
+            error = true;
+
+            break;
+        }
+
+        iterator_t* s_iter = mt_idx->index->search(mt_idx->index, key, NULL, INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL);
+
+        while(s_iter->end_of_iterator(s_iter) != 0) {
+            const tosdb_memtable_secondary_index_item_t* s_idx_item = s_iter->get_item(s_iter);
+
+            tosdb_memtable_index_item_t* res = memory_malloc(sizeof(tosdb_memtable_index_item_t) + s_idx_item->primary_key_length + s_idx_item->covered_length);
+
+            if(!res) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable index item");
+                error = true;
+
+                break;
+            }
+
+            res->record_id = s_idx_item->record_id;
+            res->is_deleted = s_idx_item->is_primary_key_deleted;
+            res->key_hash = s_idx_item->primary_key_hash;
+            res->key_length = s_idx_item->primary_key_length;
+            res->offset = s_idx_item->offset;
+            res->length = s_idx_item->covered_length;
+            memory_memcopy(s_idx_item->data + s_idx_item->secondary_key_length, res->key, res->key_length + res->length);
+
+            if(!tosdb_query_add_candidate(q, mt->id, res)) {
+                error = true;
+
+                break;
+            }
+
+            s_iter = s_iter->next(s_iter);
+        }
+
+        s_iter->destroy(s_iter);
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return !error;
+}
+
+static boolean_t tosdb_query_collect_sstable_list(tosdb_query_t* q, tosdb_record_t* record, list_t* st_list, tosdb_memtable_secondary_index_item_t* key) {
+    iterator_t* iter = list_iterator_create(st_list);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstables list items iterator");
+
+        return false;
+    }
+
+    boolean_t error = false;
+
+    while(!error && iter->end_of_iterator(iter) != 0) {
+        tosdb_block_sstable_list_item_t* sli = (tosdb_block_sstable_list_item_t*)iter->get_item(iter);
+
+        if(q->index->id <= sli->index_count) {
+            set_t* results = set_create(tosdb_memtable_record_id_comparator);
+
+            if(!results) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable search results");
+                error = true;
+
+                break;
+            }
+
+            error = !tosdb_sstable_search_on_index(record, results, sli, key, q->index->id);
+
+            iterator_t* r_iter = set_create_iterator(results);
+
+            while(r_iter->end_of_iterator(r_iter) != 0) {
+                tosdb_memtable_index_item_t* item = (tosdb_memtable_index_item_t*)r_iter->get_item(r_iter);
+
+                if(error) {
+                    memory_free(item);
+                } else if(!tosdb_query_add_candidate(q, sli->sstable_id, item)) {
+                    error = true;
+                }
+
+                r_iter = r_iter->next(r_iter);
+            }
+
+            r_iter->destroy(r_iter);
+
+            set_destroy(results);
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return !error;
+}
+
+static boolean_t tosdb_query_collect(tosdb_query_t* q, tosdb_record_t* record) {
+    tosdb_table_t* tbl = q->tbl;
+
+    uint64_t key_length = q->column->type < DATA_TYPE_STRING ? 0 : q->search_length;
+
+    tosdb_memtable_secondary_index_item_t* s_key = memory_malloc(sizeof(tosdb_memtable_secondary_index_item_t) + key_length);
+
+    if(!s_key) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable secondary index item");
+
+        return false;
+    }
+
+    const tosdb_record_key_t* r_key = hashmap_get(((tosdb_record_context_t*)record->context)->keys, (void*)q->index->id);
+
+    s_key->secondary_key_hash = r_key->key_hash;
+    s_key->secondary_key_length = r_key->key_length;
+    memory_memcopy(r_key->key, s_key->data, s_key->secondary_key_length);
+
+    boolean_t error = !tosdb_query_collect_memtables(q, s_key);
+
+    if(!error && tbl->sstable_list_items) {
+        error = !tosdb_query_collect_sstable_list(q, record, tbl->sstable_list_items, s_key);
+    }
+
+    if(!error && tbl->sstable_levels) {
+        for(uint64_t i = 1; i <= tbl->sstable_max_level; i++) {
+            list_t* st_lvl_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)i);
+
+            if(st_lvl_l && !tosdb_query_collect_sstable_list(q, record, st_lvl_l, s_key)) {
+                error = true;
+
+                break;
+            }
+        }
+    }
+
+    memory_free(s_key);
+
+    return !error;
+}
+
+static void tosdb_query_destroy_candidates(tosdb_query_t* q) {
+    iterator_t* iter = hashmap_iterator_create(q->seen);
+
+    if(iter) {
+        while(iter->end_of_iterator(iter) != 0) {
+            tosdb_query_candidate_t* cand = (tosdb_query_candidate_t*)iter->get_item(iter);
+
+            memory_free(cand->item);
+            memory_free(cand);
+
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+    }
+
+    hashmap_destroy(q->seen);
+    q->seen = NULL;
+}
+
+/**
+ * @brief fetches records with primary keys and keeps ones which still have searched value
+ * @details a key re-inserted with a new record leaves items of old record id at older sources, record_ids filters them.
+ * @param[in] q query
+ * @param[in] recs records with primary keys, destroyed or moved to results
+ * @param[in] record_ids expected record ids, null if records are already validated
+ * @param[in] count record count
+ * @return false on errors
+ */
+static boolean_t tosdb_query_fetch(tosdb_query_t* q, tosdb_record_t** recs, const uint128_t* record_ids, uint64_t count) {
+    if(!count) {
+        return true;
+    }
+
+    boolean_t* founds = memory_malloc(sizeof(boolean_t) * count);
+
+    if(!founds) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create fetch array");
+
+        for(uint64_t i = 0; i < count; i++) {
+            recs[i]->destroy(recs[i]);
+        }
+
+        return false;
+    }
+
+    boolean_t res = tosdb_table_multi_get(q->tbl, recs, count, founds);
+
+    for(uint64_t i = 0; i < count; i++) {
+        tosdb_record_context_t* ctx = recs[i]->context;
+
+        if(res && founds[i] && (!record_ids || record_ids[i] == ctx->record_id)) {
+            const data_t* d = hashmap_get(ctx->columns, (void*)q->column->id);
+
+            if(d && tosdb_query_value_matches(q, d)) {
+                res = tosdb_query_add_result(q, recs[i]);
+
+                continue;
+            }
+        }
+
+        recs[i]->destroy(recs[i]);
+    }
+
+    memory_free(founds);
+
+    return res;
+}
+
+/**
+ * @brief builds records of live candidates
+ * @details for index only plan candidates are validated with primary index, a candidate is live if newest primary
+ * index item of its key is at same source with same value offset. records are built from covered data.
+ * @param[in] q query
+ * @param[in] index_only validate candidates and build records from index items
+ * @return false on errors
+ */
+static boolean_t tosdb_query_resolve_candidates(tosdb_query_t* q, boolean_t index_only) {
+    uint64_t count = hashmap_size(q->seen);
+
+    if(!count) {
+        return true;
+    }
+
+    tosdb_query_candidate_t** cands = memory_malloc(sizeof(tosdb_query_candidate_t*) * count);
+    tosdb_record_t** recs = memory_malloc(sizeof(tosdb_record_t*) * count);
+    tosdb_record_t** pending = memory_malloc(sizeof(tosdb_record_t*) * count);
+    uint64_t* pending_positions = memory_malloc(sizeof(uint64_t) * count);
+    uint64_t* offsets = memory_malloc(sizeof(uint64_t) * count);
+    boolean_t* founds = memory_malloc(sizeof(boolean_t) * count);
+
+    if(!cands || !recs || !pending || !pending_positions || !offsets || !founds) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create candidate arrays");
+        memory_free(cands);
+        memory_free(recs);
+        memory_free(pending);
+        memory_free(pending_positions);
+        memory_free(offsets);
+        memory_free(founds);
+
+        return false;
+    }
+
+    boolean_t error = false;
+    uint64_t rec_count = 0;
+
+    iterator_t* iter = hashmap_iterator_create(q->seen);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create candidate iterator");
+        error = true;
+    }
+
+    while(!error && iter->end_of_iterator(iter) != 0) {
+        tosdb_query_candidate_t* cand = (tosdb_query_candidate_t*)iter->get_item(iter);
+
+        iter = iter->next(iter);
+
+        if(cand->item->is_deleted) {
+            continue;
+        }
+
+        tosdb_record_t* rec = tosdb_query_create_record_with_key(q, cand->item);
+
+        if(!rec) {
+            error = true;
+
+            break;
+        }
+
+        cands[rec_count] = cand;
+        recs[rec_count] = rec;
+        rec_count++;
+    }
+
+    if(iter) {
+        iter->destroy(iter);
+    }
+
+    if(!error && !index_only) {
+        uint128_t* record_ids = memory_malloc(sizeof(uint128_t) * MAX(rec_count, 1ULL));
+
+        if(!record_ids) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create record id array");
+            error = true;
+        } else {
+            for(uint64_t i = 0; i < rec_count; i++) {
+                record_ids[i] = cands[i]->record_id;
+            }
+
+            error = !tosdb_query_fetch(q, recs, record_ids, rec_count);
+            rec_count = 0;
+        }
+
+        memory_free(record_ids);
+    }
+
+    uint64_t pending_count = 0;
+
+    if(!error) {
+        for(uint64_t i = 0; i < rec_count; i++) {
+            founds[i] = tosdb_memtable_locate(recs[i], &offsets[i]);
+
+            if(!founds[i]) {
+                pending[pending_count] = recs[i];
+                pending_positions[pending_count] = i;
+                pending_count++;
+            }
+        }
+    }
+
+    if(!error && pending_count) {
+        boolean_t* pending_founds = memory_malloc(sizeof(boolean_t) * pending_count);
+        uint64_t* pending_offsets = memory_malloc(sizeof(uint64_t) * pending_count);
+
+        if(!pending_founds || !pending_offsets || !tosdb_sstable_multi_locate(q->tbl, pending, pending_count, pending_founds, pending_offsets)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot locate candidates");
+            error = true;
+        } else {
+            for(uint64_t i = 0; i < pending_count; i++) {
+                founds[pending_positions[i]] = pending_founds[i];
+                offsets[pending_positions[i]] = pending_offsets[i];
+            }
+        }
+
+        memory_free(pending_founds);
+        memory_free(pending_offsets);
+    }
+
+    // candidates without covered data are written before index covers columns, they are fetched
+    uint64_t fetch_count = 0;
+
+    for(uint64_t i = 0; i < rec_count; i++) {
+        tosdb_record_t* rec = recs[i];
+        tosdb_record_context_t* ctx = rec->context;
+        const tosdb_query_candidate_t* cand = cands[i];
+
+        boolean_t live = !error && founds[i] && !ctx->is_deleted && ctx->sstable_id == cand->source_id && offsets[i] == cand->item->offset;
+
+        if(!live) {
+            rec->destroy(rec);
+
+            continue;
+        }
+
+        if(!cand->item->length) {
+            tosdb_record_t* f_rec = tosdb_query_create_record_with_key(q, cand->item);
+
+            rec->destroy(rec);
+
+            if(!f_rec) {
+                error = true;
+
+                continue;
+            }
+
+            pending[fetch_count++] = f_rec;
+
+            continue;
+        }
+
+        data_t s_d = {0};
+        s_d.length = cand->item->length;
+        s_d.type = DATA_TYPE_INT8_ARRAY;
+        s_d.value = cand->item->key + cand->item->key_length;
+
+        data_t* r_d = data_bson_deserialize(&s_d);
+
+        if(!r_d) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot deserialize covered data");
+            rec->destroy(rec);
+            error = true;
+
+            continue;
+        }
+
+        boolean_t populated = tosdb_query_record_populate(rec, r_d);
+
+        data_free(r_d);
+
+        if(populated && !hashmap_get(ctx->columns, (void*)q->column->id)) {
+            populated = tosdb_record_set_data_with_colid(rec, q->column->id, q->column->type, q->search_length, q->search_value);
+        }
+
+        if(!populated) {
+            rec->destroy(rec);
+            error = true;
+
+            continue;
+        }
+
+        ctx->record_id = cand->record_id;
+        ctx->is_deleted = false;
+
+        if(!tosdb_query_add_result(q, rec)) {
+            error = true;
+        }
+    }
+
+    if(error) {
+        for(uint64_t i = 0; i < fetch_count; i++) {
+            pending[i]->destroy(pending[i]);
+        }
+    } else {
+        error = !tosdb_query_fetch(q, pending, NULL, fetch_count);
+    }
+
+    memory_free(cands);
+    memory_free(recs);
+    memory_free(pending);
+    memory_free(pending_positions);
+    memory_free(offsets);
+    memory_free(founds);
+
+    return !error;
+}
+
+/**
+ * @brief checks a scanned primary index item, newest version of each primary key is filtered with searched value
+ * @param[in] q query
+ * @param[in] item primary index item
+ * @param[in] value serialized record, null for deleted items
+ * @param[in] length serialized record length
+ * @return false on errors
+ */
+static boolean_t tosdb_query_scan_item(tosdb_query_t* q, const tosdb_memtable_index_item_t* item, const uint8_t* value, uint64_t length) {
+    if(hashmap_exists(q->seen, item)) {
+        return true;
+    }
+
+    uint64_t key_size = sizeof(tosdb_memtable_index_item_t) + item->key_length;
+
+    tosdb_memtable_index_item_t* seen_key = memory_malloc(key_size);
+
+    if(!seen_key) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create scanned key");
+
+        return false;
+    }
+
+    memory_memcopy(item, seen_key, key_size);
+
+    hashmap_put(q->seen, seen_key, seen_key);
+
+    if(item->is_deleted || !value) {
+        return true;
+    }
+
+    data_t s_d = {0};
+    s_d.length = length;
+    s_d.type = DATA_TYPE_INT8_ARRAY;
+    s_d.value = (void*)value;
+
+    data_t* r_d = data_bson_deserialize(&s_d);
+
+    if(!r_d) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot deserialize data");
+
+        return false;
+    }
+
+    boolean_t matches = false;
+    data_t* tmp = r_d->value;
+
+    for(uint64_t i = 0; i < r_d->length; i++) {
+        if((uint64_t)tmp[i].name->value == q->column->id) {
+            matches = tosdb_query_value_matches(q, &tmp[i]);
+
+            break;
+        }
+    }
+
+    if(!matches) {
+        data_free(r_d);
+
+        return true;
+    }
+
+    tosdb_record_t* rec = tosdb_table_create_record(q->tbl);
+
+    if(!rec) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create record");
+        data_free(r_d);
+
+        return false;
+    }
+
+    boolean_t populated = tosdb_query_record_populate(rec, r_d);
+
+    data_free(r_d);
+
+    if(!populated) {
+        rec->destroy(rec);
+
+        return false;
+    }
+
+    ((tosdb_record_context_t*)rec->context)->record_id = item->record_id;
+
+    return tosdb_query_add_result(q, rec);
+}
+
+static boolean_t tosdb_query_scan_sstable_cb(void* arg, const tosdb_block_sstable_list_item_t* sli, const tosdb_memtable_index_item_t* item, const uint8_t* value) {
+    UNUSED(sli);
+
+    return tosdb_query_scan_item(arg, item, value, item->length);
+}
+
+static boolean_t tosdb_query_scan_sstable_list(tosdb_query_t* q, list_t* st_list) {
+    iterator_t* iter = list_iterator_create(st_list);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstables list items iterator");
+
+        return false;
+    }
+
+    boolean_t error = false;
+
+    while(!error && iter->end_of_iterator(iter) != 0) {
+        tosdb_block_sstable_list_item_t* sli = (tosdb_block_sstable_list_item_t*)iter->get_item(iter);
+
+        error = !tosdb_sstable_scan(q->tbl, sli, tosdb_query_scan_sstable_cb, q);
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return !error;
+}
+
+/**
+ * @brief reads newest version of all records and filters them with searched value
+ * @details sources are visited from newest to oldest, older versions of scanned primary keys are skipped.
+ * @param[in] q query
+ * @return false on errors
+ */
+static boolean_t tosdb_query_full_scan(tosdb_query_t* q) {
+    tosdb_table_t* tbl = q->tbl;
+    boolean_t error = false;
+
+    if(tbl->memtables) {
+        iterator_t* iter = list_iterator_create(tbl->memtables);
+
+        if(!iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable iterator");
+
+            return false;
+        }
+
+        while(!error && iter->end_of_iterator(iter) != 0) {
+            const tosdb_memtable_t* mt = iter->get_item(iter);
+
+            const tosdb_memtable_index_t* mt_idx = hashmap_get(mt->indexes, (void*)tbl->primary_index_id);
+
+            if(!mt_idx) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot scan memtable %lli", mt->id);
+                error = true;
+
+                break;
+            }
+
+            iterator_t* s_iter = mt_idx->index->create_iterator(mt_idx->index);
+
+            while(!error && s_iter->end_of_iterator(s_iter) != 0) {
+                const tosdb_memtable_index_item_t* item = s_iter->get_item(s_iter);
+
+                error = !tosdb_query_scan_item(q, item, item->is_deleted ? NULL : mt->values + item->offset, item->length);
+
+                s_iter = s_iter->next(s_iter);
+            }
+
+            s_iter->destroy(s_iter);
+
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+    }
+
+    if(!error && tbl->sstable_list_items) {
+        error = !tosdb_query_scan_sstable_list(q, tbl->sstable_list_items);
+    }
+
+    if(!error && tbl->sstable_levels) {
+        for(uint64_t i = 1; i <= tbl->sstable_max_level; i++) {
+            list_t* st_lvl_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)i);
+
+            if(st_lvl_l && !tosdb_query_scan_sstable_list(q, st_lvl_l)) {
+                error = true;
+
+                break;
+            }
+        }
+    }
+
+    iterator_t* iter = hashmap_iterator_create(q->seen);
+
+    if(iter) {
+        while(iter->end_of_iterator(iter) != 0) {
+            memory_free((void*)iter->get_item(iter));
+
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+    }
+
+    hashmap_destroy(q->seen);
+    q->seen = NULL;
+
+    return !error;
+}
+
+static boolean_t tosdb_query_primary_lookup(tosdb_query_t* q) {
+    tosdb_record_t* rec = tosdb_table_create_record(q->tbl);
+
+    if(!rec) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create record");
+
+        return false;
+    }
+
+    if(!tosdb_record_set_data_with_colid(rec, q->column->id, q->column->type, q->search_length, q->search_value)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot set record key");
+        rec->destroy(rec);
+
+        return false;
+    }
+
+    if(!rec->get_record(rec)) {
+        rec->destroy(rec);
+
+        return true;
+    }
+
+    return tosdb_query_add_result(q, rec);
+}
+
+/**
+ * @brief sorts results by primary key as index scans yield them
+ * @param[in] q query
+ * @return false on errors
+ */
+static boolean_t tosdb_query_sort_results(tosdb_query_t* q) {
+    uint64_t count = list_size(q->results);
+
+    if(count < 2) {
+        return true;
+    }
+
+    tosdb_record_t** recs = memory_malloc(sizeof(tosdb_record_t*) * count);
+
+    if(!recs) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create result array");
+
+        return false;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        recs[i] = (tosdb_record_t*)list_queue_pop(q->results);
+    }
+
+    quicksort2((void**)recs, count, tosdb_query_result_comparator);
+
+    for(uint64_t i = 0; i < count; i++) {
+        list_queue_push(q->results, recs[i]);
+    }
+
+    memory_free(recs);
+
+    return true;
+}
+
+static tosdb_query_plan_t tosdb_query_plan(tosdb_query_t* q) {
+    if(!q->index) {
+        return TOSDB_QUERY_PLAN_FULL_SCAN;
+    }
+
+    if(q->index->type != TOSDB_INDEX_SECONDARY) {
+        return TOSDB_QUERY_PLAN_PRIMARY_LOOKUP;
+    }
+
+    if(tosdb_query_index_is_covering(q->tbl, q->index)) {
+        return TOSDB_QUERY_PLAN_INDEX_ONLY;
+    }
+
+    uint64_t candidate_count = hashmap_size(q->seen);
+    uint64_t record_count = tosdb_query_record_count(q->tbl);
+
+    // fetching most of table key by key costs more than reading sources with valuelog order
+    if(candidate_count * TOSDB_QUERY_FULL_SCAN_RATIO >= record_count && candidate_count > 1) {
+        return TOSDB_QUERY_PLAN_FULL_SCAN;
+    }
+
+    return TOSDB_QUERY_PLAN_SECONDARY_FETCH;
+}
+
+list_t* tosdb_record_search(tosdb_record_t* record) {
+    if(!record || !record->context) {
+        PRINTLOG(TOSDB, LOG_ERROR, "record is null");
+
+        return NULL;
+    }
+
+    tosdb_record_context_t* ctx = record->context;
+
+    tosdb_query_t q = {0};
+
+    q.tbl = ctx->table;
+
+    if(hashmap_size(ctx->keys) == 1) {
+        iterator_t* iter = hashmap_iterator_create(ctx->keys);
+
+        if(!iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot get key");
+
+            return NULL;
+        }
+
+        const tosdb_record_key_t* r_key = iter->get_item(iter);
+
+        iter->destroy(iter);
+
+        q.index = hashmap_get(q.tbl->indexes, (void*)r_key->index_id);
+        q.column = tosdb_table_get_column_by_index_id(q.tbl, r_key->index_id);
+    } else if(!hashmap_size(ctx->keys) && hashmap_size(ctx->columns) == 1) {
+        iterator_t* iter = hashmap_iterator_create(ctx->columns);
+
+        if(!iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot get search column");
+
+            return NULL;
+        }
+
+        const data_t* d = iter->get_item(iter);
+
+        iter->destroy(iter);
+
+        q.column = tosdb_query_get_column_by_id(q.tbl, (uint64_t)d->name->value);
+    } else {
+        PRINTLOG(TOSDB, LOG_ERROR, "search supports only one column");
+
+        return NULL;
+    }
+
+    if(!q.column) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot find search column of table %s", q.tbl->name);
+
+        return NULL;
+    }
+
+    if(!tosdb_record_get_data_with_colid(record, q.column->id, q.column->type, &q.search_length, (void**)&q.search_value)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot get search value");
+
+        return NULL;
+    }
+
+    q.results = list_create_list();
+    q.seen = hashmap_new_with_hkg_with_hkc(128, tosdb_query_record_id_key_generator, tosdb_query_record_id_key_comparator);
+
+    boolean_t error = !q.results || !q.seen;
+
+    if(error) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create search state");
+    }
+
+    if(!error && q.index && q.index->type == TOSDB_INDEX_SECONDARY) {
+        error = !tosdb_query_collect(&q, record);
+    }
+
+    tosdb_query_plan_t plan = tosdb_query_plan(&q);
+
+    PRINTLOG(TOSDB, LOG_TRACE, "search on table %s column %s plan %i candidates %lli", q.tbl->name, q.column->name, plan, hashmap_size(q.seen));
+
+    if(!error) {
+        switch(plan) {
+        case TOSDB_QUERY_PLAN_PRIMARY_LOOKUP:
+            error = !tosdb_query_primary_lookup(&q);
+            break;
+        case TOSDB_QUERY_PLAN_SECONDARY_FETCH:
+            error = !tosdb_query_resolve_candidates(&q, false);
+            break;
+        case TOSDB_QUERY_PLAN_INDEX_ONLY:
+            error = !tosdb_query_resolve_candidates(&q, true);
+            break;
+        case TOSDB_QUERY_PLAN_FULL_SCAN:
+            tosdb_query_destroy_candidates(&q);
+            q.seen = hashmap_new_with_hkg_with_hkc(MAX(tosdb_query_record_count(q.tbl), 128ULL),
+                                                   tosdb_query_primary_key_generator, tosdb_memtable_index_comparator);
+
+            if(!q.seen) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot create scanned key map");
+                error = true;
+            } else {
+                error = !tosdb_query_full_scan(&q);
+            }
+
+            break;
+        }
+    }
+
+    if(q.seen) {
+        tosdb_query_destroy_candidates(&q);
+    }
+
+    if(q.column->type >= DATA_TYPE_STRING) {
+        memory_free(q.search_value);
+    }
+
+    if(!error) {
+        error = !tosdb_query_sort_results(&q);
+    }
+
+    if(error) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot search table %s", q.tbl->name);
+
+        if(q.results) {
+            list_destroy_with_type(q.results, LIST_DESTROY_WITH_DATA, tosdb_query_destroy_record_cb);
+        }
+
+        return NULL;
+    }
+
+    return q.results;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file tosdb_range_scan.64.c
+ * @brief tosdb range scan over ordered indexes implementation, records are streamed by merge iterator
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <tosdb/tosdb.h>
+#include <tosdb/tosdb_internal.h>
+#include <logging.h>
+
+MODULE("turnstone.kernel.db");
+
+iterator_t* tosdb_record_range_scan_iterator(tosdb_record_t* record_lo, tosdb_record_t* record_hi) {
+    if(!record_lo || !record_lo->context || !record_hi || !record_hi->context) {
+        PRINTLOG(TOSDB, LOG_ERROR, "range records are null");
+
+        return NULL;
+    }
+
+    tosdb_table_t* tbl = ((tosdb_record_context_t*)record_lo->context)->table;
+
+    if(tbl != ((tosdb_record_context_t*)record_hi->context)->table) {
+        PRINTLOG(TOSDB, LOG_ERROR, "range records belong to different tables");
+
+        return NULL;
+    }
+
+    uint64_t lo_index_id = 0;
+    uint64_t hi_index_id = 0;
+
+    tosdb_memtable_index_item_t* lo = tosdb_record_iterator_key_item(record_lo, &lo_index_id);
+    tosdb_memtable_index_item_t* hi = tosdb_record_iterator_key_item(record_hi, &hi_index_id);
+
+    if(!lo || !hi || lo_index_id != hi_index_id) {
+        PRINTLOG(TOSDB, LOG_ERROR, "range records should have same index key");
+        memory_free(lo);
+        memory_free(hi);
+
+        return NULL;
+    }
+
+    const tosdb_index_t* index = hashmap_get(tbl->indexes, (void*)lo_index_id);
+
+    if(!index || !index->is_ordered || index->type == TOSDB_INDEX_SECONDARY) {
+        PRINTLOG(TOSDB, LOG_ERROR, "range scan needs an ordered primary or unique index on table %s", tbl->name);
+        memory_free(lo);
+        memory_free(hi);
+
+        return NULL;
+    }
+
+    // lo after hi is an empty range, merge iterator ends immediately
+    iterator_t* merge_iter = tosdb_merge_iterator_create(tbl, lo_index_id, lo, hi, NULL);
+
+    memory_free(lo);
+    memory_free(hi);
+
+    return tosdb_record_iterator_create(TOSDB_RECORD_ITERATOR_TYPE_RECORD, tbl, lo_index_id, merge_iter);
+}
+
+static int8_t tosdb_record_range_scan_destroy_record_cb(memory_heap_t* heap, void* item) {
+    UNUSED(heap);
+
+    tosdb_record_t* rec = item;
+
+    return rec->destroy(rec) ? 0 : -1;
+}
+
+list_t* tosdb_record_range_scan(tosdb_record_t* record_lo, tosdb_record_t* record_hi, uint64_t limit) {
+    iterator_t* iter = tosdb_record_range_scan_iterator(record_lo, record_hi);
+
+    if(!iter) {
+        return NULL;
+    }
+
+    list_t* recs = list_create_list();
+
+    if(!recs) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create range scan list");
+        iter->destroy(iter);
+
+        return NULL;
+    }
+
+    while(iter->end_of_iterator(iter) != 0 && (!limit || list_size(recs) < limit)) {
+        tosdb_record_t* rec = (tosdb_record_t*)iter->delete_item(iter);
+
+        if(list_queue_push(recs, rec) == -1ULL) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot add record to range scan list");
+            rec->destroy(rec);
+            list_destroy_with_type(recs, LIST_DESTROY_WITH_DATA, tosdb_record_range_scan_destroy_record_cb);
+            recs = NULL;
+
+            break;
+        }
+    }
+
+    iter->destroy(iter);
+
+    return recs;
+}
@@ -255,16 +255,14 @@ boolean_t tosdb_record_set_data_with_colid(tosdb_record_t * record, const uint64
     col_value->type = type;
     col_value->length = len;
 
-    uint64_t idx_id = tosdb_record_get_index_id(record, col_id);
+    const tosdb_index_t* idx = hashmap_get(ctx->table->index_column_map, (void*)col_id);
 
-    if(idx_id) {
-        uint64_t key_hash = 0;
+    if(idx) {
+        uint64_t idx_id = idx->id;
+        uint64_t key_hash = tosdb_record_key_hash_encode(idx, type, len, (type < DATA_TYPE_STRING)?value:l_value);
 
         if(type < DATA_TYPE_STRING) {
-            key_hash = (uint64_t)value;
             len = 0;
-        } else {
-            key_hash = xxhash64_hash(l_value, len);
         }
 
         tosdb_record_key_t* r_key = memory_malloc(sizeof(tosdb_record_key_t));
@@ -302,6 +300,77 @@ boolean_t tosdb_record_set_data_with_colid(tosdb_record_t * record, const uint64
 }
 #pragma GCC diagnostic pop
 
+uint64_t tosdb_record_key_hash_encode(const tosdb_index_t* index, data_type_t type, uint64_t len, const void* value) {
+    if(!index->is_ordered) {
+        if(type < DATA_TYPE_STRING) {
+            return (uint64_t)value;
+        }
+
+        return xxhash64_hash(value, len);
+    }
+
+    uint64_t key_hash = 0;
+
+    if(type == DATA_TYPE_FLOAT32) {
+        // ieee754 bits flipped for unsigned ordering, negatives are reversed
+        key_hash = (uint64_t)value & 0xFFFFFFFFULL;
+
+        if(key_hash & 0x80000000ULL) {
+            key_hash = ~key_hash & 0xFFFFFFFFULL;
+        } else {
+            key_hash |= 0x80000000ULL;
+        }
+    } else if(type == DATA_TYPE_FLOAT64) {
+        key_hash = (uint64_t)value;
+
+        if(key_hash & 0x8000000000000000ULL) {
+            key_hash = ~key_hash;
+        } else {
+            key_hash |= 0x8000000000000000ULL;
+        }
+    } else if(type < DATA_TYPE_STRING) {
+        // integers are sign extended, flipping sign bit gives unsigned ordering
+        key_hash = (uint64_t)value ^ 0x8000000000000000ULL;
+    } else {
+        // big endian prefix of key, ties are resolved by comparing whole key
+        const uint8_t* u8_value = value;
+
+        for(uint64_t i = 0; i < sizeof(uint64_t); i++) {
+            key_hash <<= 8;
+
+            if(i < len) {
+                key_hash |= u8_value[i];
+            }
+        }
+    }
+
+    return key_hash;
+}
+
+uint64_t tosdb_record_key_hash_decode(const tosdb_index_t* index, data_type_t type, uint64_t key_hash) {
+    if(!index || !index->is_ordered || type >= DATA_TYPE_STRING) {
+        return key_hash;
+    }
+
+    if(type == DATA_TYPE_FLOAT32) {
+        if(key_hash & 0x80000000ULL) {
+            return key_hash & 0x7FFFFFFFULL;
+        }
+
+        return ~key_hash & 0xFFFFFFFFULL;
+    }
+
+    if(type == DATA_TYPE_FLOAT64) {
+        if(key_hash & 0x8000000000000000ULL) {
+            return key_hash & 0x7FFFFFFFFFFFFFFFULL;
+        }
+
+        return ~key_hash;
+    }
+
+    return key_hash ^ 0x8000000000000000ULL;
+}
+
 boolean_t tosdb_record_get_data(tosdb_record_t * record, const char_t* colname, data_type_t type, uint64_t* len, void** value) {
     if(!record || !record->context || !strlen(colname)) {
         PRINTLOG(TOSDB, LOG_ERROR, "record or colname is null");
@@ -419,294 +488,90 @@ boolean_t tosdb_record_get(tosdb_record_t* record) {
     return false;
 }
 
-boolean_t tosdb_record_search_set_destroy_cb(void * item) {
-    if(!item) {
-        return true;
-    }
-
-    tosdb_record_t* rec = item;
-
-    return rec->destroy(rec);
-}
+boolean_t tosdb_table_multi_get(tosdb_table_t* tbl, tosdb_record_t** records, uint64_t count, boolean_t* founds) {
+    if(!tbl || !records || !founds) {
+        PRINTLOG(TOSDB, LOG_ERROR, "table, records or founds is null");
 
-static boolean_t tosdb_record_search_set_destroy_mii_cb(void * item) {
-    if(!item) {
-        return true;
+        return false;
     }
 
-    memory_free(item);
+    for(uint64_t i = 0; i < count; i++) {
+        founds[i] = false;
 
-    return true;
-}
+        if(!records[i] || !records[i]->context) {
+            PRINTLOG(TOSDB, LOG_ERROR, "record %lli is null", i);
 
-static boolean_t tosdb_record_compare_values(data_type_t type, uint64_t item1_len, void* item1, uint64_t item2_len, void* item2) {
-    if(type < DATA_TYPE_STRING) {
-        uint64_t tmp1 = (uint64_t)item1;
-        uint64_t tmp2 = (uint64_t)item2;
-
-        if(tmp1 != tmp2) {
             return false;
         }
-    } else if(type == DATA_TYPE_STRING || type == DATA_TYPE_INT8_ARRAY) {
-        if(item1_len != item2_len) {
-            return false;
-        }
-
-        if(memory_memcompare(item1, item2, item1_len)) {
-            return false;
-        }
-    } else {
-        return false;
-    }
-
-    return true;
-}
-
-list_t* tosdb_record_search(tosdb_record_t* record) {
-    if(!record || !record->context) {
-        return NULL;
-    }
 
-    tosdb_record_context_t* ctx = record->context;
+        tosdb_record_context_t* ctx = records[i]->context;
 
-    if(hashmap_size(ctx->keys) != 1) {
-        PRINTLOG(TOSDB, LOG_ERROR, "record search supports only one key");
+        if(ctx->table != tbl) {
+            PRINTLOG(TOSDB, LOG_ERROR, "record %lli does not belong to table %s", i, tbl->name);
 
-        return NULL;
-    }
-
-    iterator_t* iter = hashmap_iterator_create(ctx->keys);
-
-    if(!iter) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot get key");
-
-        return NULL;
-    }
-
-    const tosdb_record_key_t* r_key = iter->get_item(iter);
-
-    iter->destroy(iter);
-
-    if(!r_key) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot get key");
-
-        return NULL;
-    }
-
-    const tosdb_index_t* index = hashmap_get(ctx->table->indexes, (void*)r_key->index_id);
-
-    if(!index) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot get index");
-
-        return NULL;
-    }
-
-    const tosdb_column_t* col = tosdb_table_get_column_by_index_id(ctx->table, r_key->index_id);
-
-    if(!col) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot get column");
-
-        return NULL;
-    }
-
-    uint8_t* search_key = NULL;
-    uint64_t search_key_len = 0;
-
-    if(!tosdb_record_get_data_with_colid(record, col->id, col->type, &search_key_len, (void**)&search_key)) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot get data");
-
-        return NULL;
-    }
-
-    if(col->type == DATA_TYPE_STRING || col->type == DATA_TYPE_INT8_ARRAY) {
-        PRINTLOG(TOSDB, LOG_TRACE, "search key %s will be searched on table %s", search_key, ctx->table->name);
-    } else {
-        PRINTLOG(TOSDB, LOG_TRACE, "search key %lli will be searched on table %s", (int64_t)search_key, ctx->table->name);
-    }
-
-
-    set_t* results = set_create(tosdb_memtable_record_id_comparator);
-
-    if(!results) {
-        memory_free(search_key);
-
-        return NULL;
-    }
-
-    if(!tosdb_memtable_search(record, results)) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot search at memtable");
-        set_destroy_with_callback(results, tosdb_record_search_set_destroy_mii_cb);
-        memory_free(search_key);
-
-        return NULL;
-    }
+            return false;
+        }
 
-    if(!tosdb_sstable_search(record, results)) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot search at sstables");
-        set_destroy_with_callback(results, tosdb_record_search_set_destroy_mii_cb);
-        memory_free(search_key);
+        if(hashmap_size(ctx->keys) != 1) {
+            PRINTLOG(TOSDB, LOG_ERROR, "record %lli should have only one key", i);
 
-        return NULL;
+            return false;
+        }
     }
 
-    if(col->type == DATA_TYPE_STRING || col->type == DATA_TYPE_INT8_ARRAY) {
-        PRINTLOG(TOSDB, LOG_TRACE, "search key %s searched, prob res size %lli", search_key, set_size(results));
-    } else {
-        PRINTLOG(TOSDB, LOG_TRACE, "search key %lli searched prob res size %lli", (int64_t)search_key, set_size(results));
+    if(!count) {
+        return true;
     }
 
-    iterator_t* f_iter = set_create_iterator(results);
+    tosdb_record_t** pending = memory_malloc(sizeof(tosdb_record_t*) * count);
+    uint64_t* pending_positions = memory_malloc(sizeof(uint64_t) * count);
+    boolean_t* pending_founds = memory_malloc(sizeof(boolean_t) * count);
 
-    if(!f_iter) {
-        set_destroy_with_callback(results, tosdb_record_search_set_destroy_mii_cb);
-        memory_free(search_key);
+    if(!pending || !pending_positions || !pending_founds) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create multi get arrays");
+        memory_free(pending);
+        memory_free(pending_positions);
+        memory_free(pending_founds);
 
-        return NULL;
+        return false;
     }
 
-    tosdb_record_context_t* r_ctx = record->context;
-
-    list_t* recs = list_create_list();
+    uint64_t pending_count = 0;
 
-    boolean_t dont_add = false;
-
-    if(!recs) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot create results list");
-        dont_add = true;
+    for(uint64_t i = 0; i < count; i++) {
+        if(tosdb_memtable_get(records[i])) {
+            founds[i] = !tosdb_record_is_deleted(records[i]);
+        } else {
+            pending[pending_count] = records[i];
+            pending_positions[pending_count] = i;
+            pending_count++;
+        }
     }
 
-    while(f_iter->end_of_iterator(f_iter) != 0) {
-        tosdb_memtable_index_item_t* item = (tosdb_memtable_index_item_t*)f_iter->get_item(f_iter);
-
-        if(!dont_add) {
-            tosdb_record_t* rec = tosdb_table_create_record(r_ctx->table);
-
-            uint64_t len = item->key_length;
-            void* value = item->key;
+    boolean_t res = tosdb_sstable_multi_get(tbl, pending, pending_count, pending_founds);
 
-            if(len == 0) {
-                switch(r_ctx->table->primary_column_type) {
-                case DATA_TYPE_CHAR:
-                case DATA_TYPE_INT8:
-                case DATA_TYPE_BOOLEAN:
-                    len = 1;
-                    break;
-                case DATA_TYPE_INT16:
-                    len = 2;
-                    break;
-                case DATA_TYPE_INT32:
-                    len = 4;
-                    break;
-                case DATA_TYPE_INT64:
-                    len = 8;
-                    break;
-                default:
-                    break;
-                }
-
-                value = (void*)item->key_hash;
-            }
-
-            if(rec) {
-                if(!tosdb_record_set_data_with_colid(rec,
-                                                     r_ctx->table->primary_column_id,
-                                                     r_ctx->table->primary_column_type,
-                                                     len,
-                                                     value)) {
-                    PRINTLOG(TOSDB, LOG_ERROR, "cannot set pk");
-                    dont_add = true;
-                    rec->destroy(rec);
-                } else if(rec->get_record(rec)) {
-                    uint8_t* res_key_data = NULL;
-                    uint64_t res_key_len = 0;
-
-                    if(item->is_deleted) {
-                        PRINTLOG(TOSDB, LOG_INFO, "record is deleted rec id %llx", (uint64_t)item->record_id);
-                    }
-
-                    if(!tosdb_record_get_data_with_colid(rec, col->id, col->type, &res_key_len, (void**)&res_key_data)) {
-                        PRINTLOG(TOSDB, LOG_ERROR, "cannot get result key data");
-                        dont_add = true;
-                        rec->destroy(rec);
-                    } else {
-                        if(res_key_len != search_key_len) {
-                            PRINTLOG(TOSDB, LOG_TRACE, "search key len %lli != result key len %lli", search_key_len, res_key_len);
-
-                            if(col->type == DATA_TYPE_STRING || col->type == DATA_TYPE_INT8_ARRAY) {
-                                PRINTLOG(TOSDB, LOG_TRACE, "search key %s != result key %s", search_key, res_key_data);
-                            } else {
-                                PRINTLOG(TOSDB, LOG_TRACE, "search key %lli != result key %lli", (int64_t)search_key, (int64_t)res_key_data);
-                            }
-
-                            rec->destroy(rec);
-                        } else {
-                            if(!tosdb_record_compare_values(col->type, search_key_len, search_key, res_key_len, res_key_data)) {
-                                if(col->type == DATA_TYPE_STRING || col->type == DATA_TYPE_INT8_ARRAY) {
-                                    PRINTLOG(TOSDB, LOG_TRACE, "search key %s != result key %s", search_key, res_key_data);
-                                } else {
-                                    PRINTLOG(TOSDB, LOG_TRACE, "search key %lli != result key %lli", (int64_t)search_key, (int64_t)res_key_data);
-                                }
-
-                                rec->destroy(rec);
-                            } else {
-                                if(list_list_insert(recs, rec) == -1ULL) {
-                                    PRINTLOG(TOSDB, LOG_ERROR, "cannot insert record to list");
-                                    dont_add = true;
-                                    rec->destroy(rec);
-                                }
-                            }
-                        }
-
-                        if(col->type == DATA_TYPE_STRING || col->type == DATA_TYPE_INT8_ARRAY) {
-                            memory_free(res_key_data);
-                        }
-                    }
-
-                } else if(tosdb_record_is_deleted(rec)) {
-                    if(col->type == DATA_TYPE_STRING || col->type == DATA_TYPE_INT8_ARRAY) {
-                        PRINTLOG(TOSDB, LOG_TRACE, "searced key %s record key: %s is already deleted", search_key, item->key);
-                    } else {
-                        PRINTLOG(TOSDB, LOG_TRACE, "searched key %lli record key: %lli is already deleted", (int64_t)search_key, item->key_hash);
-                    }
-
-                    rec->destroy(rec);
-                } else {
-                    PRINTLOG(TOSDB, LOG_ERROR, "cannot get record");
-                    dont_add = true;
-
-                    if(col->type == DATA_TYPE_STRING || col->type == DATA_TYPE_INT8_ARRAY) {
-                        PRINTLOG(TOSDB, LOG_ERROR, "searced key %s record key: %s", search_key, item->key);
-                    } else {
-                        PRINTLOG(TOSDB, LOG_ERROR, "searched key %lli record key: %lli", (int64_t)search_key, item->key_hash);
-                    }
-
-                    rec->destroy(rec);
-                }
-            } else {
-                PRINTLOG(TOSDB, LOG_ERROR, "cannot create record");
-                dont_add = true;
-            }
+    if(res) {
+        for(uint64_t i = 0; i < pending_count; i++) {
+            founds[pending_positions[i]] = pending_founds[i];
         }
-
-        memory_free(item);
-
-        f_iter = f_iter->next(f_iter);
     }
 
-    f_iter->destroy(f_iter);
+    memory_free(pending);
+    memory_free(pending_positions);
+    memory_free(pending_founds);
 
-    set_destroy(results);
+    return res;
+}
 
-    if(col->type == DATA_TYPE_STRING || col->type == DATA_TYPE_INT8_ARRAY) {
-        PRINTLOG(TOSDB, LOG_TRACE, "search key %s ended", search_key);
-        memory_free(search_key);
-    } else {
-        PRINTLOG(TOSDB, LOG_TRACE, "search key %lli ended", (int64_t)search_key);
+boolean_t tosdb_record_search_set_destroy_cb(void * item) {
+    if(!item) {
+        return true;
     }
 
-    return recs;
-}
+    tosdb_record_t* rec = item;
 
+    return rec->destroy(rec);
+}
 
 uint64_t tosdb_record_get_index_id(tosdb_record_t* record, uint64_t colid) {
     if(!record || !record->context || !colid) {
@@ -777,7 +642,7 @@ boolean_t tosdb_record_destroy(tosdb_record_t * record){
     return true;
 }
 
-data_t* tosdb_record_serialize(tosdb_record_t* record) {
+static data_t* tosdb_record_serialize_internal(tosdb_record_t* record, boolean_t all_columns, uint64_t column_mask) {
     if(!record || !record->context) {
         PRINTLOG(TOSDB, LOG_ERROR, "record is null");
 
@@ -795,9 +660,8 @@ data_t* tosdb_record_serialize(tosdb_record_t* record) {
     data_t s_data = {0};
 
     s_data.type = DATA_TYPE_DATA;
-    s_data.length = hashmap_size(ctx->columns);
 
-    data_t* s_items = memory_malloc(sizeof(data_t) * s_data.length);
+    data_t* s_items = memory_malloc(sizeof(data_t) * MAX(hashmap_size(ctx->columns), 1ULL));
 
     if(!s_items) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot create record item list");
@@ -813,25 +677,44 @@ data_t* tosdb_record_serialize(tosdb_record_t* record) {
 
     while(iter->end_of_iterator(iter) != 0) {
         data_t* d = (data_t*)iter->get_item(iter);
+        uint64_t col_id = (uint64_t)d->name->value;
+
+        if(all_columns || (col_id < 64 && (column_mask & (1ULL << col_id)))) {
+            s_items[idx].length = d->length;
+            s_items[idx].name = d->name;
+            s_items[idx].type = d->type;
+            s_items[idx].value = d->value;
 
-        s_items[idx].length = d->length;
-        s_items[idx].name = d->name;
-        s_items[idx].type = d->type;
-        s_items[idx].value = d->value;
+            idx++;
+        }
 
-        idx++;
         iter = iter->next(iter);
     }
 
     iter->destroy(iter);
 
-    data_t* res = data_bson_serialize(&s_data);
+    s_data.length = idx;
+
+    data_t* res = NULL;
+
+    // a covered serialization without any covered column is empty
+    if(idx || all_columns) {
+        res = data_bson_serialize(&s_data);
+    }
 
     memory_free(s_items);
 
     return res;
 }
 
+data_t* tosdb_record_serialize(tosdb_record_t* record) {
+    return tosdb_record_serialize_internal(record, true, 0);
+}
+
+data_t* tosdb_record_serialize_covered(tosdb_record_t* record, uint64_t covered_columns) {
+    return tosdb_record_serialize_internal(record, false, covered_columns);
+}
+
 boolean_t tosdb_record_is_deleted(tosdb_record_t* record) {
     if(!record || !record->context) {
         PRINTLOG(TOSDB, LOG_ERROR, "record is null");
@@ -12,6 +12,7 @@
 #include <logging.h>
 #include <compression.h>
 #include <binarysearch.h>
+#include <quicksort.h>
 
 MODULE("turnstone.kernel.db");
 
@@ -64,10 +65,115 @@ int8_t tosdb_sstable_index_comparator(const void* i1, const void* i2) {
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
-boolean_t tosdb_sstable_get_on_index(tosdb_record_t * record, tosdb_block_sstable_list_item_t* sli, tosdb_memtable_index_item_t* item, uint64_t index_id){
-    tosdb_record_context_t* ctx = record->context;
+uint8_t* tosdb_valuelog_chunk_unpack(tosdb_t* tdb, const tosdb_block_valuelog_t* b_vl, uint64_t chunk_id, uint64_t* unpacked_size) {
+    if(!tdb || !b_vl || !unpacked_size) {
+        return NULL;
+    }
+
+    if(chunk_id >= b_vl->chunk_count || b_vl->chunk_size != TOSDB_VALUELOG_CHUNK_SIZE) {
+        PRINTLOG(TOSDB, LOG_ERROR, "invalid valuelog chunk %lli of sstable %lli", chunk_id, b_vl->sstable_id);
+
+        return NULL;
+    }
+
+    const tosdb_block_valuelog_chunk_t* chunk = &b_vl->chunks[chunk_id];
+
+    if(chunk->offset + chunk->packed_size > b_vl->data_size) {
+        PRINTLOG(TOSDB, LOG_ERROR, "valuelog chunk %lli of sstable %lli is out of block", chunk_id, b_vl->sstable_id);
+
+        return NULL;
+    }
+
+    uint64_t chunk_start = chunk_id * b_vl->chunk_size;
+    uint64_t expected_size = MIN(b_vl->chunk_size, b_vl->valuelog_unpacked_size - chunk_start);
+
+    uint8_t* packed_data = (uint8_t*)&b_vl->chunks[b_vl->chunk_count] + chunk->offset;
+
+    buffer_t* buf_in = buffer_encapsulate(packed_data, chunk->packed_size);
+
+    if(!buf_in) {
+        return NULL;
+    }
+
+    buffer_t* buf_out = buffer_new_with_capacity(NULL, expected_size);
+
+    if(!buf_out) {
+        buffer_destroy(buf_in);
+
+        return NULL;
+    }
+
+    int8_t zc_res = tdb->compression->unpack(buf_in, buf_out);
+
+    buffer_destroy(buf_in);
+
+    if(zc_res != 0 || buffer_get_length(buf_out) != expected_size) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot unpack valuelog chunk %lli of sstable %lli", chunk_id, b_vl->sstable_id);
+        buffer_destroy(buf_out);
+
+        return NULL;
+    }
+
+    __atomic_fetch_add(&tdb->valuelog_chunk_unpack_count, 1, __ATOMIC_RELAXED);
+
+    return buffer_get_all_bytes_and_destroy(buf_out, unpacked_size);
+}
+#pragma GCC diagnostic pop
+
+/**
+ * @brief sstable index header, first/last keys and bloom filter of an index
+ * @details if cached flag is set, items are owned by cache otherwise they should be released.
+ */
+typedef struct tosdb_sstable_index_header_t {
+    tosdb_memtable_index_item_t* first; ///< first key of index
+    tosdb_memtable_index_item_t* last; ///< last key of index
+    bloomfilter_t*               bloomfilter; ///< bloom filter of index
+    uint64_t                     index_data_location; ///< index data location
+    uint64_t                     index_data_size; ///< index data size
+    boolean_t                    cached; ///< items are owned by cache
+} tosdb_sstable_index_header_t;
 
-    const compression_t* compression = ctx->table->db->tdb->compression;
+/**
+ * @brief sstable index data, sorted index items of an index
+ */
+typedef struct tosdb_sstable_index_data_t {
+    tosdb_memtable_index_item_t** items; ///< sorted index items
+    uint64_t                      record_count; ///< index item count
+    uint8_t*                      data; ///< unpacked index data, null if cached
+    boolean_t                     cached; ///< items are owned by cache
+} tosdb_sstable_index_data_t;
+
+/**
+ * @brief valuelog reader which keeps last chunk, consecutive reads of same chunk are served without cache lookup
+ */
+typedef struct tosdb_sstable_valuelog_reader_t {
+    tosdb_t*                 tdb; ///< tosdb instance
+    tosdb_cache_t*           cache; ///< cache, can be null
+    tosdb_cache_key_t        cache_key; ///< valuelog cache key of sstable
+    uint64_t                 valuelog_location; ///< valuelog location
+    uint64_t                 valuelog_size; ///< valuelog size
+    tosdb_cached_block_t*    block; ///< valuelog block, acquired at first chunk miss
+    tosdb_cached_valuelog_t* pending; ///< unpacked chunk which will be put into cache when reader leaves it
+    uint8_t*                 chunk; ///< current chunk
+    uint64_t                 chunk_id; ///< current chunk id
+    uint64_t                 chunk_size; ///< current chunk size
+    boolean_t                chunk_owned; ///< current chunk is not cached and freed by reader
+} tosdb_sstable_valuelog_reader_t;
+
+static void tosdb_sstable_index_header_release(tosdb_sstable_index_header_t* hdr) {
+    if(!hdr->cached) {
+        bloomfilter_destroy(hdr->bloomfilter);
+        memory_free(hdr->first);
+        memory_free(hdr->last);
+    }
+
+    memory_memclean(hdr, sizeof(tosdb_sstable_index_header_t));
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+static boolean_t tosdb_sstable_index_header_load(tosdb_table_t* tbl, const tosdb_block_sstable_list_item_t* sli, uint64_t index_id, tosdb_sstable_index_header_t* hdr) {
+    const compression_t* compression = tbl->db->tdb->compression;
 
     uint64_t idx_loc = 0;
     uint64_t idx_size = 0;
@@ -86,22 +192,15 @@ boolean_t tosdb_sstable_get_on_index(tosdb_record_t * record, tosdb_block_sstabl
         return false;
     }
 
-    tosdb_cache_t* tdb_cache = ctx->table->db->tdb->cache;
-
-    tosdb_memtable_index_item_t* first = NULL;
-    tosdb_memtable_index_item_t* last = NULL;
-    bloomfilter_t* bf = NULL;
-    uint64_t index_data_size = 0;
-    uint64_t index_data_location = 0;
-    uint64_t record_count = 0;
+    tosdb_cache_t* tdb_cache = tbl->db->tdb->cache;
 
     tosdb_cached_bloomfilter_t* c_bf = NULL;
 
     tosdb_cache_key_t cache_key = {0};
 
     cache_key.type = TOSDB_CACHE_ITEM_TYPE_BLOOMFILTER;
-    cache_key.database_id = ctx->table->db->id;
-    cache_key.table_id = ctx->table->id;
+    cache_key.database_id = tbl->db->id;
+    cache_key.table_id = tbl->id;
     cache_key.index_id = index_id;
     cache_key.level = sli->level;
     cache_key.sstable_id = sli->sstable_id;
@@ -111,152 +210,147 @@ boolean_t tosdb_sstable_get_on_index(tosdb_record_t * record, tosdb_block_sstabl
     }
 
     if(c_bf) {
-        first = c_bf->first_key;
-        last = c_bf->last_key;
-        bf = c_bf->bloomfilter;
-        index_data_size = c_bf->index_data_size;
-        index_data_location = c_bf->index_data_location;
-    } else {
-        tosdb_block_sstable_index_t* st_idx = (tosdb_block_sstable_index_t*)tosdb_block_read(ctx->table->db->tdb, idx_loc, idx_size);
-
-        if(!st_idx) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot read sstable index from backend");
+        hdr->first = c_bf->first_key;
+        hdr->last = c_bf->last_key;
+        hdr->bloomfilter = c_bf->bloomfilter;
+        hdr->index_data_size = c_bf->index_data_size;
+        hdr->index_data_location = c_bf->index_data_location;
+        hdr->cached = true;
 
-            return false;
-        }
+        return true;
+    }
 
-        record_count = st_idx->record_count;
+    tosdb_block_sstable_index_t* st_idx = (tosdb_block_sstable_index_t*)tosdb_block_read(tbl->db->tdb, idx_loc, idx_size);
 
-        uint8_t* st_idx_data = &st_idx->data[0];
+    if(!st_idx) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot read sstable index from backend");
 
-        tosdb_memtable_index_item_t* t_first = (tosdb_memtable_index_item_t*)st_idx_data;
+        return false;
+    }
 
-        uint64_t first_key_length = t_first->key_length + sizeof(tosdb_memtable_index_item_t);
-        first = memory_malloc(first_key_length);
+    uint8_t* st_idx_data = &st_idx->data[0];
 
-        if(!first) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate first item");
-            memory_free(st_idx);
+    tosdb_memtable_index_item_t* t_first = (tosdb_memtable_index_item_t*)st_idx_data;
 
-            return false;
-        }
+    uint64_t first_key_length = t_first->key_length + sizeof(tosdb_memtable_index_item_t);
+    tosdb_memtable_index_item_t* first = memory_malloc(first_key_length);
 
-        PRINTLOG(TOSDB, LOG_TRACE, "first key length 0x%llx", first_key_length);
+    if(!first) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate first item");
+        memory_free(st_idx);
 
-        memory_memcopy(t_first, first, first_key_length);
+        return false;
+    }
 
-        st_idx_data += first_key_length;
+    PRINTLOG(TOSDB, LOG_TRACE, "first key length 0x%llx", first_key_length);
 
-        tosdb_memtable_index_item_t* t_last = (tosdb_memtable_index_item_t*)st_idx_data;
+    memory_memcopy(t_first, first, first_key_length);
 
-        uint64_t last_key_length = t_last->key_length + sizeof(tosdb_memtable_index_item_t);
-        last = memory_malloc(last_key_length);
+    st_idx_data += first_key_length;
 
-        if(!last) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate last item 0x%llx 0x%llx", last_key_length, t_last->key_length);;
-            memory_free(first);
-            memory_free(st_idx);
+    tosdb_memtable_index_item_t* t_last = (tosdb_memtable_index_item_t*)st_idx_data;
 
-            return false;
-        }
+    uint64_t last_key_length = t_last->key_length + sizeof(tosdb_memtable_index_item_t);
+    tosdb_memtable_index_item_t* last = memory_malloc(last_key_length);
 
-        memory_memcopy(t_last, last, last_key_length);
+    if(!last) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate last item 0x%llx 0x%llx", last_key_length, t_last->key_length);;
+        memory_free(first);
+        memory_free(st_idx);
 
-        st_idx_data += last_key_length;
+        return false;
+    }
 
-        buffer_t* buf_bf_in = buffer_encapsulate(st_idx_data, st_idx->bloomfilter_size);
-        buffer_t* buf_bf_out = buffer_new_with_capacity(NULL, st_idx->bloomfilter_unpacked_size);
+    memory_memcopy(t_last, last, last_key_length);
 
-        int8_t zc_res = compression->unpack(buf_bf_in, buf_bf_out);
+    st_idx_data += last_key_length;
 
-        uint64_t zc = buffer_get_length(buf_bf_out);
+    buffer_t* buf_bf_in = buffer_encapsulate(st_idx_data, st_idx->bloomfilter_size);
+    buffer_t* buf_bf_out = buffer_new_with_capacity(NULL, st_idx->bloomfilter_unpacked_size);
 
-        buffer_destroy(buf_bf_in);
+    int8_t zc_res = compression->unpack(buf_bf_in, buf_bf_out);
 
-        if(zc_res != 0 || zc != st_idx->bloomfilter_unpacked_size) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot unpack bf");
-            memory_free(first);
-            memory_free(last);
-            memory_free(st_idx);
-            buffer_destroy(buf_bf_out);
+    uint64_t zc = buffer_get_length(buf_bf_out);
 
-            return false;
-        }
+    buffer_destroy(buf_bf_in);
 
-        uint64_t bf_data_len = 0;
-        uint8_t* bf_data = buffer_get_all_bytes_and_destroy(buf_bf_out, &bf_data_len);
+    if(zc_res != 0 || zc != st_idx->bloomfilter_unpacked_size) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot unpack bf");
+        memory_free(first);
+        memory_free(last);
+        memory_free(st_idx);
+        buffer_destroy(buf_bf_out);
 
-        data_t bf_tmp_d = {0};
-        bf_tmp_d.type = DATA_TYPE_INT8_ARRAY;
-        bf_tmp_d.length = bf_data_len;
-        bf_tmp_d.value = bf_data;
+        return false;
+    }
 
-        bf = bloomfilter_deserialize(&bf_tmp_d);
+    uint64_t bf_data_len = 0;
+    uint8_t* bf_data = buffer_get_all_bytes_and_destroy(buf_bf_out, &bf_data_len);
 
-        memory_free(bf_data);
+    data_t bf_tmp_d = {0};
+    bf_tmp_d.type = DATA_TYPE_INT8_ARRAY;
+    bf_tmp_d.length = bf_data_len;
+    bf_tmp_d.value = bf_data;
 
-        if(!bf) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot deserialize bloom filter");
-            memory_free(st_idx);
+    bloomfilter_t* bf = bloomfilter_deserialize(&bf_tmp_d);
 
-            return false;
-        }
+    memory_free(bf_data);
 
-        if(tdb_cache) {
-            c_bf = memory_malloc(sizeof(tosdb_cached_bloomfilter_t));
+    if(!bf) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot deserialize bloom filter");
+        memory_free(first);
+        memory_free(last);
+        memory_free(st_idx);
 
-            if(!c_bf) {
-                PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate cached bloom filter");
-                memory_free(first);
-                memory_free(last);
-                memory_free(st_idx);
-                bloomfilter_destroy(bf);
+        return false;
+    }
 
-                return false;
-            }
+    hdr->first = first;
+    hdr->last = last;
+    hdr->bloomfilter = bf;
+    hdr->index_data_size = st_idx->index_data_size;
+    hdr->index_data_location = st_idx->index_data_location;
+    hdr->cached = false;
 
-            memory_memcopy(&cache_key, c_bf, sizeof(tosdb_cache_key_t));
-            c_bf->index_data_location = st_idx->index_data_location;
-            c_bf->index_data_size = st_idx->index_data_size;
-            c_bf->bloomfilter = bf;
-            c_bf->first_key = first;
-            c_bf->last_key = last;
+    if(tdb_cache) {
+        c_bf = memory_malloc(sizeof(tosdb_cached_bloomfilter_t));
 
-            c_bf->cache_key.data_size = sizeof(tosdb_cached_bloomfilter_t) + st_idx->bloomfilter_unpacked_size + first_key_length + last_key_length + 64; // near size
+        if(!c_bf) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate cached bloom filter");
+            tosdb_sstable_index_header_release(hdr);
+            memory_free(st_idx);
 
-            tosdb_cache_put(tdb_cache, (tosdb_cache_key_t*)c_bf);
+            return false;
         }
 
-        index_data_size = st_idx->index_data_size;
-        index_data_location = st_idx->index_data_location;
+        memory_memcopy(&cache_key, c_bf, sizeof(tosdb_cache_key_t));
+        c_bf->index_data_location = st_idx->index_data_location;
+        c_bf->index_data_size = st_idx->index_data_size;
+        c_bf->bloomfilter = bf;
+        c_bf->first_key = first;
+        c_bf->last_key = last;
 
-        memory_free(st_idx);
-    }
+        c_bf->cache_key.data_size = sizeof(tosdb_cached_bloomfilter_t) + st_idx->bloomfilter_unpacked_size + first_key_length + last_key_length + 64; // near size
 
+        tosdb_cache_put(tdb_cache, (tosdb_cache_key_t*)c_bf);
 
-    PRINTLOG(TOSDB, LOG_TRACE, "sstable 0x%llx level 0x%llx first: %llx item %llx last: %llx",
-             sli->sstable_id, sli->level, first->key_hash, item->key_hash, last->key_hash);
+        hdr->cached = true;
+    }
 
-    int8_t first_limit = tosdb_sstable_index_comparator(&first, &item);
-    int8_t last_limit = tosdb_sstable_index_comparator(&last, &item);
+    memory_free(st_idx);
 
-    if(first_limit == 1 || last_limit == -1) {
-        if(!tdb_cache) {
-            bloomfilter_destroy(bf);
-            memory_free(first);
-            memory_free(last);
-        }
+    return true;
+}
+#pragma GCC diagnostic pop
 
-        PRINTLOG(TOSDB, LOG_TRACE, "not found inside sstable 0x%llx level 0x%llx first_limit: %d last_limit: %d", sli->sstable_id, sli->level, first_limit, last_limit);
+static boolean_t tosdb_sstable_index_header_may_contain(const tosdb_sstable_index_header_t* hdr, tosdb_memtable_index_item_t* item) {
+    int8_t first_limit = tosdb_sstable_index_comparator(&hdr->first, &item);
+    int8_t last_limit = tosdb_sstable_index_comparator(&hdr->last, &item);
 
+    if(first_limit == 1 || last_limit == -1) {
         return false;
     }
 
-    if(!tdb_cache) {
-        memory_free(first);
-        memory_free(last);
-    }
-
     uint8_t* u8_key = item->key;
     uint64_t u8_key_length = item->key_length;
 
@@ -270,30 +364,35 @@ boolean_t tosdb_sstable_get_on_index(tosdb_record_t * record, tosdb_block_sstabl
     item_tmp_data.length = u8_key_length;
     item_tmp_data.value = u8_key;
 
-    if(!bloomfilter_check(bf, &item_tmp_data)) {
-        if(!tdb_cache) {
-            bloomfilter_destroy(bf);
-        }
-
-        PRINTLOG(TOSDB, LOG_TRACE, "not found inside sstable 0x%llx level 0x%llx bloomfilter", sli->sstable_id, sli->level);
+    return bloomfilter_check(hdr->bloomfilter, &item_tmp_data);
+}
 
-        return false;
+static void tosdb_sstable_index_data_release(tosdb_sstable_index_data_t* id) {
+    if(!id->cached) {
+        memory_free(id->items);
+        memory_free(id->data);
     }
 
-    if(!tdb_cache) {
-        bloomfilter_destroy(bf);
-    }
+    memory_memclean(id, sizeof(tosdb_sstable_index_data_t));
+}
 
-    tosdb_memtable_index_item_t** st_idx_items = NULL;
-    uint64_t valuelog_location = 0;
-    uint64_t valuelog_size = 0;
-    uint8_t* idx_data = NULL;
-    uint8_t* org_idx_data = NULL;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+static boolean_t tosdb_sstable_index_data_load(tosdb_table_t* tbl, const tosdb_block_sstable_list_item_t* sli, uint64_t index_id,
+                                               uint64_t index_data_location, uint64_t index_data_size, tosdb_sstable_index_data_t* id) {
+    const compression_t* compression = tbl->db->tdb->compression;
+    tosdb_cache_t* tdb_cache = tbl->db->tdb->cache;
 
     tosdb_cached_index_data_t* c_id = NULL;
 
+    tosdb_cache_key_t cache_key = {0};
 
     cache_key.type = TOSDB_CACHE_ITEM_TYPE_INDEX_DATA;
+    cache_key.database_id = tbl->db->id;
+    cache_key.table_id = tbl->id;
+    cache_key.index_id = index_id;
+    cache_key.level = sli->level;
+    cache_key.sstable_id = sli->sstable_id;
 
     if(tdb_cache) {
         c_id = (tosdb_cached_index_data_t*)tosdb_cache_get(tdb_cache, &cache_key);
@@ -301,231 +400,253 @@ boolean_t tosdb_sstable_get_on_index(tosdb_record_t * record, tosdb_block_sstabl
 
     if(c_id) {
         PRINTLOG(TOSDB, LOG_TRACE, "index data read from cache");
-        st_idx_items = c_id->index_items;
-        record_count = c_id->record_count;
-        valuelog_location = c_id->valuelog_location;
-        valuelog_size = c_id->valuelog_size;
-    } else {
-        PRINTLOG(TOSDB, LOG_TRACE, "index data read from backend");
-        valuelog_location = sli->valuelog_location;
-        valuelog_size = sli->valuelog_size;
+        id->items = c_id->index_items;
+        id->record_count = c_id->record_count;
+        id->data = NULL;
+        id->cached = true;
 
-        tosdb_block_sstable_index_data_t* b_sid = (tosdb_block_sstable_index_data_t*)tosdb_block_read(ctx->table->db->tdb, index_data_location, index_data_size);
-
-        if(!b_sid) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot read index data");
+        return true;
+    }
 
-            return false;
+    PRINTLOG(TOSDB, LOG_TRACE, "index data read from backend");
 
-        }
+    tosdb_block_sstable_index_data_t* b_sid = (tosdb_block_sstable_index_data_t*)tosdb_block_read(tbl->db->tdb, index_data_location, index_data_size);
 
-        record_count = b_sid->record_count;
+    if(!b_sid) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot read index data");
 
-        buffer_t* buf_idx_in = buffer_encapsulate(b_sid->data, b_sid->index_data_size);
-        buffer_t* buf_idx_out = buffer_new_with_capacity(NULL, b_sid->index_data_unpacked_size);
+        return false;
 
-        int8_t zc_res = compression->unpack(buf_idx_in, buf_idx_out);
+    }
 
-        uint64_t zc = buffer_get_length(buf_idx_out);
+    uint64_t record_count = b_sid->record_count;
 
-        uint64_t index_data_unpacked_size = b_sid->index_data_unpacked_size;
+    buffer_t* buf_idx_in = buffer_encapsulate(b_sid->data, b_sid->index_data_size);
+    buffer_t* buf_idx_out = buffer_new_with_capacity(NULL, b_sid->index_data_unpacked_size);
 
-        memory_free(b_sid);
+    int8_t zc_res = compression->unpack(buf_idx_in, buf_idx_out);
 
-        buffer_destroy(buf_idx_in);
+    uint64_t zc = buffer_get_length(buf_idx_out);
 
-        if(zc_res != 0 || zc != index_data_unpacked_size) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot unpack idx");
-            buffer_destroy(buf_idx_out);
+    uint64_t index_data_unpacked_size = b_sid->index_data_unpacked_size;
 
-            return false;
-        }
+    memory_free(b_sid);
 
-        idx_data = buffer_get_all_bytes_and_destroy(buf_idx_out, NULL);
-        org_idx_data = idx_data;
+    buffer_destroy(buf_idx_in);
 
-        st_idx_items = memory_malloc(sizeof(tosdb_memtable_index_item_t*) * record_count);
+    if(zc_res != 0 || zc != index_data_unpacked_size) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot unpack idx");
+        buffer_destroy(buf_idx_out);
 
-        if(!st_idx_items) {
-            memory_free(idx_data);
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot create index item array");
+        return false;
+    }
 
-            return false;
-        }
+    uint8_t* idx_data = buffer_get_all_bytes_and_destroy(buf_idx_out, NULL);
+    uint8_t* org_idx_data = idx_data;
 
-        for(uint64_t i = 0; i < record_count; i++) {
-            st_idx_items[i] = (tosdb_memtable_index_item_t*)idx_data;
+    tosdb_memtable_index_item_t** st_idx_items = memory_malloc(sizeof(tosdb_memtable_index_item_t*) * record_count);
 
-            if(!st_idx_items[i]) {
-                memory_free(st_idx_items);
-                memory_free(idx_data);
-                PRINTLOG(TOSDB, LOG_ERROR, "cannot create index item 0x%llx", i);
+    if(!st_idx_items) {
+        memory_free(org_idx_data);
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create index item array");
 
-                return false;
-            }
+        return false;
+    }
 
-            idx_data += sizeof(tosdb_memtable_index_item_t) + st_idx_items[i]->key_length;
-        }
+    for(uint64_t i = 0; i < record_count; i++) {
+        st_idx_items[i] = (tosdb_memtable_index_item_t*)idx_data;
 
-        if(tdb_cache) {
-            c_id = memory_malloc(sizeof(tosdb_cached_index_data_t));
+        idx_data += sizeof(tosdb_memtable_index_item_t) + st_idx_items[i]->key_length;
+    }
 
-            if(!c_id) {
-                PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate cached index data");
-                memory_free(st_idx_items);
-                memory_free(idx_data);
+    id->items = st_idx_items;
+    id->record_count = record_count;
+    id->data = org_idx_data;
+    id->cached = false;
 
-                return false;
-            }
+    if(tdb_cache) {
+        c_id = memory_malloc(sizeof(tosdb_cached_index_data_t));
 
-            memory_memcopy(&cache_key, c_id, sizeof(tosdb_cache_key_t));
-            c_id->index_items = st_idx_items;
-            c_id->record_count = record_count;
-            c_id->valuelog_location = valuelog_location;
-            c_id->valuelog_size = valuelog_size;
-            c_id->cache_key.data_size = sizeof(tosdb_cached_index_data_t) + index_data_unpacked_size + sizeof(tosdb_memtable_index_item_t*) * record_count;
+        if(!c_id) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate cached index data");
+            tosdb_sstable_index_data_release(id);
 
-            tosdb_cache_put(tdb_cache, (tosdb_cache_key_t*)c_id);
+            return false;
         }
-    }
-
-    PRINTLOG(TOSDB, LOG_TRACE, "index data read, record count: 0x%llx 0x%llx", record_count, record_count);
-
-    tosdb_memtable_index_item_t** t_found_item = (tosdb_memtable_index_item_t**)binarysearch(st_idx_items,
-                                                                                             record_count,
-                                                                                             sizeof(tosdb_memtable_index_item_t*),
-                                                                                             &item,
-                                                                                             tosdb_sstable_index_comparator);
 
+        memory_memcopy(&cache_key, c_id, sizeof(tosdb_cache_key_t));
+        c_id->index_items = st_idx_items;
+        c_id->record_count = record_count;
+        c_id->valuelog_location = sli->valuelog_location;
+        c_id->valuelog_size = sli->valuelog_size;
+        c_id->cache_key.data_size = sizeof(tosdb_cached_index_data_t) + index_data_unpacked_size + sizeof(tosdb_memtable_index_item_t*) * record_count;
 
-    if(!t_found_item) {
-        if(!tdb_cache) {
-            memory_free(st_idx_items);
-            memory_free(org_idx_data);
-        }
+        tosdb_cache_put(tdb_cache, (tosdb_cache_key_t*)c_id);
 
-        return false;
+        id->data = NULL;
+        id->cached = true;
     }
 
-    tosdb_memtable_index_item_t* found_item = *t_found_item;
-
-    if(!found_item) {
-        if(!tdb_cache) {
-            memory_free(st_idx_items);
-            memory_free(org_idx_data);
-        }
+    PRINTLOG(TOSDB, LOG_TRACE, "index data read, record count: 0x%llx", record_count);
 
-        return false;
-    }
+    return true;
+}
+#pragma GCC diagnostic pop
 
-    ctx->record_id = found_item->record_id;
+static void tosdb_sstable_valuelog_reader_init(tosdb_sstable_valuelog_reader_t* reader, tosdb_table_t* tbl, const tosdb_block_sstable_list_item_t* sli) {
+    memory_memclean(reader, sizeof(tosdb_sstable_valuelog_reader_t));
+
+    reader->tdb = tbl->db->tdb;
+    reader->cache = tbl->db->tdb->cache;
+    reader->valuelog_location = sli->valuelog_location;
+    reader->valuelog_size = sli->valuelog_size;
+
+    // valuelog is shared by all indexes of sstable
+    reader->cache_key.type = TOSDB_CACHE_ITEM_TYPE_VALUELOG;
+    reader->cache_key.database_id = tbl->db->id;
+    reader->cache_key.table_id = tbl->id;
+    reader->cache_key.index_id = 0;
+    reader->cache_key.level = sli->level;
+    reader->cache_key.sstable_id = sli->sstable_id;
+}
 
-    if(found_item->is_deleted) {
-        if(!tdb_cache) {
-            memory_free(st_idx_items);
-            memory_free(org_idx_data);
-        }
+static void tosdb_sstable_valuelog_reader_leave_chunk(tosdb_sstable_valuelog_reader_t* reader) {
+    // a fresh chunk is put into cache after it is used, so it cannot be evicted while reader holds it
+    if(reader->pending) {
+        tosdb_cache_put(reader->cache, (tosdb_cache_key_t*)reader->pending);
+        reader->pending = NULL;
+    } else if(reader->chunk_owned) {
+        memory_free(reader->chunk);
+    }
 
-        ctx->is_deleted = true;
-        ctx->level = sli->level;
-        ctx->sstable_id = sli->sstable_id;
-        ctx->record_id = found_item->record_id;
+    reader->chunk = NULL;
+    reader->chunk_size = 0;
+    reader->chunk_owned = false;
+}
 
+static boolean_t tosdb_sstable_valuelog_reader_load_chunk(tosdb_sstable_valuelog_reader_t* reader, uint64_t chunk_id) {
+    if(reader->chunk && reader->chunk_id == chunk_id) {
         return true;
     }
 
+    tosdb_sstable_valuelog_reader_leave_chunk(reader);
 
-    uint64_t offset = found_item->offset;
-    uint64_t length = found_item->length;
-
-    if(!tdb_cache) {
-        memory_free(st_idx_items);
-        memory_free(org_idx_data);
-    }
+    reader->cache_key.chunk_id = chunk_id;
 
-    buffer_t* buf_vl_out = NULL;
     tosdb_cached_valuelog_t* c_vl = NULL;
 
-    cache_key.type = TOSDB_CACHE_ITEM_TYPE_VALUELOG;
-
-    if(tdb_cache) {
-        c_vl = (tosdb_cached_valuelog_t*)tosdb_cache_get(tdb_cache, &cache_key);
+    if(reader->cache) {
+        c_vl = (tosdb_cached_valuelog_t*)tosdb_cache_get(reader->cache, &reader->cache_key);
     }
 
     if(c_vl) {
-        buf_vl_out = c_vl->values;
-    } else {
-        tosdb_block_valuelog_t* b_vl = (tosdb_block_valuelog_t*)tosdb_block_read(ctx->table->db->tdb, valuelog_location, valuelog_size);
+        reader->chunk = c_vl->chunk;
+        reader->chunk_size = c_vl->chunk_size;
+        reader->chunk_id = chunk_id;
+
+        return true;
+    }
 
-        if(!b_vl) {
+    if(!reader->block) {
+        reader->block = tosdb_block_acquire(reader->tdb, reader->valuelog_location, reader->valuelog_size);
+
+        if(!reader->block) {
             PRINTLOG(TOSDB, LOG_ERROR, "cannot read valuelog block");
 
             return false;
         }
+    }
 
-        buffer_t* buf_vl_in = buffer_encapsulate(b_vl->data, b_vl->data_size);
+    uint64_t chunk_size = 0;
+    uint8_t* chunk = tosdb_valuelog_chunk_unpack(reader->tdb, (tosdb_block_valuelog_t*)reader->block->block, chunk_id, &chunk_size);
 
-        if(!buf_vl_in) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot encapsulate valuelog");
+    if(!chunk) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot unpack valuelog chunk %lli", chunk_id);
 
-            return false;
-        }
+        return false;
+    }
 
-        buf_vl_out = buffer_new_with_capacity(NULL, b_vl->valuelog_unpacked_size);
+    if(reader->cache) {
+        c_vl = memory_malloc(sizeof(tosdb_cached_valuelog_t));
 
-        if(!buf_vl_out) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannot create valuelog buffer for decompress");
+        if(!c_vl) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate cached valuelog");
+            memory_free(chunk);
 
             return false;
         }
 
-        uint64_t buf_vl_unpacked_size = b_vl->valuelog_unpacked_size;
+        memory_memcopy(&reader->cache_key, c_vl, sizeof(tosdb_cache_key_t));
+        c_vl->chunk = chunk;
+        c_vl->chunk_size = chunk_size;
+        c_vl->cache_key.data_size = sizeof(tosdb_cached_valuelog_t) + chunk_size;
 
-        int8_t zc_res = compression->unpack(buf_vl_in, buf_vl_out);
+        reader->pending = c_vl;
+    } else {
+        reader->chunk_owned = true;
+    }
 
-        uint64_t zc = buffer_get_length(buf_vl_out);
+    reader->chunk = chunk;
+    reader->chunk_size = chunk_size;
+    reader->chunk_id = chunk_id;
 
-        memory_free(b_vl);
-        buffer_destroy(buf_vl_in);
+    return true;
+}
 
-        if(zc_res != 0 || zc != buf_vl_unpacked_size) {
-            PRINTLOG(TOSDB, LOG_ERROR, "cannotunpack valuelog");
-            buffer_destroy(buf_vl_out);
+static uint8_t* tosdb_sstable_valuelog_reader_read(tosdb_sstable_valuelog_reader_t* reader, uint64_t offset, uint64_t length) {
+    if(!length || offset + length < offset) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot read value data from valuelog");
 
-            return false;
-        }
+        return NULL;
+    }
 
-        if(tdb_cache) {
-            c_vl = memory_malloc(sizeof(tosdb_cached_valuelog_t));
+    uint8_t* value_data = memory_malloc(length);
 
-            if(!c_vl) {
-                PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate cached valuelog");
-                buffer_destroy(buf_vl_out);
+    if(!value_data) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate value data");
 
-                return false;
-            }
+        return NULL;
+    }
+
+    uint64_t first_chunk = offset / TOSDB_VALUELOG_CHUNK_SIZE;
+    uint64_t last_chunk = (offset + length - 1) / TOSDB_VALUELOG_CHUNK_SIZE;
 
-            memory_memcopy(&cache_key, c_vl, sizeof(tosdb_cache_key_t));
-            c_vl->values = buf_vl_out;
-            c_vl->cache_key.data_size = sizeof(tosdb_cached_valuelog_t) + buffer_get_length(c_vl->values);
+    for(uint64_t chunk_id = first_chunk; chunk_id <= last_chunk; chunk_id++) {
+        if(!tosdb_sstable_valuelog_reader_load_chunk(reader, chunk_id)) {
+            memory_free(value_data);
 
-            tosdb_cache_put(tdb_cache, (tosdb_cache_key_t*)c_vl);
+            return NULL;
         }
-    }
 
-    buffer_seek(buf_vl_out, offset, BUFFER_SEEK_DIRECTION_START);
-    uint8_t* value_data = buffer_get_bytes(buf_vl_out, length);
+        uint64_t chunk_start = chunk_id * TOSDB_VALUELOG_CHUNK_SIZE;
+        uint64_t copy_start = MAX(offset, chunk_start);
+        uint64_t copy_end = MIN(offset + length, chunk_start + reader->chunk_size);
 
-    if(!tdb_cache) {
-        buffer_destroy(buf_vl_out);
-    }
+        if(copy_end > copy_start) {
+            memory_memcopy(reader->chunk + (copy_start - chunk_start), value_data + (copy_start - offset), copy_end - copy_start);
+        }
 
-    if(!value_data) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot read value data from valuelog");
+        if(copy_end < MIN(offset + length, chunk_start + TOSDB_VALUELOG_CHUNK_SIZE)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "value of record is out of valuelog chunk %lli", chunk_id);
+            memory_free(value_data);
 
-        return false;
+            return NULL;
+        }
     }
 
+    return value_data;
+}
+
+static void tosdb_sstable_valuelog_reader_release(tosdb_sstable_valuelog_reader_t* reader) {
+    tosdb_sstable_valuelog_reader_leave_chunk(reader);
+    tosdb_block_release(reader->block);
+    reader->block = NULL;
+}
+
+static boolean_t tosdb_sstable_record_populate(tosdb_record_t* record, const tosdb_block_sstable_list_item_t* sli, uint64_t index_id,
+                                               uint128_t record_id, uint8_t* value_data, uint64_t length) {
+    tosdb_record_context_t* ctx = record->context;
+
     data_t s_d = {0};
     s_d.length = length;
     s_d.type = DATA_TYPE_INT8_ARRAY;
@@ -533,8 +654,6 @@ boolean_t tosdb_sstable_get_on_index(tosdb_record_t * record, tosdb_block_sstabl
 
     data_t* r_d = data_bson_deserialize(&s_d);
 
-    memory_free(value_data);
-
     if(!r_d) {
         PRINTLOG(TOSDB, LOG_ERROR, "cannot deserialize data");
 
@@ -559,13 +678,93 @@ boolean_t tosdb_sstable_get_on_index(tosdb_record_t * record, tosdb_block_sstabl
 
     ctx->level = sli->level;
     ctx->sstable_id = sli->sstable_id;
-    ctx->record_id = found_item->record_id;
+    ctx->record_id = record_id;
 
     data_free(r_d);
 
     return true;
 }
-#pragma GCC diagnostic pop
+
+boolean_t tosdb_sstable_get_on_index(tosdb_record_t * record, tosdb_block_sstable_list_item_t* sli, tosdb_memtable_index_item_t* item, uint64_t index_id){
+    tosdb_record_context_t* ctx = record->context;
+    tosdb_table_t* tbl = ctx->table;
+
+    tosdb_sstable_index_header_t hdr = {0};
+
+    if(!tosdb_sstable_index_header_load(tbl, sli, index_id, &hdr)) {
+        return false;
+    }
+
+    PRINTLOG(TOSDB, LOG_TRACE, "sstable 0x%llx level 0x%llx first: %llx item %llx last: %llx",
+             sli->sstable_id, sli->level, hdr.first->key_hash, item->key_hash, hdr.last->key_hash);
+
+    boolean_t may_contain = tosdb_sstable_index_header_may_contain(&hdr, item);
+    uint64_t index_data_location = hdr.index_data_location;
+    uint64_t index_data_size = hdr.index_data_size;
+
+    tosdb_sstable_index_header_release(&hdr);
+
+    if(!may_contain) {
+        PRINTLOG(TOSDB, LOG_TRACE, "not found inside sstable 0x%llx level 0x%llx", sli->sstable_id, sli->level);
+
+        return false;
+    }
+
+    tosdb_sstable_index_data_t id = {0};
+
+    if(!tosdb_sstable_index_data_load(tbl, sli, index_id, index_data_location, index_data_size, &id)) {
+        return false;
+    }
+
+    tosdb_memtable_index_item_t** t_found_item = (tosdb_memtable_index_item_t**)binarysearch(id.items,
+                                                                                             id.record_count,
+                                                                                             sizeof(tosdb_memtable_index_item_t*),
+                                                                                             &item,
+                                                                                             tosdb_sstable_index_comparator);
+
+    if(!t_found_item || !*t_found_item) {
+        tosdb_sstable_index_data_release(&id);
+
+        return false;
+    }
+
+    tosdb_memtable_index_item_t* found_item = *t_found_item;
+
+    uint128_t record_id = found_item->record_id;
+    boolean_t is_deleted = found_item->is_deleted;
+    uint64_t offset = found_item->offset;
+    uint64_t length = found_item->length;
+
+    tosdb_sstable_index_data_release(&id);
+
+    ctx->record_id = record_id;
+
+    if(is_deleted) {
+        ctx->is_deleted = true;
+        ctx->level = sli->level;
+        ctx->sstable_id = sli->sstable_id;
+
+        return true;
+    }
+
+    tosdb_sstable_valuelog_reader_t reader;
+
+    tosdb_sstable_valuelog_reader_init(&reader, tbl, sli);
+
+    uint8_t* value_data = tosdb_sstable_valuelog_reader_read(&reader, offset, length);
+
+    tosdb_sstable_valuelog_reader_release(&reader);
+
+    if(!value_data) {
+        return false;
+    }
+
+    boolean_t res = tosdb_sstable_record_populate(record, sli, index_id, record_id, value_data, length);
+
+    memory_free(value_data);
+
+    return res;
+}
 
 boolean_t tosdb_sstable_get_on_list(tosdb_record_t * record, list_t* st_list, tosdb_memtable_index_item_t* item, uint64_t index_id) {
     boolean_t found = false;
@@ -670,3 +869,494 @@ boolean_t tosdb_sstable_get(tosdb_record_t* record) {
     return false;
 }
 
+
+/**
+ * @brief multi get probe, one for each record which is not found at memtables
+ */
+typedef struct tosdb_sstable_multi_get_probe_t {
+    tosdb_record_t*              record; ///< record to populate
+    uint64_t                     index_id; ///< index id of record key
+    tosdb_memtable_index_item_t* item; ///< search key
+    boolean_t                    resolved; ///< newest version of key is found, older sstables are skipped
+    boolean_t                    found; ///< live record is found and populated
+    uint128_t                    record_id; ///< record id at sstable
+    uint64_t                     offset; ///< value offset at valuelog
+    uint64_t                     length; ///< value length at valuelog
+} tosdb_sstable_multi_get_probe_t;
+
+static int8_t tosdb_sstable_multi_get_probe_key_comparator(const void* i1, const void* i2) {
+    const tosdb_sstable_multi_get_probe_t* p1 = i1;
+    const tosdb_sstable_multi_get_probe_t* p2 = i2;
+
+    if(p1->index_id < p2->index_id) {
+        return -1;
+    }
+
+    if(p1->index_id > p2->index_id) {
+        return 1;
+    }
+
+    return tosdb_sstable_index_comparator(&p1->item, &p2->item);
+}
+
+static int8_t tosdb_sstable_multi_get_probe_offset_comparator(const void* i1, const void* i2) {
+    const tosdb_sstable_multi_get_probe_t* p1 = i1;
+    const tosdb_sstable_multi_get_probe_t* p2 = i2;
+
+    if(p1->offset < p2->offset) {
+        return -1;
+    }
+
+    if(p1->offset > p2->offset) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static uint64_t tosdb_sstable_index_lower_bound(tosdb_memtable_index_item_t** items, uint64_t start, uint64_t end, tosdb_memtable_index_item_t* item) {
+    while(start < end) {
+        uint64_t mid = start + (end - start) / 2;
+
+        if(tosdb_sstable_index_comparator(&items[mid], &item) < 0) {
+            start = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+
+    return start;
+}
+
+/**
+ * @brief searches sorted probes at one sstable
+ * @details bloom filter and index data of each index are fetched once for all probes. probes are sorted
+ * with index order so index data is searched forward only. values are read with valuelog order.
+ * @param[in] tbl table
+ * @param[in] sli sstable list item
+ * @param[in] probes probes sorted by index id and key
+ * @param[in] probe_count probe count
+ * @param[in] candidates scratch array with probe count capacity
+ * @param[in] hits scratch array with probe count capacity
+ * @param[in] locate_only only index data is searched, values are not read
+ * @param[out] unresolved_count decremented for each resolved probe
+ * @return false on read errors
+ */
+static boolean_t tosdb_sstable_multi_get_on_sstable(tosdb_table_t* tbl, tosdb_block_sstable_list_item_t* sli,
+                                                    tosdb_sstable_multi_get_probe_t** probes, uint64_t probe_count,
+                                                    tosdb_sstable_multi_get_probe_t** candidates, tosdb_sstable_multi_get_probe_t** hits,
+                                                    boolean_t locate_only, uint64_t* unresolved_count) {
+    uint64_t hit_count = 0;
+
+    for(uint64_t start = 0; start < probe_count;) {
+        uint64_t index_id = probes[start]->index_id;
+        uint64_t end = start;
+
+        while(end < probe_count && probes[end]->index_id == index_id) {
+            end++;
+        }
+
+        uint64_t group_start = start;
+
+        start = end;
+
+        if(index_id > sli->index_count) {
+            PRINTLOG(TOSDB, LOG_TRACE, "skipping sstable 0x%llx list item with index id 0x%llx max index count 0x%llx", sli->sstable_id, index_id, sli->index_count);
+
+            continue;
+        }
+
+        tosdb_sstable_index_header_t hdr = {0};
+        boolean_t hdr_loaded = false;
+        uint64_t candidate_count = 0;
+
+        for(uint64_t i = group_start; i < end; i++) {
+            if(probes[i]->resolved) {
+                continue;
+            }
+
+            if(!hdr_loaded) {
+                if(!tosdb_sstable_index_header_load(tbl, sli, index_id, &hdr)) {
+                    return false;
+                }
+
+                hdr_loaded = true;
+            }
+
+            if(tosdb_sstable_index_header_may_contain(&hdr, probes[i]->item)) {
+                candidates[candidate_count++] = probes[i];
+            }
+        }
+
+        if(!hdr_loaded) {
+            continue;
+        }
+
+        uint64_t index_data_location = hdr.index_data_location;
+        uint64_t index_data_size = hdr.index_data_size;
+
+        tosdb_sstable_index_header_release(&hdr);
+
+        PRINTLOG(TOSDB, LOG_TRACE, "sstable 0x%llx level 0x%llx index 0x%llx candidate count 0x%llx", sli->sstable_id, sli->level, index_id, candidate_count);
+
+        if(!candidate_count) {
+            continue;
+        }
+
+        tosdb_sstable_index_data_t id = {0};
+
+        if(!tosdb_sstable_index_data_load(tbl, sli, index_id, index_data_location, index_data_size, &id)) {
+            return false;
+        }
+
+        uint64_t pos = 0;
+
+        for(uint64_t i = 0; i < candidate_count && pos < id.record_count; i++) {
+            tosdb_sstable_multi_get_probe_t* probe = candidates[i];
+
+            pos = tosdb_sstable_index_lower_bound(id.items, pos, id.record_count, probe->item);
+
+            if(pos == id.record_count || tosdb_sstable_index_comparator(&id.items[pos], &probe->item) != 0) {
+                continue;
+            }
+
+            const tosdb_memtable_index_item_t* found_item = id.items[pos];
+            tosdb_record_context_t* ctx = probe->record->context;
+
+            probe->resolved = true;
+            (*unresolved_count)--;
+
+            ctx->record_id = found_item->record_id;
+            ctx->level = sli->level;
+            ctx->sstable_id = sli->sstable_id;
+
+            if(found_item->is_deleted) {
+                ctx->is_deleted = true;
+
+                continue;
+            }
+
+            probe->record_id = found_item->record_id;
+            probe->offset = found_item->offset;
+            probe->length = found_item->length;
+
+            if(locate_only) {
+                probe->found = true;
+
+                continue;
+            }
+
+            hits[hit_count++] = probe;
+        }
+
+        tosdb_sstable_index_data_release(&id);
+    }
+
+    if(!hit_count) {
+        return true;
+    }
+
+    // values are read with valuelog order, each chunk is unpacked or fetched from cache once
+    quicksort2((void**)hits, hit_count, tosdb_sstable_multi_get_probe_offset_comparator);
+
+    boolean_t error = false;
+
+    tosdb_sstable_valuelog_reader_t reader;
+
+    tosdb_sstable_valuelog_reader_init(&reader, tbl, sli);
+
+    for(uint64_t i = 0; i < hit_count; i++) {
+        tosdb_sstable_multi_get_probe_t* probe = hits[i];
+
+        uint8_t* value_data = tosdb_sstable_valuelog_reader_read(&reader, probe->offset, probe->length);
+
+        if(!value_data) {
+            error = true;
+
+            break;
+        }
+
+        probe->found = tosdb_sstable_record_populate(probe->record, sli, probe->index_id, probe->record_id, value_data, probe->length);
+
+        memory_free(value_data);
+    }
+
+    tosdb_sstable_valuelog_reader_release(&reader);
+
+    return !error;
+}
+
+static boolean_t tosdb_sstable_multi_get_on_list(tosdb_table_t* tbl, list_t* st_list,
+                                                 tosdb_sstable_multi_get_probe_t** probes, uint64_t probe_count,
+                                                 tosdb_sstable_multi_get_probe_t** candidates, tosdb_sstable_multi_get_probe_t** hits,
+                                                 boolean_t locate_only, uint64_t* unresolved_count) {
+    iterator_t* iter = list_iterator_create(st_list);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstables list items iterator");
+
+        return false;
+    }
+
+    boolean_t res = true;
+
+    while(*unresolved_count && iter->end_of_iterator(iter) != 0) {
+        tosdb_block_sstable_list_item_t* sli = (tosdb_block_sstable_list_item_t*) iter->get_item(iter);
+
+        if(!tosdb_sstable_multi_get_on_sstable(tbl, sli, probes, probe_count, candidates, hits, locate_only, unresolved_count)) {
+            res = false;
+
+            break;
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return res;
+}
+
+static boolean_t tosdb_sstable_multi_lookup(tosdb_table_t* tbl, tosdb_record_t** records, uint64_t count, boolean_t* founds, uint64_t* offsets) {
+    if(!tbl || !records || !founds) {
+        return false;
+    }
+
+    if(!count) {
+        return true;
+    }
+
+    tosdb_sstable_multi_get_probe_t* probe_list = memory_malloc(sizeof(tosdb_sstable_multi_get_probe_t) * count);
+    tosdb_sstable_multi_get_probe_t** probes = memory_malloc(sizeof(tosdb_sstable_multi_get_probe_t*) * count * 3);
+
+    if(!probe_list || !probes) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create multi get probes");
+        memory_free(probe_list);
+        memory_free(probes);
+
+        return false;
+    }
+
+    tosdb_sstable_multi_get_probe_t** candidates = probes + count;
+    tosdb_sstable_multi_get_probe_t** hits = candidates + count;
+
+    boolean_t res = true;
+    uint64_t probe_count = 0;
+
+    for(uint64_t i = 0; i < count; i++) {
+        tosdb_record_context_t* ctx = records[i]->context;
+
+        iterator_t* iter = hashmap_iterator_create(ctx->keys);
+
+        if(!iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot get key");
+            res = false;
+
+            break;
+        }
+
+        const tosdb_record_key_t* r_key = iter->get_item(iter);
+
+        iter->destroy(iter);
+
+        tosdb_memtable_index_item_t* item = memory_malloc(sizeof(tosdb_memtable_index_item_t) + r_key->key_length);
+
+        if(!item) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable index item");
+            res = false;
+
+            break;
+        }
+
+        item->key_hash = r_key->key_hash;
+        item->key_length = r_key->key_length;
+        memory_memcopy(r_key->key, item->key, item->key_length);
+
+        tosdb_sstable_multi_get_probe_t* probe = &probe_list[probe_count];
+
+        memory_memclean(probe, sizeof(tosdb_sstable_multi_get_probe_t));
+        probe->record = records[i];
+        probe->index_id = r_key->index_id;
+        probe->item = item;
+
+        probes[probe_count] = probe;
+        probe_count++;
+    }
+
+    uint64_t unresolved_count = probe_count;
+
+    if(res) {
+        // probes of same index become adjacent with index order, so each sstable index is walked forward once
+        quicksort2((void**)probes, probe_count, tosdb_sstable_multi_get_probe_key_comparator);
+
+        if(tbl->sstable_list_items) {
+            res = tosdb_sstable_multi_get_on_list(tbl, tbl->sstable_list_items, probes, probe_count, candidates, hits, offsets != NULL, &unresolved_count);
+        }
+
+        if(res && tbl->sstable_levels) {
+            for(uint64_t i = 1; i <= tbl->sstable_max_level && unresolved_count; i++) {
+                list_t* st_lvl_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)i);
+
+                if(st_lvl_l) {
+                    PRINTLOG(TOSDB, LOG_TRACE, "multi get on sstable level 0x%llx", i);
+
+                    res = tosdb_sstable_multi_get_on_list(tbl, st_lvl_l, probes, probe_count, candidates, hits, offsets != NULL, &unresolved_count);
+
+                    if(!res) {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    for(uint64_t i = 0; i < probe_count; i++) {
+        founds[i] = probe_list[i].found;
+        memory_free(probe_list[i].item);
+
+        if(offsets) {
+            offsets[i] = probe_list[i].offset;
+        }
+    }
+
+    memory_free(probe_list);
+    memory_free(probes);
+
+    return res;
+}
+
+boolean_t tosdb_sstable_multi_get(tosdb_table_t* tbl, tosdb_record_t** records, uint64_t count, boolean_t* founds) {
+    return tosdb_sstable_multi_lookup(tbl, records, count, founds, NULL);
+}
+
+boolean_t tosdb_sstable_multi_locate(tosdb_table_t* tbl, tosdb_record_t** records, uint64_t count, boolean_t* founds, uint64_t* offsets) {
+    if(!offsets) {
+        return false;
+    }
+
+    return tosdb_sstable_multi_lookup(tbl, records, count, founds, offsets);
+}
+
+static int8_t tosdb_sstable_scan_offset_comparator(const void* i1, const void* i2) {
+    const tosdb_memtable_index_item_t* ti1 = i1;
+    const tosdb_memtable_index_item_t* ti2 = i2;
+
+    if(ti1->offset < ti2->offset) {
+        return -1;
+    }
+
+    if(ti1->offset > ti2->offset) {
+        return 1;
+    }
+
+    return 0;
+}
+
+boolean_t tosdb_sstable_scan(tosdb_table_t* tbl, tosdb_block_sstable_list_item_t* sli, tosdb_sstable_scan_f cb, void* arg) {
+    if(!tbl || !sli || !cb) {
+        return false;
+    }
+
+    uint64_t index_id = tbl->primary_index_id;
+
+    if(index_id > sli->index_count) {
+        PRINTLOG(TOSDB, LOG_TRACE, "skipping sstable 0x%llx list item with index id 0x%llx max index count 0x%llx", sli->sstable_id, index_id, sli->index_count);
+
+        return true;
+    }
+
+    tosdb_sstable_index_header_t hdr = {0};
+
+    if(!tosdb_sstable_index_header_load(tbl, sli, index_id, &hdr)) {
+        return false;
+    }
+
+    uint64_t index_data_location = hdr.index_data_location;
+    uint64_t index_data_size = hdr.index_data_size;
+
+    tosdb_sstable_index_header_release(&hdr);
+
+    tosdb_sstable_index_data_t id = {0};
+
+    if(!tosdb_sstable_index_data_load(tbl, sli, index_id, index_data_location, index_data_size, &id)) {
+        return false;
+    }
+
+    uint64_t record_count = id.record_count;
+    uint64_t items_size = 0;
+
+    for(uint64_t i = 0; i < record_count; i++) {
+        items_size += sizeof(tosdb_memtable_index_item_t) + id.items[i]->key_length;
+    }
+
+    // cached index data can be evicted by valuelog chunk puts, so items are copied before values are read
+    uint8_t* items_data = memory_malloc(MAX(items_size, 1ULL));
+    tosdb_memtable_index_item_t** items = memory_malloc(sizeof(tosdb_memtable_index_item_t*) * MAX(record_count, 1ULL));
+
+    if(!items_data || !items) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create scan item array");
+        memory_free(items_data);
+        memory_free(items);
+        tosdb_sstable_index_data_release(&id);
+
+        return false;
+    }
+
+    uint8_t* items_pos = items_data;
+
+    for(uint64_t i = 0; i < record_count; i++) {
+        uint64_t item_size = sizeof(tosdb_memtable_index_item_t) + id.items[i]->key_length;
+
+        memory_memcopy(id.items[i], items_pos, item_size);
+        items[i] = (tosdb_memtable_index_item_t*)items_pos;
+        items_pos += item_size;
+    }
+
+    tosdb_sstable_index_data_release(&id);
+
+    // values are read with valuelog order, each chunk is unpacked or fetched from cache once
+    quicksort2((void**)items, record_count, tosdb_sstable_scan_offset_comparator);
+
+    boolean_t error = false;
+
+    tosdb_sstable_valuelog_reader_t reader;
+
+    tosdb_sstable_valuelog_reader_init(&reader, tbl, sli);
+
+    for(uint64_t i = 0; i < record_count; i++) {
+        if(items[i]->is_deleted) {
+            if(!cb(arg, sli, items[i], NULL)) {
+                error = true;
+
+                break;
+            }
+
+            continue;
+        }
+
+        uint8_t* value_data = tosdb_sstable_valuelog_reader_read(&reader, items[i]->offset, items[i]->length);
+
+        if(!value_data) {
+            error = true;
+
+            break;
+        }
+
+        boolean_t cb_res = cb(arg, sli, items[i], value_data);
+
+        memory_free(value_data);
+
+        if(!cb_res) {
+            error = true;
+
+            break;
+        }
+    }
+
+    tosdb_sstable_valuelog_reader_release(&reader);
+
+    memory_free(items);
+    memory_free(items_data);
+
+    return !error;
+}
@@ -15,8 +15,6 @@
 
 MODULE("turnstone.kernel.db");
 
-boolean_t tosdb_sstable_search_on_list(tosdb_record_t * record, set_t* results, list_t* st_list, tosdb_memtable_secondary_index_item_t* item, uint64_t index_id);
-boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results, tosdb_block_sstable_list_item_t* sli, tosdb_memtable_secondary_index_item_t* item, uint64_t index_id);
 int8_t    tosdb_sstable_secondary_index_comparator(const void* i1, const void* i2);
 
 int8_t tosdb_sstable_secondary_index_comparator(const void* i1, const void* i2) {
@@ -129,7 +127,7 @@ boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results,
 
         tosdb_memtable_secondary_index_item_t* t_first = (tosdb_memtable_secondary_index_item_t*)st_idx->data;
 
-        uint64_t first_key_length = t_first->secondary_key_length + t_first->primary_key_length + sizeof(tosdb_memtable_secondary_index_item_t);
+        uint64_t first_key_length = tosdb_memtable_secondary_index_item_size(t_first);
         first = memory_malloc(first_key_length);
 
         if(!first) {
@@ -141,9 +139,9 @@ boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results,
 
         memory_memcopy(t_first, first, first_key_length);
 
-        tosdb_memtable_secondary_index_item_t* t_last = (tosdb_memtable_secondary_index_item_t*)(st_idx->data + sizeof(tosdb_memtable_index_item_t) + first->secondary_key_length + first->primary_key_length);
+        tosdb_memtable_secondary_index_item_t* t_last = (tosdb_memtable_secondary_index_item_t*)(st_idx->data + first_key_length);
 
-        uint64_t last_key_length = t_last->secondary_key_length + t_last->primary_key_length + sizeof(tosdb_memtable_index_item_t);
+        uint64_t last_key_length = tosdb_memtable_secondary_index_item_size(t_last);
         last = memory_malloc(last_key_length);
 
         if(!last) {
@@ -354,7 +352,7 @@ boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results,
                 return false;
             }
 
-            idx_data += sizeof(tosdb_memtable_secondary_index_item_t) + st_idx_items[i]->secondary_key_length + st_idx_items[i]->primary_key_length;
+            idx_data += tosdb_memtable_secondary_index_item_size(st_idx_items[i]);
         }
 
         if(tdb_cache) {
@@ -396,7 +394,7 @@ boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results,
 
         tosdb_memtable_secondary_index_item_t* s_idx_item = *found_item;
 
-        uint64_t idx_item_len = sizeof(tosdb_memtable_index_item_t) + s_idx_item->primary_key_length;
+        uint64_t idx_item_len = sizeof(tosdb_memtable_index_item_t) + s_idx_item->primary_key_length + s_idx_item->covered_length;
 
         tosdb_memtable_index_item_t* res = memory_malloc(idx_item_len);
 
@@ -410,7 +408,10 @@ boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results,
         res->is_deleted = s_idx_item->is_primary_key_deleted;
         res->key_hash = s_idx_item->primary_key_hash;
         res->key_length = s_idx_item->primary_key_length;
-        memory_memcopy(s_idx_item->data + s_idx_item->secondary_key_length, res->key, res->key_length);
+        // version offset and covered columns are carried for index only searches, covered data follows key
+        res->offset = s_idx_item->offset;
+        res->length = s_idx_item->covered_length;
+        memory_memcopy(s_idx_item->data + s_idx_item->secondary_key_length, res->key, res->key_length + res->length);
 
         if(res->key_hash == 7083) {
             PRINTLOG(TOSDB, LOG_TRACE, "found item: %s deleted? %i", res->key, res->is_deleted);
@@ -433,7 +434,7 @@ boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results,
 
             tosdb_memtable_secondary_index_item_t* s_idx_item = *found_item;
 
-            uint64_t idx_item_len = sizeof(tosdb_memtable_index_item_t) + s_idx_item->primary_key_length;
+            uint64_t idx_item_len = sizeof(tosdb_memtable_index_item_t) + s_idx_item->primary_key_length + s_idx_item->covered_length;
 
             tosdb_memtable_index_item_t* res = memory_malloc(idx_item_len);
 
@@ -448,7 +449,9 @@ boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results,
             res->is_deleted = s_idx_item->is_primary_key_deleted;
             res->key_hash = s_idx_item->primary_key_hash;
             res->key_length = s_idx_item->primary_key_length;
-            memory_memcopy(s_idx_item->data + s_idx_item->secondary_key_length, res->key, res->key_length);
+            res->offset = s_idx_item->offset;
+            res->length = s_idx_item->covered_length;
+            memory_memcopy(s_idx_item->data + s_idx_item->secondary_key_length, res->key, res->key_length + res->length);
 
             if(res->key_hash == 7083) {
                 PRINTLOG(TOSDB, LOG_TRACE, "found item: %s deleted? %i", res->key, res->is_deleted);
@@ -473,93 +476,3 @@ boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results,
     return !error;
 }
 #pragma GCC diagnostic pop
-
-boolean_t tosdb_sstable_search_on_list(tosdb_record_t * record, set_t* results, list_t* st_list, tosdb_memtable_secondary_index_item_t* item, uint64_t index_id) {
-    boolean_t error = false;
-
-    iterator_t* iter = list_iterator_create(st_list);
-
-    if(!iter) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstables list items iterator");
-
-        return false;
-    }
-
-    while(iter->end_of_iterator(iter) != 0) {
-        tosdb_block_sstable_list_item_t* sli = (tosdb_block_sstable_list_item_t*) iter->get_item(iter);
-
-        if(index_id <= sli->index_count) {
-            error |= !tosdb_sstable_search_on_index(record, results, sli, item, index_id);
-        }
-
-        iter = iter->next(iter);
-    }
-
-    iter->destroy(iter);
-
-    return !error;
-}
-
-boolean_t tosdb_sstable_search(tosdb_record_t* record, set_t* results) {
-    if(!record || !record->context) {
-        return false;
-    }
-
-    tosdb_record_context_t* ctx = record->context;
-
-    if(hashmap_size(ctx->keys) != 1) {
-        PRINTLOG(TOSDB, LOG_ERROR, "record search supports only one key");
-
-        return false;
-    }
-
-    iterator_t* iter = hashmap_iterator_create(ctx->keys);
-
-    if(!iter) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot get key");
-
-        return false;
-    }
-
-    const tosdb_record_key_t* r_key = iter->get_item(iter);
-
-    iter->destroy(iter);
-
-    tosdb_memtable_secondary_index_item_t* item = memory_malloc(sizeof(tosdb_memtable_secondary_index_item_t) + r_key->key_length);
-
-    if(!item) {
-        PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable index item");
-
-        return false;
-    }
-
-    item->secondary_key_hash = r_key->key_hash;
-    item->secondary_key_length = r_key->key_length;
-    memory_memcopy(r_key->key, item->data, item->secondary_key_length);
-
-    if(ctx->table->sstable_list_items && !tosdb_sstable_search_on_list(record, results, ctx->table->sstable_list_items, item, r_key->index_id)) {
-        memory_free(item);
-
-        return false;
-    }
-
-
-    if(ctx->table->sstable_levels) {
-        for(uint64_t i = 1; i <= ctx->table->sstable_max_level; i++) {
-            list_t* st_lvl_l = (list_t*)hashmap_get(ctx->table->sstable_levels, (void*)i);
-
-            if(st_lvl_l) {
-                if(!tosdb_sstable_search_on_list(record, results, st_lvl_l, item, r_key->index_id)) {
-                    memory_free(item);
-
-                    return false;
-                }
-            }
-        }
-    }
-
-    memory_free(item);
-
-    return true;
-}
-
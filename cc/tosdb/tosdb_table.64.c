@@ -8,6 +8,7 @@
 
 #include <tosdb/tosdb.h>
 #include <tosdb/tosdb_internal.h>
+#include <tosdb/wal.h>
 #include <logging.h>
 #include <strings.h>
 
@@ -85,14 +86,16 @@ boolean_t tosdb_table_load_sstables(tosdb_table_t* tbl) {
     uint64_t st_list_size = tbl->sstable_list_size;
 
     while(st_list_loc != 0) {
-        tosdb_block_sstable_list_t* st_list = (tosdb_block_sstable_list_t*)tosdb_block_read(tbl->db->tdb, st_list_loc, st_list_size);
+        tosdb_cached_block_t* st_list_blk = tosdb_block_acquire(tbl->db->tdb, st_list_loc, st_list_size);
 
-        if(!st_list) {
+        if(!st_list_blk) {
             PRINTLOG(TOSDB, LOG_ERROR, "cannot read sstable list for table %s", tbl->name);
 
             return false;
         }
 
+        tosdb_block_sstable_list_t* st_list = (tosdb_block_sstable_list_t*)st_list_blk->block;
+
         uint8_t* st_list_data = (uint8_t*)&st_list->sstables[0];
 
         for(uint64_t i = 0; i < st_list->sstable_count; i++) {
@@ -105,7 +108,7 @@ boolean_t tosdb_table_load_sstables(tosdb_table_t* tbl) {
 
             if(!st) {
                 PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list for level");
-                memory_free(st_list);
+                tosdb_block_release(st_list_blk);
 
                 return false;
             }
@@ -124,7 +127,7 @@ boolean_t tosdb_table_load_sstables(tosdb_table_t* tbl) {
 
                 if(!st_l) {
                     PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list for level");
-                    memory_free(st_list);
+                    tosdb_block_release(st_list_blk);
                     memory_free(st);
 
                     return false;
@@ -139,7 +142,7 @@ boolean_t tosdb_table_load_sstables(tosdb_table_t* tbl) {
         }
 
         if(st_list->header.previous_block_invalid) {
-            memory_free(st_list);
+            tosdb_block_release(st_list_blk);
 
             break;
         }
@@ -147,7 +150,7 @@ boolean_t tosdb_table_load_sstables(tosdb_table_t* tbl) {
         st_list_loc = st_list->header.previous_block_location;
         st_list_size = st_list->header.previous_block_size;
 
-        memory_free(st_list);
+        tosdb_block_release(st_list_blk);
 
     }
 
@@ -176,14 +179,16 @@ boolean_t tosdb_table_load_indexes(tosdb_table_t* tbl) {
     uint64_t idx_list_size = tbl->index_list_size;
 
     while(idx_list_loc != 0) {
-        tosdb_block_index_list_t* idx_list = (tosdb_block_index_list_t*)tosdb_block_read(tbl->db->tdb, idx_list_loc, idx_list_size);
+        tosdb_cached_block_t* idx_list_blk = tosdb_block_acquire(tbl->db->tdb, idx_list_loc, idx_list_size);
 
-        if(!idx_list) {
+        if(!idx_list_blk) {
             PRINTLOG(TOSDB, LOG_ERROR, "cannot read index list for table %s", tbl->name);
 
             return false;
         }
 
+        tosdb_block_index_list_t* idx_list = (tosdb_block_index_list_t*)idx_list_blk->block;
+
         for(uint64_t i = 0; i < idx_list->index_count; i++) {
 
             if(hashmap_exists(tbl->indexes, (void*)idx_list->indexes[i].id)) {
@@ -194,7 +199,7 @@ boolean_t tosdb_table_load_indexes(tosdb_table_t* tbl) {
 
             if(!idx) {
                 PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate idx for table %s", tbl->name);
-                memory_free(idx_list);
+                tosdb_block_release(idx_list_blk);
 
                 return false;
             }
@@ -203,6 +208,8 @@ boolean_t tosdb_table_load_indexes(tosdb_table_t* tbl) {
             idx->is_deleted = idx_list->indexes[i].deleted;
             idx->type = idx_list->indexes[i].type;
             idx->column_id = idx_list->indexes[i].column_id;
+            idx->is_ordered = idx_list->indexes[i].ordered;
+            idx->covered_columns = idx_list->indexes[i].covered_columns;
 
             hashmap_put(tbl->indexes, (void*)idx->id, idx);
             hashmap_put(tbl->index_column_map, (void*)idx->column_id, idx);
@@ -210,7 +217,7 @@ boolean_t tosdb_table_load_indexes(tosdb_table_t* tbl) {
 
 
         if(idx_list->header.previous_block_invalid) {
-            memory_free(idx_list);
+            tosdb_block_release(idx_list_blk);
 
             break;
         }
@@ -218,7 +225,7 @@ boolean_t tosdb_table_load_indexes(tosdb_table_t* tbl) {
         idx_list_loc = idx_list->header.previous_block_location;
         idx_list_size = idx_list->header.previous_block_size;
 
-        memory_free(idx_list);
+        tosdb_block_release(idx_list_blk);
     }
 
     return true;
@@ -243,14 +250,16 @@ boolean_t tosdb_table_load_columns(tosdb_table_t* tbl) {
     uint64_t col_list_size = tbl->column_list_size;
 
     while(col_list_loc != 0) {
-        tosdb_block_column_list_t* col_list = (tosdb_block_column_list_t*)tosdb_block_read(tbl->db->tdb, col_list_loc, col_list_size);
+        tosdb_cached_block_t* col_list_blk = tosdb_block_acquire(tbl->db->tdb, col_list_loc, col_list_size);
 
-        if(!col_list) {
+        if(!col_list_blk) {
             PRINTLOG(TOSDB, LOG_ERROR, "cannot read column list for table %s", tbl->name);
 
             return false;
         }
 
+        tosdb_block_column_list_t* col_list = (tosdb_block_column_list_t*)col_list_blk->block;
+
         char_t name_buf[TOSDB_NAME_MAX_LEN + 1] = {0};
 
         for(uint64_t i = 0; i < col_list->column_count; i++) {
@@ -265,7 +274,7 @@ boolean_t tosdb_table_load_columns(tosdb_table_t* tbl) {
 
             if(!col) {
                 PRINTLOG(TOSDB, LOG_ERROR, "cannot allocate col for table %s", tbl->name);
-                memory_free(col_list);
+                tosdb_block_release(col_list_blk);
 
                 return false;
             }
@@ -280,7 +289,7 @@ boolean_t tosdb_table_load_columns(tosdb_table_t* tbl) {
 
 
         if(col_list->header.previous_block_invalid) {
-            memory_free(col_list);
+            tosdb_block_release(col_list_blk);
 
             break;
         }
@@ -288,7 +297,7 @@ boolean_t tosdb_table_load_columns(tosdb_table_t* tbl) {
         col_list_loc = col_list->header.previous_block_location;
         col_list_size = col_list->header.previous_block_size;
 
-        memory_free(col_list);
+        tosdb_block_release(col_list_blk);
     }
 
     return true;
@@ -705,6 +714,15 @@ boolean_t tosdb_table_free(tosdb_table_t* tbl) {
         tbl->sstable_levels = NULL;
     }
 
+    // columns and indexes which are not persisted are also at column and index maps
+    if(tbl->column_new) {
+        list_destroy(tbl->column_new);
+    }
+
+    if(tbl->index_new) {
+        list_destroy(tbl->index_new);
+    }
+
     memory_free(tbl->name);
     lock_destroy(tbl->lock);
     memory_free(tbl);
@@ -757,6 +775,8 @@ boolean_t tosdb_table_index_persist(tosdb_table_t* tbl) {
         block->indexes[idx_idx].column_id = idx->column_id;
         block->indexes[idx_idx].deleted = idx->is_deleted;
         block->indexes[idx_idx].type = idx->type;
+        block->indexes[idx_idx].ordered = idx->is_ordered;
+        block->indexes[idx_idx].covered_columns = idx->covered_columns;
 
         iter = iter->next(iter);
 
@@ -910,70 +930,81 @@ boolean_t tosdb_table_persist(tosdb_table_t* tbl) {
         }
     }
 
+    if(tbl->is_sstable_list_dirty) {
+        need_persist = true;
+    }
+
     if(!tbl->metadata_location) {
         need_persist = true;
     }
 
     if(need_persist) {
-        tosdb_block_table_t* block = memory_malloc(TOSDB_PAGE_SIZE);
+        return tosdb_table_metadata_persist(tbl);
+    }
 
-        if(!block) {
-            return false;
-        }
+    return true;
+}
 
-        block->header.block_size = TOSDB_PAGE_SIZE;
-        block->header.block_type = TOSDB_BLOCK_TYPE_TABLE;
-        block->header.previous_block_invalid = true;
-        block->header.previous_block_location = tbl->metadata_location;
-        block->header.previous_block_size = tbl->metadata_size;
-
-        block->id = tbl->id;
-        block->database_id = tbl->db->id;
-        strcpy(tbl->name, block->name);
-        block->column_next_id = tbl->column_next_id;
-        block->index_next_id = tbl->index_next_id;
-        block->column_list_location = tbl->column_list_location;
-        block->column_list_size = tbl->column_list_size;
-        block->index_list_location = tbl->index_list_location;
-        block->index_list_size = tbl->index_list_size;
-        block->memtable_next_id = tbl->memtable_next_id;
-        block->sstable_list_location = tbl->sstable_list_location;
-        block->sstable_list_size = tbl->sstable_list_size;
-        block->primary_column_id = tbl->primary_column_id;
-        block->primary_index_id = tbl->primary_index_id;
-        block->primary_column_type = tbl->primary_column_type;
-
-        uint64_t loc = tosdb_block_write(tbl->db->tdb, (tosdb_block_header_t*)block);
-
-        if(loc == 0) {
-            memory_free(block);
+boolean_t tosdb_table_metadata_persist(tosdb_table_t* tbl) {
+    tosdb_block_table_t* block = memory_malloc(TOSDB_PAGE_SIZE);
 
-            return false;
-        }
+    if(!block) {
+        return false;
+    }
 
-        tbl->metadata_location = loc;
-        tbl->metadata_size = block->header.block_size;
+    block->header.block_size = TOSDB_PAGE_SIZE;
+    block->header.block_type = TOSDB_BLOCK_TYPE_TABLE;
+    block->header.previous_block_invalid = true;
+    block->header.previous_block_location = tbl->metadata_location;
+    block->header.previous_block_size = tbl->metadata_size;
 
-        if(!tbl->db->table_new) {
-            tbl->db->table_new = hashmap_integer(128);
+    block->id = tbl->id;
+    block->database_id = tbl->db->id;
+    strcpy(tbl->name, block->name);
+    block->column_next_id = tbl->column_next_id;
+    block->index_next_id = tbl->index_next_id;
+    block->column_list_location = tbl->column_list_location;
+    block->column_list_size = tbl->column_list_size;
+    block->index_list_location = tbl->index_list_location;
+    block->index_list_size = tbl->index_list_size;
+    block->memtable_next_id = tbl->memtable_next_id;
+    block->sstable_list_location = tbl->sstable_list_location;
+    block->sstable_list_size = tbl->sstable_list_size;
+    block->primary_column_id = tbl->primary_column_id;
+    block->primary_index_id = tbl->primary_index_id;
+    block->primary_column_type = tbl->primary_column_type;
 
-            if(!tbl->db->table_new) {
-                memory_free(block);
+    uint64_t loc = tosdb_block_write(tbl->db->tdb, (tosdb_block_header_t*)block);
 
-                return false;
-            }
-        }
+    if(loc == 0) {
+        memory_free(block);
 
-        hashmap_put(tbl->db->table_new, (void*)tbl->id, tbl);
+        return false;
+    }
 
-        PRINTLOG(TOSDB, LOG_DEBUG, "table %s is persisted at loc 0x%llx size 0x%llx", tbl->name, loc, block->header.block_size);
+    tbl->metadata_location = loc;
+    tbl->metadata_size = block->header.block_size;
 
-        tbl->is_dirty = false;
-        tbl->db->is_dirty = true;
+    if(!tbl->db->table_new) {
+        tbl->db->table_new = hashmap_integer(128);
 
-        memory_free(block);
+        if(!tbl->db->table_new) {
+            memory_free(block);
+
+            return false;
+        }
     }
 
+    hashmap_put(tbl->db->table_new, (void*)tbl->id, tbl);
+
+    PRINTLOG(TOSDB, LOG_DEBUG, "table %s is persisted at loc 0x%llx size 0x%llx", tbl->name, loc, block->header.block_size);
+
+    tbl->is_dirty = false;
+    tbl->is_sstable_list_dirty = false;
+    tbl->db->is_dirty = true;
+
+    memory_free(block);
+
     return true;
 }
 
@@ -1032,7 +1063,7 @@ boolean_t tosdb_table_column_add(tosdb_table_t* tbl, const char_t* colname, data
     return true;
 }
 
-boolean_t tosdb_table_index_create(tosdb_table_t* tbl, const char_t* colname, tosdb_index_type_t type) {
+static boolean_t tosdb_table_index_create_internal(tosdb_table_t* tbl, const char_t* colname, tosdb_index_type_t type, boolean_t ordered, uint64_t covered_columns) {
     if(!tbl) {
         PRINTLOG(TOSDB, LOG_ERROR, "table is null");
 
@@ -1077,6 +1108,8 @@ boolean_t tosdb_table_index_create(tosdb_table_t* tbl, const char_t* colname, to
 
     idx->column_id = col->id;
     idx->type = type;
+    idx->is_ordered = ordered;
+    idx->covered_columns = covered_columns;
 
     if(type == TOSDB_INDEX_PRIMARY) {
         tbl->primary_column_id = col->id;
@@ -1094,6 +1127,44 @@ boolean_t tosdb_table_index_create(tosdb_table_t* tbl, const char_t* colname, to
 
     return true;
 }
+
+boolean_t tosdb_table_index_create(tosdb_table_t* tbl, const char_t* colname, tosdb_index_type_t type) {
+    return tosdb_table_index_create_internal(tbl, colname, type, false, 0);
+}
+
+boolean_t tosdb_table_index_create_ordered(tosdb_table_t* tbl, const char_t* colname, tosdb_index_type_t type) {
+    return tosdb_table_index_create_internal(tbl, colname, type, true, 0);
+}
+
+boolean_t tosdb_table_index_create_covering(tosdb_table_t* tbl, const char_t* colname, const char_t** covered_colnames, uint64_t covered_count) {
+    if(!tbl || !covered_colnames) {
+        PRINTLOG(TOSDB, LOG_ERROR, "table or covered columns is null");
+
+        return false;
+    }
+
+    uint64_t covered_columns = 0;
+
+    for(uint64_t i = 0; i < covered_count; i++) {
+        const tosdb_column_t* col = hashmap_get(tbl->columns, covered_colnames[i]);
+
+        if(!col) {
+            PRINTLOG(TOSDB, LOG_ERROR, "covered column %s is not at table %s", covered_colnames[i], tbl->name);
+
+            return false;
+        }
+
+        if(col->id >= 64) {
+            PRINTLOG(TOSDB, LOG_ERROR, "covered column %s id %lli is too big for table %s", covered_colnames[i], col->id, tbl->name);
+
+            return false;
+        }
+
+        covered_columns |= 1ULL << col->id;
+    }
+
+    return tosdb_table_index_create_internal(tbl, colname, TOSDB_INDEX_SECONDARY, false, covered_columns);
+}
 #pragma GCC diagnostic pop
 
 boolean_t tosdb_table_memtable_persist(tosdb_table_t* tbl) {
@@ -1232,6 +1303,192 @@ boolean_t tosdb_table_memtable_persist(tosdb_table_t* tbl) {
     return !error;
 }
 
+/**
+ * @brief appends sstable of persisted memtable to sstable list of table
+ * @details sstable moves from memtable to its level, so memtable free or table persist does not list it again.
+ * @param[in] tbl table
+ * @param[in] mt persisted memtable
+ * @return true if sstable list block is written
+ */
+static boolean_t tosdb_table_sstable_list_append(tosdb_table_t* tbl, tosdb_memtable_t* mt) {
+    tosdb_block_sstable_list_item_t* stli = mt->stli;
+
+    if(!tbl->sstable_levels) {
+        tbl->sstable_levels = hashmap_integer(128);
+
+        if(!tbl->sstable_levels) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable levels map");
+
+            return false;
+        }
+    }
+
+    list_t* st_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)stli->level);
+
+    if(!st_l) {
+        st_l = list_create_queue();
+
+        if(!st_l) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list for level");
+
+            return false;
+        }
+
+        hashmap_put(tbl->sstable_levels, (void*)stli->level, st_l);
+    }
+
+    uint64_t stli_size = sizeof(tosdb_block_sstable_list_item_t) + sizeof(tosdb_block_sstable_list_item_index_pair_t) * stli->index_count;
+    uint64_t block_size = sizeof(tosdb_block_sstable_list_t) + stli_size;
+
+    if(block_size % TOSDB_PAGE_SIZE) {
+        block_size += TOSDB_PAGE_SIZE - (block_size % TOSDB_PAGE_SIZE);
+    }
+
+    tosdb_block_sstable_list_t* block = memory_malloc(block_size);
+
+    if(!block) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list block");
+
+        return false;
+    }
+
+    block->header.block_size = block_size;
+    block->header.block_type = TOSDB_BLOCK_TYPE_SSTABLE_LIST;
+    block->header.previous_block_location = tbl->sstable_list_location;
+    block->header.previous_block_size = tbl->sstable_list_size;
+    block->database_id = tbl->db->id;
+    block->table_id = tbl->id;
+    block->sstable_count = 1;
+
+    memory_memcopy(stli, &block->sstables[0], stli_size);
+
+    uint64_t block_loc = tosdb_block_write(tbl->db->tdb, (tosdb_block_header_t*)block);
+
+    memory_free(block);
+
+    if(!block_loc) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot write sstable list");
+
+        return false;
+    }
+
+    tbl->sstable_list_location = block_loc;
+    tbl->sstable_list_size = block_size;
+    tbl->sstable_max_level = MAX(tbl->sstable_max_level, stli->level);
+
+    // newest sstable is searched first
+    list_stack_push(st_l, stli);
+    mt->stli = NULL;
+
+    return true;
+}
+
+/**
+ * @brief finds oldest wal sequence of memtables which are not reachable from superblock
+ * @param[in] tbl table
+ * @return wal sequence, zero if all memtables are checkpointed
+ */
+static uint64_t tosdb_table_get_wal_sequence(tosdb_table_t* tbl) {
+    uint64_t wal_sequence = 0;
+
+    if(!tbl->memtables) {
+        return 0;
+    }
+
+    iterator_t* iter = list_iterator_create(tbl->memtables);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create memtable iterator");
+
+        return tbl->wal_sequence;
+    }
+
+    while(iter->end_of_iterator(iter) != 0) {
+        const tosdb_memtable_t* mt = (tosdb_memtable_t*)iter->get_item(iter);
+
+        if(mt == tbl->current_memtable || mt->is_dirty || mt->stli) {
+            if(!wal_sequence || mt->wal_sequence < wal_sequence) {
+                wal_sequence = mt->wal_sequence;
+            }
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    return wal_sequence;
+}
+
+boolean_t tosdb_table_checkpoint(tosdb_table_t* tbl, tosdb_memtable_t* mt) {
+    if(!tbl || !tbl->db || !tbl->db->tdb) {
+        PRINTLOG(TOSDB, LOG_ERROR, "table or db is null");
+
+        return false;
+    }
+
+    tosdb_database_t* db = tbl->db;
+    tosdb_t* tdb = db->tdb;
+
+    boolean_t error = false;
+
+    // checkpoints write database and superblock chains, they are serialized
+    lock_acquire(tdb->lock);
+
+    if(tbl->column_new_count && !tosdb_table_column_persist(tbl)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot persist column list for table %s", tbl->name);
+        error = true;
+    }
+
+    if(!error && tbl->index_new_count && !tosdb_table_index_persist(tbl)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot persist index list for table %s", tbl->name);
+        error = true;
+    }
+
+    if(!error && mt && mt->stli && !tosdb_table_sstable_list_append(tbl, mt)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot append sstable of memtable %lli to table %s", mt->id, tbl->name);
+        error = true;
+    }
+
+    if(!error && !tosdb_table_metadata_persist(tbl)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot persist metadata of table %s", tbl->name);
+        error = true;
+    }
+
+    if(!error && !tosdb_database_persist(db)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot persist database %s", db->name);
+        error = true;
+    }
+
+    if(!error) {
+        uint64_t tbl_wal_sequence = tbl->wal_sequence;
+        uint64_t wal_first_sequence = tdb->superblock->wal_first_sequence;
+
+        if(mt) {
+            tbl->wal_sequence = tosdb_table_get_wal_sequence(tbl);
+        }
+
+        // wal blocks before trim point are dropped with the same superblock write which makes sstables reachable
+        tdb->superblock->wal_first_sequence = MAX(wal_first_sequence, tosdb_wal_get_trim_sequence(tdb->wal));
+
+        if(!tosdb_persist(tdb)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot persist tosdb metadata");
+            tbl->wal_sequence = tbl_wal_sequence;
+            tdb->superblock->wal_first_sequence = wal_first_sequence;
+            error = true;
+        }
+    }
+
+    // memtables which are not checkpointed yet are persisted at close
+    if(tbl->memtables && list_size(tbl->memtables)) {
+        tbl->is_dirty = true;
+    }
+
+    lock_release(tdb->lock);
+
+    return !error;
+}
+
 set_t* tosdb_table_get_primary_keys(tosdb_table_t* tbl) {
     if(!tbl) {
         return NULL;
@@ -1243,11 +1500,80 @@ set_t* tosdb_table_get_primary_keys(tosdb_table_t* tbl) {
         return NULL;
     }
 
-    if(!tosdb_table_get_primary_keys_internal(tbl, res, NULL)) {
-        set_destroy_with_callback(res, tosdb_record_search_set_destroy_cb);
+    iterator_t* iter = tosdb_table_primary_key_iterator(tbl);
+
+    if(!iter) {
+        set_destroy(res);
 
         return NULL;
     }
 
+    while(iter->end_of_iterator(iter) != 0) {
+        tosdb_record_t* rec = (tosdb_record_t*)iter->delete_item(iter);
+
+        if(!set_append(res, rec)) {
+            rec->destroy(rec);
+        }
+    }
+
+    iter->destroy(iter);
+
     return res;
 }
+
+boolean_t tosdb_table_get_stats(tosdb_table_t* tbl, tosdb_table_stats_t* stats) {
+    if(!tbl || !stats) {
+        return false;
+    }
+
+    memory_memclean(stats, sizeof(tosdb_table_stats_t));
+
+    lock_acquire(tbl->lock);
+
+    stats->sstable_max_level = tbl->sstable_max_level;
+    stats->backend_used_size = tbl->db->tdb->superblock->free_next_location;
+    stats->valuelog_chunk_unpack_count = __atomic_load_n(&tbl->db->tdb->valuelog_chunk_unpack_count, __ATOMIC_RELAXED);
+
+    for(uint64_t i = 0; i <= tbl->sstable_max_level; i++) {
+        list_t* st_l = NULL;
+
+        if(i == 0) {
+            st_l = tbl->sstable_list_items;
+        } else {
+            st_l = (list_t*)hashmap_get(tbl->sstable_levels, (void*)i);
+        }
+
+        if(!st_l) {
+            continue;
+        }
+
+        iterator_t* iter = list_iterator_create(st_l);
+
+        if(!iter) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot create sstable list iterator");
+            lock_release(tbl->lock);
+
+            return false;
+        }
+
+        while(iter->end_of_iterator(iter) != 0) {
+            const tosdb_block_sstable_list_item_t* stli = iter->get_item(iter);
+
+            stats->sstable_count++;
+            stats->sstable_record_count += stli->record_count;
+            stats->sstable_size += stli->valuelog_size;
+
+            for(uint64_t j = 0; j < stli->index_count; j++) {
+                stats->sstable_size += stli->indexes[j].index_size;
+            }
+
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+    }
+
+    lock_release(tbl->lock);
+
+    return true;
+}
@@ -7,5 +7,819 @@
  */
 
 #include <tosdb/wal.h>
+#include <tosdb/tosdb.h>
+#include <tosdb/tosdb_internal.h>
+#include <buffer.h>
+#include <list.h>
+#include <logging.h>
+#include <cpu/task.h>
 
 MODULE("turnstone.kernel.db");
+
+struct tosdb_wal_t {
+    tosdb_t*  tdb;
+    lock_t*   lock;
+    boolean_t is_replaying;
+    boolean_t is_flushing; ///< leader is writing a group, other groups wait it
+    boolean_t is_failed; ///< a group cannot be committed, its writers and later ones fail
+    uint64_t  replay_sequence;
+    uint64_t  group_commit_size;
+    uint64_t  next_sequence; ///< sequence of pending group
+    uint64_t  committed_sequence; ///< sequence of last durable group
+    uint64_t  record_sequence; ///< last sequence given to a record, newer record of a key wins at memtable
+    uint64_t  pending_count;
+    buffer_t* pending;
+    buffer_t* spare; ///< swapped with pending while leader is writing the group
+};
+
+boolean_t      tosdb_wal_flush(tosdb_wal_t* wal);
+tosdb_table_t* tosdb_wal_find_table(tosdb_t* tdb, tosdb_block_wal_item_t* item);
+boolean_t      tosdb_wal_replay_item(tosdb_wal_t* wal, tosdb_block_wal_item_t* item);
+boolean_t      tosdb_wal_replay_block(tosdb_wal_t* wal, tosdb_block_wal_t* block);
+
+tosdb_wal_t* tosdb_wal_new(tosdb_t* tdb) {
+    if(!tdb) {
+        PRINTLOG(TOSDB, LOG_ERROR, "tosdb is null");
+
+        return NULL;
+    }
+
+    tosdb_wal_t* wal = memory_malloc(sizeof(tosdb_wal_t));
+
+    if(!wal) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create wal");
+
+        return NULL;
+    }
+
+    wal->pending = buffer_new_with_capacity(NULL, TOSDB_PAGE_SIZE);
+    wal->spare = buffer_new_with_capacity(NULL, TOSDB_PAGE_SIZE);
+
+    if(!wal->pending || !wal->spare) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create wal pending buffers");
+        buffer_destroy(wal->pending);
+        buffer_destroy(wal->spare);
+        memory_free(wal);
+
+        return NULL;
+    }
+
+    wal->tdb = tdb;
+    wal->lock = lock_create();
+    wal->group_commit_size = TOSDB_WAL_DEFAULT_GROUP_COMMIT_SIZE;
+    wal->next_sequence = 1;
+
+    return wal;
+}
+
+boolean_t tosdb_wal_free(tosdb_wal_t* wal) {
+    if(!wal) {
+        return true;
+    }
+
+    buffer_destroy(wal->pending);
+    buffer_destroy(wal->spare);
+    lock_destroy(wal->lock);
+    memory_free(wal);
+
+    return true;
+}
+
+/**
+ * @brief writes pending group as a wal block, it is called with wal lock and returns with it
+ * @details wal lock is released while block is written, so next group is filled meanwhile. block and superblock
+ * are written with tosdb lock like checkpoints, so superblock chains are not changed under each other.
+ * @param[in] wal wal
+ * @return true if group is committed
+ */
+boolean_t tosdb_wal_flush(tosdb_wal_t* wal) {
+    if(wal->is_failed) {
+        return false;
+    }
+
+    if(!wal->pending_count) {
+        return true;
+    }
+
+    tosdb_t* tdb = wal->tdb;
+
+    buffer_t* group = wal->pending;
+    uint64_t group_count = wal->pending_count;
+    uint64_t sequence = wal->next_sequence;
+
+    wal->pending = wal->spare;
+    wal->spare = NULL;
+    wal->pending_count = 0;
+    wal->next_sequence++;
+    wal->is_flushing = true;
+
+    lock_release(wal->lock);
+
+    boolean_t res = false;
+
+    uint64_t data_size = buffer_get_length(group);
+    uint64_t block_size = sizeof(tosdb_block_wal_t) + data_size;
+
+    if(block_size % TOSDB_PAGE_SIZE) {
+        block_size += (TOSDB_PAGE_SIZE - (block_size % TOSDB_PAGE_SIZE));
+    }
+
+    tosdb_block_wal_t* block = memory_malloc(block_size);
+
+    if(!block) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create wal block");
+
+        goto relock;
+    }
+
+    block->header.block_type = TOSDB_BLOCK_TYPE_WAL;
+    block->header.block_size = block_size;
+    block->sequence = sequence;
+    block->item_count = group_count;
+    block->data_size = data_size;
+
+    if(!buffer_write_slice_into(group, 0, data_size, block->data)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot copy pending wal items");
+        memory_free(block);
+
+        goto relock;
+    }
+
+    lock_acquire(tdb->lock);
+
+    block->header.previous_block_location = tdb->superblock->wal_location;
+    block->header.previous_block_size = tdb->superblock->wal_size;
+    block->header.previous_block_invalid = tdb->superblock->wal_location == 0;
+
+    uint64_t loc = tosdb_block_write(tdb, (tosdb_block_header_t*)block);
+
+    memory_free(block);
+
+    if(loc == 0) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot write wal block");
+        lock_release(tdb->lock);
+
+        goto relock;
+    }
+
+    uint64_t prev_wal_location = tdb->superblock->wal_location;
+    uint64_t prev_wal_size = tdb->superblock->wal_size;
+
+    tdb->superblock->wal_location = loc;
+    tdb->superblock->wal_size = block_size;
+
+    // superblock write is the commit point of the whole group
+    if(!tosdb_superblock_flush(tdb)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot commit wal block");
+        tdb->superblock->wal_location = prev_wal_location;
+        tdb->superblock->wal_size = prev_wal_size;
+        lock_release(tdb->lock);
+
+        goto relock;
+    }
+
+    lock_release(tdb->lock);
+
+    PRINTLOG(TOSDB, LOG_TRACE, "wal block 0x%llx with 0x%llx items committed at 0x%llx", sequence, group_count, loc);
+
+    res = true;
+
+relock:
+    lock_acquire(wal->lock);
+
+    buffer_reset(group);
+    wal->spare = group;
+    wal->is_flushing = false;
+
+    if(res) {
+        wal->committed_sequence = sequence;
+    } else {
+        // newer groups cannot be committed without this one, they would be replayed with a gap
+        wal->is_failed = true;
+    }
+
+    return res;
+}
+
+boolean_t tosdb_wal_sync(tosdb_wal_t* wal, uint64_t sequence) {
+    if(!wal || !sequence) {
+        return true;
+    }
+
+    uint64_t wait_count = 0;
+    uint64_t last_pending_count = 0;
+
+    while(true) {
+        lock_acquire(wal->lock);
+
+        if(wal->committed_sequence >= sequence) {
+            lock_release(wal->lock);
+
+            return true;
+        }
+
+        if(wal->is_failed) {
+            lock_release(wal->lock);
+
+            return false;
+        }
+
+        if(!wal->is_flushing && wal->next_sequence == sequence) {
+            if(wal->pending_count < wal->group_commit_size &&
+               wal->pending_count != last_pending_count &&
+               wait_count < TOSDB_WAL_GROUP_COMMIT_MAX_WAIT) {
+                last_pending_count = wal->pending_count;
+                wait_count++;
+            } else {
+                boolean_t res = tosdb_wal_flush(wal);
+
+                lock_release(wal->lock);
+
+                return res;
+            }
+        }
+
+        lock_release(wal->lock);
+
+        task_yield();
+    }
+}
+
+static tosdb_block_wal_item_t* tosdb_wal_item_create(tosdb_record_t* record, boolean_t del, uint64_t* item_size) {
+    if(!record || !record->context) {
+        PRINTLOG(TOSDB, LOG_ERROR, "record is null");
+
+        return NULL;
+    }
+
+    tosdb_record_context_t* ctx = record->context;
+    tosdb_table_t* tbl = ctx->table;
+
+    data_t* sd = tosdb_record_serialize(record);
+
+    if(!sd) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot serialize record for wal");
+
+        return NULL;
+    }
+
+    *item_size = sizeof(tosdb_block_wal_item_t) + sd->length;
+
+    if(*item_size % 8) {
+        *item_size += (8 - (*item_size % 8));
+    }
+
+    tosdb_block_wal_item_t* item = memory_malloc(*item_size);
+
+    if(!item) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create wal item");
+        memory_free(sd->value);
+        memory_free(sd);
+
+        return NULL;
+    }
+
+    item->database_id = tbl->db->id;
+    item->table_id = tbl->id;
+    item->max_record_count = tbl->max_record_count;
+    item->max_valuelog_size = tbl->max_valuelog_size;
+    item->max_memtable_count = tbl->max_memtable_count;
+    item->record_id = ctx->record_id;
+    item->is_deleted = del;
+    item->data_size = sd->length;
+    memory_memcopy(sd->value, item->data, sd->length);
+
+    memory_free(sd->value);
+    memory_free(sd);
+
+    return item;
+}
+
+boolean_t tosdb_wal_prepare(tosdb_wal_t* wal, tosdb_record_t** records, const boolean_t* dels, uint64_t count, buffer_t** items) {
+    if(!items) {
+        PRINTLOG(TOSDB, LOG_ERROR, "wal item buffer is null");
+
+        return false;
+    }
+
+    *items = NULL;
+
+    if(!wal || wal->is_replaying || !wal->group_commit_size || !count) {
+        return true;
+    }
+
+    if(!records || !dels) {
+        PRINTLOG(TOSDB, LOG_ERROR, "records are null");
+
+        return false;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        if(!records[i] || !records[i]->context) {
+            continue;
+        }
+
+        tosdb_table_t* tbl = ((tosdb_record_context_t*)records[i]->context)->table;
+
+        // replay finds only tables and columns which are reachable from superblock
+        if(!tbl->metadata_location || tbl->column_new_count || tbl->index_new_count) {
+            if(!tosdb_table_checkpoint(tbl, NULL)) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot checkpoint metadata of table %s before logging", tbl->name);
+
+                return false;
+            }
+        }
+    }
+
+    buffer_t* buf = buffer_new_with_capacity(NULL, TOSDB_PAGE_SIZE);
+
+    if(!buf) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create wal item buffer");
+
+        return false;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        uint64_t item_size = 0;
+        tosdb_block_wal_item_t* item = tosdb_wal_item_create(records[i], dels[i], &item_size);
+
+        if(!item || !buffer_append_bytes(buf, (uint8_t*)item, item_size)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot append wal item");
+            memory_free(item);
+            buffer_destroy(buf);
+
+            return false;
+        }
+
+        memory_free(item);
+    }
+
+    *items = buf;
+
+    return true;
+}
+
+boolean_t tosdb_wal_enqueue(tosdb_wal_t* wal, buffer_t* items, uint64_t count, uint64_t* group_sequence, uint64_t* record_sequence) {
+    if(group_sequence) {
+        *group_sequence = 0;
+    }
+
+    if(record_sequence) {
+        *record_sequence = 0;
+    }
+
+    if(!wal) {
+        buffer_destroy(items);
+
+        return true;
+    }
+
+    boolean_t res = true;
+
+    lock_acquire(wal->lock);
+
+    // all items enter pending group at once, so they are committed in the same wal block
+    if(items) {
+        uint64_t items_size = buffer_get_length(items);
+
+        if(wal->is_failed) {
+            PRINTLOG(TOSDB, LOG_ERROR, "wal is failed, records cannot be logged");
+            res = false;
+        } else if(!buffer_append_bytes(wal->pending, buffer_get_view_at_position(items, 0, items_size), items_size)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot append wal items");
+            res = false;
+        } else {
+            wal->pending_count += count;
+
+            if(group_sequence) {
+                *group_sequence = wal->next_sequence;
+            }
+        }
+    }
+
+    // record sequences follow pending order, replay and memtables agree on which record of a key is newer
+    if(res) {
+        if(record_sequence) {
+            *record_sequence = wal->record_sequence + 1;
+        }
+
+        wal->record_sequence += count;
+    }
+
+    lock_release(wal->lock);
+
+    buffer_destroy(items);
+
+    return res;
+}
+
+uint64_t tosdb_wal_get_sequence(tosdb_wal_t* wal) {
+    if(!wal) {
+        return 0;
+    }
+
+    lock_acquire(wal->lock);
+
+    uint64_t sequence = wal->is_replaying ? wal->replay_sequence : wal->next_sequence;
+
+    lock_release(wal->lock);
+
+    return sequence;
+}
+
+uint64_t tosdb_wal_get_trim_sequence(tosdb_wal_t* wal) {
+    if(!wal) {
+        return 0;
+    }
+
+    tosdb_t* tdb = wal->tdb;
+
+    uint64_t sequence = tosdb_wal_get_sequence(wal);
+
+    iterator_t* db_iter = hashmap_iterator_create(tdb->databases);
+
+    if(!db_iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create database iterator");
+
+        return tdb->superblock->wal_first_sequence;
+    }
+
+    while(db_iter->end_of_iterator(db_iter) != 0) {
+        const tosdb_database_t* db = (tosdb_database_t*)db_iter->get_item(db_iter);
+
+        iterator_t* tbl_iter = db->tables ? hashmap_iterator_create(db->tables) : NULL;
+
+        while(tbl_iter && tbl_iter->end_of_iterator(tbl_iter) != 0) {
+            const tosdb_table_t* tbl = (tosdb_table_t*)tbl_iter->get_item(tbl_iter);
+
+            if(tbl->wal_sequence && tbl->wal_sequence < sequence) {
+                sequence = tbl->wal_sequence;
+            }
+
+            tbl_iter = tbl_iter->next(tbl_iter);
+        }
+
+        if(tbl_iter) {
+            tbl_iter->destroy(tbl_iter);
+        }
+
+        db_iter = db_iter->next(db_iter);
+    }
+
+    db_iter->destroy(db_iter);
+
+    return sequence;
+}
+
+tosdb_table_t* tosdb_wal_find_table(tosdb_t* tdb, tosdb_block_wal_item_t* item) {
+    tosdb_database_t* db = NULL;
+
+    iterator_t* iter = hashmap_iterator_create(tdb->databases);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create database iterator");
+
+        return NULL;
+    }
+
+    while(iter->end_of_iterator(iter) != 0) {
+        tosdb_database_t* t_db = (tosdb_database_t*)iter->get_item(iter);
+
+        if(t_db->id == item->database_id) {
+            db = t_db;
+
+            break;
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(!db || db->is_deleted) {
+        return NULL;
+    }
+
+    if(!db->is_open) {
+        db = tosdb_database_create_or_open(tdb, db->name);
+
+        if(!db) {
+            return NULL;
+        }
+    }
+
+    tosdb_table_t* tbl = NULL;
+
+    iter = hashmap_iterator_create(db->tables);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create table iterator");
+
+        return NULL;
+    }
+
+    while(iter->end_of_iterator(iter) != 0) {
+        tosdb_table_t* t_tbl = (tosdb_table_t*)iter->get_item(iter);
+
+        if(t_tbl->id == item->table_id) {
+            tbl = t_tbl;
+
+            break;
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(!tbl || tbl->is_deleted) {
+        return NULL;
+    }
+
+    if(!tbl->is_open) {
+        tbl = tosdb_table_create_or_open(db, tbl->name, item->max_record_count, item->max_valuelog_size, item->max_memtable_count);
+    }
+
+    return tbl;
+}
+
+boolean_t tosdb_wal_replay_item(tosdb_wal_t* wal, tosdb_block_wal_item_t* item) {
+    tosdb_table_t* tbl = tosdb_wal_find_table(wal->tdb, item);
+
+    if(!tbl) {
+        PRINTLOG(TOSDB, LOG_WARNING, "table 0x%llx of database 0x%llx for wal item not found, item skipped", item->table_id, item->database_id);
+
+        return true;
+    }
+
+    tosdb_record_t* record = tosdb_table_create_record(tbl);
+
+    if(!record) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create record for wal item");
+
+        return false;
+    }
+
+    tosdb_record_context_t* ctx = record->context;
+    ctx->record_id = item->record_id;
+
+    data_t s_d = {0};
+    s_d.length = item->data_size;
+    s_d.type = DATA_TYPE_INT8_ARRAY;
+    s_d.value = item->data;
+
+    data_t* r_d = data_bson_deserialize(&s_d);
+
+    if(!r_d) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot deserialize wal item");
+        record->destroy(record);
+
+        return false;
+    }
+
+    boolean_t res = true;
+
+    data_t* tmp = r_d->value;
+
+    for(uint64_t i = 0; i < r_d->length; i++) {
+        uint64_t tmp_col_id = (uint64_t)tmp[i].name->value;
+
+        if(!tosdb_record_set_data_with_colid(record, tmp_col_id, tmp[i].type, tmp[i].length, tmp[i].value)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot populate record from wal item");
+            res = false;
+
+            break;
+        }
+    }
+
+    data_free(r_d);
+
+    if(res) {
+        res = tosdb_memtable_upsert(record, item->is_deleted);
+    }
+
+    record->destroy(record);
+
+    return res;
+}
+
+boolean_t tosdb_wal_replay_block(tosdb_wal_t* wal, tosdb_block_wal_t* block) {
+    uint8_t* data = &block->data[0];
+    uint8_t* data_end = data + block->data_size;
+
+    for(uint64_t i = 0; i < block->item_count; i++) {
+        tosdb_block_wal_item_t* item = (tosdb_block_wal_item_t*)data;
+
+        uint64_t item_size = sizeof(tosdb_block_wal_item_t) + item->data_size;
+
+        if(item_size % 8) {
+            item_size += (8 - (item_size % 8));
+        }
+
+        if(data + item_size > data_end) {
+            PRINTLOG(TOSDB, LOG_ERROR, "wal block 0x%llx is corrupted at item 0x%llx", block->sequence, i);
+
+            return false;
+        }
+
+        if(!tosdb_wal_replay_item(wal, item)) {
+            return false;
+        }
+
+        data += item_size;
+    }
+
+    return true;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+boolean_t tosdb_wal_replay(tosdb_wal_t* wal) {
+    if(!wal) {
+        PRINTLOG(TOSDB, LOG_ERROR, "wal is null");
+
+        return false;
+    }
+
+    tosdb_t* tdb = wal->tdb;
+
+    uint64_t wal_loc = tdb->superblock->wal_location;
+    uint64_t wal_size = tdb->superblock->wal_size;
+
+    // new blocks should not fall behind trim point
+    if(wal->next_sequence < tdb->superblock->wal_first_sequence) {
+        wal->next_sequence = tdb->superblock->wal_first_sequence;
+        wal->committed_sequence = wal->next_sequence - 1;
+    }
+
+    if(!wal_loc) {
+        return true;
+    }
+
+    // blocks are chained from newest to oldest, stack gives them back in commit order
+    list_t* blocks = list_create_stack();
+
+    if(!blocks) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create wal block list");
+
+        return false;
+    }
+
+    boolean_t error = false;
+
+    while(wal_loc != 0) {
+        tosdb_block_wal_t* block = (tosdb_block_wal_t*)tosdb_block_read(tdb, wal_loc, wal_size);
+
+        if(!block) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot read wal block");
+            error = true;
+
+            break;
+        }
+
+        if(block->sequence >= wal->next_sequence) {
+            wal->next_sequence = block->sequence + 1;
+        }
+
+        // older blocks are checkpointed, their records are at sstables
+        if(block->sequence < tdb->superblock->wal_first_sequence) {
+            memory_free(block);
+
+            break;
+        }
+
+        list_stack_push(blocks, block);
+
+        if(block->header.previous_block_invalid) {
+            break;
+        }
+
+        wal_loc = block->header.previous_block_location;
+        wal_size = block->header.previous_block_size;
+    }
+
+    uint64_t replayed_block_count = 0;
+
+    wal->is_replaying = true;
+
+    iterator_t* iter = list_iterator_create(blocks);
+
+    if(!iter) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create wal block iterator");
+        error = true;
+    } else {
+        while(!error && iter->end_of_iterator(iter) != 0) {
+            tosdb_block_wal_t* block = (tosdb_block_wal_t*)iter->get_item(iter);
+
+            wal->replay_sequence = block->sequence;
+
+            if(!tosdb_wal_replay_block(wal, block)) {
+                PRINTLOG(TOSDB, LOG_ERROR, "cannot replay wal block 0x%llx", block->sequence);
+                error = true;
+            }
+
+            replayed_block_count++;
+
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+    }
+
+    wal->is_replaying = false;
+    wal->committed_sequence = wal->next_sequence - 1;
+
+    list_destroy_with_data(blocks);
+
+    PRINTLOG(TOSDB, LOG_DEBUG, "0x%llx wal blocks replayed", replayed_block_count);
+
+    return !error;
+}
+#pragma GCC diagnostic pop
+
+boolean_t tosdb_wal_truncate(tosdb_wal_t* wal) {
+    if(!wal) {
+        return true;
+    }
+
+    tosdb_t* tdb = wal->tdb;
+
+    // superblock fields are changed with tosdb lock, it is taken before wal lock like checkpoints
+    lock_acquire(tdb->lock);
+    lock_acquire(wal->lock);
+
+    wal->pending_count = 0;
+    buffer_reset(wal->pending);
+
+    if(tdb->superblock->wal_location) {
+        tdb->superblock->wal_location = 0;
+        tdb->superblock->wal_size = 0;
+        tdb->superblock->wal_first_sequence = wal->next_sequence;
+        tdb->is_dirty = true;
+    }
+
+    lock_release(wal->lock);
+    lock_release(tdb->lock);
+
+    return true;
+}
+
+boolean_t tosdb_wal_config_set(tosdb_t* tdb, tosdb_wal_config_t* config) {
+    if(!tdb || !config || !tdb->wal) {
+        PRINTLOG(TOSDB, LOG_ERROR, "required fields are null");
+
+        return false;
+    }
+
+    if(!tosdb_wal_commit(tdb)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot commit pending wal records");
+
+        return false;
+    }
+
+    tosdb_wal_t* wal = tdb->wal;
+
+    lock_acquire(wal->lock);
+
+    wal->group_commit_size = config->group_commit_size;
+
+    lock_release(wal->lock);
+
+    return true;
+}
+
+boolean_t tosdb_wal_commit(tosdb_t* tdb) {
+    if(!tdb || !tdb->wal) {
+        PRINTLOG(TOSDB, LOG_ERROR, "tosdb or wal is null");
+
+        return false;
+    }
+
+    tosdb_wal_t* wal = tdb->wal;
+
+    lock_acquire(wal->lock);
+
+    // waits the running flush when nothing is pending
+    uint64_t sequence = wal->pending_count ? wal->next_sequence : wal->next_sequence - 1;
+
+    lock_release(wal->lock);
+
+    return tosdb_wal_sync(wal, sequence);
+}
+
+boolean_t tosdb_wal_get_stats(tosdb_t* tdb, tosdb_wal_stats_t* stats) {
+    if(!tdb || !tdb->wal || !stats) {
+        PRINTLOG(TOSDB, LOG_ERROR, "required fields are null");
+
+        return false;
+    }
+
+    lock_acquire(tdb->wal->lock);
+
+    stats->first_sequence = tdb->superblock->wal_first_sequence;
+    stats->committed_sequence = tdb->wal->committed_sequence;
+
+    lock_release(tdb->wal->lock);
+
+    return true;
+}
@@ -0,0 +1,447 @@
+/**
+ * @file tosdb_write_batch.64.c
+ * @brief tosdb write batch implementation
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include <tosdb/tosdb.h>
+#include <tosdb/tosdb_internal.h>
+#include <tosdb/wal.h>
+#include <logging.h>
+#include <quicksort.h>
+
+MODULE("turnstone.kernel.db");
+
+typedef struct tosdb_write_batch_item_t {
+    tosdb_record_t*           record;
+    boolean_t                 del;
+    boolean_t                 skip; ///< superseded by a later item of same key or delete of a missing or deleted record
+    uint64_t                  sequence; ///< add order, later operation of same key wins
+    const tosdb_record_key_t* key; ///< primary key, items are sorted and folded by it before deletes are resolved
+    data_t*                   sd; ///< serialized record, only for upserts
+} tosdb_write_batch_item_t;
+
+struct tosdb_write_batch_t {
+    tosdb_t*                  tdb;
+    tosdb_write_batch_item_t* items;
+    uint64_t                  count;
+    uint64_t                  capacity;
+};
+
+#define TOSDB_WRITE_BATCH_INITIAL_CAPACITY 64
+
+static int8_t tosdb_write_batch_item_key_comparator(const tosdb_write_batch_item_t* item1, const tosdb_write_batch_item_t* item2) {
+    const tosdb_record_context_t* ctx1 = item1->record->context;
+    const tosdb_record_context_t* ctx2 = item2->record->context;
+
+    // tables are ordered by address, so concurrent batches lock tables at the same order
+    if((uint64_t)ctx1->table < (uint64_t)ctx2->table) {
+        return -1;
+    }
+
+    if((uint64_t)ctx1->table > (uint64_t)ctx2->table) {
+        return 1;
+    }
+
+    const tosdb_record_key_t* key1 = item1->key;
+    const tosdb_record_key_t* key2 = item2->key;
+
+    if(key1->key_hash < key2->key_hash) {
+        return -1;
+    }
+
+    if(key1->key_hash > key2->key_hash) {
+        return 1;
+    }
+
+    uint64_t min = MIN(key1->key_length, key2->key_length);
+
+    int8_t res = min ? memory_memcompare(key1->key, key2->key, min) : 0;
+
+    if(res != 0) {
+        return res;
+    }
+
+    if(key1->key_length < key2->key_length) {
+        return -1;
+    }
+
+    if(key1->key_length > key2->key_length) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static int8_t tosdb_write_batch_item_comparator(const void* i1, const void* i2) {
+    const tosdb_write_batch_item_t* item1 = i1;
+    const tosdb_write_batch_item_t* item2 = i2;
+
+    int8_t res = tosdb_write_batch_item_key_comparator(item1, item2);
+
+    if(res != 0) {
+        return res;
+    }
+
+    if(item1->sequence < item2->sequence) {
+        return -1;
+    }
+
+    if(item1->sequence > item2->sequence) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static void tosdb_write_batch_item_clear(tosdb_write_batch_item_t* item) {
+    if(item->sd) {
+        memory_free(item->sd->value);
+        memory_free(item->sd);
+        item->sd = NULL;
+    }
+}
+
+static boolean_t tosdb_write_batch_add(tosdb_write_batch_t* batch, tosdb_record_t* record, boolean_t del) {
+    if(!batch || !record || !record->context) {
+        PRINTLOG(TOSDB, LOG_ERROR, "batch or record is null");
+
+        return false;
+    }
+
+    tosdb_record_context_t* r_ctx = record->context;
+
+    if(!r_ctx->table || r_ctx->table->db->tdb != batch->tdb) {
+        PRINTLOG(TOSDB, LOG_ERROR, "record does not belong to tosdb of batch");
+
+        return false;
+    }
+
+    if(batch->count == batch->capacity) {
+        uint64_t new_capacity = batch->capacity ? batch->capacity * 2 : TOSDB_WRITE_BATCH_INITIAL_CAPACITY;
+
+        tosdb_write_batch_item_t* new_items = memory_malloc(sizeof(tosdb_write_batch_item_t) * new_capacity);
+
+        if(!new_items) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot grow write batch");
+
+            return false;
+        }
+
+        if(batch->items) {
+            memory_memcopy(batch->items, new_items, sizeof(tosdb_write_batch_item_t) * batch->count);
+            memory_free(batch->items);
+        }
+
+        batch->items = new_items;
+        batch->capacity = new_capacity;
+    }
+
+    tosdb_write_batch_item_t* item = &batch->items[batch->count];
+
+    memory_memclean(item, sizeof(tosdb_write_batch_item_t));
+    item->record = record;
+    item->del = del;
+    item->sequence = batch->count;
+
+    batch->count++;
+
+    return true;
+}
+
+/**
+ * @brief validates an item before anything is applied
+ * @param[in] item batch item
+ * @return true if item can be applied
+ */
+static boolean_t tosdb_write_batch_check_item(tosdb_write_batch_item_t* item) {
+    tosdb_record_t* record = item->record;
+    tosdb_record_context_t* r_ctx = record->context;
+    tosdb_table_t* tbl = r_ctx->table;
+
+    // a failed commit leaves batch untouched, items are folded again at next commit
+    item->skip = false;
+
+    if(!tbl->is_open) {
+        PRINTLOG(TOSDB, LOG_ERROR, "table %s is closed", tbl->name);
+
+        return false;
+    }
+
+    if(!item->del && hashmap_size(tbl->indexes) != hashmap_size(r_ctx->keys)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "required columns are missing from record for table %s", tbl->name);
+
+        return false;
+    }
+
+    item->key = hashmap_get(r_ctx->keys, (void*)tbl->primary_index_id);
+
+    if(!item->key) {
+        PRINTLOG(TOSDB, LOG_ERROR, "primary key is missing from record for table %s", tbl->name);
+
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief resolves delete or serializes upsert of an item which is not superseded by a later item of its key
+ * @param[in] item batch item
+ * @return true if item can be applied
+ */
+static boolean_t tosdb_write_batch_prepare_item(tosdb_write_batch_item_t* item) {
+    tosdb_record_t* record = item->record;
+    tosdb_record_context_t* r_ctx = record->context;
+    tosdb_table_t* tbl = r_ctx->table;
+
+    if(item->del) {
+        if(hashmap_size(tbl->indexes) != hashmap_size(r_ctx->keys)) {
+            // delete needs all keys of record, a missing record has nothing to delete
+            item->skip = !record->get_record(record);
+        } else if(hashmap_size(r_ctx->keys) == 1) {
+            item->skip = tosdb_memtable_is_deleted(record);
+        }
+
+        return true;
+    }
+
+    item->sd = tosdb_record_serialize(record);
+
+    if(!item->sd) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot serialize record for table %s", tbl->name);
+
+        return false;
+    }
+
+    if(item->sd->length > tbl->max_valuelog_size) {
+        PRINTLOG(TOSDB, LOG_ERROR, "record size %lli is larger than valuelog size of table %s", item->sd->length, tbl->name);
+        tosdb_write_batch_item_clear(item);
+
+        return false;
+    }
+
+    return true;
+}
+
+tosdb_write_batch_t* tosdb_write_batch_new(tosdb_t* tdb) {
+    if(!tdb) {
+        PRINTLOG(TOSDB, LOG_ERROR, "tosdb is null");
+
+        return NULL;
+    }
+
+    tosdb_write_batch_t* batch = memory_malloc(sizeof(tosdb_write_batch_t));
+
+    if(!batch) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create write batch");
+
+        return NULL;
+    }
+
+    batch->tdb = tdb;
+
+    return batch;
+}
+
+boolean_t tosdb_write_batch_upsert(tosdb_write_batch_t* batch, tosdb_record_t* record) {
+    return tosdb_write_batch_add(batch, record, false);
+}
+
+boolean_t tosdb_write_batch_delete(tosdb_write_batch_t* batch, tosdb_record_t* record) {
+    return tosdb_write_batch_add(batch, record, true);
+}
+
+uint64_t tosdb_write_batch_size(tosdb_write_batch_t* batch) {
+    if(!batch) {
+        return 0;
+    }
+
+    return batch->count;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wanalyzer-malloc-leak"
+boolean_t tosdb_write_batch_commit(tosdb_write_batch_t* batch) {
+    if(!batch) {
+        PRINTLOG(TOSDB, LOG_ERROR, "batch is null");
+
+        return false;
+    }
+
+    if(!batch->count) {
+        return true;
+    }
+
+    uint64_t count = batch->count;
+
+    tosdb_write_batch_item_t** sorted = memory_malloc(sizeof(tosdb_write_batch_item_t*) * count);
+    tosdb_record_t** wal_records = memory_malloc(sizeof(tosdb_record_t*) * count);
+    boolean_t* wal_dels = memory_malloc(sizeof(boolean_t) * count);
+
+    if(!sorted || !wal_records || !wal_dels) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot create write batch commit arrays");
+        memory_free(sorted);
+        memory_free(wal_records);
+        memory_free(wal_dels);
+
+        return false;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        if(!tosdb_write_batch_check_item(&batch->items[i])) {
+            memory_free(sorted);
+            memory_free(wal_records);
+            memory_free(wal_dels);
+
+            return false;
+        }
+
+        sorted[i] = &batch->items[i];
+    }
+
+    // items of a table become adjacent and each index receives its keys in order
+    quicksort2((void**)sorted, count, tosdb_write_batch_item_comparator);
+
+    // items of a key are adjacent at add order, only the last one is applied
+    for(uint64_t i = 1; i < count; i++) {
+        if(tosdb_write_batch_item_key_comparator(sorted[i - 1], sorted[i]) == 0) {
+            sorted[i - 1]->skip = true;
+        }
+    }
+
+    boolean_t error = false;
+
+    for(uint64_t i = 0; i < count && !error; i++) {
+        if(!sorted[i]->skip && !tosdb_write_batch_prepare_item(sorted[i])) {
+            error = true;
+        }
+    }
+
+    for(uint64_t i = 0; i < count && !error; i++) {
+        tosdb_table_t* tbl = ((tosdb_record_context_t*)sorted[i]->record->context)->table;
+
+        if(i && tbl == ((tosdb_record_context_t*)sorted[i - 1]->record->context)->table) {
+            continue;
+        }
+
+        if(!tosdb_compaction_throttle_writer(tbl)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot compact stalled level 1 of table %s", tbl->name);
+            error = true;
+        }
+    }
+
+    uint64_t wal_count = 0;
+
+    for(uint64_t i = 0; i < count && !error; i++) {
+        if(sorted[i]->skip) {
+            continue;
+        }
+
+        wal_records[wal_count] = sorted[i]->record;
+        wal_dels[wal_count] = sorted[i]->del;
+        wal_count++;
+    }
+
+    tosdb_wal_t* wal = batch->tdb->wal;
+    buffer_t* wal_items = NULL;
+
+    if(!error && !tosdb_wal_prepare(wal, wal_records, wal_dels, wal_count, &wal_items)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot prepare write batch wal items");
+        error = true;
+    }
+
+    if(error) {
+        for(uint64_t i = 0; i < count; i++) {
+            tosdb_write_batch_item_clear(&batch->items[i]);
+        }
+
+        memory_free(sorted);
+        memory_free(wal_records);
+        memory_free(wal_dels);
+
+        return false;
+    }
+
+    // all tables are held while batch takes its wal sequences and is applied, other batches and writers of these
+    // tables are ordered entirely before or after it
+    for(uint64_t i = 0; i < count; i++) {
+        tosdb_table_t* tbl = ((tosdb_record_context_t*)sorted[i]->record->context)->table;
+
+        if(!i || tbl != ((tosdb_record_context_t*)sorted[i - 1]->record->context)->table) {
+            lock_acquire(tbl->lock);
+        }
+    }
+
+    uint64_t group_sequence = 0;
+    uint64_t sequence = 0;
+
+    // items take consecutive sequences at apply order, so later item of a key is newer at wal and memtables
+    boolean_t logged = tosdb_wal_enqueue(wal, wal_items, wal_count, &group_sequence, &sequence);
+
+    if(!logged) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot append write batch to wal");
+        error = true;
+    }
+
+    for(uint64_t i = 0; i < count && logged; i++) {
+        tosdb_write_batch_item_t* item = sorted[i];
+
+        if(item->skip) {
+            continue;
+        }
+
+        // logged items are applied even after a failure, so memtables do not miss what replay would bring back
+        if(!tosdb_memtable_upsert_locked(item->record, item->del, item->sd, sequence)) {
+            PRINTLOG(TOSDB, LOG_ERROR, "cannot apply batch item to table %s", ((tosdb_record_context_t*)item->record->context)->table->name);
+            error = true;
+        }
+
+        sequence++;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        tosdb_table_t* tbl = ((tosdb_record_context_t*)sorted[i]->record->context)->table;
+
+        if(!i || tbl != ((tosdb_record_context_t*)sorted[i - 1]->record->context)->table) {
+            lock_release(tbl->lock);
+        }
+    }
+
+    if(!tosdb_wal_sync(wal, group_sequence)) {
+        PRINTLOG(TOSDB, LOG_ERROR, "cannot commit write batch to wal");
+        error = true;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        tosdb_write_batch_item_clear(&batch->items[i]);
+        batch->items[i].record->destroy(batch->items[i].record);
+    }
+
+    batch->count = 0;
+
+    memory_free(sorted);
+    memory_free(wal_records);
+    memory_free(wal_dels);
+
+    return !error;
+}
+#pragma GCC diagnostic pop
+
+boolean_t tosdb_write_batch_destroy(tosdb_write_batch_t* batch) {
+    if(!batch) {
+        return true;
+    }
+
+    for(uint64_t i = 0; i < batch->count; i++) {
+        tosdb_write_batch_item_clear(&batch->items[i]);
+        batch->items[i].record->destroy(batch->items[i].record);
+    }
+
+    memory_free(batch->items);
+    memory_free(batch);
+
+    return true;
+}
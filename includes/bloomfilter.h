@@ -25,6 +25,16 @@ typedef struct bloomfilter_t bloomfilter_t;
  */
 bloomfilter_t* bloomfilter_new(uint64_t entry_count, float64_t error);
 
+/**
+ * @brief creates new cache line blocked bloom filter
+ * @details all probes of an entry fall into one 64 byte block selected by one xxhash64, a negative check costs one
+ * cache miss. its false positive rate is slightly higher than classic filter of same size.
+ * @param[in] entry_count how many entries
+ * @param[in] error error rate for false positive
+ * @return bloom filter
+ */
+bloomfilter_t* bloomfilter_new_blocked(uint64_t entry_count, float64_t error);
+
 /**
  * @brief destroy's bloom filter
  * @param[in] bf bloom filter
@@ -50,6 +60,9 @@ boolean_t bloomfilter_add(bloomfilter_t* bf, data_t* data);
 
 /**
  * @brief serialize given bloom filter
+ * @details classic filters are serialized with seven fields as before. blocked filters add block count as
+ * eighth field, deserializers older than blocked filters reject them. users which persist filters should
+ * gate blocked ones with their format version, tosdb writes them only at major version 1 blocks.
  * @param[in] bf bloom filter to serialize
  * @return serialized data
  */
@@ -57,6 +70,7 @@ data_t* bloomfilter_serialize(bloomfilter_t* bf);
 
 /**
  * @brief deserialize given bloom filter
+ * @details both classic and blocked layouts are accepted.
  * @param[in] data data that holds serialized bloom filter
  * @return bloom filter
  */
@@ -17,12 +17,15 @@ typedef enum cache_policy_t {
     CACHE_POLICY_SIZE,
 } cache_policy_t;
 
+// item is null when an item is put again with a new key, then only old key is released
 typedef boolean_t (*cache_item_key_destroyer_f)(const void* key, const void* item);
 
+#define CACHE_DEFAULT_SHARD_COUNT 16
+
 typedef struct cache_config_t {
     cache_policy_t             policy;
     uint64_t                   hard_limit;
-    uint64_t                   soft_limit;
+    uint64_t                   shard_count; // power of two, zero means CACHE_DEFAULT_SHARD_COUNT
     hashmap_key_generator_f    key_generator;
     hashmap_key_comparator_f   key_comparator;
     cache_item_key_destroyer_f item_key_destroyer;
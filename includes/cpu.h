@@ -82,6 +82,18 @@ uint16_t cpu_read_data_segment(void);
  */
 int8_t cpu_check_rdrand(void);
 
+/**
+ * @brief checks pcid supported
+ * @return 0 when supported else -1
+ */
+int8_t cpu_check_pcid(void);
+
+/**
+ * @brief checks 1g pages supported
+ * @return 0 when supported else -1
+ */
+int8_t cpu_check_1g_pages(void);
+
 /**
  * @brief read msr and return
  * @param[in]  msr_address model Specific register address
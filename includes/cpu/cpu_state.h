@@ -20,8 +20,9 @@ typedef struct cpu_state_t {
     task_t *  idle_task; ///< idle task
     boolean_t task_switch_paramters_need_eoi; ///< task switch parameters need eoi
     boolean_t task_switch_paramters_need_sti; ///< task switch parameters need sti
-    list_t *  task_queue; ///< task list
+    list_t *  task_queue; ///< ready task list
     list_t *  task_cleanup_queue; ///< task cleanup list
+    struct task_scheduler_t * task_scheduler; ///< sleep heap, wait list and wake inbox of cpu
 } cpu_state_t;
 
 #endif
@@ -27,7 +27,30 @@ typedef struct smp_data_t {
     uint64_t               gs_base_size;
 } smp_data_t;
 
+/**
+ * @struct smp_tlb_shootdown_request_t
+ * @brief tlb shootdown request of one initiator cpu shared with target cpus
+ */
+typedef struct smp_tlb_shootdown_request_t {
+    memory_page_table_context_t* table_context; ///< page table context whose entries are changed
+    uint64_t                     virtual_address; ///< start virtual address of changed range
+    uint64_t                     page_count; ///< 4k page count of changed range, 0 for whole table
+    volatile uint64_t            pending_mask[MEMORY_PAGING_CPU_MASK_SIZE]; ///< local apic ids which did not invalidate yet
+} smp_tlb_shootdown_request_t; ///< short hand for struct
 
 int8_t smp_init(void);
 
+/**
+ * @brief invalidates range at all cpus which loaded the table
+ * @param[in] table_context page table context whose entries are changed
+ * @param[in] virtual_address start virtual address of changed range
+ * @param[in] page_count 4k page count of changed range, 0 for whole table
+ * @return 0 if successed
+ *
+ * sends ipi only to cpus at cpu mask of table and waits them. each cpu has its own request, so
+ * initiators serve requests of other cpus while waiting. cpus which left the table flush its pcid
+ * at next load instead of taking ipi.
+ */
+int8_t smp_tlb_shootdown(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t page_count);
+
 #endif
@@ -98,6 +98,18 @@ typedef enum task_state_e {
     TASK_STATE_ENDED, ///< task is ended
 } task_state_t; ///< short hand for enum
 
+/**
+ * @enum task_scheduler_queue_e
+ * @brief scheduler queues of a cpu which a task can be at
+ */
+typedef enum task_scheduler_queue_e {
+    TASK_SCHEDULER_QUEUE_NONE, ///< task is running or it is not at any queue
+    TASK_SCHEDULER_QUEUE_NEW, ///< task is created and will be placed by its cpu
+    TASK_SCHEDULER_QUEUE_READY, ///< task is at ready queue
+    TASK_SCHEDULER_QUEUE_SLEEP, ///< task is at sleep queue ordered by wake tick
+    TASK_SCHEDULER_QUEUE_WAIT, ///< task is at wait list for messages, interrupts or futures
+} task_scheduler_queue_t; ///< short hand for enum
+
 typedef struct task_registers_t {
     uint64_t rax; ///< register
     uint64_t rbx; ///< register
@@ -127,6 +139,7 @@ typedef struct task_t {
     memory_heap_t*               creator_heap; ///< the heap which task struct is at
     memory_heap_t*               heap; ///< task's heap
     uint64_t                     heap_size; ///< task's heap size
+    boolean_t                    shares_default_heap; ///< task allocates from default heap, it has no heap frames
     uint64_t                     task_id; ///< task's id
     uint64_t                     cpu_id; ///< cpu id which task is running
     uint64_t                     last_tick_count; ///< tick count when task removes from executing, used for scheduling
@@ -144,6 +157,11 @@ typedef struct task_t {
     boolean_t                    interrupt_received; ///< task state for interrupt received should move @ref task_state_e
     boolean_t                    wait_for_future; ///< task state for waiting future event should move @ref task_state_e
     uint64_t                     wake_tick; ///< tick value when task wakes up
+    task_scheduler_queue_t       scheduler_queue; ///< scheduler queue which task is at
+    volatile uint64_t            wake_pending; ///< task is at wake inbox of its cpu
+    struct task_t*               wake_next; ///< next task at wake inbox
+    struct task_t*               wait_next; ///< next task at wait list
+    struct task_t*               wait_previous; ///< previous task at wait list
     const char*                  task_name; ///< task name
     memory_page_table_context_t* page_table; ///< page table
     buffer_t*                    input_buffer; ///< input buffer
@@ -235,6 +253,19 @@ list_t* task_get_message_queue(uint64_t task_id, uint64_t queue_number);
  */
 uint64_t task_create_task(memory_heap_t* heap, uint64_t heap_size, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name);
 
+/**
+ * @brief creates a task which allocates from default heap and apends it to wait queue
+ * @details task has no heap frames, so its allocations outlive it. long living services which hand their
+ * allocations to other tasks use it.
+ * @param[in] heap creator heap
+ * @param[in] stack_size task's stack size, stack allocated with frame allocator
+ * @param[in] entry_point task's entry point
+ * @param[in] args_cnt argument count
+ * @param[in] args argument list
+ * @param[in] task_name task's name
+ */
+uint64_t task_create_task_with_default_heap(memory_heap_t* heap, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name);
+
 /**
  * @brief idle task checks if there is any task neeeds to run. it speeds up task running
  */
@@ -0,0 +1,72 @@
+/**
+ * @file task_sleep_queue.h
+ * @brief sleep queue of scheduler, sleeping tasks ordered by wake tick
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+#ifndef ___CPU_TASK_SLEEP_QUEUE_H
+/*! prevent duplicate header error macro */
+#define ___CPU_TASK_SLEEP_QUEUE_H 0
+
+#include <types.h>
+#include <memory.h>
+
+/*! sleep queue type, a min heap of tasks keyed by wake tick */
+typedef struct task_sleep_queue_t task_sleep_queue_t;
+
+/**
+ * @brief creates sleep queue
+ * @param[in] heap heap of queue, queue grows at task switch so it should not be a task heap
+ * @param[in] capacity initial capacity
+ * @return sleep queue
+ */
+task_sleep_queue_t* task_sleep_queue_create(memory_heap_t* heap, uint64_t capacity);
+
+/**
+ * @brief destroys sleep queue, tasks at queue are not touched
+ * @param[in] queue sleep queue
+ */
+void task_sleep_queue_destroy(task_sleep_queue_t* queue);
+
+/**
+ * @brief returns sleeping task count
+ * @param[in] queue sleep queue
+ * @return task count
+ */
+uint64_t task_sleep_queue_size(const task_sleep_queue_t* queue);
+
+/**
+ * @brief adds a task
+ * @param[in] queue sleep queue
+ * @param[in] task task
+ * @param[in] wake_tick tick when task wakes up
+ * @return false if queue cannot grow
+ */
+boolean_t task_sleep_queue_push(task_sleep_queue_t* queue, void* task, uint64_t wake_tick);
+
+/**
+ * @brief returns wake tick of earliest task
+ * @param[in] queue sleep queue
+ * @return wake tick, -1 if queue is empty
+ */
+uint64_t task_sleep_queue_peek_wake_tick(const task_sleep_queue_t* queue);
+
+/**
+ * @brief removes earliest task
+ * @param[in] queue sleep queue
+ * @return task, NULL if queue is empty
+ */
+void* task_sleep_queue_pop(task_sleep_queue_t* queue);
+
+/**
+ * @brief removes a task before its wake tick, such as a killed task
+ * @details task is searched linearly, it is for rare removals. earliest task is removed with
+ * @ref task_sleep_queue_pop
+ * @param[in] queue sleep queue
+ * @param[in] task task
+ * @return true if task was at queue
+ */
+boolean_t task_sleep_queue_remove(task_sleep_queue_t* queue, const void* task);
+
+#endif
@@ -179,6 +179,11 @@ typedef struct network_e1000_tx_desc_s {
     volatile uint16_t special;
 } __attribute__((packed)) network_e1000_tx_desc_t;
 
+#define NETWORK_E1000_TX_CMD_EOP  (1 << 0)
+#define NETWORK_E1000_TX_CMD_IFCS (1 << 1)
+#define NETWORK_E1000_TX_CMD_RS   (1 << 3)
+#define NETWORK_E1000_TX_STA_DD   (1 << 0)
+
 typedef struct {
     const pci_dev_t*      pci_netdev;
     network_mac_address_t mac;
@@ -193,9 +198,11 @@ typedef struct {
 
     volatile network_e1000_rx_desc_t* rx_desc; // receive descriptor buffer
     volatile uint16_t                 rx_tail;
+    network_buffer_t**                rx_buffers; // network buffers posted at rx descriptors
 
     volatile network_e1000_tx_desc_t* tx_desc; // transmit descriptor buffer
     volatile uint16_t                 tx_tail;
+    network_buffer_t**                tx_buffers; // network buffers in flight at tx descriptors
 }network_e1000_dev_t;
 
 int8_t network_e1000_init(const pci_dev_t* pci_netdev);
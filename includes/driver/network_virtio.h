@@ -128,9 +128,11 @@ typedef struct  {
 #define VIRTIO_NETWORK_IOPORT_MAX_VQ_COUNT    0x20
 #define VIRTIO_NETWORK_IOPORT_MTU             0x22
 
-#define VIRTIO_NETWORK_QUEUE_ITEM_LENGTH        16448
+#define VIRTIO_NETWORK_QUEUE_ITEM_LENGTH        sizeof(virtio_network_header_t) ///< rx/tx descriptors point to network buffers
 #define VIRTIO_NETWORK_CTRL_QUEUE_ITEM_LENGTH      16
 
+#define NETWORK_VIRTIO_RX_POLL_BUDGET            64 ///< max packets handled at one rx poll before yielding
+
 #define VIRTIO_NETWORK_CTRL_NOTF_COALESCE           6
 #define VIRTIO_NETWORK_CTRL_NOTF_COALESCE_TX_SET    0
 #define VIRTIO_NETWORK_CTRL_NOTF_COALESCE_RX_SET    1
@@ -455,6 +455,36 @@ typedef enum nvme_cmd_status_t {
 } nvme_cmd_status_t; ///< shorthand for enum
 
 
+/*! maximum io queue depth, controller limit mqes may lower it */
+#define NVME_IO_QUEUE_SIZE 256
+/*! maximum io queue pair count, one pair per cpu */
+#define NVME_IO_QUEUE_MAX_COUNT 64
+
+/**
+ * @struct nvme_io_queue_t
+ * @brief io submission/completion queue pair of a cpu, completions are signaled with queue's own msix vector
+ */
+typedef struct nvme_io_queue_t {
+    struct nvme_disk_t*            nvme_disk; ///< owner disk
+    uint16_t                       queue_id; ///< queue id of both submission and completion queue
+    uint16_t                       msix_vector; ///< msix vector of completion queue
+    uint32_t                       apic_id; ///< local apic id of cpu which completion interrupts are steered to
+    uint64_t                       isr; ///< isr number of completion queue
+    volatile uint64_t              lock_value; ///< spin lock of queue, taken with interrupts disabled
+    uint64_t                       s_queue_tail; ///< submission queue tail
+    uint64_t                       c_queue_head; ///< completion queue head
+    uint32_t*                      submission_queue_tail_doorbell; ///< submission queue tail doorbell
+    uint32_t*                      completion_queue_head_doorbell; ///< completion queue head doorbell
+    nvme_submission_queue_entry_t* submission_queue; ///< submission queue
+    nvme_completion_queue_entry_t* completion_queue; ///< completion queue
+    uint64_t                       submission_queue_fa; ///< submission queue frame address
+    uint64_t                       completion_queue_fa; ///< completion queue frame address
+    uint64_t                       prp_frame_fa; ///< prp list frames, one frame per cid
+    lock_t**                       command_locks; ///< future locks of active commands indexed by cid
+    uint16_t*                      free_cids; ///< stack of free cids
+    uint64_t                       free_cid_count; ///< free cid count
+    boolean_t                      current_phase; ///< current phase
+} nvme_io_queue_t; ///< shorthand for struct
 
 typedef struct nvme_disk_t {
     memory_heap_t*                 heap; ///< heap to allocate memory from
@@ -469,13 +499,9 @@ typedef struct nvme_disk_t {
     uint32_t*                      admin_completion_queue_head_doorbell; ///< admin completion queue head doorbell
     nvme_submission_queue_entry_t* admin_submission_queue; ///< admin submission queue
     nvme_completion_queue_entry_t* admin_completion_queue; ///< admin completion queue
-    int64_t                        io_queue_size; ///< io queue size
-    uint64_t                       io_s_queue_tail; ///< io queue tail
-    uint64_t                       io_c_queue_head; ///< io completion queue head
-    uint32_t*                      io_submission_queue_tail_doorbell; ///< io submission queue tail doorbell
-    uint32_t*                      io_completion_queue_head_doorbell; ///< io completion queue head doorbell
-    nvme_submission_queue_entry_t* io_submission_queue; ///< io submission queue
-    nvme_completion_queue_entry_t* io_completion_queue; ///< io completion queue
+    uint64_t                       io_queue_size; ///< depth of each io queue
+    uint16_t                       io_queue_count; ///< io queue pair count
+    nvme_io_queue_t*               io_queues; ///< io queue pairs, cpu with apic id i uses queue i % io_queue_count
     nvme_identify_t*               identify; ///< identify
     nvme_ns_identify_t*            ns_identify; ///< namespace identify
     uint32_t*                      active_ns_list; ///< active namespace list
@@ -483,17 +509,11 @@ typedef struct nvme_disk_t {
     uint32_t                       ns_id; ///< namespace id
     uint64_t                       lba_count; ///< lba count
     uint32_t                       lba_size; ///< lba size
-    uint16_t                       next_cid; ///< next command id
+    uint16_t                       next_cid; ///< next admin command id
     boolean_t                      flush_supported; ///< flush supported
-    uint16_t                       io_sq_count; ///< io submission queue count
-    uint16_t                       io_cq_count; ///< io completion queue count
-    uint64_t                       io_queue_isr; ///< io queue isr
-    hashmap_t*                     command_lock_map; ///< command lock map
-    uint64_t                       prp_frame_fa; ///< prp frame fa
-    uint64_t                       prp_frame_va; ///< prp frame va
+    uint16_t                       io_sq_count; ///< io submission queue count allocated by controller, zero based
+    uint16_t                       io_cq_count; ///< io completion queue count allocated by controller, zero based
     uint64_t                       max_prp_entries; ///< max prp entries
-    int64_t                        active_command_count; ///< active command count
-    boolean_t                      current_phase; ///< current phase
 } nvme_disk_t; ///< shorthand for struct
 
 
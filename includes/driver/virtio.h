@@ -110,25 +110,6 @@ typedef void * virtio_queue_t;
 
  */
 
-/*
-   static inline int8_t virtio_queue_need_event(uint16_t event_idx, uint16_t new_idx, uint16_t old_idx)
-   {
-   return (uint16_t)(new_idx - event_idx - 1) < (uint16_t)(new_idx - old_idx);
-   }
-
-   // Get location of event indices (only with VIRTIO_F_EVENT_IDX)
-   static inline uint16_t* virtio_queue_used_event(virtio_queue_t* vq)
-   {
-   return &vq->avail->ring[vq->num];
-   }
-
-   // Get location of event indices (only with VIRTIO_F_EVENT_IDX)
-   static inline uint16_t* virtio_queue_avail_event(virtio_queue_t* vq)
-   {
-   return (uint16_t*)&vq->used->ring[vq->num];
-   }
- */
-
 #define VIRTIO_QUEUE_RING_EVENT_FLAGS_ENABLE  0x0
 #define VIRTIO_QUEUE_RING_EVENT_FLAGS_DISABLE 0x1
 #define VIRTIO_QUEUE_RING_EVENT_FLAGS_DESC    0x2
@@ -209,6 +190,7 @@ typedef struct {
     virtio_queue_t              vq;
     uint16_t                    last_used_index;
     virtio_notification_data_t* nd;
+    void**                      item_buffers; ///< driver buffers posted at descriptors, indexed by descriptor id
 }virtio_queue_ext_t;
 
 typedef struct {
@@ -281,12 +263,51 @@ static inline virtio_queue_used_t* virtio_queue_get_used(virtio_dev_t* vdev, vir
     return (virtio_queue_used_t*)(((uint8_t*)queue) + vdev->queue_used_offset);
 }
 
+/* used_event field after avail ring, only with VIRTIO_F_EVENT_IDX */
+static inline volatile uint16_t* virtio_queue_get_used_event(virtio_dev_t* vdev, virtio_queue_t queue){
+    return (volatile uint16_t*)(((uint8_t*)virtio_queue_get_avail(vdev, queue)) + sizeof(uint16_t) * (2 + vdev->queue_size));
+}
+
+/* avail_event field after used ring, only with VIRTIO_F_EVENT_IDX */
+static inline volatile uint16_t* virtio_queue_get_avail_event(virtio_dev_t* vdev, virtio_queue_t queue){
+    return (volatile uint16_t*)(((uint8_t*)virtio_queue_get_used(vdev, queue)) + sizeof(uint16_t) * 2 + sizeof(virtio_queue_used_element_t) * vdev->queue_size);
+}
+
+/* true if index moved from old_idx to new_idx passes event_idx */
+static inline boolean_t virtio_queue_need_event(uint16_t event_idx, uint16_t new_idx, uint16_t old_idx){
+    return (uint16_t)(new_idx - event_idx - 1) < (uint16_t)(new_idx - old_idx);
+}
+
 typedef int8_t (* virtio_queue_item_builder_f)(virtio_dev_t* vdev, void* queue_item);
 
 int8_t virtio_create_queue(virtio_dev_t* vdev, uint16_t queue_no, uint64_t queue_item_size, boolean_t write, boolean_t iter_rw, virtio_queue_item_builder_f item_builder, interrupt_irq modern, interrupt_irq legacy);
 
 virtio_dev_t* virtio_get_device(const pci_dev_t* pci_dev);
 
+/**
+ * @brief publishes avail ring entries up to new_avail_index with one index update and notifies device if it wants
+ * @param[in] vdev virtio device
+ * @param[in] queue_no queue number
+ * @param[in] new_avail_index avail index after entries written to avail ring
+ * @return true if device is notified
+ */
+boolean_t virtio_queue_kick(virtio_dev_t* vdev, uint16_t queue_no, uint16_t new_avail_index);
+
+/**
+ * @brief asks device not to interrupt for used ring updates of queue
+ * @param[in] vdev virtio device
+ * @param[in] queue_no queue number
+ */
+void virtio_queue_disable_interrupts(virtio_dev_t* vdev, uint16_t queue_no);
+
+/**
+ * @brief asks device to interrupt for next used ring update of queue
+ * @param[in] vdev virtio device
+ * @param[in] queue_no queue number
+ * @return true if used ring has entries which are not processed, caller should poll again
+ */
+boolean_t virtio_queue_enable_interrupts(virtio_dev_t* vdev, uint16_t queue_no);
+
 typedef uint64_t (* virtio_select_features_f)(virtio_dev_t* vdev, uint64_t avail_features);
 typedef int8_t   (* virtio_create_queues_f)(virtio_dev_t* vdev);
 
@@ -38,6 +38,7 @@ typedef int8_t (*hashmap_key_comparator_f)(const void* item1, const void* item2)
 
 /**
  * @brief create hashmap with key generator and key comparator
+ * @details readers do not lock, tables moved by resize are reclaimed when readers which may see them are gone.
  * @param[in] capacity capacity of hashmap
  * @param[in] hkg key generator function
  * @param[in] hkc key comparator function
@@ -45,6 +46,26 @@ typedef int8_t (*hashmap_key_comparator_f)(const void* item1, const void* item2)
  */
 hashmap_t* hashmap_new_with_hkg_with_hkc(uint64_t capacity, hashmap_key_generator_f hkg, hashmap_key_comparator_f hkc);
 
+/**
+ * @brief create concurrent hashmap with key generator and key comparator
+ * @details readers of concurrent hashmap do not lock, they validate probed groups with versions and retry when a
+ * writer changes them. writers still serialize with map lock. tables moved by resize and data given to
+ * @ref hashmap_retire are reclaimed when readers which may see them are gone. iterators are readers too, they
+ * walk tables seen at creation, hence items moved by a resize during iteration may be skipped.
+ * @param[in] capacity capacity of hashmap
+ * @param[in] hkg key generator function
+ * @param[in] hkc key comparator function
+ * @return hashmap
+ */
+hashmap_t* hashmap_new_concurrent_with_hkg_with_hkc(uint64_t capacity, hashmap_key_generator_f hkg, hashmap_key_comparator_f hkc);
+
+/**
+ * @brief create concurrent hashmap, uses default key generator and key comparator
+ * @param[in] c capacity of hashmap
+ * @return hashmap
+ */
+#define hashmap_new_concurrent(c) hashmap_new_concurrent_with_hkg_with_hkc(c, NULL, NULL)
+
 /**
  * @brief create hashmap with key generator, uses default key comparator
  * @param[in] c capacity of hashmap
@@ -82,6 +103,20 @@ hashmap_t* hashmap_string(uint64_t capacity);
  */
 #define hashmap_integer(c) hashmap_new(c)
 
+/**
+ * @brief create concurrent hashmap with string key, uses string key generator and key comparator
+ * @param[in] capacity capacity of hashmap
+ * @return hashmap
+ */
+hashmap_t* hashmap_string_concurrent(uint64_t capacity);
+
+/**
+ * @brief create concurrent hashmap with integer key, uses integer key generator and key comparator
+ * @param[in] c capacity of hashmap
+ * @return hashmap
+ */
+#define hashmap_integer_concurrent(c) hashmap_new_concurrent(c)
+
 /**
  * @brief destroy hashmap
  * @param[in] hm hashmap to destroy
@@ -130,6 +165,24 @@ boolean_t hashmap_exists(hashmap_t* hm, const void* key);
  */
 boolean_t hashmap_delete(hashmap_t* hm, const void* key);
 
+/**
+ * @typedef hashmap_reclaimer_f
+ * @param[in] data retired data
+ * @brief reclaimer of data retired from hashmap
+ */
+typedef void (*hashmap_reclaimer_f)(void* data);
+
+/**
+ * @brief retires data removed from hashmap, such as a deleted key or value
+ * @details for concurrent hashmap reclaimer is called after readers which may still see data are gone, for other
+ * hashmaps it is called immediately.
+ * @param[in] hm hashmap which data is removed from
+ * @param[in] data retired data
+ * @param[in] reclaimer reclaimer of data
+ * @return true if data is retired
+ */
+boolean_t hashmap_retire(hashmap_t* hm, void* data, hashmap_reclaimer_f reclaimer);
+
 /**
  * @brief get size of hashmap
  * @param[in] hm hashmap to get size
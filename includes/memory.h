@@ -110,6 +110,66 @@ __attribute__ ((malloc, malloc (memory_free_ext, 2))) void* memory_malloc_ext(me
 /*! malloc with size s at default heap with aligned a */
 #define memory_malloc_aligned(s, a) memory_malloc_ext(NULL, s, a)
 
+/*! largest allocation size served by per cpu magazines */
+#define MEMORY_MAGAZINE_OBJECT_MAX_SIZE 1024
+
+/**
+ * @struct memory_magazine_stat_t
+ * @brief per cpu magazine statistics, summed over all cpus
+ */
+typedef struct memory_magazine_stat_t {
+    uint64_t hit_count; ///< allocations served from magazines
+    uint64_t refill_count; ///< batch refills from slabs
+    uint64_t flush_count; ///< batch flushes to slabs
+    uint64_t remote_free_count; ///< frees from a cpu other than slab owner
+    uint64_t slab_count; ///< total slab count at reserved area
+    uint64_t free_slab_count; ///< slabs not owned by any cpu
+} memory_magazine_stat_t; ///< short hand for struct
+
+/*! returns current cpu id, it should be less than 256 */
+typedef uint32_t (*memory_magazine_cpu_id_getter_f)(void);
+
+/**
+ * @brief enables per cpu magazine front end of default heap for small allocations
+ * @param[in] reserve_size size reserved from default heap for slabs
+ * @param[in] cpu_id_getter current cpu id getter, NULL means single cpu
+ * @return 0 on success
+ *
+ * allocations up to MEMORY_MAGAZINE_OBJECT_MAX_SIZE with at most 16 bytes alignment are served
+ * without taking default heap lock. when reserved area is exhausted default heap is used.
+ */
+int8_t memory_magazine_enable(uint64_t reserve_size, memory_magazine_cpu_id_getter_f cpu_id_getter);
+
+/**
+ * @brief disables magazines and returns reserved area to default heap
+ * @return 0 on success, -1 if there are allocated objects at magazine slabs
+ *
+ * it should be called when no other cpu uses default heap.
+ */
+int8_t memory_magazine_disable(void);
+
+/**
+ * @brief allocates from current cpu's magazine
+ * @param[in] size allocation size
+ * @param[in] align allocation alignment
+ * @return zeroed memory or NULL if caller should use default heap
+ */
+void* memory_magazine_malloc(size_t size, size_t align);
+
+/**
+ * @brief frees memory allocated from magazines
+ * @param[in] address address to free
+ * @return 0 on success, -1 if address is not from magazines, 1 if address is at magazines but it is not an
+ * allocated object such as a double free
+ */
+int8_t memory_magazine_free(void* address);
+
+/**
+ * @brief returns magazine statistics
+ * @param[out] stat statistics
+ */
+void memory_magazine_get_stat(memory_magazine_stat_t* stat);
+
 /**
  * @brief sets memory with value
  * @param[in]  address the address to be setted.
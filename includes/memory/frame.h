@@ -16,6 +16,17 @@
 /*! frame size (4K) */
 #define FRAME_SIZE 4096
 
+/*! max buddy order of frame allocator, largest block is 1 GiB */
+#define FRAME_ALLOCATOR_BUDDY_MAX_ORDER 18
+/*! buddy order count */
+#define FRAME_ALLOCATOR_BUDDY_ORDER_COUNT (FRAME_ALLOCATOR_BUDDY_MAX_ORDER + 1)
+/*! single frame count kept at each cpu cache */
+#define FRAME_ALLOCATOR_CPU_CACHE_SIZE 64
+/*! frame count moved between cpu cache and buddy at once */
+#define FRAME_ALLOCATOR_CPU_CACHE_BATCH_SIZE 32
+/*! max cpu count of frame allocator cpu caches, indexed by local apic id */
+#define FRAME_ALLOCATOR_MAX_CPU_COUNT 256
+
 /*! frame attribure for reserved frames before relinked start */
 #define FRAME_ATTRIBUTE_OLD_RESERVED           0x0000000100000000
 /*! frame attribure for acpi reclaim memory */
@@ -184,6 +195,27 @@ void frame_allocator_print(frame_allocator_t* fa);
  */
 void frame_allocator_map_page_of_acpi_code_data_frames(frame_allocator_t * fa);
 
+/*! cpu id getter of frame allocator cpu caches */
+typedef uint32_t (*frame_allocator_cpu_id_getter_f)(void);
+
+/**
+ * @brief enables per cpu single frame caches
+ * @param[in] fa frame allocator
+ * @param[in] cpu_id_getter returns current cpu id, should be less than @ref FRAME_ALLOCATOR_MAX_CPU_COUNT
+ * @return 0 if succeed
+ *
+ * single frame allocations and releases are served from cache of current cpu without frame allocator lock,
+ * caches are refilled from and drained to buddy with batches.
+ */
+int8_t frame_allocator_enable_cpu_cache(frame_allocator_t* fa, frame_allocator_cpu_id_getter_f cpu_id_getter);
+
+/**
+ * @brief destroys frame allocator and its internal structures, returned frames of allocations are not freed
+ * @param[in] fa frame allocator
+ * @return 0 if succeed
+ */
+int8_t frame_allocator_destroy(frame_allocator_t* fa);
+
 frame_allocator_t* frame_get_allocator(void);
 void               frame_set_allocator(frame_allocator_t* fa);
 
@@ -70,6 +70,15 @@ typedef enum memory_paging_internal_frame_init_state_t {
     MEMORY_PAGING_INTERNAL_FRAME_INIT_STATE_INITIALIZED = 2,
 } memory_paging_internal_frame_init_state_t;
 
+/*! cpu mask size of page table context, in 64 bit words, covers 256 local apic ids */
+#define MEMORY_PAGING_CPU_MASK_SIZE 4
+/*! max page count invalidated with invlpg, above it whole tlb is flushed */
+#define MEMORY_PAGING_TLB_INVALIDATE_MAX_PAGE_COUNT 32
+/*! max pcid value */
+#define MEMORY_PAGING_PCID_MAX 0xFFF
+/*! cr3 bit for not flushing tlb entries of pcid while loading */
+#define MEMORY_PAGING_CR3_NO_FLUSH (1ULL << 63)
+
 typedef struct memory_page_table_context_t {
     memory_page_table_t *                     page_table; ///< page table
     memory_paging_internal_frame_init_state_t internal_frame_init_state; ///< internal frame init state
@@ -79,6 +88,9 @@ typedef struct memory_page_table_context_t {
     uint64_t                                  internal_frames_2_start; ///< internal frames type 2
     uint64_t                                  internal_frames_2_count; ///< internal frames type 2 count
     uint64_t                                  internal_frames_helper_frame; ///< internal frames helper frame
+    uint64_t                                  pcid; ///< process context identifier of table, 0 if not assigned
+    volatile uint64_t                         cpu_mask[MEMORY_PAGING_CPU_MASK_SIZE]; ///< local apic ids which loaded the table
+    volatile uint64_t                         flush_mask[MEMORY_PAGING_CPU_MASK_SIZE]; ///< local apic ids which should flush pcid at next load
 } memory_page_table_context_t; ///< short hand for struct
 
 
@@ -196,7 +208,58 @@ int8_t memory_paging_add_va_for_frame_ext(memory_page_table_context_t* table_con
 #define memory_paging_add_va_for_frame(vas, f, t) memory_paging_add_va_for_frame_ext(NULL, vas, f, t)
 
 int8_t memory_paging_delete_va_for_frame_ext(memory_page_table_context_t* table_context, uint64_t va_start, frame_t* frm);
-#define memory_paging_delete_va_for_frame(vas, f) memory_paging_add_va_for_frame_ext(NULL, vas, f)
+#define memory_paging_delete_va_for_frame(vas, f) memory_paging_delete_va_for_frame_ext(NULL, vas, f)
+
+/**
+ * @brief tlb shootdown handler signature
+ * @param[in] table_context page table context whose entries are changed
+ * @param[in] virtual_address start virtual address of changed range
+ * @param[in] page_count 4k page count of changed range, 0 for whole table
+ * @return 0 if all cpus which loaded the table invalidated the range
+ */
+typedef int8_t (*memory_paging_tlb_shootdown_f)(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t page_count);
+
+/**
+ * @brief sets tlb shootdown handler, smp sets it for sending invalidation ipis to other cpus
+ * @param[in] handler shootdown handler, NULL invalidates only local cpu
+ */
+void memory_paging_set_tlb_shootdown_handler(memory_paging_tlb_shootdown_f handler);
+
+/**
+ * @brief invalidates range at current cpu
+ * @param[in] table_context page table context whose entries are changed
+ * @param[in] virtual_address start virtual address of changed range
+ * @param[in] page_count 4k page count of changed range, 0 for whole table
+ * @param[in] apic_id local apic id of current cpu
+ *
+ * if table is not the current one, its pcid is marked for flushing at next load.
+ */
+void memory_paging_tlb_invalidate_local(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t page_count, uint8_t apic_id);
+
+/**
+ * @brief builds cr3 value for loading table at cpu, marks cpu as user of the table
+ * @param[in] table_context page table context to load
+ * @param[in] apic_id local apic id of cpu which will load the table
+ * @return cr3 value with pcid and no flush bit if pcid is enabled
+ */
+uint64_t memory_paging_get_cr3_for_cpu(memory_page_table_context_t* table_context, uint8_t apic_id);
+
+/**
+ * @brief marks cpu as not user of the table, cpu switches to another table
+ * @param[in] table_context page table context which cpu leaves
+ * @param[in] apic_id local apic id of cpu
+ *
+ * tlb shootdowns of the table do not interrupt the cpu anymore, they mark its pcid for flushing at next load.
+ */
+void memory_paging_leave_table_for_cpu(memory_page_table_context_t* table_context, uint8_t apic_id);
+
+/**
+ * @brief enables pcid at current cpu if supported
+ * @return 0 if enabled
+ *
+ * should be called before smp initialization, aps copy cr4 of bsp.
+ */
+int8_t memory_paging_enable_pcid(void);
 
 memory_page_table_context_t* memory_paging_build_empty_table(uint64_t internal_frame_address);
 int8_t                       memory_paging_reserve_current_page_table_frames(void);
@@ -11,6 +11,7 @@
 
 #include <types.h>
 #include <list.h>
+#include <network/network_buffer.h>
 
 #define NETWORK_DEVICE_VENDOR_ID_VIRTIO  0x1AF4
 #define NETWORK_DEVICE_DEVICE_ID_VIRTNET1 0x1000
@@ -23,23 +24,21 @@ typedef enum network_type_t {
     NETWORK_TYPE_ETHERNET=0
 } network_type_t;
 
+/**
+ * @struct network_received_packet_t
+ * @brief received frame, buffer holds a reference which is released after processing.
+ *
+ * transmit queues and protocol return lists carry network_buffer_t pointers directly.
+ */
 typedef struct network_received_packet_t {
-    uint64_t       packet_len;
-    uint8_t*       packet_data;
-    list_t*        return_queue;
-    network_type_t network_type;
-    void*          network_info;
+    network_buffer_t* buffer;
+    list_t*           return_queue;
+    network_type_t    network_type;
+    void*             network_info;
 } network_received_packet_t;
 
-typedef struct network_transmit_packet_t {
-    uint64_t packet_len;
-    uint8_t* packet_data;
-} network_transmit_packet_t;
-
 extern list_t* network_received_packets;
 
-int8_t network_transmit_packet_destroyer(memory_heap_t* heap, void* data);
-
 int8_t network_init(void);
 
 #endif
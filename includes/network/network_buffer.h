@@ -0,0 +1,146 @@
+/**
+ * @file network_buffer.h
+ * @brief Network packet buffer pool header.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#ifndef ___NETWORK_BUFFER_H
+#define ___NETWORK_BUFFER_H 0
+
+#include <types.h>
+#include <memory.h>
+
+/*! pool slab size, a full ethernet frame fits after headroom */
+#define NETWORK_BUFFER_SIZE            2048
+/*! space reserved before packet data for prepending driver and protocol headers */
+#define NETWORK_BUFFER_HEADROOM        128
+/*! count of buffers added to pool when free list is empty */
+#define NETWORK_BUFFER_POOL_GROW_COUNT 256
+/*! upper limit of pool buffer count */
+#define NETWORK_BUFFER_POOL_MAX_COUNT  16384
+
+typedef struct network_buffer_t network_buffer_t;
+
+/**
+ * @struct network_buffer_t
+ * @brief refcounted packet buffer, data lives between head + offset and head + offset + length.
+ *
+ * pool buffers are inside reserved frames hence head_fa can be given to devices directly.
+ * buffers larger than pool slab (reassembled ipv4 packets) are heap backed and their head_fa is zero.
+ */
+struct network_buffer_t {
+    network_buffer_t* next; ///< free list link
+    uint8_t*          head; ///< buffer start
+    uint64_t          head_fa; ///< physical address of buffer start, zero for heap backed buffers
+    uint32_t          size; ///< buffer size
+    uint32_t          offset; ///< data start inside buffer
+    uint32_t          length; ///< data length
+    volatile uint32_t ref_count; ///< reference count, buffer returns to pool when it drops to zero
+};
+
+/**
+ * @brief initializes buffer pool with one grow step
+ * @return 0 on success
+ */
+int8_t network_buffer_pool_init(void);
+
+/**
+ * @brief returns free buffer count of pool
+ * @return free buffer count
+ */
+uint64_t network_buffer_pool_get_free_count(void);
+
+/**
+ * @brief allocates an empty buffer which can hold given length after headroom
+ * @param[in] length data capacity
+ * @return buffer with one reference, NULL on failure
+ */
+network_buffer_t* network_buffer_alloc(uint32_t length);
+
+/**
+ * @brief allocates a buffer and copies data into it
+ * @param[in] data data to copy
+ * @param[in] length data length
+ * @return buffer with one reference, NULL on failure
+ */
+network_buffer_t* network_buffer_create_from_data(const uint8_t* data, uint32_t length);
+
+/**
+ * @brief returns a copy of buffer inside pool when buffer isnot device accessible. reference of buffer is moved.
+ * @param[in] nb buffer
+ * @return device accessible buffer, NULL on failure
+ */
+network_buffer_t* network_buffer_get_dma_buffer(network_buffer_t* nb);
+
+/**
+ * @brief adds a reference to buffer
+ * @param[in] nb buffer
+ * @return buffer
+ */
+network_buffer_t* network_buffer_retain(network_buffer_t* nb);
+
+/**
+ * @brief drops a reference of buffer, last reference returns buffer to pool
+ * @param[in] nb buffer
+ */
+void network_buffer_release(network_buffer_t* nb);
+
+/**
+ * @brief list destroyer for lists of buffers
+ * @param[in] heap unused
+ * @param[in] data buffer
+ * @return 0
+ */
+int8_t network_buffer_destroyer(memory_heap_t* heap, void* data);
+
+/**
+ * @brief prepends length bytes to data from headroom
+ * @param[in] nb buffer
+ * @param[in] length header length
+ * @return new data start, NULL if headroom is not enough
+ */
+uint8_t* network_buffer_push(network_buffer_t* nb, uint32_t length);
+
+/**
+ * @brief strips length bytes from data start
+ * @param[in] nb buffer
+ * @param[in] length header length
+ * @return new data start, NULL if data is shorter
+ */
+uint8_t* network_buffer_pull(network_buffer_t* nb, uint32_t length);
+
+/**
+ * @brief appends length bytes to data end
+ * @param[in] nb buffer
+ * @param[in] length appended length
+ * @return start of appended area, NULL if tailroom is not enough
+ */
+uint8_t* network_buffer_put(network_buffer_t* nb, uint32_t length);
+
+/**
+ * @brief shrinks data to length, used for stripping link layer padding
+ * @param[in] nb buffer
+ * @param[in] length new data length
+ * @return 0 on success, -1 if data is shorter
+ */
+int8_t network_buffer_trim(network_buffer_t* nb, uint32_t length);
+
+static inline uint8_t* network_buffer_get_data(const network_buffer_t* nb) {
+    return nb->head + nb->offset;
+}
+
+static inline uint64_t network_buffer_get_data_fa(const network_buffer_t* nb) {
+    return nb->head_fa + nb->offset;
+}
+
+static inline uint32_t network_buffer_get_headroom(const network_buffer_t* nb) {
+    return nb->offset;
+}
+
+static inline uint32_t network_buffer_get_tailroom(const network_buffer_t* nb) {
+    return nb->size - nb->offset - nb->length;
+}
+
+#endif
@@ -36,6 +36,6 @@ typedef struct network_icmpv4_ping_header_t {
     uint32_t                timestamp_usec;
 }__attribute__((packed)) network_icmpv4_ping_header_t;
 
-uint8_t* network_icmpv4_process_packet(network_icmpv4_header_t* recv_icmpv4_packet, void* network_info, uint16_t* return_packet_len);
+network_buffer_t* network_icmpv4_process_packet(network_buffer_t* recv_buffer, void* network_info);
 
 #endif
@@ -54,9 +54,9 @@ extern network_ipv4_address_t NETWORK_IPV4_GLOBAL_BROADCAST_IP;
 extern network_ipv4_address_t NETWORK_IPV4_ZERO_IP;
 
 boolean_t network_ipv4_is_address_eq(const network_ipv4_address_t ipv4_addr1, const network_ipv4_address_t ipv4_addr2);
-list_t*   network_ipv4_process_packet(network_ipv4_header_t* recv_ipv4_packet, void* network_info);
-list_t*   network_ipv4_create_packet_from_icmp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_icmpv4_header_t* icmp_hdr, uint16_t icmp_packet_len);
-list_t*   network_ipv4_create_packet_from_udp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_udpv4_header_t* udp_hdr);
-list_t*   network_ipv4_create_packet_from_tcp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_tcpv4_header_t* tcp_hdr, uint16_t packet_len);
+list_t*   network_ipv4_process_packet(network_buffer_t* recv_buffer, void* network_info);
+list_t*   network_ipv4_create_packet_from_icmp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_buffer_t* icmp_buffer);
+list_t*   network_ipv4_create_packet_from_udp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_buffer_t* udp_buffer);
+list_t*   network_ipv4_create_packet_from_tcp_packet(const network_ipv4_address_t sip, network_ipv4_address_t dip, network_buffer_t* tcp_buffer);
 
 #endif
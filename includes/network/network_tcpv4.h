@@ -69,6 +69,6 @@ typedef struct network_tcpv4_listener_t {
     hashmap_t*             connections;
 } network_tcpv4_listener_t;
 
-uint8_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_tcpv4_header_t* recv_tcpv4_packet, void* network_info, uint16_t packet_len, uint16_t* return_packet_len);
+network_buffer_t* network_tcpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_buffer_t* recv_buffer, void* network_info);
 
 #endif
@@ -24,7 +24,7 @@ typedef struct network_udpv4_header_t {
 }__attribute__((packed)) network_udpv4_header_t;
 
 
-uint8_t*                network_udpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_udpv4_header_t* recv_udpv4_packet, void* network_info, uint16_t* return_packet_len);
-network_udpv4_header_t* network_udpv4_create_packet_from_data(uint16_t sp, uint16_t dp, uint16_t len, uint8_t* data);
+network_buffer_t* network_udpv4_process_packet(network_ipv4_address_t dip, network_ipv4_address_t sip, network_buffer_t* recv_buffer, void* network_info);
+network_buffer_t* network_udpv4_create_packet_from_data(uint16_t sp, uint16_t dp, uint16_t len, uint8_t* data);
 
 #endif
@@ -0,0 +1,98 @@
+/**
+ * @file skiplist.h
+ * @brief concurrent skiplist indexer interface
+ *
+ * skiplist is insert only. inserts are lock free and can be done from many cpus while readers iterate.
+ * items are never unlinked until index is destroyed, replaced datas are returned to caller.
+ *
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+#ifndef ___SKIPLIST_H
+/*! prevent duplicate header error macro */
+#define ___SKIPLIST_H 0
+
+#include <types.h>
+#include <memory.h>
+#include <indexer.h>
+#include <iterator.h>
+
+/*! maximum tower height of skiplist nodes */
+#define SKIPLIST_MAX_LEVEL 24
+
+/**
+ * @brief creates skiplist index implementation
+ * @param[in]  heap          heap to use
+ * @param[in]  comparator    key comparator
+ * @param[in]  unique        if unique flag set insert replaces data of equal key
+ * @return               index interface
+ */
+index_t* skiplist_create_index_with_heap_and_unique(memory_heap_t* heap, index_key_comparator_f comparator, boolean_t unique);
+
+/**
+ * @brief creates skiplist index with default heap
+ * @param[in]  c   comparator
+ * @return     skiplist index
+ */
+#define skiplist_create_index(c) skiplist_create_index_with_heap_and_unique(NULL, c, false)
+
+/**
+ * @brief creates skiplist index with default heap
+ * @param[in]  c   comparator
+ * @param[in]  u unique flag
+ * @return     skiplist index
+ */
+#define skiplist_create_index_with_unique(c, u) skiplist_create_index_with_heap_and_unique(NULL, c, u)
+
+/**
+ * @brief inserts key with data order, data of equal key is replaced only if its order is not greater
+ * @details ordered and plain inserts should not be mixed at an index. if data of equal key has greater order, data is
+ * not inserted and it is returned as removed data, so concurrent writers of same key end with the greatest order.
+ * @param[in]  idx skiplist index
+ * @param[in]  key key to insert
+ * @param[in]  data data of key
+ * @param[in]  order data order
+ * @param[out] removed_data replaced data, or data itself if it is not inserted
+ * @return     0 if succeed
+ */
+int8_t skiplist_insert_with_order(index_t* idx, const void* key, const void* data, uint64_t order, void** removed_data);
+
+/**
+ * @brief destroys skiplist index, datas are not freed
+ * @param[in]  idx skiplist index
+ * @return     0 if succeed
+ */
+int8_t skiplist_destroy_index(index_t* idx);
+
+/**
+ * @brief sets comparator which identifies unique part of keys at non unique index.
+ * keys equal with index comparator and this comparator are replaced at insert.
+ * @param[in]  idx skiplist index
+ * @param[in]  comparator unique subpart comparator
+ * @return     0 if succeed
+ */
+int8_t skiplist_set_comparator_for_unique_subpart_for_non_unique_index(index_t* idx, index_key_comparator_f comparator);
+
+/*! key destroyer function type */
+typedef int8_t (*skiplist_key_destroyer_f)(memory_heap_t* heap, void* key);
+
+/**
+ * @brief sets key destroyer which is called for each key at destroy
+ * @param[in]  idx skiplist index
+ * @param[in]  destroyer key destroyer
+ * @return     0 if succeed
+ */
+int8_t skiplist_set_key_destroyer(index_t* idx, skiplist_key_destroyer_f destroyer);
+
+/*! key cloner function type */
+typedef int8_t (*skiplist_key_cloner_f)(memory_heap_t* heap, const void* key, void** cloned_key);
+
+/**
+ * @brief sets key cloner which is called for each new key at insert
+ * @param[in]  idx skiplist index
+ * @param[in]  cloner key cloner
+ * @return     0 if succeed
+ */
+int8_t skiplist_set_key_cloner(index_t* idx, skiplist_key_cloner_f cloner);
+
+#endif
@@ -88,6 +88,7 @@ typedef struct tosdb_cache_config_t {
     uint64_t index_data_size; ///< index data cache max size
     uint64_t secondary_index_data_size; ///< index data cache max size
     uint64_t valuelog_size; ///< value log cache max size
+    uint64_t block_size; ///< raw block cache max size, zero disables block cache
 } tosdb_cache_config_t; ///< shorthand for struct
 
 /**
@@ -98,6 +99,64 @@ typedef struct tosdb_cache_config_t {
  */
 boolean_t tosdb_cache_config_set(tosdb_t* tdb, tosdb_cache_config_t* config);
 
+/**
+ * @struct tosdb_block_cache_stats_t
+ * @brief raw block cache statistics
+ */
+typedef struct tosdb_block_cache_stats_t {
+    uint64_t hit_count; ///< block reads served from cache
+    uint64_t miss_count; ///< block reads served from backend
+} tosdb_block_cache_stats_t; ///< shorthand for struct
+
+/**
+ * @brief gets raw block cache statistics
+ * @param[in] tdb tosdb instance
+ * @param[out] stats block cache statistics
+ * @return true if block cache is enabled and stats are filled
+ */
+boolean_t tosdb_block_cache_get_stats(tosdb_t* tdb, tosdb_block_cache_stats_t* stats);
+
+/**
+ * @struct tosdb_wal_config_t
+ * @brief tosdb write ahead log config
+ */
+typedef struct tosdb_wal_config_t {
+    uint64_t group_commit_size; ///< maximum record count of one group commit, zero disables wal
+} tosdb_wal_config_t; ///< shorthand for struct
+
+/**
+ * @brief sets tosdb write ahead log config, pending records are committed before change
+ * @param[in] tdb tosdb instance
+ * @param[in] config tosdb wal config
+ * @return true if wal config can be setted
+ */
+boolean_t tosdb_wal_config_set(tosdb_t* tdb, tosdb_wal_config_t* config);
+
+/**
+ * @brief commits pending write ahead log records without waiting group to be filled
+ * @details writers already wait their groups, it is needed only for records logged by other tasks
+ * @param[in] tdb tosdb instance
+ * @return true if pending records are written and flushed to backend
+ */
+boolean_t tosdb_wal_commit(tosdb_t* tdb);
+
+/**
+ * @struct tosdb_wal_stats_t
+ * @brief write ahead log statistics
+ */
+typedef struct tosdb_wal_stats_t {
+    uint64_t first_sequence; ///< oldest wal block sequence which is replayed at open, older ones are checkpointed
+    uint64_t committed_sequence; ///< sequence of last committed wal block
+} tosdb_wal_stats_t; ///< shorthand for struct
+
+/**
+ * @brief gets write ahead log statistics
+ * @param[in] tdb tosdb instance
+ * @param[out] stats wal statistics
+ * @return true if stats are filled
+ */
+boolean_t tosdb_wal_get_stats(tosdb_t* tdb, tosdb_wal_stats_t* stats);
+
 /**
  * @enum tosdb_compaction_type_t
  * @brief tosdb compation types.
@@ -110,6 +169,24 @@ typedef enum tosdb_compaction_type_t {
 
 boolean_t tosdb_compact(tosdb_t* tdb, tosdb_compaction_type_t type);
 
+/**
+ * @struct tosdb_compaction_config_t
+ * @brief tosdb background compaction config, level 1 is the level where memtables are flushed
+ */
+typedef struct tosdb_compaction_config_t {
+    uint64_t level1_trigger_count; ///< level 1 sstable count which wakes background compaction, zero disables it
+    uint64_t level1_stall_count; ///< level 1 sstable count which stalls writers until compaction, zero disables stalls
+    uint64_t level_trigger_count; ///< sstable count of deeper levels which wakes background minor compaction
+} tosdb_compaction_config_t; ///< shorthand for struct
+
+/**
+ * @brief sets tosdb background compaction config
+ * @param[in] tdb tosdb instance
+ * @param[in] config tosdb compaction config
+ * @return true if compaction config can be setted
+ */
+boolean_t tosdb_compaction_config_set(tosdb_t* tdb, tosdb_compaction_config_t* config);
+
 /*! tosdb database struct type */
 typedef struct tosdb_database_t tosdb_database_t;
 
@@ -199,6 +276,29 @@ typedef enum tosdb_index_type_t {
  */
 boolean_t tosdb_table_index_create(tosdb_table_t* tbl, const char_t* colname, tosdb_index_type_t type);
 
+/**
+ * @brief creates an ordered index on table
+ * @details ordered index keeps keys sorted by their typed value instead of hash, hence range scans can be done over it.
+ * integer and float columns are ordered by value, string and bytearray columns are ordered lexicographically.
+ * @param[in] tbl table interface
+ * @param[in] colname index column name
+ * @param[in] type index type
+ * @return true if succeed.
+ */
+boolean_t tosdb_table_index_create_ordered(tosdb_table_t* tbl, const char_t* colname, tosdb_index_type_t type);
+
+/**
+ * @brief creates a covering secondary index on table
+ * @details values of covered columns are stored at index items, when an index covers all columns of table searches
+ * are answered from index data without reading record values. covered column ids should be less than 64.
+ * @param[in] tbl table interface
+ * @param[in] colname index column name
+ * @param[in] covered_colnames names of columns stored at index
+ * @param[in] covered_count covered column count
+ * @return true if succeed.
+ */
+boolean_t tosdb_table_index_create_covering(tosdb_table_t* tbl, const char_t* colname, const char_t** covered_colnames, uint64_t covered_count);
+
 /**
  * @brief closes a table
  * @param[in] tbl the table to close
@@ -215,6 +315,27 @@ boolean_t tosdb_table_close(tosdb_table_t* tbl);
  */
 boolean_t tosdb_table_free(tosdb_table_t* tbl);
 
+/**
+ * @struct tosdb_table_stats_t
+ * @brief sstable statistics of a table, used for observing compaction
+ */
+typedef struct tosdb_table_stats_t {
+    uint64_t sstable_count; ///< number of persisted sstables
+    uint64_t sstable_max_level; ///< deepest sstable level
+    uint64_t sstable_record_count; ///< total record count of sstables, shadowed and deleted records are included
+    uint64_t sstable_size; ///< total size of valuelog and index blocks of sstables
+    uint64_t backend_used_size; ///< used size of the backend by whole tosdb
+    uint64_t valuelog_chunk_unpack_count; ///< valuelog chunks unpacked by whole tosdb, cache hits are not counted
+} tosdb_table_stats_t;
+
+/**
+ * @brief fills sstable statistics of a table
+ * @param[in] tbl table
+ * @param[out] stats statistics
+ * @return true if succeed.
+ */
+boolean_t tosdb_table_get_stats(tosdb_table_t* tbl, tosdb_table_stats_t* stats);
+
 /*! tosdb record struct type */
 typedef struct tosdb_record_t tosdb_record_t;
 
@@ -595,5 +716,108 @@ tosdb_record_t* tosdb_table_create_record(tosdb_table_t* tbl);
  */
 set_t* tosdb_table_get_primary_keys(tosdb_table_t* tbl);
 
+/**
+ * @brief scans records between two keys of an ordered primary or unique index
+ * @details collects first limit records of @ref tosdb_record_range_scan_iterator, so scan stops reading sources
+ * when limit is reached. both records should contain only the same indexed key. results are sorted by key.
+ * @param[in] record_lo lower bound of the range, inclusive
+ * @param[in] record_hi upper bound of the range, inclusive
+ * @param[in] limit maximum record count to return, zero means no limit
+ * @return the record list
+ */
+list_t* tosdb_record_range_scan(tosdb_record_t* record_lo, tosdb_record_t* record_hi, uint64_t limit);
+
+/**
+ * @brief creates a lazy iterator over records between two keys of an ordered primary or unique index
+ * @details memtables and sstables are merged by key, newest version of a key wins and deleted records are skipped.
+ * sstables whose first and last keys are outside of range are not read. records are produced one by one while
+ * iterating, nothing is materialized up front.
+ * get_item returns a record owned by iterator, delete_item gives its ownership to caller and moves to next record.
+ * @param[in] record_lo lower bound of the range, inclusive
+ * @param[in] record_hi upper bound of the range, inclusive
+ * @return iterator of records
+ */
+iterator_t* tosdb_record_range_scan_iterator(tosdb_record_t* record_lo, tosdb_record_t* record_hi);
+
+/**
+ * @brief creates a lazy iterator over records which have the same key value with given record
+ * @details record should contain only one key. ownership semantics are same as range scan iterator.
+ * @param[in] record record with search key
+ * @return iterator of records
+ */
+iterator_t* tosdb_record_search_iterator(tosdb_record_t* record);
+
+/**
+ * @brief creates a lazy iterator over live primary keys of table
+ * @details records contain only primary key. ownership semantics are same as range scan iterator.
+ * @param[in] tbl table
+ * @return iterator of records
+ */
+iterator_t* tosdb_table_primary_key_iterator(tosdb_table_t* tbl);
+
+/**
+ * @brief gets many records of a table at once
+ * @details each record should contain only one key like get_record. memtables are probed per record,
+ * remaining keys are sorted and each sstable's bloom filter and index data are fetched once for all of them,
+ * values are read grouped by sstable with valuelog order.
+ * @param[in] tbl table
+ * @param[in] records records with search keys, found ones are populated
+ * @param[in] count record count
+ * @param[out] founds found flags of records, a deleted record is not found
+ * @return false on errors
+ */
+boolean_t tosdb_table_multi_get(tosdb_table_t* tbl, tosdb_record_t** records, uint64_t count, boolean_t* founds);
+
+/*! tosdb write batch struct type */
+typedef struct tosdb_write_batch_t tosdb_write_batch_t;
+
+/**
+ * @brief creates a write batch which collects upserts and deletes of tables of a tosdb instance
+ * @param[in] tdb tosdb instance
+ * @return write batch
+ */
+tosdb_write_batch_t* tosdb_write_batch_new(tosdb_t* tdb);
+
+/**
+ * @brief adds an upsert to the batch, batch owns the record and destroys it after commit
+ * @param[in] batch write batch
+ * @param[in] record record to upsert
+ * @return true if record is added
+ */
+boolean_t tosdb_write_batch_upsert(tosdb_write_batch_t* batch, tosdb_record_t* record);
+
+/**
+ * @brief adds a delete to the batch, batch owns the record and destroys it after commit
+ * @param[in] batch write batch
+ * @param[in] record record with a unique key
+ * @return true if record is added
+ */
+boolean_t tosdb_write_batch_delete(tosdb_write_batch_t* batch, tosdb_record_t* record);
+
+/**
+ * @brief returns operation count waiting at batch
+ * @param[in] batch write batch
+ * @return operation count
+ */
+uint64_t tosdb_write_batch_size(tosdb_write_batch_t* batch);
+
+/**
+ * @brief applies batch, all operations are logged in the same wal group
+ * @details all records are validated and serialized before anything is applied, if validation fails batch is untouched.
+ * operations of the same key are folded and only the last one is applied. locks of all tables are held at address
+ * order while batch is logged and applied, so other batches and writers are ordered entirely before or after it, lock free
+ * readers can see it partially applied. batch is empty and reusable after commit.
+ * @param[in] batch write batch
+ * @return true if all operations are applied
+ */
+boolean_t tosdb_write_batch_commit(tosdb_write_batch_t* batch);
+
+/**
+ * @brief destroys batch and records waiting at it without applying them
+ * @param[in] batch write batch
+ * @return true if succeed
+ */
+boolean_t tosdb_write_batch_destroy(tosdb_write_batch_t* batch);
+
  #endif
 
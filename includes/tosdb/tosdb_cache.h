@@ -32,6 +32,12 @@ typedef enum tosdb_cache_item_type_t {
  */
 typedef struct tosdb_memtable_index_item_t tosdb_memtable_index_item_t;
 
+/**
+ * @typedef tosdb_block_header_t
+ * @brief opaque tosdb block header
+ */
+typedef struct tosdb_block_header_t tosdb_block_header_t;
+
 /**
  * @typedef tosdb_memtable_secondary_index_item_t
  * @brief opaque tosdb memtable secondary index item
@@ -49,6 +55,7 @@ typedef struct tosdb_cache_key_t {
     uint64_t                index_id; ///< index id
     uint64_t                sstable_id; ///< sstable id
     uint64_t                level; ///< level
+    uint64_t                chunk_id; ///< chunk id for chunked items such as valuelog
     uint64_t                data_size; ///< data size
 } tosdb_cache_key_t; ///< tosdb cache key
 
@@ -94,10 +101,10 @@ typedef struct tosdb_cached_secondary_index_data_t {
  * @brief tosdb valuelog cache item
  */
 typedef struct tosdb_cached_valuelog_t {
-    tosdb_cache_key_t cache_key; ///< cache key
-    uint64_t          record_count; ///< record count at valuelog
-    buffer_t*         values; ///< values
-} tosdb_cached_valuelog_t; ///< tosdb valuelog cache item
+    tosdb_cache_key_t cache_key; ///< cache key, chunk_id is valuelog chunk index
+    uint64_t          chunk_size; ///< unpacked size of chunk
+    uint8_t*          chunk; ///< unpacked chunk data
+} tosdb_cached_valuelog_t; ///< tosdb valuelog chunk cache item
 
 /**
  * @typedef tosdb_cache_t
@@ -105,6 +112,18 @@ typedef struct tosdb_cached_valuelog_t {
  */
 typedef struct tosdb_cache_t tosdb_cache_t;
 
+/**
+ * @struct tosdb_cached_block_t
+ * @brief refcounted handle of a verified raw block, block data is shared and read only
+ */
+typedef struct tosdb_cached_block_t {
+    uint64_t              location; ///< block location at backend
+    uint64_t              size; ///< block size
+    uint64_t              ref_count; ///< reference count, cache holds one while block is cached
+    tosdb_cache_t*        cache; ///< owner cache, null if block was never cached
+    tosdb_block_header_t* block; ///< block data
+} tosdb_cached_block_t; ///< tosdb cached block
+
 /**
  * @brief creates new tosdb cache
  * @param config cache config
@@ -135,4 +154,27 @@ const tosdb_cache_key_t* tosdb_cache_get(tosdb_cache_t* cache, tosdb_cache_key_t
  */
 boolean_t tosdb_cache_put(tosdb_cache_t* cache, tosdb_cache_key_t* key);
 
+/**
+ * @brief gets a raw block from block cache and takes a reference
+ * @param cache tosdb cache
+ * @param location block location
+ * @param size block size
+ * @return cached block if it is at cache, NULL otherwise or if block cache is disabled
+ */
+tosdb_cached_block_t* tosdb_cache_block_get(tosdb_cache_t* cache, uint64_t location, uint64_t size);
+
+/**
+ * @brief puts a raw block to block cache, cache takes its own reference
+ * @param cache tosdb cache
+ * @param c_blk cached block, it stays uncached if another reader already put same block
+ * @return true if block is cached, false otherwise
+ */
+boolean_t tosdb_cache_block_put(tosdb_cache_t* cache, tosdb_cached_block_t* c_blk);
+
+/**
+ * @brief releases a reference of a raw block, block is freed with last reference
+ * @param c_blk cached block
+ */
+void tosdb_cache_block_release(tosdb_cached_block_t* c_blk);
+
 #endif
@@ -10,6 +10,7 @@
 #define ___TOSDB_TOSDB_INTERNAL_H 0
 
 #include <tosdb/tosdb.h>
+#include <tosdb/tosdb_cache.h>
 #include <future.h>
 #include <utils.h>
 #include <hashmap.h>
@@ -23,11 +24,16 @@
 
 #define TOSDB_PAGE_SIZE 4096
 #define TOSDB_SUPERBLOCK_SIGNATURE "TURNSTONE OS DB\0"
-#define TOSDB_VERSION_MAJOR 0
-#define TOSDB_VERSION_MINOR 1
+/*! major version 1 packs valuelogs as chunks and keeps blocked bloom filters at sstable indexes, blocks of other majors are rejected */
+#define TOSDB_VERSION_MAJOR 1
+#define TOSDB_VERSION_MINOR 0
 
 #define TOSDB_NAME_MAX_LEN 256
 
+#define TOSDB_COMPACTION_DEFAULT_LEVEL1_TRIGGER_COUNT 4
+#define TOSDB_COMPACTION_DEFAULT_LEVEL1_STALL_COUNT   16
+#define TOSDB_COMPACTION_DEFAULT_LEVEL_TRIGGER_COUNT  4
+
 typedef enum tosdb_block_type_t {
     TOSDB_BLOCK_TYPE_NONE,
     TOSDB_BLOCK_TYPE_SUPERBLOCK,
@@ -42,6 +48,7 @@ typedef enum tosdb_block_type_t {
     TOSDB_BLOCK_TYPE_SSTABLE_INDEX,
     TOSDB_BLOCK_TYPE_SSTABLE_INDEX_DATA,
     TOSDB_BLOCK_TYPE_VALUELOG,
+    TOSDB_BLOCK_TYPE_WAL,
 } tosdb_block_type_t;
 
 /**
@@ -76,6 +83,9 @@ typedef struct tosdb_superblock_t {
     uint64_t             database_list_size; ///< size of database list
     uint64_t             database_next_id; ///< next database id
     compression_type_t   compression_type; ///< compression type of block data
+    uint64_t             wal_location; ///< location of last committed wal block, zero if wal is empty
+    uint64_t             wal_size; ///< size of last committed wal block
+    uint64_t             wal_first_sequence; ///< oldest wal block sequence which is needed, older blocks are checkpointed
     uint8_t              reservedN[2048] __attribute__((aligned(2048))); ///< padding
 }__attribute__((packed, aligned(8))) tosdb_superblock_t; ///< tosdb super block
 
@@ -203,6 +213,8 @@ typedef struct tosdb_block_index_list_item_t {
     tosdb_index_type_t type : 16; ///< index type
     boolean_t          deleted; ///< index is deleted
     uint64_t           column_id; ///< column id
+    boolean_t          ordered; ///< index keys are ordered by value
+    uint64_t           covered_columns; ///< bitmask of column ids whose values are stored at secondary index items
 }__attribute__((packed, aligned(8))) tosdb_block_index_list_item_t; ///< tosdb index list item
 
 /**
@@ -218,19 +230,34 @@ typedef struct tosdb_block_index_list_t {
     tosdb_block_index_list_item_t indexes[]; ///< index list
 }__attribute__((packed, aligned(8))) tosdb_block_index_list_t; ///< tosdb index list
 
+/*! unpacked size of each independently compressed valuelog chunk */
+#define TOSDB_VALUELOG_CHUNK_SIZE (32 << 10)
+
+/**
+ * @struct tosdb_block_valuelog_chunk_t
+ * @brief tosdb valuelog chunk table entry
+ */
+typedef struct tosdb_block_valuelog_chunk_t {
+    uint64_t offset; ///< offset of packed chunk after chunk table
+    uint64_t packed_size; ///< packed size of chunk
+}__attribute__((packed, aligned(8))) tosdb_block_valuelog_chunk_t; ///< tosdb valuelog chunk
+
 /**
  * @struct tosdb_block_valuelog_t
  * @brief tosdb valuelog
- * @details value log is serialized from row data
+ * @details value log is serialized from row data, it is packed as chunks of @ref TOSDB_VALUELOG_CHUNK_SIZE
+ * hence a record can be read by unpacking only the chunks which it spans. packed chunks follow chunk table.
  */
 typedef struct tosdb_block_valuelog_t {
-    tosdb_block_header_t header; ///< block header
-    uint64_t             database_id; ///< database id of this value log
-    uint64_t             table_id; ///< table id of this value log
-    uint64_t             sstable_id; ///< sstable id of this value log
-    uint64_t             data_size; ///< size of data packed size (compressed size)
-    uint64_t             valuelog_unpacked_size; ///< size of unpacked data
-    uint8_t              data[]; ///< compressed data
+    tosdb_block_header_t         header; ///< block header
+    uint64_t                     database_id; ///< database id of this value log
+    uint64_t                     table_id; ///< table id of this value log
+    uint64_t                     sstable_id; ///< sstable id of this value log
+    uint64_t                     data_size; ///< size of data packed size (compressed size) of all chunks
+    uint64_t                     valuelog_unpacked_size; ///< size of unpacked data
+    uint64_t                     chunk_size; ///< unpacked size of chunks, last chunk may be smaller
+    uint64_t                     chunk_count; ///< chunk count
+    tosdb_block_valuelog_chunk_t chunks[]; ///< chunk table
 }__attribute__((packed, aligned(8))) tosdb_block_valuelog_t; ///< tosdb value log
 
 /**
@@ -309,30 +336,78 @@ typedef struct tosdb_block_sstable_index_data_t {
     uint8_t              data[]; ///< compressed data of index data
 }__attribute__((packed, aligned(8))) tosdb_block_sstable_index_data_t; ///< tosdb sstable index data
 
+/**
+ * @struct tosdb_block_wal_item_t
+ * @brief tosdb wal item
+ * @details wal item is one upsert or delete operation inside wal block, item size is aligned to 8 bytes
+ */
+typedef struct tosdb_block_wal_item_t {
+    uint64_t  database_id; ///< database id of the record
+    uint64_t  table_id; ///< table id of the record
+    uint64_t  max_record_count; ///< max record count of table, used when table is opened while replaying
+    uint64_t  max_valuelog_size; ///< max valuelog size of table, used when table is opened while replaying
+    uint64_t  max_memtable_count; ///< max memtable count of table, used when table is opened while replaying
+    uint128_t record_id; ///< record id
+    boolean_t is_deleted; ///< record is deleted
+    uint64_t  data_size; ///< size of serialized record data
+    uint8_t   data[]; ///< serialized record data
+}__attribute__((packed, aligned(8))) tosdb_block_wal_item_t; ///< tosdb wal item
+
+/**
+ * @struct tosdb_block_wal_t
+ * @brief tosdb wal
+ * @details wal block is a group commit of wal items, blocks are chained with previous block location
+ */
+typedef struct tosdb_block_wal_t {
+    tosdb_block_header_t header; ///< block header
+    uint64_t             sequence; ///< sequence number of the wal block
+    uint64_t             item_count; ///< number of items in this block @see tosdb_block_wal_item_t
+    uint64_t             data_size; ///< total size of items
+    uint8_t              data[]; ///< wal items
+}__attribute__((packed, aligned(8))) tosdb_block_wal_t; ///< tosdb wal
+
 /**
  * @typedef tosdb_cache_t
  * @brief opaque tosdb cache
  */
 typedef struct tosdb_cache_t tosdb_cache_t; ///< tosdb cache
 
+/**
+ * @typedef tosdb_wal_t
+ * @brief opaque tosdb wal
+ */
+typedef struct tosdb_wal_t tosdb_wal_t; ///< tosdb wal
+
 /**
  * @struct tosdb_t
  * @brief tosdb instance
  */
 struct tosdb_t {
-    tosdb_backend_t*     backend; ///< backend
-    tosdb_superblock_t*  superblock; ///< superblock
-    boolean_t            is_dirty; ///< is dirty
-    hashmap_t*           databases; ///< databases
-    hashmap_t*           database_new; ///< new databases
-    lock_t*              lock; ///< lock
-    tosdb_cache_t*       cache; ///< cache
-    const compression_t* compression; ///< compression
+    tosdb_backend_t*          backend; ///< backend
+    tosdb_superblock_t*       superblock; ///< superblock
+    boolean_t                 is_dirty; ///< is dirty
+    hashmap_t*                databases; ///< databases
+    hashmap_t*                database_new; ///< new databases
+    lock_t*                   lock; ///< lock
+    lock_t*                   block_lock; ///< serializes block space allocation and superblock writes
+    tosdb_cache_t*            cache; ///< cache
+    const compression_t*      compression; ///< compression
+    tosdb_wal_t*              wal; ///< write ahead log
+    tosdb_compaction_config_t compaction_config; ///< background compaction config
+    uint64_t                  compaction_task_id; ///< background compaction task id, zero if writers compact themselves
+    volatile boolean_t        compaction_task_stop; ///< background compaction task should not start new compactions
+    volatile boolean_t        compaction_task_end; ///< background compaction task should end
+    volatile boolean_t        compaction_task_busy; ///< background compaction task is compacting
+    volatile boolean_t        compaction_task_failed; ///< last background compaction failed, stalled writers do not wait it
+    uint64_t                  valuelog_chunk_unpack_count; ///< unpacked valuelog chunk count, chunks served from cache are not counted
 };
 
 boolean_t             tosdb_write_and_flush_superblock(tosdb_backend_t* backend, tosdb_superblock_t* sb);
 uint64_t              tosdb_block_write(tosdb_t* tdb, tosdb_block_header_t* block);
+boolean_t             tosdb_superblock_flush(tosdb_t* tdb);
 tosdb_block_header_t* tosdb_block_read(tosdb_t* tdb, uint64_t location, uint64_t size);
+tosdb_cached_block_t* tosdb_block_acquire(tosdb_t* tdb, uint64_t location, uint64_t size);
+void                  tosdb_block_release(tosdb_cached_block_t* c_blk);
 boolean_t             tosdb_persist(tosdb_t* tdb);
 boolean_t             tosdb_load_databases(tosdb_t* tdb);
 
@@ -397,9 +472,12 @@ struct tosdb_table_t {
     list_t*           sstable_list_items;
     hashmap_t*        sstable_levels;
     uint64_t          sstable_max_level;
+    boolean_t         is_sstable_list_dirty;
+    uint64_t          wal_sequence;
 };
 
 boolean_t      tosdb_table_persist(tosdb_table_t* tbl);
+boolean_t      tosdb_table_metadata_persist(tosdb_table_t* tbl);
 tosdb_table_t* tosdb_table_load_table(tosdb_table_t* tbl);
 boolean_t      tosdb_table_load_columns(tosdb_table_t* tbl);
 boolean_t      tosdb_table_load_indexes(tosdb_table_t* tbl);
@@ -419,10 +497,13 @@ typedef struct tosdb_index_t {
     tosdb_index_type_t type;
     boolean_t          is_deleted;
     uint64_t           column_id;
+    boolean_t          is_ordered;
+    uint64_t           covered_columns;
 } tosdb_index_t;
 
 boolean_t             tosdb_table_index_persist(tosdb_table_t* tbl);
 boolean_t             tosdb_table_memtable_persist(tosdb_table_t* tbl);
+boolean_t             tosdb_table_checkpoint(tosdb_table_t* tbl, tosdb_memtable_t* mt);
 const tosdb_column_t* tosdb_table_get_column_by_index_id(tosdb_table_t* tbl, uint64_t id);
 
 typedef struct tosdb_memtable_index_item_t {
@@ -435,6 +516,11 @@ typedef struct tosdb_memtable_index_item_t {
     uint8_t   key[];
 }__attribute__((packed, aligned(8))) tosdb_memtable_index_item_t;
 
+/**
+ * @brief secondary index item
+ * @details data contains secondary key, primary key and serialized covered columns in order. offset is the value
+ * offset of indexed version at valuelog of its memtable or sstable, it identifies whether item is still the live one.
+ */
 typedef struct tosdb_memtable_secondary_index_item_t {
     uint128_t record_id;
     uint64_t  secondary_key_hash;
@@ -442,9 +528,13 @@ typedef struct tosdb_memtable_secondary_index_item_t {
     boolean_t is_primary_key_deleted;
     uint64_t  primary_key_hash;
     uint64_t  primary_key_length;
+    uint64_t  offset;
+    uint64_t  covered_length;
     uint8_t   data[];
 }__attribute__((packed, aligned(8))) tosdb_memtable_secondary_index_item_t;
 
+uint64_t tosdb_memtable_secondary_index_item_size(const tosdb_memtable_secondary_index_item_t* item);
+
 int8_t tosdb_memtable_index_comparator(const void* i1, const void* i2);
 int8_t tosdb_memtable_record_id_comparator(const void* i1, const void* i2);
 int8_t tosdb_memtable_secondary_index_comparator(const void* i1, const void* i2);
@@ -456,6 +546,9 @@ typedef struct tosdb_memtable_index_t {
     index_t*       index;
 } tosdb_memtable_index_t;
 
+/*! writer count bit which is set at rotation, last writer unpinning a rotated memtable persists it */
+#define TOSDB_MEMTABLE_WRITERS_CLOSED (1ULL << 63)
+
 struct tosdb_memtable_t {
     tosdb_table_t*                   tbl;
     uint64_t                         id;
@@ -464,16 +557,25 @@ struct tosdb_memtable_t {
     boolean_t                        is_full;
     boolean_t                        is_dirty;
     hashmap_t*                       indexes;
-    buffer_t*                        values;
-    uint64_t                         record_count;
+    uint8_t*                         values; ///< valuelog arena, writers reserve their ranges with atomic bump
+    uint64_t                         values_capacity; ///< valuelog arena size
+    volatile uint64_t                values_length; ///< reserved bytes, can pass capacity when memtable is full
+    volatile uint64_t                record_count;
+    volatile uint64_t                writer_count; ///< writers which pinned memtable, persist is deferred until they are done
+    uint64_t                         wal_sequence; ///< wal block sequence at creation, records of memtable are at this or newer blocks
+    list_t*                          retired_items; ///< replaced index items, lock free readers can still hold them
     tosdb_block_sstable_list_item_t* stli;
 };
 
-tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl);
+tosdb_memtable_t* tosdb_memtable_new_internal(tosdb_table_t * tbl, uint64_t valuelog_capacity);
 boolean_t         tosdb_memtable_new(tosdb_table_t * tbl);
+boolean_t         tosdb_memtable_persist_rotated(tosdb_table_t* tbl);
 boolean_t         tosdb_memtable_free(tosdb_memtable_t* mt);
-boolean_t         tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t * record, boolean_t del, tosdb_memtable_t** mt_out);
+int64_t           tosdb_memtable_values_reserve(tosdb_memtable_t* mt, uint64_t length);
+uint64_t          tosdb_memtable_values_size(const tosdb_memtable_t* mt);
+boolean_t         tosdb_memtable_upsert_internal(tosdb_memtable_t* mt, tosdb_record_t * record, boolean_t del, uint64_t offset, uint64_t length, uint64_t sequence);
 boolean_t         tosdb_memtable_upsert(tosdb_record_t * record, boolean_t del);
+boolean_t         tosdb_memtable_upsert_locked(tosdb_record_t * record, boolean_t del, const data_t* sd, uint64_t sequence);
 boolean_t         tosdb_memtable_persist(tosdb_memtable_t* mt);
 boolean_t         tosdb_memtable_index_persist(tosdb_memtable_t* mt, tosdb_block_sstable_list_item_t* stli, uint64_t idx, tosdb_memtable_index_t* mt_idx);
 boolean_t         tosdb_memtable_is_deleted(tosdb_record_t* record);
@@ -496,24 +598,54 @@ typedef struct tosdb_record_key_t {
 }tosdb_record_key_t;
 
 data_t*   tosdb_record_serialize(tosdb_record_t* record);
+data_t*   tosdb_record_serialize_covered(tosdb_record_t* record, uint64_t covered_columns);
 boolean_t tosdb_record_set_data_with_colid(tosdb_record_t * record, const uint64_t col_id, data_type_t type, uint64_t len, const void* value);
 boolean_t tosdb_record_get_data_with_colid(tosdb_record_t * record, const uint64_t col_id, data_type_t type, uint64_t* len, void** value);
+uint64_t  tosdb_record_key_hash_encode(const tosdb_index_t* index, data_type_t type, uint64_t len, const void* value);
+uint64_t  tosdb_record_key_hash_decode(const tosdb_index_t* index, data_type_t type, uint64_t key_hash);
+uint64_t  tosdb_record_key_length(data_type_t type);
 
 boolean_t tosdb_memtable_get(tosdb_record_t* record);
+boolean_t tosdb_memtable_locate(tosdb_record_t* record, uint64_t* offset);
 boolean_t tosdb_sstable_get(tosdb_record_t* record);
+boolean_t tosdb_sstable_multi_get(tosdb_table_t* tbl, tosdb_record_t** records, uint64_t count, boolean_t* founds);
+boolean_t tosdb_sstable_multi_locate(tosdb_table_t* tbl, tosdb_record_t** records, uint64_t count, boolean_t* founds, uint64_t* offsets);
+
+typedef boolean_t (*tosdb_sstable_scan_f)(void* arg, const tosdb_block_sstable_list_item_t* sli, const tosdb_memtable_index_item_t* item, const uint8_t* value);
+
+boolean_t tosdb_sstable_scan(tosdb_table_t* tbl, tosdb_block_sstable_list_item_t* sli, tosdb_sstable_scan_f cb, void* arg);
+uint8_t*  tosdb_valuelog_chunk_unpack(tosdb_t* tdb, const tosdb_block_valuelog_t* b_vl, uint64_t chunk_id, uint64_t* unpacked_size);
+
+boolean_t tosdb_sstable_search_on_index(tosdb_record_t * record, set_t* results, tosdb_block_sstable_list_item_t* sli, tosdb_memtable_secondary_index_item_t* item, uint64_t index_id);
+
+iterator_t* tosdb_merge_iterator_create(tosdb_table_t* tbl, uint64_t index_id, const tosdb_memtable_index_item_t* lo, const tosdb_memtable_index_item_t* hi, hashmap_t* shadowed_counts);
+iterator_t* tosdb_merge_iterator_create_secondary(tosdb_record_t* record, uint64_t index_id, tosdb_memtable_secondary_index_item_t* key);
+
+/**
+ * @enum tosdb_record_iterator_type_t
+ * @brief how record iterator builds records from merged index items
+ */
+typedef enum tosdb_record_iterator_type_t {
+    TOSDB_RECORD_ITERATOR_TYPE_PRIMARY_KEY, ///< records only contain primary key
+    TOSDB_RECORD_ITERATOR_TYPE_RECORD, ///< records are fetched with key
+    TOSDB_RECORD_ITERATOR_TYPE_SEARCH, ///< records are fetched with primary key and filtered by search value
+} tosdb_record_iterator_type_t;
 
-boolean_t tosdb_memtable_search(tosdb_record_t* record, set_t* results);
-boolean_t tosdb_sstable_search(tosdb_record_t* record, set_t* results);
+iterator_t*                  tosdb_record_iterator_create(tosdb_record_iterator_type_t type, tosdb_table_t* tbl, uint64_t index_id, iterator_t* merge_iter);
+tosdb_memtable_index_item_t* tosdb_record_iterator_key_item(tosdb_record_t* record, uint64_t* index_id);
 
 list_t*   tosdb_record_search(tosdb_record_t* record);
 boolean_t tosdb_record_search_set_destroy_cb(void * item);
 
-boolean_t tosdb_database_compact(const tosdb_database_t* db, tosdb_compaction_type_t type);
-boolean_t tosdb_table_compact(const tosdb_table_t* tbl, tosdb_compaction_type_t type);
-boolean_t tosdb_sstable_level_minor_compact(const tosdb_table_t* tbl, uint64_t level);
-boolean_t tosdb_sstable_level_major_compact(const tosdb_table_t* tbl, uint64_t level);
+boolean_t tosdb_database_compact(tosdb_database_t* db, tosdb_compaction_type_t type);
+boolean_t tosdb_table_compact(tosdb_table_t* tbl, tosdb_compaction_type_t type);
+boolean_t tosdb_sstable_level_minor_compact(tosdb_table_t* tbl, uint64_t level);
+boolean_t tosdb_sstable_level_major_compact(tosdb_table_t* tbl, uint64_t level);
+boolean_t tosdb_compaction_task_start(tosdb_t* tdb);
+boolean_t tosdb_compaction_task_stop(tosdb_t* tdb);
+boolean_t tosdb_compaction_task_end(tosdb_t* tdb);
+boolean_t tosdb_compaction_throttle_writer(tosdb_table_t* tbl);
 int8_t    tosdb_record_primary_key_comparator(const void* item1, const void* item2);
-boolean_t tosdb_table_get_primary_keys_internal(const tosdb_table_t* tbl, set_t* pks, list_t* old_pks);
 
 #define TOSDB_SEQUENCE_TABLE_NAME ".sequences"
 
@@ -10,6 +10,95 @@
 #define ___TOSDB_WAL_H 0
 
 #include <types.h>
+#include <buffer.h>
+#include <tosdb/tosdb.h>
+#include <tosdb/tosdb_internal.h>
 
-#endif
+/*! default maximum record count of one wal group commit */
+#define TOSDB_WAL_DEFAULT_GROUP_COMMIT_SIZE 64
+
+/*! maximum yield count of group leader while other writers are joining its group */
+#define TOSDB_WAL_GROUP_COMMIT_MAX_WAIT 16
+
+/**
+ * @brief creates wal of tosdb instance
+ * @param[in] tdb tosdb instance
+ * @return wal if success, NULL otherwise
+ */
+tosdb_wal_t* tosdb_wal_new(tosdb_t* tdb);
+
+/**
+ * @brief frees wal, pending records are discarded
+ * @param[in] wal wal to free
+ * @return true if success
+ */
+boolean_t tosdb_wal_free(tosdb_wal_t* wal);
+
+/**
+ * @brief builds wal items of record operations, it is called before any table lock is taken
+ * @details metadata of a new table is checkpointed before its first record. items is NULL when wal is disabled or
+ * replaying, records only need sequences then.
+ * @param[in] wal wal
+ * @param[in] records records to upsert or delete
+ * @param[in] dels deleted flags of records
+ * @param[in] count record count
+ * @param[out] items serialized wal items
+ * @return true if success
+ */
+boolean_t tosdb_wal_prepare(tosdb_wal_t* wal, tosdb_record_t** records, const boolean_t* dels, uint64_t count, buffer_t** items);
+
+/**
+ * @brief appends prepared items to pending wal group and gives sequences to their records
+ * @details records take consecutive sequences starting from record_sequence, they are the tie breaker of same key
+ * at memtables. caller holds table locks of records, so memtable placement follows the same order. items are
+ * consumed.
+ * @param[in] wal wal
+ * @param[in] items items built by tosdb_wal_prepare, can be NULL
+ * @param[in] count record count
+ * @param[out] group_sequence wal group sequence to sync, zero when nothing is appended
+ * @param[out] record_sequence sequence of first record
+ * @return true if success
+ */
+boolean_t tosdb_wal_enqueue(tosdb_wal_t* wal, buffer_t* items, uint64_t count, uint64_t* group_sequence, uint64_t* record_sequence);
+
+/**
+ * @brief waits until wal group with sequence is committed
+ * @details first waiter which finds no running flush becomes the leader of its group. leader yields while other
+ * writers are joining the group, and writes it when group is full, nobody joins anymore or wait limit is reached.
+ * @param[in] wal wal
+ * @param[in] sequence wal group sequence to wait, zero returns at once
+ * @return true if group is committed
+ */
+boolean_t tosdb_wal_sync(tosdb_wal_t* wal, uint64_t sequence);
+
+/**
+ * @brief replays committed wal blocks into memtables
+ * @param[in] wal wal
+ * @return true if all wal items are replayed
+ */
+boolean_t tosdb_wal_replay(tosdb_wal_t* wal);
+
+/**
+ * @brief drops pending and committed wal records after all memtables are persisted
+ * @param[in] wal wal
+ * @return true if success
+ */
+boolean_t tosdb_wal_truncate(tosdb_wal_t* wal);
 
+/**
+ * @brief returns sequence of wal block which next records will be written
+ * @details while replaying it is the sequence of replayed block
+ * @param[in] wal wal
+ * @return wal block sequence
+ */
+uint64_t tosdb_wal_get_sequence(tosdb_wal_t* wal);
+
+/**
+ * @brief returns oldest wal block sequence which still has records not reachable from superblock
+ * @details it is the oldest wal sequence of tables, blocks older than it can be dropped at next superblock write
+ * @param[in] wal wal
+ * @return wal block sequence
+ */
+uint64_t tosdb_wal_get_trim_sequence(tosdb_wal_t* wal);
+
+#endif
@@ -194,6 +194,32 @@ static inline boolean_t bit_set(uint64_t* data, uint8_t bitloc) {
     return res;
 }
 
+/**
+ * @brief sets bit value of given data at bitloc with lock prefix, safe for concurrent setters
+ * @param[in] data bit array
+ * @param[in] bitloc bit location at data
+ * @return old value
+ *
+ **/
+static inline boolean_t bit_set_atomic(volatile uint64_t* data, uint8_t bitloc) {
+    boolean_t res = false;
+    asm volatile ("lock bts %%rbx,(%%rax)" : "=@ccc" (res) : "a" (data), "b" (bitloc) : "memory");
+    return res;
+}
+
+/**
+ * @brief clears bit value of given data at bitloc with lock prefix, safe for concurrent clearers
+ * @param[in] data bit array
+ * @param[in] bitloc bit location at data
+ * @return old value
+ *
+ **/
+static inline boolean_t bit_clear_atomic(volatile uint64_t* data, uint8_t bitloc) {
+    boolean_t res = false;
+    asm volatile ("lock btr %%rbx,(%%rax)" : "=@ccc" (res) : "a" (data), "b" (bitloc) : "memory");
+    return res;
+}
+
 /**
  * @brief changes bit value of given data at bitloc
  * @param[in] data bit array
@@ -186,18 +186,32 @@ void __attribute__((destructor)) stop_ram(void) {
 
 uint64_t __kheap_bottom = 0;
 
+// tests which include real frame, paging or system info headers before setup.h use their types and sources
+#ifndef ___SYSTEMINFO_H
 void* SYSTEM_INFO;
+#endif
 
 void* KERNEL_FRAME_ALLOCATOR = NULL;
 
+#ifndef ___MEMORY_FRAME_H
 typedef void            * frame_t;
+#endif
+#ifndef ___MEMORY_PAGE_H
 typedef int8_t          memory_paging_page_type_t;
 typedef void            * memory_page_table_t;
+#endif
 typedef struct future_t future_t;
 
+#ifndef ___MEMORY_PAGE_H
 int8_t    memory_paging_add_va_for_frame_ext(memory_page_table_t* p4, uint64_t va_start, frame_t* frm, memory_paging_page_type_t type);
+#endif
 void      dump_ram(char_t* fname);
 void*     task_get_current_task(void);
+uint64_t  task_create_task(memory_heap_t* heap, uint64_t heap_size, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name);
+uint64_t  task_create_task_with_default_heap(memory_heap_t* heap, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name);
+void      task_yield(void);
+void      task_set_message_waiting(void);
+void      task_clear_message_waiting(uint64_t task_id);
 lock_t*   lock_create_with_heap(memory_heap_t* heap);
 int8_t    lock_destroy(lock_t* lock);
 void      lock_acquire(lock_t* lock);
@@ -206,6 +220,7 @@ lock_t*   lock_create_with_heap_for_future(memory_heap_t* heap, boolean_t for_fu
 future_t* future_create_with_heap_and_data(memory_heap_t* heap, lock_t* lock, void* data);
 void*     future_get_data_and_destroy(future_t* fut);
 
+#ifndef ___MEMORY_PAGE_H
 int8_t memory_paging_add_va_for_frame_ext(memory_page_table_t* p4, uint64_t va_start, frame_t* frm, memory_paging_page_type_t type){
     UNUSED(p4);
     UNUSED(va_start);
@@ -213,11 +228,43 @@ int8_t memory_paging_add_va_for_frame_ext(memory_page_table_t* p4, uint64_t va_s
     UNUSED(type);
     return 0;
 }
+#endif
 
 void* task_get_current_task(void){
     return NULL;
 }
 
+uint64_t task_create_task(memory_heap_t* heap, uint64_t heap_size, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name){
+    UNUSED(heap);
+    UNUSED(heap_size);
+    UNUSED(stack_size);
+    UNUSED(entry_point);
+    UNUSED(args_cnt);
+    UNUSED(args);
+    UNUSED(task_name);
+    return -1ULL;
+}
+
+uint64_t task_create_task_with_default_heap(memory_heap_t* heap, uint64_t stack_size, void* entry_point, uint64_t args_cnt, void** args, const char_t* task_name){
+    UNUSED(heap);
+    UNUSED(stack_size);
+    UNUSED(entry_point);
+    UNUSED(args_cnt);
+    UNUSED(args);
+    UNUSED(task_name);
+    return -1ULL;
+}
+
+void task_yield(void){
+}
+
+void task_set_message_waiting(void){
+}
+
+void task_clear_message_waiting(uint64_t task_id){
+    UNUSED(task_id);
+}
+
 lock_t* lock_create_with_heap(memory_heap_t* heap){
     UNUSED(heap);
     return (void*)0xdeadbeaf;
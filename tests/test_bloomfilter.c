@@ -75,6 +75,68 @@ int32_t main(uint32_t argc, char_t** argv) {
 
     bloomfilter_destroy(bf);
 
+    // classic and blocked filters are filled with same keys, false positives are counted with other keys
+    bloomfilter_t* bfs[2] = {bloomfilter_new(10000, 0.1), bloomfilter_new_blocked(10000, 0.1)};
+
+    if(!bfs[0] || !bfs[1]) {
+        print_error("cannot create bloom filters");
+        pass = false;
+    }
+
+    for(uint64_t i = 0; i < 2 && pass; i++) {
+        for(uint64_t j = 0; j < 10000; j++) {
+            data_t d = {0};
+            d.type = DATA_TYPE_INT8_ARRAY;
+            d.value = &j;
+            d.length = sizeof(uint64_t);
+
+            bloomfilter_add(bfs[i], &d);
+        }
+
+        data_t* s_bf = bloomfilter_serialize(bfs[i]);
+        bloomfilter_t* d_bf = bloomfilter_deserialize(s_bf);
+
+        if(!d_bf) {
+            print_error("cannot deserialize bloom filter");
+            pass = false;
+        }
+
+        uint64_t missing = 0;
+        uint64_t false_positive = 0;
+
+        time_t start = time_ns(NULL);
+
+        for(uint64_t j = 0; j < 20000 && d_bf; j++) {
+            data_t d = {0};
+            d.type = DATA_TYPE_INT8_ARRAY;
+            d.value = &j;
+            d.length = sizeof(uint64_t);
+
+            boolean_t found = bloomfilter_check(d_bf, &d);
+
+            if(j < 10000 && !found) {
+                missing++;
+            } else if(j >= 10000 && found) {
+                false_positive++;
+            }
+        }
+
+        printf("%s bloom filter: missing %lli false positive %lli check %lli ns\n",
+               i ? "blocked" : "classic", missing, false_positive, time_ns(NULL) - start);
+
+        if(missing || false_positive > 2000) {
+            print_error("bloom filter results are wrong");
+            pass = false;
+        }
+
+        bloomfilter_destroy(d_bf);
+        memory_free(s_bf->value);
+        memory_free(s_bf);
+    }
+
+    bloomfilter_destroy(bfs[0]);
+    bloomfilter_destroy(bfs[1]);
+
     if(pass) {
         print_success("TESTS PASSED");
     } else {
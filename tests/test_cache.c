@@ -3,15 +3,25 @@
  * Please read and understand latest version of Licence.
  */
 
+#define RAMSIZE (16 << 20)
 #include "setup.h"
 #include <cache.h>
 #include <hashmap.h>
 #include <list.h>
 #include <strings.h>
 #include <utils.h>
+#include <time.h>
+
+#define TEST_CACHE_BENCH_KEY_COUNT (16ULL << 10)
+#define TEST_CACHE_BENCH_OP_COUNT  (1ULL << 20)
 
 int32_t   main(uint32_t argc, char_t** argv);
 boolean_t test_item_key_destroyer(const void* key, const void* item);
+boolean_t test_owned_key_destroyer(const void* key, const void* item);
+uint64_t  test_owned_key_generator(const void* key);
+int8_t    test_owned_key_comparator(const void* key1, const void* key2);
+boolean_t test_bench_key_destroyer(const void* key, const void* item);
+uint64_t  test_cache_bench(uint64_t shard_count);
 
 boolean_t test_item_key_destroyer(const void* key, const void* item) {
     UNUSED(key);
@@ -21,13 +31,93 @@ boolean_t test_item_key_destroyer(const void* key, const void* item) {
     return true;
 }
 
+boolean_t test_owned_key_destroyer(const void* key, const void* item) {
+    memory_free((void*)key);
+    memory_free((void*)item);
+
+    return true;
+}
+
+uint64_t test_owned_key_generator(const void* key) {
+    return *(const uint64_t*)key;
+}
+
+int8_t test_owned_key_comparator(const void* key1, const void* key2) {
+    uint64_t k1 = *(const uint64_t*)key1;
+    uint64_t k2 = *(const uint64_t*)key2;
+
+    return k1 < k2 ? -1 : (k1 > k2 ? 1 : 0);
+}
+
+boolean_t test_bench_key_destroyer(const void* key, const void* item) {
+    UNUSED(key);
+    UNUSED(item);
+
+    return true;
+}
+
+/**
+ * @brief random gets over a full cache
+ * @details host tests run at one cpu, so this measures get path of shard count, not lock contention
+ * @param[in] shard_count shard count of cache
+ * @return elapsed ns, 0 on failure
+ */
+uint64_t test_cache_bench(uint64_t shard_count) {
+    cache_config_t cc = {0};
+    cc.policy = CACHE_POLICY_COUNT;
+    cc.hard_limit = TEST_CACHE_BENCH_KEY_COUNT;
+    cc.shard_count = shard_count;
+    cc.item_key_destroyer = test_bench_key_destroyer;
+
+    cache_t* cache = cache_new(&cc);
+
+    if(cache == NULL) {
+        print_error("cannot create bench cache");
+
+        return 0;
+    }
+
+    for(uint64_t i = 1; i <= TEST_CACHE_BENCH_KEY_COUNT; i++) {
+        cache_put_by_count(cache, (void*)i, (void*)i);
+    }
+
+    uint64_t seed = 0x1234567;
+    uint64_t hits = 0;
+
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_CACHE_BENCH_OP_COUNT; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+
+        if(cache_get(cache, (void*)((seed % TEST_CACHE_BENCH_KEY_COUNT) + 1))) {
+            hits++;
+        }
+    }
+
+    uint64_t elapsed = time_ns(NULL) - start;
+
+    cache_destroy(cache);
+
+    if(hits == 0) {
+        print_error("bench cache has no hits");
+
+        return 0;
+    }
+
+    printf("cache shards: %lli gets: %lli hits: %lli ns/get: %lli\n", shard_count, TEST_CACHE_BENCH_OP_COUNT, hits,
+           elapsed / TEST_CACHE_BENCH_OP_COUNT);
+
+    return elapsed ? elapsed : 1;
+}
+
 int32_t main(uint32_t argc, char_t** argv) {
     UNUSED(argc);
     UNUSED(argv);
 
     cache_config_t cc = {0};
     cc.hard_limit = 5;
-    cc.soft_limit = 2;
     cc.policy = CACHE_POLICY_COUNT;
     cc.item_key_destroyer = test_item_key_destroyer;
 
@@ -83,8 +173,122 @@ int32_t main(uint32_t argc, char_t** argv) {
         return -1;
     }
 
+    // all items are referenced above, so clock clears them and evicts the oldest one: key 2
+    cache_put_by_count(cache, (void*)1, strdup("elma"));
+
+    if(cache_get(cache, (void*)2) != NULL) {
+        print_error("key 2 found");
+        cache_destroy(cache);
+
+        return -1;
+    }
+
+    // referenced key 3 gets second chance, key 4 is evicted
+    cache_get(cache, (void*)3);
+    cache_put_by_count(cache, (void*)7, strdup("dut"));
+
+    if(cache_get(cache, (void*)4) != NULL) {
+        print_error("key 4 found");
+        cache_destroy(cache);
+
+        return -1;
+    }
+
+    if(cache_get(cache, (void*)3) == NULL || cache_get(cache, (void*)7) == NULL) {
+        print_error("key 3 or key 7 not found");
+        cache_destroy(cache);
+
+        return -1;
+    }
+
     cache_destroy(cache);
 
+    cc.hard_limit = 256 << 10;
+    cc.policy = CACHE_POLICY_SIZE;
+    cc.shard_count = 4;
+
+    cache = cache_new(&cc);
+
+    if(cache == NULL) {
+        print_error("cannot create sharded cache");
+
+        return -1;
+    }
+
+    uint64_t item_size = 1 << 10;
+    uint64_t item_count = 4 * (cc.hard_limit / item_size);
+
+    for(uint64_t i = 1; i <= item_count; i++) {
+        cache_put(cache, (void*)i, memory_malloc(item_size), item_size);
+    }
+
+    uint64_t found = 0;
+
+    for(uint64_t i = 1; i <= item_count; i++) {
+        if(cache_get(cache, (void*)i) != NULL) {
+            found++;
+        }
+    }
+
+    if(found == 0 || found * item_size > cc.hard_limit) {
+        print_error("sharded cache size limit failed");
+        cache_destroy(cache);
+
+        return -1;
+    }
+
+    if(cache_get(cache, (void*)item_count) == NULL) {
+        print_error("last item not found");
+        cache_destroy(cache);
+
+        return -1;
+    }
+
+    cache_destroy(cache);
+
+    // cache owns keys, putting same item with an equal key should release previous key
+    cc.hard_limit = 5;
+    cc.policy = CACHE_POLICY_COUNT;
+    cc.shard_count = 1;
+    cc.item_key_destroyer = test_owned_key_destroyer;
+    cc.key_generator = test_owned_key_generator;
+    cc.key_comparator = test_owned_key_comparator;
+
+    cache = cache_new(&cc);
+
+    if(cache == NULL) {
+        print_error("cannot create owned key cache");
+
+        return -1;
+    }
+
+    char_t* item = strdup("erik");
+
+    for(uint64_t i = 0; i < 3; i++) {
+        uint64_t* key = memory_malloc(sizeof(uint64_t));
+        *key = 42;
+
+        cache_put_by_count(cache, key, item);
+    }
+
+    uint64_t search_key = 42;
+
+    if(cache_get(cache, &search_key) != item) {
+        print_error("replaced item not found");
+        cache_destroy(cache);
+
+        return -1;
+    }
+
+    cache_destroy(cache);
+
+    // both runs use clock eviction, one shard is the old single global lock layout
+    if(!test_cache_bench(1) || !test_cache_bench(CACHE_DEFAULT_SHARD_COUNT)) {
+        print_error("TESTS FAILED");
+
+        return -1;
+    }
+
     print_success("TESTS PASSED");
 
     return 0;
@@ -3,13 +3,14 @@
  * Please read and understand latest version of Licence.
  */
 
-#define RAMSIZE (128 << 20)
+#define RAMSIZE (256 << 20)
 #include "setup.h"
 #include <utils.h>
 #include <buffer.h>
 #include <data.h>
 #include <sha2.h>
 #include <bplustree.h>
+#include <skiplist.h>
 #include <map.h>
 #include <xxhash.h>
 #include <tosdb/tosdb.h>
@@ -31,6 +32,24 @@ int32_t test_step1(uint32_t argc, char_t** argv);
 int32_t test_step2(uint32_t argc, char_t** argv);
 int32_t test_step3(uint32_t argc, char_t** argv);
 int32_t test_step4(uint32_t argc, char_t** argv);
+int32_t test_step5(uint32_t argc, char_t** argv);
+tosdb_t*  test_step5_open(tosdb_backend_t* backend);
+boolean_t test_step5_get_all(tosdb_t* tosdb, int64_t max_id, uint64_t* found, uint64_t* updated, uint64_t* elapsed, tosdb_table_stats_t* stats);
+boolean_t test_step5_multi_get_all(tosdb_t* tosdb, int64_t max_id, uint64_t* found, uint64_t* updated, uint64_t* elapsed);
+int32_t test_step6(uint32_t argc, char_t** argv);
+boolean_t test_step7_scan(tosdb_table_t* table, const char_t* colname, int64_t lo, int64_t hi, uint64_t limit, uint64_t expected);
+boolean_t test_step7_iterators(tosdb_table_t* table, uint64_t expected_live);
+int32_t test_step7(uint32_t argc, char_t** argv);
+boolean_t test_step8_fill(tosdb_table_t* table);
+boolean_t test_step8_search(tosdb_table_t* table, const char_t* colname, int64_t value, uint64_t expected, uint64_t* elapsed);
+int32_t test_step8(uint32_t argc, char_t** argv);
+char_t*   test_step9_name(int64_t id);
+boolean_t test_step9_get(tosdb_table_t* table, int64_t id, uint64_t* unpacked);
+int32_t   test_step9(uint32_t argc, char_t** argv);
+boolean_t test_step10_add(tosdb_write_batch_t* batch, tosdb_table_t* table, int64_t id, boolean_t del);
+boolean_t test_step10_exists(tosdb_table_t* table, int64_t id);
+int32_t   test_step10(uint32_t argc, char_t** argv);
+int32_t   test_step11(uint32_t argc, char_t** argv);
 
 
 #define TOSDB_CAP (32 << 20)
@@ -1287,6 +1306,1843 @@ backend_failed:
     return pass?0:-1;
 }
 
+#define TEST_STEP5_MAX_ID 5000
+#define TEST_STEP5_MULTI_GET_SIZE 256
+
+tosdb_t* test_step5_open(tosdb_backend_t* backend) {
+    tosdb_t* tosdb = tosdb_new(backend, COMPRESSION_TYPE_DEFLATE);
+
+    if(!tosdb) {
+        print_error("cannot create tosdb");
+
+        return NULL;
+    }
+
+    tosdb_cache_config_t cc = {0};
+    cc.bloomfilter_size = 2 << 20;
+    cc.index_data_size = 4 << 20;
+    cc.secondary_index_data_size = 4 << 20;
+    cc.valuelog_size = 16 << 20;
+    cc.block_size = 4 << 20;
+
+    if(!tosdb_cache_config_set(tosdb, &cc)) {
+        print_error("cannot set tosdb cache config");
+        tosdb_free(tosdb);
+
+        return NULL;
+    }
+
+    return tosdb;
+}
+
+boolean_t test_step5_get_all(tosdb_t* tosdb, int64_t max_id, uint64_t* found, uint64_t* updated, uint64_t* elapsed, tosdb_table_stats_t* stats) {
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "testdb");
+    tosdb_table_t* table2 = tosdb_table_create_or_open(testdb, "table2", 1 << 10, 128 << 10, 8);
+
+    if(!table2) {
+        print_error("cannot create/open table2");
+
+        return false;
+    }
+
+    *found = 0;
+    *updated = 0;
+
+    time_t start = time_ns(NULL);
+
+    for(int64_t id = 1; id <= max_id; id++) {
+        tosdb_record_t* rec = tosdb_table_create_record(table2);
+
+        if(!rec) {
+            print_error("cannot create record");
+
+            return false;
+        }
+
+        rec->set_int64(rec, "id", id);
+
+        if(rec->get_record(rec)) {
+            *found += 1;
+
+            char_t* sname = NULL;
+
+            if(rec->get_string(rec, "sname", &sname)) {
+                if(strcmp(sname, "compacted") == 0) {
+                    *updated += 1;
+                }
+
+                memory_free(sname);
+            }
+        }
+
+        rec->destroy(rec);
+    }
+
+    *elapsed = time_ns(NULL) - start;
+
+    return tosdb_table_get_stats(table2, stats);
+}
+
+boolean_t test_step5_multi_get_all(tosdb_t* tosdb, int64_t max_id, uint64_t* found, uint64_t* updated, uint64_t* elapsed) {
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "testdb");
+    tosdb_table_t* table2 = tosdb_table_create_or_open(testdb, "table2", 1 << 10, 128 << 10, 8);
+
+    if(!table2) {
+        print_error("cannot create/open table2");
+
+        return false;
+    }
+
+    tosdb_record_t* recs[TEST_STEP5_MULTI_GET_SIZE] = {0};
+    boolean_t founds[TEST_STEP5_MULTI_GET_SIZE] = {0};
+    boolean_t res = true;
+
+    *found = 0;
+    *updated = 0;
+
+    time_t start = time_ns(NULL);
+
+    // keys are given in reverse order, multi get sorts them itself
+    for(int64_t id = max_id; id >= 1 && res;) {
+        uint64_t count = 0;
+
+        for(; id >= 1 && count < TEST_STEP5_MULTI_GET_SIZE; id--) {
+            recs[count] = tosdb_table_create_record(table2);
+
+            if(!recs[count]) {
+                print_error("cannot create record");
+                res = false;
+
+                break;
+            }
+
+            recs[count]->set_int64(recs[count], "id", id);
+            count++;
+        }
+
+        if(res && !tosdb_table_multi_get(table2, recs, count, founds)) {
+            print_error("cannot multi get records");
+            res = false;
+        }
+
+        for(uint64_t i = 0; i < count; i++) {
+            if(res && founds[i]) {
+                *found += 1;
+
+                char_t* sname = NULL;
+
+                if(recs[i]->get_string(recs[i], "sname", &sname)) {
+                    if(strcmp(sname, "compacted") == 0) {
+                        *updated += 1;
+                    }
+
+                    memory_free(sname);
+                }
+            }
+
+            recs[i]->destroy(recs[i]);
+        }
+    }
+
+    *elapsed = time_ns(NULL) - start;
+
+    return res;
+}
+
+int32_t test_step5(uint32_t argc, char_t** argv) {
+    char_t* tosdb_out_file_name = (char_t*)"./tmp/tosdb.img";
+
+    if(argc == 2) {
+        tosdb_out_file_name = argv[1];
+    }
+
+    FILE* in = fopen(tosdb_out_file_name, "r");
+
+    if(!in) {
+        print_error("cannot open tosdb file");
+
+        return -1;
+    }
+
+    buffer_t* db_buffer = buffer_new_with_capacity(NULL, TOSDB_CAP);
+
+    if(!db_buffer) {
+        fclose(in);
+        print_error("cannot create db buffer");
+        return -1;
+    }
+
+    uint8_t* read_buf = memory_malloc(4 << 10);
+
+    if(!read_buf) {
+        buffer_destroy(db_buffer);
+        print_error("cannot create read buffer");
+        fclose(in);
+
+        return -1;
+    }
+
+    uint64_t total_read = 0;
+    while(1) {
+        uint64_t rc = fread(read_buf, 1, 4 << 10, in);
+        if(rc == 0) {
+            break;
+        }
+
+        total_read += rc;
+
+        buffer_append_bytes(db_buffer, read_buf, 4 << 10);
+        memory_memclean(read_buf, 4 << 10);
+    }
+
+    memory_free(read_buf);
+
+    fclose(in);
+
+    if(total_read != TOSDB_CAP) {
+        buffer_destroy(db_buffer);
+        print_error("cannot read db file");
+        printf("total read: %lli\n", total_read);
+
+        return -1;
+    }
+
+    boolean_t pass = true;
+
+    tosdb_backend_t* backend = tosdb_backend_memory_from_buffer(db_buffer);
+
+    if(!backend) {
+        print_error("cannot create backend");
+        pass = false;
+
+        goto backend_failed;
+    }
+
+    tosdb_t* tosdb = test_step5_open(backend);
+
+    if(!tosdb) {
+        pass = false;
+
+        goto backend_close;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "testdb");
+
+    if(!testdb) {
+        print_error("cannot create/open testdb");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    tosdb_table_t* table2 = tosdb_table_create_or_open(testdb, "table2", 1 << 10, 128 << 10, 8);
+
+    if(!table2) {
+        print_error("cannot create/open table2");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    // shadow half of the records and delete some of them, so sstables contain holes
+    uint64_t deleted_count = 0;
+
+    for(int64_t id = 2; id <= TEST_STEP5_MAX_ID; id += 2) {
+        tosdb_record_t* rec = tosdb_table_create_record(table2);
+
+        if(!rec) {
+            print_error("cannot create record");
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        rec->set_int64(rec, "id", id);
+
+        if(!rec->get_record(rec)) {
+            rec->destroy(rec);
+
+            continue;
+        }
+
+        if(id % 100 == 0) {
+            if(!rec->delete_record(rec)) {
+                print_error("cannot delete record");
+                pass = false;
+            }
+
+            deleted_count++;
+        } else {
+            rec->set_string(rec, "sname", "compacted");
+
+            if(!rec->upsert_record(rec)) {
+                print_error("cannot update record");
+                pass = false;
+            }
+        }
+
+        rec->destroy(rec);
+
+        if(!pass) {
+            goto tdb_close;
+        }
+    }
+
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+
+        goto backend_close;
+    }
+
+    tosdb = test_step5_open(backend);
+
+    if(!tosdb) {
+        pass = false;
+
+        goto backend_close;
+    }
+
+    uint64_t found[4] = {0};
+    uint64_t updated[4] = {0};
+    uint64_t elapsed[4] = {0};
+    tosdb_table_stats_t stats[4] = {0};
+    const char_t* phases[4] = {"before compaction", "after minor compaction", "after major compaction", "after reopen"};
+
+    for(uint64_t phase = 0; phase < 4; phase++) {
+        if(phase == 1 && !tosdb_compact(tosdb, TOSDB_COMPACTION_TYPE_MINOR)) {
+            print_error("cannot run minor compaction");
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        if(phase == 2 && !tosdb_compact(tosdb, TOSDB_COMPACTION_TYPE_MAJOR)) {
+            print_error("cannot run major compaction");
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        if(phase == 3) {
+            if(!tosdb_close(tosdb)) {
+                print_error("cannot close tosdb");
+                pass = false;
+            }
+
+            if(!tosdb_free(tosdb)) {
+                print_error("cannot free tosdb");
+                pass = false;
+
+                goto backend_close;
+            }
+
+            tosdb = test_step5_open(backend);
+
+            if(!tosdb) {
+                pass = false;
+
+                goto backend_close;
+            }
+        }
+
+        if(!test_step5_get_all(tosdb, TEST_STEP5_MAX_ID, &found[phase], &updated[phase], &elapsed[phase], &stats[phase])) {
+            print_error("cannot get records");
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        printf("%s: found %lli updated %lli get latency %lli ns/op sstables %lli levels %lli sstable records %lli sstable size %lli disk size %lli\n",
+               phases[phase], found[phase], updated[phase], elapsed[phase] / TEST_STEP5_MAX_ID,
+               stats[phase].sstable_count, stats[phase].sstable_max_level, stats[phase].sstable_record_count,
+               stats[phase].sstable_size, stats[phase].backend_used_size);
+
+        if(phase && (found[phase] != found[0] || updated[phase] != updated[0])) {
+            print_error("records are changed by compaction");
+            pass = false;
+        }
+
+        uint64_t multi_found = 0;
+        uint64_t multi_updated = 0;
+        uint64_t multi_elapsed = 0;
+
+        if(!test_step5_multi_get_all(tosdb, TEST_STEP5_MAX_ID, &multi_found, &multi_updated, &multi_elapsed)) {
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        printf("%s: multi get found %lli updated %lli get latency %lli ns/op\n",
+               phases[phase], multi_found, multi_updated, multi_elapsed / TEST_STEP5_MAX_ID);
+
+        if(multi_found != found[phase] || multi_updated != updated[phase]) {
+            print_error("multi get results differ from get");
+            pass = false;
+        }
+    }
+
+    if(!deleted_count || found[0] + deleted_count + 1 != TEST_STEP5_MAX_ID) {
+        print_error("unexpected record count before compaction");
+        pass = false;
+    }
+
+    if(stats[2].sstable_count != 1 || stats[2].sstable_count >= stats[0].sstable_count ||
+       stats[2].sstable_size >= stats[0].sstable_size || stats[2].sstable_record_count != found[0]) {
+        print_error("compaction does not reduce sstables");
+        pass = false;
+    }
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+backend_close:
+    if(!tosdb_backend_close(backend)) {
+        pass = false;
+    }
+
+backend_failed:
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+    return pass?0:-1;
+}
+
+#define TEST_STEP6_MAX_ID 3000
+#define TEST_STEP6_STALL_COUNT 3
+
+int32_t test_step6(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    tosdb_backend_t* backend = tosdb_backend_memory_new(TOSDB_CAP);
+
+    if(!backend) {
+        print_error("cannot create backend");
+        pass = false;
+
+        goto backend_failed;
+    }
+
+    tosdb_t* tosdb = test_step5_open(backend);
+
+    if(!tosdb) {
+        pass = false;
+
+        goto backend_close;
+    }
+
+    // there is no background task at tests, stalled writers compact level 1 themselves
+    tosdb_compaction_config_t tcc = {0};
+    tcc.level1_stall_count = TEST_STEP6_STALL_COUNT;
+
+    if(!tosdb_compaction_config_set(tosdb, &tcc)) {
+        print_error("cannot set compaction config");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "stalldb");
+
+    if(!testdb) {
+        print_error("cannot create/open stalldb");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    tosdb_table_t* table = tosdb_table_create_or_open(testdb, "stalled", 128, 16 << 10, 2);
+
+    if(!table) {
+        print_error("cannot create/open stalled table");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    if(!tosdb_table_column_add(table, "id", DATA_TYPE_INT64) ||
+       !tosdb_table_column_add(table, "name", DATA_TYPE_STRING) ||
+       !tosdb_table_index_create(table, "id", TOSDB_INDEX_PRIMARY)) {
+        print_error("cannot create columns/index of stalled table");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    tosdb_table_stats_t stats = {0};
+    uint64_t max_sstable_count = 0;
+
+    for(int64_t id = 1; id <= TEST_STEP6_MAX_ID; id++) {
+        tosdb_record_t* rec = tosdb_table_create_record(table);
+
+        if(!rec) {
+            print_error("cannot create record");
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        rec->set_int64(rec, "id", id);
+        rec->set_string(rec, "name", id % 2 ? "odd" : "even");
+
+        if(!rec->upsert_record(rec)) {
+            print_error("cannot insert record");
+            pass = false;
+        }
+
+        rec->destroy(rec);
+
+        if(!pass || !tosdb_table_get_stats(table, &stats)) {
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        if(stats.sstable_count > max_sstable_count) {
+            max_sstable_count = stats.sstable_count;
+        }
+    }
+
+    printf("stalled writes: sstables %lli max sstables %lli levels %lli sstable records %lli\n",
+           stats.sstable_count, max_sstable_count, stats.sstable_max_level, stats.sstable_record_count);
+
+    // level 1 is at most stall count after an eviction, level 2 has one merged sstable
+    if(stats.sstable_max_level != 2 || max_sstable_count > TEST_STEP6_STALL_COUNT + 1) {
+        print_error("level 1 is not bounded by stall count");
+        pass = false;
+    }
+
+    uint64_t found = 0;
+
+    for(int64_t id = 1; id <= TEST_STEP6_MAX_ID; id++) {
+        tosdb_record_t* rec = tosdb_table_create_record(table);
+
+        if(!rec) {
+            print_error("cannot create record");
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        rec->set_int64(rec, "id", id);
+
+        if(rec->get_record(rec)) {
+            found++;
+        }
+
+        rec->destroy(rec);
+    }
+
+    if(found != TEST_STEP6_MAX_ID) {
+        print_error("records are lost by stalled writer compactions");
+        printf("found: %lli\n", found);
+        pass = false;
+    }
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+backend_close:
+    if(!tosdb_backend_close(backend)) {
+        pass = false;
+    }
+
+backend_failed:
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+    return pass?0:-1;
+}
+
+#define TEST_STEP7_MAX_ID 1000
+#define TEST_STEP7_NAME_BASE 200000
+
+boolean_t test_step7_scan(tosdb_table_t* table, const char_t* colname, int64_t lo, int64_t hi, uint64_t limit, uint64_t expected) {
+    tosdb_record_t* rec_lo = tosdb_table_create_record(table);
+    tosdb_record_t* rec_hi = tosdb_table_create_record(table);
+
+    if(!rec_lo || !rec_hi) {
+        print_error("cannot create range records");
+
+        return false;
+    }
+
+    if(strcmp(colname, "id") == 0) {
+        rec_lo->set_int64(rec_lo, colname, lo);
+        rec_hi->set_int64(rec_hi, colname, hi);
+    } else {
+        char_t* name = sprintf("name%lli", lo + TEST_STEP7_NAME_BASE);
+        rec_lo->set_string(rec_lo, colname, name);
+        memory_free(name);
+        name = sprintf("name%lli", hi + TEST_STEP7_NAME_BASE);
+        rec_hi->set_string(rec_hi, colname, name);
+        memory_free(name);
+    }
+
+    list_t* recs = tosdb_record_range_scan(rec_lo, rec_hi, limit);
+
+    rec_lo->destroy(rec_lo);
+    rec_hi->destroy(rec_hi);
+
+    if(!recs) {
+        print_error("cannot scan range");
+
+        return false;
+    }
+
+    boolean_t pass = true;
+    boolean_t first = true;
+    int64_t prev_id = 0;
+
+    iterator_t* iter = list_iterator_create(recs);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        tosdb_record_t* rec = (tosdb_record_t*)iter->get_item(iter);
+
+        int64_t id = 0;
+
+        if(!rec->get_int64(rec, "id", &id)) {
+            print_error("cannot get id of scanned record");
+            pass = false;
+        } else if(id < lo || id > hi || id % 10 == 0 || (!first && id <= prev_id)) {
+            printf("unexpected scanned id %lli after %lli\n", id, prev_id);
+            pass = false;
+        }
+
+        first = false;
+        prev_id = id;
+
+        rec->destroy(rec);
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(list_size(recs) != expected) {
+        printf("range %s %lli %lli limit %lli count %lli expected %lli\n", colname, lo, hi, limit, list_size(recs), expected);
+        pass = false;
+    }
+
+    list_destroy(recs);
+
+    return pass;
+}
+
+boolean_t test_step7_iterators(tosdb_table_t* table, uint64_t expected_live) {
+    boolean_t pass = true;
+
+    tosdb_record_t* rec_lo = tosdb_table_create_record(table);
+    tosdb_record_t* rec_hi = tosdb_table_create_record(table);
+
+    rec_lo->set_int64(rec_lo, "id", -TEST_STEP7_MAX_ID);
+    rec_hi->set_int64(rec_hi, "id", TEST_STEP7_MAX_ID);
+
+    iterator_t* iter = tosdb_record_range_scan_iterator(rec_lo, rec_hi);
+
+    rec_lo->destroy(rec_lo);
+    rec_hi->destroy(rec_hi);
+
+    if(!iter) {
+        print_error("cannot create range scan iterator");
+
+        return false;
+    }
+
+    // stop early, rest of merge is never materialized
+    int64_t prev_id = -TEST_STEP7_MAX_ID - 1;
+    uint64_t count = 0;
+
+    while(iter->end_of_iterator(iter) != 0 && count < 10) {
+        tosdb_record_t* rec = (tosdb_record_t*)iter->get_item(iter);
+        int64_t id = 0;
+
+        if(!rec->get_int64(rec, "id", &id) || id <= prev_id) {
+            printf("range scan iterator order error at %lli after %lli\n", id, prev_id);
+            pass = false;
+        }
+
+        prev_id = id;
+        count++;
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(count != 10) {
+        printf("range scan iterator early stop count %lli\n", count);
+        pass = false;
+    }
+
+    iter = tosdb_table_primary_key_iterator(table);
+
+    if(!iter) {
+        print_error("cannot create primary key iterator");
+
+        return false;
+    }
+
+    count = 0;
+
+    while(iter->end_of_iterator(iter) != 0) {
+        count++;
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(count != expected_live) {
+        printf("primary key iterator count %lli expected %lli\n", count, expected_live);
+        pass = false;
+    }
+
+    set_t* pks = tosdb_table_get_primary_keys(table);
+
+    if(!pks || set_size(pks) != expected_live) {
+        printf("primary key set size %lli expected %lli\n", pks ? set_size(pks) : 0, expected_live);
+        pass = false;
+    }
+
+    if(pks) {
+        iter = set_create_iterator(pks);
+
+        while(iter->end_of_iterator(iter) != 0) {
+            tosdb_record_t* pk_rec = (tosdb_record_t*)iter->get_item(iter);
+
+            pk_rec->destroy(pk_rec);
+
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+        set_destroy(pks);
+    }
+
+    for(int64_t id = 6; id <= 7; id++) {
+        tosdb_record_t* s_rec = tosdb_table_create_record(table);
+        char_t* name = sprintf("name%lli", id + TEST_STEP7_NAME_BASE);
+
+        s_rec->set_string(s_rec, "name", name);
+        memory_free(name);
+
+        iter = tosdb_record_search_iterator(s_rec);
+
+        s_rec->destroy(s_rec);
+
+        if(!iter) {
+            print_error("cannot create search iterator");
+            pass = false;
+
+            continue;
+        }
+
+        count = 0;
+
+        while(iter->end_of_iterator(iter) != 0) {
+            tosdb_record_t* rec = (tosdb_record_t*)iter->delete_item(iter);
+            int64_t r_id = 0;
+
+            if(!rec->get_int64(rec, "id", &r_id) || r_id != id) {
+                printf("search iterator returned id %lli for %lli\n", r_id, id);
+                pass = false;
+            }
+
+            rec->destroy(rec);
+            count++;
+        }
+
+        iter->destroy(iter);
+
+        if(count != 1) {
+            printf("search iterator count %lli for id %lli\n", count, id);
+            pass = false;
+        }
+    }
+
+    return pass;
+}
+
+int32_t test_step7(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    tosdb_backend_t* backend = tosdb_backend_memory_new(TOSDB_CAP);
+
+    if(!backend) {
+        print_error("cannot create backend");
+        pass = false;
+
+        goto backend_failed;
+    }
+
+    tosdb_t* tosdb = test_step5_open(backend);
+
+    if(!tosdb) {
+        pass = false;
+
+        goto backend_close;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "rangedb");
+    tosdb_table_t* table = tosdb_table_create_or_open(testdb, "ranged", 128, 16 << 10, 2);
+
+    if(!table) {
+        print_error("cannot create/open ranged table");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    if(!tosdb_table_column_add(table, "id", DATA_TYPE_INT64) ||
+       !tosdb_table_column_add(table, "name", DATA_TYPE_STRING) ||
+       !tosdb_table_index_create_ordered(table, "id", TOSDB_INDEX_PRIMARY) ||
+       !tosdb_table_index_create_ordered(table, "name", TOSDB_INDEX_UNIQUE)) {
+        print_error("cannot create columns/indexes of ranged table");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    uint64_t id_count = 2 * TEST_STEP7_MAX_ID + 1;
+
+    // shuffled inserts, negative keys sort before positive ones
+    for(uint64_t i = 0; i < id_count; i++) {
+        int64_t id = (int64_t)((i * 7919) % id_count) - TEST_STEP7_MAX_ID;
+
+        tosdb_record_t* rec = tosdb_table_create_record(table);
+
+        if(!rec) {
+            print_error("cannot create record");
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        char_t* name = sprintf("name%lli", id + TEST_STEP7_NAME_BASE);
+
+        rec->set_int64(rec, "id", id);
+        rec->set_string(rec, "name", name);
+
+        memory_free(name);
+
+        if(!rec->upsert_record(rec)) {
+            print_error("cannot insert record");
+            pass = false;
+        }
+
+        rec->destroy(rec);
+
+        if(!pass) {
+            goto tdb_close;
+        }
+    }
+
+    // deletes and updates leave older versions at sstables
+    for(int64_t id = -TEST_STEP7_MAX_ID; id <= TEST_STEP7_MAX_ID; id++) {
+        if(id % 10 && id % 7) {
+            continue;
+        }
+
+        tosdb_record_t* rec = tosdb_table_create_record(table);
+
+        if(!rec) {
+            print_error("cannot create record");
+            pass = false;
+
+            goto tdb_close;
+        }
+
+        rec->set_int64(rec, "id", id);
+
+        if(!rec->get_record(rec)) {
+            print_error("cannot get record");
+            pass = false;
+        } else if(id % 10 == 0) {
+            pass = rec->delete_record(rec);
+        } else {
+            pass = rec->upsert_record(rec);
+        }
+
+        rec->destroy(rec);
+
+        if(!pass) {
+            print_error("cannot delete/update record");
+
+            goto tdb_close;
+        }
+    }
+
+    tosdb_table_stats_t stats = {0};
+
+    if(!tosdb_table_get_stats(table, &stats)) {
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    printf("ranged table: sstables %lli levels %lli\n", stats.sstable_count, stats.sstable_max_level);
+
+    pass &= test_step7_scan(table, "id", -50, 49, 0, 90);
+    pass &= test_step7_scan(table, "id", -TEST_STEP7_MAX_ID, TEST_STEP7_MAX_ID, 0, id_count - 201);
+    pass &= test_step7_scan(table, "id", -TEST_STEP7_MAX_ID, TEST_STEP7_MAX_ID, 25, 25);
+    pass &= test_step7_scan(table, "id", 5, 5, 0, 1);
+    pass &= test_step7_scan(table, "id", 10, 10, 0, 0);
+    pass &= test_step7_scan(table, "id", 49, -50, 0, 0);
+    pass &= test_step7_scan(table, "name", -10, 9, 0, 18);
+    pass &= test_step7_iterators(table, id_count - 201);
+
+    if(!tosdb_close(tosdb) || !tosdb_free(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+
+        goto backend_close;
+    }
+
+    // ordered flag of indexes is persisted
+    tosdb = test_step5_open(backend);
+
+    if(!tosdb) {
+        pass = false;
+
+        goto backend_close;
+    }
+
+    testdb = tosdb_database_create_or_open(tosdb, "rangedb");
+    table = tosdb_table_create_or_open(testdb, "ranged", 128, 16 << 10, 2);
+
+    if(!table) {
+        print_error("cannot re-open ranged table");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    pass &= test_step7_scan(table, "id", -50, 49, 0, 90);
+    pass &= test_step7_scan(table, "name", -10, 9, 0, 18);
+    pass &= test_step7_iterators(table, id_count - 201);
+
+    // repeated scans read same sstable blocks
+    tosdb_block_cache_stats_t bc_stats = {0};
+
+    if(!tosdb_block_cache_get_stats(tosdb, &bc_stats) || !bc_stats.hit_count || !bc_stats.miss_count) {
+        printf("block cache stats hit %lli miss %lli\n", bc_stats.hit_count, bc_stats.miss_count);
+        pass = false;
+    }
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+backend_close:
+    if(!tosdb_backend_close(backend)) {
+        pass = false;
+    }
+
+backend_failed:
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+    return pass?0:-1;
+}
+
+#define TEST_STEP8_MAX_ID 2000
+#define TEST_STEP8_SECTION_COUNT 20
+#define TEST_STEP8_MOVED_SECTION 99
+
+boolean_t test_step8_fill(tosdb_table_t* table) {
+    for(int64_t id = 1; id <= TEST_STEP8_MAX_ID; id++) {
+        tosdb_record_t* rec = tosdb_table_create_record(table);
+
+        if(!rec) {
+            print_error("cannot create record");
+
+            return false;
+        }
+
+        char_t* symbol = sprintf("sym%lli", id);
+
+        rec->set_int64(rec, "id", id);
+        rec->set_int64(rec, "section_id", id % TEST_STEP8_SECTION_COUNT);
+        rec->set_int8(rec, "flag", id % 2);
+        rec->set_int64(rec, "offset", id * 8);
+        rec->set_string(rec, "symbol", symbol);
+
+        memory_free(symbol);
+
+        boolean_t res = rec->upsert_record(rec);
+
+        rec->destroy(rec);
+
+        if(!res) {
+            print_error("cannot insert record");
+
+            return false;
+        }
+    }
+
+    // moves, deletes and re-inserts with new record ids leave stale index items at older sstables
+    for(int64_t id = 1; id <= TEST_STEP8_MAX_ID; id++) {
+        if(id % 7 && id % 10 && id % 13) {
+            continue;
+        }
+
+        tosdb_record_t* rec = tosdb_table_create_record(table);
+
+        if(!rec) {
+            print_error("cannot create record");
+
+            return false;
+        }
+
+        rec->set_int64(rec, "id", id);
+
+        boolean_t res = rec->get_record(rec);
+
+        if(res && id % 10 == 0) {
+            res = rec->delete_record(rec);
+        } else if(res && id % 7 == 0) {
+            rec->set_int64(rec, "section_id", TEST_STEP8_MOVED_SECTION);
+            res = rec->upsert_record(rec);
+        } else if(res) {
+            res = rec->delete_record(rec);
+
+            tosdb_record_t* n_rec = tosdb_table_create_record(table);
+
+            if(!n_rec) {
+                res = false;
+            } else {
+                char_t* symbol = sprintf("sym%lli", id);
+
+                n_rec->set_int64(n_rec, "id", id);
+                n_rec->set_int64(n_rec, "section_id", id % TEST_STEP8_SECTION_COUNT);
+                n_rec->set_int8(n_rec, "flag", id % 2);
+                n_rec->set_int64(n_rec, "offset", id * 8);
+                n_rec->set_string(n_rec, "symbol", symbol);
+
+                memory_free(symbol);
+
+                res = res && n_rec->upsert_record(n_rec);
+
+                n_rec->destroy(n_rec);
+            }
+        }
+
+        rec->destroy(rec);
+
+        if(!res) {
+            print_error("cannot move/delete/re-insert record");
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+boolean_t test_step8_search(tosdb_table_t* table, const char_t* colname, int64_t value, uint64_t expected, uint64_t* elapsed) {
+    tosdb_record_t* s_rec = tosdb_table_create_record(table);
+
+    if(!s_rec) {
+        print_error("cannot create search record");
+
+        return false;
+    }
+
+    if(strcmp(colname, "flag") == 0) {
+        s_rec->set_int8(s_rec, colname, value);
+    } else {
+        s_rec->set_int64(s_rec, colname, value);
+    }
+
+    time_t start = time_ns(NULL);
+
+    list_t* s_recs = s_rec->search_record(s_rec);
+
+    *elapsed += time_ns(NULL) - start;
+
+    s_rec->destroy(s_rec);
+
+    if(!s_recs) {
+        print_error("cannot search records");
+
+        return false;
+    }
+
+    boolean_t pass = true;
+    uint64_t count = 0;
+    int64_t prev_id = 0;
+
+    while(list_size(s_recs)) {
+        tosdb_record_t* rec = (tosdb_record_t*)list_queue_pop(s_recs);
+
+        int64_t id = 0;
+        int64_t col_value = 0;
+        int8_t flag = 0;
+        int64_t offset = 0;
+        char_t* symbol = NULL;
+
+        if(!rec->get_int64(rec, "id", &id) || !rec->get_int8(rec, "flag", &flag) ||
+           !rec->get_int64(rec, "offset", &offset) || !rec->get_string(rec, "symbol", &symbol)) {
+            print_error("cannot get columns of search result");
+            pass = false;
+        } else {
+            if(strcmp(colname, "flag") == 0) {
+                col_value = flag;
+            } else {
+                rec->get_int64(rec, colname, &col_value);
+            }
+
+            char_t* exp_symbol = sprintf("sym%lli", id);
+
+            // results are ordered by primary key and each key is returned once
+            if(col_value != value || offset != id * 8 || strcmp(symbol, exp_symbol) != 0 || id <= prev_id) {
+                printf("bad search result %s=%lli: id %lli value %lli offset %lli symbol %s\n", colname, value, id, col_value, offset, symbol);
+                pass = false;
+            }
+
+            prev_id = id;
+            count++;
+
+            memory_free(exp_symbol);
+        }
+
+        memory_free(symbol);
+        rec->destroy(rec);
+    }
+
+    list_destroy(s_recs);
+
+    if(count != expected) {
+        printf("search %s=%lli found %lli expected %lli\n", colname, value, count, expected);
+        pass = false;
+    }
+
+    return pass;
+}
+
+int32_t test_step8(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    tosdb_backend_t* backend = tosdb_backend_memory_new(TOSDB_CAP);
+
+    if(!backend) {
+        print_error("cannot create backend");
+        pass = false;
+
+        goto backend_failed;
+    }
+
+    tosdb_t* tosdb = test_step5_open(backend);
+
+    if(!tosdb) {
+        pass = false;
+
+        goto backend_close;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "coverdb");
+    tosdb_table_t* covered = tosdb_table_create_or_open(testdb, "covered", 128, 16 << 10, 2);
+    tosdb_table_t* plain = tosdb_table_create_or_open(testdb, "plain", 128, 16 << 10, 2);
+
+    if(!covered || !plain) {
+        print_error("cannot create/open tables");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    const char_t* covered_colnames[] = {"flag", "offset", "symbol"};
+
+    for(uint64_t i = 0; i < 2; i++) {
+        tosdb_table_t* table = i ? plain : covered;
+
+        if(!tosdb_table_column_add(table, "id", DATA_TYPE_INT64) ||
+           !tosdb_table_column_add(table, "section_id", DATA_TYPE_INT64) ||
+           !tosdb_table_column_add(table, "flag", DATA_TYPE_INT8) ||
+           !tosdb_table_column_add(table, "offset", DATA_TYPE_INT64) ||
+           !tosdb_table_column_add(table, "symbol", DATA_TYPE_STRING) ||
+           !tosdb_table_index_create(table, "id", TOSDB_INDEX_PRIMARY)) {
+            print_error("cannot create columns/indexes");
+            pass = false;
+
+            goto tdb_close;
+        }
+    }
+
+    if(!tosdb_table_index_create_covering(covered, "section_id", covered_colnames, 3) ||
+       !tosdb_table_index_create(plain, "section_id", TOSDB_INDEX_SECONDARY) ||
+       !tosdb_table_index_create(plain, "flag", TOSDB_INDEX_SECONDARY)) {
+        print_error("cannot create secondary indexes");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    const char_t* bad_colnames[] = {"missing"};
+
+    if(tosdb_table_index_create_covering(covered, "offset", bad_colnames, 1)) {
+        print_error("covering index with missing column is created");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    if(!test_step8_fill(covered) || !test_step8_fill(plain)) {
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    uint64_t expected_sections[TEST_STEP8_SECTION_COUNT] = {0};
+    uint64_t expected_moved = 0;
+    uint64_t expected_flag = 0;
+
+    for(int64_t id = 1; id <= TEST_STEP8_MAX_ID; id++) {
+        if(id % 10 == 0) {
+            continue;
+        }
+
+        if(id % 7 == 0) {
+            expected_moved++;
+        } else {
+            expected_sections[id % TEST_STEP8_SECTION_COUNT]++;
+        }
+
+        if(id % 2) {
+            expected_flag++;
+        }
+    }
+
+    for(uint64_t pass_no = 0; pass_no < 2; pass_no++) {
+        uint64_t covered_elapsed = 0;
+        uint64_t plain_elapsed = 0;
+
+        for(int64_t section_id = 0; section_id < TEST_STEP8_SECTION_COUNT; section_id++) {
+            pass &= test_step8_search(covered, "section_id", section_id, expected_sections[section_id], &covered_elapsed);
+            pass &= test_step8_search(plain, "section_id", section_id, expected_sections[section_id], &plain_elapsed);
+        }
+
+        pass &= test_step8_search(covered, "section_id", TEST_STEP8_MOVED_SECTION, expected_moved, &covered_elapsed);
+        pass &= test_step8_search(plain, "section_id", TEST_STEP8_MOVED_SECTION, expected_moved, &plain_elapsed);
+
+        printf("section searches: covering index %lli ns secondary index %lli ns\n", covered_elapsed, plain_elapsed);
+
+        uint64_t scan_elapsed = 0;
+
+        // half of table matches, planner reads all sources instead of fetching keys one by one
+        pass &= test_step8_search(plain, "flag", 1, expected_flag, &scan_elapsed);
+        // column without index is scanned
+        pass &= test_step8_search(plain, "offset", 16, 1, &scan_elapsed);
+        pass &= test_step8_search(plain, "offset", 80, 0, &scan_elapsed);
+
+        printf("full scan searches: %lli ns\n", scan_elapsed);
+
+        if(pass_no) {
+            break;
+        }
+
+        if(!tosdb_close(tosdb) || !tosdb_free(tosdb)) {
+            print_error("cannot close tosdb");
+            pass = false;
+
+            goto backend_close;
+        }
+
+        // covered columns of index are persisted
+        tosdb = test_step5_open(backend);
+
+        if(!tosdb) {
+            pass = false;
+
+            goto backend_close;
+        }
+
+        testdb = tosdb_database_create_or_open(tosdb, "coverdb");
+        covered = tosdb_table_create_or_open(testdb, "covered", 128, 16 << 10, 2);
+        plain = tosdb_table_create_or_open(testdb, "plain", 128, 16 << 10, 2);
+
+        if(!covered || !plain) {
+            print_error("cannot re-open tables");
+            pass = false;
+
+            goto tdb_close;
+        }
+    }
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+backend_close:
+    if(!tosdb_backend_close(backend)) {
+        pass = false;
+    }
+
+backend_failed:
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+    return pass?0:-1;
+}
+
+#define TEST_STEP9_MAX_ID 160
+#define TEST_STEP9_NAME_SIZE 1000
+
+char_t* test_step9_name(int64_t id) {
+    char_t* name = memory_malloc(TEST_STEP9_NAME_SIZE + 1);
+
+    if(!name) {
+        return NULL;
+    }
+
+    for(uint64_t i = 0; i < TEST_STEP9_NAME_SIZE; i++) {
+        name[i] = 'a' + ((id + i) % 26);
+    }
+
+    return name;
+}
+
+boolean_t test_step9_get(tosdb_table_t* table, int64_t id, uint64_t* unpacked) {
+    tosdb_table_stats_t stats = {0};
+
+    if(!tosdb_table_get_stats(table, &stats)) {
+        print_error("cannot get table stats");
+
+        return false;
+    }
+
+    uint64_t unpack_count = stats.valuelog_chunk_unpack_count;
+
+    tosdb_record_t* rec = tosdb_table_create_record(table);
+
+    if(!rec) {
+        print_error("cannot create record");
+
+        return false;
+    }
+
+    rec->set_int64(rec, "id", id);
+
+    boolean_t pass = true;
+
+    if(!rec->get_record(rec)) {
+        print_error("cannot get record %lli", id);
+        pass = false;
+    } else {
+        char_t* name = test_step9_name(id);
+        char_t* r_name = NULL;
+
+        if(!name || !rec->get_string(rec, "name", &r_name) || strcmp(name, r_name) != 0) {
+            print_error("value of record %lli mismatch", id);
+            pass = false;
+        }
+
+        memory_free(name);
+        memory_free(r_name);
+    }
+
+    rec->destroy(rec);
+
+    if(!pass || !tosdb_table_get_stats(table, &stats)) {
+        return false;
+    }
+
+    *unpacked = stats.valuelog_chunk_unpack_count - unpack_count;
+
+    return true;
+}
+
+int32_t test_step9(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    tosdb_backend_t* backend = tosdb_backend_memory_new(TOSDB_CAP);
+
+    if(!backend) {
+        print_error("cannot create backend");
+        pass = false;
+
+        goto backend_failed;
+    }
+
+    // without cache every get unpacks the chunks which its record spans
+    tosdb_t* tosdb = tosdb_new(backend, COMPRESSION_TYPE_DEFLATE);
+
+    if(!tosdb) {
+        print_error("cannot create tosdb");
+        pass = false;
+
+        goto backend_close;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "chunkdb");
+    tosdb_table_t* table = tosdb_table_create_or_open(testdb, "chunked", 1 << 10, 1 << 20, 2);
+
+    if(!table ||
+       !tosdb_table_column_add(table, "id", DATA_TYPE_INT64) ||
+       !tosdb_table_column_add(table, "name", DATA_TYPE_STRING) ||
+       !tosdb_table_index_create(table, "id", TOSDB_INDEX_PRIMARY)) {
+        print_error("cannot create chunked table");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    for(int64_t id = 1; id <= TEST_STEP9_MAX_ID && pass; id++) {
+        tosdb_record_t* rec = tosdb_table_create_record(table);
+        char_t* name = test_step9_name(id);
+
+        if(!rec || !name) {
+            print_error("cannot create record");
+            pass = false;
+        } else {
+            rec->set_int64(rec, "id", id);
+            rec->set_string(rec, "name", name);
+
+            if(!rec->upsert_record(rec)) {
+                print_error("cannot insert record");
+                pass = false;
+            }
+        }
+
+        memory_free(name);
+
+        if(rec) {
+            rec->destroy(rec);
+        }
+    }
+
+    if(!pass) {
+        goto tdb_close;
+    }
+
+    // records are read from the persisted valuelog after reopen
+    if(!tosdb_close(tosdb) || !tosdb_free(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+
+        goto backend_close;
+    }
+
+    tosdb = tosdb_new(backend, COMPRESSION_TYPE_DEFLATE);
+
+    if(!tosdb) {
+        print_error("cannot reopen tosdb");
+        pass = false;
+
+        goto backend_close;
+    }
+
+    testdb = tosdb_database_create_or_open(tosdb, "chunkdb");
+    table = tosdb_table_create_or_open(testdb, "chunked", 1 << 10, 1 << 20, 2);
+
+    if(!table) {
+        print_error("cannot open chunked table");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    uint64_t single_count = 0;
+    uint64_t crossing_count = 0;
+
+    for(int64_t id = 1; id <= TEST_STEP9_MAX_ID; id++) {
+        uint64_t unpacked = 0;
+
+        if(!test_step9_get(table, id, &unpacked)) {
+            pass = false;
+
+            break;
+        }
+
+        if(unpacked == 1) {
+            single_count++;
+        } else if(unpacked == 2) {
+            crossing_count++;
+        } else {
+            print_error("get of record %lli unpacked %lli chunks", id, unpacked);
+            pass = false;
+
+            break;
+        }
+    }
+
+    printf("chunked gets: single chunk %lli chunk boundary %lli\n", single_count, crossing_count);
+
+    if(pass && !crossing_count) {
+        print_error("no record crosses a valuelog chunk boundary");
+        pass = false;
+    }
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+backend_close:
+    if(!tosdb_backend_close(backend)) {
+        pass = false;
+    }
+
+backend_failed:
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+    return pass?0:-1;
+}
+
+boolean_t test_step10_add(tosdb_write_batch_t* batch, tosdb_table_t* table, int64_t id, boolean_t del) {
+    tosdb_record_t* rec = tosdb_table_create_record(table);
+
+    if(!rec) {
+        print_error("cannot create record");
+
+        return false;
+    }
+
+    rec->set_int64(rec, "id", id);
+
+    if(!del) {
+        rec->set_int64(rec, "group", id % 3);
+    }
+
+    boolean_t res = del ? tosdb_write_batch_delete(batch, rec) : tosdb_write_batch_upsert(batch, rec);
+
+    if(!res) {
+        print_error("cannot add record %lli to batch", id);
+        rec->destroy(rec);
+    }
+
+    return res;
+}
+
+boolean_t test_step10_exists(tosdb_table_t* table, int64_t id) {
+    tosdb_record_t* rec = tosdb_table_create_record(table);
+
+    if(!rec) {
+        return false;
+    }
+
+    rec->set_int64(rec, "id", id);
+
+    boolean_t res = rec->get_record(rec);
+
+    rec->destroy(rec);
+
+    return res;
+}
+
+int32_t test_step10(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    tosdb_backend_t* backend = tosdb_backend_memory_new(TOSDB_CAP);
+
+    if(!backend) {
+        print_error("cannot create backend");
+        pass = false;
+
+        goto backend_failed;
+    }
+
+    tosdb_t* tosdb = test_step5_open(backend);
+
+    if(!tosdb) {
+        print_error("cannot create tosdb");
+        pass = false;
+
+        goto backend_close;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "batchdb");
+    tosdb_table_t* tables[2] = {
+        tosdb_table_create_or_open(testdb, "first", 128, 16 << 10, 2),
+        tosdb_table_create_or_open(testdb, "second", 128, 16 << 10, 2),
+    };
+
+    // secondary index makes deletes of key only records load the record before applying
+    for(uint64_t i = 0; i < 2; i++) {
+        if(!tables[i] ||
+           !tosdb_table_column_add(tables[i], "id", DATA_TYPE_INT64) ||
+           !tosdb_table_column_add(tables[i], "group", DATA_TYPE_INT64) ||
+           !tosdb_table_index_create(tables[i], "id", TOSDB_INDEX_PRIMARY) ||
+           !tosdb_table_index_create(tables[i], "group", TOSDB_INDEX_SECONDARY)) {
+            print_error("cannot create batch tables");
+            pass = false;
+
+            goto tdb_close;
+        }
+    }
+
+    tosdb_write_batch_t* batch = tosdb_write_batch_new(tosdb);
+
+    if(!batch) {
+        print_error("cannot create write batch");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    // id 2 is deleted before the batch
+    if(!test_step10_add(batch, tables[0], 2, false) || !tosdb_write_batch_commit(batch) ||
+       !test_step10_add(batch, tables[0], 2, true) || !tosdb_write_batch_commit(batch)) {
+        print_error("cannot prepare deleted record");
+        pass = false;
+
+        goto batch_destroy;
+    }
+
+    // upsert then delete of a new key, upsert then delete of a deleted key, delete then upsert of a new key
+    if(!test_step10_add(batch, tables[0], 1, false) || !test_step10_add(batch, tables[1], 4, false) ||
+       !test_step10_add(batch, tables[0], 2, false) || !test_step10_add(batch, tables[0], 3, true) ||
+       !test_step10_add(batch, tables[0], 1, true) || !test_step10_add(batch, tables[0], 2, true) ||
+       !test_step10_add(batch, tables[0], 3, false) || !test_step10_add(batch, tables[0], 4, false)) {
+        pass = false;
+
+        goto batch_destroy;
+    }
+
+    if(!tosdb_write_batch_commit(batch)) {
+        print_error("cannot commit folded batch");
+        pass = false;
+
+        goto batch_destroy;
+    }
+
+    if(test_step10_exists(tables[0], 1) || test_step10_exists(tables[0], 2)) {
+        print_error("deleted keys of batch are found");
+        pass = false;
+    }
+
+    if(!test_step10_exists(tables[0], 3) || !test_step10_exists(tables[0], 4) || !test_step10_exists(tables[1], 4)) {
+        print_error("upserted keys of batch are not found");
+        pass = false;
+    }
+
+batch_destroy:
+    tosdb_write_batch_destroy(batch);
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+backend_close:
+    if(!tosdb_backend_close(backend)) {
+        pass = false;
+    }
+
+backend_failed:
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+    return pass?0:-1;
+}
+
+#define TEST_STEP11_WRITER_COUNT 4
+#define TEST_STEP11_RECORD_COUNT 1024
+
+int32_t test_step11(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    tosdb_backend_t* backend = tosdb_backend_memory_new(TOSDB_CAP);
+
+    if(!backend) {
+        print_error("cannot create backend");
+        pass = false;
+
+        goto backend_failed;
+    }
+
+    tosdb_t* tosdb = tosdb_new(backend, COMPRESSION_TYPE_NONE);
+
+    if(!tosdb) {
+        print_error("cannot create tosdb");
+        pass = false;
+
+        goto backend_close;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "ingestdb");
+    tosdb_table_t* table = tosdb_table_create_or_open(testdb, "records", 1 << 10, 1 << 20, 8);
+
+    if(!table ||
+       !tosdb_table_column_add(table, "id", DATA_TYPE_INT64) ||
+       !tosdb_table_column_add(table, "value", DATA_TYPE_INT64) ||
+       !tosdb_table_index_create(table, "id", TOSDB_INDEX_PRIMARY)) {
+        print_error("cannot create ingest table");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    uint64_t failed = 0;
+
+    // writers own disjoint id ranges and their upserts interleave, memtables rotate while ingesting
+    time_t start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_STEP11_RECORD_COUNT; i++) {
+        for(uint64_t w = 0; w < TEST_STEP11_WRITER_COUNT; w++) {
+            int64_t id = w * TEST_STEP11_RECORD_COUNT + i + 1;
+            tosdb_record_t* rec = tosdb_table_create_record(table);
+
+            if(!rec) {
+                failed++;
+
+                continue;
+            }
+
+            rec->set_int64(rec, "id", id);
+            rec->set_int64(rec, "value", id * 0x9E3779B97F4A7C15ULL);
+
+            if(!rec->upsert_record(rec)) {
+                failed++;
+            }
+
+            rec->destroy(rec);
+        }
+    }
+
+    time_t elapsed = time_ns(NULL) - start;
+
+    uint64_t record_count = TEST_STEP11_WRITER_COUNT * TEST_STEP11_RECORD_COUNT;
+
+    printf("ingest writers: %i records: %lli failed: %lli ns/record: %lli\n", TEST_STEP11_WRITER_COUNT, record_count, failed,
+           elapsed / record_count);
+
+    if(failed) {
+        print_error("cannot upsert records");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    for(uint64_t id = 1; id <= record_count; id++) {
+        tosdb_record_t* rec = tosdb_table_create_record(table);
+
+        if(!rec) {
+            pass = false;
+
+            break;
+        }
+
+        rec->set_int64(rec, "id", id);
+
+        int64_t value = 0;
+
+        if(!rec->get_record(rec) || !rec->get_int64(rec, "value", &value) || value != (int64_t)(id * 0x9E3779B97F4A7C15ULL)) {
+            print_error("ingested record %lli is wrong", id);
+            pass = false;
+        }
+
+        rec->destroy(rec);
+
+        if(!pass) {
+            break;
+        }
+    }
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+backend_close:
+    if(!tosdb_backend_close(backend)) {
+        pass = false;
+    }
+
+backend_failed:
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+    return pass?0:-1;
+}
+
 int32_t main(uint32_t argc, char_t** argv) {
     if(test_step1(argc, argv) != 0) {
         print_error("test step 1 failed");
@@ -1312,5 +3168,47 @@ int32_t main(uint32_t argc, char_t** argv) {
         return -1;
     }
 
+    if(test_step5(argc, argv) != 0) {
+        print_error("test step 5 failed");
+
+        return -1;
+    }
+
+    if(test_step6(argc, argv) != 0) {
+        print_error("test step 6 failed");
+
+        return -1;
+    }
+
+    if(test_step7(argc, argv) != 0) {
+        print_error("test step 7 failed");
+
+        return -1;
+    }
+
+    if(test_step8(argc, argv) != 0) {
+        print_error("test step 8 failed");
+
+        return -1;
+    }
+
+    if(test_step9(argc, argv) != 0) {
+        print_error("test step 9 failed");
+
+        return -1;
+    }
+
+    if(test_step10(argc, argv) != 0) {
+        print_error("test step 10 failed");
+
+        return -1;
+    }
+
+    if(test_step11(argc, argv) != 0) {
+        print_error("test step 11 failed");
+
+        return -1;
+    }
+
     return 0;
 }
@@ -18,6 +18,7 @@
 #include <data.h>
 #include <sha2.h>
 #include <bplustree.h>
+#include <skiplist.h>
 #include <map.h>
 #include <xxhash.h>
 #include <tosdb/tosdb.h>
@@ -37,6 +38,7 @@
 #include <quicksort.h>
 
 #define TOSDB_CAP (32 << 20)
+#define TEST_DB_FILE_BATCH_SIZE 1024
 
 int32_t main(uint32_t argc, char_t** argv);
 
@@ -356,16 +358,33 @@ int32_t main(uint32_t argc, char_t** argv) {
         TOKEN_DELIMETER_TYPE_NULL
     };
 
+    tosdb_write_batch_t* batch = tosdb_write_batch_new(tosdb);
+
+    if(!batch) {
+        print_error("cannot create write batch");
+        buffer_destroy(csv_buffer);
+        pass = false;
+
+        goto tdb_close;
+    }
+
     iterator_t* tokenizer = tokenizer_new(csv_buffer, delims, delims);
 
     if(!tokenizer) {
         print_error("cannot create tokenizer");
+        tosdb_write_batch_destroy(batch);
         buffer_destroy(csv_buffer);
         pass = false;
 
         goto tdb_close;
     }
 
+    uint64_t row = 0;
+    uint64_t single_count = 0;
+    uint64_t batch_count = 0;
+    time_t single_elapsed = 0;
+    time_t batch_elapsed = 0;
+
     while(tokenizer->end_of_iterator(tokenizer) != 0) {
         tosdb_record_t* rec = tosdb_table_create_record(table2);
 
@@ -413,13 +432,60 @@ int32_t main(uint32_t argc, char_t** argv) {
 
         memory_free(token);
 
-        rec->upsert_record(rec);
-        rec->destroy(rec);
+        // rows are written at alternating chunks with single upserts and write batches to compare them
+        if((row / TEST_DB_FILE_BATCH_SIZE) % 2 == 0) {
+            time_t start = time_ns(NULL);
+            rec->upsert_record(rec);
+            single_elapsed += time_ns(NULL) - start;
+            single_count++;
+
+            rec->destroy(rec);
+        } else {
+            time_t start = time_ns(NULL);
+
+            if(!tosdb_write_batch_upsert(batch, rec)) {
+                print_error("cannot add record to write batch");
+                rec->destroy(rec);
+                pass = false;
+
+                goto token_error;
+            }
+
+            if(tosdb_write_batch_size(batch) == TEST_DB_FILE_BATCH_SIZE && !tosdb_write_batch_commit(batch)) {
+                print_error("cannot commit write batch");
+                pass = false;
+
+                goto token_error;
+            }
+
+            batch_elapsed += time_ns(NULL) - start;
+            batch_count++;
+        }
+
+        row++;
 
         tokenizer = tokenizer->next(tokenizer);
     }
 
+    if(pass) {
+        time_t start = time_ns(NULL);
+
+        if(!tosdb_write_batch_commit(batch)) {
+            print_error("cannot commit write batch");
+            pass = false;
+        }
+
+        batch_elapsed += time_ns(NULL) - start;
+    }
+
+    if(pass && single_elapsed && batch_elapsed) {
+        printf("single upsert: %lli records/sec write batch: %lli records/sec\n",
+               (single_count * 1000000000ULL) / single_elapsed,
+               (batch_count * 1000000000ULL) / batch_elapsed);
+    }
+
 token_error:
+    tosdb_write_batch_destroy(batch);
     tokenizer->destroy(tokenizer);
 
     buffer_destroy(csv_buffer);
@@ -0,0 +1,629 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE (128 << 20)
+#include "setup.h"
+#include <disk.h>
+#include <utils.h>
+#include <buffer.h>
+#include <data.h>
+#include <bplustree.h>
+#include <skiplist.h>
+#include <map.h>
+#include <xxhash.h>
+#include <tosdb/tosdb.h>
+#include <strings.h>
+#include <bloomfilter.h>
+#include <math.h>
+#include <compression.h>
+#include <zpack.h>
+#include <deflate.h>
+#include <binarysearch.h>
+#include <set.h>
+#include <cache.h>
+#include <hashmap.h>
+#include <rbtree.h>
+#include <quicksort.h>
+#include <time.h>
+
+#define TOSDB_CAP (32 << 20)
+#define TEST_WAL_RECORD_COUNT 2000
+
+int32_t main(uint32_t argc, char_t** argv);
+
+typedef struct disk_file_context_t {
+    FILE*    fp_disk;
+    uint64_t file_size;
+    uint64_t block_size;
+} disk_file_context_t;
+
+memory_heap_t* disk_file_get_heap(const disk_or_partition_t* d);
+uint64_t       disk_file_get_disk_size(const disk_or_partition_t* d);
+uint64_t       disk_file_get_block_size(const disk_or_partition_t* d);
+int8_t         disk_file_write(const disk_or_partition_t* d, uint64_t lba, uint64_t count, uint8_t* data);
+int8_t         disk_file_read(const disk_or_partition_t* d, uint64_t lba, uint64_t count, uint8_t** data);
+int8_t         disk_file_close(const disk_or_partition_t* d);
+int8_t         disk_file_flush(const disk_or_partition_t* d);
+disk_t*        disk_file_open(const char_t* file_name, int64_t size);
+
+boolean_t test_wal_prepare(tosdb_backend_t* backend);
+boolean_t test_wal_bench(tosdb_backend_t* backend, const char_t* backend_name, uint64_t group_commit_size);
+boolean_t test_wal_replay(tosdb_backend_t* backend);
+boolean_t test_wal_trim(tosdb_backend_t* backend);
+boolean_t test_wal_upsert_range(tosdb_table_t* tbl, int64_t start, int64_t end);
+boolean_t test_wal_check_record(tosdb_table_t* tbl, int64_t id, boolean_t exists);
+
+memory_heap_t* disk_file_get_heap(const disk_or_partition_t* d) {
+    UNUSED(d);
+    return memory_get_heap(NULL);
+}
+
+uint64_t disk_file_get_disk_size(const disk_or_partition_t* d){
+    disk_file_context_t* ctx = (disk_file_context_t*)d->context;
+    return ctx->file_size;
+}
+
+uint64_t disk_file_get_block_size(const disk_or_partition_t* d){
+    disk_file_context_t* ctx = (disk_file_context_t*)d->context;
+    return ctx->block_size;
+}
+
+int8_t disk_file_write(const disk_or_partition_t* d, uint64_t lba, uint64_t count, uint8_t* data) {
+    disk_file_context_t* ctx = (disk_file_context_t*)d->context;
+
+    fseek(ctx->fp_disk, lba * ctx->block_size, SEEK_SET);
+
+    fwrite(data, count * ctx->block_size, 1, ctx->fp_disk);
+
+    return 0;
+}
+
+int8_t disk_file_read(const disk_or_partition_t* d, uint64_t lba, uint64_t count, uint8_t** data){
+    disk_file_context_t* ctx = (disk_file_context_t*)d->context;
+
+    fseek(ctx->fp_disk, lba * ctx->block_size, SEEK_SET);
+
+    *data = memory_malloc(count * ctx->block_size);
+    fread(*data, count * ctx->block_size, 1, ctx->fp_disk);
+
+    return 0;
+}
+
+int8_t disk_file_close(const disk_or_partition_t* d) {
+    disk_file_context_t* ctx = (disk_file_context_t*)d->context;
+    fclose(ctx->fp_disk);
+
+    memory_free(ctx);
+
+    memory_free((void*)d);
+
+    return 0;
+}
+
+int8_t disk_file_flush(const disk_or_partition_t* d) {
+    disk_file_context_t* ctx = (disk_file_context_t*)d->context;
+    fflush(ctx->fp_disk);
+
+    return 0;
+}
+
+disk_t* disk_file_open(const char_t* file_name, int64_t size) {
+    FILE* fp_disk = fopen(file_name, "w");
+    uint8_t data = 0;
+    fseek(fp_disk, size - 1, SEEK_SET);
+    fwrite(&data, 1, 1, fp_disk);
+    fclose(fp_disk);
+
+    fp_disk = fopen(file_name, "r+");
+
+    disk_file_context_t* ctx = memory_malloc(sizeof(disk_file_context_t));
+
+    if(ctx == NULL) {
+        fclose(fp_disk);
+
+        return NULL;
+    }
+
+    ctx->fp_disk = fp_disk;
+    ctx->file_size = size;
+    ctx->block_size = 512;
+
+    disk_t* d = memory_malloc(sizeof(disk_t));
+
+    if(d == NULL) {
+        memory_free(ctx);
+        fclose(fp_disk);
+
+        return NULL;
+    }
+
+    d->disk.context = ctx;
+    d->disk.get_heap = disk_file_get_heap;
+    d->disk.get_size = disk_file_get_disk_size;
+    d->disk.get_block_size = disk_file_get_block_size;
+    d->disk.write = disk_file_write;
+    d->disk.read = disk_file_read;
+    d->disk.close = disk_file_close;
+    d->disk.flush = disk_file_flush;
+
+    return d;
+}
+
+boolean_t test_wal_prepare(tosdb_backend_t* backend) {
+    boolean_t pass = true;
+
+    tosdb_t* tosdb = tosdb_new(backend, COMPRESSION_TYPE_ZPACK);
+
+    if(!tosdb) {
+        print_error("cannot create tosdb");
+
+        return false;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "testdb");
+
+    if(!testdb) {
+        print_error("cannot create testdb");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    tosdb_table_t* tbl = tosdb_table_create_or_open(testdb, "wal", 1 << 10, 128 << 10, 8);
+
+    if(!tbl) {
+        print_error("cannot create table wal");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    if(!tosdb_table_column_add(tbl, "id", DATA_TYPE_INT64)) {
+        print_error("cannot add id column");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    if(!tosdb_table_column_add(tbl, "name", DATA_TYPE_STRING)) {
+        print_error("cannot add name column");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    if(!tosdb_table_index_create(tbl, "id", TOSDB_INDEX_PRIMARY)) {
+        print_error("cannot create primary index");
+        pass = false;
+    }
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+    return pass;
+}
+
+boolean_t test_wal_bench(tosdb_backend_t* backend, const char_t* backend_name, uint64_t group_commit_size) {
+    if(!test_wal_prepare(backend)) {
+        return false;
+    }
+
+    boolean_t pass = true;
+
+    tosdb_t* tosdb = tosdb_new(backend, COMPRESSION_TYPE_ZPACK);
+
+    if(!tosdb) {
+        print_error("cannot open tosdb");
+
+        return false;
+    }
+
+    tosdb_wal_config_t wc = {0};
+    wc.group_commit_size = group_commit_size;
+
+    if(!tosdb_wal_config_set(tosdb, &wc)) {
+        print_error("cannot set wal config");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "testdb");
+    tosdb_table_t* tbl = tosdb_table_create_or_open(testdb, "wal", 1 << 10, 128 << 10, 8);
+
+    if(!tbl) {
+        print_error("cannot open table wal");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    time_t start = time_ns(NULL);
+
+    for(int64_t i = 1; i <= TEST_WAL_RECORD_COUNT; i++) {
+        tosdb_record_t* rec = tosdb_table_create_record(tbl);
+
+        if(!rec) {
+            print_error("cannot create record");
+            pass = false;
+
+            break;
+        }
+
+        char_t* name = sprintf("name-%lli", i);
+
+        rec->set_int64(rec, "id", i);
+        rec->set_string(rec, "name", name);
+
+        memory_free(name);
+
+        if(!rec->upsert_record(rec)) {
+            print_error("cannot upsert record %lli", i);
+            pass = false;
+        }
+
+        rec->destroy(rec);
+
+        if(!pass) {
+            break;
+        }
+    }
+
+    time_t elapsed = time_ns(NULL) - start;
+
+    // a single writer never has company at its group, so each upsert is committed alone
+    if(pass) {
+        printf("%s backend group commit size %lli: %lli records/sec\n",
+               backend_name, group_commit_size,
+               (TEST_WAL_RECORD_COUNT * 1000000000ULL) / elapsed);
+    }
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+    return pass;
+}
+
+boolean_t test_wal_upsert_range(tosdb_table_t* tbl, int64_t start, int64_t end) {
+    for(int64_t i = start; i <= end; i++) {
+        tosdb_record_t* rec = tosdb_table_create_record(tbl);
+
+        if(!rec) {
+            print_error("cannot create record");
+
+            return false;
+        }
+
+        char_t* name = sprintf("name-%lli", i);
+
+        rec->set_int64(rec, "id", i);
+        rec->set_string(rec, "name", name);
+
+        memory_free(name);
+
+        boolean_t res = rec->upsert_record(rec);
+
+        rec->destroy(rec);
+
+        if(!res) {
+            print_error("cannot upsert record %lli", i);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+boolean_t test_wal_check_record(tosdb_table_t* tbl, int64_t id, boolean_t exists) {
+    boolean_t pass = true;
+
+    tosdb_record_t* rec = tosdb_table_create_record(tbl);
+    rec->set_int64(rec, "id", id);
+
+    if(!rec->get_record(rec)) {
+        if(exists) {
+            print_error("record %lli not replayed from wal", id);
+            pass = false;
+        }
+    } else if(!exists) {
+        print_error("deleted record %lli is replayed", id);
+        pass = false;
+    } else {
+        char_t* r_name = NULL;
+        char_t* name = sprintf("name-%lli", id);
+
+        if(!rec->get_string(rec, "name", &r_name) || strcmp(r_name, name) != 0) {
+            print_error("replayed record %lli value mismatch", id);
+            pass = false;
+        }
+
+        memory_free(name);
+        memory_free(r_name);
+    }
+
+    rec->destroy(rec);
+
+    return pass;
+}
+
+boolean_t test_wal_replay(tosdb_backend_t* backend) {
+    if(!test_wal_prepare(backend)) {
+        return false;
+    }
+
+    boolean_t pass = true;
+
+    tosdb_t* tosdb = tosdb_new(backend, COMPRESSION_TYPE_ZPACK);
+
+    if(!tosdb) {
+        print_error("cannot open tosdb");
+
+        return false;
+    }
+
+    tosdb_wal_config_t wc = {0};
+    wc.group_commit_size = 8;
+
+    tosdb_wal_config_set(tosdb, &wc);
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "testdb");
+    tosdb_table_t* tbl = tosdb_table_create_or_open(testdb, "wal", 1 << 10, 128 << 10, 8);
+
+    pass &= test_wal_upsert_range(tbl, 1, 100);
+
+    tosdb_record_t* rec = tosdb_table_create_record(tbl);
+    rec->set_int64(rec, "id", 50);
+
+    if(!rec->delete_record(rec)) {
+        print_error("cannot delete record");
+        pass = false;
+    }
+
+    rec->destroy(rec);
+
+    // table is created after last persist, its metadata should be checkpointed before its first record
+    tosdb_database_t* newdb = tosdb_database_create_or_open(tosdb, "newdb");
+    tosdb_table_t* new_tbl = tosdb_table_create_or_open(newdb, "wal_new", 1 << 10, 128 << 10, 8);
+
+    if(!new_tbl || !tosdb_table_column_add(new_tbl, "id", DATA_TYPE_INT64) ||
+       !tosdb_table_column_add(new_tbl, "name", DATA_TYPE_STRING) ||
+       !tosdb_table_index_create(new_tbl, "id", TOSDB_INDEX_PRIMARY)) {
+        print_error("cannot create table wal_new");
+        pass = false;
+    } else {
+        pass &= test_wal_upsert_range(new_tbl, 1, 10);
+    }
+
+    // simulate crash without commit: nothing is persisted except acknowledged wal records
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+
+        return false;
+    }
+
+    tosdb = tosdb_new(backend, COMPRESSION_TYPE_ZPACK);
+
+    if(!tosdb) {
+        print_error("cannot reopen tosdb");
+
+        return false;
+    }
+
+    testdb = tosdb_database_create_or_open(tosdb, "testdb");
+    tbl = tosdb_table_create_or_open(testdb, "wal", 1 << 10, 128 << 10, 8);
+
+    if(!tbl) {
+        print_error("cannot reopen table wal");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    pass &= test_wal_check_record(tbl, 42, true);
+    pass &= test_wal_check_record(tbl, 100, true);
+    pass &= test_wal_check_record(tbl, 50, false);
+
+    newdb = tosdb_database_create_or_open(tosdb, "newdb");
+    new_tbl = tosdb_table_create_or_open(newdb, "wal_new", 1 << 10, 128 << 10, 8);
+
+    if(!new_tbl) {
+        print_error("cannot reopen table wal_new");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    pass &= test_wal_check_record(new_tbl, 10, true);
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+    return pass;
+}
+
+boolean_t test_wal_trim(tosdb_backend_t* backend) {
+    if(!test_wal_prepare(backend)) {
+        return false;
+    }
+
+    boolean_t pass = true;
+
+    tosdb_t* tosdb = tosdb_new(backend, COMPRESSION_TYPE_ZPACK);
+
+    if(!tosdb) {
+        print_error("cannot open tosdb");
+
+        return false;
+    }
+
+    tosdb_database_t* testdb = tosdb_database_create_or_open(tosdb, "testdb");
+    tosdb_table_t* tbl = tosdb_table_create_or_open(testdb, "wal", 1 << 6, 128 << 10, 8);
+
+    // memtable is rotated a few times, each rotation checkpoints it
+    pass &= test_wal_upsert_range(tbl, 1, 300);
+
+    tosdb_wal_stats_t stats = {0};
+
+    if(!tosdb_wal_get_stats(tosdb, &stats) || stats.first_sequence <= 1 || stats.committed_sequence < stats.first_sequence) {
+        print_error("wal is not trimmed after memtable persist");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+
+        return false;
+    }
+
+    tosdb = tosdb_new(backend, COMPRESSION_TYPE_ZPACK);
+
+    if(!tosdb) {
+        print_error("cannot reopen tosdb");
+
+        return false;
+    }
+
+    testdb = tosdb_database_create_or_open(tosdb, "testdb");
+    tbl = tosdb_table_create_or_open(testdb, "wal", 1 << 6, 128 << 10, 8);
+
+    if(!tbl) {
+        print_error("cannot reopen table wal");
+        pass = false;
+
+        goto tdb_close;
+    }
+
+    for(int64_t i = 1; i <= 300; i += 23) {
+        pass &= test_wal_check_record(tbl, i, true);
+    }
+
+    pass &= test_wal_check_record(tbl, 300, true);
+
+tdb_close:
+    if(!tosdb_close(tosdb)) {
+        print_error("cannot close tosdb");
+        pass = false;
+    }
+
+    if(!tosdb_free(tosdb)) {
+        print_error("cannot free tosdb");
+        pass = false;
+    }
+
+    return pass;
+}
+
+int32_t main(uint32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    boolean_t pass = true;
+
+    tosdb_backend_t* backend = tosdb_backend_memory_new(TOSDB_CAP);
+
+    if(!backend) {
+        print_error("cannot create backend");
+
+        return -1;
+    }
+
+    if(!test_wal_replay(backend)) {
+        print_error("wal replay failed");
+        pass = false;
+    }
+
+    tosdb_backend_close(backend);
+
+    backend = tosdb_backend_memory_new(TOSDB_CAP);
+
+    if(!backend) {
+        print_error("cannot create backend");
+
+        return -1;
+    }
+
+    if(pass && !test_wal_trim(backend)) {
+        print_error("wal trim failed");
+        pass = false;
+    }
+
+    tosdb_backend_close(backend);
+
+    uint64_t group_commit_sizes[] = {0, 1, 8, 64, 512};
+
+    for(uint64_t i = 0; pass && i < sizeof(group_commit_sizes) / sizeof(uint64_t); i++) {
+        backend = tosdb_backend_memory_new(TOSDB_CAP);
+
+        if(!backend) {
+            print_error("cannot create backend");
+            pass = false;
+
+            break;
+        }
+
+        pass = test_wal_bench(backend, "memory", group_commit_sizes[i]);
+
+        tosdb_backend_close(backend);
+    }
+
+    for(uint64_t i = 0; pass && i < sizeof(group_commit_sizes) / sizeof(uint64_t); i++) {
+        disk_t* d = disk_file_open("tmp/tosdb-wal.img", TOSDB_CAP);
+
+        if(!d) {
+            print_error("cannot create disk");
+            pass = false;
+
+            break;
+        }
+
+        backend = tosdb_backend_disk_new((disk_or_partition_t*)d);
+
+        if(!backend) {
+            print_error("cannot create backend");
+            d->disk.close((disk_or_partition_t*)d);
+            pass = false;
+
+            break;
+        }
+
+        pass = test_wal_bench(backend, "disk", group_commit_sizes[i]);
+
+        tosdb_backend_close(backend);
+        d->disk.close((disk_or_partition_t*)d);
+    }
+
+    if(pass) {
+        print_success("TESTS PASSED");
+    } else {
+        print_error("TESTS FAILED");
+    }
+
+    return pass ? 0 : -1;
+}
@@ -0,0 +1,352 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE (256ULL << 20)
+#include <memory/frame.h>
+#include <memory/paging.h>
+#include <systeminfo.h>
+#include <efi.h>
+#include <bplustree.h>
+#include <list.h>
+#include "setup.h"
+
+#define TEST_FA_PHYSICAL_SIZE  (64ULL << 20)
+#define TEST_FA_PHYSICAL_ALIGN (32ULL << 20)
+#define TEST_FA_MMAP_COUNT     5
+#define TEST_FA_SLOT_COUNT     256
+#define TEST_FA_OP_COUNT       (1 << 16)
+#define TEST_FA_BLOCK_COUNT    16
+
+int32_t  main(int32_t argc, char_t** argv);
+uint32_t test_fa_cpu_id(void);
+uint64_t test_fa_bench(frame_allocator_t* fa, frame_t** slots, uint64_t frame_count);
+int8_t   test_fa_allocations(frame_allocator_t* fa, uint64_t physical_start);
+int8_t   test_fa_system_frames(frame_allocator_t* fa, uint64_t physical_start);
+
+// host memory is used as physical memory, so all frames are identity mapped
+int8_t memory_paging_get_physical_address_ext(memory_page_table_context_t* table_context, uint64_t virtual_address, uint64_t* physical_address) {
+    UNUSED(table_context);
+
+    *physical_address = virtual_address;
+
+    return 0;
+}
+
+int8_t memory_paging_add_va_for_frame_ext(memory_page_table_context_t* table_context, uint64_t va_start, frame_t* frm, memory_paging_page_type_t type) {
+    UNUSED(table_context);
+    UNUSED(va_start);
+    UNUSED(frm);
+    UNUSED(type);
+
+    return 0;
+}
+
+int8_t memory_paging_delete_va_for_frame_ext(memory_page_table_context_t* table_context, uint64_t va_start, frame_t* frm) {
+    UNUSED(table_context);
+    UNUSED(va_start);
+    UNUSED(frm);
+
+    return 0;
+}
+
+uint32_t test_fa_cpu_id(void) {
+    return 0;
+}
+
+uint64_t test_fa_bench(frame_allocator_t* fa, frame_t** slots, uint64_t frame_count) {
+    uint64_t seed = 0x1234567;
+
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_FA_OP_COUNT; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+
+        uint64_t slot = seed % TEST_FA_SLOT_COUNT;
+
+        if(slots[slot]) {
+            fa->release_frame(fa, slots[slot]);
+            memory_free(slots[slot]);
+            slots[slot] = NULL;
+        }
+
+        if(fa->allocate_frame_by_count(fa, frame_count, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_USED, &slots[slot], NULL) != 0) {
+            print_error("cannot allocate frames at op %lli", i);
+
+            break;
+        }
+    }
+
+    uint64_t elapsed = time_ns(NULL) - start;
+
+    for(uint64_t i = 0; i < TEST_FA_SLOT_COUNT; i++) {
+        if(slots[i]) {
+            fa->release_frame(fa, slots[i]);
+            memory_free(slots[i]);
+            slots[i] = NULL;
+        }
+    }
+
+    return elapsed;
+}
+
+int8_t test_fa_allocations(frame_allocator_t* fa, uint64_t physical_start) {
+    uint64_t free_frame_count = fa->get_free_frame_count(fa);
+    frame_t* f = NULL;
+
+    if(fa->allocate_frame_by_count(fa, 100, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_USED, &f, NULL) != 0) {
+        print_error("cannot allocate block");
+
+        return -1;
+    }
+
+    if(f->frame_address < physical_start || f->frame_address + 100 * FRAME_SIZE > physical_start + TEST_FA_PHYSICAL_SIZE ||
+       (f->frame_address - physical_start) % (128 * FRAME_SIZE)) {
+        print_error("block address 0x%llx is wrong", f->frame_address);
+        memory_free(f);
+
+        return -1;
+    }
+
+    if(fa->get_free_frame_count(fa) != free_frame_count - 100) {
+        print_error("free frame count is not decreased");
+        memory_free(f);
+
+        return -1;
+    }
+
+    memory_memset((void*)f->frame_address, 0xAA, 100 * FRAME_SIZE);
+
+    if(fa->release_frame(fa, f) != 0) {
+        print_error("cannot release block");
+        memory_free(f);
+
+        return -1;
+    }
+
+    if(fa->release_frame(fa, f) == 0) {
+        print_error("double release is not detected");
+        memory_free(f);
+
+        return -1;
+    }
+
+    uint8_t* data = (uint8_t*)f->frame_address;
+
+    memory_free(f);
+
+    for(uint64_t i = 0; i < 100 * FRAME_SIZE; i++) {
+        if(data[i]) {
+            print_error("released frames are not cleaned");
+
+            return -1;
+        }
+    }
+
+    // all released frames should be merged back, so first region can be allocated as one block
+    if(fa->allocate_frame_by_count(fa, 8192, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_USED, &f, NULL) != 0) {
+        print_error("buddies are not merged");
+
+        return -1;
+    }
+
+    if(f->frame_address != physical_start) {
+        print_error("large block address 0x%llx is wrong", f->frame_address);
+        memory_free(f);
+
+        return -1;
+    }
+
+    fa->release_frame(fa, f);
+    memory_free(f);
+
+    frame_t fixed = {physical_start + (4ULL << 20), 16, FRAME_TYPE_USED, 0};
+
+    if(fa->allocate_frame(fa, &fixed) != 0) {
+        print_error("cannot allocate fixed frames");
+
+        return -1;
+    }
+
+    if(fa->allocate_frame(fa, &fixed) == 0) {
+        print_error("fixed frames are allocated twice");
+
+        return -1;
+    }
+
+    if(fa->release_frame(fa, &fixed) != 0) {
+        print_error("cannot release fixed frames");
+
+        return -1;
+    }
+
+    if(fa->allocate_frame_by_count(fa, 4, FRAME_ALLOCATION_TYPE_BLOCK | FRAME_ALLOCATION_TYPE_RESERVED, &f, NULL) != 0) {
+        print_error("cannot allocate reserved frames");
+
+        return -1;
+    }
+
+    if(fa->get_reserved_frames_of_address(fa, (void*)(f->frame_address + FRAME_SIZE)) != f) {
+        print_error("reserved frames are not found");
+
+        return -1;
+    }
+
+    frame_t part = {f->frame_address + FRAME_SIZE, 2, FRAME_TYPE_RESERVED, 0};
+
+    if(fa->release_frame(fa, &part) != 0) {
+        print_error("cannot release part of reserved frames");
+
+        return -1;
+    }
+
+    frame_t* rf = fa->get_reserved_frames_of_address(fa, (void*)(part.frame_address + 2 * FRAME_SIZE));
+
+    if(rf == NULL || rf->frame_count != 1) {
+        print_error("reserved frames are not split");
+
+        return -1;
+    }
+
+    fa->release_frame(fa, rf);
+
+    rf = fa->get_reserved_frames_of_address(fa, (void*)(part.frame_address - FRAME_SIZE));
+
+    if(rf == NULL || rf->frame_count != 1) {
+        print_error("reserved frames are not split");
+
+        return -1;
+    }
+
+    fa->release_frame(fa, rf);
+
+    if(fa->get_free_frame_count(fa) != free_frame_count) {
+        print_error("free frame count 0x%llx is not restored 0x%llx", fa->get_free_frame_count(fa), free_frame_count);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+int8_t test_fa_system_frames(frame_allocator_t* fa, uint64_t physical_start) {
+    uint64_t free_frame_count = fa->get_free_frame_count(fa);
+
+    // half of system frames are free, other half is inside acpi reclaim memory
+    frame_t system = {physical_start + (31ULL << 20), 512, FRAME_TYPE_RESERVED, 0};
+
+    if(fa->reserve_system_frames(fa, &system) != 0) {
+        print_error("cannot reserve system frames");
+
+        return -1;
+    }
+
+    if(fa->get_free_frame_count(fa) != free_frame_count - 256) {
+        print_error("system frames are not reserved");
+
+        return -1;
+    }
+
+    if(fa->release_acpi_reclaim_memory(fa) != 0 || fa->get_free_frame_count(fa) != free_frame_count) {
+        print_error("acpi reclaim memory is not released");
+
+        return -1;
+    }
+
+    return 0;
+}
+
+int32_t main(int32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    uint8_t* physical = memory_malloc_aligned(TEST_FA_PHYSICAL_SIZE, TEST_FA_PHYSICAL_ALIGN);
+    efi_memory_descriptor_t* mmap = memory_malloc(sizeof(efi_memory_descriptor_t) * TEST_FA_MMAP_COUNT);
+    system_info_t* sysinfo = memory_malloc(sizeof(system_info_t));
+    frame_t** slots = memory_malloc(sizeof(frame_t*) * TEST_FA_SLOT_COUNT);
+
+    if(!physical || !mmap || !sysinfo || !slots) {
+        print_error("cannot allocate test memory");
+
+        return -1;
+    }
+
+    uint64_t physical_start = (uint64_t)physical;
+
+    mmap[0] = (efi_memory_descriptor_t){EFI_CONVENTIONAL_MEMORY, physical_start, 0, 8192, 0};
+    mmap[1] = (efi_memory_descriptor_t){EFI_ACPI_RECLAIM_MEMORY, physical_start + (32ULL << 20), 0, 256, 0};
+    mmap[2] = (efi_memory_descriptor_t){EFI_CONVENTIONAL_MEMORY, physical_start + (33ULL << 20), 0, 3840, 0};
+    mmap[3] = (efi_memory_descriptor_t){EFI_RESERVED_MEMORY_TYPE, physical_start + (48ULL << 20), 0, 256, 0};
+    mmap[4] = (efi_memory_descriptor_t){EFI_LOADER_DATA, physical_start + (49ULL << 20), 0, 3840, 0};
+
+    sysinfo->mmap_data = (uint8_t*)mmap;
+    sysinfo->mmap_size = sizeof(efi_memory_descriptor_t) * TEST_FA_MMAP_COUNT;
+    sysinfo->mmap_descriptor_size = sizeof(efi_memory_descriptor_t);
+
+    SYSTEM_INFO = sysinfo;
+
+    frame_allocator_t* fa = frame_allocator_new();
+
+    if(fa == NULL) {
+        print_error("cannot create frame allocator");
+
+        return -1;
+    }
+
+    if(fa->get_total_frame_count(fa) != TEST_FA_PHYSICAL_SIZE / FRAME_SIZE || fa->get_free_frame_count(fa) != 8192 + 3840 + 3840) {
+        print_error("frame counts are wrong total 0x%llx free 0x%llx", fa->get_total_frame_count(fa), fa->get_free_frame_count(fa));
+
+        return -1;
+    }
+
+    if(test_fa_allocations(fa, physical_start) != 0) {
+        return -1;
+    }
+
+    uint64_t buddy_single = test_fa_bench(fa, slots, 1);
+    uint64_t buddy_block = test_fa_bench(fa, slots, TEST_FA_BLOCK_COUNT);
+
+    if(frame_allocator_enable_cpu_cache(fa, test_fa_cpu_id) != 0) {
+        print_error("cannot enable cpu cache");
+
+        return -1;
+    }
+
+    uint64_t free_frame_count = fa->get_free_frame_count(fa);
+
+    uint64_t cache_single = test_fa_bench(fa, slots, 1);
+    uint64_t cache_block = test_fa_bench(fa, slots, TEST_FA_BLOCK_COUNT);
+
+    if(fa->get_free_frame_count(fa) != free_frame_count) {
+        print_error("free frame count is not restored after cpu cache usage");
+
+        return -1;
+    }
+
+    // frames waiting at cpu cache should be allocatable by address
+    if(test_fa_allocations(fa, physical_start) != 0) {
+        return -1;
+    }
+
+    if(test_fa_system_frames(fa, physical_start) != 0) {
+        return -1;
+    }
+
+    printf("single frame: buddy %lli ns/op cpu cache %lli ns/op\n", buddy_single / TEST_FA_OP_COUNT, cache_single / TEST_FA_OP_COUNT);
+    printf("%i frame block: buddy %lli ns/op with cpu cache %lli ns/op\n", TEST_FA_BLOCK_COUNT, buddy_block / TEST_FA_OP_COUNT, cache_block / TEST_FA_OP_COUNT);
+
+    frame_allocator_destroy(fa);
+    SYSTEM_INFO = NULL;
+
+    memory_free(slots);
+    memory_free(sysinfo);
+    memory_free(mmap);
+    memory_free(physical);
+
+    print_success("TESTS PASSED");
+
+    return 0;
+}
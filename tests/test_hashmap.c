@@ -3,12 +3,52 @@
  * Please read and understand latest version of Licence.
  */
 
+#define RAMSIZE (64 << 20)
 #include "setup.h"
 #include <hashmap.h>
 #include <strings.h>
 #include <xxhash.h>
+#include <time.h>
 
 int32_t main(uint32_t argc, char_t** argv);
+void    test_hashmap_reclaimer(void* data);
+int8_t  test_hashmap_racing_kc(const void* item1, const void* item2);
+
+static uint64_t   test_hashmap_reclaimed = 0;
+static hashmap_t* test_hashmap_race_map = NULL;
+static boolean_t  test_hashmap_race_armed = false;
+static uint64_t   test_hashmap_race_freed = 0;
+
+void test_hashmap_reclaimer(void* data) {
+    test_hashmap_reclaimed += (uint64_t)data;
+}
+
+/**
+ * @brief key comparator which runs writes in the middle of a get, as a writer at another cpu would do
+ * @details armed comparator puts keys until the resize of map ends and counts frees done by them
+ */
+int8_t test_hashmap_racing_kc(const void* item1, const void* item2) {
+    if(test_hashmap_race_armed) {
+        test_hashmap_race_armed = false;
+
+        memory_heap_stat_t stat = {0};
+        memory_get_heap_stat(&stat);
+        uint64_t free_count = stat.free_count;
+
+        for(uint64_t i = 1000; i < 1064; i++) {
+            hashmap_put(test_hashmap_race_map, (void*)i, (void*)i);
+        }
+
+        memory_get_heap_stat(&stat);
+        test_hashmap_race_freed = stat.free_count - free_count;
+    }
+
+    if(item1 == item2) {
+        return 0;
+    }
+
+    return item1 < item2 ? -1 : 1;
+}
 
 int32_t main(uint32_t argc, char_t** argv) {
     UNUSED(argc);
@@ -118,11 +158,256 @@ int32_t main(uint32_t argc, char_t** argv) {
 
     hashmap_destroy(hm);
 
+    // maps created small and grown far past their capacity, like hashmap_integer(128) users
+    hm = hashmap_integer(128);
+
+    const uint64_t bench_count = 20000;
+
+    time_t start = time_ns(NULL);
+
+    for(uint64_t i = 1; i <= bench_count; i++) {
+        hashmap_put(hm, (void*)(i * 4096), (void*)i);
+    }
+
+    time_t put_elapsed = time_ns(NULL) - start;
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 1; i <= bench_count; i++) {
+        if(hashmap_get(hm, (void*)(i * 4096)) != (void*)i) {
+            pass = false;
+        }
+
+        if(hashmap_exists(hm, (void*)(i * 4096 + 1))) {
+            pass = false;
+        }
+    }
+
+    time_t get_elapsed = time_ns(NULL) - start;
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 1; i <= bench_count; i += 2) {
+        hashmap_delete(hm, (void*)(i * 4096));
+    }
+
+    time_t delete_elapsed = time_ns(NULL) - start;
+
+    if(hashmap_size(hm) != bench_count / 2) {
+        print_error("wrong size after deletes");
+        pass = false;
+    }
+
+    uint64_t iter_count = 0;
+
+    iter = hashmap_iterator_create(hm);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        uint64_t v = (uint64_t)iter->get_item(iter);
+
+        if(v % 2 || (uint64_t)iter->get_extra_data(iter) != v * 4096) {
+            pass = false;
+        }
+
+        iter_count++;
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(iter_count != bench_count / 2) {
+        print_error("wrong iterated item count");
+        pass = false;
+    }
+
+    for(uint64_t i = 1; i <= bench_count; i++) {
+        const void* v = hashmap_get(hm, (void*)(i * 4096));
+
+        if((i % 2 && v) || (!(i % 2) && v != (void*)i)) {
+            pass = false;
+        }
+    }
+
+    printf("hashmap %lli items: put %lli ns/op get+miss %lli ns/op delete %lli ns/op\n", bench_count,
+           put_elapsed / bench_count, get_elapsed / bench_count, delete_elapsed / (bench_count / 2));
+
+    hashmap_destroy(hm);
+
+    // insert/delete churn at constant size fills table with deleted slots, table is rebuilt without growing
+    hm = hashmap_integer(16);
+
+    for(uint64_t i = 1; i <= 10000; i++) {
+        hashmap_put(hm, (void*)i, (void*)i);
+
+        if(i > 8) {
+            hashmap_delete(hm, (void*)(i - 8));
+        }
+
+        if(hashmap_size(hm) != MIN(i, 8ULL) || hashmap_get(hm, (void*)i) != (void*)i) {
+            print_error("wrong map after churn");
+            pass = false;
+
+            break;
+        }
+    }
+
+    hashmap_destroy(hm);
+
+    // moved tables of plain map are reclaimed by next writes, 200 keys churn slowly fills groups with deleted slots and table is
+    // rebuilt several times, heap usage stays flat
+    hm = hashmap_integer(128);
+
+    memory_heap_stat_t stat = {0};
+    uint64_t churn_used = 0;
+
+    for(uint64_t i = 1; i <= 10 * bench_count; i++) {
+        hashmap_put(hm, (void*)i, (void*)i);
+
+        if(i > 200) {
+            hashmap_delete(hm, (void*)(i - 200));
+        }
+
+        // table reaches its churn size after first keys
+        if(i == 2000) {
+            memory_get_heap_stat(&stat);
+            churn_used = stat.total_size - stat.free_size;
+        }
+    }
+
+    memory_get_heap_stat(&stat);
+
+    // heap bookkeeping moves a few bytes, a leaked table is kilobytes
+    if(hashmap_size(hm) != 200 || stat.total_size - stat.free_size > churn_used + 1024) {
+        printf("heap usage grows with churn: %lli -> %lli\n", churn_used, stat.total_size - stat.free_size);
+        pass = false;
+    }
+
+    hashmap_destroy(hm);
+
+    // plain get probes tables without lock, a resize ending during get should not free table which get reads
+    hm = hashmap_new_with_hkg_with_hkc(128, NULL, test_hashmap_racing_kc);
+    test_hashmap_race_map = hm;
+
+    // 256 slots take 224 items, next put starts doubling and moves only first groups
+    for(uint64_t i = 1; i <= 225; i++) {
+        hashmap_put(hm, (void*)i, (void*)i);
+    }
+
+    test_hashmap_race_armed = true;
+
+    if(hashmap_get(hm, (void*)1) != (void*)1 || test_hashmap_race_armed) {
+        print_error("racing get failed");
+        pass = false;
+    }
+
+    if(test_hashmap_race_freed) {
+        printf("table is freed while get reads it: %lli frees\n", test_hashmap_race_freed);
+        pass = false;
+    }
+
+    memory_get_heap_stat(&stat);
+    uint64_t race_free_count = stat.free_count;
+
+    // get is gone, next write reclaims moved table
+    hashmap_put(hm, (void*)2000, (void*)2000);
+
+    memory_get_heap_stat(&stat);
+
+    if(stat.free_count == race_free_count || hashmap_size(hm) != 290) {
+        print_error("moved table is not reclaimed after get");
+        pass = false;
+    }
+
+    hashmap_destroy(hm);
+
+    // concurrent map grows while an iterator holds its reader section, moved tables wait for iterator
+    hm = hashmap_integer_concurrent(16);
+
+    for(uint64_t i = 1; i <= 64; i++) {
+        hashmap_put(hm, (void*)i, (void*)i);
+    }
+
+    iter = hashmap_iterator_create(hm);
+
+    for(uint64_t i = 65; i <= bench_count; i++) {
+        hashmap_put(hm, (void*)i, (void*)i);
+    }
+
+    // iterator still reads its own tables, they are retired but not reclaimed
+    while(iter->end_of_iterator(iter) != 0) {
+        if(iter->get_item(iter) != iter->get_extra_data(iter)) {
+            pass = false;
+        }
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    iter_count = 0;
+
+    iter = hashmap_iterator_create(hm);
+
+    while(iter->end_of_iterator(iter) != 0) {
+        iter_count++;
+
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(iter_count != bench_count) {
+        print_error("iterator of concurrent map lost items");
+        pass = false;
+    }
+
+    start = time_ns(NULL);
+
+    for(uint64_t i = 1; i <= bench_count; i++) {
+        if(hashmap_get(hm, (void*)i) != (void*)i || hashmap_exists(hm, (void*)(bench_count + i))) {
+            pass = false;
+        }
+    }
+
+    get_elapsed = time_ns(NULL) - start;
+
+    for(uint64_t i = 1; i <= 10; i++) {
+        hashmap_delete(hm, (void*)i);
+        hashmap_retire(hm, (void*)i, test_hashmap_reclaimer);
+    }
+
+    // writes after readers are gone reclaim retired data
+    for(uint64_t i = 1; i <= 4; i++) {
+        hashmap_delete(hm, (void*)(10 + i));
+    }
+
+    if(test_hashmap_reclaimed != 55) {
+        printf("retired data is not reclaimed: %lli\n", test_hashmap_reclaimed);
+        pass = false;
+    }
+
+    hashmap_retire(hm, (void*)100, test_hashmap_reclaimer);
+
+    if(hashmap_size(hm) != bench_count - 14 || hashmap_get(hm, (void*)15) != (void*)15) {
+        print_error("wrong concurrent map after deletes");
+        pass = false;
+    }
+
+    hashmap_destroy(hm);
+
+    if(test_hashmap_reclaimed != 155) {
+        print_error("retired data is not reclaimed at destroy");
+        pass = false;
+    }
+
+    printf("concurrent hashmap %lli items: get+miss %lli ns/op\n", bench_count, get_elapsed / bench_count);
+
     if(!pass) {
         print_error("TESTS FAILED");
     } else {
         print_success("TESTS PASSED");
     }
 
-    return 0;
+    return pass ? 0 : -1;
 }
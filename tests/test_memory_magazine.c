@@ -0,0 +1,214 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE (64ULL << 20)
+#include "setup.h"
+
+#define TEST_MAGAZINE_SLOT_COUNT 256
+#define TEST_MAGAZINE_OP_COUNT   (1 << 20)
+#define TEST_MAGAZINE_OBJ_COUNT  4096
+
+int32_t  main(int32_t argc, char_t** argv);
+uint64_t test_magazine_bench(void** slots);
+int8_t   test_magazine_objects(void);
+int8_t   test_magazine_double_free(void);
+
+uint64_t test_magazine_bench(void** slots) {
+    uint64_t seed = 0x1234567;
+
+    uint64_t start = time_ns(NULL);
+
+    for(uint64_t i = 0; i < TEST_MAGAZINE_OP_COUNT; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+
+        uint64_t slot = seed % TEST_MAGAZINE_SLOT_COUNT;
+        uint64_t size = 8 + ((seed >> 16) % MEMORY_MAGAZINE_OBJECT_MAX_SIZE);
+
+        if(size > MEMORY_MAGAZINE_OBJECT_MAX_SIZE) {
+            size = MEMORY_MAGAZINE_OBJECT_MAX_SIZE;
+        }
+
+        memory_free(slots[slot]);
+        slots[slot] = memory_malloc(size);
+    }
+
+    uint64_t elapsed = time_ns(NULL) - start;
+
+    for(uint64_t i = 0; i < TEST_MAGAZINE_SLOT_COUNT; i++) {
+        memory_free(slots[i]);
+        slots[i] = NULL;
+    }
+
+    return elapsed;
+}
+
+int8_t test_magazine_objects(void) {
+    uint64_t** objs = memory_malloc(sizeof(uint64_t*) * TEST_MAGAZINE_OBJ_COUNT);
+
+    if(!objs) {
+        print_error("cannot allocate object array");
+
+        return -1;
+    }
+
+    int8_t res = 0;
+
+    for(uint64_t i = 0; i < TEST_MAGAZINE_OBJ_COUNT; i++) {
+        uint64_t size = 16 * (1 + (i % (MEMORY_MAGAZINE_OBJECT_MAX_SIZE / 16)));
+
+        objs[i] = memory_malloc(size);
+
+        if(!objs[i]) {
+            print_error("cannot allocate object %lli", i);
+            res = -1;
+
+            break;
+        }
+
+        for(uint64_t j = 0; j < size / sizeof(uint64_t); j++) {
+            if(objs[i][j]) {
+                print_error("object %lli is not zeroed", i);
+                res = -1;
+
+                break;
+            }
+
+            objs[i][j] = i;
+        }
+    }
+
+    for(uint64_t i = 0; i < TEST_MAGAZINE_OBJ_COUNT && !res; i++) {
+        uint64_t size = 16 * (1 + (i % (MEMORY_MAGAZINE_OBJECT_MAX_SIZE / 16)));
+
+        for(uint64_t j = 0; j < size / sizeof(uint64_t); j++) {
+            if(objs[i][j] != i) {
+                print_error("object %lli is overwritten", i);
+                res = -1;
+
+                break;
+            }
+        }
+    }
+
+    for(uint64_t i = 0; i < TEST_MAGAZINE_OBJ_COUNT; i++) {
+        memory_free(objs[i]);
+    }
+
+    memory_free(objs);
+
+    return res;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfree-nonheap-object"
+#pragma GCC diagnostic ignored "-Wuse-after-free"
+int8_t test_magazine_double_free(void) {
+    uint8_t* obj = memory_malloc(48);
+
+    if(!obj) {
+        print_error("cannot allocate object");
+
+        return -1;
+    }
+
+    if(memory_free(obj + 16) == 0) {
+        print_error("inner address is freed");
+
+        return -1;
+    }
+
+    if(memory_free(obj) != 0) {
+        print_error("cannot free object");
+
+        return -1;
+    }
+
+    if(memory_free(obj) == 0) {
+        print_error("double free is accepted");
+
+        return -1;
+    }
+
+    // rejected free should not put object to magazine twice
+    uint8_t* obj1 = memory_malloc(48);
+    uint8_t* obj2 = memory_malloc(48);
+
+    int8_t res = 0;
+
+    if(!obj1 || !obj2 || obj1 == obj2) {
+        print_error("same object is allocated twice");
+        res = -1;
+    }
+
+    memory_free(obj1);
+    memory_free(obj2);
+
+    // rejected frees are logged, log buffer is released for returning its slabs at disable
+    buffer_destroy(default_buffer);
+    default_buffer = NULL;
+
+    return res;
+}
+#pragma GCC diagnostic pop
+
+int32_t main(int32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    void** slots = memory_malloc(sizeof(void*) * TEST_MAGAZINE_SLOT_COUNT);
+
+    if(!slots) {
+        print_error("cannot allocate slots");
+
+        return -1;
+    }
+
+    uint64_t heap_elapsed = test_magazine_bench(slots);
+
+    if(memory_magazine_enable(16 << 20, NULL) != 0) {
+        print_error("cannot enable magazines");
+        memory_free(slots);
+
+        return -1;
+    }
+
+    if(test_magazine_objects() != 0 || test_magazine_double_free() != 0) {
+        memory_magazine_disable();
+        memory_free(slots);
+
+        return -1;
+    }
+
+    uint64_t magazine_elapsed = test_magazine_bench(slots);
+
+    memory_magazine_stat_t stat = {0};
+    memory_magazine_get_stat(&stat);
+
+    printf("heap: %lli ns/op magazine: %lli ns/op\n", heap_elapsed / TEST_MAGAZINE_OP_COUNT, magazine_elapsed / TEST_MAGAZINE_OP_COUNT);
+    printf("hit: %lli refill: %lli flush: %lli slabs: %lli/%lli\n", stat.hit_count, stat.refill_count, stat.flush_count,
+           stat.slab_count - stat.free_slab_count, stat.slab_count);
+
+    if(stat.hit_count < TEST_MAGAZINE_OP_COUNT) {
+        print_error("magazines are not used");
+        memory_magazine_disable();
+        memory_free(slots);
+
+        return -1;
+    }
+
+    memory_free(slots);
+
+    if(memory_magazine_disable() != 0) {
+        print_error("magazine slabs are leaked");
+
+        return -1;
+    }
+
+    print_success("TESTS PASSED");
+
+    return 0;
+}
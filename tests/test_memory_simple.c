@@ -3,9 +3,132 @@
  * Please read and understand latest version of Licence.
  */
 
+#define RAMSIZE (4 << 20)
 #include "setup.h"
 
-int main(void);
+#define TEST_ALIGNED_ITEM_COUNT 16
+#define TEST_PAGE_ITEM_COUNT    192
+
+int    main(void);
+int8_t test_aligned_malloc(memory_heap_t* heap, const char_t* name);
+int8_t test_page_chunks(void);
+
+int8_t test_aligned_malloc(memory_heap_t* heap, const char_t* name) {
+    const uint64_t aligns[] = {0x10, 0x40, 0x100, 0x1000, 0x2000};
+    const uint64_t sizes[] = {0x18, 0x200, 0x1000, 0x1800};
+    uint8_t* items[TEST_ALIGNED_ITEM_COUNT] = {0};
+    int8_t res = 0;
+
+    for(uint64_t a = 0; a < sizeof(aligns) / sizeof(aligns[0]) && !res; a++) {
+        for(uint64_t i = 0; i < TEST_ALIGNED_ITEM_COUNT; i++) {
+            uint64_t size = sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+
+            items[i] = memory_malloc_ext(heap, size, aligns[a]);
+
+            if(items[i] == NULL) {
+                print_error("%s cannot malloc size 0x%llx align 0x%llx", name, size, aligns[a]);
+                res = -1;
+
+                break;
+            }
+
+            if((uint64_t)items[i] % aligns[a]) {
+                print_error("%s address %p is not aligned to 0x%llx", name, items[i], aligns[a]);
+                res = -1;
+
+                break;
+            }
+
+            for(uint64_t j = 0; j < size; j++) {
+                if(items[i][j]) {
+                    print_error("%s address %p is not zeroed", name, items[i]);
+                    res = -1;
+
+                    break;
+                }
+            }
+
+            memory_memset(items[i], (uint8_t)(i + 1), size);
+        }
+
+        for(uint64_t i = 0; i < TEST_ALIGNED_ITEM_COUNT && !res; i++) {
+            uint64_t size = sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+
+            for(uint64_t j = 0; j < size; j++) {
+                if(items[i][j] != (uint8_t)(i + 1)) {
+                    print_error("%s address %p is overwritten", name, items[i]);
+                    res = -1;
+
+                    break;
+                }
+            }
+        }
+
+        for(uint64_t i = 0; i < TEST_ALIGNED_ITEM_COUNT; i++) {
+            memory_free_ext(heap, items[i]);
+            items[i] = NULL;
+        }
+    }
+
+    return res;
+}
+
+int8_t test_page_chunks(void) {
+    uint8_t** items = memory_malloc(sizeof(uint8_t*) * TEST_PAGE_ITEM_COUNT);
+
+    if(items == NULL) {
+        print_error("Cannot malloc");
+
+        return -1;
+    }
+
+    memory_heap_stat_t before;
+    memory_get_heap_stat(&before);
+
+    int8_t res = 0;
+
+    // items span several page chunks, frees find their chunks by address
+    for(uint64_t i = 0; i < TEST_PAGE_ITEM_COUNT; i++) {
+        items[i] = memory_malloc_ext(NULL, 0x1000, 0x1000);
+
+        if(items[i] == NULL || (uint64_t)items[i] % 0x1000) {
+            print_error("cannot malloc page item %lli", i);
+            res = -1;
+
+            break;
+        }
+
+        items[i][0] = (uint8_t)(i + 1);
+    }
+
+    for(uint64_t i = 0; i < TEST_PAGE_ITEM_COUNT && !res; i++) {
+        if(items[i][0] != (uint8_t)(i + 1)) {
+            print_error("page item %lli is overwritten", i);
+            res = -1;
+        }
+    }
+
+    for(uint64_t i = 0; i < TEST_PAGE_ITEM_COUNT; i += 2) {
+        memory_free(items[i]);
+    }
+
+    for(int64_t i = TEST_PAGE_ITEM_COUNT - 1; i > 0; i -= 2) {
+        memory_free(items[i]);
+    }
+
+    memory_heap_stat_t after;
+    memory_get_heap_stat(&after);
+
+    // chunks and their pages are heap blocks, empty chunks are released so counts match
+    if(!res && after.malloc_count - before.malloc_count != after.free_count - before.free_count) {
+        print_error("page chunks are not released mc 0x%llx fc 0x%llx", after.malloc_count - before.malloc_count, after.free_count - before.free_count);
+        res = -1;
+    }
+
+    memory_free(items);
+
+    return res;
+}
 
 int main(void){
     memory_heap_stat_t stat;
@@ -156,6 +279,49 @@ int main(void){
 
     memory_free(items);
 
+    if(test_aligned_malloc(NULL, "hash heap") != 0) {
+        return -1;
+    }
+
+    print_success("hash heap aligned malloc ok");
+
+    if(test_page_chunks() != 0) {
+        return -1;
+    }
+
+    print_success("hash heap page chunks ok");
+
+    uint64_t simple_heap_size = 256 << 10;
+    uint8_t* simple_heap_area = memory_malloc_ext(NULL, simple_heap_size, 0x1000);
+
+    if(simple_heap_area == NULL) {
+        print_error("Cannot malloc simple heap area");
+        return -1;
+    }
+
+    memory_heap_t* simple_heap = memory_create_heap_simple((size_t)simple_heap_area, (size_t)simple_heap_area + simple_heap_size);
+
+    if(simple_heap == NULL) {
+        print_error("Cannot create simple heap");
+        return -1;
+    }
+
+    if(test_aligned_malloc(simple_heap, "simple heap") != 0) {
+        return -1;
+    }
+
+    memory_heap_stat_t simple_stat_after;
+    memory_get_heap_stat_ext(simple_heap, &simple_stat_after);
+
+    if(simple_stat_after.malloc_count != simple_stat_after.free_count) {
+        print_error("simple heap leaked mc 0x%llx fc 0x%llx", simple_stat_after.malloc_count, simple_stat_after.free_count);
+        return -1;
+    }
+
+    print_success("simple heap aligned malloc ok");
+
+    memory_free(simple_heap_area);
+
     memory_get_heap_stat(&stat);
     printf("mc 0x%llx fc 0x%llx ts 0x%llx fs 0x%llx 0x%llx\n", stat.malloc_count, stat.free_count, stat.total_size, stat.free_size, stat.total_size - stat.free_size);
 
@@ -0,0 +1,307 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#define RAMSIZE (256ULL << 20)
+#include <memory/frame.h>
+#include <memory/paging.h>
+#include <systeminfo.h>
+#include <efi.h>
+#include <bplustree.h>
+#include <hashmap.h>
+#include <network/network_buffer.h>
+#include "setup.h"
+
+#define TEST_NB_PHYSICAL_SIZE  (8ULL << 20)
+#define TEST_NB_PHYSICAL_ALIGN (2ULL << 20)
+
+int32_t main(int32_t argc, char_t** argv);
+int8_t  test_nb_push_pull(void);
+int8_t  test_nb_refcount(void);
+int8_t  test_nb_heap_backed(void);
+int8_t  test_nb_grow(void);
+
+// host memory is used as physical memory, so all frames are identity mapped
+int8_t memory_paging_add_va_for_frame_ext(memory_page_table_context_t* table_context, uint64_t va_start, frame_t* frm, memory_paging_page_type_t type) {
+    UNUSED(table_context);
+    UNUSED(va_start);
+    UNUSED(frm);
+    UNUSED(type);
+
+    return 0;
+}
+
+int8_t memory_paging_delete_va_for_frame_ext(memory_page_table_context_t* table_context, uint64_t va_start, frame_t* frm) {
+    UNUSED(table_context);
+    UNUSED(va_start);
+    UNUSED(frm);
+
+    return 0;
+}
+
+int8_t test_nb_push_pull(void) {
+    network_buffer_t* nb = network_buffer_alloc(64);
+
+    if(nb == NULL) {
+        print_error("cannot allocate buffer");
+
+        return -1;
+    }
+
+    if(nb->head_fa == 0 || network_buffer_get_headroom(nb) != NETWORK_BUFFER_HEADROOM || nb->length != 0 ||
+       network_buffer_get_tailroom(nb) != NETWORK_BUFFER_SIZE - NETWORK_BUFFER_HEADROOM) {
+        print_error("new buffer layout is wrong");
+
+        return -1;
+    }
+
+    uint8_t* payload = network_buffer_put(nb, 16);
+
+    if(payload != network_buffer_get_data(nb) || nb->length != 16) {
+        print_error("put failed");
+
+        return -1;
+    }
+
+    memory_memset(payload, 0xAA, 16);
+
+    uint8_t* hdr = network_buffer_push(nb, 20);
+
+    if(hdr != payload - 20 || nb->length != 36 || network_buffer_get_data_fa(nb) != nb->head_fa + NETWORK_BUFFER_HEADROOM - 20) {
+        print_error("push failed");
+
+        return -1;
+    }
+
+    if(network_buffer_push(nb, NETWORK_BUFFER_HEADROOM) != NULL) {
+        print_error("push over headroom succeeded");
+
+        return -1;
+    }
+
+    if(network_buffer_pull(nb, 20) != payload || nb->length != 16 || payload[15] != 0xAA) {
+        print_error("pull failed");
+
+        return -1;
+    }
+
+    if(network_buffer_pull(nb, 17) != NULL || network_buffer_trim(nb, 17) != -1) {
+        print_error("pull or trim over length succeeded");
+
+        return -1;
+    }
+
+    if(network_buffer_trim(nb, 8) != 0 || nb->length != 8) {
+        print_error("trim failed");
+
+        return -1;
+    }
+
+    if(network_buffer_put(nb, NETWORK_BUFFER_SIZE) != NULL) {
+        print_error("put over tailroom succeeded");
+
+        return -1;
+    }
+
+    network_buffer_release(nb);
+
+    return 0;
+}
+
+int8_t test_nb_refcount(void) {
+    uint64_t free_count = network_buffer_pool_get_free_count();
+
+    network_buffer_t* nb = network_buffer_create_from_data((const uint8_t*)"turnstone", 9);
+
+    if(nb == NULL || nb->length != 9 || memory_memcompare(network_buffer_get_data(nb), "turnstone", 9) != 0) {
+        print_error("cannot create buffer from data");
+
+        return -1;
+    }
+
+    if(network_buffer_pool_get_free_count() != free_count - 1) {
+        print_error("free count is not decreased");
+
+        return -1;
+    }
+
+    if(network_buffer_retain(nb) != nb || nb->ref_count != 2) {
+        print_error("retain failed");
+
+        return -1;
+    }
+
+    network_buffer_release(nb);
+
+    if(network_buffer_pool_get_free_count() != free_count - 1) {
+        print_error("buffer returned to pool while referenced");
+
+        return -1;
+    }
+
+    // pool buffers are already device accessible, reference is moved as is
+    if(network_buffer_get_dma_buffer(nb) != nb) {
+        print_error("pool buffer is copied for dma");
+
+        return -1;
+    }
+
+    network_buffer_release(nb);
+
+    if(network_buffer_pool_get_free_count() != free_count) {
+        print_error("buffer isnot returned to pool");
+
+        return -1;
+    }
+
+    return 0;
+}
+
+int8_t test_nb_heap_backed(void) {
+    uint64_t free_count = network_buffer_pool_get_free_count();
+
+    network_buffer_t* nb = network_buffer_alloc(4000);
+
+    if(nb == NULL || nb->head_fa != 0 || network_buffer_put(nb, 4000) == NULL) {
+        print_error("cannot allocate heap backed buffer");
+
+        return -1;
+    }
+
+    if(network_buffer_pool_get_free_count() != free_count) {
+        print_error("heap backed buffer is taken from pool");
+
+        return -1;
+    }
+
+    network_buffer_release(nb);
+
+    nb = network_buffer_alloc(4000);
+
+    if(nb == NULL) {
+        print_error("cannot allocate heap backed buffer");
+
+        return -1;
+    }
+
+    memory_memset(network_buffer_put(nb, 100), 0x55, 100);
+
+    network_buffer_t* dma_nb = network_buffer_get_dma_buffer(nb);
+
+    if(dma_nb == NULL || dma_nb->head_fa == 0 || dma_nb->length != 100 || network_buffer_get_data(dma_nb)[99] != 0x55) {
+        print_error("heap backed buffer isnot copied for dma");
+
+        return -1;
+    }
+
+    if(network_buffer_pool_get_free_count() != free_count - 1) {
+        print_error("dma copy isnot taken from pool");
+
+        return -1;
+    }
+
+    network_buffer_release(dma_nb);
+
+    return 0;
+}
+
+int8_t test_nb_grow(void) {
+    uint64_t count = network_buffer_pool_get_free_count() + NETWORK_BUFFER_POOL_GROW_COUNT / 2;
+    network_buffer_t** nbs = memory_malloc(sizeof(network_buffer_t*) * count);
+
+    if(nbs == NULL) {
+        print_error("cannot allocate buffer list");
+
+        return -1;
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        nbs[i] = network_buffer_alloc(NETWORK_BUFFER_SIZE - NETWORK_BUFFER_HEADROOM);
+
+        if(nbs[i] == NULL || nbs[i]->head_fa == 0) {
+            print_error("cannot allocate buffer 0x%llx", i);
+
+            return -1;
+        }
+
+        // slabs should not overlap
+        memory_memset(network_buffer_put(nbs[i], 8), (uint8_t)i, 8);
+    }
+
+    for(uint64_t i = 0; i < count; i++) {
+        if(network_buffer_get_data(nbs[i])[7] != (uint8_t)i) {
+            print_error("buffer 0x%llx is overwritten", i);
+
+            return -1;
+        }
+
+        network_buffer_release(nbs[i]);
+    }
+
+    memory_free(nbs);
+
+    if(network_buffer_pool_get_free_count() != 2 * NETWORK_BUFFER_POOL_GROW_COUNT) {
+        print_error("pool isnot grown, free count 0x%llx", network_buffer_pool_get_free_count());
+
+        return -1;
+    }
+
+    return 0;
+}
+
+int32_t main(int32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    uint8_t* physical = memory_malloc_aligned(TEST_NB_PHYSICAL_SIZE, TEST_NB_PHYSICAL_ALIGN);
+    efi_memory_descriptor_t* mmap = memory_malloc(sizeof(efi_memory_descriptor_t));
+    system_info_t* sysinfo = memory_malloc(sizeof(system_info_t));
+
+    if(!physical || !mmap || !sysinfo) {
+        print_error("cannot allocate test memory");
+
+        return -1;
+    }
+
+    mmap[0] = (efi_memory_descriptor_t){EFI_CONVENTIONAL_MEMORY, (uint64_t)physical, 0, TEST_NB_PHYSICAL_SIZE / FRAME_SIZE, 0};
+
+    sysinfo->mmap_data = (uint8_t*)mmap;
+    sysinfo->mmap_size = sizeof(efi_memory_descriptor_t);
+    sysinfo->mmap_descriptor_size = sizeof(efi_memory_descriptor_t);
+
+    SYSTEM_INFO = sysinfo;
+
+    frame_allocator_t* fa = frame_allocator_new();
+
+    if(fa == NULL) {
+        print_error("cannot create frame allocator");
+
+        return -1;
+    }
+
+    frame_set_allocator(fa);
+
+    if(network_buffer_pool_init() != 0 || network_buffer_pool_get_free_count() != NETWORK_BUFFER_POOL_GROW_COUNT) {
+        print_error("cannot init network buffer pool");
+
+        return -1;
+    }
+
+    if(test_nb_push_pull() != 0 || test_nb_refcount() != 0 || test_nb_heap_backed() != 0 || test_nb_grow() != 0) {
+        return -1;
+    }
+
+    // pool frames are inside test physical memory which is freed below
+    frame_set_allocator(NULL);
+    frame_allocator_destroy(fa);
+    SYSTEM_INFO = NULL;
+
+    memory_free(sysinfo);
+    memory_free(mmap);
+    memory_free(physical);
+
+    print_success("TESTS PASSED");
+
+    return 0;
+}
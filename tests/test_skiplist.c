@@ -0,0 +1,376 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include "setup.h"
+#include <skiplist.h>
+
+#define TEST_SKIPLIST_ITEM_COUNT 4096
+
+typedef struct item_t {
+    uint64_t key;
+    uint64_t version;
+} item_t;
+
+int32_t main(int32_t argc, char_t** argv);
+int8_t  key_comparator(const void* i, const void* j);
+int8_t  version_comparator(const void* i, const void* j);
+int8_t  test_unique(void);
+int8_t  test_non_unique(void);
+int8_t  test_search(void);
+int8_t  test_ordered(void);
+
+int8_t key_comparator(const void* i, const void* j){
+    const item_t* t_i = (const item_t*)i;
+    const item_t* t_j = (const item_t*)j;
+
+    if(t_i->key < t_j->key) {
+        return -1;
+    }
+
+    if(t_i->key > t_j->key) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int8_t version_comparator(const void* i, const void* j){
+    const item_t* t_i = (const item_t*)i;
+    const item_t* t_j = (const item_t*)j;
+
+    // newest version first
+    if(t_i->version < t_j->version) {
+        return 1;
+    }
+
+    if(t_i->version > t_j->version) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int8_t test_unique(void) {
+    index_t* idx = skiplist_create_index_with_unique(key_comparator, true);
+
+    if(!idx) {
+        print_error("cannot create unique skiplist");
+
+        return -1;
+    }
+
+    item_t* items = memory_malloc(sizeof(item_t) * TEST_SKIPLIST_ITEM_COUNT * 2);
+
+    if(!items) {
+        print_error("cannot create items");
+        skiplist_destroy_index(idx);
+
+        return -1;
+    }
+
+    int8_t res = 0;
+
+    for(uint64_t i = 0; i < TEST_SKIPLIST_ITEM_COUNT * 2; i++) {
+        items[i].key = (i * 7919) % TEST_SKIPLIST_ITEM_COUNT;
+        items[i].version = i;
+
+        item_t* old_item = NULL;
+
+        if(idx->insert(idx, &items[i], &items[i], (void**)&old_item) != 0) {
+            print_error("cannot insert item %lli", i);
+            res = -1;
+
+            break;
+        }
+
+        if((i < TEST_SKIPLIST_ITEM_COUNT && old_item) || (i >= TEST_SKIPLIST_ITEM_COUNT && (!old_item || old_item->key != items[i].key))) {
+            print_error("unexpected replaced item at %lli", i);
+            res = -1;
+
+            break;
+        }
+    }
+
+    if(!res && idx->size(idx) != TEST_SKIPLIST_ITEM_COUNT) {
+        print_error("unique size mismatch %lli", idx->size(idx));
+        res = -1;
+    }
+
+    if(!res) {
+        uint64_t expected = 0;
+
+        iterator_t* iter = idx->create_iterator(idx);
+
+        while(iter->end_of_iterator(iter) != 0) {
+            const item_t* item = iter->get_item(iter);
+
+            if(item->key != expected || item->version < TEST_SKIPLIST_ITEM_COUNT) {
+                print_error("unique iteration mismatch at %lli", expected);
+                res = -1;
+
+                break;
+            }
+
+            expected++;
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+
+        if(!res && expected != TEST_SKIPLIST_ITEM_COUNT) {
+            print_error("unique iteration count mismatch %lli", expected);
+            res = -1;
+        }
+    }
+
+    if(!res) {
+        item_t s_key = {.key = 17};
+        const item_t* item = idx->find(idx, &s_key);
+
+        if(!item || item->key != 17 || !idx->contains(idx, &s_key)) {
+            print_error("cannot find key");
+            res = -1;
+        }
+
+        s_key.key = TEST_SKIPLIST_ITEM_COUNT;
+
+        if(idx->find(idx, &s_key) || idx->contains(idx, &s_key)) {
+            print_error("found missing key");
+            res = -1;
+        }
+    }
+
+    skiplist_destroy_index(idx);
+    memory_free(items);
+
+    return res;
+}
+
+int8_t test_non_unique(void) {
+    index_t* idx = skiplist_create_index_with_unique(key_comparator, false);
+
+    if(!idx) {
+        print_error("cannot create non unique skiplist");
+
+        return -1;
+    }
+
+    skiplist_set_comparator_for_unique_subpart_for_non_unique_index(idx, version_comparator);
+
+    item_t items[] = {{1, 1}, {2, 1}, {1, 3}, {1, 2}, {2, 2}, {1, 3}};
+    uint64_t item_count = sizeof(items) / sizeof(item_t);
+
+    int8_t res = 0;
+    uint64_t replaced = 0;
+
+    for(uint64_t i = 0; i < item_count; i++) {
+        item_t* old_item = NULL;
+
+        if(idx->insert(idx, &items[i], &items[i], (void**)&old_item) != 0) {
+            print_error("cannot insert item %lli", i);
+            res = -1;
+
+            break;
+        }
+
+        if(old_item) {
+            replaced++;
+        }
+    }
+
+    if(!res && (replaced != 1 || idx->size(idx) != item_count - 1)) {
+        print_error("non unique replace mismatch %lli %lli", replaced, idx->size(idx));
+        res = -1;
+    }
+
+    item_t s_key = {.key = 1};
+    uint64_t expected_versions[] = {3, 2, 1};
+    uint64_t found = 0;
+
+    iterator_t* iter = idx->search(idx, &s_key, NULL, INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL);
+
+    while(!res && iter->end_of_iterator(iter) != 0) {
+        const item_t* item = iter->get_item(iter);
+
+        if(found >= 3 || item->key != 1 || item->version != expected_versions[found]) {
+            print_error("non unique search mismatch at %lli", found);
+            res = -1;
+
+            break;
+        }
+
+        found++;
+        iter = iter->next(iter);
+    }
+
+    iter->destroy(iter);
+
+    if(!res && found != 3) {
+        print_error("non unique search count mismatch %lli", found);
+        res = -1;
+    }
+
+    skiplist_destroy_index(idx);
+
+    return res;
+}
+
+int8_t test_search(void) {
+    index_t* idx = skiplist_create_index_with_unique(key_comparator, true);
+
+    if(!idx) {
+        print_error("cannot create search skiplist");
+
+        return -1;
+    }
+
+    item_t items[16];
+
+    for(uint64_t i = 0; i < 16; i++) {
+        items[i].key = i * 2;
+        items[i].version = 0;
+        idx->insert(idx, &items[i], &items[i], NULL);
+    }
+
+    struct {
+        index_key_search_criteria_t criteria;
+        uint64_t                    key1;
+        uint64_t                    key2;
+        uint64_t                    first;
+        uint64_t                    count;
+    } cases[] = {
+        {INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL, 6, 0, 6, 1},
+        {INDEXER_KEY_COMPARATOR_CRITERIA_EQUAL, 7, 0, 0, 0},
+        {INDEXER_KEY_COMPARATOR_CRITERIA_BETWEEN, 5, 11, 6, 3},
+        {INDEXER_KEY_COMPARATOR_CRITERIA_BETWEEN, 6, 10, 6, 3},
+        {INDEXER_KEY_COMPARATOR_CRITERIA_GREATER, 26, 0, 28, 2},
+        {INDEXER_KEY_COMPARATOR_CRITERIA_EQUALORGREATER, 26, 0, 26, 3},
+        {INDEXER_KEY_COMPARATOR_CRITERIA_LESS, 4, 0, 0, 2},
+        {INDEXER_KEY_COMPARATOR_CRITERIA_LESSOREQUAL, 4, 0, 0, 3},
+    };
+
+    int8_t res = 0;
+
+    for(uint64_t c = 0; c < sizeof(cases) / sizeof(cases[0]) && !res; c++) {
+        item_t key1 = {.key = cases[c].key1};
+        item_t key2 = {.key = cases[c].key2};
+
+        iterator_t* iter = idx->search(idx, &key1, &key2, cases[c].criteria);
+        uint64_t count = 0;
+
+        while(iter->end_of_iterator(iter) != 0) {
+            const item_t* item = iter->get_item(iter);
+
+            if(item->key != cases[c].first + count * 2) {
+                print_error("search case %lli item mismatch", c);
+                res = -1;
+
+                break;
+            }
+
+            count++;
+            iter = iter->next(iter);
+        }
+
+        iter->destroy(iter);
+
+        if(!res && count != cases[c].count) {
+            print_error("search case %lli count mismatch %lli", c, count);
+            res = -1;
+        }
+    }
+
+    skiplist_destroy_index(idx);
+
+    return res;
+}
+
+int8_t test_ordered(void) {
+    index_t* idx = skiplist_create_index_with_unique(key_comparator, true);
+
+    if(!idx) {
+        print_error("cannot create ordered skiplist");
+
+        return -1;
+    }
+
+    // versions are orders, inserts come out of order like writers which lost the race after their wal append
+    item_t items[] = {{1, 5}, {1, 3}, {1, 7}, {1, 6}, {2, 2}, {2, 1}};
+    item_t* expected_removed[] = {NULL, &items[1], &items[0], &items[3], NULL, &items[5]};
+    uint64_t item_count = sizeof(items) / sizeof(item_t);
+
+    int8_t res = 0;
+
+    for(uint64_t i = 0; i < item_count; i++) {
+        item_t* old_item = NULL;
+
+        if(skiplist_insert_with_order(idx, &items[i], &items[i], items[i].version, (void**)&old_item) != 0) {
+            print_error("cannot insert item %lli", i);
+            res = -1;
+
+            break;
+        }
+
+        if(old_item != expected_removed[i]) {
+            print_error("ordered insert %lli removed unexpected item", i);
+            res = -1;
+
+            break;
+        }
+    }
+
+    item_t s_key = {.key = 1};
+    const item_t* item = idx->find(idx, &s_key);
+
+    if(!res && (!item || item->version != 7)) {
+        print_error("greatest order is not kept");
+        res = -1;
+    }
+
+    s_key.key = 2;
+    item = idx->find(idx, &s_key);
+
+    if(!res && (!item || item->version != 2 || idx->size(idx) != 2)) {
+        print_error("ordered insert size or item mismatch");
+        res = -1;
+    }
+
+    skiplist_destroy_index(idx);
+
+    return res;
+}
+
+int32_t main(int32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    if(test_unique() != 0) {
+        print_error("unique skiplist tests failed");
+
+        return -1;
+    }
+
+    if(test_non_unique() != 0) {
+        print_error("non unique skiplist tests failed");
+
+        return -1;
+    }
+
+    if(test_search() != 0) {
+        print_error("skiplist search tests failed");
+
+        return -1;
+    }
+
+    if(test_ordered() != 0) {
+        print_error("ordered skiplist tests failed");
+
+        return -1;
+    }
+
+    print_success("TESTS PASSED");
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * This work is licensed under TURNSTONE OS Public License.
+ * Please read and understand latest version of Licence.
+ */
+
+#include "setup.h"
+#include <cpu/task_sleep_queue.h>
+
+#define TEST_SLEEP_QUEUE_TASK_COUNT 1024
+
+typedef struct test_task_t {
+    uint64_t wake_tick;
+    boolean_t killed;
+    boolean_t queued;
+} test_task_t;
+
+int32_t main(int32_t argc, char_t** argv);
+int8_t  test_kill_sleeping(void);
+int8_t  test_random_kills(void);
+
+int8_t test_kill_sleeping(void) {
+    task_sleep_queue_t* queue = task_sleep_queue_create(NULL, 4);
+
+    if(!queue) {
+        print_error("cannot create sleep queue");
+
+        return -1;
+    }
+
+    int8_t res = 0;
+
+    test_task_t tasks[8] = {0};
+    uint64_t ticks[8] = {50, 10, 40, 20, 70, 30, 60, 80};
+
+    for(uint64_t i = 0; i < 8; i++) {
+        tasks[i].wake_tick = ticks[i];
+
+        if(!task_sleep_queue_push(queue, &tasks[i], ticks[i])) {
+            print_error("cannot push task");
+            res = -1;
+        }
+    }
+
+    // killed tasks leave queue at once, a long sleeper and the earliest one
+    if(!task_sleep_queue_remove(queue, &tasks[7]) || !task_sleep_queue_remove(queue, &tasks[1])) {
+        print_error("cannot remove killed task");
+        res = -1;
+    }
+
+    if(task_sleep_queue_remove(queue, &tasks[1])) {
+        print_error("killed task removed twice");
+        res = -1;
+    }
+
+    if(task_sleep_queue_size(queue) != 6 || task_sleep_queue_peek_wake_tick(queue) != 20) {
+        print_error("wrong queue after kills");
+        res = -1;
+    }
+
+    uint64_t expected[6] = {20, 30, 40, 50, 60, 70};
+
+    for(uint64_t i = 0; i < 6; i++) {
+        test_task_t* t = task_sleep_queue_pop(queue);
+
+        if(!t || t->wake_tick != expected[i]) {
+            printf("wrong wake order at %lli\n", i);
+            res = -1;
+
+            break;
+        }
+    }
+
+    if(task_sleep_queue_pop(queue) != NULL || task_sleep_queue_peek_wake_tick(queue) != -1ULL) {
+        print_error("queue is not empty");
+        res = -1;
+    }
+
+    task_sleep_queue_destroy(queue);
+
+    return res;
+}
+
+int8_t test_random_kills(void) {
+    task_sleep_queue_t* queue = task_sleep_queue_create(NULL, 4);
+    test_task_t* tasks = memory_malloc(sizeof(test_task_t) * TEST_SLEEP_QUEUE_TASK_COUNT);
+
+    if(!queue || !tasks) {
+        print_error("cannot create sleep queue");
+        task_sleep_queue_destroy(queue);
+        memory_free(tasks);
+
+        return -1;
+    }
+
+    int8_t res = 0;
+
+    // equal ticks are common, scheduler sleeps are tick granular
+    for(uint64_t i = 0; i < TEST_SLEEP_QUEUE_TASK_COUNT; i++) {
+        tasks[i].wake_tick = rand() % 256;
+        tasks[i].queued = task_sleep_queue_push(queue, &tasks[i], tasks[i].wake_tick);
+
+        if(!tasks[i].queued) {
+            print_error("cannot push task");
+            res = -1;
+        }
+    }
+
+    uint64_t kill_count = 0;
+
+    for(uint64_t i = 0; i < TEST_SLEEP_QUEUE_TASK_COUNT / 4; i++) {
+        test_task_t* t = &tasks[rand() % TEST_SLEEP_QUEUE_TASK_COUNT];
+
+        if(task_sleep_queue_remove(queue, t) != !t->killed) {
+            print_error("remove does not match killed state");
+            res = -1;
+        }
+
+        if(!t->killed) {
+            t->killed = true;
+            kill_count++;
+        }
+    }
+
+    if(task_sleep_queue_size(queue) != TEST_SLEEP_QUEUE_TASK_COUNT - kill_count) {
+        print_error("wrong queue size after kills");
+        res = -1;
+    }
+
+    uint64_t last_tick = 0;
+    uint64_t pop_count = 0;
+    test_task_t* t = NULL;
+
+    while((t = task_sleep_queue_pop(queue)) != NULL) {
+        if(t->killed || t->wake_tick < last_tick) {
+            print_error("killed task woke up or wake order is broken");
+            res = -1;
+
+            break;
+        }
+
+        last_tick = t->wake_tick;
+        pop_count++;
+    }
+
+    if(pop_count != TEST_SLEEP_QUEUE_TASK_COUNT - kill_count) {
+        printf("popped %lli tasks, expected %lli\n", pop_count, TEST_SLEEP_QUEUE_TASK_COUNT - kill_count);
+        res = -1;
+    }
+
+    task_sleep_queue_destroy(queue);
+    memory_free(tasks);
+
+    return res;
+}
+
+int32_t main(int32_t argc, char_t** argv) {
+    UNUSED(argc);
+    UNUSED(argv);
+
+    int8_t res = 0;
+
+    res |= test_kill_sleeping();
+    res |= test_random_kills();
+
+    if(res) {
+        print_error("TESTS FAILED");
+    } else {
+        print_success("TESTS PASSED");
+    }
+
+    return res;
+}
@@ -472,7 +472,10 @@ boolean_t linkerdb_create_tables(linkerdb_t* ldb) {
         return false;
     }
 
-    if(!tosdb_table_index_create(tbl_relocations, "section_id", TOSDB_INDEX_SECONDARY)) {
+    // linker reads all relocations of a section, index carries their columns so search does not read values
+    const char_t* reloc_covered_colnames[] = {"symbol_id", "symbol_name", "symbol_section_id", "type", "offset", "addend"};
+
+    if(!tosdb_table_index_create_covering(tbl_relocations, "section_id", reloc_covered_colnames, 6)) {
         return false;
     }
 